@@ -29,7 +29,9 @@
 #include <poll.h>
 #include <termios.h>
 #include <signal.h>
+#include <time.h>
 #include <sys/stat.h>
+#include <sys/uio.h>
 #include <openbmc/pal.h>
 
 #define BAUDRATE      B57600
@@ -37,7 +39,40 @@
 #define ASCII_ENTER   0x0D
 #define MAX_LOGFILE_LINES 1200 // Maximum lines based on carriage returns or new line
 #define MAX_LOGFILE_SIZE 102400 // 100KB size => 1200 lines of 80 characters each = ~108000B
+
+/*
+ * Everything read from the tty lands in the scrollback ring, which is
+ * also where the log and the terminal are written from. Writes to the
+ * log are batched; they go out once LOG_BATCH_BYTES are pending or the
+ * oldest pending byte is LOG_BATCH_MS old.
+ */
+#define SCROLLBACK_SIZE (64 * 1024)
+#define READ_MIN        256
+#define READ_MAX        4096
+#define LOG_BATCH_BYTES 4096
+#define LOG_BATCH_MS    200
+// Without a terminal attached, let a chatty host fill the tty buffer a bit
+#define READ_COALESCE_MS 20
+
 static sig_atomic_t sigexit = 0;
+static sig_atomic_t sigdump = 0;
+
+struct scrollback {
+  char buf[SCROLLBACK_SIZE];
+  uint64_t head;      // bytes ever read from the tty
+  uint64_t logged;    // of which written to the log
+  uint64_t since_ms;  // when the oldest unlogged byte came in
+};
+
+static struct {
+  unsigned long long rx_bytes;
+  unsigned long long reads;
+  unsigned long long log_bytes;
+  unsigned long long log_writes;
+  unsigned long long tx_bytes;
+  unsigned long long lat_total_ms;  // summed over the log writes
+  unsigned int lat_max_ms;
+} stats;
 
 static void
 write_data(int file, char *buf, int len, char *fname) {
@@ -64,6 +99,78 @@ exit_session(int sig)
   sigexit = sig;
 }
 
+static void
+dump_session(int sig)
+{
+  sigdump = 1;
+}
+
+static uint64_t
+now_ms(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/* Write the bytes of the ring from pos to end, at most two pieces */
+static void
+write_ring(int file, struct scrollback *sb, uint64_t pos, uint64_t end,
+           char *fname) {
+  size_t off = pos % SCROLLBACK_SIZE;
+  size_t len = end - pos;
+
+  if (off + len > SCROLLBACK_SIZE) {
+    write_data(file, sb->buf + off, SCROLLBACK_SIZE - off, fname);
+    len -= SCROLLBACK_SIZE - off;
+    off = 0;
+  }
+  write_data(file, sb->buf + off, len, fname);
+}
+
+static void
+flush_log(int buf_fd, struct scrollback *sb, char *bfname) {
+  uint32_t lat;
+
+  if (sb->logged == sb->head)
+    return;
+
+  write_ring(buf_fd, sb, sb->logged, sb->head, bfname);
+  fsync(buf_fd);
+
+  lat = now_ms() - sb->since_ms;
+  stats.lat_total_ms += lat;
+  if (lat > stats.lat_max_ms)
+    stats.lat_max_ms = lat;
+  stats.log_bytes += sb->head - sb->logged;
+  stats.log_writes++;
+  sb->logged = sb->head;
+}
+
+/* Counters to syslog, and what the scrollback holds to a file */
+static void
+dump_scrollback(struct scrollback *sb, char *fru_name) {
+  char fname[64];
+  uint64_t start;
+  int fd;
+
+  syslog(LOG_INFO, "consoled %s: %llu bytes in %llu reads, %llu logged in "
+         "%llu writes (latency avg %llu ms, max %u ms), %llu to terminal",
+         fru_name, stats.rx_bytes, stats.reads, stats.log_bytes,
+         stats.log_writes,
+         stats.log_writes ? stats.lat_total_ms / stats.log_writes : 0,
+         stats.lat_max_ms, stats.tx_bytes);
+
+  sprintf(fname, "/tmp/consoled_%s_scrollback", fru_name);
+  if ((fd = open(fname, O_WRONLY | O_CREAT | O_TRUNC, 0666)) < 0) {
+    syslog(LOG_WARNING, "Cannot open the file %s", fname);
+    return;
+  }
+  start = sb->head > SCROLLBACK_SIZE ? sb->head - SCROLLBACK_SIZE : 0;
+  write_ring(fd, sb, start, sb->head, fname);
+  close(fd);
+}
+
 static void
 print_usage() {
   printf("Usage: consoled [ %s ]\n", pal_server_list);
@@ -79,17 +186,19 @@ run_console(char* fru_name, int term) {
   int nfd = 0;      // For number of fd
   int nevents;      // For number of events in fd
   int nline = 0;
-  //int pid_fd;
   int flags;
-  pid_t pid;        // For pid of the daemon
+  int timeout;
+  int chunk = READ_MIN; // How much to read from the tty, follows the host
+  size_t off;
+  off_t log_size;
   uint8_t fru;
-  char in;          // For stdin character
-  char data[32];
+  char in[64];      // For stdin characters
   char pid_file[64];
   char devtty[32];  // For tty dev path
   char bfname[32];  // For buffer file path
   char old_bfname[32];  // For old buffer file path
-  char buf[256];    // For buffer data
+  char *ctrl_x;
+  struct scrollback *sb;
   struct termios ottytio, nttytio;  // For the tty dev
 
   int stdi;    // STDIN_FILENO
@@ -116,12 +225,18 @@ run_console(char* fru_name, int term) {
     exit(-1);
   }
 
+  if ((sb = calloc(1, sizeof(*sb))) == NULL) {
+    syslog(LOG_WARNING, "Cannot allocate the scrollback");
+    exit(-1);
+  }
+
   /* Handling the few Signals differently */
   signal(SIGHUP, exit_session);
   signal(SIGINT, exit_session);
   signal(SIGTERM, exit_session);
   signal(SIGPIPE, exit_session);
   signal(SIGQUIT, exit_session);
+  signal(SIGUSR1, dump_session);
 
   /* Different flag value for tty dev */
   flags = term == 1 ? (O_RDWR | O_NOCTTY | O_NONBLOCK) :
@@ -151,6 +266,9 @@ run_console(char* fru_name, int term) {
     syslog(LOG_WARNING, "Cannot open the file %s", bfname);
     exit(-1);
   }
+  memset(&buf_stat, 0, sizeof(struct stat));
+  fstat(buf_fd, &buf_stat);
+  log_size = buf_stat.st_size;
 
   if (term) {
     /* Changing the attributes of STDIN_FILENO */
@@ -176,47 +294,91 @@ run_console(char* fru_name, int term) {
   }
 
   /* Handling the input event from the  terminal and tty dev */
-  while (!sigexit && (nevents = poll(pfd, nfd, -1 /* Timeout */))) {
+  while (!sigexit) {
+    timeout = -1;
+    if (sb->logged != sb->head) {
+      timeout = (int64_t)(sb->since_ms + LOG_BATCH_MS) - (int64_t)now_ms();
+      if (timeout < 0)
+        timeout = 0;
+    }
+
+    nevents = poll(pfd, nfd, timeout);
+    if (nevents < 0 && errno != EINTR) {
+      syslog(LOG_WARNING, "poll() failed | errno: %d", errno);
+      break;
+    }
+
+    if (sigdump) {
+      sigdump = 0;
+      dump_scrollback(sb, fru_name);
+    }
+
+    if (nevents <= 0) {
+      if (nevents == 0)
+        flush_log(buf_fd, sb, bfname);
+      continue;
+    }
 
     /* Input to the terminal from the user */
-    if (term && nevents && nfd > 1 && pfd[1].revents > 0) {
-      blen = read(stdi, &in, sizeof(in));
+    if (term && nfd > 1 && pfd[1].revents > 0) {
+      blen = read(stdi, in, sizeof(in));
       if (blen < 1) {
         nfd--;
+      } else {
+        ctrl_x = memchr(in, CTRL_X, blen);
+        if (ctrl_x) {
+          write_data(tty, in, ctrl_x - in, "tty");
+          break;
+        }
+        write_data(tty, in, blen, "tty");
       }
-
-      if (in == CTRL_X) {
-        break;
-      }
-
-      write_data(tty, &in, sizeof(in), "tty");
-
-      nevents--;
     }
 
     /* Input from the tty dev */
-    if (nevents && pfd[0].revents > 0) {
-      blen = read(tty, buf, sizeof(buf));
+    if (pfd[0].revents > 0) {
+      if (!term && chunk < READ_MAX) {
+        usleep(READ_COALESCE_MS * 1000);
+      }
+
+      // Read straight into the ring; unlogged bytes are never overwritten
+      if (sb->head - sb->logged + chunk > SCROLLBACK_SIZE) {
+        flush_log(buf_fd, sb, bfname);
+      }
+      off = sb->head % SCROLLBACK_SIZE;
+      blen = read(tty, sb->buf + off,
+                  chunk < SCROLLBACK_SIZE - off ? chunk : SCROLLBACK_SIZE - off);
       if (blen > 0) {
         for (i = 0; i < blen; i++) {
-          if (buf[i] == 0xD || buf[i] == 0xA)
+          if (sb->buf[off + i] == 0xD || sb->buf[off + i] == 0xA)
             nline++;
         }
-        write_data(buf_fd, buf, blen, bfname);
-        fsync(buf_fd);
+        if (sb->logged == sb->head)
+          sb->since_ms = now_ms();
+        sb->head += blen;
+        log_size += blen;
+        stats.rx_bytes += blen;
+        stats.reads++;
+
         if (term) {
-          write_data(stdo, buf, blen, "STDOUT_FILENO");
+          write_data(stdo, sb->buf + off, blen, "STDOUT_FILENO");
+          stats.tx_bytes += blen;
         }
+
+        if (blen == chunk && chunk < READ_MAX)
+          chunk *= 2;
+        else if (blen < chunk / 4 && chunk > READ_MIN)
+          chunk /= 2;
       } else if (blen < 0) {
         raise(SIGHUP);
       }
 
-      // Get File stat information
-      memset(&buf_stat, 0, sizeof(struct stat));
-      fstat(buf_fd, &buf_stat);
+      if (sb->head - sb->logged >= LOG_BATCH_BYTES) {
+        flush_log(buf_fd, sb, bfname);
+      }
 
       /* Log Rotation based on max number of lines or max file size */
-      if (nline >= MAX_LOGFILE_LINES || buf_stat.st_size >= MAX_LOGFILE_SIZE) {
+      if (nline >= MAX_LOGFILE_LINES || log_size >= MAX_LOGFILE_SIZE) {
+        flush_log(buf_fd, sb, bfname);
         close(buf_fd);
         remove(old_bfname);
         rename(bfname, old_bfname);
@@ -225,13 +387,15 @@ run_console(char* fru_name, int term) {
           exit(-1);
         }
         nline = 0;
+        log_size = 0;
       }
-      nevents--;
     }
   }
 
   /* Close the console buffer file */
+  flush_log(buf_fd, sb, bfname);
   close(buf_fd);
+  free(sb);
 
   /* Revert the tty dev to old attributes */
   tcflush(tty, TCIFLUSH);
@@ -0,0 +1,490 @@
+/*
+ * fand-sim
+ *
+ * Copyright 2017-present Facebook. All Rights Reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * Runs the fand control policies offline, on the development host, so a
+ * policy change can be measured before it goes near hardware.
+ *
+ * The control temperatures either come from a recorded trace, replayed
+ * open loop, or from a first order thermal model that closes the loop:
+ * the node heats towards ambient + load / cooling, where cooling grows
+ * with the fan speed, and relaxes with time constant tau. Every input
+ * of the policy sees the node through its own gain and offset.
+ *
+ * Reported per policy: a fan power proxy (speed cubed, as for the fan
+ * affinity laws), the overshoot of each input over its target, the time
+ * to settle after each load step, and the control loop latency, both as
+ * the simulated time from a load step to the first speed change and as
+ * the CPU time of a policy step.
+ */
+
+/* Yeah, the file ends in .cpp, but it's a C program.  Deal. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <math.h>
+#include <time.h>
+#include "fand_policy.h"
+
+#define MAX_STEPS 32
+#define MAX_SAMPLES 100000
+
+/* How the model shows the node temperature to each policy input */
+struct sim_profile {
+  const char *policy;
+  float ambient;
+  const char *load;
+  float gain[FAND_POLICY_INPUTS];
+  float offset[FAND_POLICY_INPUTS];
+};
+
+/*
+ * Defaults that put each policy into its working range. Yosemite's second
+ * input is the CPU thermal margin, so it reads the node less a 95C
+ * junction limit; its intake only sees ambient.
+ */
+static const struct sim_profile profiles[] = {
+  {"wedge",     25, "0:20,1200:35,2400:20", {1, 1}, {0, -5}},
+  {"sixpack",   25, "0:20,1200:35,2400:20", {1, 1}, {0, -5}},
+  {"wedge100",  25, "0:20,1200:35,2400:20", {1, 1}, {0, -5}},
+  {"yosemite",  25, "0:20,1200:35,2400:20", {0, 1}, {0, -95}},
+  {"galaxy100", 20, "0:6,1200:12,2400:6",   {1, 0}, {0, 0}},
+};
+
+struct load_step {
+  float time;
+  float load;     /* rise over ambient at full fan speed, C */
+};
+
+struct sample {
+  float time;
+  float temp[FAND_POLICY_INPUTS];
+};
+
+struct sim_opts {
+  int cycles;
+  float interval;
+  float ambient;
+  float tau;
+  float min_cooling;
+  float band;
+  bool dump;
+  const char *load;
+  const char *trace;
+  /* Policy overrides, -1 to keep */
+  int low, medium, high, bottom, top;
+};
+
+static struct sample *trace;
+static int trace_len;
+
+static void usage() {
+  fprintf(stderr,
+          "fand-sim -p <policy>[,<policy>...] [-f <trace>] [-n <cycles>]\n"
+          "\t[-i <interval>] [-a <ambient>] [-L <load>] [-k <tau>]\n"
+          "\t[-g <min-cooling>] [-s <band>] [-l <low-pct>] [-m <medium-pct>]\n"
+          "\t[-h <high-pct>] [-b <temp-bottom>] [-t <temp-top>] [-d]\n\n"
+          "\t-p policies to run on the same input, -p list shows them\n"
+          "\t-f replays \"<seconds> <temp> [<temp>]\" lines instead of the model\n"
+          "\t-n model cycles, defaults to 720\n"
+          "\t-i seconds per control cycle, defaults to 5 like fand\n"
+          "\t-a ambient C, -L \"<sec>:<load>,...\" with load the rise over\n"
+          "\t   ambient at full speed, -k time constant, defaults to 120s\n"
+          "\t-g cooling left with the fans stopped, defaults to 0.2\n"
+          "\t-s settling band, defaults to 1C\n"
+          "\t-l -m -h -b -t override the policy as for fand\n"
+          "\t-d dumps a CSV row per cycle\n");
+  exit(1);
+}
+
+static long long now_ns(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (long long)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static const struct sim_profile *find_profile(const char *name) {
+  int i;
+
+  for (i = 0; i < (int)(sizeof(profiles) / sizeof(profiles[0])); i++) {
+    if (!strcmp(profiles[i].policy, name))
+      return &profiles[i];
+  }
+  return NULL;
+}
+
+static int parse_load(const char *str, struct load_step *steps) {
+  const char *p = str;
+  char *end;
+  int n = 0;
+
+  while (*p && n < MAX_STEPS) {
+    steps[n].time = strtof(p, &end);
+    if (end == p || *end != ':')
+      return -1;
+    p = end + 1;
+    steps[n].load = strtof(p, &end);
+    if (end == p)
+      return -1;
+    n++;
+    p = (*end == ',') ? end + 1 : end;
+  }
+
+  return (*p || !n) ? -1 : n;
+}
+
+static int read_trace(const char *file) {
+  char line[256], *p, *end;
+  FILE *fp;
+  int i;
+
+  fp = fopen(file, "r");
+  if (!fp) {
+    perror(file);
+    return -1;
+  }
+
+  trace = (struct sample *)calloc(MAX_SAMPLES, sizeof(struct sample));
+  if (!trace) {
+    fclose(fp);
+    return -1;
+  }
+
+  while (fgets(line, sizeof(line), fp) && trace_len < MAX_SAMPLES) {
+    for (p = line; *p; p++) {
+      if (*p == ',')
+        *p = ' ';
+    }
+    p = line + strspn(line, " \t");
+    if (*p == '#' || *p == '\n' || !*p)
+      continue;
+
+    trace[trace_len].time = strtof(p, &end);
+    if (end == p)
+      continue;
+    for (i = 0; i < FAND_POLICY_INPUTS; i++) {
+      p = end;
+      trace[trace_len].temp[i] = strtof(p, &end);
+      if (end == p)
+        trace[trace_len].temp[i] = i ? trace[trace_len].temp[0] : NAN;
+    }
+    if (!isnan(trace[trace_len].temp[0]))
+      trace_len++;
+  }
+  fclose(fp);
+
+  if (!trace_len) {
+    fprintf(stderr, "%s: no samples\n", file);
+    return -1;
+  }
+  return 0;
+}
+
+/* Latest trace sample at or before t */
+static const struct sample *trace_at(float t, int *pos) {
+  while (*pos + 1 < trace_len && trace[*pos + 1].time <= t)
+    (*pos)++;
+  return &trace[*pos];
+}
+
+/* First cycle from which speed and inputs stay put until end */
+static int settle_cycle(const struct sample *s, const int *speed, int from,
+                        int end, int inputs, float band) {
+  int i, j;
+
+  for (i = end - 1; i > from; i--) {
+    if (speed[i - 1] != speed[end - 1])
+      break;
+    for (j = 0; j < inputs; j++) {
+      if (fabsf(s[i - 1].temp[j] - s[end - 1].temp[j]) > band)
+        break;
+    }
+    if (j < inputs)
+      break;
+  }
+
+  return i;
+}
+
+static float input_target(const struct fand_policy *p, int i) {
+  switch (p->type) {
+  case FAND_POLICY_LEVELS:
+    return p->temp_top;
+  case FAND_POLICY_MAP:
+    return p->map[i][p->map_size[i] - 1].temp;
+  case FAND_POLICY_RISE_FALL:
+    return p->map[0][p->map_size[0] - 1].temp;
+  }
+  return 0;
+}
+
+static int run(const struct fand_policy *p, const struct sim_profile *prof,
+               const struct sim_opts *o) {
+  struct load_step steps[MAX_STEPS];
+  struct fand_policy_state st;
+  struct sample *s;
+  int *speed;
+  int nsteps = 1, step = 0, pos = 0, cycles, c, i, limit, changes = 0;
+  int shutdown = -1, react_n = 0;
+  float node, t, load, cooling, power = 0, react_sum = 0, react_max = 0;
+  float settle_sum = 0, settle_max = 0, peak, over, target;
+  long long t0, cost, cost_sum = 0, cost_max = 0;
+  bool reacted = true;
+
+  steps[0].time = 0;
+  steps[0].load = 0;
+  if (!o->trace) {
+    nsteps = parse_load(o->load ? o->load : prof->load, steps);
+    if (nsteps < 0) {
+      fprintf(stderr, "bad load profile\n");
+      return -1;
+    }
+  }
+
+  cycles = o->trace ?
+           (int)((trace[trace_len - 1].time - trace[0].time) / o->interval) + 1 :
+           o->cycles;
+  s = (struct sample *)calloc(cycles, sizeof(*s));
+  speed = (int *)calloc(cycles, sizeof(*speed));
+  if (!s || !speed) {
+    free(s);
+    free(speed);
+    return -1;
+  }
+
+  /* fand starts on high (medium on galaxy100) and lets the policy settle */
+  fand_policy_init(p, &st, p->type == FAND_POLICY_RISE_FALL ? p->medium : p->high);
+  node = o->ambient + steps[0].load /
+         (o->min_cooling + (1 - o->min_cooling) * st.speed / 100.0);
+
+  for (c = 0; c < cycles; c++) {
+    t = c * o->interval;
+    if (o->trace) {
+      s[c] = *trace_at(trace[0].time + t, &pos);
+      s[c].time = t;
+    } else {
+      while (step + 1 < nsteps && steps[step + 1].time <= t) {
+        step++;
+        reacted = false;
+      }
+      load = steps[step].load;
+      cooling = o->min_cooling + (1 - o->min_cooling) * st.speed / 100.0;
+      node += (o->ambient + load / cooling - node) *
+              (1 - expf(-o->interval / o->tau));
+      s[c].time = t;
+      for (i = 0; i < FAND_POLICY_INPUTS; i++) {
+        s[c].temp[i] = o->ambient + prof->gain[i] * (node - o->ambient) +
+                       prof->offset[i];
+      }
+    }
+
+    limit = fand_policy_over_limit(p, s[c].temp);
+    if (limit >= 0 && shutdown < 0)
+      shutdown = c;
+
+    t0 = now_ns();
+    fand_policy_step(p, &st, s[c].temp, 0);
+    cost = now_ns() - t0;
+    cost_sum += cost;
+    if (cost > cost_max)
+      cost_max = cost;
+
+    speed[c] = st.speed;
+    if (c && speed[c] != speed[c - 1]) {
+      changes++;
+      if (!reacted) {
+        float latency = t - steps[step].time;
+
+        react_sum += latency;
+        if (latency > react_max)
+          react_max = latency;
+        react_n++;
+        reacted = true;
+      }
+    }
+    power += powf(speed[c] / 100.0, 3);
+
+    if (o->dump) {
+      printf("%.0f,%d", t, speed[c]);
+      for (i = 0; i < p->inputs; i++) {
+        printf(",%.2f", s[c].temp[i]);
+      }
+      printf("\n");
+    }
+  }
+
+  printf("# policy        %s\n", p->name);
+  printf("# cycles        %d x %.0fs, %s\n", cycles, o->interval,
+         o->trace ? o->trace : "thermal model");
+  printf("# fan power     %.1f%% of full speed, %.3f full speed hours\n",
+         power * 100 / cycles, power * o->interval / 3600);
+  printf("# speed changes %d, final speed %d%%\n", changes, speed[cycles - 1]);
+
+  for (i = 0; i < p->inputs; i++) {
+    target = input_target(p, i);
+    peak = s[0].temp[i];
+    over = 0;
+    for (c = 0; c < cycles; c++) {
+      if (s[c].temp[i] > peak)
+        peak = s[c].temp[i];
+      if (s[c].temp[i] > target)
+        over += o->interval;
+    }
+    printf("# %-13s peak %.1fC, %.1fC over %.0fC, %.0fs over\n",
+           p->input[i], peak, peak > target ? peak - target : 0, target, over);
+  }
+
+  for (step = 0; step < nsteps; step++) {
+    int from = (int)ceilf(steps[step].time / o->interval);
+    int end = (step + 1 < nsteps) ?
+              (int)ceilf(steps[step + 1].time / o->interval) : cycles;
+    float settle;
+
+    if (from >= end || end > cycles)
+      continue;
+    settle = (settle_cycle(s, speed, from, end, p->inputs, o->band) - from) *
+             o->interval;
+    settle_sum += settle;
+    if (settle > settle_max)
+      settle_max = settle;
+  }
+  printf("# settling      max %.0fs, mean %.0fs over %d steps, %.1fC band\n",
+         settle_max, settle_sum / nsteps, nsteps, o->band);
+  if (react_n)
+    printf("# reaction      max %.0fs, mean %.0fs to the first speed change\n",
+           react_max, react_sum / react_n);
+  printf("# step cost     mean %.2fus, max %.2fus\n",
+         cost_sum / 1000.0 / cycles, cost_max / 1000.0);
+  if (shutdown >= 0)
+    printf("# shutdown      at %.0fs\n", s[shutdown].time);
+
+  free(s);
+  free(speed);
+  return 0;
+}
+
+int main(int argc, char **argv) {
+  struct sim_opts o = {720, 5, NAN, 120, 0.2, 1, false, NULL, NULL,
+                       -1, -1, -1, -1, -1};
+  const struct sim_profile *prof;
+  const struct fand_policy *base;
+  struct fand_policy p;
+  char *policies = NULL, *name, *save;
+  int opt, i;
+
+  while ((opt = getopt(argc, argv, "p:f:n:i:a:L:k:g:s:l:m:h:b:t:d")) != -1) {
+    switch (opt) {
+    case 'p':
+      policies = optarg;
+      break;
+    case 'f':
+      o.trace = optarg;
+      break;
+    case 'n':
+      o.cycles = atoi(optarg);
+      break;
+    case 'i':
+      o.interval = atof(optarg);
+      break;
+    case 'a':
+      o.ambient = atof(optarg);
+      break;
+    case 'L':
+      o.load = optarg;
+      break;
+    case 'k':
+      o.tau = atof(optarg);
+      break;
+    case 'g':
+      o.min_cooling = atof(optarg);
+      break;
+    case 's':
+      o.band = atof(optarg);
+      break;
+    case 'l':
+      o.low = atoi(optarg);
+      break;
+    case 'm':
+      o.medium = atoi(optarg);
+      break;
+    case 'h':
+      o.high = atoi(optarg);
+      break;
+    case 'b':
+      o.bottom = atoi(optarg);
+      break;
+    case 't':
+      o.top = atoi(optarg);
+      break;
+    case 'd':
+      o.dump = true;
+      break;
+    default:
+      usage();
+      break;
+    }
+  }
+
+  if (!policies || o.cycles <= 0 || o.interval <= 0 || o.tau <= 0 ||
+      o.min_cooling <= 0 || o.min_cooling > 1) {
+    usage();
+  }
+
+  if (!strcmp(policies, "list")) {
+    for (i = 0; (base = fand_policy_get(i)); i++) {
+      printf("%s\n", base->name);
+    }
+    return 0;
+  }
+
+  if (o.trace && read_trace(o.trace))
+    return 1;
+
+  for (name = strtok_r(policies, ",", &save); name;
+       name = strtok_r(NULL, ",", &save)) {
+    base = fand_policy_find(name);
+    prof = find_profile(name);
+    if (!base || !prof) {
+      fprintf(stderr, "no policy %s\n", name);
+      return 1;
+    }
+
+    p = *base;
+    if (o.low >= 0)
+      p.low = o.low;
+    if (o.medium >= 0)
+      p.medium = o.medium;
+    if (o.high >= 0)
+      p.high = o.high;
+    if (o.bottom >= 0)
+      p.temp_bottom = o.bottom;
+    if (o.top >= 0)
+      p.temp_top = o.top;
+
+    struct sim_opts ro = o;
+    if (isnan(ro.ambient))
+      ro.ambient = prof->ambient;
+    if (run(&p, prof, &ro))
+      return 1;
+  }
+
+  return 0;
+}
@@ -68,6 +68,7 @@
 #endif
 
 #include "watchdog.h"
+#include "fand_policy.h"
 
 #if !defined(CONFIG_LIGHTNING)
 /* Sensor definitions */
@@ -195,40 +196,21 @@ const char *fan_led[] = {FAN0_LED, FAN1_LED, FAN2_LED, FAN3_LED,
 
 /* Sensor limits and tuning parameters */
 
-#define INTAKE_LIMIT INTERNAL_TEMPS(60)
-#define SWITCH_LIMIT INTERNAL_TEMPS(80)
-#if defined(CONFIG_YOSEMITE)
-#define USERVER_LIMIT INTERNAL_TEMPS(110)
-#else
-#define USERVER_LIMIT INTERNAL_TEMPS(90)
-#endif
-
-#define TEMP_TOP INTERNAL_TEMPS(70)
-#define TEMP_BOTTOM INTERNAL_TEMPS(40)
-
 /*
- * Toggling the fan constantly will wear it out (and annoy anyone who
- * can hear it), so we'll only turn down the fan after the temperature
- * has dipped a bit below the point at which we'd otherwise switch
- * things up.
+ * Speeds, thresholds and limits of the other sensors are in the control
+ * policy, see fand_policy.cpp.
  */
 
-#define COOLDOWN_SLOP INTERNAL_TEMPS(6)
+#define INTAKE_LIMIT INTERNAL_TEMPS(60)
 
-#define WEDGE_FAN_LOW 35
-#define WEDGE_FAN_MEDIUM 50
-#define WEDGE_FAN_HIGH 70
 #if defined(CONFIG_WEDGE100)
-#define WEDGE_FAN_MAX 100
-#else
-#define WEDGE_FAN_MAX 99
+#define FAND_POLICY "wedge100"
+#elif defined(CONFIG_WEDGE)
+#define FAND_POLICY "wedge"
+#elif defined(CONFIG_YOSEMITE)
+#define FAND_POLICY "yosemite"
 #endif
 
-#define SIXPACK_FAN_LOW 35
-#define SIXPACK_FAN_MEDIUM 55
-#define SIXPACK_FAN_HIGH 75
-#define SIXPACK_FAN_MAX 99
-
 /*
  * Mapping physical to hardware addresses for fans;  it's different for
  * RPM measuring and PWM setting, naturally.  Doh.
@@ -370,61 +352,20 @@ struct rpm_to_pct_map *rpm_rear_map = rpm_map;
 
 #endif
 
-/*
- * Mappings from temperatures recorded from sensors to fan speeds;
- * note that in some cases, we want to be able to look at offsets
- * from the CPU temperature margin rather than an absolute temperature,
- * so we use ints.
- */
-
-struct temp_to_pct_map {
-  int temp;
-  unsigned speed;
-};
-
-#if defined(CONFIG_YOSEMITE)
-struct temp_to_pct_map intake_map[] = {{25, 15},
-                                       {27, 16},
-                                       {29, 17},
-                                       {31, 18},
-                                       {33, 19},
-                                       {35, 20},
-                                       {37, 21},
-                                       {39, 22},
-                                       {41, 23},
-                                       {43, 24},
-                                       {45, 25}};
-#define INTAKE_MAP_SIZE (sizeof(intake_map) / sizeof(struct temp_to_pct_map))
-
-struct temp_to_pct_map cpu_map[] = {{-28, 10},
-                                    {-26, 20},
-                                    {-24, 25},
-                                    {-22, 30},
-                                    {-20, 35},
-                                    {-18, 40},
-                                    {-16, 45},
-                                    {-14, 50},
-                                    {-12, 55},
-                                    {-10, 60},
-                                    {-8, 65},
-                                    {-6, 70},
-                                    {-4, 80},
-                                    {-2, 100}};
-#define CPU_MAP_SIZE (sizeof(cpu_map) / sizeof(struct temp_to_pct_map))
-#endif
-
-
 #define FAN_FAILURE_OFFSET 30
 
-int fan_low = WEDGE_FAN_LOW;
-int fan_medium = WEDGE_FAN_MEDIUM;
-int fan_high = WEDGE_FAN_HIGH;
-int fan_max = WEDGE_FAN_MAX;
+struct fand_policy policy;
+
+/* Defaults from the policy, which the options may override */
+int fan_low;
+int fan_medium;
+int fan_high;
+int fan_max;
 int total_fans = FANS;
 int fan_offset = 0;
 
-int temp_bottom = TEMP_BOTTOM;
-int temp_top = TEMP_TOP;
+int temp_bottom;
+int temp_top;
 
 int report_temp = REPORT_TEMP;
 bool verbose = false;
@@ -800,16 +741,15 @@ int write_fan_speed(const int fan, const int value) {
   }
 }
 
-#if defined(CONFIG_YOSEMITE)
-int temp_to_fan_speed(int temp, struct temp_to_pct_map *map, int map_size) {
-  int i = map_size - 1;
-
-  while (i > 0 && temp < map[i].temp) {
-    --i;
-  }
-  return map[i].speed;
+void set_policy(const char *name) {
+  policy = *fand_policy_find(name);
+  fan_low = policy.low;
+  fan_medium = policy.medium;
+  fan_high = policy.high;
+  fan_max = policy.max;
+  temp_bottom = INTERNAL_TEMPS(policy.temp_bottom);
+  temp_top = INTERNAL_TEMPS(policy.temp_top);
 }
-#endif
 
 /* Set up fan LEDs */
 
@@ -913,7 +853,11 @@ int main(int argc, char **argv) {
   float userver_temp;
 #endif
 
-  int fan_speed = fan_high;
+  int fan_speed;
+  struct fand_policy_state state;
+  float temps[FAND_POLICY_INPUTS];
+  int limit;
+  char why[64];
   int bad_reads = 0;
   int fan_failure = 0;
   int fan_speed_changes = 0;
@@ -928,6 +872,10 @@ int main(int argc, char **argv) {
 
   struct sigaction sa;
 
+  // The signal handler runs the fans at fan_max
+  set_policy(FAND_POLICY);
+  fan_speed = fan_high;
+
   sa.sa_handler = fand_interrupt;
   sa.sa_flags = 0;
   sigemptyset(&sa.sa_mask);
@@ -946,10 +894,7 @@ int main(int argc, char **argv) {
     total_fans = 2;
     fan_offset = 2; /* fan 3 is the first */
 
-    fan_low = SIXPACK_FAN_LOW;
-    fan_medium = SIXPACK_FAN_MEDIUM;
-    fan_high = SIXPACK_FAN_HIGH;
-    fan_max = SIXPACK_FAN_MAX;
+    set_policy("sixpack");
     fan_speed = fan_high;
   }
 #endif
@@ -1004,6 +949,14 @@ int main(int argc, char **argv) {
             fan_high);
   }
 
+  policy.low = fan_low;
+  policy.medium = fan_medium;
+  policy.high = fan_high;
+  policy.max = fan_max;
+  policy.temp_bottom = EXTERNAL_TEMPS(temp_bottom);
+  policy.temp_top = EXTERNAL_TEMPS(temp_top);
+  fand_policy_init(&policy, &state, fan_speed);
+
   daemon(1, 0);
 
   if (verbose) {
@@ -1048,7 +1001,6 @@ int main(int argc, char **argv) {
   sleep(5);  /* Give the fans time to come up to speed */
 
   while (1) {
-    int max_temp;
     old_speed = fan_speed;
 
     /* Read sensors */
@@ -1125,12 +1077,14 @@ int main(int argc, char **argv) {
     }
 
 #if defined(CONFIG_WEDGE) || defined(CONFIG_WEDGE100)
-    if (switch_temp > SWITCH_LIMIT) {
-      server_shutdown("T2 temp limit reached");
-    }
+    temps[0] = EXTERNAL_TEMPS((float)switch_temp);
+#else
+    temps[0] = intake_temp;
 #endif
+    temps[1] = EXTERNAL_TEMPS((float)(userver_temp + USERVER_TEMP_FUDGE));
 
-    if (userver_temp + USERVER_TEMP_FUDGE > USERVER_LIMIT) {
+    limit = fand_policy_over_limit(&policy, temps);
+    if (limit >= 0) {
       syslog(LOG_DEBUG,
 #if defined(CONFIG_WEDGE) || defined(CONFIG_WEDGE100)
              "Temp intake %d, switch %d, "
@@ -1149,7 +1103,8 @@ int main(int argc, char **argv) {
              fan_speed,
              fan_speed_changes);
 
-      server_shutdown("uServer temp limit reached");
+      snprintf(why, sizeof(why), "%s temp limit reached", policy.input[limit]);
+      server_shutdown(why);
     }
 
     /*
@@ -1158,56 +1113,12 @@ int main(int argc, char **argv) {
      *
      * We should use the intake temperature to adjust this
      * as well.
+     *
+     * fan_speed is also run up to fan_max below when fans fail.
      */
 
-#if defined(CONFIG_YOSEMITE)
-    /* Use tables to lookup the new fan speed for Yosemite. */
-
-    int intake_speed = temp_to_fan_speed(intake_temp, intake_map,
-                                         INTAKE_MAP_SIZE);
-    int cpu_speed = temp_to_fan_speed(userver_temp, cpu_map, CPU_MAP_SIZE);
-
-    if (fan_speed == fan_max && fan_failure != 0) {
-      /* Don't change a thing */
-    } else if (intake_speed > cpu_speed) {
-      fan_speed = intake_speed;
-    } else {
-      fan_speed = cpu_speed;
-    }
-#else
-    /* Other systems use a simpler built-in table to determine fan speed. */
-
-    if (switch_temp > userver_temp + USERVER_TEMP_FUDGE) {
-      max_temp = switch_temp;
-    } else {
-      max_temp = userver_temp + USERVER_TEMP_FUDGE;
-    }
-
-    /*
-     * If recovering from a fan problem, spin down fans gradually in case
-     * temperatures are still high. Gradual spin down also reduces wear on
-     * the fans.
-     */
-    if (fan_speed == fan_max) {
-      if (fan_failure == 0) {
-        fan_speed = fan_high;
-      }
-    } else if (fan_speed == fan_high) {
-      if (max_temp + COOLDOWN_SLOP < temp_top) {
-        fan_speed = fan_medium;
-      }
-    } else if (fan_speed == fan_medium) {
-      if (max_temp > temp_top) {
-        fan_speed = fan_high;
-      } else if (max_temp + COOLDOWN_SLOP < temp_bottom) {
-        fan_speed = fan_low;
-      }
-    } else {/* low */
-      if (max_temp > temp_bottom) {
-        fan_speed = fan_medium;
-      }
-    }
-#endif
+    state.speed = fan_speed;
+    fan_speed = fand_policy_step(&policy, &state, temps, fan_failure);
 
     /*
      * Update fans only if there are no failed ones. If any fans failed
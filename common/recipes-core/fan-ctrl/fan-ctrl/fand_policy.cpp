@@ -0,0 +1,279 @@
+/*
+ * Copyright 2017-present Facebook. All Rights Reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+/* Yeah, the file ends in .cpp, but it's a C program.  Deal. */
+
+#include <stdio.h>
+#include <string.h>
+#include "fand_policy.h"
+
+#define MAP_SIZE(m) (sizeof(m) / sizeof(struct temp_to_pct_map))
+
+/* Yosemite */
+static const struct temp_to_pct_map intake_map[] = {{25, 15},
+                                                    {27, 16},
+                                                    {29, 17},
+                                                    {31, 18},
+                                                    {33, 19},
+                                                    {35, 20},
+                                                    {37, 21},
+                                                    {39, 22},
+                                                    {41, 23},
+                                                    {43, 24},
+                                                    {45, 25}};
+
+static const struct temp_to_pct_map cpu_map[] = {{-28, 10},
+                                                 {-26, 20},
+                                                 {-24, 25},
+                                                 {-22, 30},
+                                                 {-20, 35},
+                                                 {-18, 40},
+                                                 {-16, 45},
+                                                 {-14, 50},
+                                                 {-12, 55},
+                                                 {-10, 60},
+                                                 {-8, 65},
+                                                 {-6, 70},
+                                                 {-4, 80},
+                                                 {-2, 100}};
+
+/* Galaxy100 CMM */
+static const struct temp_to_pct_map galaxy100_raising_map[] = {{0, 32},
+                                                               {31, 51},
+                                                               {36, 72}};
+
+static const struct temp_to_pct_map galaxy100_falling_map[] = {{0, 32},
+                                                               {27, 51},
+                                                               {33, 72}};
+
+/*
+ * Wedge and its relatives keep to three speeds. Toggling the fan
+ * constantly will wear it out (and annoy anyone who can hear it), so
+ * we'll only turn down the fan after the temperature has dipped a bit
+ * below the point at which we'd otherwise switch things up.
+ *
+ * The uServer input of wedge* and sixpack includes the 10C fudge for its
+ * sensor not being on the CPU; on yosemite it is the thermal margin.
+ */
+static const struct fand_policy policies[] = {
+  {
+    .name = "wedge",
+    .type = FAND_POLICY_LEVELS,
+    .inputs = 2,
+    .input = {"T2", "uServer"},
+    .low = 35,
+    .medium = 50,
+    .high = 70,
+    .max = 99,
+    .temp_bottom = 40,
+    .temp_top = 70,
+    .slop = 6,
+    .map = {NULL, NULL},
+    .map_size = {0, 0},
+    .start_temp = 0,
+    .limit = {80, 90},
+  },
+  {
+    .name = "sixpack",
+    .type = FAND_POLICY_LEVELS,
+    .inputs = 2,
+    .input = {"T2", "uServer"},
+    .low = 35,
+    .medium = 55,
+    .high = 75,
+    .max = 99,
+    .temp_bottom = 40,
+    .temp_top = 70,
+    .slop = 6,
+    .map = {NULL, NULL},
+    .map_size = {0, 0},
+    .start_temp = 0,
+    .limit = {80, 90},
+  },
+  {
+    .name = "wedge100",
+    .type = FAND_POLICY_LEVELS,
+    .inputs = 2,
+    .input = {"T2", "uServer"},
+    .low = 35,
+    .medium = 50,
+    .high = 70,
+    .max = 100,
+    .temp_bottom = 40,
+    .temp_top = 70,
+    .slop = 6,
+    .map = {NULL, NULL},
+    .map_size = {0, 0},
+    .start_temp = 0,
+    .limit = {80, 90},
+  },
+  {
+    .name = "yosemite",
+    .type = FAND_POLICY_MAP,
+    .inputs = 2,
+    .input = {"Intake", "uServer"},
+    .low = 35,
+    .medium = 50,
+    .high = 70,
+    .max = 99,
+    .temp_bottom = 0,
+    .temp_top = 0,
+    .slop = 0,
+    .map = {intake_map, cpu_map},
+    .map_size = {MAP_SIZE(intake_map), MAP_SIZE(cpu_map)},
+    .start_temp = 0,
+    .limit = {60, 110},
+  },
+  {
+    .name = "galaxy100",
+    .type = FAND_POLICY_RISE_FALL,
+    .inputs = 1,
+    .input = {"Critical", NULL},
+    .low = 32,
+    .medium = 51,
+    .high = 72,
+    .max = 99,
+    .temp_bottom = 0,
+    .temp_top = 0,
+    .slop = 0,
+    .map = {galaxy100_raising_map, galaxy100_falling_map},
+    .map_size = {MAP_SIZE(galaxy100_raising_map), MAP_SIZE(galaxy100_falling_map)},
+    .start_temp = 36,
+    .limit = {60, 0},
+  },
+};
+
+#define POLICIES (sizeof(policies) / sizeof(policies[0]))
+
+const struct fand_policy *fand_policy_find(const char *name) {
+  int i;
+
+  for (i = 0; i < (int)POLICIES; i++) {
+    if (!strcmp(policies[i].name, name))
+      return &policies[i];
+  }
+  return NULL;
+}
+
+const struct fand_policy *fand_policy_get(int i) {
+  if (i < 0 || i >= (int)POLICIES)
+    return NULL;
+  return &policies[i];
+}
+
+int temp_to_fan_speed(int temp, const struct temp_to_pct_map *map,
+                      int map_size) {
+  int i = map_size - 1;
+
+  while (i > 0 && temp < map[i].temp) {
+    --i;
+  }
+  return map[i].speed;
+}
+
+void fand_policy_init(const struct fand_policy *p,
+                      struct fand_policy_state *st, int speed) {
+  st->speed = speed;
+  st->last_temp = p->start_temp;
+}
+
+static int levels_step(const struct fand_policy *p, int speed, float temp,
+                       int fan_failures) {
+  /*
+   * If recovering from a fan problem, spin down fans gradually in case
+   * temperatures are still high. Gradual spin down also reduces wear on
+   * the fans.
+   */
+  if (speed == p->max) {
+    if (fan_failures == 0) {
+      speed = p->high;
+    }
+  } else if (speed == p->high) {
+    if (temp + p->slop < p->temp_top) {
+      speed = p->medium;
+    }
+  } else if (speed == p->medium) {
+    if (temp > p->temp_top) {
+      speed = p->high;
+    } else if (temp + p->slop < p->temp_bottom) {
+      speed = p->low;
+    }
+  } else {/* low */
+    if (temp > p->temp_bottom) {
+      speed = p->medium;
+    }
+  }
+
+  return speed;
+}
+
+int fand_policy_step(const struct fand_policy *p,
+                     struct fand_policy_state *st, const float *temps,
+                     int fan_failures) {
+  float max_temp = temps[0];
+  int i, raising, falling, speed;
+
+  for (i = 1; i < p->inputs; i++) {
+    if (temps[i] > max_temp)
+      max_temp = temps[i];
+  }
+
+  switch (p->type) {
+  case FAND_POLICY_LEVELS:
+    st->speed = levels_step(p, st->speed, max_temp, fan_failures);
+    break;
+
+  case FAND_POLICY_MAP:
+    if (st->speed == p->max && fan_failures != 0) {
+      /* Don't change a thing */
+      break;
+    }
+    st->speed = 0;
+    for (i = 0; i < p->inputs; i++) {
+      speed = temp_to_fan_speed((int)temps[i], p->map[i], p->map_size[i]);
+      if (speed > st->speed)
+        st->speed = speed;
+    }
+    break;
+
+  case FAND_POLICY_RISE_FALL:
+    raising = temp_to_fan_speed((int)temps[0], p->map[0], p->map_size[0]);
+    falling = temp_to_fan_speed((int)temps[0], p->map[1], p->map_size[1]);
+    if (st->last_temp <= temps[0]) {
+      if (raising >= st->speed)
+        st->speed = raising;
+    } else {
+      if (falling <= st->speed)
+        st->speed = falling;
+    }
+    st->last_temp = temps[0];
+    break;
+  }
+
+  return st->speed;
+}
+
+int fand_policy_over_limit(const struct fand_policy *p, const float *temps) {
+  int i;
+
+  for (i = 0; i < p->inputs; i++) {
+    if (temps[i] > p->limit[i])
+      return i;
+  }
+  return -1;
+}
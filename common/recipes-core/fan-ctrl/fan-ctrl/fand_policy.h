@@ -0,0 +1,94 @@
+/*
+ * Copyright 2017-present Facebook. All Rights Reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+#ifndef __FAND_POLICY_H__
+#define __FAND_POLICY_H__
+
+/*
+ * Fan control policy, kept apart from the sensors and fans it drives so
+ * that fand and fand-sim run the same code. The caller reads its sensors
+ * into control temperatures, in degrees C, and hands them to
+ * fand_policy_step() with the number of failed fans; it gets back the
+ * speed, in percent, to write to the fans.
+ */
+
+#define FAND_POLICY_INPUTS 2
+
+/*
+ * Mappings from temperatures recorded from sensors to fan speeds;
+ * note that in some cases, we want to be able to look at offsets
+ * from the CPU temperature margin rather than an absolute temperature,
+ * so we use ints.
+ */
+struct temp_to_pct_map {
+  int temp;
+  unsigned speed;
+};
+
+enum fand_policy_type {
+  FAND_POLICY_LEVELS,     /* low/medium/high around a bottom and top temp */
+  FAND_POLICY_MAP,        /* the highest speed any input maps to */
+  FAND_POLICY_RISE_FALL,  /* one map while heating up, another cooling down */
+};
+
+struct fand_policy {
+  const char *name;
+  enum fand_policy_type type;
+  int inputs;             /* control temperatures passed to a step */
+  const char *input[FAND_POLICY_INPUTS];  /* their names, for logs */
+  int low;                /* fan speeds, percent */
+  int medium;
+  int high;
+  int max;
+  /* FAND_POLICY_LEVELS, on the hottest input */
+  int temp_bottom;
+  int temp_top;
+  int slop;               /* extra drop needed before slowing down */
+  /*
+   * FAND_POLICY_MAP: map[i] is for input i.
+   * FAND_POLICY_RISE_FALL: map[0] rising, map[1] falling, on input 0.
+   */
+  const struct temp_to_pct_map *map[FAND_POLICY_INPUTS];
+  int map_size[FAND_POLICY_INPUTS];
+  int start_temp;         /* FAND_POLICY_RISE_FALL: temp before the first step */
+  int limit[FAND_POLICY_INPUTS];  /* shut down above these, per input */
+};
+
+struct fand_policy_state {
+  int speed;
+  float last_temp;
+};
+
+/* Built in policies by name, e.g. "wedge100"; NULL if there is none */
+const struct fand_policy *fand_policy_find(const char *name);
+/* The i-th built in policy, NULL past the last */
+const struct fand_policy *fand_policy_get(int i);
+
+void fand_policy_init(const struct fand_policy *p,
+                      struct fand_policy_state *st, int speed);
+/* New fan speed for the control temperatures of this cycle */
+int fand_policy_step(const struct fand_policy *p,
+                     struct fand_policy_state *st, const float *temps,
+                     int fan_failures);
+/* Index of the first input above its limit, -1 if none is */
+int fand_policy_over_limit(const struct fand_policy *p, const float *temps);
+
+/* Speed of the last entry at or below temp, or of the first entry */
+int temp_to_fan_speed(int temp, const struct temp_to_pct_map *map,
+                      int map_size);
+
+#endif /* __FAND_POLICY_H__ */
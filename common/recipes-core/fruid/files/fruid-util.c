@@ -113,14 +113,14 @@ print_fruid_info(fruid_info_t *fruid, const char *name)
 void get_fruid_info(uint8_t fru, char *path, char* name) {
   int ret;
   fruid_info_t fruid;
+  fruid_compact_t rec;
 
-  ret = fruid_parse(path, &fruid);
+  ret = fruid_parse_cached(path, &rec, &fruid);
   if (ret) {
     fprintf(stderr, "Failed print FRUID for %s\nCheck syslog for errors!\n",
         name);
   } else {
     print_fruid_info(&fruid, name);
-    free_fruid_info(&fruid);
   }
 
 }
@@ -266,6 +266,7 @@ int main(int argc, char * argv[]) {
         syslog(LOG_CRIT, "New FRU data checksum is invalid");
         return -1;
       }
+      free_fruid_info(&fruid);
 
       fd_tmpbin = open(path, O_WRONLY);
       if (fd_tmpbin == -1) {
@@ -16,9 +16,18 @@
 # Boston, MA 02110-1301 USA
 #
 
+import sys
 import syslog
 import logging
 
+# The debug card reads critical events off the event bus, on platforms
+# that have one
+try:
+    sys.path.append('/usr/local/fbpackages/log-util')
+    import lib_evbus
+except Exception:
+    lib_evbus = None
+
 
 def clamp(v, minv, maxv):
     if v <= minv:
@@ -60,6 +69,9 @@ class Logger(object):
     def usbdbg(msg):
         # print("USBDBG: " + msg)
         syslog.syslog((syslog.LOG_LOCAL0 | syslog.LOG_ERR), msg)
+        if lib_evbus:
+            lib_evbus.evbus_publish(lib_evbus.EVBUS_T_CRI_SEL, 0,
+                                    syslog.LOG_ERR, msg)
 
     @staticmethod
     def start(name):
@@ -117,6 +117,9 @@ static int i2c_slave_read(int fd, uint8_t *buf, uint8_t *len);
 static int i2c_slave_open(uint8_t bus_num);
 static int bic_up_flag = 0;
 
+// Request trace ring, written while ipmi-util --trace turns it on
+static ipmi_trace_t *g_trace;
+
 
 #ifdef CONFIG_YOSEMITE
 // Returns the payload ID from IPMB bus routing
@@ -775,6 +778,7 @@ void
   unsigned char res_buf[MAX_IPMB_RES_LEN];
   unsigned char res_len = 0;
   struct timeval tv;
+  uint64_t start;
 
   // setup timeout for receving on socket
   tv.tv_sec = TIMEOUT_IPMB;
@@ -794,7 +798,9 @@ void
 	}
   }
 
+  start = ipmi_trace_start(g_trace);
   ipmb_handle(fd, req_buf, n, res_buf, &res_len);
+  ipmi_trace_end(g_trace, start, req_buf, n, res_buf, res_len);
 
   if (send(sock, res_buf, res_len, MSG_NOSIGNAL) < 0) {
 #ifdef DEBUG
@@ -820,6 +826,7 @@ ipmb_lib_handler(void *bus_num) {
   int fd;
   uint8_t *bnum = (uint8_t*) bus_num;
   char sock_path[20] = {0};
+  char trace_name[16];
   int rc = 0;
   pthread_attr_t attr;
 
@@ -851,6 +858,8 @@ ipmb_lib_handler(void *bus_num) {
   }
 
   sprintf(sock_path, "%s_%d", SOCK_PATH_IPMB, *bnum);
+  sprintf(trace_name, "ipmbd_%d", *bnum);
+  g_trace = ipmi_trace_open(trace_name, sock_path);
 
   local.sun_family = AF_UNIX;
   strcpy (local.sun_path, sock_path);
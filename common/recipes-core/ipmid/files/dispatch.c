@@ -0,0 +1,276 @@
+/*
+ *
+ * Copyright 2017-present Facebook. All Rights Reserved.
+ *
+ * This file routes IPMI requests to the handler registered for their
+ * (NetFn, Cmd) and keeps per-command counters and latency histograms.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <syslog.h>
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <openbmc/ipmi.h>
+#include "dispatch.h"
+
+#define NUM_NETFN   64
+#define NUM_CMD     256
+
+#define SIZE_IANA_ID 3
+
+struct cmd_entry {
+  const ipmi_cmd_t *desc;     // NULL for commands served by the fallback
+  ipmi_cmd_fn fn;
+  pthread_mutex_t *lock;      // NULL for LOCK_NONE
+  pthread_mutex_t cmd_lock;
+  ipmi_cmd_stats_t *stats;    // NULL once the stats page is full
+};
+
+struct netfn_entry {
+  unsigned char flags;
+  ipmi_cmd_fn fallback;
+  pthread_mutex_t lock;
+  struct cmd_entry *cmds[NUM_CMD];
+};
+
+/*
+ * The tables are filled in before ipmid accepts connections, except for
+ * the entries of commands sent to a fallback, which are added on first use
+ * under m_stats.
+ */
+static struct netfn_entry *g_netfn[NUM_NETFN];
+
+// Serializes stats updates; readers use the sequence count instead
+static pthread_mutex_t m_stats = PTHREAD_MUTEX_INITIALIZER;
+static ipmi_stats_t g_local_stats;
+static ipmi_stats_t *g_stats = &g_local_stats;
+
+static uint64_t
+now_us(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+// Called with m_stats held
+static ipmi_cmd_stats_t *
+stats_alloc(unsigned char netfn, unsigned char cmd, const char *name) {
+  ipmi_cmd_stats_t *st;
+
+  if (g_stats->num_cmds >= IPMI_STATS_MAX_CMDS)
+    return NULL;
+
+  st = &g_stats->cmd[g_stats->num_cmds];
+  memset(st, 0, sizeof(*st));
+  st->netfn = netfn;
+  st->cmd = cmd;
+  if (name)
+    strncpy(st->name, name, sizeof(st->name) - 1);
+  __sync_synchronize();
+  g_stats->num_cmds++;
+  return st;
+}
+
+static void
+stats_update(struct cmd_entry *ent, unsigned char cc, uint32_t us) {
+  ipmi_cmd_stats_t *st = ent->stats;
+  uint32_t v;
+  int b;
+
+  if (!st)
+    return;
+
+  for (b = 0, v = us / IPMI_STATS_HIST_BASE_US;
+       v && b < IPMI_STATS_HIST_BUCKETS - 1; v >>= 1)
+    b++;
+
+  pthread_mutex_lock(&m_stats);
+  g_stats->seq++;
+  __sync_synchronize();
+  st->count++;
+  if (cc != CC_SUCCESS)
+    st->errors++;
+  st->total_us += us;
+  if (us > st->max_us)
+    st->max_us = us;
+  st->hist[b]++;
+  __sync_synchronize();
+  g_stats->seq++;
+  pthread_mutex_unlock(&m_stats);
+}
+
+static void
+stats_unknown(void) {
+  pthread_mutex_lock(&m_stats);
+  g_stats->unknown++;
+  pthread_mutex_unlock(&m_stats);
+}
+
+// Entry for a command without one of its own, created on first use
+static struct cmd_entry *
+fallback_entry(struct netfn_entry *nf, unsigned char netfn, unsigned char cmd) {
+  struct cmd_entry *ent;
+
+  pthread_mutex_lock(&m_stats);
+  ent = nf->cmds[cmd];
+  if (!ent) {
+    ent = calloc(1, sizeof(*ent));
+    if (ent) {
+      ent->fn = nf->fallback;
+      ent->stats = stats_alloc(netfn, cmd, NULL);
+      __sync_synchronize();
+      nf->cmds[cmd] = ent;
+    }
+  }
+  pthread_mutex_unlock(&m_stats);
+
+  return ent;
+}
+
+int
+ipmi_dispatch_register(unsigned char netfn, unsigned char flags,
+                       const ipmi_cmd_t *cmds, int num, ipmi_cmd_fn fallback) {
+  struct netfn_entry *nf;
+  struct cmd_entry *ent;
+  int i;
+
+  if (netfn >= NUM_NETFN || g_netfn[netfn])
+    return -1;
+
+  nf = calloc(1, sizeof(*nf));
+  if (!nf)
+    return -1;
+  nf->flags = flags;
+  nf->fallback = fallback;
+  pthread_mutex_init(&nf->lock, NULL);
+
+  for (i = 0; i < num; i++) {
+    if (nf->cmds[cmds[i].cmd]) {
+      syslog(LOG_WARNING, "%s: NetFn 0x%02x Cmd 0x%02x registered twice",
+             __func__, netfn, cmds[i].cmd);
+      continue;
+    }
+    ent = calloc(1, sizeof(*ent));
+    if (!ent)
+      return -1;
+    ent->desc = &cmds[i];
+    ent->fn = cmds[i].fn;
+    switch (cmds[i].lock) {
+      case LOCK_CMD:
+        pthread_mutex_init(&ent->cmd_lock, NULL);
+        ent->lock = &ent->cmd_lock;
+        break;
+      case LOCK_NONE:
+        ent->lock = NULL;
+        break;
+      default:
+        ent->lock = &nf->lock;
+        break;
+    }
+    pthread_mutex_lock(&m_stats);
+    ent->stats = stats_alloc(netfn, cmds[i].cmd, cmds[i].name);
+    pthread_mutex_unlock(&m_stats);
+    nf->cmds[cmds[i].cmd] = ent;
+  }
+
+  g_netfn[netfn] = nf;
+  return 0;
+}
+
+int
+ipmi_dispatch_init(void) {
+  ipmi_stats_t *stats;
+  int fd;
+
+  fd = shm_open(IPMI_STATS_SHM, O_CREAT | O_RDWR, 0644);
+  if (fd < 0) {
+    syslog(LOG_WARNING, "%s: shm_open failed, errno %d", __func__, errno);
+    return -1;
+  }
+
+  if (ftruncate(fd, sizeof(ipmi_stats_t))) {
+    syslog(LOG_WARNING, "%s: ftruncate failed, errno %d", __func__, errno);
+    close(fd);
+    return -1;
+  }
+
+  stats = mmap(NULL, sizeof(ipmi_stats_t), PROT_READ | PROT_WRITE,
+               MAP_SHARED, fd, 0);
+  close(fd);
+  if (stats == MAP_FAILED) {
+    syslog(LOG_WARNING, "%s: mmap failed, errno %d", __func__, errno);
+    return -1;
+  }
+
+  // Start from scratch, a previous ipmid may have registered other commands
+  pthread_mutex_lock(&m_stats);
+  memset(stats, 0, sizeof(*stats));
+  stats->magic = IPMI_STATS_MAGIC;
+  stats->version = IPMI_STATS_VERSION;
+  g_stats = stats;
+  pthread_mutex_unlock(&m_stats);
+
+  return 0;
+}
+
+void
+ipmi_dispatch(unsigned char *request, unsigned char req_len,
+              unsigned char *response, unsigned char *res_len) {
+  ipmi_mn_req_t *req = (ipmi_mn_req_t *) request;
+  ipmi_res_t *res = (ipmi_res_t *) response;
+  unsigned char netfn = req->netfn_lun >> 2;
+  struct netfn_entry *nf = g_netfn[netfn];
+  struct cmd_entry *ent;
+  uint64_t start;
+
+  if (!nf) {
+    stats_unknown();
+    return;
+  }
+
+  if (nf->flags & NETFN_PRESET_CC)
+    res->cc = CC_SUCCESS;
+
+  ent = nf->cmds[req->cmd];
+  if (!ent && nf->fallback)
+    ent = fallback_entry(nf, netfn, req->cmd);
+  if (!ent) {
+    res->cc = CC_INVALID_CMD;
+    if (nf->flags & NETFN_ECHO_IANA) {
+      memcpy(res->data, req->data, SIZE_IANA_ID);
+      *res_len = SIZE_IANA_ID;
+    }
+    stats_unknown();
+    return;
+  }
+
+  // The time spent waiting for the lock is part of the latency
+  start = now_us();
+  if (ent->lock)
+    pthread_mutex_lock(ent->lock);
+  ent->fn(request, req_len, response, res_len);
+  if (ent->lock)
+    pthread_mutex_unlock(ent->lock);
+  stats_update(ent, res->cc, now_us() - start);
+}
@@ -0,0 +1,65 @@
+/*
+ *
+ * Copyright 2017-present Facebook. All Rights Reserved.
+ *
+ * This file routes IPMI requests to the handler registered for their
+ * (NetFn, Cmd) and keeps per-command counters and latency histograms.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#ifndef __DISPATCH_H__
+#define __DISPATCH_H__
+
+typedef void (*ipmi_cmd_fn)(unsigned char *request, unsigned char req_len,
+                            unsigned char *response, unsigned char *res_len);
+
+// Which lock is held around a handler
+enum {
+  LOCK_NETFN = 0,   // one lock for all such commands of the NetFn
+  LOCK_CMD,         // one lock for this command only
+  LOCK_NONE,        // the handler does its own locking
+};
+
+typedef struct {
+  unsigned char cmd;
+  unsigned char lock;
+  const char *name;
+  ipmi_cmd_fn fn;
+} ipmi_cmd_t;
+
+// NetFn flags
+#define NETFN_PRESET_CC   0x01  // cc is CC_SUCCESS unless the handler says not
+#define NETFN_ECHO_IANA   0x02  // OEM NetFn, invalid commands echo the IANA ID
+
+/*
+ * Register the commands of one NetFn. Requests for other commands go to
+ * fallback, without a lock, or fail with CC_INVALID_CMD if it is NULL.
+ */
+int ipmi_dispatch_register(unsigned char netfn, unsigned char flags,
+                           const ipmi_cmd_t *cmds, int num,
+                           ipmi_cmd_fn fallback);
+
+/* Create the shared memory stats page; dispatch works without it */
+int ipmi_dispatch_init(void);
+
+/*
+ * Run the handler for the request. Only cc, data and res_len are set, the
+ * response header is left to the caller.
+ */
+void ipmi_dispatch(unsigned char *request, unsigned char req_len,
+                   unsigned char *response, unsigned char *res_len);
+
+#endif /* __DISPATCH_H__ */
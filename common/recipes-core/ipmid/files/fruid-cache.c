@@ -0,0 +1,221 @@
+/*
+ *
+ * Copyright 2017-present Facebook. All Rights Reserved.
+ *
+ * This file keeps the FRU binary images served by ipmid in memory, and
+ * drops an image when inotify reports its file changed.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <syslog.h>
+#include <string.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <sys/inotify.h>
+#include "fruid.h"
+
+#define FRUID_CACHE_MAX   16
+// Offsets in Read FRU Data are 16 bits
+#define FRUID_IMAGE_MAX   0x10000
+
+#define FRUID_WATCH_MASK  (IN_MODIFY | IN_CLOSE_WRITE | IN_ATTRIB | \
+                           IN_DELETE_SELF | IN_MOVE_SELF)
+
+/*
+ * Images are keyed by file, as several (payload, FRU) pairs may map to the
+ * same one. An image is valid while its file is watched; any change to the
+ * file, including it being replaced by a rename (IN_ATTRIB on the link
+ * count), drops it and the next read loads it again.
+ */
+struct fruid_image {
+  char path[FRUID_PATH_MAX];
+  int wd;                   // inotify watch, -1 when not loaded
+  int size;
+  unsigned char *data;
+};
+
+static pthread_mutex_t m_fruid = PTHREAD_MUTEX_INITIALIZER;
+static struct fruid_image g_image[FRUID_CACHE_MAX];
+static int g_next_evict;
+static int g_ifd = -1;
+
+static void
+image_drop(struct fruid_image *img) {
+  if (img->wd >= 0) {
+    inotify_rm_watch(g_ifd, img->wd);
+    img->wd = -1;
+  }
+  free(img->data);
+  img->data = NULL;
+  img->size = 0;
+}
+
+static int
+image_load(struct fruid_image *img) {
+  struct stat st;
+  int fd, ret;
+
+  // Watch before reading, so a write racing with the read is not missed
+  if (g_ifd >= 0) {
+    img->wd = inotify_add_watch(g_ifd, img->path, FRUID_WATCH_MASK);
+    if (img->wd < 0)
+      return -1;
+  }
+
+  fd = open(img->path, O_RDONLY);
+  if (fd < 0)
+    goto err;
+
+  if (fstat(fd, &st) || st.st_size <= 0 || st.st_size > FRUID_IMAGE_MAX)
+    goto err_close;
+
+  img->data = malloc(st.st_size);
+  if (!img->data)
+    goto err_close;
+
+  ret = read(fd, img->data, st.st_size);
+  if (ret != st.st_size)
+    goto err_close;
+  close(fd);
+
+  img->size = st.st_size;
+  return 0;
+
+err_close:
+  close(fd);
+err:
+  image_drop(img);
+  return -1;
+}
+
+// Drop the images whose files changed. Called with m_fruid held.
+static void
+fruid_cache_sync(void) {
+  char buf[1024] __attribute__((aligned(__alignof__(struct inotify_event))));
+  struct inotify_event *ev;
+  ssize_t len;
+  char *p;
+  int i;
+
+  while ((len = read(g_ifd, buf, sizeof(buf))) > 0) {
+    for (p = buf; p < buf + len; p += sizeof(*ev) + ev->len) {
+      ev = (struct inotify_event *)p;
+      for (i = 0; i < FRUID_CACHE_MAX; i++) {
+        if (g_image[i].wd != ev->wd)
+          continue;
+        // The kernel already removed the watch
+        if (ev->mask & IN_IGNORED)
+          g_image[i].wd = -1;
+        image_drop(&g_image[i]);
+      }
+    }
+  }
+}
+
+// Returns the loaded image. Called with m_fruid held.
+static struct fruid_image *
+fruid_cache_get(unsigned char payload_id, unsigned char fru_id) {
+  char path[FRUID_PATH_MAX] = {0};
+  struct fruid_image *img = NULL;
+  int i;
+
+  if (plat_fruid_path(payload_id, fru_id, path))
+    return NULL;
+
+  if (g_ifd >= 0)
+    fruid_cache_sync();
+
+  for (i = 0; i < FRUID_CACHE_MAX; i++) {
+    if (!strcmp(g_image[i].path, path)) {
+      img = &g_image[i];
+      break;
+    }
+    if (!img && !g_image[i].path[0])
+      img = &g_image[i];
+  }
+
+  if (!img || strcmp(img->path, path)) {
+    if (!img) {
+      img = &g_image[g_next_evict];
+      g_next_evict = (g_next_evict + 1) % FRUID_CACHE_MAX;
+    }
+    image_drop(img);
+    strncpy(img->path, path, sizeof(img->path) - 1);
+  }
+
+  // Without inotify there is no telling when the file changes
+  if (g_ifd < 0)
+    image_drop(img);
+
+  if (!img->data && image_load(img))
+    return NULL;
+
+  return img;
+}
+
+int
+fruid_cache_init(void) {
+  int i;
+
+  for (i = 0; i < FRUID_CACHE_MAX; i++)
+    g_image[i].wd = -1;
+
+  g_ifd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if (g_ifd < 0) {
+    syslog(LOG_WARNING, "%s: inotify_init1 failed, errno %d, FRU images "
+           "will not be cached", __func__, errno);
+    return -1;
+  }
+
+  return 0;
+}
+
+int
+fruid_cache_size(unsigned char payload_id, unsigned char fru_id) {
+  struct fruid_image *img;
+  int size = 0;
+
+  pthread_mutex_lock(&m_fruid);
+  img = fruid_cache_get(payload_id, fru_id);
+  if (img)
+    size = img->size;
+  pthread_mutex_unlock(&m_fruid);
+
+  return size;
+}
+
+int
+fruid_cache_read(unsigned char payload_id, unsigned char fru_id,
+                 int offset, int count, unsigned char *data) {
+  struct fruid_image *img;
+  int ret = -1;
+
+  pthread_mutex_lock(&m_fruid);
+  img = fruid_cache_get(payload_id, fru_id);
+  if (img && offset >= 0 && offset < img->size && count >= 0) {
+    if (count > img->size - offset)
+      count = img->size - offset;
+    memcpy(data, img->data + offset, count);
+    ret = count;
+  }
+  pthread_mutex_unlock(&m_fruid);
+
+  return ret;
+}
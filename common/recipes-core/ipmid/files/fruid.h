@@ -21,8 +21,27 @@
 #ifndef __FRUID_H__
 #define __FRUID_H__
 
-int plat_fruid_size(unsigned char payload_id);
-int plat_fruid_data(unsigned char payload_id, int offset, int count, unsigned char *data);
+#define FRUID_PATH_MAX 64
+
 int plat_fruid_init(void);
+/*
+ * Fill path with the binary image of FRU fru_id as seen from payload_id.
+ * Returns 0, or -1 if there is no such FRU.
+ */
+int plat_fruid_path(unsigned char payload_id, unsigned char fru_id, char *path);
+
+/*
+ * FRU images are kept in memory and dropped when the file on disk changes
+ * (fruid-cache.c), so Read FRU Data chunks are served without file I/O.
+ */
+int fruid_cache_init(void);
+/* Size of the image in bytes, 0 if it is not available */
+int fruid_cache_size(unsigned char payload_id, unsigned char fru_id);
+/*
+ * Copy up to count bytes from offset. Returns the number of bytes copied,
+ * which is less than count at the end of the image, or -1.
+ */
+int fruid_cache_read(unsigned char payload_id, unsigned char fru_id,
+                     int offset, int count, unsigned char *data);
 
 #endif /* __FRUID_H__ */
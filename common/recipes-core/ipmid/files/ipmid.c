@@ -23,8 +23,11 @@
 #include "sdr.h"
 #include "sel.h"
 #include "fruid.h"
+#include "timer.h"
+#include "dispatch.h"
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
 #include <unistd.h>
 #include <errno.h>
 #include <syslog.h>
@@ -50,7 +53,18 @@
 #define BIOS_BOOT_VALID_FLAG (1U << 7)
 #define CMOS_VALID_FLAG      (1U << 1)
 
-static unsigned char IsTimerStart[MAX_NODES] = {0};
+static tmr_t bios_timer[MAX_NODES];
+static char bios_timer_name[MAX_NODES][16];
+// Boot order commands and the timers that clear the BIOS flags
+static pthread_mutex_t m_boot_order = PTHREAD_MUTEX_INITIALIZER;
+// Stops running watchdogs of servers that were powered off
+static tmr_t wdt_power_timer;
+#define WDT_POWER_POLL_MS 1000
+
+// Watchdog and timer state, for diagnostics
+#ifndef TIMER_STATE_FILE
+#define TIMER_STATE_FILE "/tmp/ipmid.timers"
+#endif
 
 static unsigned char bmc_global_enable_setting[] = {0x0c,0x0c,0x0c,0x0c};
 
@@ -68,7 +82,10 @@ static sys_info_param_t g_sys_info_params;
 // IPMI Watchdog Timer Structure
 struct watchdog_data {
   pthread_mutex_t mutex;
-  pthread_t tid;
+  tmr_t timer;              // pending while the watchdog runs
+  tmr_t pre_timer;          // pending until the pre-timeout interrupt
+  char name[16];
+  char pre_name[24];
   uint8_t slot;
   uint8_t valid;
   uint8_t run;
@@ -79,11 +96,14 @@ struct watchdog_data {
   uint8_t pre_interval;
   uint8_t expiration;
   uint16_t init_count_down;
-  uint16_t present_count_down;
+  uint16_t present_count_down;  // while stopped; derived from timer when running
 };
 
 static struct watchdog_data *g_wdt[MAX_NUM_FRUS];
 
+// Request trace ring, written while ipmi-util --trace turns it on
+static ipmi_trace_t *g_trace;
+
 static char* wdt_use_name[8] = {
   "reserved",
   "BIOS FRB2",
@@ -95,6 +115,17 @@ static char* wdt_use_name[8] = {
   "reserved",
 };
 
+static char* wdt_pre_action_name[8] = {
+  "none",
+  "SMI",
+  "NMI",
+  "Messaging Interrupt",
+  "reserved",
+  "reserved",
+  "reserved",
+  "reserved",
+};
+
 static char* wdt_action_name[8] = {
   "Timer expired",
   "Hard Reset",
@@ -138,17 +169,8 @@ static char *drive_info_key[] =
   "wwn"
 };
 
-// TODO: Based on performance testing results, might need fine grained locks
-// Since the global data is specific to a NetFunction, adding locs at NetFn level
-static pthread_mutex_t m_chassis;
-static pthread_mutex_t m_sensor;
-static pthread_mutex_t m_app;
-static pthread_mutex_t m_storage;
-static pthread_mutex_t m_transport;
-static pthread_mutex_t m_oem;
-static pthread_mutex_t m_oem_1s;
-static pthread_mutex_t m_oem_usb_dbg;
-static pthread_mutex_t m_oem_q;
+// Global data is mostly specific to a NetFunction, so commands lock at NetFn
+// level unless their entry in the command tables says otherwise
 
 static void ipmi_handle(unsigned char *request, unsigned char req_len,
        unsigned char *response, unsigned char *res_len);
@@ -160,6 +182,66 @@ static struct watchdog_data *get_watchdog(int slot_id)
   return g_wdt[slot_id - 1];
 }
 
+// Watchdog helpers, called with wdt->mutex held. Counts are in 100ms.
+static void
+wdt_start(struct watchdog_data *wdt)
+{
+  uint16_t pre = wdt->pre_interval * 10;
+
+  wdt->run = 1;
+  tmr_start(&wdt->timer, wdt->present_count_down * 100);
+  // Poll the server power only while some watchdog runs
+  if (!tmr_pending(&wdt_power_timer))
+    tmr_start(&wdt_power_timer, WDT_POWER_POLL_MS);
+  if (wdt->pre_action && wdt->present_count_down > pre)
+    tmr_start(&wdt->pre_timer, (wdt->present_count_down - pre) * 100);
+  else
+    tmr_stop(&wdt->pre_timer);
+}
+
+static void
+wdt_stop(struct watchdog_data *wdt)
+{
+  wdt->run = 0;
+  tmr_stop(&wdt->timer);
+  tmr_stop(&wdt->pre_timer);
+}
+
+static uint16_t
+wdt_count_down(struct watchdog_data *wdt)
+{
+  if (!wdt->run)
+    return wdt->present_count_down;
+  return (tmr_remaining(&wdt->timer) + 99) / 100;
+}
+
+static void
+timer_state_dump(void)
+{
+  struct watchdog_data *wdt;
+  FILE *fp;
+  int i;
+
+  fp = fopen(TIMER_STATE_FILE ".tmp", "w");
+  if (!fp)
+    return;
+
+  for (i = 0; i < MAX_NUM_FRUS; i++) {
+    if (!(wdt = g_wdt[i]))
+      continue;
+    pthread_mutex_lock(&wdt->mutex);
+    fprintf(fp, "%s: valid %d, run %d, use %s, action %s, count_down %u/%u, "
+            "expiration 0x%x\n", wdt->name, wdt->valid, wdt->run,
+            wdt_use_name[wdt->use & 0x7], wdt_action_name[wdt->action & 0x7],
+            wdt_count_down(wdt), wdt->init_count_down, wdt->expiration);
+    pthread_mutex_unlock(&wdt->mutex);
+  }
+  tmr_dump(fp);
+
+  fclose(fp);
+  rename(TIMER_STATE_FILE ".tmp", TIMER_STATE_FILE);
+}
+
 static int length_check(unsigned char cmd_len, unsigned char req_len, unsigned char *response, unsigned char *res_len)
 {
   ipmi_res_t *res = (ipmi_res_t *) response;
@@ -175,45 +257,39 @@ static int length_check(unsigned char cmd_len, unsigned char req_len, unsigned c
 /*
  **Function to handle with clearing BIOS flag
  */
-void
-*clear_bios_data_timer(void *ptr)
+static void
+clear_bios_data_timer(tmr_t *t, void *arg)
 {
-  int timer = 0;
   unsigned char boot[SIZE_BOOT_ORDER]={0};
-  unsigned char slot_id = *(uint8_t *)ptr;
+  unsigned char slot_id = (uintptr_t)arg;
   unsigned char res_len;
-  pthread_detach(pthread_self());
-
-  while( timer <= BIOS_Timeout )
-  {
-#ifdef DEBUG
-    syslog(LOG_WARNING, "[%s][%lu] Timer: %d\n", __func__, pthread_self(), timer);
-#endif
-    sleep(1);
 
-    timer++;
+  pthread_mutex_lock(&m_boot_order);
+  // Boot order was set again meanwhile
+  if (tmr_pending(t)) {
+    pthread_mutex_unlock(&m_boot_order);
+    return;
   }
 
   //get boot order setting
   pal_get_boot_order(slot_id, NULL, boot, &res_len);
 
 #ifdef DEBUG
-  syslog(LOG_WARNING, "[%s][%lu] Get: %x %x %x %x %x %x\n", __func__, pthread_self() ,boot[0], boot[1], boot[2], boot[3], boot[4], boot[5]);
+  syslog(LOG_WARNING, "[%s][%u] Get: %x %x %x %x %x %x\n", __func__, slot_id, boot[0], boot[1], boot[2], boot[3], boot[4], boot[5]);
 #endif
 
   //clear boot-valid and cmos bits due to timeout:
   boot[0] &= ~(BIOS_BOOT_VALID_FLAG | CMOS_VALID_FLAG);
 
 #ifdef DEBUG
-  syslog(LOG_WARNING, "[%s][%lu] Set: %x %x %x %x %x %x\n", __func__, pthread_self() , boot[0], boot[1], boot[2], boot[3], boot[4], boot[5]);
+  syslog(LOG_WARNING, "[%s][%u] Set: %x %x %x %x %x %x\n", __func__, slot_id, boot[0], boot[1], boot[2], boot[3], boot[4], boot[5]);
 #endif
 
   //set data
   pal_set_boot_order(slot_id, boot, NULL, &res_len);
+  pthread_mutex_unlock(&m_boot_order);
 
-  IsTimerStart[slot_id - 1] = false;
-
-  pthread_exit(0);
+  timer_state_dump();
 }
 
 /*
@@ -221,7 +297,8 @@ void
  */
 // Get Chassis Status (IPMI/Section 28.2)
 static void
-chassis_get_status (unsigned char *request, unsigned char *response, unsigned char *res_len)
+chassis_get_status (unsigned char *request, unsigned char req_len,
+                    unsigned char *response, unsigned char *res_len)
 {
   ipmi_mn_req_t *req = (ipmi_mn_req_t *) request;
   ipmi_res_t *res = (ipmi_res_t *) response;
@@ -293,30 +370,12 @@ chassis_set_boot_options (unsigned char *request, unsigned char req_len,
   *res_len = data - &res->data[0];
 }
 
-// Handle Chassis Commands (IPMI/Section 28)
-static void
-ipmi_handle_chassis (unsigned char *request, unsigned char req_len,
-         unsigned char *response, unsigned char *res_len)
-{
-  ipmi_mn_req_t *req = (ipmi_mn_req_t *) request;
-  ipmi_res_t *res = (ipmi_res_t *) response;
-  unsigned char cmd = req->cmd;
-
-  pthread_mutex_lock(&m_chassis);
-  switch (cmd)
-  {
-    case CMD_CHASSIS_GET_STATUS:
-      chassis_get_status (request, response, res_len);
-      break;
-    case CMD_CHASSIS_SET_POWER_RESTORE_POLICY:
-      chassis_set_power_restore_policy(request, req_len, response, res_len);
-      break;
-    default:
-      res->cc = CC_INVALID_CMD;
-      break;
-  }
-  pthread_mutex_unlock(&m_chassis);
-}
+// Chassis Commands (IPMI/Section 28)
+static const ipmi_cmd_t chassis_cmds[] = {
+  {CMD_CHASSIS_GET_STATUS, LOCK_NETFN, "get_status", chassis_get_status},
+  {CMD_CHASSIS_SET_POWER_RESTORE_POLICY, LOCK_NETFN, "set_power_restore_policy",
+   chassis_set_power_restore_policy},
+};
 
 /*
  * Function(s) to handle IPMI messages with NetFn: Sensor
@@ -348,27 +407,10 @@ sensor_plat_event_msg(unsigned char *request, unsigned char req_len,
   res->cc = CC_SUCCESS;
 }
 
-// Handle Sensor/Event Commands (IPMI/Section 29)
-static void
-ipmi_handle_sensor(unsigned char *request, unsigned char req_len,
-                   unsigned char *response, unsigned char *res_len)
-{
-  ipmi_mn_req_t *req = (ipmi_mn_req_t *) request;
-  ipmi_res_t *res = (ipmi_res_t *) response;
-  unsigned char cmd = req->cmd;
-
-  pthread_mutex_lock(&m_sensor);
-  switch (cmd)
-  {
-    case CMD_SENSOR_PLAT_EVENT_MSG:
-      sensor_plat_event_msg(request, req_len, response, res_len);
-      break;
-    default:
-      res->cc = CC_INVALID_CMD;
-      break;
-  }
-  pthread_mutex_unlock(&m_sensor);
-}
+// Sensor/Event Commands (IPMI/Section 29)
+static const ipmi_cmd_t sensor_cmds[] = {
+  {CMD_SENSOR_PLAT_EVENT_MSG, LOCK_NETFN, "plat_event_msg", sensor_plat_event_msg},
+};
 
 /*
  * Function(s) to handle IPMI messages with NetFn: Application
@@ -425,6 +467,14 @@ static void
 app_cold_reset(unsigned char *request, unsigned char req_len,
               unsigned char *response, unsigned char *res_len)
 {
+  ipmi_res_t *res = (ipmi_res_t *) response;
+
+  // BMC is updating a device FW
+  if (pal_get_fw_update_flag() == 1) {
+    res->cc = CC_NODE_BUSY;
+    return;
+  }
+
   reboot(RB_AUTOBOOT);
 }
 
@@ -457,6 +507,12 @@ app_manufacturing_test_on (unsigned char *request, unsigned char req_len,
   ipmi_res_t *res = (ipmi_res_t *) response;
   unsigned char *data = &res->data[0];
 
+  // BMC is updating a device FW
+  if (pal_get_fw_update_flag() == 1) {
+    res->cc = CC_NODE_BUSY;
+    return;
+  }
+
   res->cc = CC_SUCCESS;
 
   if ((!memcmp(req->data, "sled-cycle", strlen("sled-cycle"))) &&
@@ -530,7 +586,7 @@ app_reset_watchdog_timer (unsigned char *request, unsigned char req_len,
   if (wdt->valid) {
     res->cc = CC_SUCCESS;
     wdt->present_count_down = wdt->init_count_down;
-    wdt->run = 1;
+    wdt_start(wdt);
   }
   else
     res->cc = CC_INVALID_PARAM; // un-initialized watchdog
@@ -554,28 +610,40 @@ app_set_watchdog_timer (unsigned char *request, unsigned char req_len,
     return;
   }
 
-  // no support pre-itmeout interrupt
-  if (req->data[1] & 0xF0) {
+  // SMI, NMI or messaging pre-timeout interrupt
+  if ((req->data[1] & 0x80) || ((req->data[1] >> 4) & 0x7) > 3) {
     res->cc = CC_PARAM_OUT_OF_RANGE;
     *res_len = 0;
     return;
   }
 
+  // The pre-timeout interval must fit in the countdown
+  if ((req->data[1] & 0x70) &&
+      req->data[2] * 10 > (req->data[5]<<8 | req->data[4])) {
+    res->cc = CC_INVALID_DATA_FIELD;
+    *res_len = 0;
+    return;
+  }
+
   pthread_mutex_lock(&wdt->mutex);
   wdt->no_log = req->data[0] >> 7;
   wdt->use = req->data[0] & 0x7;
-  wdt->pre_action = 0; // no support
+  wdt->pre_action = (req->data[1] >> 4) & 0x7;
   wdt->action = req->data[1] & 0x7;
   wdt->pre_interval = req->data[2];
   wdt->expiration &= ~(req->data[3]);
   wdt->init_count_down = (req->data[5]<<8 | req->data[4]);
   wdt->present_count_down = wdt->init_count_down;
   if (!(req->data[0] & 0x40)) // 'do not stop timer' bit
-    wdt->run = 0;
+    wdt_stop(wdt);
+  else if (wdt->run)
+    wdt_start(wdt);
   wdt->valid = 1;
   pthread_mutex_unlock(&wdt->mutex);
   res->cc = CC_SUCCESS;
 
+  timer_state_dump();
+
   *res_len = data - &res->data[0];
 }
 
@@ -588,6 +656,7 @@ app_get_watchdog_timer (unsigned char *request, unsigned char req_len,
   ipmi_res_t *res = (ipmi_res_t *) response;
   unsigned char *data = &res->data[0];
   unsigned char byte;
+  uint16_t count_down;
   struct watchdog_data *wdt = get_watchdog(req->payload_id);
 
   if (!wdt) {
@@ -608,8 +677,9 @@ app_get_watchdog_timer (unsigned char *request, unsigned char req_len,
   *data++ = wdt->expiration;
   *data++ = wdt->init_count_down & 0xFF;
   *data++ = (wdt->init_count_down >> 8) & 0xFF;
-  *data++ = wdt->present_count_down & 0xFF;
-  *data++ = (wdt->present_count_down >> 8) & 0xFF;
+  count_down = wdt_count_down(wdt);
+  *data++ = count_down & 0xFF;
+  *data++ = (count_down >> 8) & 0xFF;
   pthread_mutex_unlock(&wdt->mutex);
   res->cc = CC_SUCCESS;
 
@@ -885,91 +955,54 @@ app_master_write_read (unsigned char *request, unsigned char req_len,
   }
 }
 
-// Handle Appliction Commands (IPMI/Section 20)
-static void
-ipmi_handle_app (unsigned char *request, unsigned char req_len,
-                unsigned char *response, unsigned char *res_len)
-{
-  ipmi_mn_req_t *req = (ipmi_mn_req_t *) request;
-  ipmi_res_t *res = (ipmi_res_t *) response;
-  unsigned char cmd = req->cmd;
-  int fw_update_flag;
-
-  //if fw_update_flag = 1 means BMC is Updating a Device FW  
-  fw_update_flag = pal_get_fw_update_flag();
-
-  pthread_mutex_lock(&m_app);
-  switch (cmd)
-  {
-    case CMD_APP_GET_DEVICE_ID:
-      app_get_device_id (request, req_len, response, res_len);
-      break;
-    case CMD_APP_COLD_RESET:
-      if(fw_update_flag == 1)
-        res->cc = CC_NODE_BUSY;
-      else
-        app_cold_reset (request, req_len, response, res_len);
-      break;
-    case CMD_APP_GET_SELFTEST_RESULTS:
-      app_get_selftest_results (request, req_len, response, res_len);
-      break;
-    case CMD_APP_MANUFACTURING_TEST_ON:
-      if(fw_update_flag == 1)
-        res->cc = CC_NODE_BUSY;
-      else
-        app_manufacturing_test_on (request, req_len, response, res_len);
-      break;
-    case CMD_APP_GET_DEVICE_GUID:
-      app_get_device_guid (request, req_len, response, res_len);
-      break;
-    case CMD_APP_GET_SYSTEM_GUID:
-      app_get_device_sys_guid (request, req_len, response, res_len);
-      break;
-    case CMD_APP_RESET_WDT:
-      app_reset_watchdog_timer (request, req_len, response, res_len);
-      break;
-    case CMD_APP_SET_WDT:
-      app_set_watchdog_timer (request, req_len, response, res_len);
-      break;
-    case CMD_APP_GET_WDT:
-      app_get_watchdog_timer (request, req_len, response, res_len);
-      break;
-    case CMD_APP_SET_GLOBAL_ENABLES:
-      app_set_global_enables (request, req_len, response, res_len);
-      break;
-    case CMD_APP_GET_GLOBAL_ENABLES:
-      app_get_global_enables (request, req_len, response, res_len);
-      break;
-    case CMD_APP_SET_SYS_INFO_PARAMS:
-      app_set_sys_info_params (request, req_len, response, res_len);
-      break;
-    case CMD_APP_CLEAR_MESSAGE_FLAGS:
-      app_clear_message_flags (request, req_len, response, res_len);
-      break;
-    case CMD_APP_GET_SYS_INFO_PARAMS:
-      app_get_sys_info_params (request,  req_len, response, res_len);
-      break;
-    case CMD_APP_MASTER_WRITE_READ:
-      app_master_write_read (request,  req_len, response, res_len);
-      break;
-    default:
-      res->cc = CC_INVALID_CMD;
-      break;
-  }
-  pthread_mutex_unlock(&m_app);
-}
+// Application Commands (IPMI/Section 20)
+// Watchdog commands lock the watchdog of their slot
+static const ipmi_cmd_t app_cmds[] = {
+  {CMD_APP_GET_DEVICE_ID, LOCK_NETFN, "get_device_id", app_get_device_id},
+  {CMD_APP_COLD_RESET, LOCK_NETFN, "cold_reset", app_cold_reset},
+  {CMD_APP_GET_SELFTEST_RESULTS, LOCK_NETFN, "get_selftest_results",
+   app_get_selftest_results},
+  {CMD_APP_MANUFACTURING_TEST_ON, LOCK_NETFN, "manufacturing_test_on",
+   app_manufacturing_test_on},
+  {CMD_APP_GET_DEVICE_GUID, LOCK_NETFN, "get_device_guid", app_get_device_guid},
+  {CMD_APP_GET_SYSTEM_GUID, LOCK_NETFN, "get_system_guid",
+   app_get_device_sys_guid},
+  {CMD_APP_RESET_WDT, LOCK_NONE, "reset_wdt", app_reset_watchdog_timer},
+  {CMD_APP_SET_WDT, LOCK_NONE, "set_wdt", app_set_watchdog_timer},
+  {CMD_APP_GET_WDT, LOCK_NONE, "get_wdt", app_get_watchdog_timer},
+  {CMD_APP_SET_GLOBAL_ENABLES, LOCK_NETFN, "set_global_enables",
+   app_set_global_enables},
+  {CMD_APP_GET_GLOBAL_ENABLES, LOCK_NETFN, "get_global_enables",
+   app_get_global_enables},
+  {CMD_APP_SET_SYS_INFO_PARAMS, LOCK_NETFN, "set_sys_info_params",
+   app_set_sys_info_params},
+  {CMD_APP_CLEAR_MESSAGE_FLAGS, LOCK_NETFN, "clear_message_flags",
+   app_clear_message_flags},
+  {CMD_APP_GET_SYS_INFO_PARAMS, LOCK_NETFN, "get_sys_info_params",
+   app_get_sys_info_params},
+  // Can take a while on a slow bus, and only needs the bus
+  {CMD_APP_MASTER_WRITE_READ, LOCK_CMD, "master_write_read",
+   app_master_write_read},
+};
 
 /*
  * Function(s) to handle IPMI messages with NetFn: Storage
  */
 
 static void
-storage_get_fruid_info(unsigned char *request, unsigned char *response, unsigned char *res_len)
+storage_get_fruid_info(unsigned char *request, unsigned char req_len,
+                       unsigned char *response, unsigned char *res_len)
 {
   ipmi_mn_req_t *req = (ipmi_mn_req_t *) request;
   ipmi_res_t *res = (ipmi_res_t *) response;
   unsigned char *data = &res->data[0];
-  int size = plat_fruid_size(req->payload_id);
+  int size = fruid_cache_size(req->payload_id, req->data[0]);
+
+  if (!size) {
+    res->cc = CC_PARAM_OUT_OF_RANGE;
+    *res_len = 0;
+    return;
+  }
 
   res->cc = CC_SUCCESS;
 
@@ -983,8 +1016,8 @@ storage_get_fruid_info(unsigned char *request, unsigned char *response, unsigned
 }
 
 static void
-storage_get_fruid_data(unsigned char *request, unsigned char *response,
-    unsigned char *res_len)
+storage_get_fruid_data(unsigned char *request, unsigned char req_len,
+                       unsigned char *response, unsigned char *res_len)
 {
   ipmi_mn_req_t *req = (ipmi_mn_req_t *) request;
   ipmi_res_t *res = (ipmi_res_t *) response;
@@ -993,13 +1026,15 @@ storage_get_fruid_data(unsigned char *request, unsigned char *response,
   int offset = req->data[1] + (req->data[2] << 8);
   int count = req->data[3];
 
-  int ret = plat_fruid_data(req->payload_id, offset, count, &(res->data[1]));
-  if (ret) {
+  // A read past the end of the image returns the bytes up to the end
+  int ret = fruid_cache_read(req->payload_id, req->data[0], offset, count,
+                             &(res->data[1]));
+  if (ret < 0) {
     res->cc = CC_UNSPECIFIED_ERROR;
   } else {
     res->cc = CC_SUCCESS;
-    *data++ = count;
-    data += count;
+    *data++ = ret;
+    data += ret;
   }
 
   if (res->cc == CC_SUCCESS) {
@@ -1009,7 +1044,8 @@ storage_get_fruid_data(unsigned char *request, unsigned char *response,
 }
 
 static void
-storage_get_sdr_info (unsigned char *response, unsigned char *res_len)
+storage_get_sdr_info (unsigned char *request, unsigned char req_len,
+                      unsigned char *response, unsigned char *res_len)
 {
   ipmi_res_t *res = (ipmi_res_t *) response;
   unsigned char *data = &res->data[0];
@@ -1046,7 +1082,8 @@ storage_get_sdr_info (unsigned char *response, unsigned char *res_len)
 }
 
 static void
-storage_rsv_sdr (unsigned char *request, unsigned char *response, unsigned char *res_len)
+storage_rsv_sdr (unsigned char *request, unsigned char req_len,
+                 unsigned char *response, unsigned char *res_len)
 {
   ipmi_mn_req_t *req = (ipmi_mn_req_t *) request;
   ipmi_res_t *res = (ipmi_res_t *) response;
@@ -1071,8 +1108,8 @@ storage_rsv_sdr (unsigned char *request, unsigned char *response, unsigned char
 }
 
 static void
-storage_get_sdr (unsigned char *request, unsigned char *response,
-     unsigned char *res_len)
+storage_get_sdr (unsigned char *request, unsigned char req_len,
+                 unsigned char *response, unsigned char *res_len)
 {
   ipmi_mn_req_t *req = (ipmi_mn_req_t *) request;
   ipmi_res_t *res = (ipmi_res_t *) response;
@@ -1112,8 +1149,8 @@ storage_get_sdr (unsigned char *request, unsigned char *response,
 }
 
 static void
-storage_get_sel_info (unsigned char *request, unsigned char *response,
-                      unsigned char *res_len)
+storage_get_sel_info (unsigned char *request, unsigned char req_len,
+                      unsigned char *response, unsigned char *res_len)
 {
   ipmi_mn_req_t *req = (ipmi_mn_req_t *) request;
   ipmi_res_t *res = (ipmi_res_t *) response;
@@ -1151,8 +1188,8 @@ storage_get_sel_info (unsigned char *request, unsigned char *response,
 }
 
 static void
-storage_rsv_sel (unsigned char * request, unsigned char *response,
-                  unsigned char *res_len)
+storage_rsv_sel (unsigned char *request, unsigned char req_len,
+                 unsigned char *response, unsigned char *res_len)
 {
   ipmi_mn_req_t *req = (ipmi_mn_req_t *) request;
   ipmi_res_t *res = (ipmi_res_t *) response;
@@ -1177,8 +1214,8 @@ storage_rsv_sel (unsigned char * request, unsigned char *response,
 }
 
 static void
-storage_get_sel (unsigned char *request, unsigned char *response,
-     unsigned char *res_len)
+storage_get_sel (unsigned char *request, unsigned char req_len,
+                 unsigned char *response, unsigned char *res_len)
 {
   ipmi_mn_req_t *req = (ipmi_mn_req_t *) request;
   ipmi_res_t *res = (ipmi_res_t *) response;
@@ -1222,8 +1259,8 @@ storage_get_sel (unsigned char *request, unsigned char *response,
 }
 
 static void
-storage_add_sel (unsigned char *request, unsigned char *response,
-     unsigned char *res_len)
+storage_add_sel (unsigned char *request, unsigned char req_len,
+                 unsigned char *response, unsigned char *res_len)
 {
   ipmi_mn_req_t *req = (ipmi_mn_req_t *) request;
   ipmi_res_t *res = (ipmi_res_t *) response;
@@ -1255,8 +1292,8 @@ storage_add_sel (unsigned char *request, unsigned char *response,
 }
 
 static void
-storage_clr_sel (unsigned char *request, unsigned char *response,
-     unsigned char *res_len)
+storage_clr_sel (unsigned char *request, unsigned char req_len,
+                 unsigned char *response, unsigned char *res_len)
 {
   ipmi_mn_req_t *req = (ipmi_mn_req_t *) request;
   ipmi_res_t *res = (ipmi_res_t *) response;
@@ -1307,7 +1344,8 @@ storage_clr_sel (unsigned char *request, unsigned char *response,
 }
 
 static void
-storage_get_sel_time (unsigned char *response, unsigned char *res_len)
+storage_get_sel_time (unsigned char *request, unsigned char req_len,
+                      unsigned char *response, unsigned char *res_len)
 {
   ipmi_res_t *res = (ipmi_res_t *) response;
 
@@ -1321,7 +1359,8 @@ storage_get_sel_time (unsigned char *response, unsigned char *res_len)
 }
 
 static void
-storage_get_sel_utc (unsigned char *response, unsigned char *res_len)
+storage_get_sel_utc (unsigned char *request, unsigned char req_len,
+                     unsigned char *response, unsigned char *res_len)
 {
   ipmi_res_t *res = (ipmi_res_t *) response;
   unsigned char *data = &res->data[0];
@@ -1337,67 +1376,26 @@ storage_get_sel_utc (unsigned char *response, unsigned char *res_len)
   *res_len = data - &res->data[0];
 }
 
-static void
-ipmi_handle_storage (unsigned char *request, unsigned char req_len,
-         unsigned char *response, unsigned char *res_len)
-{
-  ipmi_mn_req_t *req = (ipmi_mn_req_t *) request;
-  ipmi_res_t *res = (ipmi_res_t *) response;
-  unsigned char cmd = req->cmd;
-
-  res->cc = CC_SUCCESS;
-  *res_len = 0;
-
-  pthread_mutex_lock(&m_storage);
-  switch (cmd)
-  {
-    case CMD_STORAGE_GET_FRUID_INFO:
-      storage_get_fruid_info (request, response, res_len);
-      break;
-    case CMD_STORAGE_READ_FRUID_DATA:
-      storage_get_fruid_data (request, response, res_len);
-      break;
-    case CMD_STORAGE_GET_SEL_INFO:
-      storage_get_sel_info (request, response, res_len);
-      break;
-    case CMD_STORAGE_RSV_SEL:
-      storage_rsv_sel (request, response, res_len);
-      break;
-    case CMD_STORAGE_ADD_SEL:
-      storage_add_sel (request, response, res_len);
-      break;
-    case CMD_STORAGE_GET_SEL:
-      storage_get_sel (request, response, res_len);
-      break;
-    case CMD_STORAGE_CLR_SEL:
-      storage_clr_sel (request, response, res_len);
-      break;
+// FRU reads are served from the FRU cache, which has its own lock
+static const ipmi_cmd_t storage_cmds[] = {
+  {CMD_STORAGE_GET_FRUID_INFO, LOCK_NONE, "get_fruid_info",
+   storage_get_fruid_info},
+  {CMD_STORAGE_READ_FRUID_DATA, LOCK_NONE, "read_fruid_data",
+   storage_get_fruid_data},
+  {CMD_STORAGE_GET_SEL_INFO, LOCK_NETFN, "get_sel_info", storage_get_sel_info},
+  {CMD_STORAGE_RSV_SEL, LOCK_NETFN, "rsv_sel", storage_rsv_sel},
+  {CMD_STORAGE_ADD_SEL, LOCK_NETFN, "add_sel", storage_add_sel},
+  {CMD_STORAGE_GET_SEL, LOCK_NETFN, "get_sel", storage_get_sel},
+  {CMD_STORAGE_CLR_SEL, LOCK_NETFN, "clr_sel", storage_clr_sel},
 #if 0 // To avoid BIOS using this command to update RTC
       // TBD: Respond only if BMC's time has synced with NTP
-    case CMD_STORAGE_GET_SEL_TIME:
-      storage_get_sel_time (response, res_len);
-      break;
+  {CMD_STORAGE_GET_SEL_TIME, LOCK_NETFN, "get_sel_time", storage_get_sel_time},
 #endif
-    case CMD_STORAGE_GET_SEL_UTC:
-      storage_get_sel_utc (response, res_len);
-      break;
-    case CMD_STORAGE_GET_SDR_INFO:
-      storage_get_sdr_info (response, res_len);
-      break;
-    case CMD_STORAGE_RSV_SDR:
-      storage_rsv_sdr (request, response, res_len);
-      break;
-    case CMD_STORAGE_GET_SDR:
-      storage_get_sdr (request, response, res_len);
-      break;
-    default:
-      res->cc = CC_INVALID_CMD;
-      break;
-  }
-
-  pthread_mutex_unlock(&m_storage);
-  return;
-}
+  {CMD_STORAGE_GET_SEL_UTC, LOCK_NETFN, "get_sel_utc", storage_get_sel_utc},
+  {CMD_STORAGE_GET_SDR_INFO, LOCK_NETFN, "get_sdr_info", storage_get_sdr_info},
+  {CMD_STORAGE_RSV_SDR, LOCK_NETFN, "rsv_sdr", storage_rsv_sdr},
+  {CMD_STORAGE_GET_SDR, LOCK_NETFN, "get_sdr", storage_get_sdr},
+};
 
 /*
  * Function(s) to handle IPMI messages with NetFn: Transport
@@ -1405,8 +1403,8 @@ ipmi_handle_storage (unsigned char *request, unsigned char req_len,
 
 // Set LAN Configuration (IPMI/Section 23.1)
 static void
-transport_set_lan_config (unsigned char *request, unsigned char *response,
-        unsigned char *res_len)
+transport_set_lan_config (unsigned char *request, unsigned char req_len,
+                          unsigned char *response, unsigned char *res_len)
 {
   ipmi_mn_req_t *req = (ipmi_mn_req_t *) request;
   ipmi_res_t *res = (ipmi_res_t *) response;
@@ -1490,8 +1488,8 @@ transport_set_lan_config (unsigned char *request, unsigned char *response,
 
 // Get LAN Configuration (IPMI/Section 23.2)
 static void
-transport_get_lan_config (unsigned char *request, unsigned char *response,
-        unsigned char *res_len)
+transport_get_lan_config (unsigned char *request, unsigned char req_len,
+                          unsigned char *response, unsigned char *res_len)
 {
 
   ipmi_mn_req_t *req = (ipmi_mn_req_t *) request;
@@ -1610,8 +1608,8 @@ transport_get_lan_config (unsigned char *request, unsigned char *response,
 
 // Get SoL Configuration (IPMI/Section 26.3)
 static void
-transport_get_sol_config (unsigned char *request, unsigned char *response,
-        unsigned char *res_len)
+transport_get_sol_config (unsigned char *request, unsigned char req_len,
+                          unsigned char *response, unsigned char *res_len)
 {
 
   ipmi_mn_req_t *req = (ipmi_mn_req_t *) request;
@@ -1656,33 +1654,15 @@ transport_get_sol_config (unsigned char *request, unsigned char *response,
   }
 }
 
-// Handle Transport Commands (IPMI/Section 23)
-static void
-ipmi_handle_transport (unsigned char *request, unsigned char req_len,
-           unsigned char *response, unsigned char *res_len)
-{
-  ipmi_mn_req_t *req = (ipmi_mn_req_t *) request;
-  ipmi_res_t *res = (ipmi_res_t *) response;
-  unsigned char cmd = req->cmd;
-
-  pthread_mutex_lock(&m_transport);
-  switch (cmd)
-  {
-    case CMD_TRANSPORT_SET_LAN_CONFIG:
-      transport_set_lan_config (request, response, res_len);
-      break;
-    case CMD_TRANSPORT_GET_LAN_CONFIG:
-      transport_get_lan_config (request, response, res_len);
-      break;
-    case CMD_TRANSPORT_GET_SOL_CONFIG:
-      transport_get_sol_config (request, response, res_len);
-      break;
-    default:
-      res->cc = CC_INVALID_CMD;
-      break;
-  }
-  pthread_mutex_unlock(&m_transport);
-}
+// Transport Commands (IPMI/Section 23)
+static const ipmi_cmd_t transport_cmds[] = {
+  {CMD_TRANSPORT_SET_LAN_CONFIG, LOCK_NETFN, "set_lan_config",
+   transport_set_lan_config},
+  {CMD_TRANSPORT_GET_LAN_CONFIG, LOCK_NETFN, "get_lan_config",
+   transport_get_lan_config},
+  {CMD_TRANSPORT_GET_SOL_CONFIG, LOCK_NETFN, "get_sol_config",
+   transport_get_sol_config},
+};
 
 /*
  * Function(s) to handle IPMI messages with NetFn: DCMI
@@ -1717,8 +1697,8 @@ ipmi_handle_dcmi(unsigned char *request, unsigned char req_len,
  * Function(s) to handle IPMI messages with NetFn: OEM
  */
 static void
-oem_set_proc_info (unsigned char *request, unsigned char *response,
-       unsigned char *res_len)
+oem_set_proc_info (unsigned char *request, unsigned char req_len,
+                   unsigned char *response, unsigned char *res_len)
 {
   ipmi_mn_req_t *req = (ipmi_mn_req_t *) request;
   ipmi_res_t *res = (ipmi_res_t *) response;
@@ -1732,8 +1712,8 @@ oem_set_proc_info (unsigned char *request, unsigned char *response,
 }
 
 static void
-oem_set_dimm_info (unsigned char *request, unsigned char *response,
-       unsigned char *res_len)
+oem_set_dimm_info (unsigned char *request, unsigned char req_len,
+                   unsigned char *response, unsigned char *res_len)
 {
   ipmi_mn_req_t *req = (ipmi_mn_req_t *) request;
   ipmi_res_t *res = (ipmi_res_t *) response;
@@ -1977,33 +1957,20 @@ oem_set_boot_order(unsigned char *request, unsigned char req_len,
   ipmi_mn_req_t *req = (ipmi_mn_req_t *) request;
   ipmi_res_t *res = (ipmi_res_t *) response;
 
-  int RetVal;
   int ret;
-  static pthread_t bios_timer_tid[MAX_NODES];
-
-  if ( IsTimerStart[req->payload_id - 1] )
-  {
-#ifdef DEBUG
-    syslog(LOG_WARNING, "[%s] Close the previous thread\n", __func__);
-#endif
-    pthread_cancel(bios_timer_tid[req->payload_id - 1]);
-  }
-
-  /*Create timer thread*/
-  RetVal = pthread_create( &bios_timer_tid[req->payload_id - 1], NULL, clear_bios_data_timer, &req->payload_id );
 
-  if ( RetVal < 0 )
-  {
-    syslog(LOG_WARNING, "[%s] Create BIOS timer thread failed!\n", __func__);
-
-    res->cc = CC_NODE_BUSY;
+  if (req->payload_id < 1 || req->payload_id > MAX_NODES) {
+    res->cc = CC_PARAM_OUT_OF_RANGE;
     *res_len = 0;
     return;
   }
 
-  IsTimerStart[req->payload_id - 1] = true;
+  pthread_mutex_lock(&m_boot_order);
+  // (Re)start the timer to clear the BIOS flags
+  tmr_start(&bios_timer[req->payload_id - 1], BIOS_Timeout * 1000);
 
   ret = pal_set_boot_order(req->payload_id, req->data, res->data, res_len);
+  pthread_mutex_unlock(&m_boot_order);
 
   if(ret == 0)
   {
@@ -2023,7 +1990,9 @@ oem_get_boot_order(unsigned char *request, unsigned char req_len,
   ipmi_res_t *res = (ipmi_res_t *) response;
   int RetVal;
 
+  pthread_mutex_lock(&m_boot_order);
   RetVal = pal_get_boot_order(req->payload_id, req->data, res->data, res_len);
+  pthread_mutex_unlock(&m_boot_order);
 
 #ifdef DEBUG
   syslog(LOG_WARNING, "[%s] Get: %x %x %x %x %x %x\n", __func__, res->data[0], res->data[1], res->data[2], res->data[3], res->data[4], res->data[5]);
@@ -2286,8 +2255,8 @@ oem_get_ppr (unsigned char *request, unsigned char req_len,
 }
 
 static void
-oem_set_post_start (unsigned char *request, unsigned char *response,
-                  unsigned char *res_len)
+oem_set_post_start (unsigned char *request, unsigned char req_len,
+                    unsigned char *response, unsigned char *res_len)
 {
   ipmi_mn_req_t *req = (ipmi_mn_req_t *) request;
   ipmi_res_t *res = (ipmi_res_t *) response;
@@ -2298,8 +2267,8 @@ oem_set_post_start (unsigned char *request, unsigned char *response,
 }
 
 static void
-oem_set_post_end (unsigned char *request, unsigned char *response,
-                unsigned char *res_len)
+oem_set_post_end (unsigned char *request, unsigned char req_len,
+                  unsigned char *response, unsigned char *res_len)
 {
   ipmi_mn_req_t *req = (ipmi_mn_req_t *) request;
   ipmi_res_t *res = (ipmi_res_t *) response;
@@ -2323,8 +2292,8 @@ oem_set_ppin_info(unsigned char *request, unsigned char req_len,
 }
 
 static void
-oem_get_plat_info(unsigned char *request, unsigned char *response,
-                  unsigned char *res_len)
+oem_get_plat_info(unsigned char *request, unsigned char req_len,
+                  unsigned char *response, unsigned char *res_len)
 {
   ipmi_mn_req_t *req = (ipmi_mn_req_t *) request;
   ipmi_res_t *res = (ipmi_res_t *) response;
@@ -2432,105 +2401,35 @@ oem_set_machine_config_info ( unsigned char *request, unsigned char req_len,
   *res_len = 0;
 }
 
-static void
-ipmi_handle_oem (unsigned char *request, unsigned char req_len,
-     unsigned char *response, unsigned char *res_len)
-{
-  ipmi_mn_req_t *req = (ipmi_mn_req_t *) request;
-  ipmi_res_t *res = (ipmi_res_t *) response;
-
-  unsigned char cmd = req->cmd;
-
-  pthread_mutex_lock(&m_oem);
-  switch (cmd)
-  {
-    case CMD_OEM_SET_PROC_INFO:
-      oem_set_proc_info (request, response, res_len);
-      break;
-    case CMD_OEM_SET_DIMM_INFO:
-      oem_set_dimm_info (request, response, res_len);
-      break;
-    case CMD_OEM_SET_BOOT_ORDER:
-      oem_set_boot_order(request, req_len, response, res_len);
-      break;
-    case CMD_OEM_GET_BOOT_ORDER:
-      oem_get_boot_order(request, req_len, response, res_len);
-      break;
-    case CMD_OEM_SET_PPR:
-      oem_set_ppr (request, req_len, response, res_len);
-      break;
-    case CMD_OEM_GET_PPR:
-      oem_get_ppr (request, req_len, response, res_len);
-      break;
-    case CMD_OEM_SET_POST_START:
-      oem_set_post_start (request, response, res_len);
-      break;
-    case CMD_OEM_SET_POST_END:
-      oem_set_post_end (request, response, res_len);
-      break;
-    case CMD_OEM_SET_PPIN_INFO:
-      oem_set_ppin_info (request, req_len, response, res_len);
-      break;
-    case CMD_OEM_GET_PLAT_INFO:
-      oem_get_plat_info (request, response, res_len);
-      break;
-    case CMD_OEM_GET_PCIE_CONFIG:
-      oem_get_poss_pcie_config (request, req_len, response, res_len);
-      break;
-    case CMD_OEM_GET_BOARD_ID:
-      oem_get_board_id (request, req_len, response, res_len);
-      break;
-    case CMD_OEM_GET_80PORT_RECORD:
-      oem_get_80port_record (request, req_len, response, res_len);
-      break;
-    case CMD_OEM_GET_FW_INFO:
-      oem_get_fw_info (request, req_len, response, res_len);
-      break;
-    case CMD_OEM_SET_MACHINE_CONFIG_INFO:
-      oem_set_machine_config_info (request, req_len, response, res_len);
-      break;
-    default:
-      res->cc = CC_INVALID_CMD;
-      break;
-  }
-  pthread_mutex_unlock(&m_oem);
-}
-
-static void
-ipmi_handle_oem_q (unsigned char *request, unsigned char req_len,
-     unsigned char *response, unsigned char *res_len)
-{
-  ipmi_mn_req_t *req = (ipmi_mn_req_t *) request;
-  ipmi_res_t *res = (ipmi_res_t *) response;
+static const ipmi_cmd_t oem_cmds[] = {
+  {CMD_OEM_SET_PROC_INFO, LOCK_NETFN, "set_proc_info", oem_set_proc_info},
+  {CMD_OEM_SET_DIMM_INFO, LOCK_NETFN, "set_dimm_info", oem_set_dimm_info},
+  {CMD_OEM_SET_BOOT_ORDER, LOCK_NETFN, "set_boot_order", oem_set_boot_order},
+  {CMD_OEM_GET_BOOT_ORDER, LOCK_NETFN, "get_boot_order", oem_get_boot_order},
+  {CMD_OEM_SET_PPR, LOCK_NETFN, "set_ppr", oem_set_ppr},
+  {CMD_OEM_GET_PPR, LOCK_NETFN, "get_ppr", oem_get_ppr},
+  {CMD_OEM_SET_POST_START, LOCK_NETFN, "set_post_start", oem_set_post_start},
+  {CMD_OEM_SET_POST_END, LOCK_NETFN, "set_post_end", oem_set_post_end},
+  {CMD_OEM_SET_PPIN_INFO, LOCK_NETFN, "set_ppin_info", oem_set_ppin_info},
+  {CMD_OEM_GET_PLAT_INFO, LOCK_NETFN, "get_plat_info", oem_get_plat_info},
+  {CMD_OEM_GET_PCIE_CONFIG, LOCK_NETFN, "get_pcie_config",
+   oem_get_poss_pcie_config},
+  {CMD_OEM_GET_BOARD_ID, LOCK_NETFN, "get_board_id", oem_get_board_id},
+  {CMD_OEM_GET_80PORT_RECORD, LOCK_NETFN, "get_80port_record",
+   oem_get_80port_record},
+  {CMD_OEM_GET_FW_INFO, LOCK_NETFN, "get_fw_info", oem_get_fw_info},
+  {CMD_OEM_SET_MACHINE_CONFIG_INFO, LOCK_NETFN, "set_machine_config_info",
+   oem_set_machine_config_info},
+};
 
-  unsigned char cmd = req->cmd;
-  pthread_mutex_lock(&m_oem_q);
-  switch (cmd)
-  {
-    case CMD_OEM_Q_SET_PROC_INFO:
-      oem_q_set_proc_info (request, req_len, response, res_len);
-      break;
-    case CMD_OEM_Q_GET_PROC_INFO:
-      oem_q_get_proc_info (request, req_len, response, res_len);
-      break;
-    case CMD_OEM_Q_SET_DIMM_INFO:
-      oem_q_set_dimm_info (request, req_len, response, res_len);
-      break;
-    case CMD_OEM_Q_GET_DIMM_INFO:
-      oem_q_get_dimm_info (request, req_len, response, res_len);
-      break;
-    case CMD_OEM_Q_SET_DRIVE_INFO:
-      oem_q_set_drive_info (request, req_len, response, res_len);
-      break;
-    case CMD_OEM_Q_GET_DRIVE_INFO:
-      oem_q_get_drive_info (request, req_len, response, res_len);
-      break;
-    default:
-      res->cc = CC_INVALID_CMD;
-      break;
-  }
-  pthread_mutex_unlock(&m_oem_q);
-}
+static const ipmi_cmd_t oem_q_cmds[] = {
+  {CMD_OEM_Q_SET_PROC_INFO, LOCK_NETFN, "set_proc_info", oem_q_set_proc_info},
+  {CMD_OEM_Q_GET_PROC_INFO, LOCK_NETFN, "get_proc_info", oem_q_get_proc_info},
+  {CMD_OEM_Q_SET_DIMM_INFO, LOCK_NETFN, "set_dimm_info", oem_q_set_dimm_info},
+  {CMD_OEM_Q_GET_DIMM_INFO, LOCK_NETFN, "get_dimm_info", oem_q_get_dimm_info},
+  {CMD_OEM_Q_SET_DRIVE_INFO, LOCK_NETFN, "set_drive_info", oem_q_set_drive_info},
+  {CMD_OEM_Q_GET_DRIVE_INFO, LOCK_NETFN, "get_drive_info", oem_q_get_drive_info},
+};
 
 static void
 oem_1s_handle_ipmb_kcs(unsigned char *request, unsigned char req_len,
@@ -2607,102 +2506,117 @@ oem_1s_handle_ipmb_req(unsigned char *request, unsigned char req_len,
 }
 
 static void
-ipmi_handle_oem_1s(unsigned char *request, unsigned char req_len,
-     unsigned char *response, unsigned char *res_len)
+oem_1s_intr(unsigned char *request, unsigned char req_len,
+            unsigned char *response, unsigned char *res_len)
+{
+  ipmi_mn_req_t *req = (ipmi_mn_req_t *) request;
+  ipmi_res_t *res = (ipmi_res_t *) response;
+
+  syslog(LOG_INFO, "ipmi_handle_oem_1s: 1S server interrupt#%d received "
+            "for payload#%d\n", req->data[3], req->payload_id);
+
+  res->cc = CC_SUCCESS;
+  memcpy(res->data, req->data, SIZE_IANA_ID); //IANA ID
+  *res_len = 3;
+}
+
+static void
+oem_1s_post_buf(unsigned char *request, unsigned char req_len,
+                unsigned char *response, unsigned char *res_len)
 {
   ipmi_mn_req_t *req = (ipmi_mn_req_t *) request;
   ipmi_res_t *res = (ipmi_res_t *) response;
   int i;
 
-  unsigned char cmd = req->cmd;
+  // Skip the first 3 bytes of IANA ID and one byte of length field
+  for (i = SIZE_IANA_ID+1; i <= req->data[SIZE_IANA_ID]+SIZE_IANA_ID; i++) {
+    pal_post_handle(req->payload_id, req->data[i]);
+  }
+
+  res->cc = CC_SUCCESS;
+  memcpy(res->data, req->data, SIZE_IANA_ID); //IANA ID
+  *res_len = 3;
+}
 
-  pthread_mutex_lock(&m_oem_1s);
-  switch (cmd)
-  {
-    case CMD_OEM_1S_MSG_IN:
-      // Add unlock-lock mechanism whenever BIC send second NetFn 0x38 to BMC.
-      // Avoid deadlock of the same NetFn.
-      if (req->data[4] == (NETFN_OEM_1S_REQ << 2)) {
-        pthread_mutex_unlock(&m_oem_1s);
-      }
-      oem_1s_handle_ipmb_req(request, req_len, response, res_len);
-      if (req->data[4] == (NETFN_OEM_1S_REQ << 2)) {
-        pthread_mutex_lock(&m_oem_1s);
-      }
-      break;
-    case CMD_OEM_1S_INTR:
-      syslog(LOG_INFO, "ipmi_handle_oem_1s: 1S server interrupt#%d received "
-                "for payload#%d\n", req->data[3], req->payload_id);
+static void
+oem_1s_plat_disc(unsigned char *request, unsigned char req_len,
+                 unsigned char *response, unsigned char *res_len)
+{
+  ipmi_mn_req_t *req = (ipmi_mn_req_t *) request;
+  ipmi_res_t *res = (ipmi_res_t *) response;
 
-      res->cc = CC_SUCCESS;
-      memcpy(res->data, req->data, SIZE_IANA_ID); //IANA ID
-      *res_len = 3;
-      break;
-    case CMD_OEM_1S_POST_BUF:
-      // Skip the first 3 bytes of IANA ID and one byte of length field
-      for (i = SIZE_IANA_ID+1; i <= req->data[SIZE_IANA_ID]+SIZE_IANA_ID; i++) {
-        pal_post_handle(req->payload_id, req->data[i]);
-      }
+  syslog(LOG_INFO, "ipmi_handle_oem_1s: Platform Discovery received for "
+            "payload#%d\n", req->payload_id);
+  res->cc = CC_SUCCESS;
+  memcpy(res->data, req->data, SIZE_IANA_ID); //IANA ID
+  *res_len = 3;
+}
 
-      res->cc = CC_SUCCESS;
-      memcpy(res->data, req->data, SIZE_IANA_ID); //IANA ID
-      *res_len = 3;
-      break;
-    case CMD_OEM_1S_PLAT_DISC:
-      syslog(LOG_INFO, "ipmi_handle_oem_1s: Platform Discovery received for "
-                "payload#%d\n", req->payload_id);
-      res->cc = CC_SUCCESS;
-      memcpy(res->data, req->data, SIZE_IANA_ID); //IANA ID
-      *res_len = 3;
-      break;
-    case CMD_OEM_1S_BIC_RESET:
-      syslog(LOG_INFO, "ipmi_handle_oem_1s: BIC Reset received "
-                "for payload#%d\n", req->payload_id);
+static void
+oem_1s_bic_reset(unsigned char *request, unsigned char req_len,
+                 unsigned char *response, unsigned char *res_len)
+{
+  ipmi_mn_req_t *req = (ipmi_mn_req_t *) request;
+  ipmi_res_t *res = (ipmi_res_t *) response;
 
-      if (req->data[3] == 0x0) {
-         syslog(LOG_WARNING, "Cold Reset by Firmware Update\n");
-         res->cc = CC_SUCCESS;
-      } else if (req->data[3] == 0x01) {
-         syslog(LOG_WARNING, "WDT Reset\n");
-         res->cc = CC_SUCCESS;
-      } else {
-         syslog(LOG_WARNING, "Error\n");
-         res->cc = CC_INVALID_PARAM;
-      }
+  syslog(LOG_INFO, "ipmi_handle_oem_1s: BIC Reset received "
+            "for payload#%d\n", req->payload_id);
+
+  if (req->data[3] == 0x0) {
+     syslog(LOG_WARNING, "Cold Reset by Firmware Update\n");
+     res->cc = CC_SUCCESS;
+  } else if (req->data[3] == 0x01) {
+     syslog(LOG_WARNING, "WDT Reset\n");
+     res->cc = CC_SUCCESS;
+  } else {
+     syslog(LOG_WARNING, "Error\n");
+     res->cc = CC_INVALID_PARAM;
+  }
+
+  memcpy(res->data, req->data, SIZE_IANA_ID); //IANA ID
+  *res_len = 3;
+}
+
+static void
+oem_1s_bic_update_mode(unsigned char *request, unsigned char req_len,
+                       unsigned char *response, unsigned char *res_len)
+{
+  ipmi_mn_req_t *req = (ipmi_mn_req_t *) request;
+  ipmi_res_t *res = (ipmi_res_t *) response;
 
-      memcpy(res->data, req->data, SIZE_IANA_ID); //IANA ID
-      *res_len = 3;
-      break;
-    case CMD_OEM_1S_BIC_UPDATE_MODE:
 #ifdef DEBUG
-      syslog(LOG_INFO, "ipmi_handle_oem_1s: BIC Update Mode received "
-                "for payload#%d\n", req->payload_id);
+  syslog(LOG_INFO, "ipmi_handle_oem_1s: BIC Update Mode received "
+            "for payload#%d\n", req->payload_id);
 #endif
-      if (req->data[3] == 0x1) {
-         syslog(LOG_INFO, "BIC Mode: Normal\n");
-         res->cc = CC_SUCCESS;
-      } else if (req->data[3] == 0x0F) {
-         syslog(LOG_INFO, "BIC Mode: Update\n");
-         res->cc = CC_SUCCESS;
-      } else {
-         syslog(LOG_WARNING, "Error\n");
-         res->cc = CC_INVALID_PARAM;
-      }
+  if (req->data[3] == 0x1) {
+     syslog(LOG_INFO, "BIC Mode: Normal\n");
+     res->cc = CC_SUCCESS;
+  } else if (req->data[3] == 0x0F) {
+     syslog(LOG_INFO, "BIC Mode: Update\n");
+     res->cc = CC_SUCCESS;
+  } else {
+     syslog(LOG_WARNING, "Error\n");
+     res->cc = CC_INVALID_PARAM;
+  }
 
-      pal_inform_bic_mode(req->payload_id, req->data[3]);
+  pal_inform_bic_mode(req->payload_id, req->data[3]);
 
-      memcpy(res->data, req->data, SIZE_IANA_ID); //IANA ID
-      *res_len = 3;
-      break;
-    default:
-      res->cc = CC_INVALID_CMD;
-      memcpy(res->data, req->data, SIZE_IANA_ID); //IANA ID
-      *res_len = 3;
-      break;
-  }
-  pthread_mutex_unlock(&m_oem_1s);
+  memcpy(res->data, req->data, SIZE_IANA_ID); //IANA ID
+  *res_len = 3;
 }
 
+// Bridged requests take the lock of the command they carry, which may
+// itself be an OEM 1S command
+static const ipmi_cmd_t oem_1s_cmds[] = {
+  {CMD_OEM_1S_MSG_IN, LOCK_NONE, "msg_in", oem_1s_handle_ipmb_req},
+  {CMD_OEM_1S_INTR, LOCK_NETFN, "intr", oem_1s_intr},
+  {CMD_OEM_1S_POST_BUF, LOCK_NETFN, "post_buf", oem_1s_post_buf},
+  {CMD_OEM_1S_PLAT_DISC, LOCK_NETFN, "plat_disc", oem_1s_plat_disc},
+  {CMD_OEM_1S_BIC_RESET, LOCK_NETFN, "bic_reset", oem_1s_bic_reset},
+  {CMD_OEM_1S_BIC_UPDATE_MODE, LOCK_NETFN, "bic_update_mode",
+   oem_1s_bic_update_mode},
+};
+
 static void
 oem_usb_dbg_get_frame_info(unsigned char *request, unsigned char req_len,
        unsigned char *response, unsigned char *res_len)
@@ -2861,42 +2775,18 @@ oem_usb_dbg_get_frame_data(unsigned char *request, unsigned char req_len,
   *res_len = SIZE_IANA_ID + 4 + count;
 }
 
-static void
-ipmi_handle_oem_usb_dbg(unsigned char *request, unsigned char req_len,
-     unsigned char *response, unsigned char *res_len)
-{
-  ipmi_mn_req_t *req = (ipmi_mn_req_t *) request;
-  ipmi_res_t *res = (ipmi_res_t *) response;
-  int i;
-
-  unsigned char cmd = req->cmd;
-
-  pthread_mutex_lock(&m_oem_usb_dbg);
-  switch (cmd)
-  {
-    case CMD_OEM_USB_DBG_GET_FRAME_INFO:
-      oem_usb_dbg_get_frame_info(request, req_len, response, res_len);
-      break;
-    case CMD_OEM_USB_DBG_GET_UPDATED_FRAMES:
-      oem_usb_dbg_get_updated_frames(request, req_len, response, res_len);
-      break;
-    case CMD_OEM_USB_DBG_GET_POST_DESC:
-      oem_usb_dbg_get_post_desc(request, req_len, response, res_len);
-      break;
-    case CMD_OEM_USB_DBG_GET_GPIO_DESC:
-      oem_usb_dbg_get_gpio_desc(request, req_len, response, res_len);
-      break;
-    case CMD_OEM_USB_DBG_GET_FRAME_DATA:
-      oem_usb_dbg_get_frame_data(request, req_len, response, res_len);
-      break;
-    default:
-      res->cc = CC_INVALID_CMD;
-      memcpy(res->data, req->data, SIZE_IANA_ID); //IANA ID
-      *res_len = 3;
-      break;
-  }
-  pthread_mutex_unlock(&m_oem_usb_dbg);
-}
+static const ipmi_cmd_t oem_usb_dbg_cmds[] = {
+  {CMD_OEM_USB_DBG_GET_FRAME_INFO, LOCK_NETFN, "get_frame_info",
+   oem_usb_dbg_get_frame_info},
+  {CMD_OEM_USB_DBG_GET_UPDATED_FRAMES, LOCK_NETFN, "get_updated_frames",
+   oem_usb_dbg_get_updated_frames},
+  {CMD_OEM_USB_DBG_GET_POST_DESC, LOCK_NETFN, "get_post_desc",
+   oem_usb_dbg_get_post_desc},
+  {CMD_OEM_USB_DBG_GET_GPIO_DESC, LOCK_NETFN, "get_gpio_desc",
+   oem_usb_dbg_get_gpio_desc},
+  {CMD_OEM_USB_DBG_GET_FRAME_DATA, LOCK_NETFN, "get_frame_data",
+   oem_usb_dbg_get_frame_data},
+};
 
 /*
  * Function to handle all IPMI messages
@@ -2912,57 +2802,12 @@ ipmi_handle (unsigned char *request, unsigned char req_len,
   netfn = req->netfn_lun >> 2;
 
   // Provide default values in the response message
+  res->netfn_lun = (netfn + 1) << 2;
   res->cmd = req->cmd;
   res->cc = 0xFF;   // Unspecified completion code
-  printf("ipmi_handle netfn %x cmd %x len %d\n", netfn, req->cmd, req_len);
   *(unsigned short*)res_len = 0;
 
-  switch (netfn)
-  {
-    case NETFN_CHASSIS_REQ:
-      res->netfn_lun = NETFN_CHASSIS_RES << 2;
-      ipmi_handle_chassis (request, req_len, response, res_len);
-      break;
-    case NETFN_SENSOR_REQ:
-      res->netfn_lun = NETFN_SENSOR_RES << 2;
-      ipmi_handle_sensor (request, req_len, response, res_len);
-      break;
-    case NETFN_APP_REQ:
-      res->netfn_lun = NETFN_APP_RES << 2;
-      ipmi_handle_app (request, req_len, response, res_len);
-      break;
-    case NETFN_STORAGE_REQ:
-      res->netfn_lun = NETFN_STORAGE_RES << 2;
-      ipmi_handle_storage (request, req_len, response, res_len);
-      break;
-    case NETFN_TRANSPORT_REQ:
-      res->netfn_lun = NETFN_TRANSPORT_RES << 2;
-      ipmi_handle_transport (request, req_len, response, res_len);
-      break;
-    case NETFN_DCMI_REQ:
-      res->netfn_lun = NETFN_DCMI_RES << 2;
-      ipmi_handle_dcmi(request, req_len, response, res_len);
-      break;
-    case NETFN_OEM_REQ:
-      res->netfn_lun = NETFN_OEM_RES << 2;
-      ipmi_handle_oem (request, req_len, response, res_len);
-      break;
-    case NETFN_OEM_Q_REQ:
-      res->netfn_lun = NETFN_OEM_Q_RES << 2;
-      ipmi_handle_oem_q (request, req_len, response, res_len);
-      break;
-    case NETFN_OEM_1S_REQ:
-      res->netfn_lun = NETFN_OEM_1S_RES << 2;
-      ipmi_handle_oem_1s(request, req_len, response, res_len);
-      break;
-    case NETFN_OEM_USB_DBG_REQ:
-      res->netfn_lun = NETFN_OEM_USB_DBG_RES << 2;
-      ipmi_handle_oem_usb_dbg(request, req_len, response, res_len);
-      break;
-    default:
-      res->netfn_lun = (netfn + 1) << 2;
-      break;
-  }
+  ipmi_dispatch(request, req_len, response, res_len);
 
   // This header includes NetFunction, Command, and Completion Code
   *(unsigned short*)res_len += IPMI_RESP_HDR_SIZE;
@@ -2970,6 +2815,29 @@ ipmi_handle (unsigned char *request, unsigned char req_len,
   return;
 }
 
+#define REGISTER_NETFN(netfn, flags, cmds) \
+  ipmi_dispatch_register(netfn, flags, cmds, sizeof(cmds) / sizeof(cmds[0]), NULL)
+
+static int
+ipmi_register_handlers(void)
+{
+  int ret = 0;
+
+  ret |= REGISTER_NETFN(NETFN_CHASSIS_REQ, 0, chassis_cmds);
+  ret |= REGISTER_NETFN(NETFN_SENSOR_REQ, 0, sensor_cmds);
+  ret |= REGISTER_NETFN(NETFN_APP_REQ, 0, app_cmds);
+  ret |= REGISTER_NETFN(NETFN_STORAGE_REQ, NETFN_PRESET_CC, storage_cmds);
+  ret |= REGISTER_NETFN(NETFN_TRANSPORT_REQ, 0, transport_cmds);
+  // DCMI handling is specific to platform, every command goes to PAL
+  ret |= ipmi_dispatch_register(NETFN_DCMI_REQ, 0, NULL, 0, ipmi_handle_dcmi);
+  ret |= REGISTER_NETFN(NETFN_OEM_REQ, 0, oem_cmds);
+  ret |= REGISTER_NETFN(NETFN_OEM_Q_REQ, 0, oem_q_cmds);
+  ret |= REGISTER_NETFN(NETFN_OEM_1S_REQ, NETFN_ECHO_IANA, oem_1s_cmds);
+  ret |= REGISTER_NETFN(NETFN_OEM_USB_DBG_REQ, NETFN_ECHO_IANA, oem_usb_dbg_cmds);
+
+  return ret;
+}
+
 void
 *conn_handler(void *socket_desc) {
   int *p_sock = (int*)socket_desc;
@@ -2979,6 +2847,7 @@ void
   unsigned char res_buf[MAX_IPMI_MSG_SIZE];
   unsigned short res_len = 0;
   struct timeval tv;
+  uint64_t start;
   int rc = 0;
 
   // setup timeout for receving on socket
@@ -2994,7 +2863,9 @@ void
       goto conn_cleanup;
   }
 
+  start = ipmi_trace_start(g_trace);
   ipmi_handle(req_buf, n, res_buf, (unsigned char*)&res_len);
+  ipmi_trace_end(g_trace, start, req_buf, n, res_buf, res_len);
 
   if (send (sock, res_buf, res_len, 0) < 0) {
     syslog(LOG_WARNING, "ipmid: send() failed\n");
@@ -3008,80 +2879,120 @@ conn_cleanup:
   return 0;
 }
 
-void *
-wdt_timer (void *arg) {
+static void
+wdt_timeout(tmr_t *t, void *arg) {
   int ret;
   struct watchdog_data *wdt = (struct watchdog_data *)arg;
   uint8_t status;
-  char timer_use[32];
   int action = 0;
 
-  while (1) {
-    usleep(100*1000);
-    pthread_mutex_lock(&wdt->mutex);
-    if (wdt->valid && wdt->run) {
+  pthread_mutex_lock(&wdt->mutex);
+  // Reset or stopped while the timer thread was getting here
+  if (!wdt->valid || !wdt->run || tmr_pending(t)) {
+    pthread_mutex_unlock(&wdt->mutex);
+    return;
+  }
+  wdt->run = 0;
+  wdt->present_count_down = 0;
 
-      // Check if power off
-      ret = pal_get_server_power(wdt->slot, &status);
-      if ((ret >= 0) && (status == SERVER_POWER_OFF)) {
-        wdt->run = 0;
-        pthread_mutex_unlock(&wdt->mutex);
-        continue;
-      }
+  // No timeout action while the server is off
+  ret = pal_get_server_power(wdt->slot, &status);
+  if ((ret >= 0) && (status == SERVER_POWER_OFF)) {
+    pthread_mutex_unlock(&wdt->mutex);
+    timer_state_dump();
+    return;
+  }
 
-      // count down; counter 0 and run associated timer events occur immediately
-      if (wdt->present_count_down)
-        wdt->present_count_down--;
+  // Timeout
+  wdt->expiration |= (1 << wdt->use);
 
-      // Pre-timeout no support
-      /*
-      if (wdt->present_count_down == wdt->pre_interval*10) {
-      }
-      */
+  // Execute actin out of mutex
+  action = wdt->action;
 
-      // Timeout
-      if (wdt->present_count_down == 0) {
-        wdt->expiration |= (1 << wdt->use);
+  if (wdt->no_log) {
+    wdt->no_log = 0;
+  }
+  else {
+    syslog(LOG_CRIT, "%s Watchdog %s",
+      wdt_use_name[wdt->use & 0x7],
+      wdt_action_name[action & 0x7]);
+  }
+  pthread_mutex_unlock(&wdt->mutex);
 
-        // Execute actin out of mutex
-        action = wdt->action;
+  // Execute actin out of mutex
+  switch (action) {
+  case 1: // Hard Reset
+    pal_set_server_power(wdt->slot, SERVER_POWER_RESET);
+    break;
+  case 2: // Power Down
+    pal_set_server_power(wdt->slot, SERVER_POWER_OFF);
+    break;
+  case 3: // Power Cycle
+    pal_set_server_power(wdt->slot, SERVER_POWER_CYCLE);
+    break;
+  case 0: // no action
+  default:
+    break;
+  }
 
-        if (wdt->no_log) {
-          wdt->no_log = 0;
-        }
-        else {
-          syslog(LOG_CRIT, "%s Watchdog %s",
-            wdt_use_name[wdt->use & 0x7],
-            wdt_action_name[action & 0x7]);
-        }
+  timer_state_dump();
+}
+
+static void
+wdt_pre_timeout(tmr_t *t, void *arg) {
+  struct watchdog_data *wdt = (struct watchdog_data *)arg;
+  uint8_t pre_action;
 
-        wdt->run = 0;
-      } /* End of Timeout Action*/
-    } /* End of Valid and Run */
+  pthread_mutex_lock(&wdt->mutex);
+  // Reset or stopped while the timer thread was getting here
+  if (!wdt->valid || !wdt->run || tmr_pending(t)) {
     pthread_mutex_unlock(&wdt->mutex);
+    return;
+  }
+  pre_action = wdt->pre_action;
+  if (!wdt->no_log) {
+    syslog(LOG_CRIT, "%s Watchdog pre-timeout %s",
+      wdt_use_name[wdt->use & 0x7],
+      wdt_pre_action_name[pre_action & 0x7]);
+  }
+  pthread_mutex_unlock(&wdt->mutex);
 
-    // Execute actin out of mutex
-    if (action) {
-      switch (action) {
-      case 1: // Hard Reset
-        pal_set_server_power(wdt->slot, SERVER_POWER_RESET);
-        break;
-      case 2: // Power Down
-        pal_set_server_power(wdt->slot, SERVER_POWER_OFF);
-        break;
-      case 3: // Power Cycle
-        pal_set_server_power(wdt->slot, SERVER_POWER_CYCLE);
-        break;
-      case 0: // no action
-      default:
-        break;
-      }
-      action = 0;
-    }
+  // Raise the interrupt out of mutex
+  if (pal_wdt_pre_timeout(wdt->slot, pre_action)) {
+    syslog(LOG_WARNING, "%s: %s pre-timeout interrupt %s not raised",
+      __func__, wdt->name, wdt_pre_action_name[pre_action & 0x7]);
+  }
+}
 
-  } /* Forever while */
+// Stop the watchdog of a server that was powered off, so that it does not
+// act on the next boot. Polls for as long as any watchdog is running.
+static void
+wdt_power_check(tmr_t *t, void *arg) {
+  struct watchdog_data *wdt;
+  uint8_t status;
+  int i, stopped = 0, running = 0;
 
-  pthread_exit(NULL);
+  for (i = 0; i < MAX_NUM_FRUS; i++) {
+    if (!(wdt = g_wdt[i]))
+      continue;
+    status = SERVER_POWER_ON;
+    pthread_mutex_lock(&wdt->mutex);
+    if (wdt->valid && wdt->run &&
+        pal_get_server_power(wdt->slot, &status) >= 0 &&
+        status == SERVER_POWER_OFF) {
+      wdt->present_count_down = wdt_count_down(wdt);
+      wdt_stop(wdt);
+      stopped = 1;
+    }
+    if (wdt->run)
+      running = 1;
+    pthread_mutex_unlock(&wdt->mutex);
+  }
+  if (stopped)
+    timer_state_dump();
+
+  if (running)
+    tmr_start(t, WDT_POWER_POLL_MS);
 }
 
 int
@@ -3098,21 +3009,33 @@ main (void)
 
 
   plat_fruid_init();
+  fruid_cache_init();
   plat_sensor_init();
   plat_lan_init(&g_lan_config);
 
   sdr_init();
   sel_init();
 
-  pthread_mutex_init(&m_chassis, NULL);
-  pthread_mutex_init(&m_sensor, NULL);
-  pthread_mutex_init(&m_app, NULL);
-  pthread_mutex_init(&m_storage, NULL);
-  pthread_mutex_init(&m_transport, NULL);
-  pthread_mutex_init(&m_oem, NULL);
-  pthread_mutex_init(&m_oem_1s, NULL);
-  pthread_mutex_init(&m_oem_usb_dbg, NULL);
-  pthread_mutex_init(&m_oem_q, NULL);
+  // Stats page first, registering a command claims its slot in the page
+  ipmi_dispatch_init();
+  g_trace = ipmi_trace_open("ipmid", SOCK_PATH_IPMI);
+  if (ipmi_register_handlers()) {
+    syslog(LOG_WARNING, "ipmid: command registration failed\n");
+    exit (1);
+  }
+
+  // Watchdogs and boot order timers all run on one timer thread
+  if (tmr_init()) {
+    syslog(LOG_WARNING, "ipmid: timer service init failed\n");
+    exit (1);
+  }
+
+  for (fru = 1; fru <= MAX_NODES; fru++) {
+    snprintf(bios_timer_name[fru - 1], sizeof(bios_timer_name[0]),
+             "boot_order%d", fru);
+    tmr_setup(&bios_timer[fru - 1], bios_timer_name[fru - 1],
+              clear_bios_data_timer, (void *)(uintptr_t)fru);
+  }
 
   for (fru = 1; fru <= MAX_NUM_FRUS; fru++) {
     if (pal_is_slot_server(fru)) {
@@ -3125,12 +3048,17 @@ main (void)
       wdt_data->valid = 0;
       wdt_data->pre_interval = 1;
       pthread_mutex_init(&wdt_data->mutex, NULL);
+      snprintf(wdt_data->name, sizeof(wdt_data->name), "watchdog%d", fru);
+      snprintf(wdt_data->pre_name, sizeof(wdt_data->pre_name),
+               "watchdog%d_pre", fru);
+      tmr_setup(&wdt_data->timer, wdt_data->name, wdt_timeout, wdt_data);
+      tmr_setup(&wdt_data->pre_timer, wdt_data->pre_name, wdt_pre_timeout,
+                wdt_data);
 
       g_wdt[fru - 1] = wdt_data;
-      pthread_create(&wdt_data->tid, NULL, wdt_timer, wdt_data);
-      pthread_detach(wdt_data->tid);
     }
   }
+  tmr_setup(&wdt_power_timer, "watchdog_power", wdt_power_check, NULL);
 
   if ((s = socket (AF_UNIX, SOCK_STREAM, 0)) == -1)
   {
@@ -3182,15 +3110,6 @@ main (void)
 
   close(s);
 
-  pthread_mutex_destroy(&m_chassis);
-  pthread_mutex_destroy(&m_sensor);
-  pthread_mutex_destroy(&m_app);
-  pthread_mutex_destroy(&m_storage);
-  pthread_mutex_destroy(&m_transport);
-  pthread_mutex_destroy(&m_oem);
-  pthread_mutex_destroy(&m_oem_1s);
-  pthread_mutex_destroy(&m_oem_usb_dbg);
-  pthread_mutex_destroy(&m_oem_q);
 
   return 0;
 }
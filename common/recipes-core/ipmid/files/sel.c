@@ -37,7 +37,9 @@
 #include <openbmc/pal.h>
 
 // SEL File.
+#ifndef SEL_LOG_FILE
 #define SEL_LOG_FILE  "/mnt/data/sel%d.bin"
+#endif
 #define SIZE_PATH_MAX 32
 
 // SEL Header magic number
@@ -0,0 +1,47 @@
+/*
+ * Copyright 2017-present Facebook. All Rights Reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+/*
+ * Platform header for the host build of ipmid against the stub PAL
+ * (pal-stub.c): one server on FRU 1.
+ */
+#ifndef __PAL_H__
+#define __PAL_H__
+
+#include <openbmc/obmc-pal.h>
+
+#define MAX_NODES 1
+#define MAX_NUM_FRUS 1
+
+enum {
+  FRU_ALL = 0,
+  FRU_MB = 1,
+};
+
+enum {
+  SERVER_POWER_OFF,
+  SERVER_POWER_ON,
+  SERVER_POWER_CYCLE,
+  SERVER_POWER_RESET,
+  SERVER_GRACEFUL_SHUTDOWN,
+  SERVER_12V_OFF,
+  SERVER_12V_ON,
+  SERVER_12V_CYCLE,
+};
+
+#endif /* __PAL_H__ */
@@ -0,0 +1,214 @@
+/*
+ * Copyright 2017-present Facebook. All Rights Reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+/*
+ * Stub PAL and platform hooks for the host build of ipmid. Anything not
+ * here falls through to the weak defaults of obmc-pal.c. The server is
+ * always present and its state lives in memory, so a replayed trace can
+ * power it off or change its boot order without touching hardware.
+ */
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include <openbmc/ipmi.h>
+#include <openbmc/pal.h>
+#include "../fruid.h"
+#include "../sensor.h"
+
+#ifndef STUB_DIR
+#define STUB_DIR "/tmp/ipmid-stub"
+#endif
+
+#define STUB_FRUID_FILE STUB_DIR "/fruid_mb.bin"
+#define STUB_FRUID_SIZE 512
+#define STUB_BOOT_SIZE  6
+#define STUB_GUID_SIZE  16
+
+static pthread_mutex_t m_stub = PTHREAD_MUTEX_INITIALIZER;
+static uint8_t g_power = SERVER_POWER_ON;
+static uint8_t g_boot[STUB_BOOT_SIZE] = { 0x01, 0x00, 0x01, 0x02, 0x03, 0x04 };
+static uint8_t g_sysfw_ver[SIZE_SYSFW_VER] = { 0x00, 0x00, 0x05, 'S', 'T', 'U', 'B', '1' };
+
+int
+pal_is_slot_server(uint8_t fru) {
+  return fru == FRU_MB;
+}
+
+int
+pal_is_fru_prsnt(uint8_t fru, uint8_t *status) {
+  *status = (fru == FRU_MB);
+  return 0;
+}
+
+int
+pal_get_server_power(uint8_t slot_id, uint8_t *status) {
+  pthread_mutex_lock(&m_stub);
+  *status = g_power;
+  pthread_mutex_unlock(&m_stub);
+  return 0;
+}
+
+int
+pal_set_server_power(uint8_t slot_id, uint8_t cmd) {
+  pthread_mutex_lock(&m_stub);
+  switch (cmd) {
+    case SERVER_POWER_OFF:
+    case SERVER_GRACEFUL_SHUTDOWN:
+      g_power = SERVER_POWER_OFF;
+      break;
+    case SERVER_POWER_ON:
+    case SERVER_POWER_CYCLE:
+    case SERVER_POWER_RESET:
+      g_power = SERVER_POWER_ON;
+      break;
+  }
+  pthread_mutex_unlock(&m_stub);
+  return 0;
+}
+
+void
+pal_get_chassis_status(uint8_t slot, uint8_t *req_data, uint8_t *res_data,
+                       uint8_t *res_len) {
+  uint8_t status;
+
+  pal_get_server_power(slot, &status);
+  res_data[0] = (status == SERVER_POWER_ON) ? 0x01 : 0x00;
+  res_data[1] = 0x00;   // last power event
+  res_data[2] = 0x40;   // chassis identify supported
+  res_data[3] = 0x00;   // front panel buttons
+  *res_len = 4;
+}
+
+int
+pal_get_boot_order(uint8_t slot, uint8_t *req_data, uint8_t *boot,
+                   uint8_t *res_len) {
+  pthread_mutex_lock(&m_stub);
+  memcpy(boot, g_boot, STUB_BOOT_SIZE);
+  pthread_mutex_unlock(&m_stub);
+  *res_len = STUB_BOOT_SIZE;
+  return 0;
+}
+
+int
+pal_set_boot_order(uint8_t slot, uint8_t *boot, uint8_t *res_data,
+                   uint8_t *res_len) {
+  pthread_mutex_lock(&m_stub);
+  memcpy(g_boot, boot, STUB_BOOT_SIZE);
+  pthread_mutex_unlock(&m_stub);
+  *res_len = 0;
+  return 0;
+}
+
+int
+pal_get_sysfw_ver(uint8_t slot, uint8_t *ver) {
+  pthread_mutex_lock(&m_stub);
+  memcpy(ver, g_sysfw_ver, SIZE_SYSFW_VER);
+  pthread_mutex_unlock(&m_stub);
+  return 0;
+}
+
+int
+pal_set_sysfw_ver(uint8_t slot, uint8_t *ver) {
+  pthread_mutex_lock(&m_stub);
+  memcpy(g_sysfw_ver, ver, SIZE_SYSFW_VER);
+  pthread_mutex_unlock(&m_stub);
+  return 0;
+}
+
+int
+pal_get_dev_guid(uint8_t fru, char *guid) {
+  int i;
+
+  for (i = 0; i < STUB_GUID_SIZE; i++)
+    guid[i] = 0xD0 + i;
+  return 0;
+}
+
+int
+pal_get_sys_guid(uint8_t slot, char *guid) {
+  int i;
+
+  for (i = 0; i < STUB_GUID_SIZE; i++)
+    guid[i] = 0x50 + i;
+  return 0;
+}
+
+// FRU 1 is a blank image with only the common header
+int
+plat_fruid_init(void) {
+  uint8_t fru[STUB_FRUID_SIZE] = { 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xFF };
+  FILE *fp;
+
+  fp = fopen(STUB_FRUID_FILE, "w");
+  if (!fp)
+    return -1;
+  fwrite(fru, sizeof(fru), 1, fp);
+  fclose(fp);
+  return 0;
+}
+
+int
+plat_fruid_path(unsigned char payload_id, unsigned char fru_id, char *path) {
+  if (fru_id != FRU_ALL && fru_id != FRU_MB)
+    return -1;
+  snprintf(path, FRUID_PATH_MAX, "%s", STUB_FRUID_FILE);
+  return 0;
+}
+
+// The SDR holds one management controller record
+static sensor_mgmt_t g_sensor_mgmt[] = {
+  { 0x20, 0x00, 0x00, 0x01, 0x07, 0x01, 0x00, 0xC4, "BMC" },
+};
+
+void
+plat_sensor_mgmt_info(int *num, sensor_mgmt_t **p_sensor) {
+  *num = sizeof(g_sensor_mgmt) / sizeof(g_sensor_mgmt[0]);
+  *p_sensor = g_sensor_mgmt;
+}
+
+void
+plat_sensor_disc_info(int *num, sensor_disc_t **p_sensor) {
+  *num = 0;
+  *p_sensor = NULL;
+}
+
+void
+plat_sensor_thresh_info(int *num, sensor_thresh_t **p_sensor) {
+  *num = 0;
+  *p_sensor = NULL;
+}
+
+void
+plat_sensor_oem_info(int *num, sensor_oem_t **p_sensor) {
+  *num = 0;
+  *p_sensor = NULL;
+}
+
+int
+plat_sensor_init(void) {
+  return 0;
+}
+
+void
+plat_lan_init(lan_config_t *lan) {
+  uint8_t ip[SIZE_IP_ADDR] = { 192, 168, 0, 2 };
+  uint8_t mac[SIZE_MAC_ADDR] = { 0x02, 0x00, 0x00, 0x00, 0x00, 0x01 };
+
+  memcpy(lan->ip_addr, ip, sizeof(ip));
+  memcpy(lan->mac_addr, mac, sizeof(mac));
+}
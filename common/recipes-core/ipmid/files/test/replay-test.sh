@@ -0,0 +1,96 @@
+#!/bin/sh
+#
+# Copyright 2017-present Facebook. All Rights Reserved.
+#
+# This program file is free software; you can redistribute it and/or modify it
+# under the terms of the GNU General Public License as published by the
+# Free Software Foundation; version 2 of the License.
+#
+# This program is distributed in the hope that it will be useful, but WITHOUT
+# ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+# FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+# for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program in a file named COPYING; if not, write to the
+# Free Software Foundation, Inc.,
+# 51 Franklin Street, Fifth Floor,
+# Boston, MA 02110-1301 USA
+#
+
+# Record a trace of read-only requests and one Add SEL Entry from
+# ipmid-stub, then replay it against a fresh ipmid-stub: once as is,
+# where Add SEL Entry must be skipped, and once with --unsafe.
+
+STUB_DIR=${STUB_DIR:-/tmp/ipmid-stub}
+TRACE=$(mktemp)
+OUT=$(mktemp)
+fails=0
+
+cleanup() {
+  kill $pid 2>/dev/null && wait $pid 2>/dev/null
+  rm -f "$TRACE" "$OUT"
+}
+trap cleanup EXIT
+
+fail() {
+  echo "FAIL: $1"
+  fails=$((fails + 1))
+}
+
+rm -rf "$STUB_DIR"
+mkdir -p "$STUB_DIR"
+./ipmid-stub > /dev/null 2>&1 &
+pid=$!
+i=0
+while [ ! -S "$STUB_DIR/sock" ] || [ ! -f "$STUB_DIR/trace_ipmid" ]; do
+  i=$((i + 1))
+  if [ $i -gt 50 ]; then
+    echo "FAIL: ipmid-stub did not come up"
+    exit 1
+  fi
+  sleep 0.1
+done
+
+./ipmi-util --trace "$STUB_DIR/trace_ipmid" on > /dev/null
+i=0
+while [ $i -lt 10 ]; do
+  ./ipmi-util 1 0x18 0x01 > /dev/null           # Get Device ID
+  ./ipmi-util 1 0x00 0x01 > /dev/null           # Get Chassis Status
+  ./ipmi-util 1 0x18 0x08 > /dev/null           # Get Device GUID
+  ./ipmi-util 1 0x28 0x40 > /dev/null           # Get SEL Info
+  i=$((i + 1))
+done
+./ipmi-util 1 0x28 0x44 0x00 0x00 0x02 0x00 0x00 0x00 0x00 0x20 0x00 \
+  0x04 0x01 0x01 0x6F 0x01 0xFF 0xFF > /dev/null   # Add SEL Entry
+./ipmi-util --trace "$STUB_DIR/trace_ipmid" off > /dev/null
+cp "$STUB_DIR/trace_ipmid" "$TRACE"
+kill $pid
+wait $pid 2>/dev/null
+
+n=$(./ipmi-util --trace-dump "$TRACE" | grep -c "req:")
+[ "$n" = 41 ] || fail "trace holds $n requests, expected 41"
+
+# Read-only replay: the SEL stays empty, so every response matches
+STUB_DIR=$STUB_DIR ./replay.sh "$TRACE" 0 > "$OUT" 2>&1
+grep -q "^40 requests in" "$OUT" || fail "read-only replay did not send 40 requests"
+grep -q "^0 responses differ" "$OUT" || fail "read-only replay responses differ"
+grep -q "^1 requests that change state skipped" "$OUT" ||
+  fail "read-only replay did not skip Add SEL Entry"
+
+# Unsafe replay: Add SEL Entry goes through too
+STUB_DIR=$STUB_DIR ./replay.sh "$TRACE" 0 --unsafe > "$OUT" 2>&1
+grep -q "^41 requests in" "$OUT" || fail "unsafe replay did not send 41 requests"
+grep -q "^0x0A  0x44          1        0 " "$OUT" ||
+  fail "unsafe replay did not add the SEL entry"
+grep -q "skipped" "$OUT" && fail "unsafe replay skipped requests"
+
+# Paced replay: 10 times as fast as recorded
+STUB_DIR=$STUB_DIR ./replay.sh "$TRACE" 10 > "$OUT" 2>&1
+grep -q "^40 requests in" "$OUT" || fail "paced replay did not send 40 requests"
+
+if [ $fails -ne 0 ]; then
+  echo "$fails replay checks failed"
+  exit 1
+fi
+echo "replay checks passed"
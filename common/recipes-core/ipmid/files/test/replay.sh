@@ -0,0 +1,51 @@
+#!/bin/sh
+#
+# Copyright 2017-present Facebook. All Rights Reserved.
+#
+# This program file is free software; you can redistribute it and/or modify it
+# under the terms of the GNU General Public License as published by the
+# Free Software Foundation; version 2 of the License.
+#
+# This program is distributed in the hope that it will be useful, but WITHOUT
+# ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+# FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+# for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program in a file named COPYING; if not, write to the
+# Free Software Foundation, Inc.,
+# 51 Franklin Street, Fifth Floor,
+# Boston, MA 02110-1301 USA
+#
+
+# Replay a trace against a fresh ipmid-stub:
+#   replay.sh <trace_file> [speed] [ipmi-util --trace-replay options]
+
+STUB_DIR=${STUB_DIR:-/tmp/ipmid-stub}
+
+if [ $# -lt 1 ]; then
+  echo "Usage: $0 <trace_file> [speed] [options]"
+  exit 1
+fi
+
+trace=$1
+shift
+
+rm -rf "$STUB_DIR"
+mkdir -p "$STUB_DIR"
+
+./ipmid-stub > /dev/null 2>&1 &
+pid=$!
+trap 'kill $pid 2>/dev/null; wait $pid 2>/dev/null' EXIT
+
+i=0
+while [ ! -S "$STUB_DIR/sock" ]; do
+  i=$((i + 1))
+  if [ $i -gt 50 ] || ! kill -0 $pid 2>/dev/null; then
+    echo "ipmid-stub did not come up"
+    exit 1
+  fi
+  sleep 0.1
+done
+
+./ipmi-util --trace-replay "$trace" "$@" --to "$STUB_DIR/sock"
@@ -0,0 +1,243 @@
+/*
+ *
+ * Copyright 2017-present Facebook. All Rights Reserved.
+ *
+ * This file provides one-shot timers for ipmid, all served by a single
+ * thread that sleeps on a timerfd until the earliest one is due.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <errno.h>
+#include <syslog.h>
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/timerfd.h>
+#include "timer.h"
+
+/*
+ * ipmid has a handful of timers (a watchdog and a boot order timer per
+ * slot), so a sorted list is all the bookkeeping needed. Re-arming the
+ * timerfd from any thread wakes the timer thread at the new deadline.
+ */
+
+static pthread_mutex_t m_tmr = PTHREAD_MUTEX_INITIALIZER;
+static tmr_t *g_pending;
+static tmr_t *g_all;
+static int g_tfd = -1;
+static tmr_stats_t g_stats;
+
+static uint64_t
+now_us(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+// Arm the timerfd for the head of the pending list. Called with m_tmr held.
+static void
+tmr_arm(void) {
+  struct itimerspec its;
+
+  memset(&its, 0, sizeof(its));
+  if (g_pending) {
+    its.it_value.tv_sec = g_pending->due / 1000000;
+    its.it_value.tv_nsec = (g_pending->due % 1000000) * 1000;
+  }
+  if (timerfd_settime(g_tfd, TFD_TIMER_ABSTIME, &its, NULL) < 0) {
+    syslog(LOG_WARNING, "%s: timerfd_settime failed, errno %d", __func__, errno);
+  }
+}
+
+// Called with m_tmr held
+static void
+tmr_unlink(tmr_t *t) {
+  tmr_t **pp;
+
+  for (pp = &g_pending; *pp; pp = &(*pp)->next) {
+    if (*pp == t) {
+      *pp = t->next;
+      break;
+    }
+  }
+  t->next = NULL;
+  t->pending = 0;
+  g_stats.pending--;
+}
+
+static void *
+tmr_thread(void *arg) {
+  uint64_t exp, now;
+  uint32_t latency;
+  tmr_t *t;
+
+  while (1) {
+    if (read(g_tfd, &exp, sizeof(exp)) < 0 && errno != EINTR && errno != EAGAIN) {
+      syslog(LOG_WARNING, "%s: read failed, errno %d", __func__, errno);
+      sleep(1);
+    }
+
+    pthread_mutex_lock(&m_tmr);
+    g_stats.wakeups++;
+    now = now_us();
+    while ((t = g_pending) != NULL && t->due <= now) {
+      tmr_unlink(t);
+      latency = now - t->due;
+      t->last_latency = latency;
+      if (latency > t->max_latency)
+        t->max_latency = latency;
+      if (latency > g_stats.max_latency)
+        g_stats.max_latency = latency;
+      t->fired++;
+      g_stats.fired++;
+
+      pthread_mutex_unlock(&m_tmr);
+      t->cb(t, t->arg);
+      pthread_mutex_lock(&m_tmr);
+      now = now_us();
+    }
+    tmr_arm();
+    pthread_mutex_unlock(&m_tmr);
+  }
+
+  pthread_exit(NULL);
+}
+
+int
+tmr_init(void) {
+  pthread_t tid;
+
+  g_tfd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+  if (g_tfd < 0) {
+    syslog(LOG_WARNING, "%s: timerfd_create failed, errno %d", __func__, errno);
+    return -1;
+  }
+
+  if (pthread_create(&tid, NULL, tmr_thread, NULL) != 0) {
+    syslog(LOG_WARNING, "%s: pthread_create failed", __func__);
+    close(g_tfd);
+    g_tfd = -1;
+    return -1;
+  }
+  pthread_detach(tid);
+
+  return 0;
+}
+
+void
+tmr_setup(tmr_t *t, const char *name, tmr_cb cb, void *arg) {
+  memset(t, 0, sizeof(*t));
+  t->name = name;
+  t->cb = cb;
+  t->arg = arg;
+
+  pthread_mutex_lock(&m_tmr);
+  t->all = g_all;
+  g_all = t;
+  pthread_mutex_unlock(&m_tmr);
+}
+
+void
+tmr_start(tmr_t *t, uint32_t delay_ms) {
+  tmr_t **pp;
+
+  pthread_mutex_lock(&m_tmr);
+  if (t->pending)
+    tmr_unlink(t);
+
+  t->due = now_us() + (uint64_t)delay_ms * 1000;
+  for (pp = &g_pending; *pp && (*pp)->due <= t->due; pp = &(*pp)->next)
+    ;
+  t->next = *pp;
+  *pp = t;
+  t->pending = 1;
+  g_stats.pending++;
+
+  if (g_pending == t)
+    tmr_arm();
+  pthread_mutex_unlock(&m_tmr);
+}
+
+void
+tmr_stop(tmr_t *t) {
+  int was_head;
+
+  pthread_mutex_lock(&m_tmr);
+  if (t->pending) {
+    was_head = (g_pending == t);
+    tmr_unlink(t);
+    // Avoid waking up for a timer that no longer exists
+    if (was_head)
+      tmr_arm();
+  }
+  pthread_mutex_unlock(&m_tmr);
+}
+
+int
+tmr_pending(tmr_t *t) {
+  int pending;
+
+  pthread_mutex_lock(&m_tmr);
+  pending = t->pending;
+  pthread_mutex_unlock(&m_tmr);
+  return pending;
+}
+
+uint32_t
+tmr_remaining(tmr_t *t) {
+  uint64_t now;
+  uint32_t ms = 0;
+
+  pthread_mutex_lock(&m_tmr);
+  if (t->pending) {
+    now = now_us();
+    if (t->due > now)
+      ms = (t->due - now + 999) / 1000;
+  }
+  pthread_mutex_unlock(&m_tmr);
+  return ms;
+}
+
+void
+tmr_get_stats(tmr_stats_t *stats) {
+  pthread_mutex_lock(&m_tmr);
+  *stats = g_stats;
+  pthread_mutex_unlock(&m_tmr);
+}
+
+void
+tmr_dump(FILE *fp) {
+  uint64_t now;
+  tmr_t *t;
+
+  pthread_mutex_lock(&m_tmr);
+  now = now_us();
+  fprintf(fp, "wakeups: %llu\n", (unsigned long long)g_stats.wakeups);
+  fprintf(fp, "fired: %llu\n", (unsigned long long)g_stats.fired);
+  fprintf(fp, "pending: %u\n", g_stats.pending);
+  fprintf(fp, "max_latency_us: %u\n", g_stats.max_latency);
+  for (t = g_all; t; t = t->all) {
+    fprintf(fp, "%s: pending %d, due_in_ms %lld, fired %u, "
+            "last_latency_us %u, max_latency_us %u\n",
+            t->name, t->pending,
+            t->pending ? ((long long)t->due - (long long)now) / 1000 : 0LL,
+            t->fired, t->last_latency, t->max_latency);
+  }
+  pthread_mutex_unlock(&m_tmr);
+}
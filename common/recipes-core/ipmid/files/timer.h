@@ -0,0 +1,71 @@
+/*
+ *
+ * Copyright 2017-present Facebook. All Rights Reserved.
+ *
+ * This file provides one-shot timers for ipmid, all served by a single
+ * thread that sleeps on a timerfd until the earliest one is due.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#ifndef __TIMER_H__
+#define __TIMER_H__
+
+#include <stdio.h>
+#include <stdint.h>
+
+typedef struct tmr tmr_t;
+
+/*
+ * Runs on the timer thread, without any timer lock held. The timer may have
+ * been restarted in the meantime, so callbacks check tmr_pending() under
+ * their own lock before acting.
+ */
+typedef void (*tmr_cb)(tmr_t *t, void *arg);
+
+struct tmr {
+  tmr_t *next;              /* pending list, sorted by due time */
+  tmr_t *all;               /* every timer set up, for diagnostics */
+  const char *name;
+  uint64_t due;             /* CLOCK_MONOTONIC, us */
+  uint8_t pending;
+  tmr_cb cb;
+  void *arg;
+  uint32_t fired;
+  uint32_t last_latency;    /* us between due time and callback */
+  uint32_t max_latency;
+};
+
+typedef struct {
+  uint64_t wakeups;
+  uint64_t fired;
+  uint32_t pending;
+  uint32_t max_latency;     /* us, over all timers */
+} tmr_stats_t;
+
+int tmr_init(void);
+void tmr_setup(tmr_t *t, const char *name, tmr_cb cb, void *arg);
+/* (Re)arm t to fire once, delay_ms from now */
+void tmr_start(tmr_t *t, uint32_t delay_ms);
+void tmr_stop(tmr_t *t);
+int tmr_pending(tmr_t *t);
+/* ms until t fires, 0 if it is not pending */
+uint32_t tmr_remaining(tmr_t *t);
+
+void tmr_get_stats(tmr_stats_t *stats);
+/* Write service stats and one line per timer */
+void tmr_dump(FILE *fp);
+
+#endif /* __TIMER_H__ */
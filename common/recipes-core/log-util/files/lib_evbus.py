@@ -0,0 +1,76 @@
+#!/usr/bin/env python
+#
+# Copyright 2015-present Facebook. All Rights Reserved.
+#
+# This program file is free software; you can redistribute it and/or modify it
+# under the terms of the GNU General Public License as published by the
+# Free Software Foundation; version 2 of the License.
+#
+# This program is distributed in the hope that it will be useful, but WITHOUT
+# ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+# FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+# for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program in a file named COPYING; if not, write to the
+# Free Software Foundation, Inc.,
+# 51 Franklin Street, Fifth Floor,
+# Boston, MA 02110-1301 USA
+#
+
+from ctypes import *
+import time
+
+levbus_hndl = CDLL("libevbus.so")
+
+EVBUS_DATA_LEN = 8
+EVBUS_MSG_LEN = 256
+
+# Record types, see <openbmc/evbus.h>
+EVBUS_T_CRI_SEL = 1
+
+EVBUS_TYPES = {
+    1: 'cri_sel',
+    2: 'gpio',
+    3: 'sensor',
+}
+
+class evbus_rec_t(Structure):
+    _fields_ = [
+        ('seq', c_uint),
+        ('time', c_uint),
+        ('type', c_ushort),
+        ('fru', c_ubyte),
+        ('severity', c_ubyte),
+        ('data', c_ubyte * EVBUS_DATA_LEN),
+        ('msg', c_char * EVBUS_MSG_LEN),
+    ]
+
+# Returns the records newer than cursor, oldest first, and the new cursor
+def evbus_read(cursor = 0, count = 64):
+    recs = (evbus_rec_t * count)()
+    cur = c_uint(cursor)
+    events = []
+    while True:
+        n = levbus_hndl.evbus_read(byref(cur), recs, count)
+        if n <= 0:
+            break
+        for rec in recs[:n]:
+            events.append({
+                'seq': rec.seq,
+                'time': time.strftime('%Y-%m-%d %H:%M:%S', time.localtime(rec.time)),
+                'type': EVBUS_TYPES.get(rec.type, str(rec.type)),
+                'fru': rec.fru,
+                'severity': rec.severity,
+                'message': rec.msg,
+            })
+    return events, cur.value
+
+def evbus_clear():
+    levbus_hndl.evbus_clear()
+
+def evbus_publish(type, fru, severity, msg):
+    if not isinstance(msg, bytes):
+        msg = msg.encode('ascii', 'replace')
+    return levbus_hndl.evbus_publish(c_ushort(type), c_ubyte(fru),
+                                     c_ubyte(severity), None, 0, b"%s", msg)
@@ -24,9 +24,10 @@ import sys
 import os
 from ctypes import *
 from lib_pal import *
+from lib_evbus import *
 
 syslogfiles = ['/mnt/data/logfile.0', '/mnt/data/logfile']
-cmdlist = ['--print', '--clear']
+cmdlist = ['--print', '--clear', '--events']
 APPNAME = 'log-util'
 frulist = ''
 
@@ -35,6 +36,36 @@ def print_usage():
 
     print 'Usage: %s [ %s ] %s' % (APPNAME, ' | '.join(frulist), cmdlist[0])
     print '       %s [ %s ] %s' % (APPNAME, ' | '.join(frulist), cmdlist[1])
+    print '       %s [ %s ] %s' % (APPNAME, ' | '.join(frulist), cmdlist[2])
+
+
+# Print the records of the event bus, no syslog parsing needed
+def print_events(fru):
+    print '%-4s %-8s %-22s %-16s %s' % (
+        "FRU#",
+        "FRU_NAME",
+        "TIME_STAMP",
+        "EVENT_TYPE",
+        "MESSAGE"
+        )
+
+    events, cursor = evbus_read()
+    for ev in events:
+        if ev['fru'] == 0 or ev['fru'] >= len(frulist) - 1:
+            fruname = 'sys'
+        else:
+            fruname = frulist[ev['fru']]
+
+        if fru != 'all' and fru != fruname:
+            continue
+
+        print '%-4s %-8s %-22s %-16s %s' % (
+            ev['fru'],
+            fruname,
+            ev['time'],
+            ev['type'],
+            ev['message']
+            )
 
 
 def log_main():
@@ -65,6 +96,10 @@ def log_main():
         print_usage()
         return -1
 
+    if cmd == cmdlist[2]:
+        print_events(fru)
+        return 0
+
     # Print cmd
     if cmd == cmdlist[0]:
         print '%-4s %-8s %-22s %-16s %s' % (
@@ -188,6 +223,9 @@ def log_main():
 
     if cmd == cmdlist[1]:
         pal_log_clear(fru)
+        # The event bus is not kept per FRU
+        if fru == 'all':
+            evbus_clear()
 
 if __name__ == '__main__':
     log_main()
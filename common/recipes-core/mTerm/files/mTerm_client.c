@@ -19,8 +19,10 @@
 #include <arpa/inet.h>
 #include <sys/un.h>
 #include <signal.h>
+#include <time.h>
 #include "tty_helper.h"
 #include "mTerm_helper.h"
+#include "mTerm_history.h"
 
 static sig_atomic_t sigexit = 0;
 
@@ -84,6 +86,12 @@ static int readFromStdin(int clientfd, int stdi) {
       perror("mTerm_client: Invalid input to read buffer");
     }
     return 1;
+  } else if (mode == HISTORY || mode == SEEK) {
+    if (escHistory(clientfd, c[0], &mode) < 0) {
+      mode = EOL;
+      printf("Expected a number and <Enter>\r\n");
+    }
+    return 1;
   }
   charSend(clientfd, &c[0], nbytes);
   return 1;
@@ -144,6 +152,7 @@ static void connectClient(const char *dev) {
     closeTty(tty_in);
     return;
   }
+  sendTlv(clientfd, TLV_LIVE, NULL, 0);
 
   FD_SET(tty_in->fd,&master);
   FD_SET(clientfd, &master);
@@ -176,13 +185,51 @@ static void connectClient(const char *dev) {
   close(clientfd);
 }
 
+// Print the console history from..to and exit, without a tty
+static int dumpHistory(const char *dev, uint32_t from, uint32_t to) {
+  char buf[SEND_SIZE];
+  int clientfd;
+  int nbytes;
+
+  clientfd = createClientSocket(dev);
+  if (clientfd < 0) {
+    return 1;
+  }
+  // Wait for the server, there is nothing else to do
+  if (fcntl(clientfd, F_SETFL, 0) < 0 ||
+      sendHistoryReq(clientfd, from, to, HISTORY_REQ_CLOSE) < 0) {
+    close(clientfd);
+    return 1;
+  }
+  while ((nbytes = read(clientfd, buf, sizeof(buf))) > 0) {
+    writeData(STDOUT_FILENO, buf, nbytes, "stdout");
+  }
+  close(clientfd);
+  return nbytes < 0 ? 1 : 0;
+}
+
 static void
 print_usage() {
   printf("Usage example: /usr/local/bin/mTerm_client <fru> \n");
+  printf("       /usr/local/bin/mTerm_client <fru> --history <minutes>\n");
+  printf("       /usr/local/bin/mTerm_client <fru> --since <epoch> [<until>]\n");
 }
 
 int main(int argc, char **argv)
 {
+   uint32_t now, back;
+
+   if (argc >= 4 && !strcmp(argv[2], "--history")) {
+     now = time(NULL);
+     back = strtoul(argv[3], NULL, 0) * 60;
+     setFru(argv[1]);
+     return dumpHistory(argv[1], back < now ? now - back : 0, 0);
+   }
+   if (argc >= 4 && !strcmp(argv[2], "--since")) {
+     setFru(argv[1]);
+     return dumpHistory(argv[1], strtoul(argv[3], NULL, 0),
+                        argc > 4 ? strtoul(argv[4], NULL, 0) : 0);
+   }
    if (argc != 2) {
      print_usage();
      exit(1);
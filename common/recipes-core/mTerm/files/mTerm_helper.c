@@ -22,7 +22,9 @@
 #include <unistd.h>
 #include <errno.h>
 #include <syslog.h>
+#include <time.h>
 #include "mTerm_helper.h"
+#include "mTerm_history.h"
 #include "tty_helper.h"
 
 static char g_fru[10];
@@ -37,6 +39,8 @@ void escHelp(void) {
   printf("  CTRL-l x : Terminate the connection.\r\n");
   printf("  /var/log/mTerm_%s.log : Log location\r\n", g_fru);
   printf("  CTRL-l + b : Send Break\r\n");
+  printf("  CTRL-l h N <Enter> : Replay the last N minutes of console history\r\n");
+  printf("  CTRL-l @ T <Enter> : Replay the history since T, seconds since the epoch\r\n");
   /*TODO: Log file read from tool*/
   //printf("  CTRL-L :N - For reading last N lines from end of buffer.\r\n");
   printf("\r\n-----------------------------------------------------------\r\n");
@@ -64,6 +68,14 @@ int processEscMode(int clientfd, char c, escMode* mode) {
     *mode = EOL;
     return 0;
   }
+  if (c == 'h') {
+    *mode = HISTORY;
+    return 1;
+  }
+  if (c == '@') {
+    *mode = SEEK;
+    return 1;
+  }
   if (isalpha(c) && (c == 'b')) {
     printf("Warning: Send BREAK \r\n");
     escSendBreak(clientfd, &c);
@@ -123,6 +135,45 @@ int escSend(int clientfd, char c, escMode* mode) {
   return 1;
 }
 
+int sendHistoryReq(int clientfd, uint32_t from, uint32_t to, uint32_t flags) {
+  historyReq req;
+
+  req.from = from;
+  req.to = to;
+  req.flags = flags;
+  return sendTlv(clientfd, TLV_HISTORY, &req, sizeof(req));
+}
+
+// Digits of minutes back, or of a time, until Enter
+int escHistory(int clientfd, char c, escMode* mode) {
+  static uint32_t val = 0;
+  static int ndigits = 0;
+  uint32_t now;
+
+  if (c == ASCII_CR) {
+    now = time(NULL);
+    if (ndigits) {
+      if (*mode == HISTORY) {
+        sendHistoryReq(clientfd, val * 60 < now ? now - val * 60 : 0, 0, 0);
+      } else {
+        sendHistoryReq(clientfd, val, 0, 0);
+      }
+    }
+    *mode = EOL;
+    val = 0;
+    ndigits = 0;
+    return 1;
+  }
+  if (!isdigit(c) || ndigits >= 10) {
+    val = 0;
+    ndigits = 0;
+    return -1;
+  }
+  val = val * 10 + (c - '0');
+  ndigits++;
+  return 1;
+}
+
 void charSend(int clientfd, char* c, int length) {
   sendTlv(clientfd, ASCII_CARAT, c, length);
 }
@@ -37,7 +37,9 @@ typedef enum escMode {
   EOL,
   ESC,
   CTRL_X,
-  SEND
+  SEND,
+  HISTORY,
+  SEEK
 } escMode;
 
 typedef struct bufStore {
@@ -52,6 +54,9 @@ typedef struct TlvHeader {
   uint16_t length;
 }TlvHeader;
 
+// TLV type a client sends when it attaches, to get the live console at once
+#define TLV_LIVE 'l'
+
 void setFru();
 //esc mode processing
 void escHelp();
@@ -59,6 +64,8 @@ int processEscMode(int clientfd, char c, escMode* mode);
 int escSend(int clientfd, char c, escMode* mode);
 void escClose(int clientfd);
 void charSend(int clientfd, char* c, int length);
+int escHistory(int clientfd, char c, escMode* mode);
+int sendHistoryReq(int clientfd, uint32_t from, uint32_t to, uint32_t flags);
 // buffer processing
 bufStore* createBuffer(const char *dev, int fsize);
 void closeBuffer(bufStore* buf);
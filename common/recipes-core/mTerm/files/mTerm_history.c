@@ -0,0 +1,495 @@
+/*
+ * Copyright 2017-present Facebook. All Rights Reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <time.h>
+#include <dirent.h>
+#include <syslog.h>
+#include <sys/stat.h>
+#include "mTerm_history.h"
+
+/*
+ * LZ4 block format, fast enough to run on every chunk as it fills. Matches are found through a hash of the next 4 bytes; the last 5
+ * bytes are always literals and no match starts in the last 12.
+ */
+#define LZ_MIN_MATCH     4
+#define LZ_HASH_BITS     12
+#define LZ_LAST_LITERALS 5
+#define LZ_MFLIMIT       12
+#define LZ_MAX_OFFSET    65535
+
+static uint32_t lzRead32(const uint8_t *p) {
+  uint32_t v;
+
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+static uint8_t* lzPutLen(uint8_t *op, uint32_t len) {
+  while (len >= 255) {
+    *op++ = 255;
+    len -= 255;
+  }
+  *op++ = len;
+  return op;
+}
+
+static uint8_t* lzPutSequence(uint8_t *op, const uint8_t *lit, uint32_t litLen,
+                              uint32_t offset, uint32_t matchLen) {
+  uint8_t *token = op++;
+
+  *token = (litLen >= 15 ? 15 : litLen) << 4;
+  if (litLen >= 15) {
+    op = lzPutLen(op, litLen - 15);
+  }
+  memcpy(op, lit, litLen);
+  op += litLen;
+  if (!offset) {
+    return op;
+  }
+
+  *op++ = offset & 0xff;
+  *op++ = offset >> 8;
+  matchLen -= LZ_MIN_MATCH;
+  *token |= matchLen >= 15 ? 15 : matchLen;
+  if (matchLen >= 15) {
+    op = lzPutLen(op, matchLen - 15);
+  }
+  return op;
+}
+
+// len up to 64KB; dst needs len + len / 255 + 16 bytes
+static int lzCompress(const uint8_t *src, int len, uint8_t *dst) {
+  uint16_t table[1 << LZ_HASH_BITS];
+  const uint8_t *ip = src, *anchor = src, *end = src + len;
+  const uint8_t *mflimit = end - LZ_MFLIMIT;
+  const uint8_t *matchlimit = end - LZ_LAST_LITERALS;
+  const uint8_t *ref, *mp, *rp;
+  uint8_t *op = dst;
+  uint32_t v, h;
+
+  memset(table, 0, sizeof(table));
+  while (len > LZ_MFLIMIT && ip < mflimit) {
+    v = lzRead32(ip);
+    h = (v * 2654435761U) >> (32 - LZ_HASH_BITS);
+    ref = src + table[h];
+    table[h] = ip - src;
+    if (ref >= ip || ip - ref > LZ_MAX_OFFSET || lzRead32(ref) != v) {
+      ip++;
+      continue;
+    }
+
+    mp = ip + LZ_MIN_MATCH;
+    rp = ref + LZ_MIN_MATCH;
+    while (mp < matchlimit && *mp == *rp) {
+      mp++;
+      rp++;
+    }
+    op = lzPutSequence(op, anchor, ip - anchor, ip - ref, mp - ip);
+    ip = anchor = mp;
+  }
+  op = lzPutSequence(op, anchor, end - anchor, 0, 0);
+  return op - dst;
+}
+
+static int lzGetLen(const uint8_t **ip, const uint8_t *iend, uint32_t *len) {
+  uint8_t b;
+
+  do {
+    if (*ip >= iend) {
+      return -1;
+    }
+    b = *(*ip)++;
+    *len += b;
+  } while (b == 255);
+  return 0;
+}
+
+// Length of the data, or -1 if src is not a valid block that fits in size
+static int lzDecompress(const uint8_t *src, int len, uint8_t *dst, int size) {
+  const uint8_t *ip = src, *iend = src + len;
+  uint8_t *op = dst, *oend = dst + size;
+  const uint8_t *ref;
+  uint32_t token, litLen, matchLen, offset;
+
+  while (ip < iend) {
+    token = *ip++;
+    litLen = token >> 4;
+    if (litLen == 15 && lzGetLen(&ip, iend, &litLen)) {
+      return -1;
+    }
+    if (litLen > iend - ip || litLen > oend - op) {
+      return -1;
+    }
+    memcpy(op, ip, litLen);
+    op += litLen;
+    ip += litLen;
+    if (ip == iend) {
+      break;
+    }
+
+    if (iend - ip < 2) {
+      return -1;
+    }
+    offset = ip[0] | (ip[1] << 8);
+    ip += 2;
+    if (!offset || offset > op - dst) {
+      return -1;
+    }
+    matchLen = token & 15;
+    if (matchLen == 15 && lzGetLen(&ip, iend, &matchLen)) {
+      return -1;
+    }
+    matchLen += LZ_MIN_MATCH;
+    if (matchLen > oend - op) {
+      return -1;
+    }
+    // May overlap what it copies, byte by byte on purpose
+    ref = op - offset;
+    while (matchLen--) {
+      *op++ = *ref++;
+    }
+  }
+  return op - dst;
+}
+
+static void chunkPath(historyStore *h, uint32_t seq, char *path, int size) {
+  snprintf(path, size, "%s/%08x.chunk", h->dir, seq);
+}
+
+static void dropOldestChunk(historyStore *h) {
+  char path[PATH_MAX];
+
+  chunkPath(h, h->chunks[0].seq, path, sizeof(path));
+  unlink(path);
+  h->total -= h->chunks[0].size;
+  h->nChunks--;
+  memmove(&h->chunks[0], &h->chunks[1], h->nChunks * sizeof(chunkInfo));
+}
+
+static void sealChunk(historyStore *h) {
+  chunkHeader hdr;
+  chunkInfo *ci;
+  char path[PATH_MAX], tmp[PATH_MAX];
+  uint8_t *data = h->comp;
+  int fd, len, ok;
+
+  if (!h->rawLen) {
+    return;
+  }
+
+  hdr.magic = HISTORY_CHUNK_MAGIC;
+  hdr.seq = h->seq;
+  hdr.start = h->start;
+  hdr.end = h->end;
+  hdr.rawLen = h->rawLen;
+  hdr.nIndex = h->nIndex;
+  hdr.flags = 0;
+  len = lzCompress(h->raw, h->rawLen, h->comp);
+  if (len >= h->rawLen) {
+    data = h->raw;
+    len = h->rawLen;
+    hdr.flags |= HISTORY_CHUNK_RAW;
+  }
+  hdr.dataLen = len;
+
+  // Written aside and renamed, so a chunk file is always whole
+  chunkPath(h, h->seq, path, sizeof(path));
+  snprintf(tmp, sizeof(tmp), "%s/chunk.tmp", h->dir);
+  fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    syslog(LOG_WARNING, "mTerm: cannot create %s, errno=%d", tmp, errno);
+    goto reset;
+  }
+  ok = write(fd, &hdr, sizeof(hdr)) == sizeof(hdr) &&
+       write(fd, h->index, h->nIndex * sizeof(historyIndex)) ==
+         h->nIndex * sizeof(historyIndex) &&
+       write(fd, data, len) == len;
+  close(fd);
+  if (!ok || rename(tmp, path)) {
+    syslog(LOG_WARNING, "mTerm: cannot write %s, errno=%d", path, errno);
+    unlink(tmp);
+    goto reset;
+  }
+
+  if (h->nChunks == HISTORY_MAX_CHUNKS) {
+    dropOldestChunk(h);
+  }
+  ci = &h->chunks[h->nChunks++];
+  ci->seq = h->seq;
+  ci->start = h->start;
+  ci->end = h->end;
+  ci->size = sizeof(hdr) + h->nIndex * sizeof(historyIndex) + len;
+  h->total += ci->size;
+  while (h->total > h->budget && h->nChunks > 1) {
+    dropOldestChunk(h);
+  }
+
+reset:
+  h->seq++;
+  h->rawLen = 0;
+  h->nIndex = 0;
+}
+
+static int cmpChunk(const void *a, const void *b) {
+  const chunkInfo *x = a, *y = b;
+
+  return (x->seq > y->seq) - (x->seq < y->seq);
+}
+
+// Pick up the chunks an earlier mTerm_server left
+static void scanChunks(historyStore *h) {
+  DIR *dir;
+  struct dirent *de;
+  chunkHeader hdr;
+  chunkInfo *ci;
+  char path[PATH_MAX];
+  struct stat st;
+  int fd;
+
+  dir = opendir(h->dir);
+  if (!dir) {
+    return;
+  }
+  while ((de = readdir(dir)) && h->nChunks < HISTORY_MAX_CHUNKS) {
+    if (!strstr(de->d_name, ".chunk")) {
+      continue;
+    }
+    snprintf(path, sizeof(path), "%s/%s", h->dir, de->d_name);
+    fd = open(path, O_RDONLY);
+    if (fd < 0) {
+      continue;
+    }
+    if (read(fd, &hdr, sizeof(hdr)) != sizeof(hdr) || fstat(fd, &st) ||
+        hdr.magic != HISTORY_CHUNK_MAGIC) {
+      close(fd);
+      unlink(path);
+      continue;
+    }
+    close(fd);
+
+    ci = &h->chunks[h->nChunks++];
+    ci->seq = hdr.seq;
+    ci->start = hdr.start;
+    ci->end = hdr.end;
+    ci->size = st.st_size;
+    h->total += ci->size;
+    if (hdr.seq >= h->seq) {
+      h->seq = hdr.seq + 1;
+    }
+  }
+  closedir(dir);
+
+  qsort(h->chunks, h->nChunks, sizeof(chunkInfo), cmpChunk);
+  while (h->total > h->budget && h->nChunks > 1) {
+    dropOldestChunk(h);
+  }
+}
+
+historyStore* createHistory(const char *dev, uint32_t budget) {
+  historyStore *h;
+  int ret;
+
+  h = (historyStore*)calloc(1, sizeof(historyStore));
+  if (h == NULL) {
+    perror("Malloc error");
+    return NULL;
+  }
+
+  ret = snprintf(h->dir, sizeof(h->dir), "/var/log/mTerm_%s_history", dev);
+  if ((ret < 0) || (ret >= sizeof(h->dir))) {
+    perror("mTerm: Received dev name too long to create history");
+    free(h);
+    return NULL;
+  }
+  if (mkdir(h->dir, 0755) && errno != EEXIST) {
+    syslog(LOG_WARNING, "mTerm: cannot create %s, errno=%d", h->dir, errno);
+    free(h);
+    return NULL;
+  }
+
+  h->budget = budget;
+  scanChunks(h);
+  return h;
+}
+
+void closeHistory(historyStore *h) {
+  if (!h) {
+    return;
+  }
+  sealChunk(h);
+  free(h);
+}
+
+void writeToHistory(historyStore *h, char *data, int len) {
+  uint32_t now = time(NULL);
+  int n;
+
+  while (len > 0) {
+    if (h->rawLen == HISTORY_CHUNK_BYTES ||
+        (h->rawLen && now - h->start >= HISTORY_CHUNK_SECS) ||
+        (h->nIndex == HISTORY_INDEX_MAX &&
+         h->index[h->nIndex - 1].time != now)) {
+      sealChunk(h);
+    }
+    if (!h->rawLen) {
+      h->start = now;
+    }
+    if (!h->nIndex || h->index[h->nIndex - 1].time != now) {
+      h->index[h->nIndex].time = now;
+      h->index[h->nIndex].offset = h->rawLen;
+      h->nIndex++;
+    }
+
+    n = HISTORY_CHUNK_BYTES - h->rawLen;
+    if (n > len) {
+      n = len;
+    }
+    memcpy(h->raw + h->rawLen, data, n);
+    h->rawLen += n;
+    h->end = now;
+    data += n;
+    len -= n;
+  }
+}
+
+void historyTick(historyStore *h) {
+  if (h->rawLen && time(NULL) - h->start >= HISTORY_CHUNK_SECS) {
+    sealChunk(h);
+  }
+}
+
+// Find what of raw, indexed by index, came in between from and to
+static uint32_t findRange(const uint8_t *raw, uint32_t rawLen,
+                          const historyIndex *index, int nIndex,
+                          uint32_t from, uint32_t to, uint32_t *first) {
+  uint32_t last = rawLen;
+  int i;
+
+  *first = rawLen;
+  for (i = 0; i < nIndex; i++) {
+    if (index[i].offset > rawLen) {
+      return 0;
+    }
+    if (*first == rawLen && index[i].time >= from && index[i].time <= to) {
+      *first = index[i].offset;
+    }
+    if (*first != rawLen && index[i].time > to) {
+      last = index[i].offset;
+      break;
+    }
+  }
+  return (*first < last) ? last - *first : 0;
+}
+
+// Read chunk seq back into c->buf; returns the length of the range in it
+static uint32_t loadChunk(historyStore *h, historyCursor *c, uint32_t seq,
+                          uint32_t *first) {
+  chunkHeader hdr;
+  char path[PATH_MAX];
+  size_t indexLen = 0;
+  int fd, len, ok;
+
+  chunkPath(h, seq, path, sizeof(path));
+  fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    return 0;
+  }
+
+  ok = read(fd, &hdr, sizeof(hdr)) == sizeof(hdr) &&
+       hdr.magic == HISTORY_CHUNK_MAGIC &&
+       hdr.nIndex <= HISTORY_INDEX_MAX &&
+       hdr.rawLen <= HISTORY_CHUNK_BYTES &&
+       hdr.dataLen <= sizeof(h->comp);
+  if (ok) {
+    indexLen = hdr.nIndex * sizeof(historyIndex);
+    ok = read(fd, h->readIndex, indexLen) == indexLen &&
+         read(fd, h->comp, hdr.dataLen) == hdr.dataLen;
+  }
+  close(fd);
+  if (!ok) {
+    return 0;
+  }
+
+  if (hdr.flags & HISTORY_CHUNK_RAW) {
+    memcpy(c->buf, h->comp, hdr.dataLen);
+    len = hdr.dataLen;
+  } else {
+    len = lzDecompress(h->comp, hdr.dataLen, c->buf, sizeof(c->buf));
+  }
+  if (len != hdr.rawLen) {
+    syslog(LOG_WARNING, "mTerm: %s is corrupted", path);
+    return 0;
+  }
+  return findRange(c->buf, len, h->readIndex, hdr.nIndex, c->from, c->to,
+                   first);
+}
+
+historyCursor* historyOpen(historyStore *h, historyReq *req) {
+  historyCursor *c;
+
+  c = (historyCursor*)malloc(sizeof(historyCursor));
+  if (c == NULL) {
+    return NULL;
+  }
+  c->from = req->from;
+  c->to = req->to ? req->to : (uint32_t)-1;
+  c->nextSeq = 0;
+  return c;
+}
+
+uint32_t historyNext(historyStore *h, historyCursor *c, const uint8_t **data) {
+  chunkInfo *ci;
+  uint32_t first, len;
+  int i;
+
+  // Chunks are looked up by seq, as old ones go away in between calls
+  for (i = 0; i < h->nChunks; i++) {
+    ci = &h->chunks[i];
+    if (ci->seq < c->nextSeq) {
+      continue;
+    }
+    c->nextSeq = ci->seq + 1;
+    if (ci->end < c->from || ci->start > c->to) {
+      continue;
+    }
+    len = loadChunk(h, c, ci->seq, &first);
+    if (len) {
+      *data = c->buf + first;
+      return len;
+    }
+  }
+
+  // Then the chunk being filled, copied as it keeps changing
+  if (c->nextSeq <= h->seq) {
+    c->nextSeq = h->seq + 1;
+    if (h->rawLen && h->end >= c->from && h->start <= c->to) {
+      len = findRange(h->raw, h->rawLen, h->index, h->nIndex, c->from, c->to,
+                      &first);
+      memcpy(c->buf, h->raw + first, len);
+      *data = c->buf;
+      return len;
+    }
+  }
+  return 0;
+}
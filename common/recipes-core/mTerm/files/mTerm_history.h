@@ -0,0 +1,113 @@
+/*
+ * Copyright 2017-present Facebook. All Rights Reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+/*
+ * Console history. The console output is cut into chunks of up to
+ * HISTORY_CHUNK_BYTES, each LZ4 compressed into its own file under
+ * /var/log/mTerm_<fru>_history/ with an index of where every second of
+ * output starts. The oldest chunks are removed once the files together
+ * pass the byte budget.
+ */
+#include <stdint.h>
+
+#define HISTORY_CHUNK_BYTES  (64 * 1024)   // console bytes per chunk
+#define HISTORY_INDEX_MAX    512           // seconds indexed per chunk
+#define HISTORY_CHUNK_SECS   600           // a chunk this old is written out
+#define HISTORY_MAX_CHUNKS   1024
+#define HISTORY_BUDGET_BYTES (2 * 1024 * 1024)
+
+#define HISTORY_CHUNK_MAGIC  0x6d54484b
+#define HISTORY_CHUNK_RAW    0x1           // stored as is, did not compress
+
+// TLV type of a history request from the client
+#define TLV_HISTORY 'h'
+
+// Close the connection once the history is sent
+#define HISTORY_REQ_CLOSE    0x1
+
+typedef struct historyReq {
+  uint32_t from;      // seconds since the epoch
+  uint32_t to;        // 0 for up to now
+  uint32_t flags;
+} historyReq;
+
+typedef struct historyIndex {
+  uint32_t time;
+  uint32_t offset;    // of the first byte that came in at time
+} historyIndex;
+
+// Chunk file: this header, nIndex historyIndex, then the data
+typedef struct chunkHeader {
+  uint32_t magic;
+  uint32_t seq;
+  uint32_t start;
+  uint32_t end;
+  uint32_t rawLen;
+  uint32_t dataLen;
+  uint32_t nIndex;
+  uint32_t flags;
+} chunkHeader;
+
+typedef struct chunkInfo {
+  uint32_t seq;
+  uint32_t start;
+  uint32_t end;
+  uint32_t size;      // of the file
+} chunkInfo;
+
+typedef struct historyStore {
+  char dir[64];
+  uint32_t budget;
+  uint32_t total;     // bytes in chunk files
+  int nChunks;
+  chunkInfo chunks[HISTORY_MAX_CHUNKS];  // oldest first
+  // chunk being filled
+  uint32_t seq;
+  uint32_t start;
+  uint32_t end;
+  uint32_t rawLen;
+  int nIndex;
+  historyIndex index[HISTORY_INDEX_MAX];
+  uint8_t raw[HISTORY_CHUNK_BYTES];
+  // for compressing, and reading back, chunk files
+  uint8_t comp[HISTORY_CHUNK_BYTES + HISTORY_CHUNK_BYTES / 255 + 16];
+  historyIndex readIndex[HISTORY_INDEX_MAX];
+} historyStore;
+
+historyStore* createHistory(const char *dev, uint32_t budget);
+void closeHistory(historyStore *h);
+void writeToHistory(historyStore *h, char *data, int len);
+// Write out the chunk being filled if it is old enough
+void historyTick(historyStore *h);
+/*
+ * Where a client is in the history it asked for. The output is handed out
+ * one chunk at a time, so the server can send it as the client takes it.
+ */
+typedef struct historyCursor {
+  uint32_t from;
+  uint32_t to;
+  uint32_t nextSeq;   // chunk to look at next
+  uint8_t buf[HISTORY_CHUNK_BYTES];
+} historyCursor;
+
+historyCursor* historyOpen(historyStore *h, historyReq *req);
+/*
+ * Point *data at the next piece of the console output from req->from to
+ * req->to, valid until the next call. Returns its length, 0 at the end.
+ */
+uint32_t historyNext(historyStore *h, historyCursor *c, const uint8_t **data);
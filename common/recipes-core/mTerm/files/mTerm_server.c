@@ -23,10 +23,44 @@
 #include <errno.h>
 #include <syslog.h>
 #include <sys/uio.h>
+#include <signal.h>
+#include <time.h>
 #include "tty_helper.h"
 #include "mTerm_helper.h"
+#include "mTerm_history.h"
 
 #define NUM_CLIENTS 10
+#define CLIENT_QUEUE_BYTES (64 * 1024)  // console output held for a client
+#define CLIENT_STALL_SECS  10           // a client taking nothing this long is dropped
+#define CLIENT_QUIET_SECS  2            // wait for a client to say what it wants
+
+/*
+ * Output a client has not taken yet. Sends never block, so one slow client
+ * cannot hold up the console or the others. History goes out first, as the
+ * client takes it, and the console output meanwhile is queued behind it.
+ * Until a new client sends its first message, console output is only
+ * queued for it, so one that asks for the history alone gets nothing else.
+ */
+typedef struct clientOut {
+  historyCursor *hist;      // history still to be sent
+  int closeAfter;           // hang up once the history is sent, and send
+                            // no console output
+  int quiet;                // no first message yet
+  time_t accepted;
+  const uint8_t *data;      // piece of the history being sent
+  uint32_t dataLen;
+  char *queue;              // console output behind it
+  uint32_t queueLen;
+  time_t lastSent;          // last time anything went out while pending
+} clientOut;
+
+static clientOut clients[FD_SETSIZE];
+
+static sig_atomic_t sigexit = 0;
+
+static void exit_handler(int sig) {
+  sigexit = sig;
+}
 
 static int createServerSocket(const char* dev) {
   int serverFd;
@@ -87,17 +121,156 @@ static int acceptClient(int serverFd) {
 }
 
 void closeClient(fd_set* master, int clientfd) {
+  clientOut *c = &clients[clientfd];
+
+  free(c->hist);
+  free(c->queue);
+  memset(c, 0, sizeof(*c));
   close(clientfd);
   FD_CLR(clientfd, master);
 }
 
+static int clientPending(int clientfd) {
+  clientOut *c = &clients[clientfd];
+
+  return c->hist || c->dataLen || (c->queueLen && !c->quiet);
+}
+
+static void clientAccepted(int clientfd) {
+  clientOut *c = &clients[clientfd];
+
+  c->quiet = 1;
+  c->accepted = time(NULL);
+}
+
+// The client said what it wants, or took too long to
+static void clientHeard(int clientfd) {
+  clientOut *c = &clients[clientfd];
+
+  if (c->quiet) {
+    c->quiet = 0;
+    c->lastSent = time(NULL);
+  }
+}
+
+static int clientQueue(fd_set* master, int clientfd, const char *data, int len) {
+  clientOut *c = &clients[clientfd];
+
+  if (!c->queue) {
+    c->queue = malloc(CLIENT_QUEUE_BYTES);
+  }
+  if (!c->queue || c->queueLen + len > CLIENT_QUEUE_BYTES) {
+    syslog(LOG_ERR, "mTerm_server: Client fd=%d is too slow, dropping it\n",
+           clientfd);
+    closeClient(master, clientfd);
+    return -1;
+  }
+  if (!clientPending(clientfd)) {
+    c->lastSent = time(NULL);
+  }
+  memcpy(c->queue + c->queueLen, data, len);
+  c->queueLen += len;
+  return 0;
+}
+
+// Console output for a client: sent now if nothing is ahead of it, else queued
+static void clientSend(fd_set* master, int clientfd, const char *data, int len) {
+  clientOut *c = &clients[clientfd];
+  int n = 0;
+
+  if (c->closeAfter) {
+    return;
+  }
+  if (!c->quiet && !clientPending(clientfd)) {
+    n = send(clientfd, data, len, MSG_DONTWAIT | MSG_NOSIGNAL);
+    if (n < 0) {
+      if (errno != EAGAIN && errno != EWOULDBLOCK) {
+        syslog(LOG_ERR, "mTerm_server: Error on send fd=%d\n", clientfd);
+        closeClient(master, clientfd);
+        return;
+      }
+      n = 0;
+    }
+  }
+  if (n < len) {
+    clientQueue(master, clientfd, data + n, len - n);
+  }
+}
+
+// Send what the client can take of its history, then of its queue
+static void clientFlush(fd_set* master, int clientfd, historyStore *hist) {
+  clientOut *c = &clients[clientfd];
+  const char *buf;
+  int n, len;
+
+  for (;;) {
+    if (!c->dataLen && c->hist) {
+      c->dataLen = historyNext(hist, c->hist, &c->data);
+      if (!c->dataLen) {
+        free(c->hist);
+        c->hist = NULL;
+        if (c->closeAfter) {
+          closeClient(master, clientfd);
+          return;
+        }
+      }
+    }
+    if (c->dataLen) {
+      buf = (const char *)c->data;
+      len = c->dataLen;
+    } else if (c->queueLen && !c->quiet) {
+      buf = c->queue;
+      len = c->queueLen;
+    } else {
+      break;
+    }
+
+    n = send(clientfd, buf, len, MSG_DONTWAIT | MSG_NOSIGNAL);
+    if (n < 0) {
+      if (errno == EAGAIN || errno == EWOULDBLOCK) {
+        break;
+      }
+      syslog(LOG_ERR, "mTerm_server: Error on send fd=%d\n", clientfd);
+      closeClient(master, clientfd);
+      return;
+    }
+    c->lastSent = time(NULL);
+    if (c->dataLen) {
+      c->data += n;
+      c->dataLen -= n;
+    } else {
+      memmove(c->queue, c->queue + n, c->queueLen - n);
+      c->queueLen -= n;
+    }
+  }
+}
+
+static void clientHistory(fd_set* master, int clientfd, historyStore *hist,
+                          historyReq *req) {
+  clientOut *c = &clients[clientfd];
+
+  free(c->hist);
+  c->hist = historyOpen(hist, req);
+  c->dataLen = 0;
+  c->closeAfter = req->flags & HISTORY_REQ_CLOSE;
+  if (c->closeAfter) {
+    c->queueLen = 0;
+  }
+  if (!c->hist) {
+    closeClient(master, clientfd);
+    return;
+  }
+  c->lastSent = time(NULL);
+  clientFlush(master, clientfd, hist);
+}
+
 void sendBreak(int clientFd, int solFd, char *c) {
   syslog(LOG_INFO, "mTerm_server: Client socket %d send BREAK+%c\n", clientFd,*c);
   tcsendbreak(solFd, 1);
 }
 
 static void processClient(fd_set* master, int clientFd , int solFd,
-                          bufStore *buf) {
+                          bufStore *buf, historyStore *hist) {
   char data[SEND_SIZE];
   int nbytes = 0;
   TlvHeader header;
@@ -127,6 +300,7 @@ static void processClient(fd_set* master, int clientFd , int solFd,
   } else if (header.length > (nbytes - sizeof(header))) {
     syslog(LOG_ERR, "mTerm_server: Received %d bytes for fd=%d dropping message.\n",nbytes, clientFd);
   } else {
+    clientHeard(clientFd);
     switch (header.type) {
       case ASCII_CTRL_L:
         /* TODO: Server should store client pointers for last reference of
@@ -144,6 +318,23 @@ static void processClient(fd_set* master, int clientFd , int solFd,
           bufferGetLines(buf->file, clientFd, atoi(vec[1].iov_base), 0);
         }
         break;
+      case TLV_HISTORY:
+        if (header.length != sizeof(historyReq)) {
+          syslog(LOG_ERR, "mTerm_server: Received incorrect history request");
+          break;
+        }
+        if (!hist) {
+          syslog(LOG_ERR, "mTerm_server: No history to send fd=%d\n", clientFd);
+          // Such a client waits for the end of the history
+          if (((historyReq *)vec[1].iov_base)->flags & HISTORY_REQ_CLOSE) {
+            closeClient(master, clientFd);
+          }
+          break;
+        }
+        clientHistory(master, clientFd, hist, vec[1].iov_base);
+        break;
+      case TLV_LIVE:
+        break;
       case 'x':
         syslog(LOG_INFO, "mTerm_server: Client socket %d closed\n", clientFd);
         closeClient(master, clientFd);
@@ -158,12 +349,8 @@ static void processClient(fd_set* master, int clientFd , int solFd,
   }
 }
 
-/* TODO: We should support non-blocking writes to clients, and buffer data if
-they don't read it fast enough. If we end up buffering too much data for any
-particular client then we should disconnect that client.
-*/
 static int processSol(fd_set* master, int serverfd, int fdmax,
-                      int solFd, bufStore *buf) {
+                      int solFd, bufStore *buf, historyStore *hist) {
   char data[SEND_SIZE];
   int nbytes;
   int currFd;
@@ -173,15 +360,14 @@ static int processSol(fd_set* master, int serverfd, int fdmax,
     for (currFd = 0; currFd <= fdmax; currFd++) {
       if (FD_ISSET(currFd, master)) {
         if ((currFd != serverfd) && (currFd != solFd)) {
-          if (send(currFd, data, nbytes, 0) == -1) {
-            syslog(LOG_ERR, "mTerm_server: Error on send fd=%d\n", currFd);
-            closeClient(master, currFd);
-            syslog(LOG_ERR, "mTerm_server: Terminated client fd=%d\n", currFd);
-          }
+          clientSend(master, currFd, data, nbytes);
         }
       }
     }
     writeToBuffer(buf, data, nbytes);
+    if (hist) {
+      writeToHistory(hist, data, nbytes);
+    }
   } else if (nbytes < 0) {
     syslog(LOG_ERR, "mTerm_server: Error on read fd=%d\n", solFd);
     return -1;
@@ -190,11 +376,13 @@ static int processSol(fd_set* master, int serverfd, int fdmax,
 }
 
 static void connectServer(const char *stty, const char *dev) {
-  int fdmax, newfd;
+  int fdmax, newfd, pending, i;
+  time_t now;
 
-  fd_set master, read_fds;
+  fd_set master, read_fds, write_fds;
   FD_ZERO(&master);
   FD_ZERO(&read_fds);
+  FD_ZERO(&write_fds);
 
   int serverfd;
   serverfd = createServerSocket(dev);
@@ -220,21 +408,60 @@ static void connectServer(const char *stty, const char *dev) {
     return;
   }
 
+  // Without it there is just the log file
+  struct historyStore* hist;
+  hist = createHistory(dev, HISTORY_BUDGET_BYTES);
+  if (!hist) {
+    syslog(LOG_ERR, "mTerm_server: Failed to create the console history\n");
+  }
+
   FD_SET(serverfd, &master);
   FD_SET(tty_sol->fd,&master);
   fdmax = (serverfd > tty_sol->fd) ? serverfd : tty_sol->fd;
 
+  // Stopping the service keeps what the history has not written out yet
+  signal(SIGTERM, exit_handler);
+  signal(SIGINT, exit_handler);
+
+  struct timeval tv;
   for(;;) {
+    if (sigexit) {
+      break;
+    }
     read_fds = master;
-    if (select(fdmax + 1, &read_fds, NULL, NULL, NULL) == -1) {
-      syslog(LOG_ERR, "mTerm_server: Server socket: select error\n");
+    FD_ZERO(&write_fds);
+    pending = 0;
+    for (i = 0; i <= fdmax; i++) {
+      if (FD_ISSET(i, &master) && clientPending(i)) {
+        FD_SET(i, &write_fds);
+        pending = 1;
+      }
+      if (FD_ISSET(i, &master) && clients[i].quiet) {
+        pending = 1;
+      }
+    }
+    // Wake up now and then to write out a chunk of a quiet console, and
+    // often enough to drop stalled clients and give up on silent ones
+    tv.tv_sec = pending ? 1 : 60;
+    tv.tv_usec = 0;
+    if (select(fdmax + 1, &read_fds, &write_fds, NULL, &tv) == -1) {
+      if (errno == EINTR && !sigexit) {
+        continue;
+      }
+      if (!sigexit) {
+        syslog(LOG_ERR, "mTerm_server: Server socket: select error\n");
+      }
       break;
     }
+    if (hist) {
+      historyTick(hist);
+    }
     if (FD_ISSET(serverfd, &read_fds)) {
       newfd = acceptClient(serverfd);
       if (newfd < 0) {
         syslog(LOG_ERR, "mTerm_server: Error on accepting client\n");
       } else {
+        clientAccepted(newfd);
         FD_SET(newfd, &master);
         if (newfd > fdmax) {
           fdmax = newfd;
@@ -242,24 +469,43 @@ static void connectServer(const char *stty, const char *dev) {
       }
     }
     if (FD_ISSET(tty_sol->fd, &read_fds)) {
-      if ( processSol(&master, serverfd, fdmax, tty_sol->fd, buf) < 0) {
+      if ( processSol(&master, serverfd, fdmax, tty_sol->fd, buf, hist) < 0) {
         break;
       }
     }
-    int i;
     for(i = 0; i <= fdmax; i++) {
       if (FD_ISSET(i, &read_fds)) {
         if ((i == serverfd) || (i == tty_sol->fd)) {
           continue;
         } else {
-          processClient(&master, i, tty_sol->fd, buf);
+          processClient(&master, i, tty_sol->fd, buf, hist);
         }
       }
     }
+    now = time(NULL);
+    for (i = 0; i <= fdmax; i++) {
+      // Older clients do not send a message when they attach
+      if (FD_ISSET(i, &master) && clients[i].quiet &&
+          now - clients[i].accepted >= CLIENT_QUIET_SECS) {
+        clientHeard(i);
+      }
+      if (!FD_ISSET(i, &master) || !clientPending(i)) {
+        continue;
+      }
+      if (FD_ISSET(i, &write_fds)) {
+        clientFlush(&master, i, hist);
+      }
+      if (FD_ISSET(i, &master) && clientPending(i) &&
+          now - clients[i].lastSent >= CLIENT_STALL_SECS) {
+        syslog(LOG_ERR, "mTerm_server: Client fd=%d stalled, dropping it\n", i);
+        closeClient(&master, i);
+      }
+    }
   }
   closeTty(tty_sol);
   close(serverfd);
   closeBuffer(buf);
+  closeHistory(hist);
 }
 
 static void
@@ -32,43 +32,10 @@
 #include <errno.h>
 #include <sys/ioctl.h>
 #include <getopt.h>
+#include <time.h>
+#include <endian.h>
 #include <openbmc/pal.h>
-
-/***********************************************************************/
-struct timing_negotiation {
-  uint8_t msg_timing;
-  uint8_t addr_timing;
-};
-
-struct xfer_msg {
-  uint8_t client_addr;
-  uint8_t tx_len;
-  uint8_t rx_len;
-  uint8_t tx_fcs;
-  uint8_t rx_fcs;
-  uint8_t fcs_en;
-  uint8_t sw_fcs;
-  uint8_t *tx_buf;
-  uint8_t *rx_buf;
-  uint32_t sts;
-};
-
-#define PECI_DEVICE "/dev/ast-peci"
-
-//IOCTL ..
-#define PECIIOC_BASE 'P'
-
-#define AST_PECI_IOCRTIMING _IOR(PECIIOC_BASE, 0, struct timing_negotiation*)
-#define AST_PECI_IOCWTIMING _IOW(PECIIOC_BASE, 1, struct timing_negotiation*)
-#define AST_PECI_IOCXFER _IOWR(PECIIOC_BASE, 2, struct xfer_msg*)
-
-#define PECI_INT_TIMEOUT     (0x1 << 4)
-#define PECI_INT_CONNECT     (0x1 << 3)
-#define PECI_INT_W_FCS_BAD   (0x1 << 2)
-#define PECI_INT_W_FCS_ABORT (0x1 << 1)
-#define PECI_INT_CMD_DONE    (0x1)
-
-/***********************************************************************/
+#include <openbmc/peci.h>
 
 #if defined(__GNUC__)
 int pal_before_peci(void) __attribute__((weak));
@@ -78,27 +45,131 @@ static int process_file (int peci_fd, char* file_path);
 static int process_command (int peci_fd, int argc, char **argv);
 
 static uint8_t awfcs_en = 0;
-static uint8_t retry_times = 3;
-static uint8_t retry_interval = 250;
+static int retry_times = 3;
+static int retry_interval = 250;
 static uint8_t verbose = 0;
 
+enum {
+  OUTPUT_TEXT,
+  OUTPUT_JSON,
+  OUTPUT_BINARY,
+};
+static uint8_t output = OUTPUT_TEXT;
+// Commands from a pipe go out as soon as they are done
+static uint8_t streaming = 0;
+
+static struct {
+  unsigned int cmds;
+  unsigned int retries;
+  unsigned int failed;
+} stats;
+
 static void
 print_usage_help(void) {
   printf("Usage: peci-util <client addr> <Tx length> <Rx length> <[0..n]data_bytes_to_send>\n");
-  printf("       peci-util -f <peci command file>\n");
+  printf("       peci-util -f <peci command file | ->\n");
   printf("  client addr: 0x30 CPU0, 0x31 CPU1\n");
   printf("  --awfcs, -a <1|0>\n");
   printf("    Enable/Disable AW FCS, default is 0\n");
   printf("  --retry, -r <retry times>\n");
-  printf("    Retry times if CC is 0x80 or 0x81. Default is 3\n");
+  printf("    Keep retrying for <retry times> intervals if CC is 0x80 or 0x81. Default is 3\n");
   printf("  --interval, -i <interval>\n");
-  printf("    Interval between retry, unit is ms. Default is 250\n");
+  printf("    Longest interval between retries, unit is ms. Default is 250\n");
   printf("  --verbose, -v\n");
   printf("    Display verbose information\n");
   printf("  --help, -h\n");
   printf("    Display this help messages\n");
   printf("  --file, -f <file>\n");
-  printf("    Read commands from <file>\n");
+  printf("    Read commands from <file>, or from stdin for -\n");
+  printf("  --output, -o <text|json|binary>\n");
+  printf("    Format of the responses. Default is text\n");
+}
+
+// Verbose messages stay out of the way of json and binary output
+static FILE *
+info_fp(void) {
+  return (output == OUTPUT_TEXT) ? stdout : stderr;
+}
+
+static void
+print_hex(const uint8_t *buf, int len) {
+  int i;
+
+  for (i = 0; i < len; i++)
+    printf("%02x", buf[i]);
+}
+
+static void
+print_echo(const char *str) {
+  const char *p;
+
+  switch (output) {
+  case OUTPUT_JSON:
+    printf("{\"echo\":\"");
+    for (p = str; *p && *p != '\n'; p++) {
+      if (*p == '"' || *p == '\\')
+        putchar('\\');
+      if ((unsigned char)*p >= 0x20)
+        putchar(*p);
+    }
+    printf("\"}\n");
+    break;
+  case OUTPUT_BINARY:
+    // No room for text in the records
+    return;
+  default:
+    printf("%s", str);
+    break;
+  }
+  if (streaming)
+    fflush(stdout);
+}
+
+static void
+print_result(const peci_cmd_t *cmd, const peci_result_t *res) {
+  peci_record_t rec;
+  uint32_t ms;
+  int i;
+
+  switch (output) {
+  case OUTPUT_JSON:
+    printf("{\"addr\":%d,\"tx\":\"", cmd->addr);
+    print_hex(cmd->tx, cmd->tx_len);
+    if (res->status) {
+      printf("\",\"error\":%u", res->sts);
+    } else {
+      printf("\",\"cc\":%d,\"rx\":\"", res->rx[0]);
+      print_hex(res->rx, cmd->rx_len);
+      printf("\"");
+    }
+    printf(",\"retries\":%d,\"us\":%u}\n", res->retries, res->us);
+    break;
+  case OUTPUT_BINARY:
+    ms = res->us / 1000;
+    rec.addr = cmd->addr;
+    rec.tx_len = cmd->tx_len;
+    rec.rx_len = cmd->rx_len;
+    rec.status = res->status ? 1 : 0;
+    rec.retries = res->retries;
+    rec.reserved = 0;
+    rec.ms = htole16(ms > 0xFFFF ? 0xFFFF : ms);
+    fwrite(&rec, sizeof(rec), 1, stdout);
+    fwrite(cmd->tx, 1, cmd->tx_len, stdout);
+    fwrite(res->rx, 1, cmd->rx_len, stdout);
+    break;
+  default:
+    if (res->status) {
+      fprintf(stderr, "PECI failed. sts:%08Xh\n", res->sts);
+      break;
+    }
+    for (i = 0; i < cmd->rx_len; i++) {
+      printf("%02X ", res->rx[i]);
+    }
+    printf("\n");
+    break;
+  }
+  if (streaming)
+    fflush(stdout);
 }
 
 #define MAX_ARG_NUM 64
@@ -110,7 +181,10 @@ process_file (int peci_fd, char* path) {
   char *str, *next, *del=" \n";
   char *argv[MAX_ARG_NUM];
 
-  if (!(fp = fopen(path, "r"))) {
+  if (!strcmp(path, "-")) {
+    fp = stdin;
+    streaming = 1;
+  } else if (!(fp = fopen(path, "r"))) {
     syslog(LOG_WARNING, "Failed to open %s", path);
     return -1;
   }
@@ -124,7 +198,7 @@ process_file (int peci_fd, char* path) {
         break;
 
       if ((argc == 1) && !strcmp(str, "echo")) {
-        printf("%s", (*next) ? next : "\n");
+        print_echo((*next) ? next : "\n");
         break;
       }
       argv[argc] = str;
@@ -137,37 +211,35 @@ process_file (int peci_fd, char* path) {
     if (ret)
       final_ret = ret;
   }
-  fclose(fp);
+  if (fp != stdin)
+    fclose(fp);
 
   return final_ret;
 }
 
 static int
 process_command (int peci_fd, int argc, char **argv) {
-  struct xfer_msg msg;
-  uint8_t tbuf[32] = {0x00};
-  uint8_t rbuf[32] = {0x00};
-  uint8_t tlen = 0;
-  uint16_t rlen = 0;
-  int i, opt, retry;
+  peci_cmd_t cmd;
+  peci_result_t res;
+  peci_retry_t retry;
+  char line[1024];
+  int i, opt, len;
   char file_path[256];
   int optind_long = 0;
 
-  static const char* optstring = "a:r:i:f:vhe";
+  static const char* optstring = "a:r:i:f:o:vhe";
   static const struct option long_options[] = {
     {"awfcs", required_argument, 0, 'a'},
     {"retry", required_argument, 0, 'r'},
     {"interval", required_argument, 0, 'i'},
     {"file", required_argument, 0, 'f'},
+    {"output", required_argument, 0, 'o'},
     {"verbose", no_argument, 0, 'v'},
     {"help", no_argument, 0, 'h'},
     {"echo", no_argument, 0, 'e'},
     {0, 0, 0, 0}
   };
 
-  msg.tx_buf = tbuf;
-  msg.rx_buf = rbuf;
-
   optind = 0; // Reset getopt function
   while ((opt = getopt_long(argc, argv, optstring, long_options, &optind_long)) != -1) {
     switch (opt) {
@@ -183,6 +255,18 @@ process_command (int peci_fd, int argc, char **argv) {
     case 'f':
       strncpy(file_path, optarg, 256);
       return process_file(peci_fd, file_path);
+    case 'o':
+      if (!strcmp(optarg, "text")) {
+        output = OUTPUT_TEXT;
+      } else if (!strcmp(optarg, "json")) {
+        output = OUTPUT_JSON;
+      } else if (!strcmp(optarg, "binary")) {
+        output = OUTPUT_BINARY;
+      } else {
+        printf("Unknown output format %s.\n", optarg);
+        goto err_exit;
+      }
+      break;
     case 'v':
       verbose = 1;
       break;
@@ -190,9 +274,11 @@ process_command (int peci_fd, int argc, char **argv) {
       print_usage_help();
       return 0;
     case 'e':
-      for (i=optind; i<argc; i++)
-        printf("%s ", argv[i]);
-      printf("\n");
+      line[0] = '\0';
+      for (i=optind, len=0; i<argc && len<sizeof(line); i++)
+        len += snprintf(line+len, sizeof(line)-len, "%s ", argv[i]);
+      strncat(line, "\n", sizeof(line)-strlen(line)-1);
+      print_echo(line);
       return 0;
     default:
       printf("Unknown option.\n");
@@ -200,93 +286,51 @@ process_command (int peci_fd, int argc, char **argv) {
     }
   }
 
-  // fill xfer_msg
-  if (argc - optind < 3) {
-    goto err_exit;
-  }
-  i = optind;
-  msg.client_addr = (uint8_t)strtoul(argv[i++], NULL, 0);
-  msg.tx_len = (uint8_t)strtoul(argv[i++], NULL, 0);
-  msg.rx_len = (uint8_t)strtoul(argv[i++], NULL, 0);
-  msg.fcs_en = awfcs_en;
-  if (argc - i != msg.tx_len || msg.tx_len > 32 || msg.rx_len > 32) {
+  if (peci_parse_cmd(argc - optind, &argv[optind], &cmd)) {
     goto err_exit;
   }
-  while (i < argc) {
-    tbuf[tlen++] = (uint8_t)strtoul(argv[i++], NULL, 0);
-  }
+  cmd.awfcs = awfcs_en;
 
   if (verbose) {
-    printf("awfcs:%d,addr:%d,", msg.fcs_en, msg.client_addr);
-    printf("tx(%d):", msg.tx_len);
-    for (i=0; i<msg.tx_len; i++)
-      printf("%02X ", tbuf[i]);
-    printf("rx(%d)", msg.rx_len);
-    printf("\n");
+    fprintf(info_fp(), "awfcs:%d,addr:%d,", cmd.awfcs, cmd.addr);
+    fprintf(info_fp(), "tx(%d):", cmd.tx_len);
+    for (i=0; i<cmd.tx_len; i++)
+      fprintf(info_fp(), "%02X ", cmd.tx[i]);
+    fprintf(info_fp(), "rx(%d)", cmd.rx_len);
+    fprintf(info_fp(), "\n");
   }
 
-  retry = 0;
-  do {
-    ioctl(peci_fd, AST_PECI_IOCXFER, &msg);
+  retry.retries = retry_times;
+  retry.interval_ms = retry_interval;
+  peci_xfer(peci_fd, &cmd, &retry, &res);
 
-    switch (msg.sts) {
-      case PECI_INT_CMD_DONE:
-        break;
-      default:
-        fprintf(stderr, "PECI failed. sts:%08Xh\n", msg.sts);
-        return -1;
-    }
-
-    if (retry_times) {
-      switch (msg.rx_buf[0]) {
-        case 0x80: // Response timeout, Data not ready
-        case 0x81: // Response timeout, not able to allocate resource
-          if (verbose) {
-            printf("CC: %02Xh, retry...\n", msg.rx_buf[0]);
-          }
-          if (retry < retry_times) {
-            retry++;
-            usleep(retry_interval*1000);
-            continue;
-          }
-          break;
-        case 0x40: // Command Passed
-        case 0x82: // Low power state
-        case 0x90: // Unknown/Invalid/Illegal Request
-        case 0x91: // Error
-        default:
-          break;
-      }
-    }
-    break;
-  } while (retry < retry_times);
+  stats.cmds++;
+  stats.retries += res.retries;
+  if (res.status)
+    stats.failed++;
 
-  if (verbose && retry_times) {
-    if (retry == retry_times)
-      printf("retry count is full.\n");
+  if (verbose && res.retries) {
+    fprintf(info_fp(), "CC: %02Xh after %d retries in %u ms\n",
+            res.rx[0], res.retries, res.us / 1000);
   }
 
-  // Print the response
-  for (i = 0; i < msg.rx_len; i++) {
-    printf("%02X ", msg.rx_buf[i]);
-  }
-  printf("\n");
+  print_result(&cmd, &res);
+  return res.status;
 
-  return 0;
 err_exit:
   printf("wrong arg:");
   for (i=0; i<argc; i++)
     printf("%s ", argv[i]);
   printf("\n");
   print_usage_help();
-exit:
   return -1;
 }
 
+int
 main(int argc, char **argv) {
-  int peci_fd = 0;
-  int timeout = 5;
+  int peci_fd;
   int ret = -1;
+  struct timespec start, end;
 
   if (pal_is_crashdump_ongoing(1)) {
     printf("Auto Crash Dump is ongoing, block peci-util.\n");
@@ -295,18 +339,25 @@ main(int argc, char **argv) {
   if (pal_before_peci != NULL)
     pal_before_peci();
 
-  while ((peci_fd = open(PECI_DEVICE, O_RDWR)) < 0) {
-    if (timeout-- < 0) {
-      fprintf(stderr, "Failed to open %s\n", PECI_DEVICE);
-      return -1;
-    }
-    usleep(10*1000);
+  if ((peci_fd = peci_open()) < 0) {
+    fprintf(stderr, "Failed to open PECI device\n");
+    if (pal_after_peci != NULL)
+      pal_after_peci();
+    return -1;
   }
 
+  clock_gettime(CLOCK_MONOTONIC, &start);
   ret = process_command(peci_fd, argc, argv);
+  clock_gettime(CLOCK_MONOTONIC, &end);
+
+  if (verbose && stats.cmds > 1) {
+    fprintf(stderr, "%u commands, %u retries, %u failed in %ld ms\n",
+            stats.cmds, stats.retries, stats.failed,
+            (end.tv_sec - start.tv_sec) * 1000 +
+            (end.tv_nsec - start.tv_nsec) / 1000000);
+  }
 
-  if (peci_fd)
-    close(peci_fd);
+  peci_close(peci_fd);
   if (pal_after_peci != NULL)
     pal_after_peci();
   return ret;
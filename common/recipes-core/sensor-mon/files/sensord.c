@@ -33,6 +33,7 @@
 #include <openbmc/sdr.h>
 #include <openbmc/pal.h>
 #include <openbmc/obmc-sensor.h>
+#include <openbmc/evbus.h>
 
 #define DELAY 2
 #define STOP_PERIOD 10
@@ -41,6 +42,39 @@
 
 static thresh_sensor_t g_snr[MAX_NUM_FRUS][MAX_SENSOR_NUM] = {0};
 
+/* Results of one pal_sensor_sweep() of a fru */
+typedef struct {
+  uint8_t seen[256];
+  int ret[256];
+  float value[256];
+} sweep_result_t;
+
+static void
+sweep_result(uint8_t fru, uint8_t snr_num, int ret, float value, void *arg) {
+  sweep_result_t *res = (sweep_result_t *) arg;
+
+  res->seen[snr_num] = 1;
+  res->ret[snr_num] = ret;
+  res->value[snr_num] = value;
+  /* The sweep cached it, only the history is left to record */
+  if (!ret)
+    sensor_history_write(fru, snr_num, value);
+}
+
+/*
+ * Value of a sensor after a sweep: what the sweep read, the cached value if
+ * it was not due, or a read of its own if the sweep does not cover it
+ */
+static int
+sweep_read(sweep_result_t *res, uint8_t fru, uint8_t snr_num, float *value) {
+  if (!res->seen[snr_num])
+    return sensor_raw_read(fru, snr_num, value);
+  if (res->ret[snr_num] > 0)
+    return sensor_cache_read(fru, snr_num, value);
+  *value = res->value[snr_num];
+  return res->ret[snr_num];
+}
+
 static void
 print_usage() {
     printf("Usage: sensord <options>\n");
@@ -140,6 +174,23 @@ get_snr_thresh_val(uint8_t fru, uint8_t snr_num, uint8_t thresh) {
   return val;
 }
 
+// Publish a threshold event for readers of the event bus
+static void
+publish_thresh_event(uint8_t fru, uint8_t snr_num, uint8_t thresh,
+                     uint8_t assert, float curr_val, char *thresh_name) {
+  thresh_sensor_t *snr = &g_snr[fru-1][snr_num];
+  evbus_sensor_t ev = {
+    .snr_num = snr_num,
+    .thresh = thresh,
+    .assert = assert,
+    .value = curr_val,
+  };
+
+  evbus_publish(EVBUS_T_SENSOR, fru, LOG_CRIT, &ev, sizeof(ev),
+                "%s: %s %s %.2f %s", assert ? "ASSERT" : "DEASSERT",
+                snr->name, thresh_name, curr_val, snr->units);
+}
+
 /*
  * Check the curr sensor values against the threshold and
  * if the curr val has deasserted, log it.
@@ -237,6 +288,7 @@ check_thresh_deassert(uint8_t fru, uint8_t snr_num, uint8_t thresh,
         "curr_val: %.2f %s, thresh_val: %.2f %s, snr: %-16s",thresh_name,
         fru, snr_num, *curr_val, snr[snr_num].units, thresh_val,
         snr[snr_num].units, snr[snr_num].name);
+    publish_thresh_event(fru, snr_num, thresh, 0, *curr_val, thresh_name);
     pal_sensor_deassert_handle(snr_num, *curr_val, thresh);
   }
 
@@ -343,6 +395,7 @@ check_thresh_assert(uint8_t fru, uint8_t snr_num, uint8_t thresh,
         " curr_val: %.2f %s, thresh_val: %.2f %s, snr: %-16s", thresh_name,
         fru, snr_num, *curr_val, snr[snr_num].units, thresh_val,
         snr[snr_num].units, snr[snr_num].name);
+    publish_thresh_event(fru, snr_num, thresh, 1, *curr_val, thresh_name);
     pal_sensor_assert_handle(snr_num, *curr_val, thresh);
   }
 
@@ -362,6 +415,7 @@ snr_monitor(void *arg) {
   float curr_val;
   uint8_t *sensor_list, *discrete_list;
   thresh_sensor_t *snr;
+  sweep_result_t *sweep;
 
   ret = pal_get_fru_sensor_list(fru, &sensor_list, &sensor_cnt);
   if (ret < 0) {
@@ -391,6 +445,12 @@ snr_monitor(void *arg) {
     pal_get_sensor_name(fru, snr_num, snr[snr_num].name);
   }
 
+  sweep = calloc(1, sizeof(sweep_result_t));
+  if (sweep == NULL) {
+    syslog(LOG_WARNING, "snr_monitor: sweep result alloc failed");
+    exit(-1);
+  }
+
   while(1) {
 
     if (pal_is_fw_update_ongoing(fru)) {
@@ -398,11 +458,15 @@ snr_monitor(void *arg) {
       continue;
     }
 
+    // Read the fru in bus order where the platform supports it
+    memset(sweep->seen, 0, sizeof(sweep->seen));
+    pal_sensor_sweep(fru, sweep_result, sweep);
+
     for (i = 0; i < sensor_cnt; i++) {
       snr_num = sensor_list[i];
       curr_val = 0;
       if (snr[snr_num].flag) {
-        if (!(ret = sensor_raw_read(fru, snr_num, &curr_val))) {
+        if (!(ret = sweep_read(sweep, fru, snr_num, &curr_val))) {
 
           check_thresh_assert(fru, snr_num, UNR_THRESH, &curr_val);
           check_thresh_assert(fru, snr_num, UCR_THRESH, &curr_val);
@@ -428,7 +492,7 @@ snr_monitor(void *arg) {
 
     for (i = 0; i < discrete_cnt; i++) {
       snr_num = discrete_list[i];
-      ret = sensor_raw_read(fru, snr_num, &curr_val);
+      ret = sweep_read(sweep, fru, snr_num, &curr_val);
       if (!ret && (snr[snr_num].curr_state != (int) curr_val)) {
         pal_sensor_discrete_check(fru, snr_num, snr[snr_num].name,
             snr[snr_num].curr_state, (int) curr_val);
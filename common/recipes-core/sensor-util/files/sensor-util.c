@@ -40,7 +40,7 @@
 #define STATUS_LCR  "lcr"
 #define STATUS_LNR  "lnr"
 
-#define MAX_HISTORY_PERIOD  3600
+#define MAX_HISTORY_PERIOD  (7 * 24 * 3600)
 
 static void
 print_usage() {
@@ -22,9 +22,11 @@
 
 #include <linux/err.h>
 #include <linux/errno.h>
+#include <linux/bitops.h>
 #include <linux/hwmon.h>
 #include <linux/hwmon-sysfs.h>
 #include <linux/i2c.h>
+#include <linux/jiffies.h>
 #include <linux/module.h>
 #include <linux/mutex.h>
 #include <linux/slab.h>
@@ -45,6 +47,146 @@
 
 #endif
 
+/*
+ * Register cache. Many attributes are bit-fields of the same register, so
+ * reading them one after the other reads that register over and over.
+ * With the cache on, a register read over the bus is kept for
+ * cache_ttl_ms and the other attributes in it are served from memory;
+ * writing an attribute drops its register. "regmap" returns all the
+ * registers the attributes cover, in I2C block reads of up to
+ * I2C_SMBUS_BLOCK_MAX bytes when the adapter and the device do them.
+ *
+ * To try it without the hardware:
+ *   modprobe i2c-stub chip_addr=0x31
+ *   echo syscpld 0x31 > /sys/bus/i2c/devices/i2c-<stub bus>/new_device
+ * then set registers with i2cset and read the attributes, "regmap" and
+ * "cache_stats".
+ */
+
+#define I2C_DEV_N_REGS 256
+
+typedef struct i2c_dev_cache_st_ {
+  unsigned int ic_ttl_ms;
+  unsigned long ic_ttl;           /* ic_ttl_ms in jiffies, 0 to not cache */
+  int ic_n_regs;                  /* registers 0 to ic_n_regs - 1 */
+  bool ic_block_read;
+  uint8_t ic_regs[I2C_DEV_N_REGS];
+  unsigned long ic_time[I2C_DEV_N_REGS];
+  DECLARE_BITMAP(ic_valid, I2C_DEV_N_REGS);
+  unsigned long ic_hits;
+  unsigned long ic_reads;
+  unsigned long ic_block_reads;
+  struct bin_attribute ic_regmap_attr;
+  struct device_attribute ic_ttl_attr;
+  struct device_attribute ic_stats_attr;
+  struct attribute *ic_attrs[3];
+  struct bin_attribute *ic_bin_attrs[2];
+  struct attribute_group ic_attr_group;
+} i2c_dev_cache_st;
+
+static bool i2c_dev_cache_fresh(i2c_dev_cache_st *cache, int reg)
+{
+  return cache && cache->ic_ttl && reg >= 0 && reg < cache->ic_n_regs
+    && test_bit(reg, cache->ic_valid)
+    && time_before(jiffies, cache->ic_time[reg] + cache->ic_ttl);
+}
+
+static void i2c_dev_cache_fill(i2c_dev_cache_st *cache, int reg, uint8_t val)
+{
+  if (!cache || !cache->ic_ttl || reg < 0 || reg >= cache->ic_n_regs) {
+    return;
+  }
+  cache->ic_regs[reg] = val;
+  cache->ic_time[reg] = jiffies;
+  set_bit(reg, cache->ic_valid);
+}
+
+static void i2c_dev_cache_drop(i2c_dev_data_st *data, int reg)
+{
+  if (data->idd_cache && reg >= 0 && reg < I2C_DEV_N_REGS) {
+    clear_bit(reg, data->idd_cache->ic_valid);
+  }
+}
+
+static void i2c_dev_cache_drop_all(i2c_dev_data_st *data)
+{
+  if (data->idd_cache) {
+    bitmap_zero(data->idd_cache->ic_valid, I2C_DEV_N_REGS);
+  }
+}
+
+/* Read one register, from the cache if it is fresh. idd_lock is held. */
+static int i2c_dev_read_reg(struct i2c_client *client,
+                            i2c_dev_data_st *data, int reg)
+{
+  i2c_dev_cache_st *cache = data->idd_cache;
+  int val;
+
+  if (i2c_dev_cache_fresh(cache, reg)) {
+    cache->ic_hits++;
+    return cache->ic_regs[reg];
+  }
+
+  val = i2c_smbus_read_byte_data(client, reg);
+
+  if (cache) {
+    cache->ic_reads++;
+    if (val >= 0) {
+      i2c_dev_cache_fill(cache, reg, val);
+    }
+  }
+  return val;
+}
+
+/*
+ * Read count registers from reg on, a block at a time: from the cache if
+ * the whole block is fresh, else in one block read, or byte by byte if
+ * the device can't do those. idd_lock is held.
+ */
+static int i2c_dev_read_regs(struct i2c_client *client,
+                             i2c_dev_data_st *data, int reg,
+                             uint8_t values[], int count)
+{
+  i2c_dev_cache_st *cache = data->idd_cache;
+  int i, j, n;
+  int ret_val;
+
+  for (i = 0; i < count; i += n) {
+    n = min(count - i, I2C_SMBUS_BLOCK_MAX);
+
+    for (j = 0; j < n && i2c_dev_cache_fresh(cache, reg + i + j); j++);
+    if (j == n) {
+      memcpy(&values[i], &cache->ic_regs[reg + i], n);
+      cache->ic_hits += n;
+      continue;
+    }
+
+    if (!cache || !cache->ic_block_read) {
+      for (j = 0; j < n; j++) {
+        ret_val = i2c_dev_read_reg(client, data, reg + i + j);
+        if (ret_val < 0) {
+          return ret_val;
+        }
+        values[i + j] = ret_val;
+      }
+      continue;
+    }
+
+    ret_val = i2c_smbus_read_i2c_block_data(client, reg + i, n, &values[i]);
+    cache->ic_block_reads++;
+    if (ret_val < 0) {
+      return ret_val;
+    }
+    if (ret_val != n) {
+      return -EIO;
+    }
+    for (j = 0; j < n; j++) {
+      i2c_dev_cache_fill(cache, reg + i + j, values[i + j]);
+    }
+  }
+  return count;
+}
+
 ssize_t i2c_dev_show_label(struct device *dev,
                            struct device_attribute *attr,
                            char *buf)
@@ -73,7 +215,7 @@ int i2c_dev_read_byte(struct device *dev,
 
   mutex_lock(&data->idd_lock);
 
-  val = i2c_smbus_read_byte_data(client, dev_attr->ida_reg);
+  val = i2c_dev_read_reg(client, data, dev_attr->ida_reg);
 
   mutex_unlock(&data->idd_lock);
 
@@ -101,7 +243,7 @@ int i2c_dev_read_nbytes(struct device *dev,
 
   mutex_lock(&data->idd_lock);
   for (i = 0; i < nbytes; ++i) {
-    ret_val = i2c_smbus_read_byte_data(client, dev_attr->ida_reg + i);
+    ret_val = i2c_dev_read_reg(client, data, dev_attr->ida_reg + i);
     if (ret_val < 0) {
       mutex_unlock(&data->idd_lock);
       return ret_val;
@@ -192,7 +334,7 @@ static ssize_t i2c_dev_sysfs_show(struct device *dev,
   mutex_lock(&data->idd_lock);
 
   /* default handling */
-  val = i2c_smbus_read_byte_data(client, dev_attr->ida_reg);
+  val = i2c_dev_read_reg(client, data, dev_attr->ida_reg);
 
   mutex_unlock(&data->idd_lock);
 
@@ -225,7 +367,13 @@ static ssize_t i2c_dev_sysfs_store(struct device *dev,
   }
 
   if (dev_attr->ida_store != I2C_DEV_ATTR_STORE_DEFAULT) {
-    return dev_attr->ida_store(dev, attr, buf, count);
+    /* A custom store may write any register, so drop them all after it */
+    ssize_t ret = dev_attr->ida_store(dev, attr, buf, count);
+
+    mutex_lock(&data->idd_lock);
+    i2c_dev_cache_drop_all(data);
+    mutex_unlock(&data->idd_lock);
+    return ret;
   }
 
   /* parse the buffer */
@@ -237,7 +385,11 @@ static ssize_t i2c_dev_sysfs_store(struct device *dev,
 
   mutex_lock(&data->idd_lock);
 
-  /* default handling, first read back the current value */
+  /*
+   * default handling, first read back the current value, from the
+   * device rather than the cache, which drops the register either way
+   */
+  i2c_dev_cache_drop(data, dev_attr->ida_reg);
   val = i2c_smbus_read_byte_data(client, dev_attr->ida_reg);
 
   if (val < 0) {
@@ -267,6 +419,10 @@ void i2c_dev_sysfs_data_clean(struct i2c_client *client, i2c_dev_data_st *data)
   if (!data) {
     return;
   }
+  if (data->idd_cache) {
+    sysfs_remove_group(&client->dev.kobj, &data->idd_cache->ic_attr_group);
+    kfree(data->idd_cache);
+  }
   if (data->idd_hwmon_dev) {
     hwmon_device_unregister(data->idd_hwmon_dev);
   }
@@ -306,6 +462,7 @@ int i2c_dev_sysfs_data_init(struct i2c_client *client,
     err = -ENOMEM;
     goto exit_cleanup;
   }
+  data->idd_n_attrs = n_attrs;
   PP_DEBUG("Allocated %u attributes", n_attrs);
 
   for (i = 0,
@@ -349,6 +506,183 @@ int i2c_dev_sysfs_data_init(struct i2c_client *client,
 }
 EXPORT_SYMBOL_GPL(i2c_dev_sysfs_data_init);
 
+static ssize_t i2c_dev_regmap_read(struct file *filp, struct kobject *kobj,
+                                   struct bin_attribute *attr,
+                                   char *buf, loff_t off, size_t count)
+{
+  struct device *dev = container_of(kobj, struct device, kobj);
+  struct i2c_client *client = to_i2c_client(dev);
+  i2c_dev_data_st *data = i2c_get_clientdata(client);
+  int ret_val;
+
+  if (off >= attr->size) {
+    return 0;
+  }
+  if (off + count > attr->size) {
+    count = attr->size - off;
+  }
+
+  mutex_lock(&data->idd_lock);
+  ret_val = i2c_dev_read_regs(client, data, off, buf, count);
+  mutex_unlock(&data->idd_lock);
+
+  if (ret_val < 0) {
+    return ret_val;
+  }
+  return count;
+}
+
+static ssize_t i2c_dev_cache_ttl_show(struct device *dev,
+                                      struct device_attribute *attr,
+                                      char *buf)
+{
+  i2c_dev_data_st *data = i2c_get_clientdata(to_i2c_client(dev));
+
+  return scnprintf(buf, PAGE_SIZE, "%u\n", data->idd_cache->ic_ttl_ms);
+}
+
+static ssize_t i2c_dev_cache_ttl_store(struct device *dev,
+                                       struct device_attribute *attr,
+                                       const char *buf, size_t count)
+{
+  i2c_dev_data_st *data = i2c_get_clientdata(to_i2c_client(dev));
+  i2c_dev_cache_st *cache = data->idd_cache;
+  unsigned int ttl_ms;
+
+  if (kstrtouint(buf, 0, &ttl_ms)) {
+    return -EINVAL;
+  }
+
+  mutex_lock(&data->idd_lock);
+  cache->ic_ttl_ms = ttl_ms;
+  cache->ic_ttl = msecs_to_jiffies(ttl_ms);
+  bitmap_zero(cache->ic_valid, I2C_DEV_N_REGS);
+  mutex_unlock(&data->idd_lock);
+
+  return count;
+}
+
+static ssize_t i2c_dev_cache_stats_show(struct device *dev,
+                                        struct device_attribute *attr,
+                                        char *buf)
+{
+  i2c_dev_data_st *data = i2c_get_clientdata(to_i2c_client(dev));
+  i2c_dev_cache_st *cache = data->idd_cache;
+  ssize_t len;
+
+  mutex_lock(&data->idd_lock);
+  len = scnprintf(buf, PAGE_SIZE,
+                  "registers: %d\nblock read capable: %s\n"
+                  "hits: %lu\nbyte reads: %lu\nblock reads: %lu\n",
+                  cache->ic_n_regs, cache->ic_block_read ? "yes" : "no",
+                  cache->ic_hits, cache->ic_reads, cache->ic_block_reads);
+  mutex_unlock(&data->idd_lock);
+
+  return len;
+}
+
+/*
+ * Not every device moves on to the next register within a block read, so
+ * read the first registers both ways and only use block reads if they
+ * agree.
+ */
+static bool i2c_dev_cache_block_ok(struct i2c_client *client, int n_regs)
+{
+  uint8_t block[8];
+  int n = min(n_regs, (int)sizeof(block));
+  int i;
+
+  if (n < 2 || !i2c_check_functionality(client->adapter,
+                                        I2C_FUNC_SMBUS_READ_I2C_BLOCK)) {
+    return false;
+  }
+  if (i2c_smbus_read_i2c_block_data(client, 0, n, block) != n) {
+    return false;
+  }
+  for (i = 0; i < n; i++) {
+    if (i2c_smbus_read_byte_data(client, i) != block[i]) {
+      return false;
+    }
+  }
+  return true;
+}
+
+int i2c_dev_sysfs_cache_init(struct i2c_client *client,
+                             i2c_dev_data_st *data,
+                             unsigned int ttl_ms)
+{
+  i2c_dev_cache_st *cache;
+  const i2c_dev_attr_st *dev_attr;
+  int i;
+  int err;
+  int last;
+  int n_regs = 0;
+
+  /* cover every register an attribute reads */
+  for (i = 0; i < data->idd_n_attrs; i++) {
+    dev_attr = data->idd_attrs[i].isa_i2c_attr;
+    if (dev_attr->ida_reg < 0) {
+      continue;
+    }
+    last = dev_attr->ida_reg
+      + max((dev_attr->ida_bit_offset + dev_attr->ida_n_bits + 7) / 8, 1);
+    if (last > n_regs) {
+      n_regs = last;
+    }
+  }
+  n_regs = min(n_regs, I2C_DEV_N_REGS);
+
+  cache = kzalloc(sizeof(*cache), GFP_KERNEL);
+  if (!cache) {
+    return -ENOMEM;
+  }
+
+  cache->ic_ttl_ms = ttl_ms;
+  cache->ic_ttl = msecs_to_jiffies(ttl_ms);
+  cache->ic_n_regs = n_regs;
+  cache->ic_block_read = i2c_dev_cache_block_ok(client, n_regs);
+
+  sysfs_bin_attr_init(&cache->ic_regmap_attr);
+  cache->ic_regmap_attr.attr.name = "regmap";
+  cache->ic_regmap_attr.attr.mode = S_IRUGO;
+  cache->ic_regmap_attr.size = n_regs;
+  cache->ic_regmap_attr.read = i2c_dev_regmap_read;
+
+  sysfs_attr_init(&cache->ic_ttl_attr.attr);
+  cache->ic_ttl_attr.attr.name = "cache_ttl_ms";
+  cache->ic_ttl_attr.attr.mode = S_IRUGO | S_IWUSR;
+  cache->ic_ttl_attr.show = i2c_dev_cache_ttl_show;
+  cache->ic_ttl_attr.store = i2c_dev_cache_ttl_store;
+
+  sysfs_attr_init(&cache->ic_stats_attr.attr);
+  cache->ic_stats_attr.attr.name = "cache_stats";
+  cache->ic_stats_attr.attr.mode = S_IRUGO;
+  cache->ic_stats_attr.show = i2c_dev_cache_stats_show;
+
+  cache->ic_attrs[0] = &cache->ic_ttl_attr.attr;
+  cache->ic_attrs[1] = &cache->ic_stats_attr.attr;
+  cache->ic_bin_attrs[0] = &cache->ic_regmap_attr;
+  cache->ic_attr_group.attrs = cache->ic_attrs;
+  cache->ic_attr_group.bin_attrs = cache->ic_bin_attrs;
+
+  mutex_lock(&data->idd_lock);
+  data->idd_cache = cache;
+  mutex_unlock(&data->idd_lock);
+
+  if ((err = sysfs_create_group(&client->dev.kobj, &cache->ic_attr_group))) {
+    mutex_lock(&data->idd_lock);
+    data->idd_cache = NULL;
+    mutex_unlock(&data->idd_lock);
+    kfree(cache);
+    return err;
+  }
+
+  PP_DEBUG("Register cache for %d registers, ttl %u ms, block reads %d",
+           n_regs, ttl_ms, cache->ic_block_read);
+  return 0;
+}
+EXPORT_SYMBOL_GPL(i2c_dev_sysfs_cache_init);
+
 
 MODULE_AUTHOR("Tian Fang <tfang@fb.com>");
 MODULE_DESCRIPTION("i2c device sysfs attribute library");
@@ -52,11 +52,15 @@ typedef struct i2c_sysfs_attr_st_{
 #define TO_I2C_SYSFS_ATTR(_attr) \
 	container_of(_attr, i2c_sysfs_attr_st, isa_dev_attr)
 
+struct i2c_dev_cache_st_;
+
 typedef struct i2c_dev_data_st_ {
   struct device *idd_hwmon_dev;
   struct mutex idd_lock;
   i2c_sysfs_attr_st *idd_attrs;
   struct attribute_group idd_attr_group;
+  int idd_n_attrs;
+  struct i2c_dev_cache_st_ *idd_cache;
 } i2c_dev_data_st;
 
 int i2c_dev_sysfs_data_init(struct i2c_client *client,
@@ -64,6 +68,17 @@ int i2c_dev_sysfs_data_init(struct i2c_client *client,
                             const i2c_dev_attr_st *dev_attrs,
                             int n_attrs);
 void i2c_dev_sysfs_data_clean(struct i2c_client *client, i2c_dev_data_st *data);
+
+/*
+ * Optional, after i2c_dev_sysfs_data_init(): keep the registers the
+ * attributes read for ttl_ms (0 to not cache until "cache_ttl_ms" is
+ * written) and add a "regmap" binary attribute with all of them. Only for
+ * devices where reading any of those registers has no side effects.
+ */
+int i2c_dev_sysfs_cache_init(struct i2c_client *client,
+                             i2c_dev_data_st *data,
+                             unsigned int ttl_ms);
+
 int i2c_dev_read_byte(struct device *dev,
                       struct device_attribute *attr);
 int i2c_dev_read_nbytes(struct device *dev,
@@ -0,0 +1,345 @@
+/*
+ * Copyright 2017-present Facebook. All Rights Reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <syslog.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "evbus.h"
+
+#define EVBUS_MAGIC   0x45564253  // "EVBS"
+#define EVBUS_VERSION 2
+
+struct evbus_shm {
+  uint32_t magic;
+  uint32_t version;
+  volatile uint32_t head;   // seq of the newest record
+  volatile uint32_t clears; // evbus_clear() calls since boot
+  evbus_rec_t rec[EVBUS_RING_RECS];
+};
+
+/*
+ * Publishers serialize on an flock of the shm fd, and threads of one
+ * process on m_bus as well, since they share the fd. A record is written
+ * with its seq cleared and the seq is set last, so a reader that sees the
+ * same seq before and after copying it got the whole record.
+ */
+static pthread_mutex_t m_bus = PTHREAD_MUTEX_INITIALIZER;
+static struct evbus_shm *g_bus;
+static int g_fd = -1;
+static int g_log_fd = -1;
+
+// Fill the ring with the newest records of the flash log
+static void
+evbus_load(struct evbus_shm *bus) {
+  evbus_rec_t *log, *r;
+  uint32_t head = 0;
+  ssize_t len;
+  int fd, i, n;
+
+  fd = open(EVBUS_LOG_FILE, O_RDONLY);
+  if (fd < 0)
+    return;
+
+  log = malloc(EVBUS_LOG_RECS * sizeof(evbus_rec_t));
+  if (!log) {
+    close(fd);
+    return;
+  }
+
+  len = read(fd, log, EVBUS_LOG_RECS * sizeof(evbus_rec_t));
+  close(fd);
+  // Records of another size are from an older format
+  n = (len > 0 && len % sizeof(evbus_rec_t) == 0) ? len / sizeof(evbus_rec_t) : 0;
+
+  // A record is only trusted in the slot its seq maps to
+  for (i = 0; i < n; i++) {
+    if (log[i].seq && (log[i].seq - 1) % EVBUS_LOG_RECS == i && log[i].seq > head)
+      head = log[i].seq;
+  }
+
+  for (i = 0; i < n; i++) {
+    r = &log[i];
+    if (!r->seq || (r->seq - 1) % EVBUS_LOG_RECS != i)
+      continue;
+    if (head - r->seq >= EVBUS_RING_RECS)
+      continue;
+    r->msg[EVBUS_MSG_LEN - 1] = '\0';
+    bus->rec[(r->seq - 1) % EVBUS_RING_RECS] = *r;
+  }
+  bus->head = head;
+
+  free(log);
+}
+
+static struct evbus_shm *
+evbus_open(void) {
+  struct evbus_shm *bus;
+  struct stat st;
+  int fd;
+
+  pthread_mutex_lock(&m_bus);
+  if (g_bus)
+    goto exit;
+
+  fd = shm_open(EVBUS_SHM, O_CREAT | O_RDWR | O_CLOEXEC, 0644);
+  if (fd < 0) {
+    syslog(LOG_WARNING, "%s: shm_open failed, errno %d", __func__, errno);
+    goto exit;
+  }
+
+  // Whoever gets here first after boot sets the ring up
+  flock(fd, LOCK_EX);
+  if (fstat(fd, &st) || (st.st_size < sizeof(struct evbus_shm) &&
+                         ftruncate(fd, sizeof(struct evbus_shm)))) {
+    syslog(LOG_WARNING, "%s: ftruncate failed, errno %d", __func__, errno);
+    goto err;
+  }
+
+  bus = mmap(NULL, sizeof(struct evbus_shm), PROT_READ | PROT_WRITE,
+             MAP_SHARED, fd, 0);
+  if (bus == MAP_FAILED) {
+    syslog(LOG_WARNING, "%s: mmap failed, errno %d", __func__, errno);
+    goto err;
+  }
+
+  if (bus->magic != EVBUS_MAGIC || bus->version != EVBUS_VERSION) {
+    memset(bus, 0, sizeof(*bus));
+    evbus_load(bus);
+    bus->version = EVBUS_VERSION;
+    bus->magic = EVBUS_MAGIC;
+  }
+  flock(fd, LOCK_UN);
+
+  g_fd = fd;
+  g_bus = bus;
+  goto exit;
+
+err:
+  flock(fd, LOCK_UN);
+  close(fd);
+exit:
+  bus = g_bus;
+  pthread_mutex_unlock(&m_bus);
+  return bus;
+}
+
+// Called with the bus locked
+static void
+evbus_persist(const evbus_rec_t *r) {
+  off_t off = ((r->seq - 1) % EVBUS_LOG_RECS) * sizeof(evbus_rec_t);
+
+  // /mnt/data may not be mounted yet, try again with the next record
+  if (g_log_fd < 0) {
+    g_log_fd = open(EVBUS_LOG_FILE, O_CREAT | O_WRONLY | O_CLOEXEC, 0644);
+    if (g_log_fd < 0)
+      return;
+  }
+
+  if (pwrite(g_log_fd, r, sizeof(*r), off) != sizeof(*r)) {
+    close(g_log_fd);
+    g_log_fd = -1;
+  }
+}
+
+int
+evbus_publish(uint16_t type, uint8_t fru, uint8_t severity,
+              const void *data, int len, const char *fmt, ...) {
+  struct evbus_shm *bus = evbus_open();
+  evbus_rec_t rec, *r;
+  va_list ap;
+
+  if (!bus)
+    return -1;
+
+  memset(&rec, 0, sizeof(rec));
+  rec.time = time(NULL);
+  rec.type = type;
+  rec.fru = fru;
+  rec.severity = severity;
+  if (data && len > 0)
+    memcpy(rec.data, data, (len < EVBUS_DATA_LEN) ? len : EVBUS_DATA_LEN);
+  va_start(ap, fmt);
+  vsnprintf(rec.msg, sizeof(rec.msg), fmt, ap);
+  va_end(ap);
+
+  pthread_mutex_lock(&m_bus);
+  flock(g_fd, LOCK_EX);
+
+  rec.seq = bus->head + 1;
+  r = &bus->rec[(rec.seq - 1) % EVBUS_RING_RECS];
+  r->seq = 0;
+  __sync_synchronize();
+  memcpy((uint8_t *)r + sizeof(r->seq), (uint8_t *)&rec + sizeof(rec.seq),
+         sizeof(rec) - sizeof(rec.seq));
+  __sync_synchronize();
+  r->seq = rec.seq;
+  __sync_synchronize();
+  bus->head = rec.seq;
+
+  evbus_persist(&rec);
+
+  flock(g_fd, LOCK_UN);
+  pthread_mutex_unlock(&m_bus);
+
+  return 0;
+}
+
+int
+evbus_head(uint32_t *seq) {
+  struct evbus_shm *bus = evbus_open();
+
+  if (!bus)
+    return -1;
+
+  *seq = bus->head;
+  return 0;
+}
+
+int
+evbus_read(uint32_t *cursor, evbus_rec_t *recs, int max) {
+  struct evbus_shm *bus = evbus_open();
+  volatile evbus_rec_t *r;
+  uint32_t head, oldest, s;
+  int n = 0;
+
+  if (!bus || !cursor || !recs)
+    return -1;
+
+  head = bus->head;
+  __sync_synchronize();
+  oldest = (head > EVBUS_RING_RECS) ? head - EVBUS_RING_RECS + 1 : 1;
+
+  // A cursor ahead of head is from before a reboot, start over
+  s = *cursor + 1;
+  if (s < oldest || *cursor > head)
+    s = oldest;
+
+  for (; s <= head && n < max; s++) {
+    r = &bus->rec[(s - 1) % EVBUS_RING_RECS];
+    if (r->seq != s)
+      continue;
+    __sync_synchronize();
+    memcpy(&recs[n], (const void *)r, sizeof(evbus_rec_t));
+    __sync_synchronize();
+    if (r->seq != s || recs[n].seq != s)
+      continue;
+    recs[n].msg[EVBUS_MSG_LEN - 1] = '\0';
+    n++;
+  }
+  *cursor = s - 1;
+
+  return n;
+}
+
+static int
+rec_seq_cmp(const void *a, const void *b) {
+  uint32_t x = ((const evbus_rec_t *)a)->seq, y = ((const evbus_rec_t *)b)->seq;
+
+  return (x > y) - (x < y);
+}
+
+int
+evbus_read_log(uint16_t type, uint32_t before, evbus_rec_t *recs, int max) {
+  struct evbus_shm *bus = evbus_open();
+  evbus_rec_t *log;
+  ssize_t len;
+  int fd, i, n, cnt = 0;
+
+  if (!bus || !recs || max <= 0)
+    return -1;
+
+  log = malloc(EVBUS_LOG_RECS * sizeof(evbus_rec_t));
+  if (!log)
+    return -1;
+
+  // Shared with publishers, so no record is read half written
+  pthread_mutex_lock(&m_bus);
+  flock(g_fd, LOCK_SH);
+  fd = open(EVBUS_LOG_FILE, O_RDONLY);
+  len = (fd < 0) ? 0 : read(fd, log, EVBUS_LOG_RECS * sizeof(evbus_rec_t));
+  if (fd >= 0)
+    close(fd);
+  flock(g_fd, LOCK_UN);
+  pthread_mutex_unlock(&m_bus);
+
+  n = (len > 0 && len % sizeof(evbus_rec_t) == 0) ? len / sizeof(evbus_rec_t) : 0;
+  for (i = 0; i < n; i++) {
+    if (!log[i].seq || (log[i].seq - 1) % EVBUS_LOG_RECS != i)
+      continue;
+    if (log[i].type != type || log[i].seq >= before)
+      continue;
+    log[i].msg[EVBUS_MSG_LEN - 1] = '\0';
+    log[cnt++] = log[i];
+  }
+
+  qsort(log, cnt, sizeof(evbus_rec_t), rec_seq_cmp);
+  if (cnt > max) {
+    memmove(log, &log[cnt - max], max * sizeof(evbus_rec_t));
+    cnt = max;
+  }
+  memcpy(recs, log, cnt * sizeof(evbus_rec_t));
+
+  free(log);
+  return cnt;
+}
+
+int
+evbus_clear(void) {
+  struct evbus_shm *bus = evbus_open();
+  int i, ret = 0;
+
+  if (!bus)
+    return -1;
+
+  pthread_mutex_lock(&m_bus);
+  flock(g_fd, LOCK_EX);
+
+  for (i = 0; i < EVBUS_RING_RECS; i++) {
+    bus->rec[i].seq = 0;
+  }
+  __sync_synchronize();
+  bus->clears++;
+
+  if (truncate(EVBUS_LOG_FILE, 0) && errno != ENOENT)
+    ret = -1;
+
+  flock(g_fd, LOCK_UN);
+  pthread_mutex_unlock(&m_bus);
+
+  return ret;
+}
+
+int
+evbus_clears(uint32_t *count) {
+  struct evbus_shm *bus = evbus_open();
+
+  if (!bus)
+    return -1;
+
+  *count = bus->clears;
+  return 0;
+}
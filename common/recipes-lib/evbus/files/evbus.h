@@ -0,0 +1,112 @@
+/*
+ * Copyright 2017-present Facebook. All Rights Reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+#ifndef __EVBUS_H__
+#define __EVBUS_H__
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Event bus: typed, timestamped event records in a shared memory ring that
+ * any process can publish to, backed by a fixed-size binary log on flash.
+ * Readers keep a cursor (the seq of the last record they saw) and page
+ * through the ring without parsing text; the ring is loaded from flash by
+ * the first process that opens it after boot.
+ */
+
+#define EVBUS_SHM         "/evbus"
+#define EVBUS_LOG_FILE    "/mnt/data/evbus.log"
+#define EVBUS_RING_RECS   256   /* records kept in memory */
+#define EVBUS_LOG_RECS    1024  /* records kept on flash */
+
+#define EVBUS_DATA_LEN    8
+#define EVBUS_MSG_LEN     256
+
+/* Record types and the layout of their data */
+enum {
+  EVBUS_T_CRI_SEL = 1,    /* critical SEL for the debug card, no data */
+  EVBUS_T_GPIO,           /* evbus_gpio_t */
+  EVBUS_T_SENSOR,         /* evbus_sensor_t */
+};
+
+typedef struct {
+  uint32_t seq;           /* 1, 2, ... in publish order, 0 for a free slot */
+  uint32_t time;          /* wall clock, seconds since the epoch */
+  uint16_t type;
+  uint8_t fru;
+  uint8_t severity;       /* syslog priority */
+  uint8_t data[EVBUS_DATA_LEN];
+  char msg[EVBUS_MSG_LEN];  /* display text, NUL terminated */
+} evbus_rec_t;
+
+typedef struct {
+  uint16_t gpio;
+  uint8_t value;
+} __attribute__((packed)) evbus_gpio_t;
+
+typedef struct {
+  uint8_t snr_num;
+  uint8_t thresh;         /* threshold enum of sensord */
+  uint8_t assert;         /* 1 raised, 0 settled */
+  uint8_t rsvd;
+  float value;
+} __attribute__((packed)) evbus_sensor_t;
+
+/*
+ * Publish a record; data may be NULL. The message is formatted like
+ * printf and cut to EVBUS_MSG_LEN - 1 characters.
+ */
+int evbus_publish(uint16_t type, uint8_t fru, uint8_t severity,
+                  const void *data, int len, const char *fmt, ...)
+                  __attribute__((format(printf, 6, 7)));
+
+/* seq of the newest record, 0 when there is none yet */
+int evbus_head(uint32_t *seq);
+
+/*
+ * Copy up to max records newer than *cursor, oldest first, and advance
+ * *cursor past them. Start with *cursor = 0 to read everything kept.
+ * Records overwritten before they were read are skipped; the gap shows
+ * in their seq. Returns the number of records copied, or -1.
+ */
+int evbus_read(uint32_t *cursor, evbus_rec_t *recs, int max);
+
+/*
+ * Copy up to max of the newest records of the given type with a seq below
+ * before from the flash log, oldest first, for readers that keep records
+ * the ring has already let go of. Returns the number copied, or -1.
+ */
+int evbus_read_log(uint16_t type, uint32_t before, evbus_rec_t *recs, int max);
+
+/* Drop all records, in memory and on flash. seq keeps counting. */
+int evbus_clear(void);
+
+/*
+ * Times the bus was cleared since boot. A reader that keeps a view of
+ * past records drops it when this changes.
+ */
+int evbus_clears(uint32_t *count);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __EVBUS_H__ */
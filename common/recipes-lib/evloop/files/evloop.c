@@ -0,0 +1,521 @@
+/*
+ * Copyright 2017-present Facebook. All Rights Reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <syslog.h>
+#include <time.h>
+#include <unistd.h>
+#include "evloop.h"
+
+/*
+ * Four levels of 64 slots. Level 0 holds timers due within 64 ticks, one
+ * tick per slot; each higher level covers 64 times the span of the one
+ * below and is cascaded down whenever the level below wraps.
+ */
+#define WHEEL_BITS      6
+#define WHEEL_SIZE      (1 << WHEEL_BITS)
+#define WHEEL_MASK      (WHEEL_SIZE - 1)
+#define WHEEL_LEVELS    4
+#define WHEEL_MAX_TICKS ((1ULL << (WHEEL_BITS * WHEEL_LEVELS)) - 1)
+
+#define STATS_WINDOW_MS 10000
+
+#define LEVEL_EXPIRED   0xFF    /* on the expired list of run_timers() */
+
+typedef struct {
+  int fd;
+  short events;
+  ev_fd_cb cb;
+  void *arg;
+  uint32_t gen;
+} ev_fd_t;
+
+struct evloop {
+  ev_timer_t wheel[WHEEL_LEVELS][WHEEL_SIZE];   /* list heads */
+  uint32_t level_cnt[WHEEL_LEVELS];
+  uint64_t tick;                                /* next tick to run */
+  uint64_t now_ms;
+
+  ev_fd_t fds[EV_MAX_FDS];
+  int nfds;
+  uint32_t fd_gen;
+
+  int stop;
+  evloop_stats_t stats;
+  uint64_t window_start;
+  uint64_t window_wakeups;
+};
+
+static uint64_t
+mono_ms(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static void
+list_init(ev_timer_t *head)
+{
+  head->next = head->prev = head;
+}
+
+static void
+list_add_tail(ev_timer_t *head, ev_timer_t *t)
+{
+  t->prev = head->prev;
+  t->next = head;
+  head->prev->next = t;
+  head->prev = t;
+}
+
+static void
+list_del(ev_timer_t *t)
+{
+  t->prev->next = t->next;
+  t->next->prev = t->prev;
+  t->next = t->prev = NULL;
+}
+
+evloop_t *
+evloop_create(void)
+{
+  evloop_t *loop;
+  int l, s;
+
+  loop = calloc(1, sizeof(*loop));
+  if (!loop)
+    return NULL;
+
+  for (l = 0; l < WHEEL_LEVELS; l++)
+    for (s = 0; s < WHEEL_SIZE; s++)
+      list_init(&loop->wheel[l][s]);
+
+  loop->now_ms = mono_ms();
+  loop->tick = loop->now_ms / EV_TICK_MS;
+  loop->window_start = loop->now_ms;
+  return loop;
+}
+
+void
+evloop_destroy(evloop_t *loop)
+{
+  free(loop);
+}
+
+uint64_t
+evloop_now_ms(evloop_t *loop)
+{
+  return loop->now_ms;
+}
+
+void
+evloop_break(evloop_t *loop)
+{
+  loop->stop = 1;
+}
+
+int
+evloop_add_fd(evloop_t *loop, int fd, short events, ev_fd_cb cb, void *arg)
+{
+  ev_fd_t *e;
+
+  if (fd < 0 || !cb)
+    return -1;
+  if (loop->nfds >= EV_MAX_FDS) {
+    syslog(LOG_WARNING, "evloop: too many fds");
+    return -1;
+  }
+
+  e = &loop->fds[loop->nfds++];
+  e->fd = fd;
+  e->events = events;
+  e->cb = cb;
+  e->arg = arg;
+  e->gen = ++loop->fd_gen;
+  return 0;
+}
+
+int
+evloop_del_fd(evloop_t *loop, int fd)
+{
+  int i;
+
+  for (i = 0; i < loop->nfds; i++) {
+    if (loop->fds[i].fd == fd) {
+      loop->fds[i] = loop->fds[--loop->nfds];
+      return 0;
+    }
+  }
+  return -1;
+}
+
+/* Insert t in the slot its expiry maps to, relative to the current tick */
+static void
+wheel_add(evloop_t *loop, ev_timer_t *t)
+{
+  uint64_t delta;
+  int level, slot;
+
+  if (t->expires < loop->tick)
+    t->expires = loop->tick;
+  delta = t->expires - loop->tick;
+  if (delta > WHEEL_MAX_TICKS) {
+    t->expires = loop->tick + WHEEL_MAX_TICKS;
+    delta = WHEEL_MAX_TICKS;
+  }
+
+  for (level = 0; level < WHEEL_LEVELS - 1; level++) {
+    if (delta < (1ULL << (WHEEL_BITS * (level + 1))))
+      break;
+  }
+  slot = (t->expires >> (WHEEL_BITS * level)) & WHEEL_MASK;
+
+  list_add_tail(&loop->wheel[level][slot], t);
+  t->level = level;
+  loop->level_cnt[level]++;
+}
+
+static void
+wheel_del(evloop_t *loop, ev_timer_t *t)
+{
+  if (t->level != LEVEL_EXPIRED)
+    loop->level_cnt[t->level]--;
+  list_del(t);
+}
+
+/* Move the timers of one higher-level slot down to where they now belong */
+static void
+cascade(evloop_t *loop, int level)
+{
+  int slot = (loop->tick >> (WHEEL_BITS * level)) & WHEEL_MASK;
+  ev_timer_t *head = &loop->wheel[level][slot];
+  ev_timer_t *t;
+
+  while (head->next != head) {
+    t = head->next;
+    wheel_del(loop, t);
+    wheel_add(loop, t);
+  }
+}
+
+void
+ev_timer_init(ev_timer_t *t, ev_timer_cb cb, void *arg)
+{
+  memset(t, 0, sizeof(*t));
+  t->cb = cb;
+  t->arg = arg;
+}
+
+void
+ev_timer_set_slack(ev_timer_t *t, uint32_t slack_ms)
+{
+  t->slack = slack_ms;
+}
+
+int
+ev_timer_pending(const ev_timer_t *t)
+{
+  return t->next != NULL;
+}
+
+void
+ev_timer_stop(evloop_t *loop, ev_timer_t *t)
+{
+  if (t->next)
+    wheel_del(loop, t);
+}
+
+static uint64_t
+expiry_tick(uint64_t due_ms, uint32_t slack)
+{
+  /* Round up to the slack grid so timers with the same slack line up */
+  if (slack > EV_TICK_MS)
+    due_ms = ((due_ms + slack - 1) / slack) * slack;
+  return (due_ms + EV_TICK_MS - 1) / EV_TICK_MS;
+}
+
+void
+ev_timer_start(evloop_t *loop, ev_timer_t *t, uint32_t delay_ms,
+    uint32_t period_ms)
+{
+  ev_timer_stop(loop, t);
+
+  loop->now_ms = mono_ms();
+  t->period = period_ms;
+  t->expires = expiry_tick(loop->now_ms + delay_ms, t->slack);
+  wheel_add(loop, t);
+}
+
+/* Fire everything due up to and including now */
+static int
+run_timers(evloop_t *loop)
+{
+  uint64_t now_tick = loop->now_ms / EV_TICK_MS;
+  ev_timer_t expired, *t;
+  int level, slot, fired = 0;
+
+  list_init(&expired);
+  while (loop->tick <= now_tick) {
+    slot = loop->tick & WHEEL_MASK;
+
+    /* Level 0 wrapped, pull the next span down from above */
+    if (slot == 0) {
+      for (level = 1; level < WHEEL_LEVELS; level++) {
+        cascade(loop, level);
+        if ((loop->tick >> (WHEEL_BITS * level)) & WHEEL_MASK)
+          break;
+      }
+    }
+
+    /* Nothing can expire before level 0 wraps again */
+    if (!loop->level_cnt[0]) {
+      loop->tick = (loop->tick | WHEEL_MASK) + 1;
+      if (loop->tick > now_tick + 1)
+        loop->tick = now_tick + 1;
+      continue;
+    }
+
+    while (loop->wheel[0][slot].next != &loop->wheel[0][slot]) {
+      t = loop->wheel[0][slot].next;
+      wheel_del(loop, t);
+      list_add_tail(&expired, t);
+      t->level = LEVEL_EXPIRED;
+    }
+    loop->tick++;
+  }
+
+  /* Callbacks run after the wheel is consistent, and may re-arm or stop */
+  while (expired.next != &expired) {
+    t = expired.next;
+    list_del(t);
+    if (t->period) {
+      t->expires = expiry_tick(t->expires * EV_TICK_MS + t->period, t->slack);
+      /* Fell behind by more than a period, restart from now */
+      if (t->expires <= now_tick)
+        t->expires = expiry_tick(loop->now_ms + t->period, t->slack);
+      wheel_add(loop, t);
+    }
+    fired++;
+    t->cb(loop, t, t->arg);
+  }
+
+  loop->stats.timers_fired += fired;
+  return fired;
+}
+
+/* Milliseconds until the earliest pending timer, -1 if there is none */
+static int
+next_timeout(evloop_t *loop)
+{
+  uint64_t next = UINT64_MAX, now_tick = loop->now_ms / EV_TICK_MS;
+  ev_timer_t *head, *t;
+  int level, slot, i;
+
+  if (loop->level_cnt[0]) {
+    for (i = 0; i < WHEEL_SIZE; i++) {
+      slot = (loop->tick + i) & WHEEL_MASK;
+      if (loop->wheel[0][slot].next != &loop->wheel[0][slot]) {
+        next = loop->tick + i;
+        break;
+      }
+    }
+  }
+
+  /* Higher levels may hold something due before the first level 0 entry */
+  {
+    for (level = 1; level < WHEEL_LEVELS; level++) {
+      if (!loop->level_cnt[level])
+        continue;
+      for (slot = 0; slot < WHEEL_SIZE; slot++) {
+        head = &loop->wheel[level][slot];
+        for (t = head->next; t != head; t = t->next) {
+          if (t->expires < next)
+            next = t->expires;
+        }
+      }
+    }
+  }
+
+  if (next == UINT64_MAX)
+    return -1;
+  if (next <= now_tick)
+    return 0;
+  return (int)((next * EV_TICK_MS) - loop->now_ms);
+}
+
+static void
+update_rate(evloop_t *loop)
+{
+  uint64_t elapsed = loop->now_ms - loop->window_start;
+
+  loop->window_wakeups++;
+  if (elapsed >= STATS_WINDOW_MS) {
+    loop->stats.wakeups_per_sec = loop->window_wakeups * 1000.0 / elapsed;
+    loop->window_wakeups = 0;
+    loop->window_start = loop->now_ms;
+  }
+}
+
+int
+evloop_run(evloop_t *loop)
+{
+  struct pollfd pfd[EV_MAX_FDS];
+  ev_fd_t snap[EV_MAX_FDS];
+  int i, j, n, nfds, events;
+
+  loop->stop = 0;
+  loop->now_ms = mono_ms();
+
+  while (!loop->stop) {
+    nfds = loop->nfds;
+    for (i = 0; i < nfds; i++) {
+      snap[i] = loop->fds[i];
+      pfd[i].fd = snap[i].fd;
+      pfd[i].events = snap[i].events;
+      pfd[i].revents = 0;
+    }
+
+    n = poll(pfd, nfds, next_timeout(loop));
+    if (n < 0 && errno != EINTR) {
+      syslog(LOG_ERR, "evloop: poll failed, errno = %d", errno);
+      return -1;
+    }
+
+    loop->now_ms = mono_ms();
+    loop->stats.wakeups++;
+    update_rate(loop);
+
+    events = 0;
+    for (i = 0; n > 0 && i < nfds; i++) {
+      if (!pfd[i].revents)
+        continue;
+      /* Skip fds removed by an earlier callback in this round */
+      for (j = 0; j < loop->nfds; j++) {
+        if (loop->fds[j].gen == snap[i].gen)
+          break;
+      }
+      if (j == loop->nfds)
+        continue;
+      events++;
+      snap[i].cb(loop, snap[i].fd, pfd[i].revents, snap[i].arg);
+    }
+    loop->stats.fd_events += events;
+
+    if (!run_timers(loop) && !events)
+      loop->stats.idle_wakeups++;
+  }
+
+  return 0;
+}
+
+static void
+input_timer_cb(evloop_t *loop, ev_timer_t *t, void *arg)
+{
+  ev_input_t *in = arg;
+
+  in->cb(loop, in, in->arg);
+}
+
+static void
+input_fd_cb(evloop_t *loop, int fd, short revents, void *arg)
+{
+  ev_input_t *in = arg;
+  char buf[16];
+
+  /* sysfs keeps signalling until the attribute is read again */
+  lseek(fd, 0, SEEK_SET);
+  if (read(fd, buf, sizeof(buf)) < 0)
+    return;
+
+  in->edges++;
+  ev_timer_start(loop, &in->timer, in->debounce, 0);
+}
+
+int
+ev_input_start(evloop_t *loop, ev_input_t *in, const int *fds, int nfds,
+    uint32_t debounce_ms, uint32_t poll_ms, ev_input_cb cb, void *arg)
+{
+  int i;
+
+  if (!cb || nfds < 0 || nfds > EV_INPUT_MAX_FDS)
+    return -1;
+
+  memset(in, 0, sizeof(*in));
+  in->debounce = debounce_ms;
+  in->poll = poll_ms;
+  in->cb = cb;
+  in->arg = arg;
+  ev_timer_init(&in->timer, input_timer_cb, in);
+
+  for (i = 0; i < nfds; i++) {
+    if (evloop_add_fd(loop, fds[i], POLLPRI, input_fd_cb, in)) {
+      ev_input_stop(loop, in);
+      return -1;
+    }
+    in->fds[in->nfds++] = fds[i];
+  }
+
+  /* Initial state, then either edges or sampling from here on */
+  ev_timer_start(loop, &in->timer, 0, in->nfds ? 0 : poll_ms);
+  return 0;
+}
+
+void
+ev_input_stop(evloop_t *loop, ev_input_t *in)
+{
+  int i;
+
+  for (i = 0; i < in->nfds; i++)
+    evloop_del_fd(loop, in->fds[i]);
+  in->nfds = 0;
+  ev_timer_stop(loop, &in->timer);
+}
+
+void
+ev_input_recheck(evloop_t *loop, ev_input_t *in, uint32_t delay_ms)
+{
+  ev_timer_start(loop, &in->timer, delay_ms, in->nfds ? 0 : in->poll);
+}
+
+void
+evloop_get_stats(evloop_t *loop, evloop_stats_t *stats)
+{
+  int l;
+
+  *stats = loop->stats;
+  stats->timers_pending = 0;
+  for (l = 0; l < WHEEL_LEVELS; l++)
+    stats->timers_pending += loop->level_cnt[l];
+}
+
+void
+evloop_dump_stats(evloop_t *loop, FILE *fp)
+{
+  evloop_stats_t st;
+
+  evloop_get_stats(loop, &st);
+  fprintf(fp, "wakeups: %llu\n", (unsigned long long)st.wakeups);
+  fprintf(fp, "wakeups_per_sec: %.2f\n", st.wakeups_per_sec);
+  fprintf(fp, "idle_wakeups: %llu\n", (unsigned long long)st.idle_wakeups);
+  fprintf(fp, "fd_events: %llu\n", (unsigned long long)st.fd_events);
+  fprintf(fp, "timers_fired: %llu\n", (unsigned long long)st.timers_fired);
+  fprintf(fp, "timers_pending: %u\n", st.timers_pending);
+}
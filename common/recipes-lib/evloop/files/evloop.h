@@ -0,0 +1,122 @@
+/*
+ * Copyright 2017-present Facebook. All Rights Reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+#ifndef __EVLOOP_H__
+#define __EVLOOP_H__
+
+#include <stdint.h>
+#include <stdio.h>
+#include <poll.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Single-threaded event loop: file descriptors waited on with poll() and
+ * timers kept in a hierarchical timer wheel. The loop sleeps until the
+ * next fd event or timer expiry, so an idle daemon does not wake up.
+ *
+ * Timers have EV_TICK_MS resolution. A timer started with slack may fire
+ * up to slack ms late so that it shares a wakeup with other timers.
+ */
+
+#define EV_TICK_MS      10
+#define EV_MAX_FDS      32
+#define EV_INPUT_MAX_FDS 4
+
+typedef struct evloop evloop_t;
+typedef struct ev_timer ev_timer_t;
+typedef struct ev_input ev_input_t;
+
+typedef void (*ev_timer_cb)(evloop_t *loop, ev_timer_t *t, void *arg);
+typedef void (*ev_fd_cb)(evloop_t *loop, int fd, short revents, void *arg);
+typedef void (*ev_input_cb)(evloop_t *loop, ev_input_t *in, void *arg);
+
+struct ev_timer {
+  ev_timer_t *next;         /* wheel slot list, NULL when not pending */
+  ev_timer_t *prev;
+  uint64_t expires;         /* tick */
+  uint32_t period;          /* ms, 0 for one-shot */
+  uint32_t slack;           /* ms */
+  uint8_t level;            /* wheel level while pending */
+  ev_timer_cb cb;
+  void *arg;
+};
+
+struct ev_input {
+  int fds[EV_INPUT_MAX_FDS];
+  int nfds;                 /* 0 when sampled every poll ms */
+  uint32_t debounce;        /* ms */
+  uint32_t poll;            /* ms */
+  uint64_t edges;
+  ev_timer_t timer;
+  ev_input_cb cb;
+  void *arg;
+};
+
+typedef struct {
+  uint64_t wakeups;         /* returns from poll() */
+  uint64_t idle_wakeups;    /* wakeups with neither fd event nor timer */
+  uint64_t fd_events;
+  uint64_t timers_fired;
+  uint32_t timers_pending;
+  float wakeups_per_sec;    /* over the last completed stats window */
+} evloop_stats_t;
+
+evloop_t *evloop_create(void);
+void evloop_destroy(evloop_t *loop);
+
+/* Run until evloop_break(). Returns 0, or -1 if poll() fails. */
+int evloop_run(evloop_t *loop);
+void evloop_break(evloop_t *loop);
+
+/* Monotonic time in ms as seen by the loop */
+uint64_t evloop_now_ms(evloop_t *loop);
+
+int evloop_add_fd(evloop_t *loop, int fd, short events, ev_fd_cb cb, void *arg);
+int evloop_del_fd(evloop_t *loop, int fd);
+
+void ev_timer_init(ev_timer_t *t, ev_timer_cb cb, void *arg);
+/* (Re)arm t to fire after delay_ms, then every period_ms if non-zero */
+void ev_timer_start(evloop_t *loop, ev_timer_t *t, uint32_t delay_ms,
+    uint32_t period_ms);
+void ev_timer_set_slack(ev_timer_t *t, uint32_t slack_ms);
+void ev_timer_stop(evloop_t *loop, ev_timer_t *t);
+int ev_timer_pending(const ev_timer_t *t);
+
+/*
+ * Debounced input over sysfs attributes that signal a change with POLLPRI,
+ * such as GPIO value files with an edge configured. cb runs once right
+ * away, then debounce_ms after the last edge on any of the fds. With no
+ * fds, cb runs every poll_ms instead.
+ */
+int ev_input_start(evloop_t *loop, ev_input_t *in, const int *fds, int nfds,
+    uint32_t debounce_ms, uint32_t poll_ms, ev_input_cb cb, void *arg);
+void ev_input_stop(evloop_t *loop, ev_input_t *in);
+/* Run cb again after delay_ms, to retry or to follow a held button */
+void ev_input_recheck(evloop_t *loop, ev_input_t *in, uint32_t delay_ms);
+
+void evloop_get_stats(evloop_t *loop, evloop_stats_t *stats);
+/* Write stats as "key: value" lines */
+void evloop_dump_stats(evloop_t *loop, FILE *fp);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __EVLOOP_H__ */
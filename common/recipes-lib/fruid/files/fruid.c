@@ -18,10 +18,17 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <stddef.h>
+#include <limits.h>
 #include <errno.h>
 #include <string.h>
 #include <syslog.h>
 #include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
 #include "fruid.h"
 
 #define FIELD_TYPE(x)     ((x & (0x03 << 6)) >> 6)
@@ -43,42 +50,112 @@ const char * ascii_6bit[4] = {
   "PQRSTUVWXYZ[\\]^_"
 };
 
+/* List of all the Chassis types. */
+const char * fruid_chassis_type [] = {
+  "Other",                    /* 0x01 */
+  "Unknown",                  /* 0x02 */
+  "Desktop",                  /* 0x03 */
+  "Low Profile Desktop",      /* 0x04 */
+  "Pizza Box",                /* 0x05 */
+  "Mini Tower",               /* 0x06 */
+  "Tower",                    /* 0x07 */
+  "Portable",                 /* 0x08 */
+  "Laptop",                   /* 0x09 */
+  "Notebook",                 /* 0x0A */
+  "Hand Held",                /* 0x0B */
+  "Docking Station",          /* 0x0C */
+  "All in One",               /* 0x0D */
+  "Sub Notebook",             /* 0x0E */
+  "Space-saving",             /* 0x0F */
+  "Lunch Box",                /* 0x10 */
+  "Main Server Chassis",      /* 0x11 */
+  "Expansion Chassis",        /* 0x12 */
+  "SubChassis",               /* 0x13 */
+  "Bus Expansion Chassis",    /* 0x14 */
+  "Peripheral Chassis",       /* 0x15 */
+  "RAID Chassis",             /* 0x16 */
+  "Rack Mount Chassis",       /* 0x17 */
+  "Sealed-case PC",           /* 0x18 */
+  "Multi-system Chassis",     /* 0x19 */
+  "Compact PCI",              /* 0x1A */
+  "Advanced TCA",             /* 0x1B */
+  "Blade",                    /* 0x1C */
+  "Blade Enclosure",          /* 0x1D */
+  "Tablet",                   /* 0x1E */
+  "Convertible",              /* 0x1F */
+  "Detachable"                /* 0x20 */
+};
+
+/* Bump allocator over the string pool of a compact record */
+typedef struct fruid_arena_t {
+  fruid_compact_t * rec;
+} fruid_arena_t;
+
 /*
- * calculate_time - calculate time from the unix time stamp stored
+ * arena_alloc - reserve len bytes of the pool for field slot
  *
- * @mfg_time    : Unix timestamp since 1996
- *
- * returns char * for mfg_time_str
- * returns NULL for memory allocation failure
+ * returns ptr to the reserved bytes
+ * returns NULL if the pool is exhausted
  */
-static char * calculate_time(uint8_t * mfg_time)
+static char * arena_alloc(fruid_arena_t * arena, int len, int slot)
 {
-  int len;
-  struct tm * local;
-  time_t unix_time = 0;
-  unix_time = ((mfg_time[2] << 16) + (mfg_time[1] << 8) + mfg_time[0]) * 60;
-  unix_time += UNIX_TIMESTAMP_1996;
-
-  local = localtime(&unix_time);
-  char * str = asctime(local);
-
-  len = strlen(str);
+  fruid_compact_t * rec = arena->rec;
+  char * p;
 
-  char * mfg_time_str = (char *) malloc(len);
-  if (!mfg_time_str) {
+  if (rec->used + len > FRUID_POOL_SIZE) {
 #ifdef DEBUG
-    syslog(LOG_WARNING, "fruid: malloc: memory allocation failed\n");
+    syslog(LOG_WARNING, "fruid: string pool exhausted\n");
 #endif
     return NULL;
   }
 
-  memset(mfg_time_str, 0, len);
+  p = &rec->pool[rec->used];
+  rec->field[slot] = rec->used;
+  rec->used += len;
+
+  return p;
+}
+
+static int arena_strcpy(fruid_arena_t * arena, const char * str, int slot)
+{
+  int len = strlen(str) + 1;
+  char * p = arena_alloc(arena, len, slot);
+
+  if (!p)
+    return ENOMEM;
+  memcpy(p, str, len);
+
+  return 0;
+}
+
+/*
+ * calculate_time - calculate time from the unix time stamp stored
+ *
+ * @mfg_time    : Minutes since 1996, little endian
+ * @arena       : pool the mfg_time_str is stored in
+ *
+ * returns 0 on success
+ * returns ENOMEM if the pool is exhausted
+ */
+static int calculate_time(const uint8_t * mfg_time, fruid_arena_t * arena)
+{
+  struct tm local;
+  char str[32];
+  time_t unix_time = 0;
+  int len;
+
+  unix_time = ((mfg_time[2] << 16) + (mfg_time[1] << 8) + mfg_time[0]) * 60;
+  unix_time += UNIX_TIMESTAMP_1996;
 
-  memcpy(mfg_time_str, str, len);
+  localtime_r(&unix_time, &local);
+  asctime_r(&local, str);
 
-  mfg_time_str[len - 1] = '\0';
+  /* Drop asctime's trailing newline */
+  len = strlen(str);
+  if (len > 0 && str[len - 1] == '\n')
+    str[len - 1] = '\0';
 
-  return mfg_time_str;
+  return arena_strcpy(arena, str, FRUID_BOARD_MFG_TIME);
 }
 
 /*
@@ -91,7 +168,7 @@ static char * calculate_time(uint8_t * mfg_time)
  * returns 0 if chksum is verified
  * returns -1 if there exist a mismatch
  */
-static int verify_chksum(uint8_t * area, uint8_t len, uint8_t chksum_read)
+static int verify_chksum(const uint8_t * area, int len, uint8_t chksum_read)
 {
   int i;
   uint8_t chksum = 0;
@@ -110,62 +187,62 @@ static int verify_chksum(uint8_t * area, uint8_t len, uint8_t chksum_read)
  *
  * @type_hex  : type stored in the data
  *
- * returns char ptr for chassis type string
+ * returns the chassis type string
  * returns NULL if type not in the list
  */
-static char * get_chassis_type(uint8_t type_hex)
+static const char * get_chassis_type(uint8_t type_hex)
 {
-  int type, ret;
-  char type_int[4];
-
-  ret = sprintf(type_int, "%u", type_hex);
-  type = atoi(type_int) - 1;
-
   /* If the type is not in the list defined.*/
-  if (type > FRUID_CHASSIS_TYPECODE_MAX || type < FRUID_CHASSIS_TYPECODE_MIN) {
+  if (type_hex > FRUID_CHASSIS_TYPECODE_MAX ||
+      type_hex < FRUID_CHASSIS_TYPECODE_MIN) {
 #ifdef DEBUG
     syslog(LOG_INFO, "fruid: chassis area: invalid chassis type\n");
 #endif
     return NULL;
   }
 
-  char * type_str = (char *) malloc(strlen(fruid_chassis_type[type]));
-  if (!type_str) {
-#ifdef DEBUG
-    syslog(LOG_WARNING, "fruid: malloc: memory allocation failed\n");
-#endif
-    return NULL;
-  }
-
-  memcpy(type_str, fruid_chassis_type[type], strlen(fruid_chassis_type[type]));
-
-  return type_str;
+  return fruid_chassis_type[type_hex - 1];
 }
 
 /*
- * _fruid_area_field_read - read the field data
+ * _fruid_area_field_read - decode one type/length field into the pool
  *
  * @offset    : offset of the field
+ * @avail     : bytes left in the area from offset
+ * @arena     : pool the decoded string is stored in
+ * @slot      : field slot of the compact record
  *
- * returns char ptr for the field data string
+ * returns the number of bytes the field occupies in the area
+ * returns -EBADF on a truncated field, -ENOMEM if the pool is exhausted
  */
-static char * _fruid_area_field_read(uint8_t *offset)
+static int _fruid_area_field_read(const uint8_t * offset, int avail,
+      fruid_arena_t * arena, int slot)
 {
   int field_type, field_len, field_len_eff;
-  int idx, idx_eff, val;
+  int i, n, rem, val;
+  const uint8_t * data = offset + 1;
   char * field;
 
+  if (avail < 1)
+    return -EBADF;
+
   /* Bits 7:6 */
   field_type = FIELD_TYPE(offset[0]);
   /* Bits 5:0 */
   field_len = FIELD_LEN(offset[0]);
 
+  if (field_len + 1 > avail) {
+#ifdef DEBUG
+    syslog(LOG_ERR, "fruid: field runs past the end of its area");
+#endif
+    return -EBADF;
+  }
+
   /* Calculate the effective length of the field data based on type stored. */
   switch (field_type) {
-
   case TYPE_BINARY:
     /* TODO: Need to add support to read data stored in binary type. */
-    field_len_eff = 1;
+    field_len_eff = 0;
     break;
 
   case TYPE_ASCII_6BIT:
@@ -178,604 +255,565 @@ static char * _fruid_area_field_read(uint8_t *offset)
 
   case TYPE_BCD_PLUS:
   case TYPE_ASCII_8BIT:
+  default:
     field_len_eff = field_len;
     break;
   }
 
   /* If field data is zero, store 'N/A' for that field. */
-  field_len_eff > 0 ? (field = (char *) malloc(field_len_eff + 1)) :
-                      (field = (char *) malloc(strlen(FIELD_EMPTY)));
-  if (!field) {
-#ifdef DEBUG
-    syslog(LOG_WARNING, "fruid: malloc: memory allocation failed\n");
-#endif
-    return NULL;
+  if (field_len == 0) {
+    if (arena_strcpy(arena, FIELD_EMPTY, slot))
+      return -ENOMEM;
+    return 1;
   }
 
-  memset(field, 0, field_len + 1);
-
-  if (field_len_eff < 1) {
-    strcpy(field, FIELD_EMPTY);
-    return field;
-  }
+  field = arena_alloc(arena, field_len_eff + 1, slot);
+  if (!field)
+    return -ENOMEM;
 
   /* Retrieve field data depending on the type it was stored. */
   switch (field_type) {
   case TYPE_BINARY:
-   /* TODO: Need to add support to read data stored in binary type. */
     break;
 
   case TYPE_BCD_PLUS:
-
-    idx = 0;
-    while (idx != field_len) {
-      field[idx] = bcd_plus_array[offset[idx + 1] & 0x0F];
-      idx++;
-    }
-    field[idx] = '\0';
+    for (i = 0; i < field_len; i++)
+      field[i] = bcd_plus_array[data[i] & 0x0F];
     break;
 
   case TYPE_ASCII_6BIT:
-
-    idx_eff = 0, idx = 1;
-
-    while (field_len > 0) {
+    n = 0;
+    for (i = 0; i < field_len; i += 3) {
+      rem = field_len - i;
 
       /* 6-Bits => Bits 5:0 of the first byte */
-      val = offset[idx] & 0x3F;
-      field[idx_eff++] = ascii_6bit[(val & 0xF0) >> 4][val & 0x0F];
-      field_len--;
+      val = data[i] & 0x3F;
+      field[n++] = ascii_6bit[(val & 0xF0) >> 4][val & 0x0F];
 
-      if (field_len > 0) {
+      if (rem > 1) {
         /* 6-Bits => Bits 3:0 of second byte + Bits 7:6 of first byte. */
-        val = ((offset[idx] & 0xC0) >> 6) |
-              ((offset[idx + 1] & 0x0F) << 2);
-        field[idx_eff++] = ascii_6bit[(val & 0xF0) >> 4][val & 0x0F];
-        field_len--;
+        val = ((data[i] & 0xC0) >> 6) | ((data[i + 1] & 0x0F) << 2);
+        field[n++] = ascii_6bit[(val & 0xF0) >> 4][val & 0x0F];
       }
 
-      if (field_len > 0) {
+      if (rem > 2) {
         /* 6-Bits => Bits 1:0 of third byte + Bits 7:4 of second byte. */
-        val = ((offset[idx + 1] & 0xF0) >> 4) |
-              ((offset[idx + 2] & 0x03) << 4);
-        field[idx_eff++] = ascii_6bit[(val & 0xF0) >> 4][val & 0x0F];
+        val = ((data[i + 1] & 0xF0) >> 4) | ((data[i + 2] & 0x03) << 4);
+        field[n++] = ascii_6bit[(val & 0xF0) >> 4][val & 0x0F];
 
         /* 6-Bits => Bits 7:2 of third byte. */
-        val = ((offset[idx + 2] & 0xFC) >> 2);
-        field[idx_eff++] = ascii_6bit[(val & 0xF0) >> 4][val & 0x0F];
-
-        field_len--;
-        idx += 3;
+        val = ((data[i + 2] & 0xFC) >> 2);
+        field[n++] = ascii_6bit[(val & 0xF0) >> 4][val & 0x0F];
       }
     }
-    /* Add Null terminator */
-    field[idx_eff] = '\0';
     break;
 
   case TYPE_ASCII_8BIT:
-
-    memcpy(field, offset + 1, field_len);
-    /* Add Null terminator */
-    field[field_len] = '\0';
+    memcpy(field, data, field_len);
     break;
   }
 
-  return field;
-}
-
-/* Free all the memory allocated for fruid information */
-void free_fruid_info(fruid_info_t * fruid)
-{
-  if (fruid->chassis.flag) {
-    free(fruid->chassis.type_str);
-    free(fruid->chassis.part);
-    free(fruid->chassis.serial);
-    free(fruid->chassis.custom1);
-    free(fruid->chassis.custom2);
-    free(fruid->chassis.custom3);
-  }
-
-  if (fruid->board.flag) {
-    free(fruid->board.mfg_time_str);
-    free(fruid->board.mfg);
-    free(fruid->board.name);
-    free(fruid->board.serial);
-    free(fruid->board.part);
-    free(fruid->board.fruid);
-    free(fruid->board.custom1);
-    free(fruid->board.custom2);
-    free(fruid->board.custom3);
-  }
-
-  if (fruid->product.flag) {
-    free(fruid->product.mfg);
-    free(fruid->product.name);
-    free(fruid->product.part);
-    free(fruid->product.version);
-    free(fruid->product.serial);
-    free(fruid->product.asset_tag);
-    free(fruid->product.fruid);
-    free(fruid->product.custom1);
-    free(fruid->product.custom2);
-    free(fruid->product.custom3);
-  }
-}
+  /* Add Null terminator */
+  field[field_len_eff] = '\0';
 
-/* Initialize the fruid information struct */
-static void init_fruid_info(fruid_info_t * fruid)
-{
-  fruid->chassis.flag = 0;
-  fruid->board.flag = 0;
-  fruid->product.flag = 0;
-  fruid->chassis.type_str = NULL;
-  fruid->chassis.part = NULL;
-  fruid->chassis.serial = NULL;
-  fruid->chassis.custom1 = NULL;
-  fruid->chassis.custom2 = NULL;
-  fruid->chassis.custom3 = NULL;
-  fruid->board.mfg_time_str = NULL;
-  fruid->board.mfg = NULL;
-  fruid->board.name = NULL;
-  fruid->board.serial = NULL;
-  fruid->board.part = NULL;
-  fruid->board.fruid = NULL;
-  fruid->board.custom1 = NULL;
-  fruid->board.custom2 = NULL;
-  fruid->board.custom3 = NULL;
-  fruid->product.mfg = NULL;
-  fruid->product.name = NULL;
-  fruid->product.part = NULL;
-  fruid->product.version = NULL;
-  fruid->product.serial = NULL;
-  fruid->product.asset_tag = NULL;
-  fruid->product.fruid = NULL;
-  fruid->product.custom1 = NULL;
-  fruid->product.custom2 = NULL;
-  fruid->product.custom3 = NULL;
+  return field_len + 1;
 }
 
-/* Parse the Product area data */
-int parse_fruid_area_product(uint8_t * product,
-      fruid_area_product_t * fruid_product)
+/*
+ * parse_fruid_area - check and decode a chassis, board or product area
+ *
+ * @area      : start of the area
+ * @avail     : bytes from area to the end of the binary
+ * @index     : offset of the first type/length field
+ * @slots     : field slots of the fixed fields, then the three custom ones
+ * @nfixed    : number of fixed fields
+ *
+ * returns 0 on success
+ * returns non-zero errno value on error
+ */
+static int parse_fruid_area(const uint8_t * area, int avail, int index,
+      const uint8_t * slots, int nfixed, fruid_arena_t * arena)
 {
-  int ret, index;
+  int area_len, len, i;
 
-  index = 0;
-
-  /* Reset the struct to zero */
-  memset(fruid_product, 0, sizeof(fruid_area_product_t));
+  if (avail < index) {
+#ifdef DEBUG
+    syslog(LOG_ERR, "fruid: area truncated");
+#endif
+    return EBADF;
+  }
 
   /* Check if the format version is as per IPMI FRUID v1.0 format spec */
-  fruid_product->format_ver = product[index++];
-  if (fruid_product->format_ver != FRUID_FORMAT_VER) {
+  if ((area[0] & 0x0F) != FRUID_FORMAT_VER) {
 #ifdef DEBUG
-    syslog(LOG_ERR, "fruid: product_area: format version not supported");
+    syslog(LOG_ERR, "fruid: area: format version not supported");
 #endif
     return EPROTONOSUPPORT;
   }
 
-  fruid_product->area_len = product[index++] * FRUID_AREA_LEN_MULTIPLIER;
-  fruid_product->lang_code = product[index++];
-
-  fruid_product->chksum = product[fruid_product->area_len - 1];
-  ret = verify_chksum((uint8_t *) product,
-          fruid_product->area_len, fruid_product->chksum);
+  area_len = area[1] * FRUID_AREA_LEN_MULTIPLIER;
+  if (area_len <= index || area_len > avail) {
+#ifdef DEBUG
+    syslog(LOG_ERR, "fruid: area: bad area length %d", area_len);
+#endif
+    return EBADF;
+  }
 
-  if (ret) {
+  if (verify_chksum(area, area_len, area[area_len - 1])) {
 #ifdef DEBUG
-    syslog(LOG_ERR, "fruid: product_area: chksum not verified.");
+    syslog(LOG_ERR, "fruid: area: chksum not verified.");
 #endif
     return EBADF;
   }
 
-  fruid_product->mfg = _fruid_area_field_read(&product[index]);
-  if (fruid_product->mfg == NULL)
-    return ENOMEM;
-  index += FIELD_LEN(product[index]) + 1;
+  /* Checksum byte is not part of the fields */
+  area_len--;
 
-  fruid_product->name = _fruid_area_field_read(&product[index]);
-  if (fruid_product->name == NULL)
-    return ENOMEM;
-  index += FIELD_LEN(product[index]) + 1;
+  for (i = 0; i < nfixed + 3; i++) {
+    /* Check if this field was last and there is no more custom data */
+    if (i >= nfixed && (index >= area_len || area[index] == NO_MORE_DATA_BYTE))
+      break;
 
-  fruid_product->part = _fruid_area_field_read(&product[index]);
-  if (fruid_product->part == NULL)
-    return ENOMEM;
-  index += FIELD_LEN(product[index]) + 1;
+    len = _fruid_area_field_read(&area[index], area_len - index, arena, slots[i]);
+    if (len < 0)
+      return -len;
+    index += len;
+  }
 
-  fruid_product->version = _fruid_area_field_read(&product[index]);
-  if (fruid_product->version == NULL)
-    return ENOMEM;
-  index += FIELD_LEN(product[index]) + 1;
+  return 0;
+}
 
-  fruid_product->serial = _fruid_area_field_read(&product[index]);
-  if (fruid_product->serial == NULL)
-    return ENOMEM;
-  index += FIELD_LEN(product[index]) + 1;
+static const uint8_t chassis_slots[] = {
+  FRUID_CHASSIS_PART, FRUID_CHASSIS_SERIAL,
+  FRUID_CHASSIS_CUSTOM1, FRUID_CHASSIS_CUSTOM2, FRUID_CHASSIS_CUSTOM3,
+};
 
-  fruid_product->asset_tag = _fruid_area_field_read(&product[index]);
-  if (fruid_product->asset_tag == NULL)
-    return ENOMEM;
-  index += FIELD_LEN(product[index]) + 1;
+static const uint8_t board_slots[] = {
+  FRUID_BOARD_MFG, FRUID_BOARD_NAME, FRUID_BOARD_SERIAL, FRUID_BOARD_PART,
+  FRUID_BOARD_FRUID,
+  FRUID_BOARD_CUSTOM1, FRUID_BOARD_CUSTOM2, FRUID_BOARD_CUSTOM3,
+};
 
-  fruid_product->fruid = _fruid_area_field_read(&product[index]);
-  if (fruid_product->fruid == NULL)
-    return ENOMEM;
-  index += FIELD_LEN(product[index]) + 1;
+static const uint8_t product_slots[] = {
+  FRUID_PRODUCT_MFG, FRUID_PRODUCT_NAME, FRUID_PRODUCT_PART,
+  FRUID_PRODUCT_VERSION, FRUID_PRODUCT_SERIAL, FRUID_PRODUCT_ASSET_TAG,
+  FRUID_PRODUCT_FRUID,
+  FRUID_PRODUCT_CUSTOM1, FRUID_PRODUCT_CUSTOM2, FRUID_PRODUCT_CUSTOM3,
+};
 
-  /* Check if this field was last and there is no more custom data */
-  if (product[index] == NO_MORE_DATA_BYTE)
-    return 0;
-  fruid_product->custom1 = _fruid_area_field_read(&product[index]);
-  if (fruid_product->custom1 == NULL)
-    return ENOMEM;
-  index += FIELD_LEN(product[index]) + 1;
+/* Parse the Chassis area data: version, length, type, fields */
+static int parse_fruid_area_chassis(const uint8_t * chassis, int avail,
+      fruid_arena_t * arena)
+{
+  const char * type_str;
+  int ret;
 
-  /* Check if this field was last and there is no more custom data */
-  if (product[index] == NO_MORE_DATA_BYTE)
-    return 0;
-  fruid_product->custom2 = _fruid_area_field_read(&product[index]);
-  if (fruid_product->custom2 == NULL)
-    return ENOMEM;
-  index += FIELD_LEN(product[index]) + 1;
+  ret = parse_fruid_area(chassis, avail, 3, chassis_slots, 2, arena);
+  if (ret)
+    return ret;
 
-  /* Check if this field was last and there is no more custom data */
-  if (product[index] == NO_MORE_DATA_BYTE)
-    return 0;
-  fruid_product->custom3 = _fruid_area_field_read(&product[index]);
-  if (fruid_product->custom3 == NULL)
-    return ENOMEM;
+  type_str = get_chassis_type(chassis[2]);
+  if (type_str == NULL)
+    return ENOMSG;
 
-  return 0;
+  return arena_strcpy(arena, type_str, FRUID_CHASSIS_TYPE);
 }
 
-/* Parse the Board area data */
-int parse_fruid_area_board(uint8_t * board,
-      fruid_area_board_t * fruid_board)
+/* Parse the Board area data: version, length, language, mfg time, fields */
+static int parse_fruid_area_board(const uint8_t * board, int avail,
+      fruid_arena_t * arena)
 {
-  int ret, index, i;
-  time_t unix_time;
+  int ret;
 
-  index = 0;
+  ret = parse_fruid_area(board, avail, 6, board_slots, 5, arena);
+  if (ret)
+    return ret;
 
-  /* Reset the struct to zero */
-  memset(fruid_board, 0, sizeof(fruid_area_board_t));
+  return calculate_time(&board[3], arena);
+}
 
-  /* Check if the format version is as per IPMI FRUID v1.0 format spec */
-  fruid_board->format_ver = board[index++];
-  if (fruid_board->format_ver != FRUID_FORMAT_VER) {
+/* Parse the Product area data: version, length, language, fields */
+static int parse_fruid_area_product(const uint8_t * product, int avail,
+      fruid_arena_t * arena)
+{
+  return parse_fruid_area(product, avail, 3, product_slots, 7, arena);
+}
+
+/* Populate the common header struct */
+static int parse_fruid_header(const uint8_t * eeprom, int len,
+      fruid_header_t * header)
+{
+  if (len < (int) sizeof(fruid_header_t)) {
 #ifdef DEBUG
-    syslog(LOG_ERR, "fruid: board_area: format version not supported");
+    syslog(LOG_ERR, "fruid: common_header: truncated");
 #endif
-    return EPROTONOSUPPORT;
+    return EBADF;
   }
-  fruid_board->area_len = board[index++] * FRUID_AREA_LEN_MULTIPLIER;
-  fruid_board->lang_code = board[index++];
-
-  fruid_board->chksum = board[fruid_board->area_len - 1];
-  ret = verify_chksum((uint8_t *) board,
-          fruid_board->area_len, fruid_board->chksum);
 
-  if (ret) {
+  memcpy((uint8_t *)header, eeprom, sizeof(fruid_header_t));
+  if (verify_chksum(eeprom, sizeof(fruid_header_t), header->chksum)) {
 #ifdef DEBUG
-    syslog(LOG_ERR, "fruid: board_area: chksum not verified.");
+    syslog(LOG_ERR, "fruid: common_header: chksum not verified.");
 #endif
     return EBADF;
   }
 
-  for (i = 0; i < 3; i++) {
-    fruid_board->mfg_time[i] = board[index++];
-  }
-
-  fruid_board->mfg_time_str = calculate_time(fruid_board->mfg_time);
-  if (fruid_board->mfg_time_str == NULL)
-    return ENOMEM;
-
-  fruid_board->mfg = _fruid_area_field_read(&board[index]);
-  if (fruid_board->mfg == NULL)
-    return ENOMEM;
-  index += FIELD_LEN(board[index]) + 1;
+  return 0;
+}
 
-  fruid_board->name = _fruid_area_field_read(&board[index]);
-  if (fruid_board->name == NULL)
-    return ENOMEM;
-  index += FIELD_LEN(board[index]) + 1;
+/*
+ * fruid_parse_compact - decode a FRUID binary into a compact record
+ *
+ * @eeprom    : FRUID binary
+ * @len       : size of the binary
+ * @rec       : record the result is decoded into
+ *
+ * Nothing is allocated: every string goes to rec->pool.
+ *
+ * returns 0 on success
+ * returns non-zero errno value on error, also kept in rec->status
+ */
+int fruid_parse_compact(const uint8_t * eeprom, int len, fruid_compact_t * rec)
+{
+  fruid_header_t header;
+  fruid_arena_t arena = { .rec = rec };
+  int off, ret;
+
+  memset(rec, 0, offsetof(fruid_compact_t, pool));
+  rec->magic = FRUID_COMPACT_MAGIC;
+  rec->version = FRUID_COMPACT_VER;
+  /* Offset 0 is "absent", keep an empty string there */
+  rec->pool[0] = '\0';
+  rec->used = 1;
+
+  ret = parse_fruid_header(eeprom, len, &header);
+  if (ret)
+    goto exit;
+
+  /* If Chassis area is present, parse it */
+  if (header.offset_area.chassis) {
+    off = header.offset_area.chassis * FRUID_OFFSET_MULTIPLIER;
+    ret = parse_fruid_area_chassis(eeprom + off, len - off, &arena);
+    if (ret)
+      goto exit;
+    rec->flags |= FRUID_HAS_CHASSIS;
+  }
 
-  fruid_board->serial = _fruid_area_field_read(&board[index]);
-  if (fruid_board->serial == NULL)
-    return ENOMEM;
-  index += FIELD_LEN(board[index]) + 1;
+  /* If Board area is present, parse it */
+  if (header.offset_area.board) {
+    off = header.offset_area.board * FRUID_OFFSET_MULTIPLIER;
+    ret = parse_fruid_area_board(eeprom + off, len - off, &arena);
+    if (ret)
+      goto exit;
+    rec->flags |= FRUID_HAS_BOARD;
+  }
 
-  fruid_board->part = _fruid_area_field_read(&board[index]);
-  if (fruid_board->part == NULL)
-    return ENOMEM;
-  index += FIELD_LEN(board[index]) + 1;
+  /* If Product area is present, parse it */
+  if (header.offset_area.product) {
+    off = header.offset_area.product * FRUID_OFFSET_MULTIPLIER;
+    ret = parse_fruid_area_product(eeprom + off, len - off, &arena);
+    if (ret)
+      goto exit;
+    rec->flags |= FRUID_HAS_PRODUCT;
+  }
 
-  fruid_board->fruid = _fruid_area_field_read(&board[index]);
-  if (fruid_board->fruid == NULL)
-    return ENOMEM;
-  index += FIELD_LEN(board[index]) + 1;
+exit:
+  rec->status = ret;
+  return ret;
+}
 
-  /* Check if this field was last and there is no more custom data */
-  if (board[index] == NO_MORE_DATA_BYTE)
-    return 0;
-  fruid_board->custom1 = _fruid_area_field_read(&board[index]);
-  if (fruid_board->custom1 == NULL)
-    return ENOMEM;
-  index += FIELD_LEN(board[index]) + 1;
+static char * compact_str(const fruid_compact_t * rec, int slot)
+{
+  return rec->field[slot] ? (char *) &rec->pool[rec->field[slot]] : NULL;
+}
 
-  /* Check if this field was last and there is no more custom data */
-  if (board[index] == NO_MORE_DATA_BYTE)
-    return 0;
-  fruid_board->custom2 = _fruid_area_field_read(&board[index]);
-  if (fruid_board->custom2 == NULL)
-    return ENOMEM;
-  index += FIELD_LEN(board[index]) + 1;
+/* Point the fruid information struct into a compact record */
+void fruid_compact_info(const fruid_compact_t * rec, fruid_info_t * fruid)
+{
+  memset(fruid, 0, sizeof(fruid_info_t));
+
+  if (rec->flags & FRUID_HAS_CHASSIS) {
+    fruid->chassis.flag = 1;
+    fruid->chassis.type_str = compact_str(rec, FRUID_CHASSIS_TYPE);
+    fruid->chassis.part = compact_str(rec, FRUID_CHASSIS_PART);
+    fruid->chassis.serial = compact_str(rec, FRUID_CHASSIS_SERIAL);
+    fruid->chassis.custom1 = compact_str(rec, FRUID_CHASSIS_CUSTOM1);
+    fruid->chassis.custom2 = compact_str(rec, FRUID_CHASSIS_CUSTOM2);
+    fruid->chassis.custom3 = compact_str(rec, FRUID_CHASSIS_CUSTOM3);
+  }
 
-  /* Check if this field was last and there is no more custom data */
-  if (board[index] == NO_MORE_DATA_BYTE)
-    return 0;
-  fruid_board->custom3 = _fruid_area_field_read(&board[index]);
-  if (fruid_board->custom3 == NULL)
-    return ENOMEM;
+  if (rec->flags & FRUID_HAS_BOARD) {
+    fruid->board.flag = 1;
+    fruid->board.mfg_time_str = compact_str(rec, FRUID_BOARD_MFG_TIME);
+    fruid->board.mfg = compact_str(rec, FRUID_BOARD_MFG);
+    fruid->board.name = compact_str(rec, FRUID_BOARD_NAME);
+    fruid->board.serial = compact_str(rec, FRUID_BOARD_SERIAL);
+    fruid->board.part = compact_str(rec, FRUID_BOARD_PART);
+    fruid->board.fruid = compact_str(rec, FRUID_BOARD_FRUID);
+    fruid->board.custom1 = compact_str(rec, FRUID_BOARD_CUSTOM1);
+    fruid->board.custom2 = compact_str(rec, FRUID_BOARD_CUSTOM2);
+    fruid->board.custom3 = compact_str(rec, FRUID_BOARD_CUSTOM3);
+  }
 
-  return 0;
+  if (rec->flags & FRUID_HAS_PRODUCT) {
+    fruid->product.flag = 1;
+    fruid->product.mfg = compact_str(rec, FRUID_PRODUCT_MFG);
+    fruid->product.name = compact_str(rec, FRUID_PRODUCT_NAME);
+    fruid->product.part = compact_str(rec, FRUID_PRODUCT_PART);
+    fruid->product.version = compact_str(rec, FRUID_PRODUCT_VERSION);
+    fruid->product.serial = compact_str(rec, FRUID_PRODUCT_SERIAL);
+    fruid->product.asset_tag = compact_str(rec, FRUID_PRODUCT_ASSET_TAG);
+    fruid->product.fruid = compact_str(rec, FRUID_PRODUCT_FRUID);
+    fruid->product.custom1 = compact_str(rec, FRUID_PRODUCT_CUSTOM1);
+    fruid->product.custom2 = compact_str(rec, FRUID_PRODUCT_CUSTOM2);
+    fruid->product.custom3 = compact_str(rec, FRUID_PRODUCT_CUSTOM3);
+  }
 }
 
-/* Parse the Chassis area data */
-int parse_fruid_area_chassis(uint8_t * chassis,
-      fruid_area_chassis_t * fruid_chassis)
+/* Free the memory allocated for fruid information by fruid_parse() */
+void free_fruid_info(fruid_info_t * fruid)
 {
-  int ret, index;
-
-  index = 0;
+  free(fruid->arena);
+  fruid->arena = NULL;
+}
 
-  /* Reset the struct to zero */
-  memset(fruid_chassis, 0, sizeof(fruid_area_chassis_t));
+/*
+ * read_fruid_bin - read a whole FRUID binary
+ *
+ * returns malloc'ed buffer holding *len bytes
+ * returns NULL on error with errno value in *err
+ */
+static uint8_t * read_fruid_bin(const char * bin, int * len, int * err)
+{
+  struct stat st;
+  uint8_t * eeprom;
+  int fd, n, total = 0;
 
-  /* Check if the format version is as per IPMI FRUID v1.0 format spec */
-  fruid_chassis->format_ver = chassis[index++];
-  if (fruid_chassis->format_ver != FRUID_FORMAT_VER) {
+  fd = open(bin, O_RDONLY);
+  if (fd < 0) {
 #ifdef DEBUG
-    syslog(LOG_ERR, "fruid: chassis_area: format version not supported");
+    syslog(LOG_ERR, "fruid: unable to open the file");
 #endif
-    return EPROTONOSUPPORT;
+    *err = ENOENT;
+    return NULL;
   }
 
-  fruid_chassis->area_len = chassis[index++] * FRUID_AREA_LEN_MULTIPLIER;
-  fruid_chassis->type = chassis[index++];
+  if (fstat(fd, &st) || st.st_size <= 0) {
+    close(fd);
+    *err = ENOENT;
+    return NULL;
+  }
 
-  fruid_chassis->chksum = chassis[fruid_chassis->area_len - 1];
-  ret = verify_chksum((uint8_t *) chassis,
-          fruid_chassis->area_len, fruid_chassis->chksum);
-  if (ret) {
+  eeprom = (uint8_t *) malloc(st.st_size);
+  if (!eeprom) {
 #ifdef DEBUG
-    syslog(LOG_ERR, "fruid: chassis_area: chksum not verified.");
+    syslog(LOG_WARNING, "fruid: malloc: memory allocation failed\n");
 #endif
-    return EBADF;
+    close(fd);
+    *err = ENOMEM;
+    return NULL;
   }
 
-  fruid_chassis->type_str = get_chassis_type(fruid_chassis->type);
-  if (fruid_chassis->type_str == NULL)
-    return ENOMSG;
+  while (total < st.st_size) {
+    n = read(fd, eeprom + total, st.st_size - total);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      break;
+    total += n;
+  }
+  close(fd);
 
-  fruid_chassis->part = _fruid_area_field_read(&chassis[index]);
-  if (fruid_chassis->part == NULL)
-    return ENOMEM;
-  index += FIELD_LEN(chassis[index]) + 1;
+  *len = total;
+  return eeprom;
+}
 
-  fruid_chassis->serial = _fruid_area_field_read(&chassis[index]);
-  if (fruid_chassis->serial == NULL)
-    return ENOMEM;
-  index += FIELD_LEN(chassis[index]) + 1;
+/*
+ * fruid_parse - To parse the bin file (eeprom) and populate
+ *               the fruid information in the struct
+ * @bin       : Eeprom binary file
+ * @fruid     : ptr to the struct that holds the fruid information
+ *
+ * All strings share a single allocation released by free_fruid_info().
+ *
+ * returns 0 on success
+ * returns non-zero errno value on error
+ */
+int fruid_parse(const char * bin, fruid_info_t * fruid)
+{
+  fruid_compact_t * rec;
+  uint8_t * eeprom;
+  int len, ret = 0;
 
-  /* Check if this field was last and there is no more custom data */
-  if (chassis[index] == NO_MORE_DATA_BYTE)
-    return 0;
-  fruid_chassis->custom1 = _fruid_area_field_read(&chassis[index]);
-  if (fruid_chassis->custom1 == NULL)
-    return ENOMEM;
-  index += FIELD_LEN(chassis[index]) + 1;
+  memset(fruid, 0, sizeof(fruid_info_t));
 
-  /* Check if this field was last and there is no more custom data */
-  if (chassis[index] == NO_MORE_DATA_BYTE)
-    return 0;
-  fruid_chassis->custom2 = _fruid_area_field_read(&chassis[index]);
-  if (fruid_chassis->custom2 == NULL)
-    return ENOMEM;
-  index += FIELD_LEN(chassis[index]) + 1;
+  eeprom = read_fruid_bin(bin, &len, &ret);
+  if (!eeprom)
+    return ret;
 
-  /* Check if this field was last and there is no more custom data */
-  if (chassis[index] == NO_MORE_DATA_BYTE)
-    return 0;
-  fruid_chassis->custom3 = _fruid_area_field_read(&chassis[index]);
-  if (fruid_chassis->custom3 == NULL)
+  rec = (fruid_compact_t *) malloc(sizeof(fruid_compact_t));
+  if (!rec) {
+    free(eeprom);
     return ENOMEM;
+  }
+
+  ret = fruid_parse_compact(eeprom, len, rec);
+  free(eeprom);
+  if (ret) {
+    free(rec);
+    return ret;
+  }
+
+  fruid_compact_info(rec, fruid);
+  fruid->arena = rec;
 
   return 0;
 }
 
-/* Calculate the area offsets and populate the fruid_eeprom_t struct */
-void set_fruid_eeprom_offsets(uint8_t * eeprom, fruid_header_t * header,
-      fruid_eeprom_t * fruid_eeprom)
+/* CRC-32 (IEEE 802.3) of the FRUID binary, used as the cache key */
+static uint32_t fruid_crc32(const uint8_t * buf, int len)
 {
-  fruid_eeprom->header = eeprom + 0x00;
+  uint32_t crc = 0xFFFFFFFF;
+  int i, j;
 
-  header->offset_area.chassis ? (fruid_eeprom->chassis = eeprom + \
-    (header->offset_area.chassis * FRUID_OFFSET_MULTIPLIER)) : \
-    (fruid_eeprom->chassis = NULL);
+  for (i = 0; i < len; i++) {
+    crc ^= buf[i];
+    for (j = 0; j < 8; j++)
+      crc = (crc >> 1) ^ (0xEDB88320 & -(crc & 1));
+  }
 
-  header->offset_area.board ? (fruid_eeprom->board = eeprom + \
-    (header->offset_area.board * FRUID_OFFSET_MULTIPLIER)) : \
-    (fruid_eeprom->board = NULL);
+  return ~crc;
+}
 
-  header->offset_area.product ? (fruid_eeprom->product = eeprom + \
-    (header->offset_area.product * FRUID_OFFSET_MULTIPLIER)) : \
-    (fruid_eeprom->product = NULL);
+/* Cache file for a binary: its path with '/' turned into '_' */
+static void fruid_cache_path(const char * bin, char * path, int size)
+{
+  int i, n;
 
-  header->offset_area.multirecord ? (fruid_eeprom->multirecord = eeprom + \
-    (header->offset_area.multirecord * FRUID_OFFSET_MULTIPLIER)) : \
-    (fruid_eeprom->multirecord = NULL);
+  n = snprintf(path, size, "%s/", FRUID_CACHE_DIR);
+  for (i = 0; bin[i] && n < size - 1; i++)
+    path[n++] = (bin[i] == '/') ? '_' : bin[i];
+  path[n] = '\0';
 }
 
-/* Populate the common header struct */
-int parse_fruid_header(uint8_t * eeprom, fruid_header_t * header)
+/*
+ * fruid_cache_load - copy the cached record of a binary into rec
+ *
+ * returns 0 if a well-formed record was found
+ * returns -1 otherwise
+ */
+static int fruid_cache_load(const char * path, fruid_compact_t * rec)
 {
-  int ret;
+  struct stat st;
+  void * map;
+  int fd, ret = -1;
 
-  memcpy((uint8_t *)header, (uint8_t *)eeprom, sizeof(fruid_header_t));
-  ret = verify_chksum((uint8_t *) header,
-          sizeof(fruid_header_t), header->chksum);
-  if (ret) {
-#ifdef DEBUG
-    syslog(LOG_ERR, "fruid: common_header: chksum not verified.");
-#endif
-    return EBADF;
-  }
+  rec->magic = 0;
+  fd = open(path, O_RDONLY);
+  if (fd < 0)
+    return -1;
+
+  if (fstat(fd, &st) || st.st_size != sizeof(fruid_compact_t))
+    goto exit;
+
+  map = mmap(NULL, sizeof(fruid_compact_t), PROT_READ, MAP_SHARED, fd, 0);
+  if (map == MAP_FAILED)
+    goto exit;
+
+  memcpy(rec, map, sizeof(fruid_compact_t));
+  munmap(map, sizeof(fruid_compact_t));
 
+  if (rec->magic == FRUID_COMPACT_MAGIC && rec->version == FRUID_COMPACT_VER &&
+      rec->used <= FRUID_POOL_SIZE)
+    ret = 0;
+
+exit:
+  close(fd);
+  if (ret)
+    rec->magic = 0;
   return ret;
 }
 
-/* Parse the eeprom dump and populate the fruid info in struct */
-int populate_fruid_info(fruid_eeprom_t * fruid_eeprom, fruid_info_t * fruid)
+/* Write rec to the cache; readers see either the old or the new record */
+static void fruid_cache_store(const char * path, const fruid_compact_t * rec)
 {
-  int ret;
+  char tmp[PATH_MAX];
+  int fd, n;
 
-  /* Initial all the required fruid structures */
-  fruid_area_chassis_t fruid_chassis;
-  fruid_area_board_t fruid_board;
-  fruid_area_product_t fruid_product;
-
-  /* If Chassis area is present, parse and print it */
-  if (fruid_eeprom->chassis) {
-    ret = parse_fruid_area_chassis(fruid_eeprom->chassis, &fruid_chassis);
-    if (!ret) {
-      fruid->chassis.flag = 1;
-      fruid->chassis.type_str = fruid_chassis.type_str;
-      fruid->chassis.part = fruid_chassis.part;
-      fruid->chassis.serial = fruid_chassis.serial;
-      fruid->chassis.custom1 = fruid_chassis.custom1;
-      fruid->chassis.custom2 = fruid_chassis.custom2;
-      fruid->chassis.custom3 = fruid_chassis.custom3;
-    } else
-      return ret;
-  }
+  mkdir(FRUID_CACHE_DIR, 0755);
 
-  /* If Board area is present, parse and print it */
-  if (fruid_eeprom->board) {
-    ret = parse_fruid_area_board(fruid_eeprom->board, &fruid_board);
-    if (!ret) {
-      fruid->board.flag = 1;
-      fruid->board.mfg_time_str = fruid_board.mfg_time_str;
-      fruid->board.mfg = fruid_board.mfg;
-      fruid->board.name = fruid_board.name;
-      fruid->board.serial = fruid_board.serial;
-      fruid->board.part = fruid_board.part;
-      fruid->board.fruid = fruid_board.fruid;
-      fruid->board.custom1 = fruid_board.custom1;
-      fruid->board.custom2 = fruid_board.custom2;
-      fruid->board.custom3 = fruid_board.custom3;
-    } else
-      return ret;
+  /* Unique per writer, threads of one process included */
+  snprintf(tmp, sizeof(tmp), "%s.XXXXXX", path);
+  fd = mkstemp(tmp);
+  if (fd < 0) {
+#ifdef DEBUG
+    syslog(LOG_WARNING, "fruid: cannot create cache %s", tmp);
+#endif
+    return;
   }
 
-  /* If Product area is present, parse and print it */
-  if (fruid_eeprom->product) {
-    ret = parse_fruid_area_product(fruid_eeprom->product, &fruid_product);
-    if (!ret) {
-      fruid->product.flag = 1;
-      fruid->product.mfg = fruid_product.mfg;
-      fruid->product.name = fruid_product.name;
-      fruid->product.part = fruid_product.part;
-      fruid->product.version = fruid_product.version;
-      fruid->product.serial = fruid_product.serial;
-      fruid->product.asset_tag = fruid_product.asset_tag;
-      fruid->product.fruid = fruid_product.fruid;
-      fruid->product.custom1 = fruid_product.custom1;
-      fruid->product.custom2 = fruid_product.custom2;
-      fruid->product.custom3 = fruid_product.custom3;
-    } else
-      return ret;
-  }
+  fchmod(fd, 0644);
+  n = write(fd, rec, sizeof(fruid_compact_t));
+  close(fd);
 
-  return 0;
+  if (n != sizeof(fruid_compact_t) || rename(tmp, path))
+    unlink(tmp);
 }
 
 /*
- * fruid_parse - To parse the bin file (eeprom) and populate
- *               the fruid information in the struct
+ * fruid_parse_cached - fruid_parse() backed by the FRUID_CACHE_DIR cache
  * @bin       : Eeprom binary file
+ * @rec       : record the strings of fruid point into
  * @fruid     : ptr to the struct that holds the fruid information
  *
  * returns 0 on success
  * returns non-zero errno value on error
  */
-int fruid_parse(const char * bin, fruid_info_t * fruid)
+int fruid_parse_cached(const char * bin, fruid_compact_t * rec,
+      fruid_info_t * fruid)
 {
-  int fruid_len, ret;
-  FILE *fruid_fd;
+  char path[PATH_MAX];
+  struct stat st;
   uint8_t * eeprom;
+  int64_t mtime;
+  uint32_t crc;
+  int len, ret = 0;
 
-  /* Initial all the required fruid structures */
-  fruid_header_t fruid_header;
-  fruid_eeprom_t fruid_eeprom;
-
-  memset(&fruid_header, 0, sizeof(fruid_header_t));
-  memset(&fruid_eeprom, 0, sizeof(fruid_eeprom_t));
-
-  /* Reset parser return value */
-  ret = 0;
+  memset(fruid, 0, sizeof(fruid_info_t));
 
-  /* Open the FRUID binary file */
-  fruid_fd = fopen(bin, "rb");
-  if (!fruid_fd) {
+  if (stat(bin, &st)) {
 #ifdef DEBUG
     syslog(LOG_ERR, "fruid: unable to open the file");
 #endif
     return ENOENT;
   }
+  mtime = (int64_t) st.st_mtim.tv_sec * 1000000000LL + st.st_mtim.tv_nsec;
 
-  /* Get the size of the binary file */
-  fseek(fruid_fd, 0, SEEK_END);
-  fruid_len = (uint32_t) ftell(fruid_fd);
+  fruid_cache_path(bin, path, sizeof(path));
+  if (!fruid_cache_load(path, rec) && rec->src_size == st.st_size &&
+      rec->src_mtime == mtime)
+    goto done;
 
-  fseek(fruid_fd, 0, SEEK_SET);
-
-  eeprom = (uint8_t *) malloc(fruid_len);
-  if (!eeprom) {
-#ifdef DEBUG
-    syslog(LOG_WARNING, "fruid: malloc: memory allocation failed\n");
-#endif
-    return ENOMEM;
-  }
-
-  /* Read the binary file */
-  fread(eeprom, sizeof(uint8_t), fruid_len, fruid_fd);
-
-  /* Close the FRUID binary file */
-  fclose(fruid_fd);
-
-  /* Parse the common header data */
-  ret = parse_fruid_header(eeprom, &fruid_header);
-  if (ret) {
-    /* Free the eeprom malloc'ed memory */
-    free(eeprom);
+  eeprom = read_fruid_bin(bin, &len, &ret);
+  if (!eeprom)
     return ret;
-  }
+  crc = fruid_crc32(eeprom, len);
 
-  /* Calculate all the area offsets */
-  set_fruid_eeprom_offsets(eeprom, &fruid_header, &fruid_eeprom);
+  /* Rewritten with the same content, only refresh the key */
+  if (rec->magic != FRUID_COMPACT_MAGIC || rec->src_size != len ||
+      rec->src_crc != crc)
+    fruid_parse_compact(eeprom, len, rec);
+  free(eeprom);
 
-  init_fruid_info(fruid);
-  /* Parse the eeprom and populate the fruid information */
-  ret = populate_fruid_info(&fruid_eeprom, fruid);
-  if (ret) {
-    /* Free the malloced memory for the fruid information */
-    free_fruid_info(fruid);
-  }
+  rec->src_size = len;
+  rec->src_crc = crc;
+  rec->src_mtime = mtime;
+  fruid_cache_store(path, rec);
 
-  /* Free the eeprom malloced memory */
-  free(eeprom);
+done:
+  if (rec->status)
+    return rec->status;
 
-  return ret;
+  fruid_compact_info(rec, fruid);
+  return 0;
 }
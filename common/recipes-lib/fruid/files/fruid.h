@@ -147,6 +147,7 @@ typedef struct fruid_info_t {
     char * custom2;
     char * custom3;
   } product;
+  void * arena;   /* single allocation backing every string, or NULL */
 } fruid_info_t;
 
 /* To hold the different area offsets. */
@@ -158,45 +159,84 @@ typedef struct fruid_eeprom_t {
   uint8_t * multirecord;
 } fruid_eeprom_t;
 
-/* List of all the Chassis types. */
-const char * fruid_chassis_type [] = {
-  "Other",                    /* 0x01 */
-  "Unknown",                  /* 0x02 */
-  "Desktop",                  /* 0x03 */
-  "Low Profile Desktop",      /* 0x04 */
-  "Pizza Box",                /* 0x05 */
-  "Mini Tower",               /* 0x06 */
-  "Tower",                    /* 0x07 */
-  "Portable",                 /* 0x08 */
-  "Laptop",                   /* 0x09 */
-  "Notebook",                 /* 0x0A */
-  "Hand Held",                /* 0x0B */
-  "Docking Station",          /* 0x0C */
-  "All in One",               /* 0x0D */
-  "Sub Notebook",             /* 0x0E */
-  "Space-saving",             /* 0x0F */
-  "Lunch Box",                /* 0x10 */
-  "Main Server Chassis",      /* 0x11 */
-  "Expansion Chassis",        /* 0x12 */
-  "SubChassis",               /* 0x13 */
-  "Bus Expansion Chassis",    /* 0x14 */
-  "Peripheral Chassis",       /* 0x15 */
-  "RAID Chassis",             /* 0x16 */
-  "Rack Mount Chassis",       /* 0x17 */
-  "Sealed-case PC",           /* 0x18 */
-  "Multi-system Chassis",     /* 0x19 */
-  "Compact PCI",              /* 0x1A */
-  "Advanced TCA",             /* 0x1B */
-  "Blade",                    /* 0x1C */
-  "Blade Enclosure",          /* 0x1D */
-  "Tablet",                   /* 0x1E */
-  "Convertible",              /* 0x1F */
-  "Detachable"                /* 0x20 */
+/* List of all the Chassis types, indexed by type code - 1. */
+extern const char * fruid_chassis_type[];
+
+/* Field slots of the compact record */
+enum {
+  FRUID_CHASSIS_TYPE = 0,
+  FRUID_CHASSIS_PART,
+  FRUID_CHASSIS_SERIAL,
+  FRUID_CHASSIS_CUSTOM1,
+  FRUID_CHASSIS_CUSTOM2,
+  FRUID_CHASSIS_CUSTOM3,
+  FRUID_BOARD_MFG_TIME,
+  FRUID_BOARD_MFG,
+  FRUID_BOARD_NAME,
+  FRUID_BOARD_SERIAL,
+  FRUID_BOARD_PART,
+  FRUID_BOARD_FRUID,
+  FRUID_BOARD_CUSTOM1,
+  FRUID_BOARD_CUSTOM2,
+  FRUID_BOARD_CUSTOM3,
+  FRUID_PRODUCT_MFG,
+  FRUID_PRODUCT_NAME,
+  FRUID_PRODUCT_PART,
+  FRUID_PRODUCT_VERSION,
+  FRUID_PRODUCT_SERIAL,
+  FRUID_PRODUCT_ASSET_TAG,
+  FRUID_PRODUCT_FRUID,
+  FRUID_PRODUCT_CUSTOM1,
+  FRUID_PRODUCT_CUSTOM2,
+  FRUID_PRODUCT_CUSTOM3,
+  FRUID_FIELD_MAX,
 };
 
+#define FRUID_HAS_CHASSIS   (1 << 0)
+#define FRUID_HAS_BOARD     (1 << 1)
+#define FRUID_HAS_PRODUCT   (1 << 2)
+
+#define FRUID_COMPACT_MAGIC 0x44555246  /* "FRUD" */
+#define FRUID_COMPACT_VER   1
+/* Enough for every field at its longest 6-bit ASCII decode */
+#define FRUID_POOL_SIZE     3072
+
+#define FRUID_CACHE_DIR     "/tmp/fruid_cache"
+
+/*
+ * Parsed FRUID in one contiguous, pointer-free block. Strings live in pool
+ * and are referenced by offset (0 = field absent), so the record can be
+ * written to a file and mapped back by any process as is.
+ */
+typedef struct fruid_compact_t {
+  uint32_t magic;
+  uint16_t version;
+  uint16_t used;                      /* bytes of pool in use */
+  int32_t status;                     /* fruid_parse() return value */
+  uint32_t flags;                     /* FRUID_HAS_* */
+  uint32_t src_size;                  /* source binary size, mtime and CRC32 */
+  uint32_t src_crc;
+  int64_t src_mtime;                  /* nanoseconds */
+  uint16_t field[FRUID_FIELD_MAX];
+  char pool[FRUID_POOL_SIZE];
+} fruid_compact_t;
+
 int fruid_parse(const char * bin, fruid_info_t * fruid);
 void free_fruid_info(fruid_info_t * fruid);
 
+/* Decode an in-memory FRUID binary into rec without allocating */
+int fruid_parse_compact(const uint8_t * eeprom, int len, fruid_compact_t * rec);
+/* Point every fruid_info_t field into rec; no free_fruid_info() needed */
+void fruid_compact_info(const fruid_compact_t * rec, fruid_info_t * fruid);
+
+/*
+ * fruid_parse() through the per-binary cache in FRUID_CACHE_DIR. The binary
+ * is only read when its size or mtime changed and only re-parsed when its
+ * CRC changed too. Strings in fruid point into rec, which must outlive it.
+ */
+int fruid_parse_cached(const char * bin, fruid_compact_t * rec,
+      fruid_info_t * fruid);
+
 #ifdef __cplusplus
 }
 #endif
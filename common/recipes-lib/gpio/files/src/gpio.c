@@ -183,7 +183,10 @@ int gpio_change_edge(gpio_st *g, gpio_edge_en edge)
     goto edge_exit;
   }
 
-  write(fd, str, strlen(str) + 1);
+  /* Pins without interrupt support reject any edge but "none" */
+  if (write(fd, str, strlen(str) + 1) < 0) {
+    rc = -errno;
+  }
 
 edge_exit:
   close(fd);
@@ -317,6 +320,26 @@ int gpio_poll_open(gpio_poll_st *gpios, int count)
   return 0;
 }
 
+int gpio_open_edge(gpio_st *g, int gpio, gpio_edge_en edge)
+{
+  int rc;
+
+  gpio_export(gpio);
+  rc = gpio_open(g, gpio);
+  if (rc) {
+    return rc;
+  }
+  gpio_change_direction(g, GPIO_DIRECTION_IN);
+  rc = gpio_change_edge(g, edge);
+  if (rc) {
+    gpio_close(g);
+    return rc;
+  }
+  /* Consume the current value so only later changes signal */
+  gpio_read(g);
+  return 0;
+}
+
 static void *gpio_poll_pin(void *arg)
 {
   gpio_poll_st *gpios = (gpio_poll_st *)arg;
@@ -73,6 +73,11 @@ char *gpio_name(int gpio, char *str);
 
 int gpio_export(int gpio);
 int gpio_unexport(int gpio);
+/*
+ * Open gpio as an input that signals POLLPRI on its value fd (g->gs_fd)
+ * when edge occurs. Fails if the pin cannot generate interrupts.
+ */
+int gpio_open_edge(gpio_st *g, int gpio, gpio_edge_en edge);
 int gpio_poll_open(gpio_poll_st *gpios, int count);
 int gpio_poll(gpio_poll_st *gpios, int count, int timeout);
 int gpio_poll_close(gpio_poll_st *gpios, int count);
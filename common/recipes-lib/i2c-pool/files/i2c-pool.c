@@ -0,0 +1,402 @@
+/*
+ * Copyright 2017-present Facebook. All Rights Reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <syslog.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "i2c-pool.h"
+
+#define I2C_POOL_STATS_MAGIC   0x49325053  // "I2PS"
+#define I2C_POOL_STATS_VERSION 1
+
+struct pool_stats {
+  uint32_t magic;
+  uint32_t version;
+  i2c_bus_stats_t bus[I2C_POOL_MAX_BUS];
+};
+
+/*
+ * The mutex serializes the threads of a process on the bus handle, since
+ * the slave address is a property of the handle. It is recursive so that
+ * a thread holding i2c_pool_lock() can still make transfers.
+ */
+struct pool_bus {
+  pthread_mutex_t mutex;
+  int fd;
+  int addr;     // 7-bit address last set with I2C_SLAVE, -1 for none
+  int depth;    // nesting of i2c_pool_lock()
+};
+
+static pthread_once_t g_once = PTHREAD_ONCE_INIT;
+static struct pool_bus g_bus[I2C_POOL_MAX_BUS];
+static struct pool_stats *g_stats;
+
+typedef int (*xfer_fn)(struct pool_bus *b, void *arg);
+
+struct rdwr_arg {
+  uint8_t addr;
+  uint8_t *tbuf;
+  uint8_t tcount;
+  uint8_t *rbuf;
+  uint8_t rcount;
+};
+
+struct smbus_arg {
+  uint8_t addr;
+  char read_write;
+  uint8_t cmd;
+  int size;
+  union i2c_smbus_data *data;
+};
+
+static uint64_t
+now_us(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void
+msleep(int msec) {
+  struct timespec req;
+
+  req.tv_sec = msec / 1000;
+  req.tv_nsec = (msec % 1000) * 1000 * 1000;
+
+  while (nanosleep(&req, &req) == -1 && errno == EINTR) {
+    continue;
+  }
+}
+
+// Map the stats page shared by all users of the pool; they go uncounted
+// if that fails
+static void
+stats_open(void) {
+  struct pool_stats *stats;
+  struct stat st;
+  int fd;
+
+  fd = shm_open(I2C_POOL_STATS_SHM, O_CREAT | O_RDWR | O_CLOEXEC, 0644);
+  if (fd < 0) {
+    syslog(LOG_WARNING, "%s: shm_open failed, errno %d", __func__, errno);
+    return;
+  }
+
+  // Whoever gets here first after boot sets the page up
+  flock(fd, LOCK_EX);
+  if (fstat(fd, &st) || (st.st_size < sizeof(struct pool_stats) &&
+                         ftruncate(fd, sizeof(struct pool_stats)))) {
+    syslog(LOG_WARNING, "%s: ftruncate failed, errno %d", __func__, errno);
+    goto exit;
+  }
+
+  stats = mmap(NULL, sizeof(struct pool_stats), PROT_READ | PROT_WRITE,
+               MAP_SHARED, fd, 0);
+  if (stats == MAP_FAILED) {
+    syslog(LOG_WARNING, "%s: mmap failed, errno %d", __func__, errno);
+    goto exit;
+  }
+
+  if (stats->magic != I2C_POOL_STATS_MAGIC ||
+      stats->version != I2C_POOL_STATS_VERSION) {
+    memset(stats, 0, sizeof(*stats));
+    stats->version = I2C_POOL_STATS_VERSION;
+    stats->magic = I2C_POOL_STATS_MAGIC;
+  }
+  g_stats = stats;
+
+exit:
+  flock(fd, LOCK_UN);
+  close(fd);
+}
+
+static void
+pool_init(void) {
+  pthread_mutexattr_t attr;
+  int i;
+
+  pthread_mutexattr_init(&attr);
+  pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+  for (i = 0; i < I2C_POOL_MAX_BUS; i++) {
+    pthread_mutex_init(&g_bus[i].mutex, &attr);
+    g_bus[i].fd = -1;
+    g_bus[i].addr = -1;
+  }
+  pthread_mutexattr_destroy(&attr);
+
+  stats_open();
+}
+
+static struct pool_bus *
+pool_bus(uint8_t bus) {
+  if (bus >= I2C_POOL_MAX_BUS) {
+    errno = EINVAL;
+    return NULL;
+  }
+
+  pthread_once(&g_once, pool_init);
+  return &g_bus[bus];
+}
+
+// Counters are bumped atomically, many processes share them
+static void
+stats_xfer(uint8_t bus, uint32_t us, int err) {
+  i2c_bus_stats_t *st;
+  uint32_t old;
+  int i;
+
+  if (!g_stats)
+    return;
+  st = &g_stats->bus[bus];
+
+  __sync_fetch_and_add(&st->xfers, 1);
+  if (err)
+    __sync_fetch_and_add(&st->errors, 1);
+
+  old = __sync_fetch_and_add(&st->total_us_lo, us);
+  if (old + us < old)
+    __sync_fetch_and_add(&st->total_us_hi, 1);
+
+  for (i = 0; i < I2C_POOL_HIST_BUCKETS - 1; i++) {
+    if (us < (I2C_POOL_HIST_BASE_US << i))
+      break;
+  }
+  __sync_fetch_and_add(&st->hist[i], 1);
+
+  do {
+    old = st->max_us;
+  } while (us > old && !__sync_bool_compare_and_swap(&st->max_us, old, us));
+}
+
+// Called with the bus mutex held
+static int
+pool_open(uint8_t bus, struct pool_bus *b) {
+  char fn[32];
+
+  if (b->fd >= 0)
+    return 0;
+
+  snprintf(fn, sizeof(fn), "/dev/i2c-%d", bus);
+  b->fd = open(fn, O_RDWR | O_CLOEXEC);
+  if (b->fd < 0) {
+    syslog(LOG_WARNING, "%s: open %s failed, errno %d", __func__, fn, errno);
+    return -1;
+  }
+  b->addr = -1;
+
+  if (g_stats)
+    __sync_fetch_and_add(&g_stats->bus[bus].opens, 1);
+  return 0;
+}
+
+// Called with the bus mutex held; the handle carries the flock, so it
+// stays while the bus is locked
+static void
+pool_close(struct pool_bus *b) {
+  if (b->fd < 0 || b->depth > 0)
+    return;
+
+  close(b->fd);
+  b->fd = -1;
+  b->addr = -1;
+}
+
+static int
+pool_xfer(uint8_t bus, const i2c_retry_t *retry, xfer_fn fn, void *arg) {
+  struct pool_bus *b = pool_bus(bus);
+  uint64_t start, t0;
+  int ret, err, attempt = 0, backoff;
+
+  if (!b)
+    return -1;
+
+  start = now_us();
+  backoff = retry ? retry->backoff_ms : 0;
+
+  for (;;) {
+    pthread_mutex_lock(&b->mutex);
+    ret = pool_open(bus, b);
+    if (!ret) {
+      t0 = now_us();
+      ret = fn(b, arg);
+      err = errno;
+      stats_xfer(bus, now_us() - t0, ret < 0);
+      // The adapter is gone, e.g. a mux was torn down; open it afresh
+      if (ret < 0 && (err == ENODEV || err == EBADF))
+        pool_close(b);
+      errno = err;
+    }
+    pthread_mutex_unlock(&b->mutex);
+
+    if (ret >= 0)
+      return 0;
+
+    if (!retry || attempt >= retry->retries)
+      break;
+    if (retry->deadline_ms &&
+        now_us() - start + (uint64_t)backoff * 1000 >
+        (uint64_t)retry->deadline_ms * 1000)
+      break;
+
+    attempt++;
+    if (g_stats)
+      __sync_fetch_and_add(&g_stats->bus[bus].retries, 1);
+    msleep(backoff);
+    backoff *= 2;
+    if (retry->max_backoff_ms && backoff > retry->max_backoff_ms)
+      backoff = retry->max_backoff_ms;
+  }
+
+  if (g_stats)
+    __sync_fetch_and_add(&g_stats->bus[bus].giveups, 1);
+  return -1;
+}
+
+static int
+rdwr_fn(struct pool_bus *b, void *arg) {
+  struct rdwr_arg *a = arg;
+
+  return i2c_rdwr_msg_transfer(b->fd, a->addr, a->tbuf, a->tcount,
+                               a->rbuf, a->rcount);
+}
+
+static int
+smbus_fn(struct pool_bus *b, void *arg) {
+  struct smbus_arg *a = arg;
+
+  if (b->addr != a->addr) {
+    if (ioctl(b->fd, I2C_SLAVE, a->addr) < 0) {
+      b->addr = -1;
+      return -1;
+    }
+    b->addr = a->addr;
+  }
+
+  return i2c_smbus_access(b->fd, a->read_write, a->cmd, a->size, a->data);
+}
+
+int
+i2c_pool_rdwr(uint8_t bus, uint8_t addr, uint8_t *tbuf, uint8_t tcount,
+              uint8_t *rbuf, uint8_t rcount, const i2c_retry_t *retry) {
+  struct rdwr_arg a = {addr, tbuf, tcount, rbuf, rcount};
+
+  return pool_xfer(bus, retry, rdwr_fn, &a);
+}
+
+int
+i2c_pool_smbus(uint8_t bus, uint8_t addr, char read_write, uint8_t cmd,
+               int size, union i2c_smbus_data *data,
+               const i2c_retry_t *retry) {
+  struct smbus_arg a = {addr, read_write, cmd, size, data};
+
+  return pool_xfer(bus, retry, smbus_fn, &a);
+}
+
+int
+i2c_pool_lock(uint8_t bus) {
+  struct pool_bus *b = pool_bus(bus);
+  uint64_t start;
+  int ret;
+
+  if (!b)
+    return -1;
+
+  pthread_mutex_lock(&b->mutex);
+  if (b->depth > 0) {
+    b->depth++;
+    return 0;
+  }
+
+  if (pool_open(bus, b))
+    goto err;
+
+  if (flock(b->fd, LOCK_EX | LOCK_NB)) {
+    if (errno != EWOULDBLOCK)
+      goto err;
+
+    start = now_us();
+    while ((ret = flock(b->fd, LOCK_EX)) < 0 && errno == EINTR);
+    if (ret < 0)
+      goto err;
+    if (g_stats) {
+      __sync_fetch_and_add(&g_stats->bus[bus].lock_waits, 1);
+      __sync_fetch_and_add(&g_stats->bus[bus].lock_wait_ms,
+                           (now_us() - start) / 1000);
+    }
+  }
+
+  b->depth = 1;
+  return 0;
+
+err:
+  syslog(LOG_WARNING, "%s: bus %d, errno %d", __func__, bus, errno);
+  pthread_mutex_unlock(&b->mutex);
+  return -1;
+}
+
+void
+i2c_pool_unlock(uint8_t bus) {
+  struct pool_bus *b = pool_bus(bus);
+
+  if (!b || b->depth <= 0)
+    return;
+
+  if (--b->depth == 0)
+    flock(b->fd, LOCK_UN);
+  pthread_mutex_unlock(&b->mutex);
+}
+
+void
+i2c_pool_release(uint8_t bus) {
+  struct pool_bus *b = pool_bus(bus);
+
+  if (!b)
+    return;
+
+  pthread_mutex_lock(&b->mutex);
+  pool_close(b);
+  pthread_mutex_unlock(&b->mutex);
+}
+
+int
+i2c_pool_get_stats(uint8_t bus, i2c_bus_stats_t *stats) {
+  if (!pool_bus(bus) || !g_stats)
+    return -1;
+
+  memcpy(stats, &g_stats->bus[bus], sizeof(*stats));
+  return 0;
+}
+
+int
+i2c_pool_clear_stats(void) {
+  pthread_once(&g_once, pool_init);
+  if (!g_stats)
+    return -1;
+
+  memset(g_stats->bus, 0, sizeof(g_stats->bus));
+  return 0;
+}
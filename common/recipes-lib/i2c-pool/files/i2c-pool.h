@@ -0,0 +1,96 @@
+/*
+ * Copyright 2017-present Facebook. All Rights Reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+#ifndef __I2C_POOL_H__
+#define __I2C_POOL_H__
+
+#include <stdint.h>
+#include <string.h>
+#include <openbmc/obmc-i2c.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * I2C handle pool: one /dev/i2c-N handle per bus and process, kept open
+ * across transactions, with the slave address only set when it changes.
+ * Transactions retry by a caller supplied policy, and every attempt is
+ * counted in per-bus stats shared by all processes.
+ */
+
+#define I2C_POOL_MAX_BUS        16
+#define I2C_POOL_STATS_SHM      "/i2c-pool"
+#define I2C_POOL_HIST_BUCKETS   12
+#define I2C_POOL_HIST_BASE_US   64    /* bucket i counts < BASE << i us */
+
+typedef struct {
+  int retries;          /* attempts after the first one */
+  int backoff_ms;       /* sleep before the first retry, doubled after each */
+  int max_backoff_ms;   /* cap for the sleep, 0 for none */
+  int deadline_ms;      /* no retry after this long, 0 for none */
+} i2c_retry_t;
+
+typedef struct {
+  uint32_t xfers;       /* attempts, retries included */
+  uint32_t errors;      /* attempts that failed */
+  uint32_t retries;
+  uint32_t giveups;     /* calls that failed after their last retry */
+  uint32_t opens;       /* times a process had to open the bus */
+  uint32_t lock_waits;  /* i2c_pool_lock calls that found the bus taken */
+  uint32_t lock_wait_ms;
+  uint32_t max_us;
+  uint32_t total_us_lo; /* time spent in transfers */
+  uint32_t total_us_hi;
+  uint32_t hist[I2C_POOL_HIST_BUCKETS];
+} i2c_bus_stats_t;
+
+/*
+ * Take the bus for a sequence of transactions, e.g. a page select and the
+ * read that depends on it. Excludes other threads and, through an flock
+ * of the device, other processes that use the pool. Calls nest.
+ */
+int i2c_pool_lock(uint8_t bus);
+void i2c_pool_unlock(uint8_t bus);
+
+/*
+ * Raw transfer as i2c_rdwr_msg_transfer(); addr is the 8-bit address.
+ * retry may be NULL for a single attempt.
+ */
+int i2c_pool_rdwr(uint8_t bus, uint8_t addr, uint8_t *tbuf, uint8_t tcount,
+                  uint8_t *rbuf, uint8_t rcount, const i2c_retry_t *retry);
+
+/*
+ * SMBus transfer as i2c_smbus_access() after I2C_SLAVE; addr is the 7-bit
+ * address.
+ */
+int i2c_pool_smbus(uint8_t bus, uint8_t addr, char read_write, uint8_t cmd,
+                   int size, union i2c_smbus_data *data,
+                   const i2c_retry_t *retry);
+
+/* Close the cached handle, e.g. when the adapter went away */
+void i2c_pool_release(uint8_t bus);
+
+/* Copy the stats of the bus; -1 if none have been kept */
+int i2c_pool_get_stats(uint8_t bus, i2c_bus_stats_t *stats);
+int i2c_pool_clear_stats(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __I2C_POOL_H__ */
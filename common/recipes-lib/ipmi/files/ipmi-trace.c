@@ -0,0 +1,175 @@
+/*
+ *
+ * Copyright 2017-present Facebook. All Rights Reserved.
+ *
+ * This file keeps the request trace ring of ipmid and ipmbd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#include "ipmi.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syslog.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+
+#define TRACE_ALIGN(x)  (((x) + 7) & ~7)
+
+struct ipmi_trace {
+  ipmi_trace_hdr_t *hdr;
+  uint8_t *ring;
+  uint32_t id;
+  pthread_mutex_t lock;
+};
+
+static uint64_t
+trace_now_us(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/*
+ * The ring lives in a file so it outlives the daemon and ipmi-util can
+ * map it. Pages are only used once tracing is turned on.
+ */
+ipmi_trace_t *
+ipmi_trace_open(const char *name, const char *sock) {
+  ipmi_trace_t *trace;
+  char path[64];
+  size_t len = sizeof(ipmi_trace_hdr_t) + IPMI_TRACE_SIZE;
+  void *map;
+  int fd;
+
+  snprintf(path, sizeof(path), IPMI_TRACE_PATH, name);
+  fd = open(path, O_RDWR | O_CREAT, 0644);
+  if (fd < 0) {
+    syslog(LOG_WARNING, "ipmi_trace_open: cannot open %s", path);
+    return NULL;
+  }
+  if (ftruncate(fd, len)) {
+    syslog(LOG_WARNING, "ipmi_trace_open: cannot size %s", path);
+    close(fd);
+    return NULL;
+  }
+  map = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED) {
+    syslog(LOG_WARNING, "ipmi_trace_open: cannot map %s", path);
+    return NULL;
+  }
+
+  trace = calloc(1, sizeof(*trace));
+  if (!trace) {
+    munmap(map, len);
+    return NULL;
+  }
+  trace->hdr = map;
+  trace->ring = (uint8_t *)map + sizeof(ipmi_trace_hdr_t);
+  pthread_mutex_init(&trace->lock, NULL);
+
+  // Whatever an earlier instance left behind is of no use
+  memset(trace->hdr, 0, sizeof(ipmi_trace_hdr_t));
+  trace->hdr->magic = IPMI_TRACE_MAGIC;
+  trace->hdr->version = IPMI_TRACE_VERSION;
+  trace->hdr->size = IPMI_TRACE_SIZE;
+  strncpy(trace->hdr->sock, sock, sizeof(trace->hdr->sock) - 1);
+
+  return trace;
+}
+
+uint64_t
+ipmi_trace_start(ipmi_trace_t *trace) {
+  if (!trace || !trace->hdr->enabled)
+    return 0;
+  return trace_now_us();
+}
+
+static void
+trace_drop_oldest(ipmi_trace_hdr_t *hdr, uint8_t *ring) {
+  ipmi_trace_rec_t *rec = (ipmi_trace_rec_t *)(ring + hdr->tail);
+
+  hdr->tail += rec->size;
+  if (hdr->tail + sizeof(*rec) > hdr->size ||
+      ((ipmi_trace_rec_t *)(ring + hdr->tail))->size == 0)
+    hdr->tail = 0;
+  hdr->count--;
+  hdr->dropped++;
+  if (!hdr->count)
+    hdr->tail = hdr->head;
+}
+
+void
+ipmi_trace_end(ipmi_trace_t *trace, uint64_t start,
+               const unsigned char *req, unsigned short req_len,
+               const unsigned char *res, unsigned short res_len) {
+  ipmi_trace_hdr_t *hdr;
+  ipmi_trace_rec_t *rec;
+  uint32_t need = TRACE_ALIGN(sizeof(*rec) + req_len + res_len);
+  uint32_t lat;
+
+  if (!trace || !start)
+    return;
+  lat = trace_now_us() - start;
+  hdr = trace->hdr;
+  if (need > hdr->size / 2)
+    return;
+
+  pthread_mutex_lock(&trace->lock);
+  hdr->seq++;
+  __sync_synchronize();
+
+  // Wrap, dropping what is left between the head and the end
+  if (hdr->head + need > hdr->size) {
+    while (hdr->count && hdr->tail >= hdr->head)
+      trace_drop_oldest(hdr, trace->ring);
+    if (hdr->head + sizeof(*rec) <= hdr->size)
+      ((ipmi_trace_rec_t *)(trace->ring + hdr->head))->size = 0;
+    hdr->head = 0;
+    if (!hdr->count)
+      hdr->tail = 0;
+  }
+  while (hdr->count && hdr->tail >= hdr->head && hdr->tail < hdr->head + need)
+    trace_drop_oldest(hdr, trace->ring);
+
+  rec = (ipmi_trace_rec_t *)(trace->ring + hdr->head);
+  rec->size = need;
+  rec->req_len = req_len;
+  rec->res_len = res_len;
+  rec->rsvd = 0;
+  rec->id = trace->id++;
+  rec->lat_us = lat;
+  rec->ts_us = start;
+  memcpy(rec + 1, req, req_len);
+  memcpy((uint8_t *)(rec + 1) + req_len, res, res_len);
+
+  hdr->head += need;
+  if (hdr->head + sizeof(*rec) > hdr->size) {
+    if (hdr->head < hdr->size)
+      ((ipmi_trace_rec_t *)(trace->ring + hdr->head))->size = 0;
+    hdr->head = 0;
+  }
+  hdr->count++;
+
+  __sync_synchronize();
+  hdr->seq++;
+  pthread_mutex_unlock(&trace->lock);
+}
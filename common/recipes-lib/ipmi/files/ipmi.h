@@ -27,7 +27,9 @@ extern "C" {
 
 #include <stdint.h>
 
+#ifndef SOCK_PATH_IPMI
 #define SOCK_PATH_IPMI "/tmp/ipmi_socket"
+#endif
 
 #define IPMI_SEL_VERSION  0x51
 #define IPMI_SDR_VERSION  0x51
@@ -565,9 +567,86 @@ enum
   test_mode = 0x7c,
 };
 
+// Per-command statistics kept by ipmid in shared memory
+#define IPMI_STATS_SHM            "/ipmid_stats"
+#define IPMI_STATS_MAGIC          0x49504d53
+#define IPMI_STATS_VERSION        1
+#define IPMI_STATS_MAX_CMDS       128
+// Bucket i counts latencies below (64us << i), the last one the rest
+#define IPMI_STATS_HIST_BUCKETS   16
+#define IPMI_STATS_HIST_BASE_US   64
+
+typedef struct {
+  uint8_t netfn;
+  uint8_t cmd;
+  uint8_t rsvd[2];
+  char name[28];
+  uint32_t count;
+  uint32_t errors;          // completion code other than CC_SUCCESS
+  uint32_t max_us;
+  uint64_t total_us;
+  uint32_t hist[IPMI_STATS_HIST_BUCKETS];
+} ipmi_cmd_stats_t;
+
+typedef struct {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t seq;             // odd while ipmid updates the page
+  uint32_t num_cmds;
+  uint32_t unknown;         // requests with no handler
+  ipmi_cmd_stats_t cmd[IPMI_STATS_MAX_CMDS];
+} ipmi_stats_t;
+
 void lib_ipmi_handle(unsigned char *request, unsigned char req_len,
                  unsigned char *response, unsigned short *res_len);
 
+/*
+ * Request tracing. ipmid and ipmbd keep a ring of the requests they
+ * served, with the responses and timings, in IPMI_TRACE_PATH. The ring is
+ * written only while its enabled flag is set, by ipmi-util --trace.
+ */
+#ifndef IPMI_TRACE_PATH
+#define IPMI_TRACE_PATH           "/tmp/ipmi_trace_%s"
+#endif
+#define IPMI_TRACE_MAGIC          0x49504d54
+#define IPMI_TRACE_VERSION        1
+#define IPMI_TRACE_SIZE           (256 * 1024)
+
+typedef struct {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t enabled;
+  uint32_t seq;             // odd while a record is added
+  uint32_t size;            // of the ring, which follows this header
+  uint32_t head;            // where the next record goes
+  uint32_t tail;            // oldest record
+  uint32_t count;
+  uint32_t dropped;         // records overwritten by newer ones
+  uint32_t rsvd;
+  char sock[24];            // socket the requests came in on
+} ipmi_trace_hdr_t;
+
+// Followed by the request, the response and padding to 8 bytes
+typedef struct {
+  uint16_t size;            // 0 marks the end of the ring
+  uint16_t req_len;
+  uint16_t res_len;
+  uint16_t rsvd;
+  uint32_t id;
+  uint32_t lat_us;
+  uint64_t ts_us;           // CLOCK_MONOTONIC when the request came in
+} ipmi_trace_rec_t;
+
+typedef struct ipmi_trace ipmi_trace_t;
+
+ipmi_trace_t *ipmi_trace_open(const char *name, const char *sock);
+/* Start time of a request, or 0 if tracing is off */
+uint64_t ipmi_trace_start(ipmi_trace_t *trace);
+/* Add a request started at start to the ring; nothing if start is 0 */
+void ipmi_trace_end(ipmi_trace_t *trace, uint64_t start,
+                    const unsigned char *req, unsigned short req_len,
+                    const unsigned char *res, unsigned short res_len);
+
 #ifdef __cplusplus
 } // extern "C"
 #endif
@@ -30,8 +30,10 @@ extern "C" {
 #define MAX_KEY_LEN       64
 #define MAX_VALUE_LEN     64
 
+#ifndef KV_STORE_PATH
 #define KV_STORE "/mnt/data/kv_store/%s"
 #define KV_STORE_PATH "/mnt/data/kv_store"
+#endif
 
 int kv_get(char* key, char *value);
 int kv_set(char* key, char *value);
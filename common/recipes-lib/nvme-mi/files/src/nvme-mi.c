@@ -22,6 +22,10 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
 #include <openbmc/obmc-i2c.h>
 #include "nvme-mi.h"
 
@@ -51,32 +55,269 @@
 #define VENDOR_ID_SEAGATE 0x1BB1
 #define VENDOR_ID_TOSHIBA 0x1179
 
+/*
+ * NVMe-MI basic management data structure. An I2C block read at command 0
+ * returns the blocks of command codes 0 and 8 back to back, each starting
+ * with its length and ending with its own PEC.
+ */
+#define NVME_MI_BLOCK_SIZE 32
+#define NVME_MI_BLK0_CMD 0x00
+#define NVME_MI_BLK0_LEN 6
+#define NVME_MI_BLK0_PEC 7
+#define NVME_MI_BLK8_CMD 0x08
+#define NVME_MI_BLK8_LEN 22
+
+#define NVME_MI_RETRY 5
+/* Block reads are tried twice; after this many failures in a row the drive
+ * is taken not to support them and is only read byte by byte */
+#define NVME_BLOCK_RETRY_MS 10
+#define NVME_BLOCK_MAX_FAILS 3
+
+/* The drive refreshes the structure about once a second */
+#define NVME_SNAPSHOT_MS 1000
+
+#define NVME_DEV_MAX 16
+
+/*
+ * One entry per bus device, holding the open fd and the last snapshot read
+ * through it. Drives behind a mux share the entry, so whoever switches the
+ * mux calls nvme_snapshot_invalidate().
+ */
+struct nvme_dev {
+  char bus[32];
+  int fd;                   // -1 when closed
+  int valid;                // 1 snapshot, -1 block read failed, 0 neither
+  int block_fails;          // failed block reads in a row
+  uint64_t ts_ms;
+  ssd_data data;
+};
+
+static pthread_mutex_t m_nvme = PTHREAD_MUTEX_INITIALIZER;
+static struct nvme_dev g_dev[NVME_DEV_MAX];
+static int g_next_evict;
+
+static uint64_t
+now_ms(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/* SMBus PEC, CRC-8 with polynomial x^8 + x^2 + x + 1 */
+static uint8_t
+nvme_crc8(uint8_t crc, const uint8_t *buf, int len) {
+  int i;
+
+  while (len--) {
+    crc ^= *buf++;
+    for (i = 0; i < 8; i++)
+      crc = (crc & 0x80) ? (crc << 1) ^ 0x07 : crc << 1;
+  }
+
+  return crc;
+}
+
+/* Check the length and PEC of the block of a command code at offset off */
+static int
+nvme_block_check(const uint8_t *buf, uint8_t cmd, int off, int len) {
+  uint8_t hdr[3] = {I2C_NVME_INTF_ADDR << 1, cmd, (I2C_NVME_INTF_ADDR << 1) | 1};
+  uint8_t crc;
+
+  if (buf[off] != len)
+    return -1;
+
+  crc = nvme_crc8(0, hdr, sizeof(hdr));
+  crc = nvme_crc8(crc, buf + off, len + 1);
+
+  return (crc == buf[off + len + 1]) ? 0 : -1;
+}
+
+static void
+nvme_dev_close(struct nvme_dev *nd) {
+  if (nd->fd >= 0) {
+    close(nd->fd);
+    nd->fd = -1;
+  }
+  nd->valid = 0;
+  nd->block_fails = 0;
+}
+
+/* Find or open the entry of a bus device. Called with m_nvme held. */
+static struct nvme_dev *
+nvme_dev_get(const char *i2c_bus_device) {
+  struct nvme_dev *nd = NULL;
+  int i;
+
+  for (i = 0; i < NVME_DEV_MAX; i++) {
+    if (!strcmp(g_dev[i].bus, i2c_bus_device)) {
+      nd = &g_dev[i];
+      break;
+    }
+    if (!nd && !g_dev[i].bus[0])
+      nd = &g_dev[i];
+  }
+
+  if (!nd || strcmp(nd->bus, i2c_bus_device)) {
+    if (strlen(i2c_bus_device) >= sizeof(nd->bus)) {
+      syslog(LOG_DEBUG, "%s(): bus name too long", __func__);
+      return NULL;
+    }
+    if (!nd) {
+      nd = &g_dev[g_next_evict];
+      g_next_evict = (g_next_evict + 1) % NVME_DEV_MAX;
+    }
+    if (nd->bus[0])
+      nvme_dev_close(nd);
+    else
+      nd->fd = -1;
+    strcpy(nd->bus, i2c_bus_device);
+  }
+
+  if (nd->fd >= 0)
+    return nd;
+
+  nd->fd = open(i2c_bus_device, O_RDWR | O_CLOEXEC);
+  if (nd->fd < 0) {
+    syslog(LOG_DEBUG, "%s(): open() failed", __func__);
+    return NULL;
+  }
+
+  if (ioctl(nd->fd, I2C_SLAVE, I2C_NVME_INTF_ADDR) < 0) {
+    syslog(LOG_DEBUG, "%s(): ioctl() assigning i2c addr failed", __func__);
+    nvme_dev_close(nd);
+    return NULL;
+  }
+
+  return nd;
+}
+
+/* Read and decode the whole structure. Called with m_nvme held. */
+static int
+nvme_dev_block_read(struct nvme_dev *nd, ssd_data *data) {
+  uint8_t buf[NVME_MI_BLOCK_SIZE];
+  int retry = 0;
+  int res;
+
+  while (1) {
+    res = i2c_smbus_read_i2c_block_data(nd->fd, NVME_MI_BLK0_CMD, sizeof(buf), buf);
+    if (res == sizeof(buf) &&
+        !nvme_block_check(buf, NVME_MI_BLK0_CMD, 0, NVME_MI_BLK0_LEN) &&
+        !nvme_block_check(buf, NVME_MI_BLK8_CMD, NVME_MI_BLK0_PEC + 1, NVME_MI_BLK8_LEN))
+      break;
+    if (retry++ >= 1) {
+      syslog(LOG_DEBUG, "%s(): %s", __func__, (res == sizeof(buf)) ?
+             "PEC mismatch" : "i2c_smbus_read_i2c_block_data failed");
+      nd->valid = -1;
+      nd->ts_ms = now_ms();
+      if (nd->block_fails < NVME_BLOCK_MAX_FAILS)
+        nd->block_fails++;
+      return -1;
+    }
+    msleep(NVME_BLOCK_RETRY_MS);
+  }
+
+  data->sflgs = buf[NVME_SFLGS_REG];
+  data->warning = buf[NVME_WARNING_REG];
+  data->temp = buf[NVME_TEMP_REG];
+  data->pdlu = buf[NVME_PDLU_REG];
+  data->vendor = buf[NVME_VENDOR_REG] << 8 | buf[NVME_VENDOR_REG + 1];
+  memcpy(data->serial_num, buf + NVME_SERIAL_NUM_REG, SERIAL_NUM_SIZE);
+
+  nd->data = *data;
+  nd->ts_ms = now_ms();
+  nd->valid = 1;
+  nd->block_fails = 0;
+
+  return 0;
+}
+
+/* Read the basic management data structure in one transaction. */
+int
+nvme_block_read(const char *i2c_bus_device, ssd_data *data) {
+  struct nvme_dev *nd;
+  int ret = -1;
+
+  if ((i2c_bus_device == NULL) | (data == NULL))
+    return -1;
+
+  pthread_mutex_lock(&m_nvme);
+  nd = nvme_dev_get(i2c_bus_device);
+  if (nd)
+    ret = nvme_dev_block_read(nd, data);
+  pthread_mutex_unlock(&m_nvme);
+
+  return ret;
+}
+
+/*
+ * Return the snapshot of the drive, reading it again once it is stale. A
+ * failed block read is not retried within the same window, and not at all
+ * on a drive that keeps failing them, so the per-field reads of drives
+ * without it fall back to byte reads right away.
+ */
+int
+nvme_snapshot_read(const char *i2c_bus_device, ssd_data *data) {
+  struct nvme_dev *nd;
+  int ret = -1;
+
+  if ((i2c_bus_device == NULL) | (data == NULL))
+    return -1;
+
+  pthread_mutex_lock(&m_nvme);
+  nd = nvme_dev_get(i2c_bus_device);
+  if (nd && nd->block_fails < NVME_BLOCK_MAX_FAILS) {
+    if (nd->valid && now_ms() - nd->ts_ms < NVME_SNAPSHOT_MS) {
+      if (nd->valid > 0) {
+        *data = nd->data;
+        ret = 0;
+      }
+    } else {
+      ret = nvme_dev_block_read(nd, data);
+    }
+  }
+  pthread_mutex_unlock(&m_nvme);
+
+  return ret;
+}
+
+/* Drop the snapshot of a bus, e.g. after a mux switched to another drive. */
+void
+nvme_snapshot_invalidate(const char *i2c_bus_device) {
+  int i;
+
+  if (i2c_bus_device == NULL)
+    return;
+
+  pthread_mutex_lock(&m_nvme);
+  for (i = 0; i < NVME_DEV_MAX; i++) {
+    if (!strcmp(g_dev[i].bus, i2c_bus_device)) {
+      g_dev[i].valid = 0;
+      g_dev[i].block_fails = 0;
+    }
+  }
+  pthread_mutex_unlock(&m_nvme);
+}
+
 /* Read a byte from NVMe-MI 0x6A. Need to give a bus and a byte address for reading. */
 int
 nvme_read_byte(const char *i2c_bus_device, uint8_t item, uint8_t *value) {
-  int dev;
-  int ret;
+  struct nvme_dev *nd;
   int32_t res;
   int retry = 0;
 
-  dev = open(i2c_bus_device, O_RDWR);
-  if (dev < 0) {
-    syslog(LOG_DEBUG, "%s(): open() failed", __func__);
+  pthread_mutex_lock(&m_nvme);
+  nd = nvme_dev_get(i2c_bus_device);
+  if (!nd) {
+    pthread_mutex_unlock(&m_nvme);
     return -1;
   }
 
-  ret = ioctl(dev, I2C_SLAVE, I2C_NVME_INTF_ADDR);
-  if (ret < 0) {
-    syslog(LOG_DEBUG, "%s(): ioctl() assigning i2c addr failed", __func__);
-    close(dev);
-    return -1;
-  }
-
-  res = i2c_smbus_read_byte_data(dev, item);
+  res = i2c_smbus_read_byte_data(nd->fd, item);
   retry = 0;
-  while ((retry < 5) && (res < 0)) {
+  while ((retry < NVME_MI_RETRY) && (res < 0)) {
     msleep(100);
-    res = i2c_smbus_read_byte_data(dev, item);
+    res = i2c_smbus_read_byte_data(nd->fd, item);
     if (res < 0)
       retry++;
     else
@@ -85,43 +326,36 @@ nvme_read_byte(const char *i2c_bus_device, uint8_t item, uint8_t *value) {
 
   if (res < 0) {
     syslog(LOG_DEBUG, "%s(): i2c_smbus_read_byte_data failed", __func__);
-    close(dev);
+    nvme_dev_close(nd);
+    pthread_mutex_unlock(&m_nvme);
     return -1;
   }
+  pthread_mutex_unlock(&m_nvme);
 
   *value = (uint8_t) res;
 
-  close(dev);
-
   return 0;
 }
 
 /* Read a word from NVMe-MI 0x6A. Need to give a bus and a byte address for reading. */
 int
 nvme_read_word(const char *i2c_bus_device, uint8_t item, uint16_t *value) {
-  int dev;
-  int ret;
+  struct nvme_dev *nd;
   int32_t res;
   int retry = 0;
 
-  dev = open(i2c_bus_device, O_RDWR);
-  if (dev < 0) {
-    syslog(LOG_DEBUG, "%s(): open() failed", __func__);
-    return -1;
-  }
-
-  ret = ioctl(dev, I2C_SLAVE, I2C_NVME_INTF_ADDR);
-  if (ret < 0) {
-    syslog(LOG_DEBUG, "%s(): ioctl() assigning i2c addr failed", __func__);
-    close(dev);
+  pthread_mutex_lock(&m_nvme);
+  nd = nvme_dev_get(i2c_bus_device);
+  if (!nd) {
+    pthread_mutex_unlock(&m_nvme);
     return -1;
   }
 
-  res = i2c_smbus_read_word_data(dev, item);
+  res = i2c_smbus_read_word_data(nd->fd, item);
   retry = 0;
-  while ((retry < 5) && (res < 0)) {
+  while ((retry < NVME_MI_RETRY) && (res < 0)) {
     msleep(100);
-    res = i2c_smbus_read_word_data(dev, item);
+    res = i2c_smbus_read_word_data(nd->fd, item);
     if (res < 0)
       retry++;
     else
@@ -130,22 +364,28 @@ nvme_read_word(const char *i2c_bus_device, uint8_t item, uint16_t *value) {
 
   if (res < 0) {
     syslog(LOG_DEBUG, "%s(): i2c_smbus_read_byte_data failed", __func__);
-    close(dev);
+    nvme_dev_close(nd);
+    pthread_mutex_unlock(&m_nvme);
     return -1;
   }
+  pthread_mutex_unlock(&m_nvme);
 
   *value = (uint16_t) res;
 
-  close(dev);
-
   return 0;
 }
 
 /* Read NVMe-MI Status Flags. Need to give a bus for reading. */
 int
 nvme_sflgs_read(const char *i2c_bus_device, uint8_t *value) {
+  ssd_data ssd;
   int ret;
 
+  if (!nvme_snapshot_read(i2c_bus_device, &ssd)) {
+    *value = ssd.sflgs;
+    return 0;
+  }
+
   ret = nvme_read_byte(i2c_bus_device, NVME_SFLGS_REG, value);
 
   if(ret < 0) {
@@ -159,8 +399,14 @@ nvme_sflgs_read(const char *i2c_bus_device, uint8_t *value) {
 /* Read NVMe-MI SMART Warnings. Need to give a bus for reading. */
 int
 nvme_smart_warning_read(const char *i2c_bus_device, uint8_t *value) {
+  ssd_data ssd;
   int ret;
 
+  if (!nvme_snapshot_read(i2c_bus_device, &ssd)) {
+    *value = ssd.warning;
+    return 0;
+  }
+
   ret = nvme_read_byte(i2c_bus_device, NVME_WARNING_REG, value);
 
   if(ret < 0) {
@@ -174,8 +420,14 @@ nvme_smart_warning_read(const char *i2c_bus_device, uint8_t *value) {
 /* Read NVMe-MI Composite Temperature. Need to give a bus for reading. */
 int
 nvme_temp_read(const char *i2c_bus_device, uint8_t *value) {
+  ssd_data ssd;
   int ret;
 
+  if (!nvme_snapshot_read(i2c_bus_device, &ssd)) {
+    *value = ssd.temp;
+    return 0;
+  }
+
   ret = nvme_read_byte(i2c_bus_device, NVME_TEMP_REG, value);
 
   if(ret < 0) {
@@ -189,8 +441,14 @@ nvme_temp_read(const char *i2c_bus_device, uint8_t *value) {
 /* Read NVMe-MI Percentage Drive Life Used. Need to give a bus for reading. */
 int
 nvme_pdlu_read(const char *i2c_bus_device, uint8_t *value) {
+  ssd_data ssd;
   int ret;
 
+  if (!nvme_snapshot_read(i2c_bus_device, &ssd)) {
+    *value = ssd.pdlu;
+    return 0;
+  }
+
   ret = nvme_read_byte(i2c_bus_device, NVME_PDLU_REG, value);
 
   if(ret < 0) {
@@ -204,8 +462,14 @@ nvme_pdlu_read(const char *i2c_bus_device, uint8_t *value) {
 /* Read NVMe-MI Vendor ID. Need to give a bus for reading. */
 int
 nvme_vendor_read(const char *i2c_bus_device, uint16_t *value) {
+  ssd_data ssd;
   int ret;
 
+  if (!nvme_snapshot_read(i2c_bus_device, &ssd)) {
+    *value = ssd.vendor;
+    return 0;
+  }
+
   ret = nvme_read_word(i2c_bus_device, NVME_VENDOR_REG, value);
 
   if(ret < 0) {
@@ -221,6 +485,7 @@ nvme_vendor_read(const char *i2c_bus_device, uint16_t *value) {
 /* Read NVMe-MI Serial Number. Need to give a bus for reading. */
 int
 nvme_serial_num_read(const char *i2c_bus_device, uint8_t *value, int size) {
+  ssd_data ssd;
   int ret;
   uint8_t reg = NVME_SERIAL_NUM_REG;
   int count;
@@ -230,6 +495,11 @@ nvme_serial_num_read(const char *i2c_bus_device, uint8_t *value, int size) {
     return -1;
   }
 
+  if (!nvme_snapshot_read(i2c_bus_device, &ssd)) {
+    memcpy(value, ssd.serial_num, SERIAL_NUM_SIZE);
+    return 0;
+  }
+
   for(count = 0; count < SERIAL_NUM_SIZE; count++) {
     ret = nvme_read_byte(i2c_bus_device, reg + count, value + count);
     if(ret < 0) {
@@ -53,6 +53,15 @@ t_key_value_pair media_status;
 t_key_value_pair backup_device;
 } t_smart_warning; 
 
+/*
+ * Read the whole basic management data structure in one block transaction
+ * and check its PEC. nvme_snapshot_read() returns the last one while it is
+ * less than a second old, and the per-field reads below go through it.
+ */
+int nvme_block_read(const char *i2c_bus, ssd_data *data);
+int nvme_snapshot_read(const char *i2c_bus, ssd_data *data);
+void nvme_snapshot_invalidate(const char *i2c_bus);
+
 int nvme_read_byte(const char *i2c_bus, uint8_t item, uint8_t *value);
 int nvme_read_word(const char *i2c_bus, uint8_t item, uint16_t *value);
 int nvme_sflgs_read(const char *i2c_bus, uint8_t *value);
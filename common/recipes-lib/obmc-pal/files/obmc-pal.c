@@ -211,6 +211,12 @@ pal_set_server_power(uint8_t slot_id, uint8_t cmd)
   return PAL_EOK;
 }
 
+int __attribute__((weak))
+pal_wdt_pre_timeout(uint8_t slot_id, uint8_t pre_action)
+{
+  return PAL_ENOTSUP;
+}
+
 int __attribute__((weak))
 pal_sled_cycle(void)
 {
@@ -241,6 +247,12 @@ pal_set_hb_led(uint8_t status)
   return PAL_EOK;
 }
 
+int __attribute__((weak))
+pal_get_fp_gpios(uint8_t input, int *gpios, int *cnt)
+{
+  return PAL_ENOTSUP;
+}
+
 int __attribute__((weak))
 pal_get_fru_list(char *list)
 {
@@ -313,6 +325,12 @@ pal_sensor_read_raw(uint8_t fru, uint8_t sensor_num, void *value)
   return PAL_EOK;
 }
 
+int __attribute__((weak))
+pal_sensor_sweep(uint8_t fru, pal_sensor_sweep_cb cb, void *arg)
+{
+  return PAL_ENOTSUP;
+}
+
 int __attribute__((weak))
 pal_sensor_threshold_flag(uint8_t fru, uint8_t snr_num, uint16_t *flag)
 {
@@ -32,6 +32,17 @@ enum {
   /* non system errors start from -256 downwards */
 };
 
+/* Front panel inputs front-paneld can wait on */
+enum {
+  FP_INPUT_DBG_CARD_PRSNT = 0,
+  FP_INPUT_PWR_BTN,
+  FP_INPUT_RST_BTN,
+  FP_INPUT_HAND_SW,
+  FP_INPUT_MAX,
+};
+
+#define FP_MAX_GPIOS  4
+
 //TODO remove it when
 //fw-util FW Updating Flag File
 
@@ -75,11 +86,14 @@ int pal_get_num_slots(uint8_t *num);
 int pal_is_fru_prsnt(uint8_t fru, uint8_t *status);
 int pal_get_server_power(uint8_t slot_id, uint8_t *status);
 int pal_set_server_power(uint8_t slot_id, uint8_t cmd);
+/* Raise the IPMI watchdog pre-timeout interrupt: 1 SMI, 2 NMI, 3 messaging */
+int pal_wdt_pre_timeout(uint8_t slot_id, uint8_t pre_action);
 int pal_sled_cycle(void);
 int pal_post_handle(uint8_t slot, uint8_t status);
 int pal_set_rst_btn(uint8_t slot, uint8_t status);
 int pal_set_led(uint8_t led, uint8_t status);
 int pal_set_hb_led(uint8_t status);
+int pal_get_fp_gpios(uint8_t input, int *gpios, int *cnt);
 int pal_get_fru_list(char *list);
 int pal_get_fru_id(char *fru_str, uint8_t *fru);
 int pal_get_fru_name(uint8_t fru, char *name);
@@ -92,6 +106,10 @@ int pal_fruid_write(uint8_t slot, char *path);
 int pal_get_fru_devtty(uint8_t fru, char *devtty);
 int pal_sensor_read(uint8_t fru, uint8_t sensor_num, void *value);
 int pal_sensor_read_raw(uint8_t fru, uint8_t sensor_num, void *value);
+/* Called by pal_sensor_sweep() with each sensor; ret > 0 if it was not due */
+typedef void (*pal_sensor_sweep_cb)(uint8_t fru, uint8_t sensor_num, int ret,
+    float value, void *arg);
+int pal_sensor_sweep(uint8_t fru, pal_sensor_sweep_cb cb, void *arg);
 int pal_sensor_threshold_flag(uint8_t fru, uint8_t snr_num, uint16_t *flag);
 int pal_get_sensor_name(uint8_t fru, uint8_t sensor_num, char *name);
 int pal_get_sensor_units(uint8_t fru, uint8_t sensor_num, char *units);
@@ -0,0 +1,227 @@
+/*
+ * Copyright 2017-present Facebook. All Rights Reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syslog.h>
+#include <openbmc/edb.h>
+#include "obmc-pal.h"
+#include "pal-sensor.h"
+
+static const pal_snr_table_t *g_sort_tbl;
+
+static int
+desc_cmp(const void *a, const void *b)
+{
+  const pal_snr_desc_t *da = &g_sort_tbl->desc[*(const uint16_t *)a];
+  const pal_snr_desc_t *db = &g_sort_tbl->desc[*(const uint16_t *)b];
+
+  if (da->fru != db->fru)
+    return da->fru - db->fru;
+  if (da->bus_type != db->bus_type)
+    return da->bus_type - db->bus_type;
+  if (da->bus != db->bus)
+    return da->bus - db->bus;
+  if (da->addr != db->addr)
+    return da->addr - db->addr;
+  return da->num - db->num;
+}
+
+int
+pal_snr_table_init(pal_snr_table_t *tbl)
+{
+  static pthread_mutex_t sort_lock = PTHREAD_MUTEX_INITIALIZER;
+  char fruname[32];
+  const pal_snr_desc_t *d;
+  int i, ret = 0;
+
+  if (tbl->ready)
+    return 0;
+
+  pthread_mutex_lock(&tbl->lock);
+  if (tbl->ready)
+    goto exit;
+
+  tbl->order = calloc(tbl->cnt, sizeof(uint16_t));
+  tbl->keys = calloc(tbl->cnt, sizeof(*tbl->keys));
+  tbl->last = calloc(tbl->cnt, sizeof(time_t));
+  if (!tbl->order || !tbl->keys || !tbl->last) {
+    ret = -1;
+    goto error_exit;
+  }
+
+  memset(tbl->index, 0, sizeof(tbl->index));
+  tbl->valid = 0;
+  for (i = 0; i < tbl->cnt; i++) {
+    d = &tbl->desc[i];
+    if (d->fru >= PAL_SNR_MAX_FRU || tbl->index[d->fru][d->num]) {
+      syslog(LOG_WARNING, "%s: bad or duplicate sensor fru %d num 0x%x",
+             __func__, d->fru, d->num);
+      continue;
+    }
+    if (pal_get_fru_name(d->fru, fruname))
+      continue;
+    snprintf(tbl->keys[i], sizeof(tbl->keys[i]), "%s_sensor%d", fruname, d->num);
+    tbl->index[d->fru][d->num] = i + 1;
+    tbl->order[tbl->valid++] = i;
+  }
+
+  pthread_mutex_lock(&sort_lock);
+  g_sort_tbl = tbl;
+  qsort(tbl->order, tbl->valid, sizeof(uint16_t), desc_cmp);
+  pthread_mutex_unlock(&sort_lock);
+
+  tbl->ready = 1;
+  goto exit;
+
+error_exit:
+  free(tbl->order);
+  free(tbl->keys);
+  free(tbl->last);
+  tbl->order = NULL;
+  tbl->keys = NULL;
+  tbl->last = NULL;
+exit:
+  pthread_mutex_unlock(&tbl->lock);
+  return ret;
+}
+
+const pal_snr_desc_t *
+pal_snr_lookup(pal_snr_table_t *tbl, uint8_t fru, uint8_t num)
+{
+  uint16_t idx;
+
+  if (fru >= PAL_SNR_MAX_FRU || pal_snr_table_init(tbl))
+    return NULL;
+
+  idx = tbl->index[fru][num];
+  return idx ? &tbl->desc[idx - 1] : NULL;
+}
+
+static int
+snr_cache_write(pal_snr_table_t *tbl, const pal_snr_desc_t *d, int ret, float value)
+{
+  char str[MAX_VALUE_LEN];
+
+  if (ret > 0)
+    return ret;
+
+  if (ret)
+    strcpy(str, "NA");
+  else
+    snprintf(str, sizeof(str), "%.2f", value);
+
+  if (edb_cache_set(tbl->keys[d - tbl->desc], str) < 0) {
+#ifdef DEBUG
+    syslog(LOG_WARNING, "%s: cache_set key = %s, str = %s failed.", __func__,
+           tbl->keys[d - tbl->desc], str);
+#endif
+    return -1;
+  }
+  return ret;
+}
+
+static int
+snr_read_gated(const pal_snr_desc_t *d, uint8_t pwr, float *value)
+{
+  if (!(d->gate & SNR_GATE(pwr)))
+    return PAL_SNR_NA;
+  if (d->present && !d->present())
+    return PAL_SNR_NA;
+
+  return d->read(d, pwr, value);
+}
+
+/* Read and convert d, again if power changed under it; *pwr follows the state */
+static int
+snr_read_stable(pal_snr_table_t *tbl, const pal_snr_desc_t *d, uint8_t *pwr,
+                float *value)
+{
+  uint8_t now;
+  int ret, retry = 1;
+
+  for (;;) {
+    ret = snr_read_gated(d, *pwr, value);
+    if (!ret && d->conv)
+      d->conv(d, value);
+    if (!tbl->power_state || retry-- <= 0)
+      break;
+    /* Power changed while reading, so the result may be stale or NA */
+    now = tbl->power_state(d->fru);
+    if (now == *pwr)
+      break;
+    *pwr = now;
+  }
+  return ret;
+}
+
+int
+pal_snr_read(pal_snr_table_t *tbl, uint8_t fru, uint8_t num, float *value)
+{
+  const pal_snr_desc_t *d;
+  uint8_t pwr = SNR_PWR_ON;
+  int ret;
+
+  d = pal_snr_lookup(tbl, fru, num);
+  if (!d || !d->read)
+    return PAL_SNR_UNKNOWN;
+
+  if (tbl->power_state)
+    pwr = tbl->power_state(fru);
+  ret = snr_read_stable(tbl, d, &pwr, value);
+
+  return snr_cache_write(tbl, d, ret, *value);
+}
+
+int
+pal_snr_sweep(pal_snr_table_t *tbl, uint8_t fru, pal_sensor_sweep_cb cb, void *arg)
+{
+  const pal_snr_desc_t *d;
+  uint8_t pwr = SNR_PWR_ON;
+  time_t now = time(NULL);
+  float value;
+  int i, ret, cnt = 0;
+
+  if (pal_snr_table_init(tbl))
+    return -1;
+
+  if (tbl->power_state)
+    pwr = tbl->power_state(fru);
+
+  for (i = 0; i < tbl->valid; i++) {
+    d = &tbl->desc[tbl->order[i]];
+    if (d->fru != fru || !d->read)
+      continue;
+    if (d->poll && (now - tbl->last[tbl->order[i]]) < d->poll) {
+      /* Not due, the cached value stands */
+      if (cb)
+        cb(d->fru, d->num, 1, 0, arg);
+      continue;
+    }
+
+    value = 0;
+    ret = snr_read_stable(tbl, d, &pwr, &value);
+    ret = snr_cache_write(tbl, d, ret, value);
+    tbl->last[tbl->order[i]] = now;
+    if (cb)
+      cb(d->fru, d->num, ret, value, arg);
+    cnt++;
+  }
+
+  return cnt;
+}
@@ -0,0 +1,135 @@
+/*
+ * Copyright 2017-present Facebook. All Rights Reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+#ifndef __PAL_SENSOR_H__
+#define __PAL_SENSOR_H__
+
+#include <stdint.h>
+#include <pthread.h>
+#include <time.h>
+#include "obmc-pal.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Table-driven sensor access for platform PALs.
+ *
+ * A platform describes each sensor once with a pal_snr_desc_t and hands the
+ * array to a pal_snr_table_t. pal_snr_read() then replaces the per-platform
+ * switch in pal_sensor_read_raw(), and pal_snr_sweep() reads a whole FRU in
+ * bus/device order for pal_sensor_sweep().
+ */
+
+#define PAL_SNR_MAX_FRU   8
+#define PAL_SNR_MAX_NUM   256
+
+/* Read return codes, besides 0 on success */
+#define PAL_SNR_NA        -2  /* cached as "NA" */
+#define PAL_SNR_UNKNOWN   -1  /* no such sensor, cache untouched */
+/* Any positive return from a read function keeps the previous cache value */
+
+/* Bus the sensor is read over, used to group reads during a sweep */
+enum {
+  SNR_BUS_NONE = 0,   /* GPIO, postcode or otherwise computed */
+  SNR_BUS_SYSFS,      /* hwmon attribute */
+  SNR_BUS_ADC,
+  SNR_BUS_I2C,
+  SNR_BUS_IPMB,       /* proxied through ME or BIC */
+  SNR_BUS_PECI,
+  SNR_BUS_MAX,
+};
+
+/* Server power states, as reported by the table power_state() callback */
+enum {
+  SNR_PWR_OFF = 0,
+  SNR_PWR_SETTLING,   /* server on, rails not yet stable */
+  SNR_PWR_ON,
+};
+
+/* Power gating: mask of the power states a sensor may be read in */
+#define SNR_GATE(state)     (1 << (state))
+#define SNR_GATE_STBY       (SNR_GATE(SNR_PWR_OFF) | SNR_GATE(SNR_PWR_SETTLING) | \
+                             SNR_GATE(SNR_PWR_ON))
+#define SNR_GATE_SERVER_ON  (SNR_GATE(SNR_PWR_SETTLING) | SNR_GATE(SNR_PWR_ON))
+#define SNR_GATE_SETTLED    SNR_GATE(SNR_PWR_ON)
+
+typedef struct pal_snr_desc pal_snr_desc_t;
+
+/* Reads one sensor. pwr is the power state the gate was checked against. */
+typedef int (*pal_snr_read_t)(const pal_snr_desc_t *desc, uint8_t pwr, float *value);
+/* Optional post-read conversion (correction tables, unit scaling) */
+typedef void (*pal_snr_conv_t)(const pal_snr_desc_t *desc, float *value);
+
+struct pal_snr_desc {
+  uint8_t fru;
+  uint8_t num;
+  uint8_t bus_type;       /* SNR_BUS_* */
+  uint8_t bus;            /* bus number within bus_type */
+  uint8_t addr;           /* device on that bus */
+  uint8_t gate;           /* SNR_GATE_* */
+  uint16_t poll;          /* seconds between sweep reads, 0 for every sweep */
+  const char *dev;        /* device path or attribute, read function specific */
+  int arg;                /* read function specific (ADC pin, VR page, ...) */
+  pal_snr_read_t read;
+  pal_snr_conv_t conv;
+  int (*present)(void);   /* optional, sensor is NA when this returns 0 */
+};
+
+typedef struct {
+  const pal_snr_desc_t *desc;
+  int cnt;
+  int (*power_state)(uint8_t fru);
+
+  /* Built lazily by pal_snr_table_init() */
+  pthread_mutex_t lock;
+  int ready;
+  uint16_t index[PAL_SNR_MAX_FRU][PAL_SNR_MAX_NUM];  /* desc index + 1 */
+  uint16_t *order;        /* valid desc indices sorted by fru, bus and device */
+  int valid;              /* entries in order */
+  char (*keys)[64];       /* edb cache keys, "<fru>_sensor<num>" */
+  time_t *last;           /* last sweep read of each sensor */
+} pal_snr_table_t;
+
+#define PAL_SNR_TABLE(_desc, _power_state) {            \
+  .desc = (_desc),                                      \
+  .cnt = sizeof(_desc) / sizeof((_desc)[0]),            \
+  .power_state = (_power_state),                        \
+  .lock = PTHREAD_MUTEX_INITIALIZER,                    \
+}
+
+int pal_snr_table_init(pal_snr_table_t *tbl);
+const pal_snr_desc_t *pal_snr_lookup(pal_snr_table_t *tbl, uint8_t fru, uint8_t num);
+
+/* Read one sensor and update the cache, drop-in for pal_sensor_read_raw() */
+int pal_snr_read(pal_snr_table_t *tbl, uint8_t fru, uint8_t num, float *value);
+
+/*
+ * Read every sensor of fru that is due, grouped by bus and device. Power
+ * state is sampled once for the whole sweep. cb, if given, is called with
+ * each result, and with a positive ret for sensors not yet due. Returns the
+ * number of sensors read.
+ */
+int pal_snr_sweep(pal_snr_table_t *tbl, uint8_t fru, pal_sensor_sweep_cb cb,
+    void *arg);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
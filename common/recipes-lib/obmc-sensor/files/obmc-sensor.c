@@ -30,6 +30,9 @@
 #include <fcntl.h>
 #include <sys/mman.h>
 #include <errno.h>
+#include <limits.h>
+#include <sched.h>
+#include <stddef.h>
 #include <openbmc/pal.h>
 #include <openbmc/edb.h>
 #include "obmc-sensor.h"
@@ -40,18 +43,71 @@
 #define DEBUG_STR(...)
 #endif
 
-#define MAX_DATA_NUM    2000
+/*
+ * Per-sensor history in shared memory, one object per sensor key.
+ *
+ * Samples go to a raw ring and are folded into 1-minute and 1-hour rollup
+ * tiers as they arrive. Each tier is a struct of arrays appended in time
+ * order, so a query is a binary search for the start of the range followed
+ * by min/max/sum over contiguous floats.
+ *
+ * Writers serialize on flock(LOCK_EX) and bump seq around every update
+ * (odd while writing). Readers run lock-free and retry if seq moved,
+ * falling back to flock(LOCK_SH) if a writer keeps them from finishing.
+ */
+#define HIST_MAGIC      0x54534948  /* "HIST" */
+#define HIST_RAW_NUM    1024
+#define HIST_MIN_NUM    360         /* 6 hours of 1-minute buckets */
+#define HIST_HOUR_NUM   168         /* 7 days of 1-hour buckets */
+#define HIST_RETRY      8
 
 typedef struct {
-  long log_time;
-  float value;
-} sensor_data_t;
+  uint32_t head;                    /* samples ever written */
+  int32_t time[HIST_RAW_NUM];
+  float value[HIST_RAW_NUM];
+} hist_raw_t;
+
+#define HIST_TIER(n) struct {                                         \
+  uint32_t head;                    /* buckets ever started */        \
+  int32_t time[n];                  /* bucket start */                \
+  float min[n];                                                       \
+  float max[n];                                                       \
+  float sum[n];                                                       \
+  uint16_t cnt[n];                                                    \
+}
 
 typedef struct {
-  int index;
-  sensor_data_t data[MAX_DATA_NUM];
+  uint32_t magic;
+  uint32_t seq;
+  hist_raw_t raw;
+  HIST_TIER(HIST_MIN_NUM) min;
+  HIST_TIER(HIST_HOUR_NUM) hour;
 } sensor_shm_t;
 
+/* Common view of a rollup tier */
+typedef struct {
+  uint32_t *head;
+  int32_t *time;
+  float *min;
+  float *max;
+  float *sum;
+  uint16_t *cnt;
+  int num;
+  int period;
+} hist_tier_t;
+
+#define TIER_VIEW(shm, t, n, p) {                                     \
+  &(shm)->t.head, (shm)->t.time, (shm)->t.min, (shm)->t.max,          \
+  (shm)->t.sum, (shm)->t.cnt, (n), (p)                                \
+}
+
+typedef struct {
+  float min;
+  float max;
+  float sum;
+  uint32_t cnt;
+} hist_agg_t;
+
 static int
 sensor_key_get(uint8_t fru, uint8_t sensor_num, char *key)
 {
@@ -63,13 +119,79 @@ sensor_key_get(uint8_t fru, uint8_t sensor_num, char *key)
   return 0;
 }
 
+/*
+ * Map a history object. One that another process created but has not sized
+ * yet is sized here by writers, which hold its lock, and refused to readers,
+ * as touching past its end would raise SIGBUS.
+ */
+static sensor_shm_t *
+hist_map(int fd, int prot)
+{
+  struct stat st;
+  void *ptr;
+
+  if (fstat(fd, &st) < 0)
+    return NULL;
+  if ((size_t)st.st_size < sizeof(sensor_shm_t)) {
+    if (!(prot & PROT_WRITE)) {
+      errno = ENODATA;
+      return NULL;
+    }
+    if (ftruncate(fd, sizeof(sensor_shm_t)) < 0)
+      return NULL;
+  }
+
+  ptr = mmap(NULL, sizeof(sensor_shm_t), prot, MAP_SHARED, fd, 0);
+  if (ptr == MAP_FAILED)
+    return NULL;
+  return (sensor_shm_t *)ptr;
+}
+
+static void
+hist_write_begin(sensor_shm_t *shm)
+{
+  /* Force odd even if a previous writer died mid-update */
+  __atomic_store_n(&shm->seq, shm->seq | 1, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+static void
+hist_write_end(sensor_shm_t *shm)
+{
+  __atomic_store_n(&shm->seq, shm->seq + 1, __ATOMIC_RELEASE);
+}
+
+static void
+hist_tier_add(hist_tier_t *t, int32_t now, float value)
+{
+  int32_t start = now - (now % t->period);
+  uint32_t i;
+
+  i = (*t->head - 1) % t->num;
+  if (*t->head && t->time[i] == start && t->cnt[i] < UINT16_MAX) {
+    if (value < t->min[i])
+      t->min[i] = value;
+    if (value > t->max[i])
+      t->max[i] = value;
+    t->sum[i] += value;
+    t->cnt[i]++;
+    return;
+  }
+
+  i = *t->head % t->num;
+  t->time[i] = start;
+  t->min[i] = t->max[i] = t->sum[i] = value;
+  t->cnt[i] = 1;
+  (*t->head)++;
+}
+
 static int
 cache_set_history(char *key, float value) {
 
   int fd;
-  int share_size = sizeof(sensor_shm_t);
-  void *ptr;
-  sensor_shm_t *snr_shm;
+  int32_t now, last;
+  sensor_shm_t *shm;
+  uint32_t i;
   int ret = ERR_FAILURE;
 
   fd = shm_open(key, O_CREAT | O_RDWR, S_IRUSR | S_IWUSR);
@@ -83,20 +205,44 @@ cache_set_history(char *key, float value) {
     goto close_bail;
   }
 
-  ftruncate(fd, share_size);
-
-  ptr = mmap(NULL, share_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
-  if (ptr == MAP_FAILED) {
+  shm = hist_map(fd, PROT_READ | PROT_WRITE);
+  if (!shm) {
     syslog(LOG_INFO, "cache_set_history: mmap %s failed, errno = %d", key, errno);
     goto unlock_bail;
   }
 
-  snr_shm = (sensor_shm_t *)ptr;
-  snr_shm->data[snr_shm->index].log_time = time(NULL);
-  snr_shm->data[snr_shm->index].value = value;
-  snr_shm->index = (snr_shm->index + 1) % MAX_DATA_NUM;
+  hist_write_begin(shm);
+  if (shm->magic != HIST_MAGIC) {
+    /* New object, or one left by an older layout */
+    memset(&shm->raw, 0, sizeof(sensor_shm_t) - offsetof(sensor_shm_t, raw));
+    shm->magic = HIST_MAGIC;
+  }
+
+  now = time(NULL);
+  if (shm->raw.head) {
+    last = shm->raw.time[(shm->raw.head - 1) % HIST_RAW_NUM];
+    /* Rings must stay in time order: ride out small steps back, restart on big ones */
+    if (last - now > 60)
+      memset(&shm->raw, 0, sizeof(sensor_shm_t) - offsetof(sensor_shm_t, raw));
+    else if (now < last)
+      now = last;
+  }
+
+  i = shm->raw.head % HIST_RAW_NUM;
+  shm->raw.time[i] = now;
+  shm->raw.value[i] = value;
+  shm->raw.head++;
+
+  {
+    hist_tier_t min = TIER_VIEW(shm, min, HIST_MIN_NUM, 60);
+    hist_tier_t hour = TIER_VIEW(shm, hour, HIST_HOUR_NUM, 3600);
 
-  if (munmap(ptr, share_size) != 0) {
+    hist_tier_add(&min, now, value);
+    hist_tier_add(&hour, now, value);
+  }
+  hist_write_end(shm);
+
+  if (munmap(shm, sizeof(sensor_shm_t)) != 0) {
     syslog(LOG_INFO, "cache_set_history: munmap %s failed, errno = %d", key, errno);
     goto unlock_bail;
   }
@@ -112,8 +258,6 @@ close_bail:
   return ret;
 }
 
-
-
 int
 sensor_cache_read(uint8_t fru, uint8_t sensor_num, float *value)
 {
@@ -147,7 +291,20 @@ sensor_cache_write(uint8_t fru, uint8_t sensor_num, bool available, float value)
     DEBUG_STR("sensor_cache_write: cache_set %s failed.\n", key);
     return ERR_FAILURE;
   }
-  cache_set_history(key, value);
+  if (available)
+    cache_set_history(key, value);
+  return 0;
+}
+
+int
+sensor_history_write(uint8_t fru, uint8_t sensor_num, float value)
+{
+  char key[MAX_KEY_LEN];
+
+  if (sensor_key_get(fru, sensor_num, key))
+    return ERR_UNKNOWN_FRU;
+  if (cache_set_history(key, value))
+    return ERR_FAILURE;
   return 0;
 }
 
@@ -161,18 +318,239 @@ int sensor_raw_read(uint8_t fru, uint8_t sensor_num, float *value)
   return ret;
 }
 
+/*
+ * Aggregation kernels. Four independent lanes keep the loops free of
+ * loop-carried dependencies so the compiler can vectorize them where the
+ * target has SIMD, and they pipeline well where it does not.
+ */
+static void
+agg_merge(hist_agg_t *agg, const float *mn, const float *mx, const float *sum,
+          uint32_t cnt)
+{
+  int j;
+
+  if (!agg->cnt) {
+    agg->min = mn[0];
+    agg->max = mx[0];
+  }
+  for (j = 0; j < 4; j++) {
+    if (mn[j] < agg->min)
+      agg->min = mn[j];
+    if (mx[j] > agg->max)
+      agg->max = mx[j];
+    agg->sum += sum[j];
+  }
+  agg->cnt += cnt;
+}
+
+static void
+agg_raw(const float *v, int n, hist_agg_t *agg)
+{
+  float mn[4], mx[4], sum[4] = {0};
+  int i, j;
+
+  if (n <= 0)
+    return;
+
+  for (j = 0; j < 4; j++)
+    mn[j] = mx[j] = v[0];
+
+  for (i = 0; i + 4 <= n; i += 4) {
+    for (j = 0; j < 4; j++) {
+      mn[j] = v[i + j] < mn[j] ? v[i + j] : mn[j];
+      mx[j] = v[i + j] > mx[j] ? v[i + j] : mx[j];
+      sum[j] += v[i + j];
+    }
+  }
+  for (; i < n; i++) {
+    mn[0] = v[i] < mn[0] ? v[i] : mn[0];
+    mx[0] = v[i] > mx[0] ? v[i] : mx[0];
+    sum[0] += v[i];
+  }
+
+  agg_merge(agg, mn, mx, sum, n);
+}
+
+static void
+agg_tier(const float *tmin, const float *tmax, const float *tsum,
+         const uint16_t *tcnt, int n, hist_agg_t *agg)
+{
+  float mn[4], mx[4], sum[4] = {0};
+  uint32_t cnt[4] = {0};
+  int i, j;
+
+  if (n <= 0)
+    return;
+
+  for (j = 0; j < 4; j++) {
+    mn[j] = tmin[0];
+    mx[j] = tmax[0];
+  }
+
+  for (i = 0; i + 4 <= n; i += 4) {
+    for (j = 0; j < 4; j++) {
+      mn[j] = tmin[i + j] < mn[j] ? tmin[i + j] : mn[j];
+      mx[j] = tmax[i + j] > mx[j] ? tmax[i + j] : mx[j];
+      sum[j] += tsum[i + j];
+      cnt[j] += tcnt[i + j];
+    }
+  }
+  for (; i < n; i++) {
+    mn[0] = tmin[i] < mn[0] ? tmin[i] : mn[0];
+    mx[0] = tmax[i] > mx[0] ? tmax[i] : mx[0];
+    sum[0] += tsum[i];
+    cnt[0] += tcnt[i];
+  }
+
+  agg_merge(agg, mn, mx, sum, cnt[0] + cnt[1] + cnt[2] + cnt[3]);
+}
+
+/* Logical index range [*first, *last) of a ring whose times fall in [lo, hi) */
+static void
+ring_range(const int32_t *time, uint32_t head, int num, int32_t lo, int32_t hi,
+           uint32_t *first, uint32_t *last)
+{
+  uint32_t oldest = head > num ? head - num : 0;
+  uint32_t l, r, m;
+
+  /* lower bound of lo */
+  for (l = oldest, r = head; l < r; ) {
+    m = l + (r - l) / 2;
+    if (time[m % num] < lo)
+      l = m + 1;
+    else
+      r = m;
+  }
+  *first = l;
+
+  /* lower bound of hi */
+  for (r = head; l < r; ) {
+    m = l + (r - l) / 2;
+    if (time[m % num] < hi)
+      l = m + 1;
+    else
+      r = m;
+  }
+  *last = l;
+}
+
+/*
+ * Split the logical range [first, last) of a ring into at most two runs
+ * of physical indices. Returns the number of runs.
+ */
+static int
+ring_runs(uint32_t first, uint32_t last, int num, int off[2], int len[2])
+{
+  int runs = 0, n;
+
+  while (first < last && runs < 2) {
+    n = num - first % num;
+    if (n > last - first)
+      n = last - first;
+    off[runs] = first % num;
+    len[runs++] = n;
+    first += n;
+  }
+  return runs;
+}
+
+static void
+hist_tier_agg(const hist_tier_t *t, int32_t lo, int32_t hi, hist_agg_t *agg)
+{
+  uint32_t first, last;
+  int off[2], len[2], i, runs;
+
+  ring_range(t->time, *t->head, t->num, lo, hi, &first, &last);
+  runs = ring_runs(first, last, t->num, off, len);
+  for (i = 0; i < runs; i++)
+    agg_tier(&t->min[off[i]], &t->max[off[i]], &t->sum[off[i]],
+             &t->cnt[off[i]], len[i], agg);
+}
+
+/* Oldest time a ring fully covers, INT32_MIN until it has wrapped */
+static int32_t
+ring_coverage(const int32_t *time, uint32_t head, int num)
+{
+  if (head <= num)
+    return INT32_MIN;
+  return time[head % num];
+}
+
+static int32_t
+align_down(int32_t t, int g)
+{
+  return t - (((t % g) + g) % g);
+}
+
+static void
+hist_raw_agg(hist_raw_t *raw, int32_t lo, int32_t hi, hist_agg_t *agg)
+{
+  uint32_t first, last;
+  int off[2], len[2], i, runs;
+
+  ring_range(raw->time, raw->head, HIST_RAW_NUM, lo, hi, &first, &last);
+  runs = ring_runs(first, last, HIST_RAW_NUM, off, len);
+  for (i = 0; i < runs; i++)
+    agg_raw(&raw->value[off[i]], len[i], agg);
+}
+
+/*
+ * Aggregate everything since start. The raw ring answers the recent part,
+ * older parts come from the next tier that reaches further back. Each
+ * tier is cut at the bucket boundary of the tier that takes over, so no
+ * sample is counted twice; the oldest bucket is included whole.
+ */
+static void
+hist_query(sensor_shm_t *shm, int32_t start, int32_t now, hist_agg_t *agg)
+{
+  hist_tier_t tier[3] = {
+    { .head = &shm->raw.head, .time = shm->raw.time, .num = HIST_RAW_NUM, .period = 1 },
+    TIER_VIEW(shm, min, HIST_MIN_NUM, 60),
+    TIER_VIEW(shm, hour, HIST_HOUR_NUM, 3600),
+  };
+  int32_t cover[3], lo, hi = now + 1;
+  int i, j;
+
+  memset(agg, 0, sizeof(*agg));
+  for (i = 0; i < 3; i++)
+    cover[i] = ring_coverage(tier[i].time, *tier[i].head, tier[i].num);
+
+  for (i = 0; i < 3; i = j) {
+    /* Next tier that reaches further back than this one */
+    for (j = i + 1; j < 3 && cover[j] >= cover[i]; j++)
+      ;
+
+    if (cover[i] <= start || j == 3) {
+      lo = align_down(start, tier[i].period);
+      if (lo < cover[i])
+        lo = cover[i];
+    } else {
+      lo = align_down(cover[i], tier[j].period) + tier[j].period;
+      if (lo > hi)
+        lo = align_down(hi, tier[j].period);
+    }
+
+    if (i == 0)
+      hist_raw_agg(&shm->raw, lo, hi, agg);
+    else
+      hist_tier_agg(&tier[i], lo, hi, agg);
+
+    if (cover[i] <= start || j == 3)
+      break;
+    hi = lo;
+  }
+}
+
 int
 sensor_read_history(uint8_t fru, uint8_t sensor_num, float *min, float *average, float *max, int start_time)
 {
   char key[MAX_KEY_LEN] = {0};
   int fd;
-  int share_size = sizeof(sensor_shm_t);
-  void *ptr;
-  sensor_shm_t *snr_shm;
-  int16_t read_index;
-  uint16_t count = 0;
-  float read_val;
-  double total = 0;
+  sensor_shm_t *shm;
+  hist_agg_t agg;
+  uint32_t seq;
+  int32_t now = time(NULL);
+  int retry;
   int ret = ERR_FAILURE;
 
   if (sensor_key_get(fru, sensor_num, key))
@@ -184,63 +562,54 @@ sensor_read_history(uint8_t fru, uint8_t sensor_num, float *min, float *average,
     return ERR_FAILURE;
   }
 
-  if (flock(fd, LOCK_EX) < 0) {
-    syslog(LOG_INFO, "%s: file-lock %s failed errno = %d\n", __FUNCTION__, key, errno);
-    goto close_bail;
-  }
-
-  ptr = mmap(NULL, share_size, PROT_READ, MAP_SHARED, fd, 0);
-  if (ptr == MAP_FAILED) {
+  shm = hist_map(fd, PROT_READ);
+  if (!shm) {
     syslog(LOG_INFO, "cache_get_history: mmap %s failed, errno = %d", key, errno);
-    goto unlock_bail;
+    goto close_bail;
   }
 
-  snr_shm = (sensor_shm_t *)ptr;
-  read_index = snr_shm->index - 1;
-  if (read_index < 0) {
-    read_index += MAX_DATA_NUM;
+  for (retry = 0; retry < HIST_RETRY; retry++) {
+    seq = __atomic_load_n(&shm->seq, __ATOMIC_ACQUIRE);
+    if (seq & 1) {
+      sched_yield();
+      continue;
+    }
+    hist_query(shm, start_time, now, &agg);
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    if (__atomic_load_n(&shm->seq, __ATOMIC_RELAXED) == seq)
+      break;
   }
 
-  read_val = snr_shm->data[read_index].value;
-  *min = read_val;
-  *max = read_val;
-
-  while ((snr_shm->data[read_index].log_time >= start_time) && (count < MAX_DATA_NUM)) {
-    read_val = snr_shm->data[read_index].value;
-    if (read_val > *max)
-      *max = read_val;
-    if (read_val < *min)
-      *min = read_val;
-
-    total += read_val;
-    count++;
-    if ((--read_index) < 0) {
-      read_index += MAX_DATA_NUM;
+  if (retry == HIST_RETRY) {
+    /* Writers kept getting in the way, wait for them instead */
+    if (flock(fd, LOCK_SH) < 0) {
+      syslog(LOG_INFO, "%s: file-lock %s failed errno = %d\n", __FUNCTION__, key, errno);
+      goto unmap_bail;
     }
+    hist_query(shm, start_time, now, &agg);
+    flock(fd, LOCK_UN);
   }
 
-  if (munmap(ptr, share_size) != 0) {
-    syslog(LOG_INFO, "cache_get_history: munmap %s failed, errno = %d", key, errno);
-    goto unlock_bail;
-  }
+  if (shm->magic != HIST_MAGIC)
+    agg.cnt = 0;
 
   /* If none found in history, just return the cached value */
-  if (!count) {
+  if (!agg.cnt) {
     float read_value;
     ret = sensor_cache_read(fru, sensor_num, &read_value);
     if (ret)
-      return ret;
-    total = *min = *max = read_val;
-    count = 1;
+      goto unmap_bail;
+    agg.sum = agg.min = agg.max = read_value;
+    agg.cnt = 1;
   }
 
-  *average = total / count;
+  *min = agg.min;
+  *max = agg.max;
+  *average = agg.sum / agg.cnt;
   ret = 0;
-unlock_bail:
-  if (flock(fd, LOCK_UN) < 0) {
-    syslog(LOG_INFO, "%s: file-unlock %s failed errno = %d\n", __FUNCTION__, key, errno);
-    ret = -1;
-  }
+
+unmap_bail:
+  munmap(shm, sizeof(sensor_shm_t));
 close_bail:
   close(fd);
   return ret;
@@ -266,15 +635,16 @@ int sensor_clear_history(uint8_t fru, uint8_t sensor_num)
     goto close_bail;
   }
 
-  ftruncate(fd, share_size);
-
-  snr_shm = (sensor_shm_t *)mmap(NULL, share_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
-  if (snr_shm == MAP_FAILED) {
+  snr_shm = hist_map(fd, PROT_READ | PROT_WRITE);
+  if (!snr_shm) {
     syslog(LOG_INFO, "cache_set_history: mmap %s failed, errno = %d", key, errno);
     goto unlock_bail;
   }
 
-  memset(snr_shm, 0, share_size);
+  hist_write_begin(snr_shm);
+  memset(&snr_shm->raw, 0, share_size - offsetof(sensor_shm_t, raw));
+  snr_shm->magic = HIST_MAGIC;
+  hist_write_end(snr_shm);
   if (munmap(snr_shm, share_size) != 0) {
     syslog(LOG_INFO, "cache_set_history: munmap %s failed, errno = %d", key, errno);
     goto unlock_bail;
@@ -38,13 +38,18 @@ extern "C" {
 /* Read a cached value of the given sensor */
 int sensor_cache_read(uint8_t fru, uint8_t sensor_num, float *value);
 
-/* Read the sensor history */
+/* Read the sensor history since start_time. Older parts of long periods
+ * come from 1-minute and 1-hour rollups, so the oldest bucket counts whole. */
 int sensor_read_history(uint8_t fru, uint8_t sensor_num, float *min,
                float *average, float *max, int start_time);
 
 /* Clear the sensor history */
 int sensor_clear_history(uint8_t fru, uint8_t sensor_num);
 
+/* Add a value read outside sensor_raw_read(), such as by a PAL sweep that
+ * already cached it, to the sensor history */
+int sensor_history_write(uint8_t fru, uint8_t sensor_num, float value);
+
 /* Read sensor directly from the hardware. Note, this function does not
  * protect the caller from other readers. The caller should ensure 
  * exclusivity. The simplest method being limiting all calls to this
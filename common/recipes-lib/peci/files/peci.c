@@ -0,0 +1,203 @@
+/*
+ * Copyright 2017-present Facebook. All Rights Reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <syslog.h>
+#include <time.h>
+#include <sys/ioctl.h>
+#include "peci.h"
+
+struct xfer_msg {
+  uint8_t client_addr;
+  uint8_t tx_len;
+  uint8_t rx_len;
+  uint8_t tx_fcs;
+  uint8_t rx_fcs;
+  uint8_t fcs_en;
+  uint8_t sw_fcs;
+  uint8_t *tx_buf;
+  uint8_t *rx_buf;
+  uint32_t sts;
+};
+
+#define PECI_DEVICE "/dev/ast-peci"
+
+//IOCTL ..
+#define PECIIOC_BASE 'P'
+
+#define AST_PECI_IOCXFER _IOWR(PECIIOC_BASE, 2, struct xfer_msg*)
+
+#define PECI_INT_CMD_DONE    (0x1)
+
+/* Byte 1 of these commands is the host ID, with the retry bit in bit 0 */
+#define PECI_RETRY_BIT       0x01
+
+#define PECI_RETRY_MIN_US    1000
+
+/* Per command code, about how long the CPU took to have the data ready */
+static uint32_t ready_us[256];
+
+static uint32_t
+elapsed_us(const struct timespec *start) {
+  struct timespec now;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (now.tv_sec - start->tv_sec) * 1000000 +
+         (now.tv_nsec - start->tv_nsec) / 1000;
+}
+
+static int
+has_retry_bit(uint8_t code) {
+  switch (code) {
+    case 0x61: // RdPCIConfig
+    case 0x65: // WrPCIConfig
+    case 0xA1: // RdPkgConfig
+    case 0xA5: // WrPkgConfig
+    case 0xB1: // RdIAMSR
+    case 0xB5: // WrIAMSR
+    case 0xC1: // RdEndPointConfig
+    case 0xC5: // WrEndPointConfig
+    case 0xE1: // RdPCIConfigLocal
+    case 0xE5: // WrPCIConfigLocal
+      return 1;
+    default:
+      return 0;
+  }
+}
+
+int
+peci_open(void) {
+  int fd;
+  int timeout = 5;
+
+  while ((fd = open(PECI_DEVICE, O_RDWR)) < 0) {
+    if (timeout-- < 0) {
+      syslog(LOG_WARNING, "peci_open: failed to open %s", PECI_DEVICE);
+      return -1;
+    }
+    usleep(10*1000);
+  }
+  return fd;
+}
+
+void
+peci_close(int fd) {
+  if (fd >= 0)
+    close(fd);
+}
+
+int
+peci_parse_cmd(int argc, char **argv, peci_cmd_t *cmd) {
+  int i = 0;
+
+  if (argc < 3)
+    return -1;
+
+  memset(cmd, 0, sizeof(*cmd));
+  cmd->addr = (uint8_t)strtoul(argv[i++], NULL, 0);
+  cmd->tx_len = (uint8_t)strtoul(argv[i++], NULL, 0);
+  cmd->rx_len = (uint8_t)strtoul(argv[i++], NULL, 0);
+  if (argc - i != cmd->tx_len || cmd->tx_len > PECI_MAX_LEN ||
+      cmd->rx_len > PECI_MAX_LEN)
+    return -1;
+
+  while (i < argc) {
+    cmd->tx[i - 3] = (uint8_t)strtoul(argv[i], NULL, 0);
+    i++;
+  }
+  return 0;
+}
+
+int
+peci_xfer(int fd, const peci_cmd_t *cmd, const peci_retry_t *retry,
+          peci_result_t *res) {
+  struct xfer_msg msg;
+  struct timespec start;
+  uint8_t tbuf[PECI_MAX_LEN];
+  uint8_t code = cmd->tx_len ? cmd->tx[0] : 0;
+  uint32_t budget_us = 0, max_us = 0, waited_us = 0, delay_us;
+
+  memset(res, 0, sizeof(*res));
+  memcpy(tbuf, cmd->tx, cmd->tx_len);
+
+  memset(&msg, 0, sizeof(msg));
+  msg.client_addr = cmd->addr;
+  msg.tx_len = cmd->tx_len;
+  msg.rx_len = cmd->rx_len;
+  msg.fcs_en = cmd->awfcs;
+  msg.tx_buf = tbuf;
+  msg.rx_buf = res->rx;
+
+  if (retry && retry->retries > 0 && cmd->rx_len) {
+    max_us = retry->interval_ms * 1000;
+    budget_us = retry->retries * max_us;
+  }
+  delay_us = ready_us[code];
+  if (delay_us < PECI_RETRY_MIN_US)
+    delay_us = PECI_RETRY_MIN_US;
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for (;;) {
+    msg.sts = 0;
+    if (ioctl(fd, AST_PECI_IOCXFER, &msg) < 0 ||
+        msg.sts != PECI_INT_CMD_DONE) {
+      res->status = -1;
+      break;
+    }
+
+    if ((res->rx[0] != PECI_CC_TIMEOUT && res->rx[0] != PECI_CC_NO_RES) ||
+        waited_us >= budget_us)
+      break;
+
+    if (delay_us > max_us)
+      delay_us = max_us;
+    if (delay_us > budget_us - waited_us)
+      delay_us = budget_us - waited_us;
+    usleep(delay_us);
+    waited_us += delay_us;
+    delay_us *= 2;
+    res->retries++;
+
+    if (has_retry_bit(code))
+      tbuf[1] |= PECI_RETRY_BIT;
+  }
+  res->sts = msg.sts;
+  res->us = elapsed_us(&start);
+
+  // Remember the wait that got the data for the next command of the kind
+  if (!res->status && res->rx[0] == PECI_CC_PASSED)
+    ready_us[code] = (ready_us[code] * 3 + waited_us) / 4;
+
+  return res->status;
+}
+
+int
+peci_batch(int fd, const peci_cmd_t *cmds, int n,
+           const peci_retry_t *retry, peci_result_t *res) {
+  int i, failed = 0;
+
+  for (i = 0; i < n; i++) {
+    if (peci_xfer(fd, &cmds[i], retry, &res[i]))
+      failed++;
+  }
+  return failed;
+}
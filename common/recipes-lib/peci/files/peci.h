@@ -0,0 +1,103 @@
+/*
+ * Copyright 2017-present Facebook. All Rights Reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+#ifndef __PECI_H__
+#define __PECI_H__
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * PECI transactions through the AST PECI controller, one command at a
+ * time as the controller does them, retried while the CPU answers "data
+ * not ready". Platforms that mux PECI, see pal_before_peci(), select it
+ * before peci_open().
+ */
+
+#define PECI_MAX_LEN      32
+
+/* Completion codes */
+#define PECI_CC_PASSED    0x40
+#define PECI_CC_TIMEOUT   0x80  /* data not ready */
+#define PECI_CC_NO_RES    0x81  /* not able to allocate resource */
+
+typedef struct {
+  int retries;          /* give up after retries * interval_ms of waiting */
+  int interval_ms;      /* longest wait between two attempts */
+} peci_retry_t;
+
+typedef struct {
+  uint8_t addr;         /* 0x30 CPU0, 0x31 CPU1 */
+  uint8_t tx_len;
+  uint8_t rx_len;
+  uint8_t awfcs;        /* let the controller add the AW FCS */
+  uint8_t tx[PECI_MAX_LEN];
+} peci_cmd_t;
+
+typedef struct {
+  int status;           /* 0, or -1 if the transfer failed */
+  uint32_t sts;         /* controller status of the last attempt */
+  uint8_t retries;
+  uint32_t us;          /* time taken, retries included */
+  uint8_t rx[PECI_MAX_LEN];
+} peci_result_t;
+
+/*
+ * Record per command in the binary output of peci-util, followed by the
+ * tx_len bytes sent and the rx_len bytes received.
+ */
+typedef struct __attribute__((packed)) {
+  uint8_t addr;
+  uint8_t tx_len;
+  uint8_t rx_len;
+  uint8_t status;       /* 0, or 1 if the transfer failed */
+  uint8_t retries;
+  uint8_t reserved;
+  uint16_t ms;          /* time taken, little endian */
+} peci_record_t;
+
+int peci_open(void);
+void peci_close(int fd);
+
+/*
+ * Parse "<addr> <tx length> <rx length> <tx bytes...>" from argv, as
+ * peci-util takes them. Returns -1 if they don't add up.
+ */
+int peci_parse_cmd(int argc, char **argv, peci_cmd_t *cmd);
+
+/*
+ * Run one command. While the completion code says the CPU isn't ready,
+ * and retry allows, send it again with the retry bit set, after a wait
+ * that starts from what the last commands of the same kind needed and
+ * doubles up to retry->interval_ms. retry may be NULL for one attempt.
+ * Returns res->status.
+ */
+int peci_xfer(int fd, const peci_cmd_t *cmd, const peci_retry_t *retry,
+              peci_result_t *res);
+
+/* Run n commands back to back; returns how many failed */
+int peci_batch(int fd, const peci_cmd_t *cmds, int n,
+               const peci_retry_t *retry, peci_result_t *res);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __PECI_H__ */
@@ -0,0 +1,100 @@
+#!/usr/bin/env python
+#
+# Copyright 2015-present Facebook. All Rights Reserved.
+#
+# This program file is free software; you can redistribute it and/or modify it
+# under the terms of the GNU General Public License as published by the
+# Free Software Foundation; version 2 of the License.
+#
+# This program is distributed in the hope that it will be useful, but WITHOUT
+# ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+# FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+# for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program in a file named COPYING; if not, write to the
+# Free Software Foundation, Inc.,
+# 51 Franklin Street, Fifth Floor,
+# Boston, MA 02110-1301 USA
+#
+
+from ctypes import *
+from node import node
+import time
+
+levbus_hndl = CDLL("libevbus.so")
+
+EVBUS_DATA_LEN = 8
+EVBUS_MSG_LEN = 256
+
+# Record types, see <openbmc/evbus.h>
+EVBUS_TYPES = {
+    1: 'cri_sel',
+    2: 'gpio',
+    3: 'sensor',
+}
+
+class evbus_rec_t(Structure):
+    _fields_ = [
+        ('seq', c_uint),
+        ('time', c_uint),
+        ('type', c_ushort),
+        ('fru', c_ubyte),
+        ('severity', c_ubyte),
+        ('data', c_ubyte * EVBUS_DATA_LEN),
+        ('msg', c_char * EVBUS_MSG_LEN),
+    ]
+
+class eventsNode(node):
+    def __init__(self, fru, info = None, actions = None):
+        self.fru = fru
+
+        if info == None:
+            self.info = {}
+        else:
+            self.info = info
+        if actions == None:
+            self.actions = []
+        else:
+            self.actions = actions
+
+    # Records newer than cursor for this FRU, and the cursor to read on from
+    def readEvents(self, cursor):
+        recs = (evbus_rec_t * 64)()
+        cur = c_uint(cursor)
+        events = []
+        while True:
+            n = levbus_hndl.evbus_read(byref(cur), recs, 64)
+            if n <= 0:
+                break
+            for rec in recs[:n]:
+                if self.fru != None and rec.fru != self.fru:
+                    continue
+                events.append({
+                    "SEQ": rec.seq,
+                    "TIME_STAMP": time.strftime('%Y-%m-%d %H:%M:%S', time.localtime(rec.time)),
+                    "TYPE": EVBUS_TYPES.get(rec.type, str(rec.type)),
+                    "SEVERITY": rec.severity,
+                    "MESSAGE": rec.msg,
+                })
+
+        return { "Events": events, "Cursor": cur.value }
+
+    def getInformation(self):
+        return self.readEvents(0)
+
+    # { "action": "read", "cursor": N } pages on from a previous read
+    def doAction(self, data):
+        if data["action"] != "read":
+            return { "result": 'failure' }
+
+        try:
+            cursor = int(data.get("cursor", 0))
+        except ValueError:
+            return { "result": 'failure' }
+
+        return self.readEvents(cursor)
+
+def get_node_events(fru = None):
+    actions = [ "read" ]
+    return eventsNode(fru, actions = actions)
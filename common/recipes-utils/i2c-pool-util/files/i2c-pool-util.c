@@ -0,0 +1,92 @@
+/*
+ * Copyright 2017-present Facebook. All Rights Reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <openbmc/i2c-pool.h>
+
+static void
+print_usage_help(void) {
+  printf("Usage: i2c-pool-util --stats [bus]\n");
+  printf("       i2c-pool-util --clear\n");
+}
+
+// Upper bound of the histogram bucket holding the given percentile, or the
+// maximum if that is lower
+static uint32_t
+hist_percentile(const i2c_bus_stats_t *st, int pct) {
+  uint64_t seen = 0, target = ((uint64_t)st->xfers * pct + 99) / 100;
+  int i;
+
+  for (i = 0; i < I2C_POOL_HIST_BUCKETS - 1; i++) {
+    seen += st->hist[i];
+    if (seen >= target)
+      break;
+  }
+  if (i < I2C_POOL_HIST_BUCKETS - 1 &&
+      (I2C_POOL_HIST_BASE_US << i) < st->max_us) {
+    return I2C_POOL_HIST_BASE_US << i;
+  }
+  return st->max_us;
+}
+
+static int
+print_stats(int only) {
+  i2c_bus_stats_t st;
+  uint64_t total_us;
+  int bus;
+
+  printf("Bus %10s %8s %8s %8s %6s %8s %8s %8s %8s %8s %9s\n", "Xfers",
+         "Errors", "Retries", "GiveUps", "Opens", "LockWait", "Wait(ms)",
+         "Avg(us)", "P50(us)", "P99(us)", "Max(us)");
+  for (bus = 0; bus < I2C_POOL_MAX_BUS; bus++) {
+    if (only >= 0 && bus != only)
+      continue;
+    if (i2c_pool_get_stats(bus, &st)) {
+      printf("i2c pool stats not available\n");
+      return -1;
+    }
+    if (!st.xfers && only < 0)
+      continue;
+
+    total_us = ((uint64_t)st.total_us_hi << 32) | st.total_us_lo;
+    printf("%3d %10u %8u %8u %8u %6u %8u %8u %8llu %8u %8u %9u\n", bus,
+           st.xfers, st.errors, st.retries, st.giveups, st.opens,
+           st.lock_waits, st.lock_wait_ms,
+           (unsigned long long)(st.xfers ? total_us / st.xfers : 0),
+           hist_percentile(&st, 50), hist_percentile(&st, 99), st.max_us);
+  }
+
+  return 0;
+}
+
+int
+main(int argc, char **argv) {
+  if (argc >= 2 && !strcmp(argv[1], "--stats")) {
+    return print_stats(argc > 2 ? atoi(argv[2]) : -1);
+  }
+
+  if (argc == 2 && !strcmp(argv[1], "--clear")) {
+    return i2c_pool_clear_stats();
+  }
+
+  print_usage_help();
+  return -1;
+}
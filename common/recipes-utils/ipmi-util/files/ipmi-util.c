@@ -29,12 +29,569 @@
 #include <fcntl.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
+#include <time.h>
 #include <errno.h>
+#include <stddef.h>
+#include <sys/socket.h>
+#include <sys/un.h>
 #include <openbmc/ipmi.h>
+#include <openbmc/ipmb.h>
+
+#define MAX_REPLAY_CMDS 128
+
+typedef struct {
+  uint8_t netfn;
+  uint8_t cmd;
+  uint32_t count;
+  uint32_t fails;
+  uint64_t total_us;
+  uint64_t min_us;
+  uint64_t max_us;
+} replay_stat_t;
+
+/*
+ * Requests --trace-replay resends by default. They only read state; the
+ * reservations are in as Get SDR and Get SEL Entry need them. Anything
+ * else could power the server off, write FRU or SEL, or flash firmware,
+ * so it is skipped unless --unsafe is given.
+ */
+static const struct {
+  uint8_t netfn;
+  uint8_t cmd;
+} replay_safe[] = {
+  { NETFN_CHASSIS_REQ, CMD_CHASSIS_GET_STATUS },
+  { NETFN_CHASSIS_REQ, CMD_CHASSIS_GET_BOOT_OPTIONS },
+  { NETFN_SENSOR_REQ, CMD_SENSOR_GET_SENSOR_READING },
+  { NETFN_APP_REQ, CMD_APP_GET_DEVICE_ID },
+  { NETFN_APP_REQ, CMD_APP_GET_SELFTEST_RESULTS },
+  { NETFN_APP_REQ, CMD_APP_GET_DEVICE_GUID },
+  { NETFN_APP_REQ, CMD_APP_GET_WDT },
+  { NETFN_APP_REQ, CMD_APP_GET_GLOBAL_ENABLES },
+  { NETFN_APP_REQ, CMD_APP_GET_SYSTEM_GUID },
+  { NETFN_APP_REQ, CMD_APP_GET_SYS_INFO_PARAMS },
+  { NETFN_STORAGE_REQ, CMD_STORAGE_GET_FRUID_INFO },
+  { NETFN_STORAGE_REQ, CMD_STORAGE_READ_FRUID_DATA },
+  { NETFN_STORAGE_REQ, CMD_STORAGE_GET_SDR_INFO },
+  { NETFN_STORAGE_REQ, CMD_STORAGE_RSV_SDR },
+  { NETFN_STORAGE_REQ, CMD_STORAGE_GET_SDR },
+  { NETFN_STORAGE_REQ, CMD_STORAGE_GET_SEL_INFO },
+  { NETFN_STORAGE_REQ, CMD_STORAGE_RSV_SEL },
+  { NETFN_STORAGE_REQ, CMD_STORAGE_GET_SEL },
+  { NETFN_STORAGE_REQ, CMD_STORAGE_GET_SEL_TIME },
+  { NETFN_STORAGE_REQ, CMD_STORAGE_GET_SEL_UTC },
+  { NETFN_TRANSPORT_REQ, CMD_TRANSPORT_GET_LAN_CONFIG },
+  { NETFN_TRANSPORT_REQ, CMD_TRANSPORT_GET_SOL_CONFIG },
+  { NETFN_NM_REQ, CMD_NM_GET_CPU_MEM_TEMP },
+};
 
 static void
 print_usage_help(void) {
   printf("Usage: ipmi-util <node#> <[0..n]data_bytes_to_send>\n");
+  printf("       ipmi-util --stats\n");
+  printf("       ipmi-util --replay <trace_file> [iterations]\n");
+  printf("         trace_file: one request per line, in the same form as\n");
+  printf("         the arguments above; lines starting with # are skipped\n");
+  printf("       ipmi-util --trace <ipmid|ipmbd_N> <on|off>\n");
+  printf("       ipmi-util --trace-dump <ipmid|ipmbd_N|trace_file>\n");
+  printf("       ipmi-util --trace-replay <ipmid|ipmbd_N|trace_file> [speed]\n");
+  printf("                 [--unsafe] [--to <socket>]\n");
+  printf("         resend the traced requests to the daemon they went to,\n");
+  printf("         or to the one at socket, speed times as fast as they\n");
+  printf("         came in; 0 for back to back. Only requests that read\n");
+  printf("         state are sent, unless --unsafe is given\n");
+}
+
+static uint64_t
+now_us(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+// Upper bound of the histogram bucket holding the given percentile, or the
+// maximum if that is lower
+static uint32_t
+hist_percentile(const ipmi_cmd_stats_t *st, int pct) {
+  uint64_t seen = 0, target = ((uint64_t)st->count * pct + 99) / 100;
+  int i;
+
+  for (i = 0; i < IPMI_STATS_HIST_BUCKETS - 1; i++) {
+    seen += st->hist[i];
+    if (seen >= target)
+      break;
+  }
+  if (i < IPMI_STATS_HIST_BUCKETS - 1 &&
+      (IPMI_STATS_HIST_BASE_US << i) < st->max_us) {
+    return IPMI_STATS_HIST_BASE_US << i;
+  }
+  return st->max_us;
+}
+
+static int
+print_stats(void) {
+  ipmi_stats_t *shm, *stats;
+  ipmi_cmd_stats_t *st;
+  uint32_t seq;
+  int fd, i, tries;
+
+  fd = shm_open(IPMI_STATS_SHM, O_RDONLY, 0);
+  if (fd < 0) {
+    printf("ipmid stats not available, errno %d\n", errno);
+    return -1;
+  }
+  shm = mmap(NULL, sizeof(ipmi_stats_t), PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (shm == MAP_FAILED) {
+    printf("mmap failed, errno %d\n", errno);
+    return -1;
+  }
+
+  stats = malloc(sizeof(ipmi_stats_t));
+  if (!stats) {
+    munmap(shm, sizeof(ipmi_stats_t));
+    return -1;
+  }
+
+  // Retry while ipmid is in the middle of an update
+  for (tries = 0; tries < 100; tries++) {
+    seq = shm->seq;
+    __sync_synchronize();
+    memcpy(stats, shm, sizeof(ipmi_stats_t));
+    __sync_synchronize();
+    if (!(seq & 1) && seq == shm->seq)
+      break;
+    usleep(1000);
+  }
+  munmap(shm, sizeof(ipmi_stats_t));
+
+  if (stats->magic != IPMI_STATS_MAGIC || stats->version != IPMI_STATS_VERSION) {
+    printf("unknown ipmid stats format\n");
+    free(stats);
+    return -1;
+  }
+
+  printf("NetFn Cmd  %-24s %10s %8s %8s %8s %8s %8s\n", "Name", "Count",
+         "Errors", "Avg(us)", "P50(us)", "P99(us)", "Max(us)");
+  for (i = 0; i < stats->num_cmds && i < IPMI_STATS_MAX_CMDS; i++) {
+    st = &stats->cmd[i];
+    if (!st->count)
+      continue;
+    printf("0x%02X  0x%02X %-24s %10u %8u %8llu %8u %8u %8u\n",
+           st->netfn, st->cmd, st->name[0] ? st->name : "-", st->count,
+           st->errors, (unsigned long long)(st->total_us / st->count),
+           hist_percentile(st, 50), hist_percentile(st, 99), st->max_us);
+  }
+  printf("Requests without a handler: %u\n", stats->unknown);
+
+  free(stats);
+  return 0;
+}
+
+static void
+replay_account(replay_stat_t *stat, int *num, uint8_t netfn, uint8_t cmd,
+               uint64_t us, int fail) {
+  replay_stat_t *rs;
+  int i;
+
+  for (i = 0; i < *num; i++) {
+    if (stat[i].netfn == netfn && stat[i].cmd == cmd)
+      break;
+  }
+  if (i == *num) {
+    if (*num == MAX_REPLAY_CMDS)
+      return;
+    (*num)++;
+    stat[i].netfn = netfn;
+    stat[i].cmd = cmd;
+    stat[i].min_us = us;
+  }
+  rs = &stat[i];
+  rs->count++;
+  if (fail)
+    rs->fails++;
+  rs->total_us += us;
+  if (us < rs->min_us)
+    rs->min_us = us;
+  if (us > rs->max_us)
+    rs->max_us = us;
+}
+
+static void
+print_replay_stats(replay_stat_t *stat, int num, uint32_t total, uint64_t us) {
+  replay_stat_t *rs;
+  int i;
+
+  printf("NetFn Cmd  %10s %8s %8s %8s %8s\n", "Count", "Fails", "Min(us)",
+         "Avg(us)", "Max(us)");
+  for (i = 0; i < num; i++) {
+    rs = &stat[i];
+    printf("0x%02X  0x%02X %10u %8u %8llu %8llu %8llu\n", rs->netfn, rs->cmd,
+           rs->count, rs->fails, (unsigned long long)rs->min_us,
+           (unsigned long long)(rs->total_us / rs->count),
+           (unsigned long long)rs->max_us);
+  }
+  printf("%u requests in %llu ms", total, (unsigned long long)(us / 1000));
+  if (us)
+    printf(", %llu requests/s", (unsigned long long)total * 1000000 / us);
+  printf("\n");
+}
+
+static int
+replay_trace(const char *path, int iterations) {
+  FILE *fp;
+  char line[2048];
+  char *tok, *saveptr;
+  uint8_t tbuf[256];
+  uint8_t rbuf[256];
+  size_t tlen;
+  uint16_t rlen;
+  replay_stat_t stat[MAX_REPLAY_CMDS];
+  uint64_t start, us, begin;
+  uint32_t total = 0;
+  int num = 0, iter, lineno, c, cut;
+
+  fp = fopen(path, "r");
+  if (!fp) {
+    printf("Cannot open %s, errno %d\n", path, errno);
+    return -1;
+  }
+
+  memset(stat, 0, sizeof(stat));
+  begin = now_us();
+  for (iter = 0; iter < iterations; iter++) {
+    rewind(fp);
+    lineno = 0;
+    while (fgets(line, sizeof(line), fp)) {
+      lineno++;
+      // Whatever of a line fgets() could not take is dropped with it
+      cut = !strchr(line, '\n') && !feof(fp);
+      while (cut && (c = fgetc(fp)) != EOF && c != '\n')
+        ;
+      tlen = 0;
+      for (tok = strtok_r(line, " \t\r\n", &saveptr);
+           tok && tok[0] != '#';
+           tok = strtok_r(NULL, " \t\r\n", &saveptr)) {
+        // lib_ipmi_handle() takes at most 255 bytes
+        if (tlen < sizeof(tbuf) - 1)
+          tbuf[tlen] = (uint8_t)strtoul(tok, NULL, 0);
+        tlen++;
+      }
+      if (cut || tlen >= sizeof(tbuf)) {
+        if (iter == 0)
+          printf("Line %d of %s is longer than a request can be, skipped\n",
+                 lineno, path);
+        continue;
+      }
+      // node#, NetFn and Cmd at least
+      if (tlen < 3)
+        continue;
+
+      rlen = 0;
+      start = now_us();
+      lib_ipmi_handle(tbuf, tlen, rbuf, &rlen);
+      us = now_us() - start;
+      total++;
+
+      // No response, or a completion code other than success
+      replay_account(stat, &num, tbuf[1] >> 2, tbuf[2], us,
+                     rlen < IPMI_RESP_HDR_SIZE || rbuf[2] != CC_SUCCESS);
+    }
+  }
+  us = now_us() - begin;
+  fclose(fp);
+
+  print_replay_stats(stat, num, total, us);
+
+  return 0;
+}
+
+static int
+trace_open_file(const char *name, int flags, char *path, size_t len) {
+  // A name of a daemon, or a file a trace was copied to
+  if (strchr(name, '/'))
+    snprintf(path, len, "%s", name);
+  else
+    snprintf(path, len, IPMI_TRACE_PATH, name);
+  return open(path, flags);
+}
+
+static int
+trace_set(const char *name, const char *onoff) {
+  ipmi_trace_hdr_t *hdr;
+  char path[64];
+  int fd;
+
+  if (strcmp(onoff, "on") && strcmp(onoff, "off")) {
+    print_usage_help();
+    return -1;
+  }
+
+  fd = trace_open_file(name, O_RDWR, path, sizeof(path));
+  if (fd < 0) {
+    printf("Cannot open %s, errno %d\n", path, errno);
+    return -1;
+  }
+  hdr = mmap(NULL, sizeof(*hdr), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (hdr == MAP_FAILED) {
+    printf("mmap failed, errno %d\n", errno);
+    return -1;
+  }
+  if (hdr->magic != IPMI_TRACE_MAGIC || hdr->version != IPMI_TRACE_VERSION) {
+    printf("unknown trace format in %s\n", path);
+    munmap(hdr, sizeof(*hdr));
+    return -1;
+  }
+
+  hdr->enabled = !strcmp(onoff, "on");
+  printf("%s: tracing %s, %u requests, %u dropped\n", path, onoff,
+         hdr->count, hdr->dropped);
+  munmap(hdr, sizeof(*hdr));
+  return 0;
+}
+
+// Copy of the trace ring, taken while no record was being added
+static ipmi_trace_hdr_t *
+trace_load(const char *name) {
+  ipmi_trace_hdr_t *shm, *hdr = NULL;
+  struct stat st;
+  char path[64];
+  uint32_t seq;
+  int fd, tries;
+
+  fd = trace_open_file(name, O_RDONLY, path, sizeof(path));
+  if (fd < 0) {
+    printf("Cannot open %s, errno %d\n", path, errno);
+    return NULL;
+  }
+  if (fstat(fd, &st) || st.st_size < sizeof(*hdr)) {
+    printf("%s is not a trace\n", path);
+    close(fd);
+    return NULL;
+  }
+  shm = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (shm == MAP_FAILED) {
+    printf("mmap failed, errno %d\n", errno);
+    return NULL;
+  }
+
+  if (shm->magic != IPMI_TRACE_MAGIC || shm->version != IPMI_TRACE_VERSION ||
+      sizeof(*hdr) + shm->size > st.st_size) {
+    printf("unknown trace format in %s\n", path);
+    goto out;
+  }
+
+  hdr = malloc(st.st_size);
+  if (!hdr)
+    goto out;
+
+  // Retry while the daemon is in the middle of an update
+  for (tries = 0; tries < 100; tries++) {
+    seq = shm->seq;
+    __sync_synchronize();
+    memcpy(hdr, shm, st.st_size);
+    __sync_synchronize();
+    if (!(seq & 1) && seq == shm->seq)
+      break;
+    usleep(1000);
+  }
+
+out:
+  munmap(shm, st.st_size);
+  return hdr;
+}
+
+// Record at *pos, oldest first from hdr->tail; NULL if the ring is broken
+static ipmi_trace_rec_t *
+trace_next(ipmi_trace_hdr_t *hdr, uint32_t *pos) {
+  uint8_t *ring = (uint8_t *)(hdr + 1);
+  ipmi_trace_rec_t *rec;
+
+  if (*pos + sizeof(*rec) > hdr->size ||
+      ((ipmi_trace_rec_t *)(ring + *pos))->size == 0)
+    *pos = 0;
+  rec = (ipmi_trace_rec_t *)(ring + *pos);
+  if (rec->size < sizeof(*rec) + rec->req_len + rec->res_len ||
+      *pos + rec->size > hdr->size)
+    return NULL;
+  *pos += rec->size;
+  return rec;
+}
+
+static int
+trace_dump(const char *name) {
+  ipmi_trace_hdr_t *hdr;
+  ipmi_trace_rec_t *rec;
+  uint8_t *data;
+  uint64_t first = 0;
+  uint32_t pos, i, j;
+
+  if (!(hdr = trace_load(name)))
+    return -1;
+
+  printf("# %s: %u requests, %u dropped\n", hdr->sock, hdr->count,
+         hdr->dropped);
+  pos = hdr->tail;
+  for (i = 0; i < hdr->count; i++) {
+    if (!(rec = trace_next(hdr, &pos)))
+      break;
+    if (i == 0)
+      first = rec->ts_us;
+    data = (uint8_t *)(rec + 1);
+    printf("%llu.%06llu %6uus req:",
+           (unsigned long long)((rec->ts_us - first) / 1000000),
+           (unsigned long long)((rec->ts_us - first) % 1000000), rec->lat_us);
+    for (j = 0; j < rec->req_len; j++)
+      printf(" %02X", data[j]);
+    printf(" res:");
+    for (j = 0; j < rec->res_len; j++)
+      printf(" %02X", data[rec->req_len + j]);
+    printf("\n");
+  }
+
+  free(hdr);
+  return 0;
+}
+
+// One request to the daemon at sock; length of the response or -1
+static int
+trace_xfer(const char *sock, uint8_t *req, uint16_t req_len,
+           uint8_t *res, uint16_t res_size) {
+  struct sockaddr_un remote;
+  struct timeval tv;
+  int s, len, n = -1;
+
+  if ((s = socket(AF_UNIX, SOCK_STREAM, 0)) < 0)
+    return -1;
+
+  tv.tv_sec = TIMEOUT_IPMB + 1;
+  tv.tv_usec = 0;
+  setsockopt(s, SOL_SOCKET, SO_RCVTIMEO, (char *)&tv, sizeof(tv));
+
+  remote.sun_family = AF_UNIX;
+  snprintf(remote.sun_path, sizeof(remote.sun_path), "%s", sock);
+  len = strlen(remote.sun_path) + sizeof(remote.sun_family);
+  if (!connect(s, (struct sockaddr *)&remote, len) &&
+      send(s, req, req_len, 0) == req_len) {
+    n = recv(s, res, res_size, 0);
+  }
+  close(s);
+  return n;
+}
+
+static int
+cmp_u32(const void *a, const void *b) {
+  uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+
+  return (x > y) - (x < y);
+}
+
+static void
+print_percentiles(const char *what, uint32_t *lat, uint32_t n) {
+  if (!n)
+    return;
+  qsort(lat, n, sizeof(*lat), cmp_u32);
+  printf("%-8s latency(us) p50 %u, p90 %u, p99 %u, max %u\n", what,
+         lat[n / 2], lat[n * 90 / 100], lat[n * 99 / 100], lat[n - 1]);
+}
+
+static int
+replay_is_safe(uint8_t netfn, uint8_t cmd) {
+  int i;
+
+  for (i = 0; i < sizeof(replay_safe) / sizeof(replay_safe[0]); i++) {
+    if (replay_safe[i].netfn == netfn && replay_safe[i].cmd == cmd)
+      return 1;
+  }
+  return 0;
+}
+
+static int
+trace_replay(const char *name, double speed, int unsafe, const char *to) {
+  ipmi_trace_hdr_t *hdr;
+  ipmi_trace_rec_t *rec;
+  replay_stat_t stat[MAX_REPLAY_CMDS];
+  uint8_t rbuf[MAX_IPMB_RES_LEN];
+  uint8_t *req, *res;
+  uint32_t *lat, *orig;
+  uint32_t pos, i, total = 0, differ = 0, refused = 0;
+  uint64_t first = 0, begin, due, start, us;
+  int num = 0, ipmb, cmd_off, cc_off, skip, n;
+  const char *sock;
+
+  if (!(hdr = trace_load(name)))
+    return -1;
+  sock = to ? to : hdr->sock;
+
+  lat = calloc(hdr->count + 1, sizeof(*lat));
+  orig = calloc(hdr->count + 1, sizeof(*orig));
+  if (!lat || !orig) {
+    free(lat);
+    free(orig);
+    free(hdr);
+    return -1;
+  }
+
+  // IPMB frames carry addresses, a sequence number and checksums, which
+  // change from one run to the next
+  ipmb = !strncmp(hdr->sock, SOCK_PATH_IPMB, strlen(SOCK_PATH_IPMB));
+  cmd_off = ipmb ? offsetof(ipmb_req_t, cmd) : 2;
+  cc_off = ipmb ? offsetof(ipmb_res_t, cc) : 2;
+  skip = ipmb ? cc_off : 0;
+
+  memset(stat, 0, sizeof(stat));
+  pos = hdr->tail;
+  begin = now_us();
+  for (i = 0; i < hdr->count && (rec = trace_next(hdr, &pos)); i++) {
+    req = (uint8_t *)(rec + 1);
+    res = req + rec->req_len;
+    if (i == 0)
+      first = rec->ts_us;
+    if (rec->req_len <= cmd_off)
+      continue;
+    if (!unsafe && !replay_is_safe(req[1] >> 2, req[cmd_off])) {
+      refused++;
+      continue;
+    }
+
+    // Keep the gaps of the trace, speed times shorter
+    if (speed > 0) {
+      due = begin + (uint64_t)((rec->ts_us - first) / speed);
+      us = now_us();
+      if (due > us)
+        usleep(due - us);
+    }
+
+    start = now_us();
+    n = trace_xfer(sock, req, rec->req_len, rbuf, sizeof(rbuf));
+    us = now_us() - start;
+
+    lat[total] = us;
+    orig[total] = rec->lat_us;
+    total++;
+    if (n != rec->res_len || (n > skip + ipmb &&
+        memcmp(rbuf + skip, res + skip, n - skip - ipmb)))
+      differ++;
+    replay_account(stat, &num, req[1] >> 2, req[cmd_off], us,
+                   n <= cc_off || rbuf[cc_off] != CC_SUCCESS);
+  }
+  us = now_us() - begin;
+
+  print_replay_stats(stat, num, total, us);
+  print_percentiles("replay", lat, total);
+  print_percentiles("traced", orig, total);
+  printf("%u responses differ from the trace\n", differ);
+  if (refused)
+    printf("%u requests that change state skipped, --unsafe sends them\n",
+           refused);
+
+  free(lat);
+  free(orig);
+  free(hdr);
+  return 0;
 }
 
 int
@@ -45,6 +602,41 @@ main(int argc, char **argv) {
   uint16_t rlen = 0;
   int i;
 
+  if (argc == 2 && !strcmp(argv[1], "--stats")) {
+    return print_stats();
+  }
+
+  if (argc >= 3 && !strcmp(argv[1], "--replay")) {
+    return replay_trace(argv[2], argc > 3 ? atoi(argv[3]) : 1);
+  }
+
+  if (argc == 4 && !strcmp(argv[1], "--trace")) {
+    return trace_set(argv[2], argv[3]);
+  }
+
+  if (argc == 3 && !strcmp(argv[1], "--trace-dump")) {
+    return trace_dump(argv[2]);
+  }
+
+  if (argc >= 3 && !strcmp(argv[1], "--trace-replay")) {
+    double speed = 1;
+    int unsafe = 0;
+    const char *to = NULL;
+
+    for (i = 3; i < argc; i++) {
+      if (!strcmp(argv[i], "--unsafe")) {
+        unsafe = 1;
+      } else if (!strcmp(argv[i], "--to") && i + 1 < argc) {
+        to = argv[++i];
+      } else if (argv[i][0] != '-') {
+        speed = atof(argv[i]);
+      } else {
+        goto err_exit;
+      }
+    }
+    return trace_replay(argv[2], speed, unsafe, to);
+  }
+
   if (argc < 3) {
     goto err_exit;
   }
@@ -58,8 +58,11 @@
 #include <signal.h>
 #include <syslog.h>
 #include "watchdog.h"
+#include "fand_policy.h"
 #ifdef CONFIG_GALAXY100
 #include <fcntl.h>
+#include <time.h>
+#include <pthread.h>
 #include <openbmc/obmc-i2c.h>
 #endif
 
@@ -95,16 +98,8 @@
  * things up.
  */
 
-#define GALAXY100_FAN_LOW 32
-#define GALAXY100_FAN_MEDIUM 51
-#define GALAXY100_FAN_HIGH 72
-#define GALAXY100_FAN_MAX 99
+/* Speeds, raising and falling thresholds and the limit are in fand_policy.cpp */
 //#define GALAXY100_FAN_ONEFAILED_RAISE_PEC 20
-#define GALAXY100_RAISING_TEMP_LOW 31
-#define GALAXY100_RAISING_TEMP_HIGH 36
-#define GALAXY100_FALLING_TEMP_LOW 27
-#define GALAXY100_FALLING_TEMP_HIGH 33
-#define GALAXY100_SYSTEM_LIMIT 60
 
 #define GALAXY100_TEMP_I2C_BUS 1
 #define GALAXY100_FANTRAY_I2C_BUS 8
@@ -124,6 +119,10 @@
 #define GALAXY100_PSU_CHANNEL_I2C_ADDR 0x71
 #define GALAXY100_PSU_I2C_ADDR 0x10
 
+#define GALAXY100_MAX_I2C_BUS 16
+#define GALAXY100_MUX_LEVELS 3
+#define GALAXY100_SETTLE_MAX_US 11000
+
 #define FANS 4
 #define GALAXY100_LC_NUM 4
 #define GALAXY100_SCM_NUM 8
@@ -141,8 +140,9 @@ struct sensor_info {
   struct channel_info_stu channel3;
   uchar bus;
   uchar addr;
-  uchar temp;
+  int temp;
   int (*read_temp)(struct channel_info_stu, struct channel_info_stu, struct channel_info_stu, int, int);
+  uchar valid; /* temp was read by the last sweep */
 };
 struct fan_info_stu {
   uchar front_fan_reg;
@@ -181,10 +181,9 @@ static int galaxy100_i2c_read(int bus, int addr, uchar reg, int byte);
 static int galaxy100_i2c_write(int bus, int addr, uchar reg, int value, int byte);
 static int open_i2c_dev(int i2cbus, char *filename, size_t size);
 static int read_temp(struct channel_info_stu channel1, struct channel_info_stu channel2, struct channel_info_stu channel3, int bus, int addr);
+static void galaxy100_sweep_temps(void);
 static int read_critical_max_temp(void);
 static int read_alarm_max_temp(void);
-static int calculate_falling_fan_pwm(int temp);
-static int calculate_raising_fan_pwm(int temp);
 static int galaxy100_set_fan(int fan, int value);
 static int galaxy100_fan_is_okey(int fan);
 static int galaxy100_write_fan_led(int fan, const char *color);
@@ -194,6 +193,7 @@ static int galaxy100_lc_present_detect(void);
 static int galaxy100_scm_present_detect(void);
 static int galaxy100_cmm_is_master(void);
 static int galaxy100_chanel_reinit(void);
+static void galaxy100_mux_invalidate(void);
 
 
 /*CMM info*/
@@ -627,10 +627,13 @@ struct galaxy100_fan_failed_control_stu galaxy100_fan_failed_control[] = {
 
 
 
-int fan_low = GALAXY100_FAN_LOW;
-int fan_medium = GALAXY100_FAN_MEDIUM;
-int fan_high = GALAXY100_FAN_HIGH;
-int fan_max = GALAXY100_FAN_MAX;
+const struct fand_policy *policy;
+
+/* Defaults from the policy, which the options may override */
+int fan_low;
+int fan_medium;
+int fan_high;
+int fan_max;
 int total_fans = FANS;
 int fan_offset = 0;
 
@@ -642,48 +645,192 @@ bool verbose = false;
 int lc_status[GALAXY100_LC_NUM] = {0};
 int scm_status[GALAXY100_SCM_NUM] = {0};
 
-static int galaxy100_i2c_read(int bus, int addr, uchar reg, int byte)
+/*
+ * Every bus keeps its device open, with the slave address it points at
+ * and the mux path last programmed through it. The mutex serializes the
+ * sweep threads; it is recursive so that a path select and the accesses
+ * behind it can be held together.
+ */
+struct settle_stu {
+  uchar bus;
+  uchar addr;
+  int us;
+};
+struct i2c_bus_stu {
+  pthread_mutex_t lock;
+  int fd;
+  int addr;                 /* slave address of fd, -1 for none */
+  int path_valid;           /* the muxes are known to be set to path */
+  struct channel_info_stu path[GALAXY100_MUX_LEVELS];
+  struct settle_stu *settle;  /* device of the last write, until next access */
+  long long settle_until;
+};
+
+/*
+ * Time a device needs after a write before the bus is used again. Devices
+ * not listed get GALAXY100_SETTLE_MAX_US, the fixed wait everything had
+ * before. When the access that follows a write fails, the time of the
+ * written device is doubled, up to that bound.
+ */
+static struct settle_stu galaxy100_settle[] = {
+  {GALAXY100_TEMP_I2C_BUS, 0x70, 1000},
+  {GALAXY100_TEMP_I2C_BUS, 0x73, 1000},
+  {GALAXY100_TEMP_I2C_BUS, 0x75, 1000},
+  {GALAXY100_TEMP_I2C_BUS, GALAXY100_CMM_CHANNEL1_ADDR_BAKUP, 1000},
+  {GALAXY100_FANTRAY_I2C_BUS, 0x70, 1000},
+  {GALAXY100_FANTRAY_I2C_BUS, 0x75, 1000},
+  {GALAXY100_FANTRAY_I2C_BUS, GALAXY100_CMM_CHANNEL1_ADDR_BAKUP, 1000},
+  {GALAXY100_FANTRAY_I2C_BUS, GALAXY100_FANTRAY_CPLD_ADDR, 2000},
+};
+static struct settle_stu settle_default = {0xff, 0xff, GALAXY100_SETTLE_MAX_US};
+
+static pthread_once_t i2c_bus_once = PTHREAD_ONCE_INIT;
+static struct i2c_bus_stu i2c_bus[GALAXY100_MAX_I2C_BUS];
+
+static long long now_us(void)
 {
-  int res, file;
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (long long)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void i2c_bus_init(void)
+{
+  pthread_mutexattr_t attr;
+  int i;
+
+  pthread_mutexattr_init(&attr);
+  pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+  for(i = 0; i < GALAXY100_MAX_I2C_BUS; i++) {
+    pthread_mutex_init(&i2c_bus[i].lock, &attr);
+    i2c_bus[i].fd = -1;
+    i2c_bus[i].addr = -1;
+  }
+  pthread_mutexattr_destroy(&attr);
+}
+
+static struct i2c_bus_stu *galaxy100_i2c_bus(int bus)
+{
+  if(bus < 0 || bus >= GALAXY100_MAX_I2C_BUS)
+    return NULL;
+
+  pthread_once(&i2c_bus_once, i2c_bus_init);
+  return &i2c_bus[bus];
+}
+
+static struct settle_stu *galaxy100_settle_find(int bus, int addr)
+{
+  size_t i;
+
+  for(i = 0; i < sizeof(galaxy100_settle) / sizeof(galaxy100_settle[0]); i++) {
+    if(galaxy100_settle[i].bus == bus && galaxy100_settle[i].addr == addr)
+      return &galaxy100_settle[i];
+  }
+
+  return &settle_default;
+}
+
+/* Lock the bus and get its device ready for addr */
+static struct i2c_bus_stu *galaxy100_i2c_get(int bus, int addr)
+{
+  struct i2c_bus_stu *b = galaxy100_i2c_bus(bus);
   char filename[20];
+  long long wait;
+
+  if(!b)
+    return NULL;
+
+  pthread_mutex_lock(&b->lock);
+  if(b->fd < 0) {
+    b->fd = open_i2c_dev(bus, filename, sizeof(filename));
+    b->addr = -1;
+    if(b->fd < 0) {
+      pthread_mutex_unlock(&b->lock);
+      return NULL;
+    }
+  }
 
-  file = open_i2c_dev(bus, filename, sizeof(filename));
-  if(file < 0) {
-    return -1;
+  if(b->settle) {
+    wait = b->settle_until - now_us();
+    if(wait > 0)
+      usleep(wait);
   }
-  if(ioctl(file, I2C_SLAVE_FORCE, addr) < 0) {
-    return -1;
+
+  if(b->addr != addr) {
+    if(ioctl(b->fd, I2C_SLAVE_FORCE, addr) < 0) {
+      b->addr = -1;
+      pthread_mutex_unlock(&b->lock);
+      return NULL;
+    }
+    b->addr = addr;
+  }
+
+  return b;
+}
+
+/* Account for an access made after galaxy100_i2c_get() and unlock */
+static void galaxy100_i2c_put(struct i2c_bus_stu *b, int bus, int addr, int res, bool write)
+{
+  if(res < 0) {
+    if(b->settle && b->settle->us < GALAXY100_SETTLE_MAX_US) {
+      b->settle->us *= 2;
+      if(b->settle->us > GALAXY100_SETTLE_MAX_US)
+        b->settle->us = GALAXY100_SETTLE_MAX_US;
+      syslog(LOG_WARNING, "%s: settle time of 0x%x on bus %d raised to %d us",
+             __func__, b->settle->addr, bus, b->settle->us);
+    }
+    // A mux may have been reset with the device that failed
+    close(b->fd);
+    b->fd = -1;
+    b->addr = -1;
+    b->path_valid = 0;
+  }
+
+  b->settle = NULL;
+  if(res >= 0 && write) {
+    b->settle = galaxy100_settle_find(bus, addr);
+    b->settle_until = now_us() + b->settle->us;
   }
+  pthread_mutex_unlock(&b->lock);
+}
+
+static int galaxy100_i2c_read(int bus, int addr, uchar reg, int byte)
+{
+  struct i2c_bus_stu *b;
+  int res;
+
+  if(byte != 1 && byte != 2)
+    return -1;
+
+  b = galaxy100_i2c_get(bus, addr);
+  if(!b)
+    return -1;
   if(byte == 1)
-    res = i2c_smbus_read_byte_data(file, reg);
-  else if(byte == 2)
-    res = i2c_smbus_read_word_data(file, reg);
+    res = i2c_smbus_read_byte_data(b->fd, reg);
   else
-    return -1;
+    res = i2c_smbus_read_word_data(b->fd, reg);
+  galaxy100_i2c_put(b, bus, addr, res, false);
 
-  close(file);
   return res;
 }
 static int galaxy100_i2c_write(int bus, int addr, uchar reg, int value, int byte)
 {
-  int res, file;
-  char filename[20];
+  struct i2c_bus_stu *b;
+  int res;
 
-  file = open_i2c_dev(bus, filename, sizeof(filename));
-  if(file < 0) {
+  if(byte != 1 && byte != 2)
     return -1;
-  }
-  if(ioctl(file, I2C_SLAVE_FORCE, addr) < 0) {
+
+  b = galaxy100_i2c_get(bus, addr);
+  if(!b)
     return -1;
-  }
   if(byte == 1)
-    res = i2c_smbus_write_byte_data(file, reg, value);
-  else if(byte == 2)
-    res = i2c_smbus_write_word_data(file, reg, value);
+    res = i2c_smbus_write_byte_data(b->fd, reg, value);
   else
-    return -1;
+    res = i2c_smbus_write_word_data(b->fd, reg, value);
+  galaxy100_i2c_put(b, bus, addr, res, true);
 
-  close(file);
   return res;
 }
 static int open_i2c_dev(int i2cbus, char *filename, size_t size)
@@ -692,49 +839,105 @@ static int open_i2c_dev(int i2cbus, char *filename, size_t size)
 
   snprintf(filename, size, "/dev/i2c/%d", i2cbus);
   filename[size - 1] = '\0';
-  file = open(filename, O_RDWR);
+  file = open(filename, O_RDWR | O_CLOEXEC);
   if (file < 0 && (errno == ENOENT || errno == ENOTDIR)) {
     sprintf(filename, "/dev/i2c-%d", i2cbus);
-    file = open(filename, O_RDWR);
+    file = open(filename, O_RDWR | O_CLOEXEC);
   }
 
   return file;
 }
 
+static bool galaxy100_path_used(struct channel_info_stu channel1, struct channel_info_stu channel2, struct channel_info_stu channel3)
+{
+  return channel1.channel != 0xff || channel2.channel != 0xff || channel3.channel != 0xff;
+}
+
+/*
+ * Program the mux path. A level further down is only known to be set while
+ * every level above it is unchanged, as it may be a different device
+ * behind another upstream channel, so the path is rewritten from the first
+ * level that differs.
+ */
 static int galaxy100_channel_set(int bus, struct channel_info_stu  channel1, struct channel_info_stu channel2, struct channel_info_stu channel3)
 {
-  int ret;
+  struct channel_info_stu path[GALAXY100_MUX_LEVELS] = {channel1, channel2, channel3};
+  struct i2c_bus_stu *b = galaxy100_i2c_bus(bus);
+  int i, first = 0, ret;
 
-  if(channel1.channel!= 0xff) {
-    ret = galaxy100_i2c_write(bus, channel1.addr, 0x0, channel1.channel, 1);
-    if(ret < 0) {
-      syslog(LOG_ERR, "%s: failed to set channel1 0x%x on bus %d, value 0x%x",
-             __func__, channel1.addr, bus, channel1.channel);
-      return -1;
+  if(!b)
+    return -1;
+
+  pthread_mutex_lock(&b->lock);
+  if(b->path_valid) {
+    for(first = 0; first < GALAXY100_MUX_LEVELS; first++) {
+      if(b->path[first].addr != path[first].addr ||
+         b->path[first].channel != path[first].channel)
+        break;
+    }
+    if(first == GALAXY100_MUX_LEVELS) {
+      pthread_mutex_unlock(&b->lock);
+      return 0;
     }
-    usleep(11000);
   }
 
-  if(channel2.channel != 0xff) {
-    ret = galaxy100_i2c_write(bus, channel2.addr, 0x0, channel2.channel, 1);
+  b->path_valid = 0;
+  for(i = first; i < GALAXY100_MUX_LEVELS; i++) {
+    if(path[i].channel == 0xff)
+      continue;
+    ret = galaxy100_i2c_write(bus, path[i].addr, 0x0, path[i].channel, 1);
     if(ret < 0) {
-      syslog(LOG_ERR, "%s: failed to set channel2 0x%x on bus %d, value 0x%x",
-             __func__, channel2.addr, bus, channel2.channel);
+      syslog(LOG_ERR, "%s: failed to set channel%d 0x%x on bus %d, value 0x%x",
+             __func__, i + 1, path[i].addr, bus, path[i].channel);
+      pthread_mutex_unlock(&b->lock);
       return -1;
     }
-    usleep(11000);
   }
-  if(channel3.channel != 0xff) {
-    ret = galaxy100_i2c_write(bus, channel3.addr, 0x0, channel3.channel, 1);
+  memcpy(b->path, path, sizeof(path));
+  b->path_valid = 1;
+  pthread_mutex_unlock(&b->lock);
+
+  return 0;
+}
+
+/*
+ * Forget the mux paths. The muxes on the fantray bus are also switched by
+ * the kernel mux drivers for sysfs users, so a path is only trusted for
+ * the duration of one control cycle.
+ */
+static void galaxy100_mux_invalidate(void)
+{
+  struct i2c_bus_stu *b;
+  int i;
+
+  for(i = 0; i < GALAXY100_MAX_I2C_BUS; i++) {
+    b = galaxy100_i2c_bus(i);
+    pthread_mutex_lock(&b->lock);
+    b->path_valid = 0;
+    pthread_mutex_unlock(&b->lock);
+  }
+}
+
+static int read_temp_once(struct channel_info_stu  channel1, struct channel_info_stu channel2, struct channel_info_stu channel3, int bus, int addr)
+{
+  struct i2c_bus_stu *mux = NULL;
+  int ret;
+
+  // Hold the mux bus so that no other sweep moves the path before the read
+  if(galaxy100_path_used(channel1, channel2, channel3)) {
+    mux = galaxy100_i2c_bus(GALAXY100_TEMP_I2C_BUS);
+    pthread_mutex_lock(&mux->lock);
+    ret = galaxy100_channel_set(GALAXY100_TEMP_I2C_BUS, channel1, channel2, channel3);
     if(ret < 0) {
-      syslog(LOG_ERR, "%s: failed to set channel3 0x%x on bus %d, value 0x%x",
-             __func__, channel3.addr, bus, channel3.channel);
+      pthread_mutex_unlock(&mux->lock);
       return -1;
     }
-    usleep(11000);
   }
+  ret = galaxy100_i2c_read(bus, addr, 0x0, 2);
+  if(mux)
+    pthread_mutex_unlock(&mux->lock);
 
-  return 0;
+  return ret;
 }
 
 static int read_temp(struct channel_info_stu  channel1, struct channel_info_stu channel2, struct channel_info_stu channel3, int bus, int addr)
@@ -742,35 +945,143 @@ static int read_temp(struct channel_info_stu  channel1, struct channel_info_stu
   int ret;
   int value;
 
-  ret = galaxy100_channel_set(GALAXY100_TEMP_I2C_BUS, channel1, channel2, channel3);
+  // A failure drops the cached path and may have raised a settle time, so
+  // one more try goes out with the path rewritten and the longer wait
+  ret = read_temp_once(channel1, channel2, channel3, bus, addr);
   if(ret < 0)
-    return -1;
-  ret = galaxy100_i2c_read(bus, addr, 0x0, 2);
+    ret = read_temp_once(channel1, channel2, channel3, bus, addr);
   value = (ret < 0) ? ret : swab16(ret);
   if(value < 0) {
     syslog(LOG_ERR, "%s: failed to read temperature bus %d, addr 0x%x", __func__, bus, addr);
     return -1;
   }
-  usleep(11000);
 
   return ((short)value / 128) / 2;
 }
+
+/*
+ * Sensors of one sweep: those behind muxes are on the temp bus with their
+ * muxes, the others on the bus they are read from. Sweeps of different
+ * buses run in parallel.
+ */
+#define GALAXY100_SWEEP_MAX (BOARD_INFO_SIZE * 2)
+
+struct sweep_stu {
+  int bus;
+  int num;
+  struct sensor_info *sensor[GALAXY100_SWEEP_MAX];
+};
+
+static int galaxy100_sweep_bus(const struct sensor_info *sensor)
+{
+  if(galaxy100_path_used(sensor->channel1, sensor->channel2, sensor->channel3))
+    return GALAXY100_TEMP_I2C_BUS;
+  return sensor->bus;
+}
+
+/* Order by bus and mux path, so reads behind a common prefix are adjacent */
+static int galaxy100_sweep_cmp(const void *a, const void *b)
+{
+  const struct sensor_info *x = *(struct sensor_info * const *)a;
+  const struct sensor_info *y = *(struct sensor_info * const *)b;
+  const struct channel_info_stu *px[] = {&x->channel1, &x->channel2, &x->channel3};
+  const struct channel_info_stu *py[] = {&y->channel1, &y->channel2, &y->channel3};
+  int i;
+
+  if(galaxy100_sweep_bus(x) != galaxy100_sweep_bus(y))
+    return galaxy100_sweep_bus(x) - galaxy100_sweep_bus(y);
+  for(i = 0; i < GALAXY100_MUX_LEVELS; i++) {
+    if(px[i]->addr != py[i]->addr)
+      return px[i]->addr - py[i]->addr;
+    if(px[i]->channel != py[i]->channel)
+      return px[i]->channel - py[i]->channel;
+  }
+  if(x->bus != y->bus)
+    return x->bus - y->bus;
+  return x->addr - y->addr;
+}
+
+static void *galaxy100_sweep_thread(void *arg)
+{
+  struct sweep_stu *sweep = (struct sweep_stu *)arg;
+  struct sensor_info *sensor;
+  int i, temp;
+
+  for(i = 0; i < sweep->num; i++) {
+    sensor = sweep->sensor[i];
+    temp = sensor->read_temp(sensor->channel1, sensor->channel2, sensor->channel3,
+                             sensor->bus, sensor->addr);
+    sensor->valid = (temp != -1);
+    if(sensor->valid)
+      sensor->temp = temp;
+  }
+
+  return NULL;
+}
+
+static void galaxy100_sweep_temps(void)
+{
+  struct sensor_info *list[GALAXY100_SWEEP_MAX];
+  struct sweep_stu sweep[GALAXY100_SWEEP_MAX];
+  pthread_t tid[GALAXY100_SWEEP_MAX];
+  bool started[GALAXY100_SWEEP_MAX];
+  struct galaxy100_board_info_stu *info;
+  struct sensor_info *sensor[2];
+  sigset_t mask, old;
+  int i, j, k, num = 0, sweeps = 0;
+
+  for(i = 0; i < (int)BOARD_INFO_SIZE; i++) {
+    info = &galaxy100_board_info[i];
+    sensor[0] = info->critical;
+    sensor[1] = info->alarm;
+    for(j = 0; j < 2; j++) {
+      if(!sensor[j] || !sensor[j]->read_temp)
+        continue;
+      for(k = 0; k < num && list[k] != sensor[j]; k++);
+      if(k == num)
+        list[num++] = sensor[j];
+    }
+  }
+  qsort(list, num, sizeof(list[0]), galaxy100_sweep_cmp);
+
+  for(i = 0; i < num; i++) {
+    if(!sweeps || sweep[sweeps - 1].bus != galaxy100_sweep_bus(list[i])) {
+      sweep[sweeps].bus = galaxy100_sweep_bus(list[i]);
+      sweep[sweeps].num = 0;
+      sweeps++;
+    }
+    sweep[sweeps - 1].sensor[sweep[sweeps - 1].num++] = list[i];
+  }
+
+  // Signals are left to the main thread, their handler drives the fans
+  sigfillset(&mask);
+  pthread_sigmask(SIG_BLOCK, &mask, &old);
+  for(i = 1; i < sweeps; i++) {
+    started[i] = !pthread_create(&tid[i], NULL, galaxy100_sweep_thread, &sweep[i]);
+  }
+  pthread_sigmask(SIG_SETMASK, &old, NULL);
+
+  if(sweeps)
+    galaxy100_sweep_thread(&sweep[0]);
+  for(i = 1; i < sweeps; i++) {
+    if(started[i])
+      pthread_join(tid[i], NULL);
+    else
+      galaxy100_sweep_thread(&sweep[i]);
+  }
+}
+
 static int read_critical_max_temp(void)
 {
   int i;
-  int temp, max_temp = 0;
+  int max_temp = 0;
   struct galaxy100_board_info_stu *info;
 
   for(i = 0; i < BOARD_INFO_SIZE; i++) {
     info = &galaxy100_board_info[i];
-    if(info->critical) {
-      temp = read_temp(info->critical->channel1, info->critical->channel2, info->critical->channel3,
-                       info->critical->bus, info->critical->addr);
-      if(temp != -1) {
-        info->critical->temp = temp;
-        if(temp > max_temp)
-          max_temp = temp;
-      }
+    if(info->critical && info->critical->valid) {
+      if(info->critical->temp > max_temp)
+        max_temp = info->critical->temp;
     }
   }
   //printf("%s: critical: max_temp=%d\n", __func__, max_temp);
@@ -780,48 +1091,20 @@ static int read_critical_max_temp(void)
 static int read_alarm_max_temp(void)
 {
   int i;
-  int temp, max_temp = 0;
+  int max_temp = 0;
   struct galaxy100_board_info_stu *info;
 
   for(i = 0; i < BOARD_INFO_SIZE; i++) {
     info = &galaxy100_board_info[i];
-    if(info->alarm) {
-      temp = read_temp(info->alarm->channel1, info->alarm->channel2, info->alarm->channel3,
-                       info->alarm->bus, info->alarm->addr);
-      if(temp != -1) {
-        info->alarm->temp = temp;
-        if(temp > max_temp)
-          max_temp = temp;
-      }
+    if(info->alarm && info->alarm->valid) {
+      if(info->alarm->temp > max_temp)
+        max_temp = info->alarm->temp;
     }
   }
   //printf("%s: alarm: max_temp=%d\n", __func__, max_temp);
 
   return max_temp;
 }
-static int calculate_raising_fan_pwm(int temp)
-{
-  if(temp < GALAXY100_RAISING_TEMP_LOW) {
-    return GALAXY100_FAN_LOW;
-  } else if(temp >= GALAXY100_RAISING_TEMP_LOW && temp < GALAXY100_RAISING_TEMP_HIGH) {
-    return GALAXY100_FAN_MEDIUM;
-  } else  {
-    return GALAXY100_FAN_HIGH;
-  }
-  return GALAXY100_FAN_HIGH;
-}
-static int calculate_falling_fan_pwm(int temp)
-{
-  if(temp < GALAXY100_FALLING_TEMP_LOW) {
-    return GALAXY100_FAN_LOW;
-  } else if(temp >= GALAXY100_FALLING_TEMP_LOW && temp < GALAXY100_FALLING_TEMP_HIGH) {
-    return GALAXY100_FAN_MEDIUM;
-  } else  {
-    return GALAXY100_FAN_HIGH;
-  }
-
-  return GALAXY100_FAN_HIGH;
-}
 static int galaxy100_set_fan(int fan, int value)
 {
   int ret;
@@ -850,21 +1133,18 @@ static int galaxy100_set_fan(int fan, int value)
     syslog(LOG_ERR, "%s: failed to set fan1 pwm 0x%x, value 0x%x", __func__, info->fan1.pwm_reg, value);
     return -1;
   }
-  usleep(11000);
 
   ret = galaxy100_i2c_write(GALAXY100_FANTRAY_I2C_BUS, GALAXY100_FANTRAY_CPLD_ADDR, info->fan2.pwm_reg, value, 1);
   if(ret < 0) {
     syslog(LOG_ERR, "%s: failed to set fan2 pwm 0x%x, value 0x%x", __func__, info->fan2.pwm_reg, value);
     return -1;
   }
-  usleep(11000);
 
   ret = galaxy100_i2c_write(GALAXY100_FANTRAY_I2C_BUS, GALAXY100_FANTRAY_CPLD_ADDR, info->fan3.pwm_reg, value, 1);
   if(ret < 0) {
     syslog(LOG_ERR, "%s: failed to set fan3 pwm 0x%x, value 0x%x", __func__, info->fan3.pwm_reg, value);
     return -1;
   }
-  usleep(11000);
 
   return 0;
 }
@@ -878,7 +1158,6 @@ static int galaxy100_fab_is_present(int fan)
     syslog(LOG_ERR, "%s: failed to read module present reg 0x%x", __func__, GALAXY100_MODULE_PRESENT_REG);
     return -1;
   }
-  usleep(11000);
   if((ret >> bits) & 0x1 == 0x1) {
     /*not present*/
     syslog(LOG_ERR, "%s: FAB-%d not present", __func__, fan + 1);
@@ -896,7 +1175,6 @@ static int galaxy100_lc_present_detect(void)
     syslog(LOG_ERR, "%s: failed to read module present reg 0x%x", __func__, GALAXY100_MODULE_PRESENT_REG);
     return -1;
   }
-  usleep(11000);
   //printf("%s: ret = 0x%x\n", __func__, ret);
   for(i = 0; i < GALAXY100_LC_NUM; i++) {
     if((ret >> i) & 0x1 == 0x1) {
@@ -923,7 +1201,6 @@ static int galaxy100_scm_present_detect(void)
     syslog(LOG_ERR, "%s: failed to read module present reg 0x%x", __func__, GALAXY100_SCM_PRESENT_REG);
     return -1;
   }
-  usleep(11000);
   //printf("%s: ret = 0x%x\n", __func__, ret);
   for(i = 0; i < GALAXY100_SCM_NUM; i++) {
     if((ret >> i) & 0x1 == 0x1) {
@@ -950,7 +1227,6 @@ static int galaxy100_cmm_is_master(void)
     syslog(LOG_ERR, "%s: failed to read cmm status reg 0x%x", __func__, GALAXY100_CMM_STATUS_REG);
     return -1;
   }
-  usleep(11000);
   //printf("%s: ret = 0x%x\n", __func__, ret);
   if(ret & (0x1 << 3)) {
     return 0;//slave
@@ -984,6 +1260,7 @@ static int galaxy100_chanel_reinit(void)
     channel = &info->channel_info;
     channel->channel1.addr = GALAXY100_CMM_CHANNEL1_ADDR_BAKUP;
   }
+  galaxy100_mux_invalidate();
 }
 
 
@@ -1020,7 +1297,6 @@ static int galaxy100_fan_is_okey(int fan)
     syslog(LOG_ERR, "%s: failed to read fan1 status 0x%x", __func__, info->fan1.fan_status);
     error++;
   } else {
-    usleep(11000);
     if(ret & 0x1) {
       if(info->fan1.present == 1)
         printf("FCB-%d fantray 1 is removed\n", fan + 1);
@@ -1047,7 +1323,6 @@ static int galaxy100_fan_is_okey(int fan)
     syslog(LOG_ERR, "%s: failed to read fan2 status 0x%x", __func__, info->fan2.fan_status);
     error++;
   } else {
-    usleep(11000);
     if(ret & 0x1) {
       if(info->fan2.present == 1)
         printf("FCB-%d fantray 2 is removed\n", fan + 1);
@@ -1074,7 +1349,6 @@ static int galaxy100_fan_is_okey(int fan)
     syslog(LOG_ERR, "%s: failed to read fan3 status 0x%x", __func__, info->fan3.fan_status);
     error++;
   } else {
-    usleep(11000);
     if(ret & 0x1) {
       if(info->fan3.present == 1)
         printf("FCB-%d fantray 3 is removed\n", fan + 1);
@@ -1134,14 +1408,12 @@ static int galaxy100_write_fan_led(int fan, const char *color)
     syslog(LOG_ERR, "%s: failed to read fan1 status 0x%x", __func__, info->fan1.fan_status);
     return -1;
   }
-  usleep(11000);
   if((ret & 0x1) == 0 && ((ret > 1 && value == 2) || (ret == 0 && value == 1))) {
     ret = galaxy100_i2c_write(GALAXY100_FANTRAY_I2C_BUS, GALAXY100_FANTRAY_CPLD_ADDR, info->fan1.fan_led_reg, value, 1);
     if(ret < 0) {
       syslog(LOG_ERR, "%s: failed to set led 0x%x, value 0x%x", __func__, info->fan1.fan_led_reg, value);
       return -1;
     }
-    usleep(11000);
   }
 
   ret = galaxy100_i2c_read(GALAXY100_FANTRAY_I2C_BUS, GALAXY100_FANTRAY_CPLD_ADDR, info->fan2.fan_status, 1);
@@ -1149,14 +1421,12 @@ static int galaxy100_write_fan_led(int fan, const char *color)
     syslog(LOG_ERR, "%s: failed to read fan2 status 0x%x", __func__, info->fan2.fan_status);
     return -1;
   }
-  usleep(11000);
   if((ret & 0x1) == 0 && ((ret > 1 && value == 2) || (ret == 0 && value == 1))) {
     ret = galaxy100_i2c_write(GALAXY100_FANTRAY_I2C_BUS, GALAXY100_FANTRAY_CPLD_ADDR, info->fan2.fan_led_reg, value, 1);
     if(ret < 0) {
       syslog(LOG_ERR, "%s: failed to set led  0x%x, value 0x%x", __func__, info->fan2.fan_led_reg, value);
       return -1;
     }
-    usleep(11000);
   }
 
   ret = galaxy100_i2c_read(GALAXY100_FANTRAY_I2C_BUS, GALAXY100_FANTRAY_CPLD_ADDR, info->fan3.fan_status, 1);
@@ -1164,14 +1434,12 @@ static int galaxy100_write_fan_led(int fan, const char *color)
     syslog(LOG_ERR, "%s: failed to read fan3 status 0x%x", __func__, info->fan3.fan_status);
     return -1;
   }
-  usleep(11000);
   if((ret & 0x1) == 0 && ((ret > 1 && value == 2) || (ret == 0 && value == 1))) {
     ret = galaxy100_i2c_write(GALAXY100_FANTRAY_I2C_BUS, GALAXY100_FANTRAY_CPLD_ADDR, info->fan3.fan_led_reg, value, 1);
     if(ret < 0) {
       syslog(LOG_ERR, "%s: failed to set led  0x%x, value 0x%x", __func__, info->fan3.fan_led_reg, value);
       return -1;
     }
-    usleep(11000);
   }
 
   return 1;
@@ -1188,7 +1456,6 @@ static int system_shutdown(const char *why)
       syslog(LOG_ERR, "%s: failed to set PSU channel 0x%x, value 0x%x", __func__, GALAXY100_PSU_CHANNEL_I2C_ADDR, 0x1 << i);
       return -1;
     }
-    usleep(11000);
     ret = galaxy100_i2c_write(GALAXY100_PSU_CHANNEL_I2C_BUS, GALAXY100_PSU_I2C_ADDR, 0x1, 0x0, 1);
     if(ret < 0) {
       syslog(LOG_ERR, "%s: failed to set PSU shutdown 0x1, value 0x0", __func__);
@@ -1256,9 +1523,25 @@ int write_fan_led(const int fan, const char *color) {
 
 /* Gracefully shut down on receipt of a signal */
 
+static volatile sig_atomic_t fand_signal = 0;
+
 void fand_interrupt(int sig)
+{
+  fand_signal = sig;
+}
+
+/*
+ * The fail-safe writes take the i2c bus locks, which a signal handler
+ * must not, so the main loop does them between steps.
+ */
+static void fand_check_signal(void)
 {
   int fan;
+  int sig = fand_signal;
+
+  if (sig == 0)
+    return;
+
   for (fan = 0; fan < total_fans; fan++) {
     write_fan_speed(fan + fan_offset, fan_max);
   }
@@ -1274,11 +1557,10 @@ int main(int argc, char **argv) {
   /* Sensor values */
   int critical_temp;
   int alarm_temp;
-  int old_temp = GALAXY100_RAISING_TEMP_HIGH;
-  int raising_pwm;
-  int falling_pwm;
+  struct fand_policy_state state;
+  float temps[FAND_POLICY_INPUTS];
   struct galaxy100_fantray_info_stu *info;
-  int fan_speed = fan_medium;
+  int fan_speed;
   int failed_speed = 0;
 
   int bad_reads = 0;
@@ -1296,6 +1578,14 @@ int main(int argc, char **argv) {
 
   struct sigaction sa;
 
+  // A signal runs the fans at fan_max
+  policy = fand_policy_find("galaxy100");
+  fan_low = policy->low;
+  fan_medium = policy->medium;
+  fan_high = policy->high;
+  fan_max = policy->max;
+  fan_speed = fan_medium;
+
   sa.sa_handler = fand_interrupt;
   sa.sa_flags = 0;
   sigemptyset(&sa.sa_mask);
@@ -1358,6 +1648,8 @@ int main(int argc, char **argv) {
             fan_high);
   }
 
+  fand_policy_init(policy, &state, fan_speed);
+
   daemon(1, 0);
 
   if (verbose) {
@@ -1389,6 +1681,7 @@ int main(int argc, char **argv) {
 
   while (1) {
     int max_temp;
+    fand_check_signal();
     old_speed = fan_speed;
 
     /*if it is master, then run next*/
@@ -1399,6 +1692,8 @@ int main(int argc, char **argv) {
     }
 
     /* Read sensors */
+    galaxy100_mux_invalidate();
+    galaxy100_sweep_temps();
     critical_temp = read_critical_max_temp();
     alarm_temp = read_alarm_max_temp();
     if ((critical_temp == BAD_TEMP || alarm_temp == BAD_TEMP)) {
@@ -1412,7 +1707,8 @@ int main(int argc, char **argv) {
     }
 
     /* Protection heuristics */
-    if(critical_temp > GALAXY100_SYSTEM_LIMIT) {
+    temps[0] = critical_temp;
+    if(fand_policy_over_limit(policy, temps) >= 0) {
       system_shutdown("Critical temp limit reached");
     }
 
@@ -1423,22 +1719,8 @@ int main(int argc, char **argv) {
      * We should use the intake temperature to adjust this
      * as well.
      */
-
-    /* Other systems use a simpler built-in table to determine fan speed. */
-    raising_pwm = calculate_raising_fan_pwm(critical_temp);
-    falling_pwm = calculate_falling_fan_pwm(critical_temp);
-    if(old_temp <= critical_temp) {
-      /*raising*/
-      if(raising_pwm >= fan_speed) {
-        fan_speed = raising_pwm;
-      }
-    } else {
-      /*falling*/
-      if(falling_pwm <= fan_speed ) {
-        fan_speed = falling_pwm;
-      }
-    }
-    old_temp = critical_temp;
+    state.speed = fan_speed;
+    fan_speed = fand_policy_step(policy, &state, temps, fan_failure);
 
     /*
      * Update fans only if there are no failed ones. If any fans failed
@@ -1465,6 +1747,7 @@ int main(int argc, char **argv) {
      */
 
     sleep(5);
+    fand_check_signal();
     galaxy100_lc_present_detect();
     galaxy100_scm_present_detect();
 
@@ -1551,13 +1834,13 @@ int main(int argc, char **argv) {
 #endif
         fan_failed += not_present * 3;
         if(fan_failed > 0 && fan_failed <= 3) {
-          if(fan_speed == GALAXY100_FAN_LOW) {
+          if(fan_speed == policy->low) {
             failed_speed = galaxy100_fan_failed_control[fan_failed - 1].low_level;
-          } else if(fan_speed == GALAXY100_FAN_MEDIUM) {
+          } else if(fan_speed == policy->medium) {
             failed_speed = galaxy100_fan_failed_control[fan_failed - 1].mid_level;
-          } else if(fan_speed == GALAXY100_FAN_HIGH) {
+          } else if(fan_speed == policy->high) {
             failed_speed = galaxy100_fan_failed_control[fan_failed - 1].high_level;
-          } else if(fan_speed == GALAXY100_FAN_MAX) {
+          } else if(fan_speed == policy->max) {
             failed_speed = galaxy100_fan_failed_control[fan_failed - 1].alarm_level;
           }
         } else {
@@ -1575,7 +1858,7 @@ int main(int argc, char **argv) {
        * to a more suitable rpm. The fan daemon does not need to be restarted.
        */
     } else if(prev_fans_bad != 0 && fan_failure == 0){
-      old_temp = GALAXY100_RAISING_TEMP_HIGH;
+      fand_policy_init(policy, &state, fan_medium);
       fan_speed = fan_medium;
       for (fan = 0; fan < total_fans; fan++) {
         write_fan_speed(fan + fan_offset, fan_speed);
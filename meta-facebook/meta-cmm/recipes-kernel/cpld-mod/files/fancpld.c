@@ -334,8 +334,20 @@ static int fancpld_probe(struct i2c_client *client,
                          const struct i2c_device_id *id)
 {
   int n_attrs = sizeof(fancpld_attr_table) / sizeof(fancpld_attr_table[0]);
-  return i2c_dev_sysfs_data_init(client, &fancpld_data,
-                                 fancpld_attr_table, n_attrs);
+  int err;
+
+  err = i2c_dev_sysfs_data_init(client, &fancpld_data,
+                                fancpld_attr_table, n_attrs);
+  if (err) {
+    return err;
+  }
+
+  /* plain registers, so they can be cached and read in bulk */
+  err = i2c_dev_sysfs_cache_init(client, &fancpld_data, 0);
+  if (err) {
+    i2c_dev_sysfs_data_clean(client, &fancpld_data);
+  }
+  return err;
 }
 
 static int fancpld_remove(struct i2c_client *client)
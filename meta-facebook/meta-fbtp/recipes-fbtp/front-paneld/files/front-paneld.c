@@ -34,6 +34,8 @@
 #include <openbmc/ipmi.h>
 #include <openbmc/ipmb.h>
 #include <openbmc/pal.h>
+#include <openbmc/gpio.h>
+#include <openbmc/evloop.h>
 
 #define BTN_MAX_SAMPLES   200
 #define BTN_POWER_OFF     40
@@ -56,52 +58,88 @@
 #define LED_ON_TIME_BMC_SELECT 500
 #define LED_OFF_TIME_BMC_SELECT 500
 
+#define FP_DEBOUNCE_MS 50
+#define FP_POLL_MS 1000
+#define STATUS_POLL_MS 1000
+#define STATUS_SLACK_MS 200
+#define STATS_INTERVAL_MS (60 * 1000)
+#define STATS_FILE "/tmp/front-paneld.stats"
+
 
 uint8_t g_sync_led[MAX_NUM_SLOTS+1] = {0x0};
 
-// Thread for monitoring debug card hotswap
-static void *
-debug_card_handler() {
-  int curr = -1;
-  int prev = -1;
+static evloop_t *g_loop;
+static ev_input_t g_dbg_card;
+static ev_timer_t g_ts_timer;
+static ev_timer_t g_id_led_timer;
+static ev_timer_t g_stats_timer;
+
+// Wait for edges on the GPIOs behind a front panel input, or sample it
+// every poll_ms if the platform or the pins cannot signal edges
+static int
+fp_input_start(ev_input_t *in, uint8_t input, uint32_t poll_ms, ev_input_cb cb) {
+  int gpios[FP_MAX_GPIOS], fds[FP_MAX_GPIOS];
+  int i, cnt = FP_MAX_GPIOS, nfds = 0;
+  gpio_st g;
+
+  if (pal_get_fp_gpios(input, gpios, &cnt) == 0) {
+    for (i = 0; i < cnt; i++) {
+      if (gpio_open_edge(&g, gpios[i], GPIO_EDGE_BOTH))
+        break;
+      fds[nfds++] = g.gs_fd;
+    }
+    // A pin without edges would leave the input stale, so sample instead
+    if (i < cnt) {
+      while (nfds > 0)
+        close(fds[--nfds]);
+      syslog(LOG_INFO, "front panel input %d: no edge support, polling", input);
+    }
+  }
+
+  return ev_input_start(g_loop, in, fds, nfds, FP_DEBOUNCE_MS, poll_ms, cb, NULL);
+}
+
+// Debug card hotswap
+static void
+debug_card_handler(evloop_t *loop, ev_input_t *in, void *arg) {
+  static int prev = -1;
+  int curr;
   uint8_t prsnt;
   int ret;
 
-  while (1) {
-    // Check if debug card present or not
-    ret = pal_is_debug_card_prsnt(&prsnt);
-    if (ret) {
-      goto debug_card_out;
-    }
+  // Check if debug card present or not
+  ret = pal_is_debug_card_prsnt(&prsnt);
+  if (ret) {
+    goto debug_card_retry;
+  }
 
-    curr = prsnt;
+  curr = prsnt;
 
-    // Check if Debug Card was either inserted or removed
-    if (curr == prev) {
-      goto debug_card_out;
-    }
+  // Check if Debug Card was either inserted or removed
+  if (curr == prev) {
+    return;
+  }
 
-    if (!curr) {
-    // Debug Card was removed
-      syslog(LOG_WARNING, "Debug Card Extraction\n");
-      // Switch UART mux to BMC
-      ret = pal_switch_uart_mux(UART_TO_BMC);
-      if (ret) {
-        goto debug_card_out;
-      }
-    } else {
-    // Debug Card was inserted
-      syslog(LOG_WARNING, "Debug Card Insertion\n");
-      // Switch UART mux to Debug card
-      ret = pal_switch_uart_mux(UART_TO_DEBUG);
-      if (ret) {
-        goto debug_card_out;
-      }
-    }
-    prev = curr;
-debug_card_out:
-      sleep(1);
+  if (!curr) {
+  // Debug Card was removed
+    syslog(LOG_WARNING, "Debug Card Extraction\n");
+    // Switch UART mux to BMC
+    ret = pal_switch_uart_mux(UART_TO_BMC);
+  } else {
+  // Debug Card was inserted
+    syslog(LOG_WARNING, "Debug Card Insertion\n");
+    // Switch UART mux to Debug card
+    ret = pal_switch_uart_mux(UART_TO_DEBUG);
+  }
+  if (ret) {
+    goto debug_card_retry;
   }
+  prev = curr;
+  return;
+
+debug_card_retry:
+  // No edge may follow, so try again as the old poll loop would have
+  ev_input_recheck(loop, in, FP_POLL_MS);
 }
 
 #if 0
@@ -263,19 +301,56 @@ pwr_btn_out:
 }
 #endif
 
-// Thread to monitor SLED Cycles by using time stamp
-static void *
-ts_handler() {
-  int count = 0;
+// Monitor SLED Cycles by using time stamp
+static long time_sled_off;
+
+static void
+ts_handler(evloop_t *loop, ev_timer_t *t, void *arg) {
   struct timespec ts;
   struct timespec mts;
+  char buf[128] = {0};
+  long time_sled_on;
+  static uint8_t time_init = 0;
+
+  if (time_init) {
+    // Store timestamp every one hour to keep track of SLED power
+    pal_update_ts_sled();
+    return;
+  }
+
+  // Make sure the time is initialized properly
+  // Since there is no battery backup, the time could be reset to build time
+  clock_gettime(CLOCK_REALTIME, &ts);
+  if (ts.tv_sec < time_sled_off) {
+    ev_timer_start(loop, t, 1000, 0);
+    return;
+  }
+
+  // If current time is more than the stored time, the date is correct
+  // Need to log SLED ON event, if this is Power-On-Reset
+  if (pal_is_bmc_por()) {
+    // Get uptime
+    clock_gettime(CLOCK_MONOTONIC, &mts);
+    // To find out when SLED was on, subtract the uptime from current time
+    time_sled_on = ts.tv_sec - mts.tv_sec;
+
+    ctime_r(&time_sled_on, buf);
+    // Log an event if this is Power-On-Reset
+    syslog(LOG_CRIT, "SLED Powered ON at %s", buf);
+  }
+  pal_update_ts_sled();
+  time_init = 1;
+
+  ev_timer_set_slack(t, HB_SLEEP_TIME * 1000);
+  ev_timer_start(loop, t, HB_TIMESTAMP_COUNT * HB_SLEEP_TIME * 1000,
+                 HB_TIMESTAMP_COUNT * HB_SLEEP_TIME * 1000);
+}
+
+static void
+ts_init(void) {
   char tstr[64] = {0};
   char buf[128] = {0};
   char temp_log[28] = {0};
-  uint8_t por = 0;
-  uint8_t time_init = 0;
-  long time_sled_on;
-  long time_sled_off;
 
   // Read the last timestamp from KV storage
   pal_get_key_value("timestamp_sled", tstr);
@@ -291,43 +366,8 @@ ts_handler() {
     syslog(LOG_CRIT, "BMC Reboot detected");
   }
 
-  while (1) {
-
-    // Make sure the time is initialized properly
-    // Since there is no battery backup, the time could be reset to build time
-    if (time_init == 0) {
-      // Read current time
-      clock_gettime(CLOCK_REALTIME, &ts);
-
-      if (ts.tv_sec < time_sled_off) {
-        sleep(1);
-        continue;
-      }
-
-      // If current time is more than the stored time, the date is correct
-      time_init = 1;
-      // Need to log SLED ON event, if this is Power-On-Reset
-      if (pal_is_bmc_por()) {
-        // Get uptime
-        clock_gettime(CLOCK_MONOTONIC, &mts);
-        // To find out when SLED was on, subtract the uptime from current time
-        time_sled_on = ts.tv_sec - mts.tv_sec;
-
-        ctime_r(&time_sled_on, buf);
-        // Log an event if this is Power-On-Reset
-        syslog(LOG_CRIT, "SLED Powered ON at %s", buf);
-      }
-      pal_update_ts_sled();
-    }
-
-    // Store timestamp every one hour to keep track of SLED power
-    if (count++ == HB_TIMESTAMP_COUNT) {
-      pal_update_ts_sled();
-      count = 0;
-    }
-
-    sleep(HB_SLEEP_TIME);
-  }
+  ev_timer_init(&g_ts_timer, ts_handler, NULL);
+  ev_timer_start(g_loop, &g_ts_timer, 0, 0);
 }
 
 #if 0
@@ -447,165 +487,54 @@ led_handler_exit:
 }
 #endif
 
-// Thread to handle LED state of the SLED
-static void *
-led_sync_handler() {
-  int ret;
-  uint8_t pos;
-  uint8_t ident = 0;
+// Handle LED state of the SLED
+static void
+led_sync_handler(evloop_t *loop, ev_timer_t *t, void *arg) {
+  static uint8_t led_on = 0;
   char identify[16] = {0};
-  char tstr[64] = {0};
-  char id_arr[5] = {0};
-  uint8_t slot;
-  uint8_t spb_hlth = 0;
-  uint8_t nic_hlth = 0;
-
-  while (1) {
-    // Handle Slot IDENTIFY condition
-    memset(identify, 0x0, 16);
-    ret = pal_get_key_value("identify_sled", identify);
-    if (ret == 0 && !strcmp(identify, "on")) {
-      // Start blinking the ID LED
-      pal_set_id_led(FRU_MB, ID_LED_ON);
-
-      msleep(LED_ON_TIME_IDENTIFY);
-
-      pal_set_id_led(FRU_MB, ID_LED_OFF);
-
-      msleep(LED_OFF_TIME_IDENTIFY);
-      continue;
-    }
-
-    sleep(1);
-
-#if 0
-    // Handle Sled level health condition
-    ret = pal_get_fru_health(FRU_MB, &mb_hlth);
-    if (ret) {
-      sleep(1);
-      continue;
-    }
-
-    ret = pal_get_fru_health(FRU_NIC, &nic_hlth);
-    if (ret) {
-      sleep(1);
-      continue;
-    }
-
-    if (spb_hlth == FRU_STATUS_BAD || nic_hlth == FRU_STATUS_BAD) {
-      // Turn OFF Blue LED
-      for (slot = 1; slot <= MAX_NUM_SLOTS; slot++) {
-        g_sync_led[slot] = 1;
-        pal_set_led(slot, LED_OFF);
-      }
-
-      // Start blinking the Yellow/ID LED
-      for (slot = 1; slot <= MAX_NUM_SLOTS; slot++) {
-        pal_set_id_led(slot, ID_LED_ON);
-      }
-
-      msleep(LED_ON_TIME_HEALTH);
-
-      for (slot = 1; slot <= MAX_NUM_SLOTS; slot++) {
-        pal_set_id_led(slot, ID_LED_OFF);
-      }
-      msleep(LED_OFF_TIME_HEALTH);
-      continue;
-    }
-
-    // Check if slot needs to be identified
-    ident = 0;
-    for (slot = 1; slot <= MAX_NUM_SLOTS; slot++)  {
-      id_arr[slot] = 0x0;
-      sprintf(tstr, "identify_slot%d", slot);
-      memset(identify, 0x0, 16);
-      ret = pal_get_key_value(tstr, identify);
-      if (ret == 0 && !strcmp(identify, "on")) {
-        id_arr[slot] = 0x1;
-        ident = 1;
-      }
-    }
-
-    // Get hand switch position to see if this is selected server
-    ret = pal_get_hand_sw(&pos);
-    if (ret) {
-      sleep(1);
-      continue;
-    }
-
-    // Handle BMC select condition when no slot is being identified
-    if ((pos == HAND_SW_BMC) && (ident == 0)) {
-       // Check hand sw position for bounce logic
-      msleep(100);
-      ret = pal_get_hand_sw(&pos);
-      if ((ret) || (pos != HAND_SW_BMC)) {
-        sleep(1);
-        continue;
-      }
-
-      // Turn OFF Yellow LED
-      for (slot = 1; slot <= MAX_NUM_SLOTS; slot++) {
-        g_sync_led[slot] = 1;
-        pal_set_id_led(slot, ID_LED_OFF);
-      }
-
-      // Start blinking Blue LED
-      for (slot = 1; slot <= 4; slot++) {
-        pal_set_led(slot, LED_ON);
-      }
-
-      msleep(LED_ON_TIME_BMC_SELECT);
-
-      for (slot = 1; slot <= 4; slot++) {
-        pal_set_led(slot, LED_OFF);
-      }
+  int ret;
 
-      msleep(LED_OFF_TIME_BMC_SELECT);
-      continue;
-    }
+  // Finish the blink cycle started below
+  if (led_on) {
+    pal_set_id_led(FRU_MB, ID_LED_OFF);
+    led_on = 0;
+    ev_timer_set_slack(t, 0);
+    ev_timer_start(loop, t, LED_OFF_TIME_IDENTIFY, 0);
+    return;
+  }
 
-    // Handle individual identify slot condition
-    if (ident) {
-      for (slot = 1; slot <=4; slot++) {
-        if (id_arr[slot]) {
-          g_sync_led[slot] = 1;
-          pal_set_led(slot, LED_OFF);
-          pal_set_id_led(slot, ID_LED_ON);
-        } else {
-          g_sync_led[slot] = 0;
-        }
-      }
+  // Handle Slot IDENTIFY condition
+  ret = pal_get_key_value("identify_sled", identify);
+  if (ret == 0 && !strcmp(identify, "on")) {
+    // Start blinking the ID LED
+    pal_set_id_led(FRU_MB, ID_LED_ON);
+    led_on = 1;
+    ev_timer_set_slack(t, 0);
+    ev_timer_start(loop, t, LED_ON_TIME_IDENTIFY, 0);
+    return;
+  }
 
-      msleep(LED_ON_TIME_IDENTIFY);
+  // Checked once a second, sharing the wakeup with other timers
+  ev_timer_set_slack(t, STATUS_SLACK_MS);
+  ev_timer_start(loop, t, STATUS_POLL_MS, 0);
+}
 
-      for (slot = 1; slot <=4; slot++) {
-        if (id_arr[slot]) {
-          pal_set_id_led(slot, ID_LED_OFF);
-        }
-      }
+static void
+stats_handler(evloop_t *loop, ev_timer_t *t, void *arg) {
+  FILE *fp;
 
-      msleep(LED_OFF_TIME_IDENTIFY);
-      continue;
-    }
-    for (slot = 1; slot <= 4; slot++) {
-      g_sync_led[slot] = 0;
-    }
-    msleep(200);
-#endif
+  fp = fopen(STATS_FILE ".tmp", "w");
+  if (!fp) {
+    return;
   }
+  evloop_dump_stats(loop, fp);
+  fprintf(fp, "dbg_card_edges: %llu\n", (unsigned long long)g_dbg_card.edges);
+  fclose(fp);
+  rename(STATS_FILE ".tmp", STATS_FILE);
 }
 
 int
 main (int argc, char * const argv[]) {
-  pthread_t tid_hand_sw;
-  pthread_t tid_debug_card;
-  pthread_t tid_rst_btn;
-  pthread_t tid_pwr_btn;
-  pthread_t tid_ts;
-  pthread_t tid_sync_led;
-  pthread_t tid_leds[MAX_NUM_SLOTS];
-  int i;
-  int *ip;
   int rc;
   int pid_file;
 
@@ -621,58 +550,30 @@ main (int argc, char * const argv[]) {
    openlog("front-paneld", LOG_CONS, LOG_DAEMON);
   }
 
-
-  if (pthread_create(&tid_debug_card, NULL, debug_card_handler, NULL) < 0) {
-    syslog(LOG_WARNING, "pthread_create for debug card error\n");
-    exit(1);
-  }
-#if 0
-  if (pthread_create(&tid_hand_sw, NULL, usb_handler, NULL) < 0) {
-    syslog(LOG_WARNING, "pthread_create for hand switch error\n");
+  // All front panel work shares one event loop: inputs are handled on GPIO
+  // edges and periodic work runs from coalesced timers
+  g_loop = evloop_create();
+  if (!g_loop) {
+    syslog(LOG_WARNING, "evloop_create failed\n");
     exit(1);
   }
 
-  if (pthread_create(&tid_rst_btn, NULL, rst_btn_handler, NULL) < 0) {
-    syslog(LOG_WARNING, "pthread_create for reset button error\n");
+  if (fp_input_start(&g_dbg_card, FP_INPUT_DBG_CARD_PRSNT, FP_POLL_MS,
+                     debug_card_handler)) {
+    syslog(LOG_WARNING, "debug card monitor setup error\n");
     exit(1);
   }
 
-  if (pthread_create(&tid_pwr_btn, NULL, pwr_btn_handler, NULL) < 0) {
-    syslog(LOG_WARNING, "pthread_create for power button error\n");
-    exit(1);
-  }
+  ts_init();
 
-#endif
-  if (pthread_create(&tid_ts, NULL, ts_handler, NULL) < 0) {
-    syslog(LOG_WARNING, "pthread_create for time stamp error\n");
-    exit(1);
-  }
+  ev_timer_init(&g_id_led_timer, led_sync_handler, NULL);
+  ev_timer_start(g_loop, &g_id_led_timer, 0, 0);
 
-  if (pthread_create(&tid_sync_led, NULL, led_sync_handler, NULL) < 0) {
-    syslog(LOG_WARNING, "pthread_create for led sync error\n");
-    exit(1);
-  }
+  ev_timer_init(&g_stats_timer, stats_handler, NULL);
+  ev_timer_set_slack(&g_stats_timer, STATS_INTERVAL_MS / 10);
+  ev_timer_start(g_loop, &g_stats_timer, STATS_INTERVAL_MS, STATS_INTERVAL_MS);
 
-#if 0
-  for (i = 0; i < MAX_NUM_SLOTS; i++) {
-    ip = malloc(sizeof(int));
-    *ip = i;
-    if (pthread_create(&tid_leds[i], NULL, led_handler, (void*)ip) < 0) {
-      syslog(LOG_WARNING, "pthread_create for led error\n");
-      exit(1);
-    }
-  }
-#endif
-  pthread_join(tid_debug_card, NULL);
-  pthread_join(tid_sync_led, NULL);
-  pthread_join(tid_ts, NULL);
-#if 0
-  pthread_join(tid_hand_sw, NULL);
-  pthread_join(tid_rst_btn, NULL);
-  pthread_join(tid_pwr_btn, NULL);
-  for (i = 0;  i < MAX_NUM_SLOTS; i++) {
-    pthread_join(tid_leds[i], NULL);
-  }
-#endif
-  return 0;
+  rc = evloop_run(g_loop);
+  evloop_destroy(g_loop);
+  return rc ? 1 : 0;
 }
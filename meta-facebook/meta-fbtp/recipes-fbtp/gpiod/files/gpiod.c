@@ -27,12 +27,14 @@
 #include <stdint.h>
 #include <math.h>
 #include <string.h>
+#include <time.h>
 #include <pthread.h>
 #include <sys/un.h>
 #include <sys/file.h>
 #include <openbmc/pal.h>
 #include <openbmc/gpio.h>
 #include <openbmc/ocp-dbg-lcd.h>
+#include <openbmc/evbus.h>
 #include <linux/i2c.h>
 #include <linux/i2c-dev.h>
 
@@ -70,47 +72,218 @@ static inline long int decrease_timer(long int *val) {
   return *val;
 }
 
+#define DELAY_LOG_STATS "/tmp/gpiod.stats"
+
+/*
+ * Delayed GPIO logs wait in a min-heap ordered by due time and are written
+ * by a single thread. Each GPIO has at most one pending log: changes that
+ * come in while it waits are folded into it rather than queued, so a
+ * bouncing line costs a counter and not a thread or an allocation.
+ */
 struct delayed_log {
-  useconds_t usec;
-  char msg[256];
+  gpio_poll_st *gp;
+  uint64_t due;             // us, monotonic
+  uint8_t first;            // value after the first change
+  uint8_t value;            // value after the last change
+  uint32_t changes;         // changes folded in after the first
+  bool pending;
 };
-// Thread for delay event
+
+static struct {
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+  bool running;
+  gpio_poll_st *gpios;
+  int count;
+  struct delayed_log *ent;  // one per GPIO
+  struct delayed_log **heap;
+  int num;
+  uint64_t queued;
+  uint64_t logged;
+  uint64_t coalesced;
+  uint32_t max_pending;
+} g_dlog = {
+  .lock = PTHREAD_MUTEX_INITIALIZER,
+};
+
+static uint64_t
+now_us(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+// Log a GPIO change, and any that followed within its delay, to syslog and the event bus
+static void
+gpio_log_write(gpio_poll_st *gp, uint8_t first, uint32_t changes, uint8_t value)
+{
+  evbus_gpio_t ev = {
+    .gpio = gp->gs.gs_gpio,
+    .value = value,
+  };
+
+  if (changes == 0) {
+    syslog(LOG_CRIT, "%s: %s - %s\n", first ? "DEASSERT" : "ASSERT", gp->name, gp->desc);
+    evbus_publish(EVBUS_T_GPIO, FRU_MB, LOG_CRIT, &ev, sizeof(ev), "%s: %s",
+                  first ? "DEASSERT" : "ASSERT", gp->name);
+  } else {
+    syslog(LOG_CRIT, "%s: %s - %s, %u more changes, now %s\n",
+           first ? "DEASSERT" : "ASSERT", gp->name, gp->desc,
+           changes, value ? "DEASSERT" : "ASSERT");
+    evbus_publish(EVBUS_T_GPIO, FRU_MB, LOG_CRIT, &ev, sizeof(ev),
+                  "%s: %s, %u more changes, now %s", first ? "DEASSERT" : "ASSERT",
+                  gp->name, changes, value ? "DEASSERT" : "ASSERT");
+  }
+}
+
+static void
+dlog_heap_push(struct delayed_log *ent) {
+  struct delayed_log **h = g_dlog.heap;
+  int i = g_dlog.num++;
+
+  while (i > 0 && h[(i - 1) / 2]->due > ent->due) {
+    h[i] = h[(i - 1) / 2];
+    i = (i - 1) / 2;
+  }
+  h[i] = ent;
+}
+
+static struct delayed_log *
+dlog_heap_pop(void) {
+  struct delayed_log **h = g_dlog.heap;
+  struct delayed_log *top = h[0], *last;
+  int i = 0, c;
+
+  last = h[--g_dlog.num];
+  while ((c = 2 * i + 1) < g_dlog.num) {
+    if (c + 1 < g_dlog.num && h[c + 1]->due < h[c]->due)
+      c++;
+    if (last->due <= h[c]->due)
+      break;
+    h[i] = h[c];
+    i = c;
+  }
+  h[i] = last;
+
+  return top;
+}
+
+static void
+dlog_write_stats(void) {
+  FILE *fp;
+
+  fp = fopen(DELAY_LOG_STATS, "w");
+  if (!fp)
+    return;
+  fprintf(fp, "delayed_queued: %llu\n", (unsigned long long)g_dlog.queued);
+  fprintf(fp, "delayed_logged: %llu\n", (unsigned long long)g_dlog.logged);
+  fprintf(fp, "delayed_coalesced: %llu\n", (unsigned long long)g_dlog.coalesced);
+  fprintf(fp, "delayed_pending: %d\n", g_dlog.num);
+  fprintf(fp, "delayed_max_pending: %u\n", g_dlog.max_pending);
+  fclose(fp);
+}
+
+// Thread for delayed GPIO logs
 static void *
-delay_log(void *arg)
+delay_log_thread(void *arg)
 {
-  struct delayed_log* log = (struct delayed_log*)arg;
+  struct delayed_log *ent, log;
+  struct timespec ts;
+  uint64_t now;
 
-  pthread_detach(pthread_self());
+  pthread_mutex_lock(&g_dlog.lock);
+  while (1) {
+    if (g_dlog.num == 0) {
+      pthread_cond_wait(&g_dlog.cond, &g_dlog.lock);
+      continue;
+    }
+
+    now = now_us();
+    if (g_dlog.heap[0]->due > now) {
+      ts.tv_sec = g_dlog.heap[0]->due / 1000000;
+      ts.tv_nsec = (g_dlog.heap[0]->due % 1000000) * 1000;
+      pthread_cond_timedwait(&g_dlog.cond, &g_dlog.lock, &ts);
+      continue;
+    }
 
-  if (arg) {
-    usleep(log->usec);
-    syslog(LOG_CRIT, log->msg);
+    ent = dlog_heap_pop();
+    ent->pending = false;
+    log = *ent;
+    g_dlog.logged++;
+    g_dlog.coalesced += log.changes;
 
-    free(arg);
+    // Don't hold up the GPIO handlers on syslog
+    pthread_mutex_unlock(&g_dlog.lock);
+    gpio_log_write(log.gp, log.first, log.changes, log.value);
+    pthread_mutex_lock(&g_dlog.lock);
+
+    if (g_dlog.num == 0)
+      dlog_write_stats();
   }
 
-  pthread_exit(NULL);
+  return NULL;
+}
+
+static int
+delay_log_init(gpio_poll_st *gpios, int count)
+{
+  pthread_condattr_t attr;
+  pthread_t tid_delay_log;
+
+  g_dlog.ent = calloc(count, sizeof(struct delayed_log));
+  g_dlog.heap = calloc(count, sizeof(struct delayed_log *));
+  if (!g_dlog.ent || !g_dlog.heap)
+    goto err;
+
+  pthread_condattr_init(&attr);
+  pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+  pthread_cond_init(&g_dlog.cond, &attr);
+  pthread_condattr_destroy(&attr);
+
+  g_dlog.gpios = gpios;
+  g_dlog.count = count;
+  if (pthread_create(&tid_delay_log, NULL, delay_log_thread, NULL))
+    goto err;
+  g_dlog.running = true;
+
+  return 0;
+
+err:
+  free(g_dlog.ent);
+  free(g_dlog.heap);
+  return -1;
 }
 
 static void log_gpio_change(gpio_poll_st *gp, useconds_t log_delay)
 {
-  if (log_delay == 0) {
-    syslog(LOG_CRIT, "%s: %s - %s\n", gp->value ? "DEASSERT": "ASSERT", gp->name, gp->desc);
+  struct delayed_log *ent;
+  int idx = gp - g_dlog.gpios;
+
+  if (log_delay == 0 || !g_dlog.running || idx < 0 || idx >= g_dlog.count) {
+    gpio_log_write(gp, gp->value, 0, gp->value);
+    return;
+  }
+
+  pthread_mutex_lock(&g_dlog.lock);
+  g_dlog.queued++;
+  ent = &g_dlog.ent[idx];
+  if (ent->pending) {
+    // Keep the first due time, so a bouncing line can't hold the log back
+    ent->value = gp->value;
+    ent->changes++;
   } else {
-    pthread_t tid_delay_log;
-    struct delayed_log *log = (struct delayed_log *)malloc(sizeof(struct delayed_log));
-    if (log) {
-      log->usec = log_delay;
-      snprintf(log->msg, 256, "%s: %s - %s\n", gp->value ? "DEASSERT" : "ASSERT", gp->name, gp->desc);
-      if (pthread_create(&tid_delay_log, NULL, delay_log, (void *)log)) {
-        free(log);
-        log = NULL;
-      }
-    }
-    if (!log) {
-      syslog(LOG_CRIT, "%s: %s - %s\n", gp->value ? "DEASSERT": "ASSERT", gp->name, gp->desc);
-    }
+    ent->gp = gp;
+    ent->due = now_us() + log_delay;
+    ent->first = ent->value = gp->value;
+    ent->changes = 0;
+    ent->pending = true;
+    dlog_heap_push(ent);
+    if (g_dlog.num > g_dlog.max_pending)
+      g_dlog.max_pending = g_dlog.num;
+    pthread_cond_signal(&g_dlog.cond);
   }
+  pthread_mutex_unlock(&g_dlog.lock);
 }
 
 // Event Handler for GPIOR5 platform reset changes
@@ -534,6 +707,10 @@ main(int argc, void **argv) {
       exit(1);
     }
 
+    if (delay_log_init(g_gpios, g_count) < 0) {
+      syslog(LOG_WARNING, "delay_log_init failed, delayed GPIO logs are written right away\n");
+    }
+
     gpio_poll_open(g_gpios, g_count);
     //GPIO status pre check
     gpio_pre_check();
@@ -107,43 +107,18 @@ int plat_fruid_init(void) {
   return ret;
 }
 
-int plat_fruid_size(unsigned char payload_id) {
-  struct stat buf;
-  int ret;
-
-  // check the size of the file and return size
-  ret = stat(BIN_MB, &buf);
-  if (ret) {
-    return 0;
-  }
-
-  return buf.st_size;
-}
-
-int plat_fruid_data(unsigned char payload_id, int offset, int count, unsigned char *data) {
-  int fd;
-  int ret;
-
-  // open file for read purpose
-  fd = open(BIN_MB, O_RDONLY);
-  if (fd < 0) {
-    return fd;
-  }
-
-  // seek position based on given offset
-  ret = lseek(fd, offset, SEEK_SET);
-  if (ret < 0) {
-    close(fd);
-    return ret;
-  }
-
-  // read the file content
-  ret = read(fd, data, count);
-  if (ret != count) {
-    close(fd);
-    return -1;
+int plat_fruid_path(unsigned char payload_id, unsigned char fru_id, char *path) {
+
+  switch (fru_id) {
+    case 0:
+      strcpy(path, BIN_MB);
+      break;
+    case 1:
+      strcpy(path, BIN_NIC);
+      break;
+    default:
+      return -1;
   }
 
-  close(fd);
   return 0;
 }
@@ -25,12 +25,16 @@
 #include <stdint.h>
 #include <unistd.h>
 #include <errno.h>
+#include <time.h>
+#include <pthread.h>
 #include <syslog.h>
 #include <string.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/inotify.h>
 #include <openbmc/pal.h>
 #include <openbmc/fruid.h>
+#include <openbmc/evbus.h>
 #include <arpa/inet.h>
 
 #define ESCAPE "\x1B"
@@ -462,25 +466,243 @@ read_device(const char *device, char *value) {
   }
 }
 
+// Frames as last rendered; the card is served from here
+enum {
+  FRAME_INFO = 1,
+  FRAME_CRI_SEL,
+  FRAME_CRI_SENSOR,
+  FRAME_MAX,
+};
+
+typedef struct {
+  char buff[MAX_PAGE * LEN_PER_PAGE];
+  int line_num;
+  uint32_t dirty;       // pages changed since the card read them, bit 0 is page 1
+  long long ts_ms;      // when it was last rendered, 0 for never
+} udbg_frame_t;
+
+#define SENSOR_STORE      "/tmp/cache_store"
+#define SENSOR_REFRESH_MS 1000    // while the sensor store cannot be watched
+#define INFO_REFRESH_MS   10000   // FRU, LAN and versions send no notifications
+
+static pthread_mutex_t m_frame = PTHREAD_MUTEX_INITIALIZER;
+static udbg_frame_t g_frame[FRAME_MAX];
+static uint32_t cri_cursor;
+static uint32_t cri_clears;
+static int snr_fd = -1;
+static int snr_stale = 1;
+
+static int plat_udbg_render_info_page(char *frame_buff);
+static int plat_udbg_render_cri_sensor(char *frame_buff);
+
+static long long
+now_ms(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
 static int
-plat_chk_cri_sel_update(uint8_t *cri_sel_up) {
-  static time_t mtime;
-  FILE *fp;
-  struct stat file_stat;
-
-  fp = fopen("/mnt/data/cri_sel", "r");
-  if (fp) {
-    if ((stat("/mnt/data/cri_sel", &file_stat) == 0) && (file_stat.st_mtime > mtime)) {
-      mtime = file_stat.st_mtime;
-      *cri_sel_up = 1;
-    } else {
-      *cri_sel_up = 0;
+plat_udbg_page_num(int line_num) {
+  int page_num = line_num/LINE_PER_PAGE + ((line_num%LINE_PER_PAGE)?1:0);
+
+  return page_num ? page_num : 1;
+}
+
+// Take a new rendering of the frame and mark the pages that differ
+static void
+plat_udbg_frame_update(udbg_frame_t *f, const char *frame_buff, int line_num) {
+  int i, old_num, new_num;
+
+  old_num = f->ts_ms ? plat_udbg_page_num(f->line_num) : 0;
+  new_num = plat_udbg_page_num(line_num);
+
+  for (i = 0; i < new_num; i++) {
+    // The head of every page shows the page count
+    if (old_num != new_num ||
+        memcmp(&f->buff[i*LEN_PER_PAGE], &frame_buff[i*LEN_PER_PAGE], LEN_PER_PAGE))
+      f->dirty |= 1 << i;
+  }
+  f->dirty &= (1 << new_num) - 1;
+
+  memcpy(f->buff, frame_buff, sizeof(f->buff));
+  f->line_num = line_num;
+  f->ts_ms = now_ms();
+}
+
+// Scroll one critical SEL message into the frame; 0 if it had no text
+static int
+plat_udbg_add_cri_sel(udbg_frame_t *f, const char *msg) {
+  int len, msg_line;
+
+  len = strlen(msg);
+  if (len == 0)
+    return 0;
+
+  // line number of this 1 message
+  msg_line = (len/LEN_PER_LINE) + ((len%LEN_PER_LINE)?1:0);
+
+  // total line number after this message
+  if ((f->line_num + msg_line) < MAX_LINE)
+    f->line_num += msg_line;
+  else
+    f->line_num = MAX_LINE;
+
+  // Scroll message down
+  memmove(&f->buff[LEN_PER_LINE*msg_line], &f->buff[0],
+          LEN_PER_LINE*(f->line_num-msg_line));
+
+  // Write new message
+  memcpy(&f->buff[0], msg, len);
+  memset(&f->buff[len], ' ', msg_line*LEN_PER_LINE-len);
+  return 1;
+}
+
+// Scroll the critical SELs published since the last call into the frame
+static void
+plat_udbg_sync_cri_sel(void) {
+  udbg_frame_t *f = &g_frame[FRAME_CRI_SEL];
+  evbus_rec_t recs[16], *log;
+  uint32_t clears;
+  int i, n, m, seed = 0, added = 0;
+
+  // After log-util --clear the card starts over from an empty list
+  if (!evbus_clears(&clears) && clears != cri_clears) {
+    cri_clears = clears;
+    f->line_num = 0;
+    f->dirty = 1;
+    memset(f->buff, ' ', sizeof(f->buff));
+  }
+
+  if (cri_cursor == 0 && f->line_num == 0) {
+    memset(f->buff, ' ', sizeof(f->buff));
+    seed = 1;
+  }
+
+  while ((n = evbus_read(&cri_cursor, recs, sizeof(recs) / sizeof(recs[0]))) > 0) {
+    // The ring is shared with other events, older critical SELs are only
+    // left in the flash log; every message takes at least one line
+    if (seed) {
+      seed = 0;
+      log = malloc(MAX_LINE * sizeof(evbus_rec_t));
+      if (log) {
+        m = evbus_read_log(EVBUS_T_CRI_SEL, recs[0].seq, log, MAX_LINE);
+        for (i = 0; i < m; i++)
+          added |= plat_udbg_add_cri_sel(f, log[i].msg);
+        free(log);
+      }
     }
-    fclose(fp);
+    for (i = 0; i < n; i++) {
+      if (recs[i].type != EVBUS_T_CRI_SEL)
+        continue;
+      added |= plat_udbg_add_cri_sel(f, recs[i].msg);
+    }
+  }
+
+  // Scrolling moves every line
+  if (added)
+    f->dirty = (1 << plat_udbg_page_num(f->line_num)) - 1;
+}
+
+static int
+plat_udbg_is_cri_sensor(int num) {
+  int i;
+
+  for (i = 0; i < (sensor_count-1); i++) {
+    if (cri_sensor[i].sensor_num == num)
+      return 1;
   }
   return 0;
 }
 
+// Watch the sensor store for writes of the critical sensors' readings
+static void
+plat_udbg_chk_sensor_store(void) {
+  char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+  struct inotify_event *ev;
+  ssize_t len;
+  char *ptr;
+  int num;
+
+  if (snr_fd < 0) {
+    snr_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (snr_fd >= 0 &&
+        inotify_add_watch(snr_fd, SENSOR_STORE, IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+      // sensord has not created the store yet
+      close(snr_fd);
+      snr_fd = -1;
+    }
+    if (snr_fd < 0) {
+      if (now_ms() - g_frame[FRAME_CRI_SENSOR].ts_ms >= SENSOR_REFRESH_MS)
+        snr_stale = 1;
+      return;
+    }
+    snr_stale = 1;
+  }
+
+  while ((len = read(snr_fd, buf, sizeof(buf))) > 0) {
+    for (ptr = buf; ptr < buf + len; ptr += sizeof(struct inotify_event) + ev->len) {
+      ev = (struct inotify_event *)ptr;
+      if (ev->mask & (IN_Q_OVERFLOW | IN_IGNORED)) {
+        snr_stale = 1;
+        if (ev->mask & IN_IGNORED) {
+          close(snr_fd);
+          snr_fd = -1;
+          return;
+        }
+        continue;
+      }
+      if (ev->len && sscanf(ev->name, "mb_sensor%d", &num) == 1 &&
+          plat_udbg_is_cri_sensor(num))
+        snr_stale = 1;
+    }
+  }
+}
+
+static void
+plat_udbg_sync_cri_sensor(void) {
+  char frame_buff[MAX_PAGE * LEN_PER_PAGE];
+  int line_num;
+
+  plat_udbg_chk_sensor_store();
+  if (!snr_stale)
+    return;
+  snr_stale = 0;
+
+  line_num = plat_udbg_render_cri_sensor(frame_buff);
+  plat_udbg_frame_update(&g_frame[FRAME_CRI_SENSOR], frame_buff, line_num);
+}
+
+static void
+plat_udbg_sync_info_page(void) {
+  udbg_frame_t *f = &g_frame[FRAME_INFO];
+  char frame_buff[MAX_PAGE * LEN_PER_PAGE];
+  int line_num;
+
+  if (f->ts_ms && now_ms() - f->ts_ms < INFO_REFRESH_MS)
+    return;
+
+  line_num = plat_udbg_render_info_page(frame_buff);
+  plat_udbg_frame_update(f, frame_buff, line_num);
+}
+
+// Bring the frame up to date with its source; cheap when nothing changed
+static void
+plat_udbg_sync_frame(uint8_t frame) {
+  switch (frame) {
+    case FRAME_INFO:
+      plat_udbg_sync_info_page();
+      break;
+    case FRAME_CRI_SEL:
+      plat_udbg_sync_cri_sel();
+      break;
+    case FRAME_CRI_SENSOR:
+      plat_udbg_sync_cri_sensor();
+      break;
+  }
+}
+
 int
 plat_udbg_get_frame_info(uint8_t *num) {
   *num = 3;
@@ -489,27 +711,20 @@ plat_udbg_get_frame_info(uint8_t *num) {
 
 int
 plat_udbg_get_updated_frames(uint8_t *count, uint8_t *buffer) {
-  uint8_t cri_sel_up;
-  uint8_t info_page_up = 1;
+  uint8_t frame;
 
   *count = 0;
-  //info page update
-  //pal_post_end_chk(&info_page_up);
-  if(info_page_up == 1) {
-    *count += 1;
-    buffer[*count-1] = 1;
-  }
 
-  //cri sel update
-  plat_chk_cri_sel_update(&cri_sel_up);
-  if(cri_sel_up == 1) {
-    *count += 1;
-    buffer[*count-1] = 2;
+  // Only frames with pages the card has not read since they changed
+  pthread_mutex_lock(&m_frame);
+  for (frame = FRAME_INFO; frame < FRAME_MAX; frame++) {
+    plat_udbg_sync_frame(frame);
+    if (g_frame[frame].dirty) {
+      *count += 1;
+      buffer[*count-1] = frame;
+    }
   }
-
-  //cri sensor update
-  *count += 1;
-  buffer[*count-1] = 3;
+  pthread_mutex_unlock(&m_frame);
 
   return 0;
 }
@@ -600,88 +815,6 @@ plat_udbg_get_gpio_desc(uint8_t index, uint8_t *next, uint8_t *level, uint8_t *d
   return 0;
 }
 
-static int
-plat_udbg_get_cri_sel(uint8_t frame, uint8_t page, uint8_t *next, uint8_t *count, uint8_t *buffer) {
-  static char frame_buff[MAX_PAGE * LEN_PER_PAGE];
-  static time_t mtime;
-  static int page_num = 1, line_num = 0;
-  int i, len, msg_line;
-  char line_buff[256], *ptr;
-  FILE *fp;
-  struct stat file_stat;
-
-  fp = fopen("/mnt/data/cri_sel", "r");
-  if (fp) {
-    if ((stat("/mnt/data/cri_sel", &file_stat) == 0) && (file_stat.st_mtime > mtime)) {
-      mtime = file_stat.st_mtime;
-      memset(frame_buff, ' ', sizeof(frame_buff));
-
-      line_num = 0;
-      while (fgets(line_buff, 256, fp)) {
-        // Remove newline
-        line_buff[strlen(line_buff)-1] = '\0';
-        ptr = line_buff;
-        // Find message
-        ptr = strstr(ptr, "local0.err");
-        if(ptr)
-          ptr = strstr(ptr, ":");
-        len = (ptr)?strlen(ptr):0;
-        if (len > 2) {
-          ptr+=2;
-          len-=2;
-        } else {
-          continue;
-        }
-
-        // line number of this 1 message
-        msg_line = (len/LEN_PER_LINE) + ((len%LEN_PER_LINE)?1:0);
-
-        // total line number after this message
-        if ((line_num + msg_line) < MAX_LINE)
-          line_num += msg_line;
-        else
-          line_num = MAX_LINE;
-
-        // Scroll message down
-        for(i = (line_num-1); (i-msg_line)>=0; i--)
-          memcpy(&frame_buff[LEN_PER_LINE*i], &frame_buff[LEN_PER_LINE*(i-msg_line)], LEN_PER_LINE);
-
-        // Write new message
-        memcpy(&frame_buff[0], ptr, len);
-        memset(&frame_buff[len], ' ', msg_line*LEN_PER_LINE-len);
-      }
-    }
-    fclose(fp);
-    page_num = line_num/LINE_PER_PAGE + ((line_num%LINE_PER_PAGE)?1:0);
-  } else {
-    memset(frame_buff, ' ', sizeof(frame_buff));
-    page_num = 1;
-    line_num = 0;
-  }
-
-  if (page > page_num) {
-    return -1;
-  }
-
-  // Frame Head
-  snprintf(line_buff, 17, "Cri SEL    %02d/%02d", page, page_num);
-  memcpy(&buffer[0], line_buff, 16); // First line
-
-  // Frame Body
-  memcpy(&buffer[16], &frame_buff[(page-1)*LEN_PER_PAGE], LEN_PER_PAGE);
-
-
-  *count = 128;
-  if (page == page_num) {
-    // Set next to 0xFF to indicate this is last page
-    *next = 0xFF;
-  } else {
-    *next = page+1;
-  }
-
-  return 0;
-}
-
 static int
 plat_udbg_fill_frame (uint8_t *buffer, int max_line, int indent, char *string) {
   int height, len, space_per_line;
@@ -708,9 +841,7 @@ plat_udbg_fill_frame (uint8_t *buffer, int max_line, int indent, char *string) {
 }
 
 static int
-plat_udbg_get_cri_sensor (uint8_t frame, uint8_t page, uint8_t *next, uint8_t *count, uint8_t *buffer) {
-  char frame_buff[MAX_PAGE * LEN_PER_PAGE];
-  int page_num;
+plat_udbg_render_cri_sensor (char *frame_buff) {
   char val[16] = {0}, str[32] = {0}, temp_val[16] = {0}, temp_thresh[5] = {0};
   float sensor_reading;
   char FilePath [] = "/tmp/cache_store/mb_sensor", SensorFilePath [50];
@@ -718,7 +849,7 @@ plat_udbg_get_cri_sensor (uint8_t frame, uint8_t page, uint8_t *next, uint8_t *c
   uint8_t thresh;
   int line_num = 0;
 
-  memset(frame_buff, ' ', sizeof(frame_buff));
+  memset(frame_buff, ' ', MAX_PAGE * LEN_PER_PAGE);
   for( i=0; i<(sensor_count-1) ; i++){
     sprintf(SensorFilePath, "%s%d", FilePath, cri_sensor[i].sensor_num);
     ret = read_device(SensorFilePath, val);
@@ -754,34 +885,17 @@ plat_udbg_get_cri_sensor (uint8_t frame, uint8_t page, uint8_t *next, uint8_t *c
     line_num += plat_udbg_fill_frame(&frame_buff[line_num * LEN_PER_LINE], MAX_LINE-line_num, 0, str);
   }
 
-  page_num = line_num/LINE_PER_PAGE + ((line_num%LINE_PER_PAGE)?1:0);
-  if (page > page_num) {
-    return -1;
-  }
-  // Frame Head
-  snprintf(str, 17, "CriSensor  %02d/%02d", page, page_num);
-  memcpy(&buffer[0], str, 16); // First line
-
-  // Frame Body
-  memcpy(&buffer[16], &frame_buff[(page-1)*LEN_PER_PAGE], LEN_PER_PAGE);
-  *count = 128;
-
-  if (page == page_num)
-    *next = 0xFF;    // Set the value of next to 0xFF to indicate this is the last page
-  else
-    *next = page+1;
-
-  return 0;
+  return line_num;
 }
 
 static int
-plat_udbg_get_info_page (uint8_t frame, uint8_t page, uint8_t *next, uint8_t *count, uint8_t *buffer) {
-  char frame_buff[MAX_PAGE * LEN_PER_PAGE];
-  int page_num = 1, line_num = 0;
+plat_udbg_render_info_page (char *frame_buff) {
+  int line_num = 0;
   int i, len, msg_line, ret;
   char line_buff[256], *ptr;
   FILE *fp;
   fruid_info_t fruid;
+  fruid_compact_t fruid_rec;
   lan_config_t lan_config = { 0 };
   unsigned char zero_ip_addr[SIZE_IP_ADDR] = { 0 };
   unsigned char zero_ip6_addr[SIZE_IP6_ADDR] = { 0 };
@@ -789,12 +903,12 @@ plat_udbg_get_info_page (uint8_t frame, uint8_t page, uint8_t *next, uint8_t *co
   ipmb_res_t *res;
   uint8_t byte;
 
-  memset(frame_buff, ' ', sizeof(frame_buff));
+  memset(frame_buff, ' ', MAX_PAGE * LEN_PER_PAGE);
 
   line_num = 0;
 
   // FRU
-  ret = fruid_parse("/tmp/fruid_mb.bin", &fruid);
+  ret = fruid_parse_cached("/tmp/fruid_mb.bin", &fruid_rec, &fruid);
   if (! ret) {
     line_num += plat_udbg_fill_frame(&frame_buff[line_num * LEN_PER_LINE], MAX_LINE-line_num,
       0, "SN:");
@@ -804,7 +918,6 @@ plat_udbg_get_info_page (uint8_t frame, uint8_t page, uint8_t *next, uint8_t *co
       0, "PN:");
     line_num += plat_udbg_fill_frame(&frame_buff[line_num * LEN_PER_LINE], MAX_LINE-line_num,
       1, fruid.board.part);
-    free_fruid_info(&fruid);
   }
 
   // LAN
@@ -905,19 +1018,41 @@ plat_udbg_get_info_page (uint8_t frame, uint8_t page, uint8_t *next, uint8_t *co
   line_num += plat_udbg_fill_frame(&frame_buff[line_num * LEN_PER_LINE], MAX_LINE-line_num,
     1, ESCAPE"R");
 
-  page_num = line_num/LINE_PER_PAGE + ((line_num%LINE_PER_PAGE)?1:0);
+  return line_num;
+}
 
-  if (page > page_num) {
+int
+plat_udbg_get_frame_data(uint8_t frame, uint8_t page, uint8_t *next, uint8_t *count, uint8_t *buffer) {
+  static const char *title[FRAME_MAX] = {
+    [FRAME_INFO] = "SYS_Info",
+    [FRAME_CRI_SEL] = "Cri SEL",
+    [FRAME_CRI_SENSOR] = "CriSensor",
+  };
+  char line_buff[17];
+  udbg_frame_t *f;
+  int page_num;
+
+  if (frame < FRAME_INFO || frame >= FRAME_MAX)
+    return -1;
+  f = &g_frame[frame];
+
+  pthread_mutex_lock(&m_frame);
+  plat_udbg_sync_frame(frame);
+
+  page_num = plat_udbg_page_num(f->line_num);
+  if (page == 0 || page > page_num) {
+    pthread_mutex_unlock(&m_frame);
     return -1;
   }
 
   // Frame Head
-  snprintf(line_buff, 17, "SYS_Info   %02d/%02d", page, page_num);
+  snprintf(line_buff, 17, "%-10s %02d/%02d", title[frame], page, page_num);
   memcpy(&buffer[0], line_buff, 16); // First line
 
   // Frame Body
-  memcpy(&buffer[16], &frame_buff[(page-1)*LEN_PER_PAGE], LEN_PER_PAGE);
-
+  memcpy(&buffer[16], &f->buff[(page-1)*LEN_PER_PAGE], LEN_PER_PAGE);
+  f->dirty &= ~(1 << (page-1));
+  pthread_mutex_unlock(&m_frame);
 
   *count = 128;
   if (page == page_num) {
@@ -929,18 +1064,3 @@ plat_udbg_get_info_page (uint8_t frame, uint8_t page, uint8_t *next, uint8_t *co
 
   return 0;
 }
-
-int
-plat_udbg_get_frame_data(uint8_t frame, uint8_t page, uint8_t *next, uint8_t *count, uint8_t *buffer) {
-
-  switch (frame) {
-    case 1: //info_page
-      return plat_udbg_get_info_page(frame, page, next, count, buffer);
-    case 2: // critical SEL
-      return plat_udbg_get_cri_sel(frame, page, next, count, buffer);
-    case 3: //critical Sensor
-      return plat_udbg_get_cri_sensor(frame, page, next, count, buffer);
-    default:
-      return -1;
-  }
-}
@@ -21,6 +21,7 @@
  */
 
 #include <stdio.h>
+#include <stdbool.h>
 #include <sys/ioctl.h>
 #include <sys/types.h>
 #include <sys/stat.h>
@@ -29,15 +30,19 @@
 #include <errno.h>
 #include <stdlib.h>
 #include <string.h>
+#include <mtd/mtd-user.h>
 
 #include <openbmc/pal.h>
 #include <openbmc/gpio.h>
+#include "bios.h"
 
 #define GPIO_BMC_CTRL        109
 #define BIOS_VER_REGION_SIZE (4*1024*1024)
 #define BIOS_ERASE_PKT_SIZE  (64*1024)
 #define BIOS_FRU_ID          (1)
 
+static uint32_t crc32_table[256];
+
 static int
 get_bios_mtd_name(char* dev)
 {
@@ -135,6 +140,212 @@ close_bail:
   return ret;
 }
 
+static uint32_t
+crc32_update(uint32_t crc, const uint8_t *buf, size_t len)
+{
+  uint32_t c;
+  int i, j;
+
+  if (!crc32_table[1]) {
+    for (i = 0; i < 256; i++) {
+      c = i;
+      for (j = 0; j < 8; j++) {
+        c = (c & 1) ? 0xEDB88320 ^ (c >> 1) : c >> 1;
+      }
+      crc32_table[i] = c;
+    }
+  }
+
+  crc = ~crc;
+  while (len--) {
+    crc = crc32_table[(crc ^ *buf++) & 0xFF] ^ (crc >> 8);
+  }
+  return ~crc;
+}
+
+static int
+pread_all(int fd, uint8_t *buf, size_t len, off_t off)
+{
+  ssize_t rcnt;
+  size_t i = 0;
+
+  while (i < len) {
+    rcnt = pread(fd, buf + i, len - i, off + i);
+    if (rcnt < 0) {
+      if (errno == EINTR)
+        continue;
+      return -1;
+    }
+    if (rcnt == 0) {
+      errno = EIO;
+      return -1;
+    }
+    i += rcnt;
+  }
+  return 0;
+}
+
+static int
+pwrite_all(int fd, const uint8_t *buf, size_t len, off_t off)
+{
+  ssize_t wcnt;
+  size_t i = 0;
+
+  while (i < len) {
+    wcnt = pwrite(fd, buf + i, len - i, off + i);
+    if (wcnt < 0) {
+      if (errno == EINTR)
+        continue;
+      return -1;
+    }
+    i += wcnt;
+  }
+  return 0;
+}
+
+// Plain files stand in for flash, with 0xFF for erased
+static int
+erase_block(int fd, bool is_mtd, uint8_t *buf, uint32_t start, uint32_t len)
+{
+  struct erase_info_user ei;
+
+  if (is_mtd) {
+    ei.start = start;
+    ei.length = len;
+    return ioctl(fd, MEMERASE, &ei);
+  }
+  memset(buf, 0xFF, len);
+  return pwrite_all(fd, buf, len, start);
+}
+
+static bool
+is_erased(const uint8_t *buf, uint32_t len)
+{
+  while (len--) {
+    if (*buf++ != 0xFF)
+      return false;
+  }
+  return true;
+}
+
+int bios_mtd_program(const char *dev, const char *file)
+{
+  struct mtd_info_user info;
+  struct stat st;
+  uint8_t *img = NULL, *flash = NULL, *tmp = NULL;
+  uint32_t block, blocks, len, start, img_crc = 0, flash_crc = 0, rewritten = 0;
+  int fd = -1, ifd = -1, ret = -1, retry;
+  bool is_mtd = true;
+
+  ifd = open(file, O_RDONLY);
+  if (ifd < 0 || fstat(ifd, &st)) {
+    printf("ERROR: Cannot open %s: %s\n", file, strerror(errno));
+    goto bail;
+  }
+
+  fd = open(dev, O_RDWR | O_SYNC);
+  if (fd < 0) {
+    printf("ERROR: Cannot open %s: %s\n", dev, strerror(errno));
+    goto bail;
+  }
+  if (ioctl(fd, MEMGETINFO, &info)) {
+    struct stat dst;
+
+    if (errno != ENOTTY || fstat(fd, &dst)) {
+      printf("ERROR: MEMGETINFO on %s failed: %s\n", dev, strerror(errno));
+      goto bail;
+    }
+    is_mtd = false;
+    info.size = dst.st_size;
+    info.erasesize = BIOS_ERASE_PKT_SIZE;
+  }
+  if (st.st_size == 0 || (uint64_t)st.st_size > info.size ||
+      info.erasesize == 0) {
+    printf("ERROR: %s does not fit %s\n", file, dev);
+    goto bail;
+  }
+
+  img = (uint8_t *)malloc(info.erasesize);
+  flash = (uint8_t *)malloc(info.erasesize);
+  tmp = (uint8_t *)malloc(info.erasesize);
+  if (!img || !flash || !tmp) {
+    goto bail;
+  }
+
+  blocks = (st.st_size + info.erasesize - 1) / info.erasesize;
+  for (block = 0; block < blocks; block++) {
+    start = block * info.erasesize;
+    len = st.st_size - start < info.erasesize ? st.st_size - start : info.erasesize;
+
+    if (pread_all(fd, flash, info.erasesize, start) ||
+        pread_all(ifd, img, len, start)) {
+      printf("\nERROR: Read of block %u failed: %s\n", block, strerror(errno));
+      goto bail;
+    }
+    img_crc = crc32_update(img_crc, img, len);
+
+    if (memcmp(flash, img, len)) {
+      // Keep what is past the end of the image in the last block
+      memcpy(flash, img, len);
+      for (retry = 0; ; retry++) {
+        if (erase_block(fd, is_mtd, tmp, start, info.erasesize) ||
+            (!is_erased(flash, info.erasesize) &&
+             pwrite_all(fd, flash, info.erasesize, start)) ||
+            pread_all(fd, tmp, info.erasesize, start)) {
+          printf("\nERROR: Programming block %u failed: %s\n", block,
+                 strerror(errno));
+          goto bail;
+        }
+        if (crc32_update(0, tmp, info.erasesize) ==
+            crc32_update(0, flash, info.erasesize)) {
+          break;
+        }
+        if (retry) {
+          printf("\nERROR: Verify of block %u failed\n", block);
+          goto bail;
+        }
+      }
+      rewritten++;
+    }
+
+    printf("Programming: %u/%u blocks (%.2f%%), %u rewritten \r", block + 1,
+           blocks, ((block + 1) / (float)blocks) * 100, rewritten);
+    fflush(stdout);
+  }
+  printf("\n");
+
+  // Read the whole image back from the device
+  for (block = 0; block < blocks; block++) {
+    start = block * info.erasesize;
+    len = st.st_size - start < info.erasesize ? st.st_size - start : info.erasesize;
+
+    if (pread_all(fd, tmp, len, start)) {
+      printf("ERROR: Read back of block %u failed: %s\n", block, strerror(errno));
+      goto bail;
+    }
+    flash_crc = crc32_update(flash_crc, tmp, len);
+  }
+
+  if (flash_crc != img_crc) {
+    printf("ERROR: CRC32 of %s is 0x%08X, expected 0x%08X\n", dev, flash_crc,
+           img_crc);
+    goto bail;
+  }
+  printf("Verified: CRC32 0x%08X, %u of %u blocks rewritten\n", img_crc,
+         rewritten, blocks);
+  ret = 0;
+
+bail:
+  free(img);
+  free(flash);
+  free(tmp);
+  if (fd >= 0)
+    close(fd);
+  if (ifd >= 0)
+    close(ifd);
+  return ret;
+}
+
 int bios_get_ver(uint8_t slot_id, char *ver)
 {
   uint8_t sysfw_ver[32] = {0};
@@ -159,7 +370,6 @@ int bios_get_ver(uint8_t slot_id, char *ver)
 int bios_program(uint8_t slot_id, const char *file)
 {
   int exit_code;
-  char cmd[80];
   char mtddev[32];
   gpio_st bmc_ctrl_pin;
 
@@ -188,9 +398,7 @@ int bios_program(uint8_t slot_id, const char *file)
     printf("ERROR: Could not get MTD device for the BIOS!\n");
     return -1;
   }
-  snprintf(cmd, sizeof(cmd), "flashcp -v %s %s", file, mtddev);
-  exit_code = system(cmd);
-  exit_code = exit_code == -1 ? 127 : WEXITSTATUS(exit_code);
+  exit_code = bios_mtd_program(mtddev, file);
 
   system("echo -n \"spi1.0\" > /sys/bus/spi/drivers/m25p80/unbind");
   gpio_write(&bmc_ctrl_pin, GPIO_VALUE_LOW);
@@ -28,6 +28,12 @@ extern "C" {
 
 int bios_get_ver(uint8_t slot_id, char *ver);
 int bios_program(uint8_t slot_id, const char *file);
+/*
+ * Write file to the flash at dev, erasing and writing only the erase
+ * blocks that differ. dev may also be a plain file, taken as flash with
+ * 64KB erase blocks, e.g. to try the update against a copy of the flash.
+ */
+int bios_mtd_program(const char *dev, const char *file);
 
 #ifdef __cplusplus
 } // extern "C"
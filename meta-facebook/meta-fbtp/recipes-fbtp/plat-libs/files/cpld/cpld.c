@@ -100,12 +100,27 @@ int cpld_get_device_id(unsigned int *dev_id)
 	return 0;
 }
 
-int cpld_verify(void)
+/* Compare the CPLD with JEDFILE without programming it; 0 if they match */
+int cpld_verify(char *JEDFILE)
 {
-	if (cur_dev == NULL || fp_in == NULL)
+	int ret;
+
+	if (cur_dev == NULL || cur_dev->cpld_verify == NULL) {
+		printf("[%s] Cannot get pointer from DEVICE!\n", __func__);
+		return -1;
+	}
+
+	fp_in = fopen(JEDFILE, "r");
+	if (fp_in == NULL) {
+		printf("[%s] Cannot Open File!\n", __func__);
 		return -1;
+	}
+
+	ret = cur_dev->cpld_verify(fp_in);
+	fclose(fp_in);
+	fp_in = NULL;
 
-	return cur_dev->cpld_verify(fp_in);
+	return ret;
 }
 
 int cpld_program(char *JEDFILE)
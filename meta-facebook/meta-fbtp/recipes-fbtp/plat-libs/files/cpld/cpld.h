@@ -31,7 +31,7 @@ int cpld_get_ver(unsigned int *ver);
 int cpld_get_device_id(unsigned int *dev_id);
 int cpld_erase(void);
 int cpld_program(char *JEDFILE);
-int cpld_verify(void);
+int cpld_verify(char *JEDFILE);
 
 #ifdef __cplusplus
 } // extern "C"
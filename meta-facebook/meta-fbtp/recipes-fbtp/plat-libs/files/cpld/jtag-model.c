@@ -0,0 +1,272 @@
+/*
+ * jtag-model CPLD module
+ *
+ * Copyright 2017-present Facebook. All Rights Reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+/*
+ * Software stand-in for ast-jtag.c: the same calls, answered by a model
+ * of an LCMXO2-4000HC behind the JTAG master instead of /dev/ast-jtag.
+ * It keeps the configuration flash, the UFM and the usercode, goes busy
+ * for a while after erase and program commands, and counts the JTAG
+ * operations, so the programming flow can be run and timed on a host.
+ *
+ * JTAG_MODEL_FILE names a file the flash is loaded from on open and
+ * saved to on close. JTAG_MODEL_OP_US adds that much time to every JTAG
+ * operation, standing in for the ioctl and the shifting on real hardware.
+ * The counts go to stderr on close.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "lattice.h"
+#include "ast-jtag.h"
+
+#define MODEL_IDCODE		0x012BC043	//LCMXO2-4000HC
+#define MODEL_CF_ROWS		9212
+#define MODEL_UFM_ROWS		767
+#define MODEL_ROW_WORDS		4		//128 bit rows
+#define MODEL_PROGRAM_US	200
+#define MODEL_ERASE_US		(100 * 1000)
+
+struct jtag_model {
+	unsigned int	cf[MODEL_CF_ROWS][MODEL_ROW_WORDS];
+	unsigned int	ufm[MODEL_UFM_ROWS][MODEL_ROW_WORDS];
+	unsigned int	usercode;
+	unsigned int	usercode_in;
+	unsigned int	ir;
+	unsigned int	(*rows)[MODEL_ROW_WORDS];
+	unsigned int	nrows;
+	unsigned int	addr;
+	unsigned int	freq;
+	unsigned long long busy_until;
+	unsigned int	op_us;
+	/* counts */
+	unsigned int	sir;
+	unsigned int	sdr;
+	unsigned int	runtest;
+	unsigned int	polls;
+	unsigned int	programmed;
+	unsigned int	read;
+	unsigned int	while_busy;
+};
+
+static struct jtag_model *model;
+
+static unsigned long long now_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (unsigned long long)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+// Time the operation would take on the hardware
+static void model_op(void)
+{
+	unsigned long long end;
+
+	if (model->op_us) {
+		end = now_us() + model->op_us;
+		while (now_us() < end);
+	}
+}
+
+static int model_busy(void)
+{
+	return now_us() < model->busy_until;
+}
+
+static void model_set_busy(unsigned int us)
+{
+	if (model_busy())
+		model->while_busy++;
+	model->busy_until = now_us() + us;
+}
+
+int ast_jtag_open(void)
+{
+	const char *file = getenv("JTAG_MODEL_FILE");
+	const char *op_us = getenv("JTAG_MODEL_OP_US");
+	FILE *fp;
+
+	model = calloc(1, sizeof(*model));
+	if (!model)
+		return -1;
+	model->rows = model->cf;
+	model->nrows = MODEL_CF_ROWS;
+	if (op_us)
+		model->op_us = atoi(op_us);
+
+	if (file && (fp = fopen(file, "r"))) {
+		if (fread(model->cf, sizeof(model->cf), 1, fp) != 1 ||
+		    fread(model->ufm, sizeof(model->ufm), 1, fp) != 1 ||
+		    fread(&model->usercode, sizeof(model->usercode), 1, fp) != 1)
+			fprintf(stderr, "jtag-model: short %s, starting erased\n", file);
+		fclose(fp);
+	}
+
+	return 0;
+}
+
+void ast_jtag_close(void)
+{
+	const char *file = getenv("JTAG_MODEL_FILE");
+	FILE *fp;
+
+	if (!model)
+		return;
+
+	if (file && (fp = fopen(file, "w"))) {
+		fwrite(model->cf, sizeof(model->cf), 1, fp);
+		fwrite(model->ufm, sizeof(model->ufm), 1, fp);
+		fwrite(&model->usercode, sizeof(model->usercode), 1, fp);
+		fclose(fp);
+	}
+
+	fprintf(stderr, "jtag-model: %u SIR, %u SDR, %u RUNTEST, %u busy polls, "
+		"%u rows programmed, %u read, %u commands while busy\n",
+		model->sir, model->sdr, model->runtest, model->polls,
+		model->programmed, model->read, model->while_busy);
+	free(model);
+	model = NULL;
+}
+
+unsigned int ast_get_jtag_freq(void)
+{
+	return model ? model->freq : 0;
+}
+
+int ast_set_jtag_freq(unsigned int freq)
+{
+	if (!model)
+		return -1;
+	model->freq = freq;
+	return 0;
+}
+
+int ast_jtag_run_test_idle(unsigned char reset, unsigned char end, unsigned char tck)
+{
+	if (!model)
+		return -1;
+	model_op();
+	model->runtest++;
+	return 0;
+}
+
+unsigned int ast_jtag_sir_xfer(unsigned char endir, unsigned int len, unsigned int tdi)
+{
+	if (!model || len > 32)
+		return -1;
+	model_op();
+	model->sir++;
+	model->ir = tdi;
+
+	switch (tdi) {
+	case LCMXO2_LSC_INIT_ADDRESS:
+		model->rows = model->cf;
+		model->nrows = MODEL_CF_ROWS;
+		model->addr = 0;
+		break;
+	case LCMXO2_LSC_INIT_ADDR_UFM:
+		model->rows = model->ufm;
+		model->nrows = MODEL_UFM_ROWS;
+		model->addr = 0;
+		break;
+	case LCMXO2_ISC_PROGRAM_USERCOD:
+		model->usercode = model->usercode_in;
+		model_set_busy(MODEL_PROGRAM_US);
+		break;
+	default:
+		break;
+	}
+
+	return 0;
+}
+
+int ast_jtag_tdi_xfer(unsigned char enddr, unsigned int len, unsigned int *tdio)
+{
+	if (!model)
+		return -1;
+	model_op();
+	model->sdr++;
+
+	switch (model->ir) {
+	case LCMXO2_ISC_ERASE:
+		// Erased flash reads back as zeroes
+		if (tdio[0] & 0x4)
+			memset(model->cf, 0, sizeof(model->cf));
+		if (tdio[0] & 0x8)
+			memset(model->ufm, 0, sizeof(model->ufm));
+		model_set_busy(MODEL_ERASE_US);
+		break;
+	case LCMXO2_LSC_PROG_INCR_NV:
+		if (model->addr < model->nrows)
+			memcpy(model->rows[model->addr++], tdio,
+			       MODEL_ROW_WORDS * sizeof(unsigned int));
+		model->programmed++;
+		model_set_busy(MODEL_PROGRAM_US);
+		break;
+	case LCMXO2_USERCODE:
+		model->usercode_in = tdio[0];
+		break;
+	default:
+		break;
+	}
+
+	return 0;
+}
+
+int ast_jtag_tdo_xfer(unsigned char enddr, unsigned int len, unsigned int *tdio)
+{
+	unsigned int words = (len + 31) / 32;
+
+	if (!model)
+		return -1;
+	model_op();
+	model->sdr++;
+	memset(tdio, 0, words * sizeof(unsigned int));
+
+	switch (model->ir) {
+	case LCMXO2_IDCODE_PUB:
+		tdio[0] = MODEL_IDCODE;
+		break;
+	case LCMXO2_LSC_CHECK_BUSY:
+		model->polls++;
+		tdio[0] = model_busy() ? 0x80 : 0;
+		break;
+	case LCMXO2_LSC_READ_STATUS:
+		tdio[0] = model_busy() ? 0x1000 : 0;
+		break;
+	case LCMXO2_LSC_READ_INCR_NV:
+		if (model->addr < model->nrows && words >= MODEL_ROW_WORDS)
+			memcpy(tdio, model->rows[model->addr++],
+			       MODEL_ROW_WORDS * sizeof(unsigned int));
+		model->read++;
+		break;
+	case LCMXO2_USERCODE:
+		tdio[0] = model->usercode;
+		break;
+	default:
+		break;
+	}
+
+	return 0;
+}
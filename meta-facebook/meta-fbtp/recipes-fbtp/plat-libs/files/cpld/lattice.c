@@ -8,6 +8,7 @@
 #include <getopt.h>
 #include <string.h>
 #include <termios.h>
+#include <time.h>
 
 #include <sys/mman.h>
 #include "lattice.h"
@@ -15,6 +16,19 @@
 
 #define MAX_RETRY 1000
 #define LATTICE_COL_SIZE 128
+#define LATTICE_ROW_WORDS (LATTICE_COL_SIZE / 32)
+
+/*
+ * Busy polling. A row takes a couple of hundred microseconds to program,
+ * an erase a good deal longer, so start polling quickly and back off;
+ * give up after as long as MAX_RETRY 1ms polls used to take.
+ */
+#define POLL_MIN_US 50
+#define POLL_MAX_US 1000
+#define POLL_TIMEOUT_US (MAX_RETRY * 1000)
+
+/* Rows that differ are listed up to this many per array when verifying */
+#define VERIFY_REPORT_ROWS 8
 #define ARRAY_SIZE(x) (sizeof(x) / sizeof((x)[0]))
 
 typedef struct
@@ -139,230 +153,213 @@ ShiftData(unsigned char *data, unsigned int *result, int len)
   return RetVal;
 }
 
+static unsigned int
+LCMXO2Family_Time_Us(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+
+  return ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/*
+ * Poll the busy flag or the status bits until the device is done.
+ * expect_us is how long the operation should take: most of it is slept
+ * off before the first read, then the poll interval doubles from
+ * POLL_MIN_US up to POLL_MAX_US. Returns the time waited in us, or -1
+ * on a timeout or when the status reads back the fail bit.
+ */
 static int
-LCMXO2Family_Check_Device_Status(int mode)
+LCMXO2Family_Wait_Device(int mode, unsigned int expect_us)
 {
-  int RetVal = 0;
-  int RETRY = MAX_RETRY;
+  unsigned int start = LCMXO2Family_Time_Us();
+  unsigned int delay = POLL_MIN_US;
+  unsigned int elapsed;
   unsigned int buf[4]={0};
 
   switch (mode)
   {
       case CHECK_BUSY:
-          ast_jtag_run_test_idle( 0, 0, 3);
           ast_jtag_sir_xfer(1, LATTICE_INS_LENGTH, LCMXO2_LSC_CHECK_BUSY);
+          break;
 
-          do
-          {
-            usleep(1000);
-
-            buf[0] = 0;
-
-            ast_jtag_tdo_xfer(0, 32, &buf[0]);
+      case CHECK_STATUS:
+          ast_jtag_sir_xfer(0, LATTICE_INS_LENGTH, LCMXO2_LSC_READ_STATUS);
+          break;
 
-            buf[0] = (buf[0] >> 7) & 0x1;
+      default:
+          return 0;
+  }
 
-            if ( 0 == buf[0] )
-            {
-              break;
-            }
-#ifdef CPLD_DEBUG
-            else
-            {
-              printf("[%s][LCMXO2_LSC_CHECK_BUSY(0xF0)]%x\n",__func__ ,buf[0]);
-            }
-#endif
-            RETRY--;
+  if ( expect_us > POLL_TIMEOUT_US )
+  {
+    expect_us = POLL_TIMEOUT_US;
+  }
 
-          } while( RETRY );
+  if ( expect_us )
+  {
+    usleep(expect_us * 3 / 4);
+  }
 
-          if ( !RETRY )
-          {
-            RetVal = -1;
-          }
+  while ( 1 )
+  {
+    buf[0] = 0;
 
-      break;
+    ast_jtag_tdo_xfer(0, 32, &buf[0]);
 
-      case CHECK_STATUS:
-          ast_jtag_run_test_idle( 0, 0, 3);
-          ast_jtag_sir_xfer(0, LATTICE_INS_LENGTH, LCMXO2_LSC_READ_STATUS);
-          do
-          {
-            usleep(1000);
+    elapsed = LCMXO2Family_Time_Us() - start;
 
-            buf[0] = 0;
+    if ( CHECK_BUSY == mode )
+    {
+      buf[0] = (buf[0] >> 7) & 0x1;
+    }
+    else
+    {
+      //bit 12 is busy, bit 13 fail
+      buf[0] = (buf[0] >> 12) & 0x3;
 
-            ast_jtag_tdo_xfer(0, 32, &buf[0]);
+      if ( buf[0] & 0x2 )
+      {
+        printf("[%s][LCMXO2_LSC_READ_STATUS(0x3C)] Fail bit set\n", __func__);
 
-            buf[0] = (buf[0] >> 12) & 0x3;
+        return -1;
+      }
+    }
 
-            if ( 0 == buf[0] )
-            {
-              break;
-            }
+    if ( 0 == buf[0] )
+    {
+      break;
+    }
 #ifdef CPLD_DEBUG
-            else
-            {
-                printf("[%s][LCMXO2_LSC_READ_STATUS(0x3C)]%x\n",__func__ ,buf[0]);
-            }
+    else
+    {
+      printf("[%s][%s]%x\n", __func__, (CHECK_BUSY == mode) ? "LCMXO2_LSC_CHECK_BUSY(0xF0)" : "LCMXO2_LSC_READ_STATUS(0x3C)", buf[0]);
+    }
 #endif
-            RETRY--;
-          }
-          while ( RETRY );
 
-          if ( !RETRY )
-          {
-              RetVal = -1;
-          }
+    if ( elapsed >= POLL_TIMEOUT_US )
+    {
+      return -1;
+    }
 
-      break;
+    usleep(delay);
 
-      default:
-        break;
+    delay *= 2;
 
+    if ( delay > POLL_MAX_US )
+    {
+      delay = POLL_MAX_US;
+    }
   }
 
-  return RetVal;
+  return elapsed;
 }
 
-/*write cf data*/
 static int
-LCMXO2Family_SendCFdata(CPLDInfo *dev_info)
+LCMXO2Family_Check_Device_Status(int mode)
 {
-  int RetVal = 0;
-  int CurrentAddr = 0;
-  int i;
+  ast_jtag_run_test_idle( 0, 0, 3);
 
-  for ( i = 0; i < dev_info->CF_Line; i++ )
+  if ( LCMXO2Family_Wait_Device(mode, 0) < 0 )
   {
-    printf("Writing Data: %d/%d (%.2f%%) \r",(i+1), dev_info->CF_Line, (((i+1)/(float)dev_info->CF_Line)*100));
-
-    CurrentAddr = (i * LATTICE_COL_SIZE) / 32;
-
-    //RUNTEST    IDLE    15 TCK    1.00E-003 SEC;
-    ast_jtag_run_test_idle( 0, 0, 3);
-
-    //set page to program page
-    ast_jtag_sir_xfer(1, LATTICE_INS_LENGTH, LCMXO2_LSC_PROG_INCR_NV);
-
-    //send data
-    ast_jtag_tdi_xfer(0, LATTICE_COL_SIZE, &dev_info->CF[CurrentAddr]);
-
-    //usleep(1000);
+    return -1;
+  }
 
-    RetVal = LCMXO2Family_Check_Device_Status(CHECK_BUSY);
+  return 0;
+}
 
-    if ( RetVal < 0 )
-    {
-      printf("[%s]Write CF Error\n", __func__);
-    }
+/*print progress when the percentage changes rather than for every row*/
+static void
+LCMXO2Family_Progress(const char *action, const char *what, int current, int total)
+{
+  int percent = (current * 100) / total;
 
+  if ( current > 1 && percent == ((current - 1) * 100) / total )
+  {
+    return;
   }
 
-  printf("\n");
-
-  return RetVal;
+  printf("%s %s Data: %d/%d (%d%%) \r", action, what, current, total, percent);
+  fflush(stdout);
 }
 
-/*write ufm data if need*/
+/*
+ * Write rows from the address LSC_INIT_ADDRESS or LSC_INIT_ADDR_UFM set
+ * on. The busy read of the previous row leaves the TAP in idle, so a row
+ * is the program instruction, the data, the idle clocks the command runs
+ * on and the busy check, and the check sleeps through what rows have
+ * taken so far before it starts polling.
+ */
 static int
-LCMXO2Family_SendUFMdata(CPLDInfo *dev_info)
+LCMXO2Family_Send_Rows(const char *what, unsigned int *rows, unsigned int lines)
 {
-  int RetVal = 0;
-  int CurrentAddr = 0;
+  static unsigned int row_busy_us;
+  int busy_us;
   int i;
 
-  for ( i = 0; i < dev_info->UFM_Line; i++ )
+  for ( i = 0; i < lines; i++ )
   {
-    CurrentAddr = (i * LATTICE_COL_SIZE) / 32;
-
-    //RUNTEST    IDLE    15 TCK    1.00E-003 SEC;
-    ast_jtag_run_test_idle( 0, 0, 3);
+    LCMXO2Family_Progress("Writing", what, i + 1, lines);
 
     //set page to program page
     ast_jtag_sir_xfer(1, LATTICE_INS_LENGTH, LCMXO2_LSC_PROG_INCR_NV);
 
     //send data
-    ast_jtag_tdi_xfer(0, LATTICE_COL_SIZE, &dev_info->UFM[CurrentAddr]);
+    ast_jtag_tdi_xfer(0, LATTICE_COL_SIZE, &rows[i * LATTICE_ROW_WORDS]);
 
-    //usleep(1000);
+    //RUNTEST    IDLE    2 TCK;
+    ast_jtag_run_test_idle( 0, 0, 3);
 
-    RetVal = LCMXO2Family_Check_Device_Status(CHECK_BUSY);
+    busy_us = LCMXO2Family_Wait_Device(CHECK_BUSY, row_busy_us);
 
-    if ( RetVal < 0 )
+    if ( busy_us < 0 )
     {
-      printf("[%s]Write UFM Error\n", __func__);
+      printf("\n[%s]Write %s Error at row %d\n", __func__, what, i);
+
+      return -1;
     }
 
+    row_busy_us = (row_busy_us * 3 + busy_us) / 4;
   }
 
-  return RetVal;
+  printf("\n");
+
+  return 0;
 }
 
-/*check the size of cf and ufm*/
-static int
-LCMXO2Family_Get_Update_Data_Size(FILE *jed_fd, int *cf_size, int *ufm_size)
+/*
+ * Make room for row 'line' in a row array, doubling the array when it is
+ * full, and return the row zeroed for ShiftData() to OR the bits into.
+ */
+static unsigned int *
+LCMXO2Family_Add_Row(unsigned int **rows, unsigned int *size, unsigned int line)
 {
-  const char TAG_CF_START[]="L000";
-  int ReadLineSize = LATTICE_COL_SIZE;
-  unsigned char tmp_buf[ReadLineSize];
-  unsigned int CFStart = 0;
-  unsigned int UFMStart = 0;
-  const char TAG_UFM[]="NOTE TAG DATA";
-  int RetVal = 0;
+  unsigned int *tmp;
+  unsigned int new_size;
 
-  while( NULL != fgets(tmp_buf, ReadLineSize, jed_fd) )
+  if ( line >= *size )
   {
-    if ( startWith(tmp_buf, TAG_CF_START/*"L000"*/) )
-    {
-      CFStart = 1;
-    }
-    else if ( startWith(tmp_buf, TAG_UFM/*"NOTE TAG DATA"*/) )
-    {
-      UFMStart = 1;
-    }
+    new_size = (*size) ? (*size * 2) : 1024;
 
-    if ( CFStart )
-    {
-      if ( !startWith(tmp_buf, TAG_CF_START/*"L000"*/) && strlen(tmp_buf) != 1 )
-      {
-        if ( startWith(tmp_buf,"0") || startWith(tmp_buf,"1") )
-        {
-          (*cf_size)++;
-        }
-        else
-        {
-           CFStart = 0;
-        }
-      }
-    }
-    else if ( UFMStart )
+    tmp = (unsigned int*)realloc(*rows, (new_size * LATTICE_COL_SIZE) / 8);
+
+    if ( NULL == tmp )
     {
-      if ( !startWith(tmp_buf, TAG_UFM/*"NOTE TAG DATA"*/) && !startWith(tmp_buf, "L") && strlen(tmp_buf) != 1 )
-      {
-        if ( startWith(tmp_buf,"0") || startWith(tmp_buf,"1") )
-        {
-          (*ufm_size)++;
-        }
-        else
-        {
-          UFMStart = 0;
-        }
-      }
+      return NULL;
     }
-  }
 
-  //cf must greater than 0
-  if ( !(*cf_size) )
-  {
-    RetVal = -1;
+    *rows = tmp;
+    *size = new_size;
   }
 
-  return RetVal;
+  memset(&(*rows)[line * LATTICE_ROW_WORDS], 0, LATTICE_COL_SIZE / 8);
+
+  return &(*rows)[line * LATTICE_ROW_WORDS];
 }
 
 static int
-LCMXO2Family_JED_File_Parser(FILE *jed_fd, CPLDInfo *dev_info, int cf_size, int ufm_size)
+LCMXO2Family_JED_File_Parser(FILE *jed_fd, CPLDInfo *dev_info)
 {
   /**TAG Information**/
   const char TAG_QF[]="QF";
@@ -382,21 +379,12 @@ LCMXO2Family_JED_File_Parser(FILE *jed_fd, CPLDInfo *dev_info, int cf_size, int
   unsigned int VersionStart = 0;
   unsigned int ChkSUMStart = 0;
   unsigned int JED_CheckSum = 0;
+  unsigned int cf_size = 0;  // unit: rows
+  unsigned int ufm_size = 0; // unit: rows
+  unsigned int *row;
   int copy_size;
-  int current_addr=0;
   int i;
   int RetVal = 0;
-  int cf_size_used = (cf_size * LATTICE_COL_SIZE) / 8; // unit: bytes
-  int ufm_size_used = (ufm_size * LATTICE_COL_SIZE) / 8; // unit: bytes
-
-  dev_info->CF = (unsigned int*)malloc( cf_size_used );
-  memset(dev_info->CF, 0, cf_size_used);
-
-  if ( ufm_size_used )
-  {
-    dev_info->UFM = (unsigned int*)malloc( ufm_size_used );
-    memset(dev_info->UFM, 0, ufm_size_used);
-  }
 
   dev_info->CF_Line=0;
   dev_info->UFM_Line=0;
@@ -462,24 +450,31 @@ LCMXO2Family_JED_File_Parser(FILE *jed_fd, CPLDInfo *dev_info, int cf_size, int
       {
         if ( startWith(tmp_buf,"0") || startWith(tmp_buf,"1") )
         {
-          current_addr = (dev_info->CF_Line * LATTICE_COL_SIZE) / 32;
+          row = LCMXO2Family_Add_Row(&dev_info->CF, &cf_size, dev_info->CF_Line);
+
+          if ( NULL == row )
+          {
+            printf("[%s] Cannot allocate CF row %d\n", __func__, dev_info->CF_Line);
+
+            return -1;
+          }
 
           memset(data_buf, 0, sizeof(data_buf));
 
           memcpy(data_buf, tmp_buf, LATTICE_COL_SIZE);
 
           /*convert string to byte data*/
-          ShiftData(data_buf, &dev_info->CF[current_addr], LATTICE_COL_SIZE);
+          ShiftData(data_buf, row, LATTICE_COL_SIZE);
 #ifdef CPLD_DEBUG
-          printf("[%d]%x %x %x %x\n",dev_info->CF_Line, dev_info->CF[current_addr],dev_info->CF[current_addr+1],dev_info->CF[current_addr+2],dev_info->CF[current_addr+3]);
+          printf("[%d]%x %x %x %x\n",dev_info->CF_Line, row[0], row[1], row[2], row[3]);
 #endif
           //each data has 128bits(4*unsigned int), so the for-loop need to be run 4 times
-          for ( i = 0; i < sizeof(unsigned int); i++ )
+          for ( i = 0; i < LATTICE_ROW_WORDS; i++ )
           {
-            JED_CheckSum += (dev_info->CF[current_addr+i]>>24) & 0xff;
-            JED_CheckSum += (dev_info->CF[current_addr+i]>>16) & 0xff;
-            JED_CheckSum += (dev_info->CF[current_addr+i]>>8)  & 0xff;
-            JED_CheckSum += (dev_info->CF[current_addr+i])     & 0xff;
+            JED_CheckSum += (row[i]>>24) & 0xff;
+            JED_CheckSum += (row[i]>>16) & 0xff;
+            JED_CheckSum += (row[i]>>8)  & 0xff;
+            JED_CheckSum += (row[i])     & 0xff;
           }
 
             dev_info->CF_Line++;
@@ -564,15 +559,22 @@ LCMXO2Family_JED_File_Parser(FILE *jed_fd, CPLDInfo *dev_info, int cf_size, int
       {
         if ( startWith(tmp_buf,"0") || startWith(tmp_buf,"1") )
         {
-          current_addr = (dev_info->UFM_Line * LATTICE_COL_SIZE) / 32;
+          row = LCMXO2Family_Add_Row(&dev_info->UFM, &ufm_size, dev_info->UFM_Line);
+
+          if ( NULL == row )
+          {
+            printf("[%s] Cannot allocate UFM row %d\n", __func__, dev_info->UFM_Line);
+
+            return -1;
+          }
 
           memset(data_buf, 0, sizeof(data_buf));
 
           memcpy(data_buf, tmp_buf, LATTICE_COL_SIZE);
 
-          ShiftData(data_buf, &dev_info->UFM[current_addr], LATTICE_COL_SIZE);
+          ShiftData(data_buf, row, LATTICE_COL_SIZE);
 #ifdef CPLD_DEBUG
-          printf("%x %x %x %x\n",dev_info->UFM[current_addr],dev_info->UFM[current_addr+1],dev_info->UFM[current_addr+2],dev_info->UFM[current_addr+3]);
+          printf("%x %x %x %x\n", row[0], row[1], row[2], row[3]);
 #endif
           dev_info->UFM_Line++;
         }
@@ -587,6 +589,14 @@ LCMXO2Family_JED_File_Parser(FILE *jed_fd, CPLDInfo *dev_info, int cf_size, int
     }
   }
 
+  //cf must greater than 0
+  if ( !dev_info->CF_Line )
+  {
+    printf("[%s] No CF data in JED File\n", __func__);
+
+    return -1;
+  }
+
   JED_CheckSum = JED_CheckSum & 0xffff;
 
   if ( dev_info->CheckSum != JED_CheckSum || dev_info->CheckSum == 0)
@@ -604,20 +614,27 @@ LCMXO2Family_JED_File_Parser(FILE *jed_fd, CPLDInfo *dev_info, int cf_size, int
   return RetVal;
 }
 
+/*
+ * Read back the rows of the array init_ins (LSC_INIT_ADDRESS or
+ * LSC_INIT_ADDR_UFM) selects and compare them with the file. Returns the
+ * number of rows that differ; with report set the first few are listed.
+ */
 static int
-LCMXO2Family_cpld_verify(CPLDInfo *dev_info)
+LCMXO2Family_Compare_Rows(const char *what, unsigned int init_ins, unsigned int *rows, unsigned int lines, int report)
 {
+  unsigned int buff[LATTICE_ROW_WORDS]={0};
+  unsigned int diff_row[VERIFY_REPORT_ROWS];
+  int diff = 0;
   int i;
-  int result;
-  int current_addr = 0;
-  unsigned int buff[4]={0};
-  int err = 0;
 
   ast_jtag_run_test_idle( 0, 0, 3);
-  ast_jtag_sir_xfer(0, LATTICE_INS_LENGTH, LCMXO2_LSC_INIT_ADDRESS);
+  ast_jtag_sir_xfer(0, LATTICE_INS_LENGTH, init_ins);
 
-  buff[0] = 0x04;
-  ast_jtag_tdi_xfer( 0, LATTICE_INS_LENGTH, &buff[0]);
+  if ( LCMXO2_LSC_INIT_ADDRESS == init_ins )
+  {
+    buff[0] = 0x04;
+    ast_jtag_tdi_xfer( 0, LATTICE_INS_LENGTH, &buff[0]);
+  }
   usleep(1000);
 
   ast_jtag_run_test_idle( 0, 0, 3);
@@ -625,41 +642,96 @@ LCMXO2Family_cpld_verify(CPLDInfo *dev_info)
   usleep(1000);
 
 #ifdef CPLD_DEBUG
-  printf("[%s] dev_info->CF_Line: %d\n", __func__, dev_info->CF_Line);
+  printf("[%s] %s lines: %d\n", __func__, what, lines);
 #endif
 
-  for(i = 0; i < dev_info->CF_Line; i++)
+  for ( i = 0; i < lines; i++ )
   {
-    printf("Verify Data: %d/%d (%.2f%%) \r",(i+1), dev_info->CF_Line, (((i+1)/(float)dev_info->CF_Line)*100));
-
-    current_addr = (i * LATTICE_COL_SIZE) / 32;
+    LCMXO2Family_Progress("Verify", what, i + 1, lines);
 
     memset(buff, 0, sizeof(buff));
 
     ast_jtag_tdo_xfer( 0, LATTICE_COL_SIZE, buff);
 
-    result = memcmp(buff, &dev_info->CF[current_addr], sizeof(unsigned int));
+    if ( memcmp(buff, &rows[i * LATTICE_ROW_WORDS], sizeof(buff)) )
+    {
+      if ( diff < VERIFY_REPORT_ROWS )
+      {
+        diff_row[diff] = i;
+      }
+
+      diff++;
+    }
+  }
+
+  printf("\n");
 
-    if ( result )
+  if ( report )
+  {
+    for ( i = 0; i < diff && i < VERIFY_REPORT_ROWS; i++ )
     {
-      err = 1;
+      printf("%s row %d differs\n", what, diff_row[i]);
+    }
 
-      break;
+    if ( diff > VERIFY_REPORT_ROWS )
+    {
+      printf("%s: %d more rows differ\n", what, diff - VERIFY_REPORT_ROWS);
     }
+  }
 
-    //usleep(3000);
+  return diff;
+}
+
+/*
+ * Compare the CF, the UFM if the file has any, and the usercode in the
+ * device with the file, counting the usercode as one row.
+ */
+static int
+LCMXO2Family_cpld_Compare(CPLDInfo *dev_info, int report)
+{
+  unsigned int dr_data[4]={0};
+  int diff;
+
+  diff = LCMXO2Family_Compare_Rows("CF", LCMXO2_LSC_INIT_ADDRESS, dev_info->CF, dev_info->CF_Line, report);
+
+  if ( dev_info->UFM_Line )
+  {
+    diff += LCMXO2Family_Compare_Rows("UFM", LCMXO2_LSC_INIT_ADDR_UFM, dev_info->UFM, dev_info->UFM_Line, report);
   }
 
-  printf("\n");
+  //Shift in READ USERCODE(0xC0) instruction;
+  ast_jtag_run_test_idle( 0, 0, 3);
+  ast_jtag_sir_xfer(0, LATTICE_INS_LENGTH, LCMXO2_USERCODE);
+  ast_jtag_tdo_xfer(0, 32, dr_data);
 
-  if ( err )
+  if ( dr_data[0] != dev_info->Version )
   {
-    printf("\nVerify CPLD FW Error\n", __func__);
+    if ( report )
+    {
+      printf("USERCODE differs: %08X, file %08X\n", dr_data[0], dev_info->Version);
+    }
+
+    diff++;
+  }
+
+  return diff;
+}
+
+static int
+LCMXO2Family_cpld_verify(CPLDInfo *dev_info)
+{
+  int err = 0;
+
+  if ( LCMXO2Family_cpld_Compare(dev_info, 0) )
+  {
+    printf("\nVerify CPLD FW Error\n");
+
+    err = -1;
   }
 #ifdef CPLD_DEBUG
   else
   {
-    printf("\nVerify CPLD FW Pass\n", __func__);
+    printf("\nVerify CPLD FW Pass\n");
   }
 #endif
 
@@ -744,6 +816,28 @@ LCMXO2Family_cpld_End()
   return RetVal;
 }
 
+/*
+ * Leave transparent mode without touching the DONE bit, for sessions
+ * that only read the device.
+ */
+static int
+LCMXO2Family_cpld_Exit()
+{
+  ast_jtag_run_test_idle( 0, 0, 3);
+
+  //Shift in ISC DISABLE(0x26) instruction
+  ast_jtag_sir_xfer(0, LATTICE_INS_LENGTH, LCMXO2_ISC_DISABLE);
+
+#ifdef CPLD_DEBUG
+  printf("[%s] ISC DISABLE(0x26)\n", __func__);
+#endif
+
+  //Shift in BYPASS(0xFF) instruction
+  ast_jtag_sir_xfer(0, LATTICE_INS_LENGTH, BYPASS);
+
+  return 0;
+}
+
 static int
 LCMXO2Family_cpld_Check_ID()
 {
@@ -851,7 +945,12 @@ LCMXO2Family_cpld_program(CPLDInfo *dev_info)
   printf("[%s] INIT_ADDRESS(0x46) \n", __func__);
 #endif
 
-  LCMXO2Family_SendCFdata(dev_info);
+  RetVal = LCMXO2Family_Send_Rows("CF", dev_info->CF, dev_info->CF_Line);
+
+  if ( RetVal < 0 )
+  {
+    return RetVal;
+  }
 
   if ( dev_info->UFM_Line )
   {
@@ -859,7 +958,12 @@ LCMXO2Family_cpld_program(CPLDInfo *dev_info)
     //program UFM
     ast_jtag_sir_xfer(0, LATTICE_INS_LENGTH, LCMXO2_LSC_INIT_ADDR_UFM);
 
-    LCMXO2Family_SendUFMdata(dev_info);
+    RetVal = LCMXO2Family_Send_Rows("UFM", dev_info->UFM, dev_info->UFM_Line);
+
+    if ( RetVal < 0 )
+    {
+      return RetVal;
+    }
   }
 
 #ifdef CPLD_DEBUG
@@ -958,8 +1062,6 @@ int
 LCMXO2Family_cpld_update(FILE *jed_fd)
 {
   CPLDInfo dev_info = {0};
-  int cf_size = 0;
-  int ufm_size = 0;
   int erase_type = 0;
   int RetVal;
 
@@ -979,21 +1081,8 @@ LCMXO2Family_cpld_update(FILE *jed_fd)
   //set file pointer to the beginning
   fseek(jed_fd, 0, SEEK_SET);
 
-  //get update data size
-  RetVal = LCMXO2Family_Get_Update_Data_Size(jed_fd, &cf_size, &ufm_size);
-
-  if ( RetVal < 0 )
-  {
-    printf("[%s] Update Data Size Error!\n", __func__);
-
-    goto error_exit;
-  }
-
-  //set file pointer to the beginning
-  fseek(jed_fd, 0, SEEK_SET);
-
   //parse info from JED file and calculate checksum
-  RetVal = LCMXO2Family_JED_File_Parser(jed_fd, &dev_info, cf_size, ufm_size);
+  RetVal = LCMXO2Family_JED_File_Parser(jed_fd, &dev_info);
 
   if ( RetVal < 0 )
   {
@@ -1070,6 +1159,85 @@ error_exit:
   return RetVal;
 }
 
+/*
+ * Read the device back and compare it with the JED file without erasing
+ * or programming anything, so an update can be skipped when the CPLD
+ * already holds the image. Returns 0 when everything matches.
+ */
+int
+LCMXO2Family_cpld_Verify_Only(FILE *jed_fd)
+{
+  CPLDInfo dev_info = {0};
+  int diff;
+  int RetVal;
+
+  RetVal = LCMXO2Family_cpld_Check_ID();
+
+  if ( RetVal < 0 )
+  {
+    printf("[%s] Unknown Device ID!\n", __func__);
+
+    goto error_exit;
+  }
+
+  //set file pointer to the beginning
+  fseek(jed_fd, 0, SEEK_SET);
+
+  //parse info from JED file and calculate checksum
+  RetVal = LCMXO2Family_JED_File_Parser(jed_fd, &dev_info);
+
+  if ( RetVal < 0 )
+  {
+    printf("[%s] JED file CheckSum Error!\n", __func__);
+
+    goto error_exit;
+  }
+
+  RetVal = LCMXO2Family_cpld_Start();
+
+  if ( RetVal < 0 )
+  {
+    printf("[%s] Enter Transparent mode Error!\n", __func__);
+
+    goto error_exit;
+  }
+
+  diff = LCMXO2Family_cpld_Compare(&dev_info, 1);
+
+  RetVal = LCMXO2Family_cpld_Exit();
+
+  if ( RetVal < 0 )
+  {
+    printf("[%s] Exit Transparent Mode Failed!\n", __func__);
+
+    goto error_exit;
+  }
+
+  if ( diff )
+  {
+    printf("CPLD FW differs from the JED file (%d rows)\n", diff);
+
+    RetVal = -1;
+  }
+  else
+  {
+    printf("CPLD FW matches the JED file\n");
+  }
+
+error_exit:
+  if ( NULL != dev_info.CF )
+  {
+    free(dev_info.CF);
+  }
+
+  if ( NULL != dev_info.UFM )
+  {
+    free(dev_info.UFM);
+  }
+
+  return RetVal;
+}
+
 /*************************************************************************************/
 unsigned int jed_file_parse_header(FILE *jed_fd)
 {
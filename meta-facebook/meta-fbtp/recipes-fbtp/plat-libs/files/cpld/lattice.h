@@ -48,6 +48,7 @@ extern int lcmxo2_2000hc_cpld_verify(FILE *jed_fd);
 /*LCMXO2Family*/
 extern int LCMXO2Family_cpld_update(FILE *jed_fd);
 extern int LCMXO2Family_cpld_Get_Ver(unsigned int *ver);
+extern int LCMXO2Family_cpld_Verify_Only(FILE *jed_fd);
 /*************************************************************************************/
 struct cpld_dev_info {
 	const char		*name;
@@ -69,11 +70,13 @@ static struct cpld_dev_info lattice_device_list[] = {
 		.dev_id = 0x012BB043,
 		.cpld_ver = LCMXO2Family_cpld_Get_Ver,
 		.cpld_program = LCMXO2Family_cpld_update,
+		.cpld_verify = LCMXO2Family_cpld_Verify_Only,
   },
   [1] = {
     .name = "LC LCMXO2-4000HC",
     .dev_id = 0x012BC043,
     .cpld_ver = LCMXO2Family_cpld_Get_Ver,
     .cpld_program = LCMXO2Family_cpld_update,
+    .cpld_verify = LCMXO2Family_cpld_Verify_Only,
   }
 };
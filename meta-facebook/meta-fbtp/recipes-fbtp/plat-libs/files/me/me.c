@@ -21,10 +21,20 @@
  */
 #include <stdio.h>
 #include <stdint.h>
+#include <stdlib.h>
 #include <fcntl.h>
 #include <syslog.h>
 #include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <poll.h>
+#include <pthread.h>
 #include <sys/stat.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
 #include "me.h"
 
 #define DEBUG
@@ -36,6 +46,28 @@
 #define SIZE_SYS_GUID 16
 #define SIZE_IANA_ID 3
 
+#define ME_BUS_ID 0x04
+// ipmbd listens with a backlog of 5, keep the pipeline below that
+#define ME_PIPELINE_DEPTH 4
+
+#define ME_PROXY_SHM "/me_sensor_proxy"
+#define ME_PROXY_MAX_ENTRY 48
+#define ME_PROXY_REQ_LEN 40
+#define ME_PROXY_RES_LEN 64
+#define ME_PROXY_PERIOD_MS 2000
+// Requests nobody asked for in this long drop out of the polled set
+#define ME_PROXY_IDLE_MS (ME_PROXY_PERIOD_MS * 10)
+// A response is no longer served once it is this old, or after this many
+// refreshes in a row failed, so readings go NA when the ME stops answering
+#define ME_PROXY_MAX_AGE_MS (ME_PROXY_PERIOD_MS * 3)
+#define ME_PROXY_MAX_FAILS 3
+// A refresh in which the ME answered nothing doubles the wait before the
+// next one, up to this long, so a dead ME is not polled every period
+#define ME_PROXY_MAX_BACKOFF_MS 30000
+// A claimed entry is left to its refresh for as long as that can take
+#define ME_PROXY_CLAIM_MS \
+  ((TIMEOUT_IPMB + 1) * 1000 * (ME_PROXY_MAX_ENTRY / ME_PIPELINE_DEPTH + 1))
+
 #pragma pack(push, 1)
 typedef struct _sdr_rec_hdr_t {
   uint16_t rec_id;
@@ -45,6 +77,45 @@ typedef struct _sdr_rec_hdr_t {
 } sdr_rec_hdr_t;
 #pragma pack(pop)
 
+typedef struct {
+  uint8_t *req;
+  uint8_t req_len;
+  uint8_t *res;
+  uint8_t res_len;
+} me_xfer_t;
+
+typedef struct {
+  uint8_t req_len;
+  uint8_t res_len;
+  uint8_t fails;        // refreshes failed since the last response
+  uint8_t req[ME_PROXY_REQ_LEN];
+  uint8_t res[ME_PROXY_RES_LEN];
+  uint64_t updated;     // last successful response, 0 if never answered
+  uint64_t requested;   // last time a client asked for it
+  uint64_t claimed;     // refresh in flight since, 0 if none
+} me_proxy_entry_t;
+
+typedef struct {
+  me_proxy_stats_t stats;
+  me_proxy_entry_t entry[ME_PROXY_MAX_ENTRY];
+  uint64_t last_attempt;  // end of the last refresh, or start of one in flight
+  uint32_t backoff_ms;    // wait after it before the next, 0 for a period
+} me_proxy_shm_t;
+
+// One refresh: what was claimed, and copies to transfer with the proxy
+// unlocked, as the entries may be reused meanwhile
+typedef struct {
+  int cnt;
+  int slot[ME_PROXY_MAX_ENTRY];
+  uint8_t req[ME_PROXY_MAX_ENTRY][ME_PROXY_REQ_LEN];
+  uint8_t res[ME_PROXY_MAX_ENTRY][MAX_IPMB_RES_LEN];
+  me_xfer_t xfer[ME_PROXY_MAX_ENTRY];
+} me_proxy_batch_t;
+
+static pthread_mutex_t m_proxy = PTHREAD_MUTEX_INITIALIZER;
+static me_proxy_shm_t *g_proxy = NULL;
+static int g_proxy_fd = -1;
+
 // Helper Functions
 static void
 msleep(int msec) {
@@ -455,12 +526,36 @@ me_get_sdr(ipmi_sel_sdr_req_t *req, ipmi_sel_sdr_res_t *res, uint8_t *rlen) {
 
 int
 me_read_sensor(uint8_t sensor_num, ipmi_sensor_reading_t *sensor) {
-  int ret;
-  int rlen = 0;
+  uint8_t tbuf[MAX_IPMB_RES_LEN] = {0};
+  uint8_t rbuf[MAX_IPMB_RES_LEN] = {0};
+  uint8_t rlen = 0;
+  uint8_t len;
+  ipmb_req_t *req = (ipmb_req_t *) tbuf;
+  ipmb_res_t *res = (ipmb_res_t *) rbuf;
+
+  req->res_slave_addr = 0x16 << 1;
+  req->netfn_lun = NETFN_SENSOR_REQ << LUN_OFFSET;
+  req->hdr_cksum = req->res_slave_addr + req->netfn_lun;
+  req->hdr_cksum = ZERO_CKSUM_CONST - req->hdr_cksum;
+  req->req_slave_addr = BMC_SLAVE_ADDR << 1;
+  req->seq_lun = 0x00;
+  req->cmd = CMD_SENSOR_GET_SENSOR_READING;
+  req->data[0] = sensor_num;
 
-  ret = me_ipmb_wrapper(NETFN_SENSOR_REQ, CMD_SENSOR_GET_SENSOR_READING, (uint8_t *)&sensor_num, 1, (uint8_t *)sensor, &rlen);
+  // Sensor readings are served by the ME sensor proxy
+  me_proxy_ipmb(tbuf, IPMB_HDR_SIZE + IPMI_REQ_HDR_SIZE + 1, rbuf, &rlen, NULL);
 
-  return ret;
+  if (rlen <= IPMB_HDR_SIZE + IPMI_RESP_HDR_SIZE || res->cc) {
+    return -1;
+  }
+
+  len = rlen - IPMB_HDR_SIZE - IPMI_RESP_HDR_SIZE;
+  if (len > sizeof(ipmi_sensor_reading_t)) {
+    len = sizeof(ipmi_sensor_reading_t);
+  }
+  memcpy(sensor, res->data, len);
+
+  return 0;
 }
 
 int
@@ -488,3 +583,309 @@ me_xmit(uint8_t *txbuf, uint8_t txlen, uint8_t *rxbuf, uint8_t *rxlen) {
 
   return me_ipmb_wrapper(netfn, cmd, req->data, tlen, rxbuf, rxlen);
 }
+
+static uint64_t
+me_now_ms(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+// Issue up to ME_PIPELINE_DEPTH requests to ipmbd at a time. ipmbd runs each
+// connection in its own thread with its own sequence number, so the requests
+// are in flight on the IPMB bus together instead of back to back.
+static void
+me_ipmb_pipeline(me_xfer_t *xfer, int cnt) {
+  struct pollfd pfd[ME_PIPELINE_DEPTH];
+  struct sockaddr_un remote;
+  uint64_t deadline, now;
+  int i, j, n, t, s, len, pending;
+
+  remote.sun_family = AF_UNIX;
+  sprintf(remote.sun_path, "%s_%d", SOCK_PATH_IPMB, ME_BUS_ID);
+  len = strlen(remote.sun_path) + sizeof(remote.sun_family);
+
+  for (i = 0; i < cnt; i += n) {
+    n = cnt - i;
+    if (n > ME_PIPELINE_DEPTH)
+      n = ME_PIPELINE_DEPTH;
+
+    pending = 0;
+    for (j = 0; j < n; j++) {
+      xfer[i+j].res_len = 0;
+      pfd[j].fd = -1;
+      pfd[j].events = POLLIN;
+      pfd[j].revents = 0;
+
+      if ((s = socket(AF_UNIX, SOCK_STREAM, 0)) < 0)
+        continue;
+      if (connect(s, (struct sockaddr *)&remote, len) < 0 ||
+          send(s, xfer[i+j].req, xfer[i+j].req_len, 0) < 0) {
+        close(s);
+        continue;
+      }
+      pfd[j].fd = s;
+      pending++;
+    }
+
+    deadline = me_now_ms() + (TIMEOUT_IPMB + 1) * 1000;
+    while (pending > 0 && (now = me_now_ms()) < deadline) {
+      if (poll(pfd, n, deadline - now) <= 0) {
+        if (errno == EINTR)
+          continue;
+        break;
+      }
+      for (j = 0; j < n; j++) {
+        if (pfd[j].fd < 0 || !pfd[j].revents)
+          continue;
+        t = recv(pfd[j].fd, xfer[i+j].res, MAX_IPMB_RES_LEN, 0);
+        if (t > 0)
+          xfer[i+j].res_len = t;
+        close(pfd[j].fd);
+        pfd[j].fd = -1;
+        pending--;
+      }
+    }
+
+    for (j = 0; j < n; j++) {
+      if (pfd[j].fd >= 0)
+        close(pfd[j].fd);
+    }
+  }
+}
+
+static int
+me_proxy_open(void) {
+  int fd;
+
+  if (g_proxy)
+    return 0;
+
+  fd = shm_open(ME_PROXY_SHM, O_CREAT | O_RDWR, S_IRUSR | S_IWUSR);
+  if (fd < 0) {
+    syslog(LOG_WARNING, "%s: shm_open failed, errno = %d", __func__, errno);
+    return -1;
+  }
+
+  // A fresh object reads back as zeroes, which is an empty table
+  if (ftruncate(fd, sizeof(me_proxy_shm_t)) < 0) {
+    close(fd);
+    return -1;
+  }
+
+  g_proxy = mmap(NULL, sizeof(me_proxy_shm_t), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (g_proxy == MAP_FAILED) {
+    syslog(LOG_WARNING, "%s: mmap failed, errno = %d", __func__, errno);
+    g_proxy = NULL;
+    close(fd);
+    return -1;
+  }
+  g_proxy_fd = fd;
+
+  return 0;
+}
+
+// Requests match on everything but the sequence number and data checksum,
+// which ipmbd fills in.
+static bool
+me_proxy_match(me_proxy_entry_t *e, uint8_t *req, uint8_t req_len) {
+  if (e->req_len != req_len)
+    return false;
+  if (memcmp(e->req, req, 4))
+    return false;
+  return !memcmp(&e->req[5], &req[5], req_len - 6);
+}
+
+static me_proxy_entry_t *
+me_proxy_lookup(uint8_t *req, uint8_t req_len, uint64_t now) {
+  me_proxy_entry_t *e, *victim = NULL;
+  int i;
+
+  for (i = 0; i < ME_PROXY_MAX_ENTRY; i++) {
+    e = &g_proxy->entry[i];
+    if (e->req_len && me_proxy_match(e, req, req_len))
+      return e;
+    if (!e->req_len || (now - e->requested) > ME_PROXY_IDLE_MS) {
+      if (!victim || victim->req_len)
+        victim = e;
+    } else if (!victim || (victim->req_len && e->requested < victim->requested)) {
+      victim = e;
+    }
+  }
+
+  memset(victim, 0, sizeof(*victim));
+  memcpy(victim->req, req, req_len);
+  victim->req_len = req_len;
+  return victim;
+}
+
+// Whether a refresh may start now: one per period, or per backoff while the
+// ME is not answering. A new entry is fetched right away unless backing off.
+static bool
+me_proxy_refresh_due(me_proxy_entry_t *e, uint64_t now) {
+  uint32_t wait = g_proxy->backoff_ms ? g_proxy->backoff_ms : ME_PROXY_PERIOD_MS;
+
+  if (e->claimed && (now - e->claimed) < ME_PROXY_CLAIM_MS)
+    return false;
+  if (e->updated && (now - e->updated) < ME_PROXY_PERIOD_MS)
+    return false;
+  if (!e->updated && !e->fails && !g_proxy->backoff_ms)
+    return true;
+  return !g_proxy->last_attempt || (now - g_proxy->last_attempt) >= wait;
+}
+
+// Claim every active entry that is due within half a period, so the whole
+// set lands on one schedule and goes out as one pipelined burst. Called
+// with the proxy locked.
+static void
+me_proxy_claim(me_proxy_batch_t *b, uint64_t now) {
+  me_proxy_entry_t *e;
+  int i;
+
+  b->cnt = 0;
+  for (i = 0; i < ME_PROXY_MAX_ENTRY; i++) {
+    e = &g_proxy->entry[i];
+    if (!e->req_len)
+      continue;
+    if ((now - e->requested) > ME_PROXY_IDLE_MS) {
+      e->req_len = 0;
+      continue;
+    }
+    if (e->claimed && (now - e->claimed) < ME_PROXY_CLAIM_MS)
+      continue;
+    if (e->updated && (now - e->updated) < ME_PROXY_PERIOD_MS / 2)
+      continue;
+
+    e->claimed = now;
+    memcpy(b->req[b->cnt], e->req, e->req_len);
+    b->xfer[b->cnt].req = b->req[b->cnt];
+    b->xfer[b->cnt].req_len = e->req_len;
+    b->xfer[b->cnt].res = b->res[b->cnt];
+    b->slot[b->cnt++] = i;
+  }
+  if (b->cnt)
+    g_proxy->last_attempt = now;
+}
+
+// Store what the refresh got, into the entries that still hold the same
+// requests. Called with the proxy locked.
+static void
+me_proxy_publish(me_proxy_batch_t *b, uint64_t now) {
+  me_proxy_entry_t *e;
+  int i, answered = 0;
+
+  for (i = 0; i < b->cnt; i++) {
+    e = &g_proxy->entry[b->slot[i]];
+    if (!e->req_len || !me_proxy_match(e, b->req[i], b->xfer[i].req_len))
+      continue;
+    e->claimed = 0;
+    if (b->xfer[i].res_len == 0 || b->xfer[i].res_len > ME_PROXY_RES_LEN) {
+      g_proxy->stats.failures++;
+      if (e->fails < ME_PROXY_MAX_FAILS)
+        e->fails++;
+      continue;
+    }
+    memcpy(e->res, b->xfer[i].res, b->xfer[i].res_len);
+    e->res_len = b->xfer[i].res_len;
+    e->updated = now;
+    e->fails = 0;
+    answered++;
+  }
+
+  if (answered) {
+    g_proxy->backoff_ms = 0;
+  } else if (g_proxy->backoff_ms < ME_PROXY_MAX_BACKOFF_MS) {
+    g_proxy->backoff_ms = g_proxy->backoff_ms ? g_proxy->backoff_ms * 2 :
+                                                ME_PROXY_PERIOD_MS * 2;
+    if (g_proxy->backoff_ms > ME_PROXY_MAX_BACKOFF_MS)
+      g_proxy->backoff_ms = ME_PROXY_MAX_BACKOFF_MS;
+  }
+  g_proxy->last_attempt = now;
+  g_proxy->stats.refreshes++;
+  g_proxy->stats.xfers += b->cnt;
+}
+
+static void
+me_proxy_lock(void) {
+  pthread_mutex_lock(&m_proxy);
+  flock(g_proxy_fd, LOCK_EX);
+}
+
+static void
+me_proxy_unlock(void) {
+  flock(g_proxy_fd, LOCK_UN);
+  pthread_mutex_unlock(&m_proxy);
+}
+
+// Serve an ME request from the shared sensor proxy. The first caller to find
+// its entry older than the poll period refreshes the whole set, with the
+// proxy unlocked during the transfers; everyone else is answered from
+// memory. An expired entry answers with nothing, as a failed transaction
+// would.
+void
+me_proxy_ipmb(uint8_t *req, uint8_t req_len, uint8_t *res, uint8_t *res_len,
+              me_proxy_info_t *info) {
+  me_proxy_batch_t *b = NULL;
+  me_proxy_entry_t *e;
+  uint64_t now;
+
+  *res_len = 0;
+  if (req_len > ME_PROXY_REQ_LEN || req_len < 7) {
+    lib_ipmb_handle(ME_BUS_ID, req, req_len, res, res_len);
+    return;
+  }
+
+  pthread_mutex_lock(&m_proxy);
+  if (me_proxy_open()) {
+    pthread_mutex_unlock(&m_proxy);
+    lib_ipmb_handle(ME_BUS_ID, req, req_len, res, res_len);
+    return;
+  }
+  flock(g_proxy_fd, LOCK_EX);
+
+  now = me_now_ms();
+  e = me_proxy_lookup(req, req_len, now);
+  e->requested = now;
+
+  if (me_proxy_refresh_due(e, now) && (b = malloc(sizeof(*b))) != NULL) {
+    me_proxy_claim(b, now);
+    me_proxy_unlock();
+
+    me_ipmb_pipeline(b->xfer, b->cnt);
+
+    me_proxy_lock();
+    now = me_now_ms();
+    me_proxy_publish(b, now);
+    free(b);
+    // The entry may have been reused while unlocked
+    e = me_proxy_lookup(req, req_len, now);
+  } else {
+    g_proxy->stats.hits++;
+  }
+
+  if (e->res_len && (now - e->updated) < ME_PROXY_MAX_AGE_MS &&
+      e->fails < ME_PROXY_MAX_FAILS) {
+    memcpy(res, e->res, e->res_len);
+    *res_len = e->res_len;
+  }
+  if (info) {
+    info->age_ms = e->updated ? (uint32_t)(now - e->updated) : UINT32_MAX;
+    info->stale = !e->updated || (now - e->updated) >= ME_PROXY_PERIOD_MS;
+  }
+  me_proxy_unlock();
+}
+
+int
+me_proxy_get_stats(me_proxy_stats_t *stats) {
+  pthread_mutex_lock(&m_proxy);
+  if (me_proxy_open()) {
+    pthread_mutex_unlock(&m_proxy);
+    return -1;
+  }
+  flock(g_proxy_fd, LOCK_SH);
+  memcpy(stats, &g_proxy->stats, sizeof(*stats));
+  flock(g_proxy_fd, LOCK_UN);
+  pthread_mutex_unlock(&m_proxy);
+  return 0;
+}
@@ -23,6 +23,7 @@
 
 #include <openbmc/ipmi.h>
 #include <openbmc/ipmb.h>
+#include <stdbool.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -49,6 +50,25 @@ int me_get_sys_guid(uint8_t *guid);
 
 int me_xmit(uint8_t *txbuf, uint8_t txlen, uint8_t *rxbuf, uint8_t *rxlen);
 
+// ME sensor proxy: sensor requests from all processes share one cache that
+// is refreshed as a single pipelined batch once per poll period.
+typedef struct {
+  uint32_t age_ms;    // age of the returned response
+  uint8_t stale;      // response is older than the poll period
+} me_proxy_info_t;
+
+typedef struct {
+  uint32_t refreshes; // batched refresh rounds
+  uint32_t xfers;     // IPMB transactions issued by the proxy
+  uint32_t hits;      // requests answered from the cache
+  uint32_t failures;  // transactions that got no usable response
+} me_proxy_stats_t;
+
+// req/res are complete IPMB frames, as for lib_ipmb_handle()
+void me_proxy_ipmb(uint8_t *req, uint8_t req_len, uint8_t *res, uint8_t *res_len,
+                   me_proxy_info_t *info);
+int me_proxy_get_stats(me_proxy_stats_t *stats);
+
 #ifdef __cplusplus
 } // extern "C"
 #endif
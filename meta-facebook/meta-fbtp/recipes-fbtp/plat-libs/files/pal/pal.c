@@ -30,11 +30,13 @@
 #include <pthread.h>
 #include <unistd.h>
 #include "pal.h"
+#include <openbmc/pal-sensor.h>
 #include <openbmc/vr.h>
 #include <linux/i2c.h>
 #include <linux/i2c-dev.h>
 #include <sys/stat.h>
 #include <openbmc/gpio.h>
+#include <openbmc/evbus.h>
 
 #define BIT(value, index) ((value >> index) & 1)
 
@@ -162,6 +164,7 @@
 #define POST_CODE_FILE       "/sys/devices/platform/ast-snoop-dma.0/data_history"
 
 #define CPLD_BUS_ID 0x6
+#define VR_BUS_ID 0x5
 #define CPLD_ADDR 0xA0
 
 static uint8_t gpio_rst_btn[] = { 0, GPIO_POWER_RESET};
@@ -989,7 +992,6 @@ read_hsc_value(const char *device, float *value) {
 
 static int
 read_hsc_current_value(float *value) {
-  uint8_t bus_id = 0x4; //TODO: ME's address 0x2c in FBTP
   uint8_t tbuf[256] = {0x00};
   uint8_t rbuf[256] = {0x00};
   uint8_t tlen = 0;
@@ -1035,8 +1037,8 @@ read_hsc_current_value(float *value) {
   req->data[9] = 0x8C;
   tlen = 16;
 
-  // Invoke IPMB library handler
-  lib_ipmb_handle(bus_id, tbuf, tlen+1, &rbuf, &rlen);
+  // Served by the ME sensor proxy
+  me_proxy_ipmb(tbuf, tlen+1, rbuf, &rlen, NULL);
 
   if (rlen == 0) {
 #ifdef DEBUG
@@ -1063,7 +1065,6 @@ read_hsc_current_value(float *value) {
 
 static int
 read_sensor_reading_from_ME(uint8_t snr_num, float *value) {
-  uint8_t bus_id = 0x4; //TODO: ME's address 0x2c in FBTP
   uint8_t tbuf[256] = {0x00};
   uint8_t rbuf[256] = {0x00};
   uint8_t tlen = 0;
@@ -1091,8 +1092,8 @@ read_sensor_reading_from_ME(uint8_t snr_num, float *value) {
   req->data[0] = snr_num;
   tlen = 7;
 
-  // Invoke IPMB library handler
-  lib_ipmb_handle(bus_id, tbuf, tlen+1, &rbuf, &rlen);
+  // Served by the ME sensor proxy
+  me_proxy_ipmb(tbuf, tlen+1, rbuf, &rlen, NULL);
 
   if (rlen == 0) {
   //ME no response
@@ -1146,7 +1147,6 @@ read_sensor_reading_from_ME(uint8_t snr_num, float *value) {
 static int
 read_cpu_temp(uint8_t snr_num, float *value) {
   int ret = 0;
-  uint8_t bus_id = 0x4; //TODO: ME's address 0x2c in FBTP
   uint8_t tbuf[256] = {0x00};
   uint8_t rbuf1[256] = {0x00};
   static uint8_t tjmax[2] = {0x00};
@@ -1198,8 +1198,8 @@ read_cpu_temp(uint8_t snr_num, float *value) {
     req->data[9] = 0x00;
     req->data[10] = 0x00;
     tlen = 17;
-    // Invoke IPMB library handler
-    lib_ipmb_handle(bus_id, tbuf, tlen+1, &rbuf1, &rlen);
+    // Served by the ME sensor proxy
+    me_proxy_ipmb(tbuf, tlen+1, rbuf1, &rlen, NULL);
     if (rlen == 0) {
     //ME no response
 #ifdef DEBUG
@@ -1247,8 +1247,8 @@ read_cpu_temp(uint8_t snr_num, float *value) {
     req->data[10] = 0x00;
     tlen = 17;
 
-    // Invoke IPMB library handler
-    lib_ipmb_handle(bus_id, tbuf, tlen+1, &rbuf1, &rlen);
+    // Served by the ME sensor proxy
+    me_proxy_ipmb(tbuf, tlen+1, rbuf1, &rlen, NULL);
 
     if (rlen == 0) {
       //ME no response
@@ -1287,7 +1287,6 @@ read_cpu_temp(uint8_t snr_num, float *value) {
 static int
 read_dimm_temp(uint8_t snr_num, float *value) {
   int ret = READING_NA;
-  uint8_t bus_id = 0x4; //TODO: ME's address 0x2c in FBTP
   uint8_t tbuf[256] = {0x00};
   uint8_t rbuf1[256] = {0x00};
   uint8_t tlen = 0;
@@ -1346,39 +1345,37 @@ read_dimm_temp(uint8_t snr_num, float *value) {
   req->req_slave_addr = 0x20;
   req->seq_lun = 0x00;
 
-  for (i=0; i<3; i++) { // Get 3 channel for each DIMM group
-    //Get DIMM Temp per channel
-    req->cmd = CMD_NM_SEND_RAW_PECI;
-    req->data[0] = 0x57;
-    req->data[1] = 0x01;
-    req->data[2] = 0x00;
-    req->data[3] = 0x30 + (dimm_index / 2);
-    req->data[4] = 0x05;
-    req->data[5] = 0x05;
-    req->data[6] = 0xa1;
-    req->data[7] = 0x00;
-    req->data[8] = 0x0e;
-    req->data[9] = 0x00 + (dimm_index % 2 * 3) + i;
-    req->data[10] = 0x00;
-    tlen = 17;
-
-    // Invoke IPMB library handler
-    lib_ipmb_handle(bus_id, tbuf, tlen+1, &rbuf1, &rlen);
-    if (rlen == 0) {
-    //ME no response
+  // Get the 3 channels of the DIMM group in one aggregated PECI request
+  req->cmd = CMD_NM_AGGREGATED_SEND_RAW_PECI;
+  req->data[0] = 0x57;
+  req->data[1] = 0x01;
+  req->data[2] = 0x00;
+  for (i=0; i<3; i++) {
+    req->data[3+i*8] = 0x30 + (dimm_index / 2);
+    req->data[4+i*8] = 0x05;
+    req->data[5+i*8] = 0x05;
+    req->data[6+i*8] = 0xa1;
+    req->data[7+i*8] = 0x00;
+    req->data[8+i*8] = 0x0e;
+    req->data[9+i*8] = 0x00 + (dimm_index % 2 * 3) + i;
+    req->data[10+i*8] = 0x00;
+  }
+  tlen = 33;
+
+  me_proxy_ipmb(tbuf, tlen+1, rbuf1, &rlen, NULL);
+  if (rlen == 0) {
+  //ME no response
 #ifdef DEBUG
-      syslog(LOG_DEBUG, "%s(%d): Zero bytes received\n", __func__, __LINE__);
+    syslog(LOG_DEBUG, "%s(%d): Zero bytes received\n", __func__, __LINE__);
 #endif
-    } else {
-      if (rbuf1[6] == 0)
-      {
-        // If PECI command successes
-        if ( (rbuf1[10] == 0x40)) {
-          if (rbuf1[11] > max)
-            max = rbuf1[11];
-          if (rbuf1[12] > max)
-            max = rbuf1[11];
-        }
+  } else if (rbuf1[6] == 0) {
+    for (i=0; i<3; i++) {
+      // Each channel returns ME CC, PECI CC and 4 bytes of data
+      if ((rbuf1[10+i*6] == 0x00) && (rbuf1[11+i*6] == 0x40)) {
+        if (rbuf1[12+i*6] > max)
+          max = rbuf1[12+i*6];
+        if (rbuf1[13+i*6] > max)
+          max = rbuf1[13+i*6];
       }
     }
   }
@@ -2921,6 +2918,31 @@ pal_set_hb_led(uint8_t status) {
   return 0;
 }
 
+// Return the GPIOs behind a front panel input, for front-paneld to wait on
+int
+pal_get_fp_gpios(uint8_t input, int *gpios, int *cnt) {
+  if (*cnt < 1) {
+    return -1;
+  }
+
+  switch (input) {
+    case FP_INPUT_DBG_CARD_PRSNT:
+      gpios[0] = GPIO_DBG_CARD_PRSNT;
+      break;
+    case FP_INPUT_PWR_BTN:
+      gpios[0] = GPIO_PWR_BTN;
+      break;
+    case FP_INPUT_RST_BTN:
+      gpios[0] = GPIO_RST_BTN;
+      break;
+    default:
+      return PAL_ENOTSUP;
+  }
+
+  *cnt = 1;
+  return 0;
+}
+
 // Update the Identification LED for the given fru with the status
 int
 pal_set_id_led(uint8_t fru, uint8_t status) {
@@ -3300,464 +3322,520 @@ pal_sensor_read(uint8_t fru, uint8_t sensor_num, void *value) {
   return ret;
 }
 
-int
-pal_sensor_read_raw(uint8_t fru, uint8_t sensor_num, void *value) {
-  uint8_t status;
-  char key[MAX_KEY_LEN] = {0};
-  char str[MAX_VALUE_LEN] = {0};
-  int ret;
-  float volt, curr;
-  static uint8_t poweron_10s_flag = 0;
-  uint8_t retry = MAX_READ_RETRY;
-  bool server_off;
+/*
+ * Sensor descriptor table. Each entry names the bus the sensor lives on,
+ * the power states it can be read in and the function that reads it; the
+ * common engine in pal-sensor.c does the lookup, gating and caching.
+ */
+static uint8_t poweron_10s_flag = 0;
 
-  switch(fru) {
-  case FRU_MB:
-    sprintf(key, "mb_sensor%d", sensor_num);
-    server_off = is_server_off();
-    if (server_off) {
-      poweron_10s_flag = 0;
-      // Power is OFF, so only some of the sensors can be read
-      switch(sensor_num) {
-      // Temp. Sensors
-      case MB_SENSOR_INLET_TEMP:
-        ret = read_temp(MB_INLET_TEMP_DEVICE, (float*) value);
-        break;
-      case MB_SENSOR_OUTLET_TEMP:
-        ret = read_temp(MB_OUTLET_TEMP_DEVICE, (float*) value);
-        break;
-      case MB_SENSOR_INLET_REMOTE_TEMP:
-        ret = read_temp_attr(MB_INLET_TEMP_DEVICE, "temp2_input", (float*) value);
-        if (!ret)
-          apply_inlet_correction((float *) value);
-        break;
-      case MB_SENSOR_OUTLET_REMOTE_TEMP:
-        ret = read_temp_attr(MB_OUTLET_TEMP_DEVICE, "temp2_input", (float*) value);
-        break;
-      case MB_SENSOR_P12V:
-        ret = read_adc_value(ADC_PIN2, ADC_VALUE, (float*) value);
-        break;
-      case MB_SENSOR_P1V05:
-        ret = read_adc_value(ADC_PIN3, ADC_VALUE, (float*) value);
-        break;
-      case MB_SENSOR_PVNN_PCH_STBY:
-        ret = read_adc_value(ADC_PIN4, ADC_VALUE, (float*) value);
-        break;
-      case MB_SENSOR_P3V3_STBY:
-        ret = read_adc_value(ADC_PIN5, ADC_VALUE, (float*) value);
-        break;
-      case MB_SENSOR_P5V_STBY:
-        ret = read_adc_value(ADC_PIN6, ADC_VALUE, (float*) value);
-        break;
-      case MB_SENSOR_P3V_BAT:
-        gpio_set(GPIO_BAT_SENSE_EN_N, 0);
-        msleep(10);
-        ret = read_adc_value(ADC_PIN7, ADC_VALUE, (float*) value);
-        gpio_set(GPIO_BAT_SENSE_EN_N, 1);
-        break;
+/* HSC voltage/current are readable in standby but settle after power on */
+#define SNR_GATE_HSC (SNR_GATE(SNR_PWR_OFF) | SNR_GATE(SNR_PWR_ON))
 
-      // Hot Swap Controller
-      case MB_SENSOR_HSC_IN_VOLT:
-        ret = read_sensor_reading_from_ME(MB_SENSOR_HSC_IN_VOLT, (float*) value);
-        break;
-      case MB_SENSOR_HSC_OUT_CURR:
-        ret = read_hsc_current_value((float*) value);
-        break;
-      case MB_SENSOR_HSC_IN_POWER:
-        ret = read_sensor_reading_from_ME(MB_SENSOR_HSC_IN_POWER, (float*) value);
-        break;
-      case MB_SENSOR_POWER_FAIL:
-        ret = read_CPLD_power_fail_sts (fru, sensor_num, (float*) value, poweron_10s_flag);
-        break;
-      default:
-        ret = READING_NA;
-        break;
-      }
-    } else {
-      if((poweron_10s_flag < 5) && ((sensor_num == MB_SENSOR_HSC_IN_VOLT) ||
-         (sensor_num == MB_SENSOR_HSC_OUT_CURR) || (sensor_num == MB_SENSOR_HSC_IN_POWER) ||
-         (sensor_num == MB_SENSOR_FAN0_TACH) || (sensor_num == MB_SENSOR_FAN1_TACH))) {
-        if(sensor_num == MB_SENSOR_HSC_IN_POWER){
-          poweron_10s_flag++;
-        }
-        ret = READING_NA;
-        break;
-      }
-      switch(sensor_num) {
-      // Temp. Sensors
-      case MB_SENSOR_INLET_TEMP:
-        ret = read_temp(MB_INLET_TEMP_DEVICE, (float*) value);
-        break;
-      case MB_SENSOR_OUTLET_TEMP:
-        ret = read_temp(MB_OUTLET_TEMP_DEVICE, (float*) value);
-        break;
-      case MB_SENSOR_INLET_REMOTE_TEMP:
-        ret = read_temp_attr(MB_INLET_TEMP_DEVICE, "temp2_input", (float*) value);
-        if (!ret)
-          apply_inlet_correction((float *) value);
-        break;
-      case MB_SENSOR_OUTLET_REMOTE_TEMP:
-        ret = read_temp_attr(MB_OUTLET_TEMP_DEVICE, "temp2_input", (float*) value);
-        break;
-      // Fan Sensors
-      case MB_SENSOR_FAN0_TACH:
-        ret = read_fan_value_f(FAN0, FAN_TACH_RPM, (float*) value);
-        break;
-      case MB_SENSOR_FAN1_TACH:
-        ret = read_fan_value_f(FAN1, FAN_TACH_RPM, (float*) value);
-        break;
-      // Various Voltages
-      case MB_SENSOR_P3V3:
-        ret = read_adc_value(ADC_PIN0, ADC_VALUE, (float*) value);
-        break;
-      case MB_SENSOR_P5V:
-        ret = read_adc_value(ADC_PIN1, ADC_VALUE, (float*) value);
-        break;
-      case MB_SENSOR_P12V:
-        ret = read_adc_value(ADC_PIN2, ADC_VALUE, (float*) value);
-        break;
-      case MB_SENSOR_P1V05:
-        ret = read_adc_value(ADC_PIN3, ADC_VALUE, (float*) value);
-        break;
-      case MB_SENSOR_PVNN_PCH_STBY:
-        ret = read_adc_value(ADC_PIN4, ADC_VALUE, (float*) value);
-        break;
-      case MB_SENSOR_P3V3_STBY:
-        ret = read_adc_value(ADC_PIN5, ADC_VALUE, (float*) value);
-        break;
-      case MB_SENSOR_P5V_STBY:
-        ret = read_adc_value(ADC_PIN6, ADC_VALUE, (float*) value);
-        break;
-      case MB_SENSOR_P3V_BAT:
-        gpio_set(GPIO_BAT_SENSE_EN_N, 0);
-        msleep(10);
-        ret = read_adc_value(ADC_PIN7, ADC_VALUE, (float*) value);
-        gpio_set(GPIO_BAT_SENSE_EN_N, 1);
-        break;
-
-      // Hot Swap Controller
-      case MB_SENSOR_HSC_IN_VOLT:
-        ret = read_sensor_reading_from_ME(MB_SENSOR_HSC_IN_VOLT, (float*) value);
-        break;
-      case MB_SENSOR_HSC_OUT_CURR:
-        ret = read_hsc_current_value((float*) value);
-        break;
-      case MB_SENSOR_HSC_IN_POWER:
-        ret = read_sensor_reading_from_ME(MB_SENSOR_HSC_IN_POWER, (float*) value);
-        break;
-      //CPU, DIMM, PCH Temp
-      case MB_SENSOR_CPU0_TEMP:
-      case MB_SENSOR_CPU1_TEMP:
-        ret = read_cpu_temp(sensor_num, (float*) value);
-        break;
-      case MB_SENSOR_CPU0_DIMM_GRPA_TEMP:
-      case MB_SENSOR_CPU0_DIMM_GRPB_TEMP:
-      case MB_SENSOR_CPU1_DIMM_GRPC_TEMP:
-      case MB_SENSOR_CPU1_DIMM_GRPD_TEMP:
-        ret = read_dimm_temp(sensor_num, (float*) value);
-        break;
-      case MB_SENSOR_CPU0_PKG_POWER:
-      case MB_SENSOR_CPU1_PKG_POWER:
-        ret = read_cpu_package_power(sensor_num, (float*) value);
-        break;
-      case MB_SENSOR_PCH_TEMP:
-        ret = read_sensor_reading_from_ME(MB_SENSOR_PCH_TEMP, (float*) value);
-        break;
-      //VR Sensors
-      case MB_SENSOR_VR_CPU0_VCCIN_TEMP:
-        ret = vr_read_temp(VR_CPU0_VCCIN, VR_LOOP_PAGE_0, (float*) value);
-        break;
-      case MB_SENSOR_VR_CPU0_VCCIN_CURR:
-        ret = vr_read_curr(VR_CPU0_VCCIN, VR_LOOP_PAGE_0, (float*) value);
-        break;
-      case MB_SENSOR_VR_CPU0_VCCIN_VOLT:
-        ret = vr_read_volt(VR_CPU0_VCCIN, VR_LOOP_PAGE_0, (float*) value);
-        break;
-      case MB_SENSOR_VR_CPU0_VCCIN_POWER:
-        ret = vr_read_power(VR_CPU0_VCCIN, VR_LOOP_PAGE_0, (float*) value);
-        break;
-      case MB_SENSOR_VR_CPU0_VSA_TEMP:
-        ret = vr_read_temp(VR_CPU0_VSA, VR_LOOP_PAGE_1, (float*) value);
-        break;
-      case MB_SENSOR_VR_CPU0_VSA_CURR:
-        ret = vr_read_curr(VR_CPU0_VSA, VR_LOOP_PAGE_1, (float*) value);
-        break;
-      case MB_SENSOR_VR_CPU0_VSA_VOLT:
-        ret = vr_read_volt(VR_CPU0_VSA, VR_LOOP_PAGE_1, (float*) value);
-        break;
-      case MB_SENSOR_VR_CPU0_VSA_POWER:
-        ret = vr_read_power(VR_CPU0_VSA, VR_LOOP_PAGE_1, (float*) value);
-        break;
-      case MB_SENSOR_VR_CPU0_VCCIO_TEMP:
-        ret = vr_read_temp(VR_CPU0_VCCIO, VR_LOOP_PAGE_0, (float*) value);
-        break;
-      case MB_SENSOR_VR_CPU0_VCCIO_CURR:
-        ret = vr_read_curr(VR_CPU0_VCCIO, VR_LOOP_PAGE_0, (float*) value);
-        break;
-      case MB_SENSOR_VR_CPU0_VCCIO_VOLT:
-        ret = vr_read_volt(VR_CPU0_VCCIO, VR_LOOP_PAGE_0, (float*) value);
-        break;
-      case MB_SENSOR_VR_CPU0_VCCIO_POWER:
-        ret = vr_read_power(VR_CPU0_VCCIO, VR_LOOP_PAGE_0, (float*) value);
-        break;
-      case MB_SENSOR_VR_CPU0_VDDQ_GRPA_TEMP:
-        ret = vr_read_temp(g_vr_cpu0_vddq_abc, VR_LOOP_PAGE_0, (float*) value);
-        break;
-      case MB_SENSOR_VR_CPU0_VDDQ_GRPA_CURR:
-        ret = vr_read_curr(g_vr_cpu0_vddq_abc, VR_LOOP_PAGE_0, (float*) value);
-        break;
-      case MB_SENSOR_VR_CPU0_VDDQ_GRPA_VOLT:
-        ret = vr_read_volt(g_vr_cpu0_vddq_abc, VR_LOOP_PAGE_0, (float*) value);
-        break;
-      case MB_SENSOR_VR_CPU0_VDDQ_GRPA_POWER:
-        ret = vr_read_power(g_vr_cpu0_vddq_abc, VR_LOOP_PAGE_0, (float*) value);
-        break;
-      case MB_SENSOR_VR_CPU0_VDDQ_GRPB_TEMP:
-        ret = vr_read_temp(g_vr_cpu0_vddq_def, VR_LOOP_PAGE_0, (float*) value);
-        break;
-      case MB_SENSOR_VR_CPU0_VDDQ_GRPB_CURR:
-        ret = vr_read_curr(g_vr_cpu0_vddq_def, VR_LOOP_PAGE_0, (float*) value);
-        break;
-      case MB_SENSOR_VR_CPU0_VDDQ_GRPB_VOLT:
-        ret = vr_read_volt(g_vr_cpu0_vddq_def, VR_LOOP_PAGE_0, (float*) value);
-        break;
-      case MB_SENSOR_VR_CPU0_VDDQ_GRPB_POWER:
-        ret = vr_read_power(g_vr_cpu0_vddq_def, VR_LOOP_PAGE_0, (float*) value);
-        break;
-      case MB_SENSOR_VR_CPU1_VCCIN_TEMP:
-        if (is_cpu1_socket_occupy())
-          ret = vr_read_temp(VR_CPU1_VCCIN, VR_LOOP_PAGE_0, (float*) value);
-        else
-          ret = READING_NA;
-        break;
-      case MB_SENSOR_VR_CPU1_VCCIN_CURR:
-        if (is_cpu1_socket_occupy())
-          ret = vr_read_curr(VR_CPU1_VCCIN, VR_LOOP_PAGE_0, (float*) value);
-        else
-          ret = READING_NA;
-        break;
-      case MB_SENSOR_VR_CPU1_VCCIN_VOLT:
-        if (is_cpu1_socket_occupy())
-          ret = vr_read_volt(VR_CPU1_VCCIN, VR_LOOP_PAGE_0, (float*) value);
-        else
-          ret = READING_NA;
-        break;
-      case MB_SENSOR_VR_CPU1_VCCIN_POWER:
-        if (is_cpu1_socket_occupy())
-          ret = vr_read_power(VR_CPU1_VCCIN, VR_LOOP_PAGE_0, (float*) value);
-        else
-          ret = READING_NA;
-        break;
-      case MB_SENSOR_VR_CPU1_VSA_TEMP:
-        if (is_cpu1_socket_occupy())
-          ret = vr_read_temp(VR_CPU1_VSA, VR_LOOP_PAGE_1, (float*) value);
-        else
-          ret = READING_NA;
-        break;
-      case MB_SENSOR_VR_CPU1_VSA_CURR:
-        if (is_cpu1_socket_occupy())
-          ret = vr_read_curr(VR_CPU1_VSA, VR_LOOP_PAGE_1, (float*) value);
-        else
-          ret = READING_NA;
-        break;
-      case MB_SENSOR_VR_CPU1_VSA_VOLT:
-        if (is_cpu1_socket_occupy())
-          ret = vr_read_volt(VR_CPU1_VSA, VR_LOOP_PAGE_1, (float*) value);
-        else
-          ret = READING_NA;
-        break;
-      case MB_SENSOR_VR_CPU1_VSA_POWER:
-        if (is_cpu1_socket_occupy())
-          ret = vr_read_power(VR_CPU1_VSA, VR_LOOP_PAGE_1, (float*) value);
-        else
-          ret = READING_NA;
-        break;
-      case MB_SENSOR_VR_CPU1_VCCIO_TEMP:
-        if (is_cpu1_socket_occupy())
-          ret = vr_read_temp(VR_CPU1_VCCIO, VR_LOOP_PAGE_0, (float*) value);
-        else
-          ret = READING_NA;
-        break;
-      case MB_SENSOR_VR_CPU1_VCCIO_CURR:
-        if (is_cpu1_socket_occupy())
-          ret = vr_read_curr(VR_CPU1_VCCIO, VR_LOOP_PAGE_0, (float*) value);
-        else
-          ret = READING_NA;
-        break;
-      case MB_SENSOR_VR_CPU1_VCCIO_VOLT:
-        if (is_cpu1_socket_occupy())
-          ret = vr_read_volt(VR_CPU1_VCCIO, VR_LOOP_PAGE_0, (float*) value);
-        else
-          ret = READING_NA;
-        break;
-      case MB_SENSOR_VR_CPU1_VCCIO_POWER:
-        if (is_cpu1_socket_occupy())
-          ret = vr_read_power(VR_CPU1_VCCIO, VR_LOOP_PAGE_0, (float*) value);
-        else
-          ret = READING_NA;
-        break;
-      case MB_SENSOR_VR_CPU1_VDDQ_GRPC_TEMP:
-        if (is_cpu1_socket_occupy())
-          ret = vr_read_temp(g_vr_cpu1_vddq_ghj, VR_LOOP_PAGE_0, (float*) value);
-        else
-          ret = READING_NA;
-        break;
-      case MB_SENSOR_VR_CPU1_VDDQ_GRPC_CURR:
-        if (is_cpu1_socket_occupy())
-          ret = vr_read_curr(g_vr_cpu1_vddq_ghj, VR_LOOP_PAGE_0, (float*) value);
-        else
-          ret = READING_NA;
-        break;
-      case MB_SENSOR_VR_CPU1_VDDQ_GRPC_VOLT:
-        if (is_cpu1_socket_occupy())
-          ret = vr_read_volt(g_vr_cpu1_vddq_ghj, VR_LOOP_PAGE_0, (float*) value);
-        else
-          ret = READING_NA;
-        break;
-      case MB_SENSOR_VR_CPU1_VDDQ_GRPC_POWER:
-        if (is_cpu1_socket_occupy())
-          ret = vr_read_power(g_vr_cpu1_vddq_ghj, VR_LOOP_PAGE_0, (float*) value);
-        else
-          ret = READING_NA;
-        break;
-      case MB_SENSOR_VR_CPU1_VDDQ_GRPD_TEMP:
-        if (is_cpu1_socket_occupy())
-          ret = vr_read_temp(g_vr_cpu1_vddq_klm, VR_LOOP_PAGE_0, (float*) value);
-        else
-          ret = READING_NA;
-        break;
-      case MB_SENSOR_VR_CPU1_VDDQ_GRPD_CURR:
-        if (is_cpu1_socket_occupy())
-          ret = vr_read_curr(g_vr_cpu1_vddq_klm, VR_LOOP_PAGE_0, (float*) value);
-        else
-          ret = READING_NA;
-        break;
-      case MB_SENSOR_VR_CPU1_VDDQ_GRPD_VOLT:
-        if (is_cpu1_socket_occupy())
-          ret = vr_read_volt(g_vr_cpu1_vddq_klm, VR_LOOP_PAGE_0, (float*) value);
-        else
-          ret = READING_NA;
-        break;
-      case MB_SENSOR_VR_CPU1_VDDQ_GRPD_POWER:
-        if (is_cpu1_socket_occupy())
-          ret = vr_read_power(g_vr_cpu1_vddq_klm, VR_LOOP_PAGE_0, (float*) value);
-        else
-          ret = READING_NA;
-        break;
-      case MB_SENSOR_VR_PCH_PVNN_TEMP:
-        ret = vr_read_temp(VR_PCH_PVNN, VR_LOOP_PAGE_0, (float*) value);
-        break;
-      case MB_SENSOR_VR_PCH_PVNN_CURR:
-        ret = vr_read_curr(VR_PCH_PVNN, VR_LOOP_PAGE_0, (float*) value);
-        break;
-      case MB_SENSOR_VR_PCH_PVNN_VOLT:
-        ret = vr_read_volt(VR_PCH_PVNN, VR_LOOP_PAGE_0, (float*) value);
-        break;
-      case MB_SENSOR_VR_PCH_PVNN_POWER:
-        ret = vr_read_power(VR_PCH_PVNN, VR_LOOP_PAGE_0, (float*) value);
-        break;
-      case MB_SENSOR_VR_PCH_P1V05_TEMP:
-        ret = vr_read_temp(VR_PCH_P1V05, VR_LOOP_PAGE_1, (float*) value);
-        break;
-      case MB_SENSOR_VR_PCH_P1V05_CURR:
-        ret = vr_read_curr(VR_PCH_P1V05, VR_LOOP_PAGE_1, (float*) value);
-        break;
-      case MB_SENSOR_VR_PCH_P1V05_VOLT:
-        ret = vr_read_volt(VR_PCH_P1V05, VR_LOOP_PAGE_1, (float*) value);
-        break;
-      case MB_SENSOR_VR_PCH_P1V05_POWER:
-        ret = vr_read_power(VR_PCH_P1V05, VR_LOOP_PAGE_1, (float*) value);
-        break;
-      case MB_SENSOR_C2_AVA_FTEMP:
-      case MB_SENSOR_C2_AVA_RTEMP:
-      case MB_SENSOR_C3_AVA_FTEMP:
-      case MB_SENSOR_C3_AVA_RTEMP:
-      case MB_SENSOR_C4_AVA_FTEMP:
-      case MB_SENSOR_C4_AVA_RTEMP:
-        ret = read_ava_temp(sensor_num, (float*) value);
-        break;
-      case MB_SENSOR_C2_1_NVME_CTEMP:
-      case MB_SENSOR_C2_2_NVME_CTEMP:
-      case MB_SENSOR_C2_3_NVME_CTEMP:
-      case MB_SENSOR_C2_4_NVME_CTEMP:
-      case MB_SENSOR_C3_1_NVME_CTEMP:
-      case MB_SENSOR_C3_2_NVME_CTEMP:
-      case MB_SENSOR_C3_3_NVME_CTEMP:
-      case MB_SENSOR_C3_4_NVME_CTEMP:
-      case MB_SENSOR_C4_1_NVME_CTEMP:
-      case MB_SENSOR_C4_2_NVME_CTEMP:
-      case MB_SENSOR_C4_3_NVME_CTEMP:
-      case MB_SENSOR_C4_4_NVME_CTEMP:
-        ret = read_nvme_temp(sensor_num, (float*) value);
-        break;
-      case MB_SENSOR_C2_P12V_INA230_VOL:
-      case MB_SENSOR_C3_P12V_INA230_VOL:
-      case MB_SENSOR_C4_P12V_INA230_VOL:
-      case MB_SENSOR_CONN_P12V_INA230_VOL:
-      case MB_SENSOR_C2_P12V_INA230_CURR:
-      case MB_SENSOR_C3_P12V_INA230_CURR:
-      case MB_SENSOR_C4_P12V_INA230_CURR:
-      case MB_SENSOR_CONN_P12V_INA230_CURR:
-      case MB_SENSOR_C2_P12V_INA230_PWR:
-      case MB_SENSOR_C3_P12V_INA230_PWR:
-      case MB_SENSOR_C4_P12V_INA230_PWR:
-      case MB_SENSOR_CONN_P12V_INA230_PWR:
-        ret = read_INA230 (sensor_num, (float*) value, poweron_10s_flag);
-        break;
-      case MB_SENSOR_POWER_FAIL:
-        ret = read_CPLD_power_fail_sts (fru, sensor_num, (float*) value, poweron_10s_flag);
-        break;
-      case MB_SENSOR_MEMORY_LOOP_FAIL:
-        ret = check_postcodes(FRU_MB, sensor_num, (float*) value);
-        break;
-      case MB_SENSOR_PROCESSOR_FAIL:
-        ret = check_frb3(FRU_MB, sensor_num, (float*) value);
-        break;
+static int
+snr_power_state(uint8_t fru) {
+  if (fru != FRU_MB)
+    return SNR_PWR_ON;
 
-      default:
-        return -1;
-      }
-    }
-    if (is_server_off() != server_off) {
-      /* server power status changed while we were reading the sensor.
-       * this sensor is potentially NA. */
-      return pal_sensor_read_raw(fru, sensor_num, value);
-    }
-    break;
-  case FRU_NIC:
-    sprintf(key, "nic_sensor%d", sensor_num);
-    switch(sensor_num) {
-    case MEZZ_SENSOR_TEMP:
-      ret = read_nic_temp(MEZZ_TEMP_DEVICE, (float*) value);
-      break;
-    default:
-      return -1;
-    }
-    break;
-  default:
-    return -1;
+  if (is_server_off()) {
+    poweron_10s_flag = 0;
+    return SNR_PWR_OFF;
   }
+  return (poweron_10s_flag < 5) ? SNR_PWR_SETTLING : SNR_PWR_ON;
+}
 
-  if (ret) {
-    if (ret == READING_NA || ret == -1) {
-      strcpy(str, "NA");
-    } else {
-      return ret;
-    }
-  } else {
-    sprintf(str, "%.2f",*((float*)value));
+static int
+snr_cpu1_present(void) {
+  return is_cpu1_socket_occupy();
+}
+
+static uint8_t
+snr_vr_addr(uint8_t vr) {
+  // VDDQ VR addresses differ on EVT boards, see init_board_sensors()
+  switch (vr) {
+    case VR_CPU0_VDDQ_ABC:
+      return g_vr_cpu0_vddq_abc;
+    case VR_CPU0_VDDQ_DEF:
+      return g_vr_cpu0_vddq_def;
+    case VR_CPU1_VDDQ_GHJ:
+      return g_vr_cpu1_vddq_ghj;
+    case VR_CPU1_VDDQ_KLM:
+      return g_vr_cpu1_vddq_klm;
   }
+  return vr;
+}
 
-  if(edb_cache_set(key, str) < 0) {
-#ifdef DEBUG
-     syslog(LOG_WARNING, "pal_sensor_read_raw: cache_set key = %s, str = %s failed.", key, str);
-#endif
-    return -1;
-  } else {
-    return ret;
+static int
+snr_read_temp(const pal_snr_desc_t *d, uint8_t pwr, float *value) {
+  return read_temp(d->dev, value);
+}
+
+static int
+snr_read_remote_temp(const pal_snr_desc_t *d, uint8_t pwr, float *value) {
+  return read_temp_attr(d->dev, "temp2_input", value);
+}
+
+static void
+snr_inlet_correction(const pal_snr_desc_t *d, float *value) {
+  apply_inlet_correction(value);
+}
+
+static int
+snr_read_nic_temp(const pal_snr_desc_t *d, uint8_t pwr, float *value) {
+  return read_nic_temp(d->dev, value);
+}
+
+static int
+snr_read_fan(const pal_snr_desc_t *d, uint8_t pwr, float *value) {
+  return read_fan_value_f(d->arg, FAN_TACH_RPM, value);
+}
+
+static int
+snr_read_adc(const pal_snr_desc_t *d, uint8_t pwr, float *value) {
+  return read_adc_value(d->arg, ADC_VALUE, value);
+}
+
+static int
+snr_read_battery(const pal_snr_desc_t *d, uint8_t pwr, float *value) {
+  int ret;
+
+  gpio_set(GPIO_BAT_SENSE_EN_N, 0);
+  msleep(10);
+  ret = read_adc_value(d->arg, ADC_VALUE, value);
+  gpio_set(GPIO_BAT_SENSE_EN_N, 1);
+  return ret;
+}
+
+static int
+snr_read_me(const pal_snr_desc_t *d, uint8_t pwr, float *value) {
+  return read_sensor_reading_from_ME(d->num, value);
+}
+
+static int
+snr_read_hsc_curr(const pal_snr_desc_t *d, uint8_t pwr, float *value) {
+  return read_hsc_current_value(value);
+}
+
+static int
+snr_read_hsc_power(const pal_snr_desc_t *d, uint8_t pwr, float *value) {
+  // HSC input power paces the power-on settle window
+  if (pwr == SNR_PWR_SETTLING) {
+    poweron_10s_flag++;
+    return READING_NA;
   }
+  return read_sensor_reading_from_ME(d->num, value);
+}
 
-  return 0;
+static int
+snr_read_cpu_temp(const pal_snr_desc_t *d, uint8_t pwr, float *value) {
+  return read_cpu_temp(d->num, value);
+}
+
+static int
+snr_read_dimm_temp(const pal_snr_desc_t *d, uint8_t pwr, float *value) {
+  return read_dimm_temp(d->num, value);
+}
+
+static int
+snr_read_pkg_power(const pal_snr_desc_t *d, uint8_t pwr, float *value) {
+  return read_cpu_package_power(d->num, value);
+}
+
+static int
+snr_read_vr_temp(const pal_snr_desc_t *d, uint8_t pwr, float *value) {
+  return vr_read_temp(snr_vr_addr(d->addr), d->arg, value);
+}
+
+static int
+snr_read_vr_curr(const pal_snr_desc_t *d, uint8_t pwr, float *value) {
+  return vr_read_curr(snr_vr_addr(d->addr), d->arg, value);
+}
+
+static int
+snr_read_vr_volt(const pal_snr_desc_t *d, uint8_t pwr, float *value) {
+  return vr_read_volt(snr_vr_addr(d->addr), d->arg, value);
+}
+
+static int
+snr_read_vr_power(const pal_snr_desc_t *d, uint8_t pwr, float *value) {
+  return vr_read_power(snr_vr_addr(d->addr), d->arg, value);
+}
+
+static int
+snr_read_ava_temp(const pal_snr_desc_t *d, uint8_t pwr, float *value) {
+  return read_ava_temp(d->num, value);
+}
+
+static int
+snr_read_nvme_temp(const pal_snr_desc_t *d, uint8_t pwr, float *value) {
+  return read_nvme_temp(d->num, value);
+}
+
+static int
+snr_read_ina230(const pal_snr_desc_t *d, uint8_t pwr, float *value) {
+  return read_INA230(d->num, value, poweron_10s_flag);
+}
+
+static int
+snr_read_power_fail(const pal_snr_desc_t *d, uint8_t pwr, float *value) {
+  return read_CPLD_power_fail_sts(d->fru, d->num, value, poweron_10s_flag);
+}
+
+static int
+snr_check_postcodes(const pal_snr_desc_t *d, uint8_t pwr, float *value) {
+  return check_postcodes(d->fru, d->num, value);
+}
+
+static int
+snr_check_frb3(const pal_snr_desc_t *d, uint8_t pwr, float *value) {
+  return check_frb3(d->fru, d->num, value);
+}
+
+static const pal_snr_desc_t fbtp_sensors[] = {
+  /* Temp. Sensors */
+  { .fru = FRU_MB, .num = MB_SENSOR_INLET_TEMP, .bus_type = SNR_BUS_SYSFS, .bus = 6, .addr = 0x4e,
+    .gate = SNR_GATE_STBY, .dev = MB_INLET_TEMP_DEVICE,
+    .read = snr_read_temp },
+  { .fru = FRU_MB, .num = MB_SENSOR_INLET_REMOTE_TEMP, .bus_type = SNR_BUS_SYSFS, .bus = 6, .addr = 0x4e,
+    .gate = SNR_GATE_STBY, .dev = MB_INLET_TEMP_DEVICE,
+    .read = snr_read_remote_temp, .conv = snr_inlet_correction },
+  { .fru = FRU_MB, .num = MB_SENSOR_OUTLET_TEMP, .bus_type = SNR_BUS_SYSFS, .bus = 6, .addr = 0x4f,
+    .gate = SNR_GATE_STBY, .dev = MB_OUTLET_TEMP_DEVICE,
+    .read = snr_read_temp },
+  { .fru = FRU_MB, .num = MB_SENSOR_OUTLET_REMOTE_TEMP, .bus_type = SNR_BUS_SYSFS, .bus = 6, .addr = 0x4f,
+    .gate = SNR_GATE_STBY, .dev = MB_OUTLET_TEMP_DEVICE,
+    .read = snr_read_remote_temp },
+  /* Fan Sensors */
+  { .fru = FRU_MB, .num = MB_SENSOR_FAN0_TACH, .bus_type = SNR_BUS_SYSFS, .bus = 0, .addr = 0,
+    .gate = SNR_GATE_SETTLED, .arg = FAN0,
+    .read = snr_read_fan },
+  { .fru = FRU_MB, .num = MB_SENSOR_FAN1_TACH, .bus_type = SNR_BUS_SYSFS, .bus = 0, .addr = 0,
+    .gate = SNR_GATE_SETTLED, .arg = FAN1,
+    .read = snr_read_fan },
+  /* Various Voltages */
+  { .fru = FRU_MB, .num = MB_SENSOR_P3V3, .bus_type = SNR_BUS_ADC, .bus = 0, .addr = 0,
+    .gate = SNR_GATE_SERVER_ON, .arg = ADC_PIN0,
+    .read = snr_read_adc },
+  { .fru = FRU_MB, .num = MB_SENSOR_P5V, .bus_type = SNR_BUS_ADC, .bus = 0, .addr = 1,
+    .gate = SNR_GATE_SERVER_ON, .arg = ADC_PIN1,
+    .read = snr_read_adc },
+  { .fru = FRU_MB, .num = MB_SENSOR_P12V, .bus_type = SNR_BUS_ADC, .bus = 0, .addr = 2,
+    .gate = SNR_GATE_STBY, .arg = ADC_PIN2,
+    .read = snr_read_adc },
+  { .fru = FRU_MB, .num = MB_SENSOR_P1V05, .bus_type = SNR_BUS_ADC, .bus = 0, .addr = 3,
+    .gate = SNR_GATE_STBY, .arg = ADC_PIN3,
+    .read = snr_read_adc },
+  { .fru = FRU_MB, .num = MB_SENSOR_PVNN_PCH_STBY, .bus_type = SNR_BUS_ADC, .bus = 0, .addr = 4,
+    .gate = SNR_GATE_STBY, .arg = ADC_PIN4,
+    .read = snr_read_adc },
+  { .fru = FRU_MB, .num = MB_SENSOR_P3V3_STBY, .bus_type = SNR_BUS_ADC, .bus = 0, .addr = 5,
+    .gate = SNR_GATE_STBY, .arg = ADC_PIN5,
+    .read = snr_read_adc },
+  { .fru = FRU_MB, .num = MB_SENSOR_P5V_STBY, .bus_type = SNR_BUS_ADC, .bus = 0, .addr = 6,
+    .gate = SNR_GATE_STBY, .arg = ADC_PIN6,
+    .read = snr_read_adc },
+  { .fru = FRU_MB, .num = MB_SENSOR_P3V_BAT, .bus_type = SNR_BUS_ADC, .bus = 0, .addr = 7,
+    .gate = SNR_GATE_STBY, .arg = ADC_PIN7,
+    .read = snr_read_battery },
+  /* Hot Swap Controller, CPU, DIMM and PCH, all proxied by the ME */
+  { .fru = FRU_MB, .num = MB_SENSOR_HSC_IN_VOLT, .bus_type = SNR_BUS_IPMB, .bus = 0x4, .addr = 0x2c,
+    .gate = SNR_GATE_HSC,
+    .read = snr_read_me },
+  { .fru = FRU_MB, .num = MB_SENSOR_HSC_OUT_CURR, .bus_type = SNR_BUS_IPMB, .bus = 0x4, .addr = 0x2c,
+    .gate = SNR_GATE_HSC,
+    .read = snr_read_hsc_curr },
+  { .fru = FRU_MB, .num = MB_SENSOR_HSC_IN_POWER, .bus_type = SNR_BUS_IPMB, .bus = 0x4, .addr = 0x2c,
+    .gate = SNR_GATE_STBY,
+    .read = snr_read_hsc_power },
+  { .fru = FRU_MB, .num = MB_SENSOR_PCH_TEMP, .bus_type = SNR_BUS_IPMB, .bus = 0x4, .addr = 0x2c,
+    .gate = SNR_GATE_SERVER_ON,
+    .read = snr_read_me },
+  { .fru = FRU_MB, .num = MB_SENSOR_CPU0_TEMP, .bus_type = SNR_BUS_PECI, .bus = 0x4, .addr = 0x2c,
+    .gate = SNR_GATE_SERVER_ON,
+    .read = snr_read_cpu_temp },
+  { .fru = FRU_MB, .num = MB_SENSOR_CPU1_TEMP, .bus_type = SNR_BUS_PECI, .bus = 0x4, .addr = 0x2c,
+    .gate = SNR_GATE_SERVER_ON,
+    .read = snr_read_cpu_temp },
+  { .fru = FRU_MB, .num = MB_SENSOR_CPU0_DIMM_GRPA_TEMP, .bus_type = SNR_BUS_PECI, .bus = 0x4, .addr = 0x2c,
+    .gate = SNR_GATE_SERVER_ON,
+    .read = snr_read_dimm_temp },
+  { .fru = FRU_MB, .num = MB_SENSOR_CPU0_DIMM_GRPB_TEMP, .bus_type = SNR_BUS_PECI, .bus = 0x4, .addr = 0x2c,
+    .gate = SNR_GATE_SERVER_ON,
+    .read = snr_read_dimm_temp },
+  { .fru = FRU_MB, .num = MB_SENSOR_CPU1_DIMM_GRPC_TEMP, .bus_type = SNR_BUS_PECI, .bus = 0x4, .addr = 0x2c,
+    .gate = SNR_GATE_SERVER_ON,
+    .read = snr_read_dimm_temp },
+  { .fru = FRU_MB, .num = MB_SENSOR_CPU1_DIMM_GRPD_TEMP, .bus_type = SNR_BUS_PECI, .bus = 0x4, .addr = 0x2c,
+    .gate = SNR_GATE_SERVER_ON,
+    .read = snr_read_dimm_temp },
+  { .fru = FRU_MB, .num = MB_SENSOR_CPU0_PKG_POWER, .bus_type = SNR_BUS_PECI, .bus = 0x4, .addr = 0x2c,
+    .gate = SNR_GATE_SERVER_ON,
+    .read = snr_read_pkg_power },
+  { .fru = FRU_MB, .num = MB_SENSOR_CPU1_PKG_POWER, .bus_type = SNR_BUS_PECI, .bus = 0x4, .addr = 0x2c,
+    .gate = SNR_GATE_SERVER_ON,
+    .read = snr_read_pkg_power },
+  /* VR Sensors */
+  { .fru = FRU_MB, .num = MB_SENSOR_VR_CPU0_VCCIN_TEMP, .bus_type = SNR_BUS_I2C, .bus = VR_BUS_ID, .addr = VR_CPU0_VCCIN,
+    .gate = SNR_GATE_SERVER_ON, .arg = VR_LOOP_PAGE_0,
+    .read = snr_read_vr_temp },
+  { .fru = FRU_MB, .num = MB_SENSOR_VR_CPU0_VCCIN_CURR, .bus_type = SNR_BUS_I2C, .bus = VR_BUS_ID, .addr = VR_CPU0_VCCIN,
+    .gate = SNR_GATE_SERVER_ON, .arg = VR_LOOP_PAGE_0,
+    .read = snr_read_vr_curr },
+  { .fru = FRU_MB, .num = MB_SENSOR_VR_CPU0_VCCIN_VOLT, .bus_type = SNR_BUS_I2C, .bus = VR_BUS_ID, .addr = VR_CPU0_VCCIN,
+    .gate = SNR_GATE_SERVER_ON, .arg = VR_LOOP_PAGE_0,
+    .read = snr_read_vr_volt },
+  { .fru = FRU_MB, .num = MB_SENSOR_VR_CPU0_VCCIN_POWER, .bus_type = SNR_BUS_I2C, .bus = VR_BUS_ID, .addr = VR_CPU0_VCCIN,
+    .gate = SNR_GATE_SERVER_ON, .arg = VR_LOOP_PAGE_0,
+    .read = snr_read_vr_power },
+  { .fru = FRU_MB, .num = MB_SENSOR_VR_CPU0_VSA_TEMP, .bus_type = SNR_BUS_I2C, .bus = VR_BUS_ID, .addr = VR_CPU0_VSA,
+    .gate = SNR_GATE_SERVER_ON, .arg = VR_LOOP_PAGE_1,
+    .read = snr_read_vr_temp },
+  { .fru = FRU_MB, .num = MB_SENSOR_VR_CPU0_VSA_CURR, .bus_type = SNR_BUS_I2C, .bus = VR_BUS_ID, .addr = VR_CPU0_VSA,
+    .gate = SNR_GATE_SERVER_ON, .arg = VR_LOOP_PAGE_1,
+    .read = snr_read_vr_curr },
+  { .fru = FRU_MB, .num = MB_SENSOR_VR_CPU0_VSA_VOLT, .bus_type = SNR_BUS_I2C, .bus = VR_BUS_ID, .addr = VR_CPU0_VSA,
+    .gate = SNR_GATE_SERVER_ON, .arg = VR_LOOP_PAGE_1,
+    .read = snr_read_vr_volt },
+  { .fru = FRU_MB, .num = MB_SENSOR_VR_CPU0_VSA_POWER, .bus_type = SNR_BUS_I2C, .bus = VR_BUS_ID, .addr = VR_CPU0_VSA,
+    .gate = SNR_GATE_SERVER_ON, .arg = VR_LOOP_PAGE_1,
+    .read = snr_read_vr_power },
+  { .fru = FRU_MB, .num = MB_SENSOR_VR_CPU0_VCCIO_TEMP, .bus_type = SNR_BUS_I2C, .bus = VR_BUS_ID, .addr = VR_CPU0_VCCIO,
+    .gate = SNR_GATE_SERVER_ON, .arg = VR_LOOP_PAGE_0,
+    .read = snr_read_vr_temp },
+  { .fru = FRU_MB, .num = MB_SENSOR_VR_CPU0_VCCIO_CURR, .bus_type = SNR_BUS_I2C, .bus = VR_BUS_ID, .addr = VR_CPU0_VCCIO,
+    .gate = SNR_GATE_SERVER_ON, .arg = VR_LOOP_PAGE_0,
+    .read = snr_read_vr_curr },
+  { .fru = FRU_MB, .num = MB_SENSOR_VR_CPU0_VCCIO_VOLT, .bus_type = SNR_BUS_I2C, .bus = VR_BUS_ID, .addr = VR_CPU0_VCCIO,
+    .gate = SNR_GATE_SERVER_ON, .arg = VR_LOOP_PAGE_0,
+    .read = snr_read_vr_volt },
+  { .fru = FRU_MB, .num = MB_SENSOR_VR_CPU0_VCCIO_POWER, .bus_type = SNR_BUS_I2C, .bus = VR_BUS_ID, .addr = VR_CPU0_VCCIO,
+    .gate = SNR_GATE_SERVER_ON, .arg = VR_LOOP_PAGE_0,
+    .read = snr_read_vr_power },
+  { .fru = FRU_MB, .num = MB_SENSOR_VR_CPU0_VDDQ_GRPA_TEMP, .bus_type = SNR_BUS_I2C, .bus = VR_BUS_ID, .addr = VR_CPU0_VDDQ_ABC,
+    .gate = SNR_GATE_SERVER_ON, .arg = VR_LOOP_PAGE_0,
+    .read = snr_read_vr_temp },
+  { .fru = FRU_MB, .num = MB_SENSOR_VR_CPU0_VDDQ_GRPA_CURR, .bus_type = SNR_BUS_I2C, .bus = VR_BUS_ID, .addr = VR_CPU0_VDDQ_ABC,
+    .gate = SNR_GATE_SERVER_ON, .arg = VR_LOOP_PAGE_0,
+    .read = snr_read_vr_curr },
+  { .fru = FRU_MB, .num = MB_SENSOR_VR_CPU0_VDDQ_GRPA_VOLT, .bus_type = SNR_BUS_I2C, .bus = VR_BUS_ID, .addr = VR_CPU0_VDDQ_ABC,
+    .gate = SNR_GATE_SERVER_ON, .arg = VR_LOOP_PAGE_0,
+    .read = snr_read_vr_volt },
+  { .fru = FRU_MB, .num = MB_SENSOR_VR_CPU0_VDDQ_GRPA_POWER, .bus_type = SNR_BUS_I2C, .bus = VR_BUS_ID, .addr = VR_CPU0_VDDQ_ABC,
+    .gate = SNR_GATE_SERVER_ON, .arg = VR_LOOP_PAGE_0,
+    .read = snr_read_vr_power },
+  { .fru = FRU_MB, .num = MB_SENSOR_VR_CPU0_VDDQ_GRPB_TEMP, .bus_type = SNR_BUS_I2C, .bus = VR_BUS_ID, .addr = VR_CPU0_VDDQ_DEF,
+    .gate = SNR_GATE_SERVER_ON, .arg = VR_LOOP_PAGE_0,
+    .read = snr_read_vr_temp },
+  { .fru = FRU_MB, .num = MB_SENSOR_VR_CPU0_VDDQ_GRPB_CURR, .bus_type = SNR_BUS_I2C, .bus = VR_BUS_ID, .addr = VR_CPU0_VDDQ_DEF,
+    .gate = SNR_GATE_SERVER_ON, .arg = VR_LOOP_PAGE_0,
+    .read = snr_read_vr_curr },
+  { .fru = FRU_MB, .num = MB_SENSOR_VR_CPU0_VDDQ_GRPB_VOLT, .bus_type = SNR_BUS_I2C, .bus = VR_BUS_ID, .addr = VR_CPU0_VDDQ_DEF,
+    .gate = SNR_GATE_SERVER_ON, .arg = VR_LOOP_PAGE_0,
+    .read = snr_read_vr_volt },
+  { .fru = FRU_MB, .num = MB_SENSOR_VR_CPU0_VDDQ_GRPB_POWER, .bus_type = SNR_BUS_I2C, .bus = VR_BUS_ID, .addr = VR_CPU0_VDDQ_DEF,
+    .gate = SNR_GATE_SERVER_ON, .arg = VR_LOOP_PAGE_0,
+    .read = snr_read_vr_power },
+  { .fru = FRU_MB, .num = MB_SENSOR_VR_CPU1_VCCIN_TEMP, .bus_type = SNR_BUS_I2C, .bus = VR_BUS_ID, .addr = VR_CPU1_VCCIN,
+    .gate = SNR_GATE_SERVER_ON, .arg = VR_LOOP_PAGE_0,
+    .read = snr_read_vr_temp, .present = snr_cpu1_present },
+  { .fru = FRU_MB, .num = MB_SENSOR_VR_CPU1_VCCIN_CURR, .bus_type = SNR_BUS_I2C, .bus = VR_BUS_ID, .addr = VR_CPU1_VCCIN,
+    .gate = SNR_GATE_SERVER_ON, .arg = VR_LOOP_PAGE_0,
+    .read = snr_read_vr_curr, .present = snr_cpu1_present },
+  { .fru = FRU_MB, .num = MB_SENSOR_VR_CPU1_VCCIN_VOLT, .bus_type = SNR_BUS_I2C, .bus = VR_BUS_ID, .addr = VR_CPU1_VCCIN,
+    .gate = SNR_GATE_SERVER_ON, .arg = VR_LOOP_PAGE_0,
+    .read = snr_read_vr_volt, .present = snr_cpu1_present },
+  { .fru = FRU_MB, .num = MB_SENSOR_VR_CPU1_VCCIN_POWER, .bus_type = SNR_BUS_I2C, .bus = VR_BUS_ID, .addr = VR_CPU1_VCCIN,
+    .gate = SNR_GATE_SERVER_ON, .arg = VR_LOOP_PAGE_0,
+    .read = snr_read_vr_power, .present = snr_cpu1_present },
+  { .fru = FRU_MB, .num = MB_SENSOR_VR_CPU1_VSA_TEMP, .bus_type = SNR_BUS_I2C, .bus = VR_BUS_ID, .addr = VR_CPU1_VSA,
+    .gate = SNR_GATE_SERVER_ON, .arg = VR_LOOP_PAGE_1,
+    .read = snr_read_vr_temp, .present = snr_cpu1_present },
+  { .fru = FRU_MB, .num = MB_SENSOR_VR_CPU1_VSA_CURR, .bus_type = SNR_BUS_I2C, .bus = VR_BUS_ID, .addr = VR_CPU1_VSA,
+    .gate = SNR_GATE_SERVER_ON, .arg = VR_LOOP_PAGE_1,
+    .read = snr_read_vr_curr, .present = snr_cpu1_present },
+  { .fru = FRU_MB, .num = MB_SENSOR_VR_CPU1_VSA_VOLT, .bus_type = SNR_BUS_I2C, .bus = VR_BUS_ID, .addr = VR_CPU1_VSA,
+    .gate = SNR_GATE_SERVER_ON, .arg = VR_LOOP_PAGE_1,
+    .read = snr_read_vr_volt, .present = snr_cpu1_present },
+  { .fru = FRU_MB, .num = MB_SENSOR_VR_CPU1_VSA_POWER, .bus_type = SNR_BUS_I2C, .bus = VR_BUS_ID, .addr = VR_CPU1_VSA,
+    .gate = SNR_GATE_SERVER_ON, .arg = VR_LOOP_PAGE_1,
+    .read = snr_read_vr_power, .present = snr_cpu1_present },
+  { .fru = FRU_MB, .num = MB_SENSOR_VR_CPU1_VCCIO_TEMP, .bus_type = SNR_BUS_I2C, .bus = VR_BUS_ID, .addr = VR_CPU1_VCCIO,
+    .gate = SNR_GATE_SERVER_ON, .arg = VR_LOOP_PAGE_0,
+    .read = snr_read_vr_temp, .present = snr_cpu1_present },
+  { .fru = FRU_MB, .num = MB_SENSOR_VR_CPU1_VCCIO_CURR, .bus_type = SNR_BUS_I2C, .bus = VR_BUS_ID, .addr = VR_CPU1_VCCIO,
+    .gate = SNR_GATE_SERVER_ON, .arg = VR_LOOP_PAGE_0,
+    .read = snr_read_vr_curr, .present = snr_cpu1_present },
+  { .fru = FRU_MB, .num = MB_SENSOR_VR_CPU1_VCCIO_VOLT, .bus_type = SNR_BUS_I2C, .bus = VR_BUS_ID, .addr = VR_CPU1_VCCIO,
+    .gate = SNR_GATE_SERVER_ON, .arg = VR_LOOP_PAGE_0,
+    .read = snr_read_vr_volt, .present = snr_cpu1_present },
+  { .fru = FRU_MB, .num = MB_SENSOR_VR_CPU1_VCCIO_POWER, .bus_type = SNR_BUS_I2C, .bus = VR_BUS_ID, .addr = VR_CPU1_VCCIO,
+    .gate = SNR_GATE_SERVER_ON, .arg = VR_LOOP_PAGE_0,
+    .read = snr_read_vr_power, .present = snr_cpu1_present },
+  { .fru = FRU_MB, .num = MB_SENSOR_VR_CPU1_VDDQ_GRPC_TEMP, .bus_type = SNR_BUS_I2C, .bus = VR_BUS_ID, .addr = VR_CPU1_VDDQ_GHJ,
+    .gate = SNR_GATE_SERVER_ON, .arg = VR_LOOP_PAGE_0,
+    .read = snr_read_vr_temp, .present = snr_cpu1_present },
+  { .fru = FRU_MB, .num = MB_SENSOR_VR_CPU1_VDDQ_GRPC_CURR, .bus_type = SNR_BUS_I2C, .bus = VR_BUS_ID, .addr = VR_CPU1_VDDQ_GHJ,
+    .gate = SNR_GATE_SERVER_ON, .arg = VR_LOOP_PAGE_0,
+    .read = snr_read_vr_curr, .present = snr_cpu1_present },
+  { .fru = FRU_MB, .num = MB_SENSOR_VR_CPU1_VDDQ_GRPC_VOLT, .bus_type = SNR_BUS_I2C, .bus = VR_BUS_ID, .addr = VR_CPU1_VDDQ_GHJ,
+    .gate = SNR_GATE_SERVER_ON, .arg = VR_LOOP_PAGE_0,
+    .read = snr_read_vr_volt, .present = snr_cpu1_present },
+  { .fru = FRU_MB, .num = MB_SENSOR_VR_CPU1_VDDQ_GRPC_POWER, .bus_type = SNR_BUS_I2C, .bus = VR_BUS_ID, .addr = VR_CPU1_VDDQ_GHJ,
+    .gate = SNR_GATE_SERVER_ON, .arg = VR_LOOP_PAGE_0,
+    .read = snr_read_vr_power, .present = snr_cpu1_present },
+  { .fru = FRU_MB, .num = MB_SENSOR_VR_CPU1_VDDQ_GRPD_TEMP, .bus_type = SNR_BUS_I2C, .bus = VR_BUS_ID, .addr = VR_CPU1_VDDQ_KLM,
+    .gate = SNR_GATE_SERVER_ON, .arg = VR_LOOP_PAGE_0,
+    .read = snr_read_vr_temp, .present = snr_cpu1_present },
+  { .fru = FRU_MB, .num = MB_SENSOR_VR_CPU1_VDDQ_GRPD_CURR, .bus_type = SNR_BUS_I2C, .bus = VR_BUS_ID, .addr = VR_CPU1_VDDQ_KLM,
+    .gate = SNR_GATE_SERVER_ON, .arg = VR_LOOP_PAGE_0,
+    .read = snr_read_vr_curr, .present = snr_cpu1_present },
+  { .fru = FRU_MB, .num = MB_SENSOR_VR_CPU1_VDDQ_GRPD_VOLT, .bus_type = SNR_BUS_I2C, .bus = VR_BUS_ID, .addr = VR_CPU1_VDDQ_KLM,
+    .gate = SNR_GATE_SERVER_ON, .arg = VR_LOOP_PAGE_0,
+    .read = snr_read_vr_volt, .present = snr_cpu1_present },
+  { .fru = FRU_MB, .num = MB_SENSOR_VR_CPU1_VDDQ_GRPD_POWER, .bus_type = SNR_BUS_I2C, .bus = VR_BUS_ID, .addr = VR_CPU1_VDDQ_KLM,
+    .gate = SNR_GATE_SERVER_ON, .arg = VR_LOOP_PAGE_0,
+    .read = snr_read_vr_power, .present = snr_cpu1_present },
+  { .fru = FRU_MB, .num = MB_SENSOR_VR_PCH_PVNN_TEMP, .bus_type = SNR_BUS_I2C, .bus = VR_BUS_ID, .addr = VR_PCH_PVNN,
+    .gate = SNR_GATE_SERVER_ON, .arg = VR_LOOP_PAGE_0,
+    .read = snr_read_vr_temp },
+  { .fru = FRU_MB, .num = MB_SENSOR_VR_PCH_PVNN_CURR, .bus_type = SNR_BUS_I2C, .bus = VR_BUS_ID, .addr = VR_PCH_PVNN,
+    .gate = SNR_GATE_SERVER_ON, .arg = VR_LOOP_PAGE_0,
+    .read = snr_read_vr_curr },
+  { .fru = FRU_MB, .num = MB_SENSOR_VR_PCH_PVNN_VOLT, .bus_type = SNR_BUS_I2C, .bus = VR_BUS_ID, .addr = VR_PCH_PVNN,
+    .gate = SNR_GATE_SERVER_ON, .arg = VR_LOOP_PAGE_0,
+    .read = snr_read_vr_volt },
+  { .fru = FRU_MB, .num = MB_SENSOR_VR_PCH_PVNN_POWER, .bus_type = SNR_BUS_I2C, .bus = VR_BUS_ID, .addr = VR_PCH_PVNN,
+    .gate = SNR_GATE_SERVER_ON, .arg = VR_LOOP_PAGE_0,
+    .read = snr_read_vr_power },
+  { .fru = FRU_MB, .num = MB_SENSOR_VR_PCH_P1V05_TEMP, .bus_type = SNR_BUS_I2C, .bus = VR_BUS_ID, .addr = VR_PCH_P1V05,
+    .gate = SNR_GATE_SERVER_ON, .arg = VR_LOOP_PAGE_1,
+    .read = snr_read_vr_temp },
+  { .fru = FRU_MB, .num = MB_SENSOR_VR_PCH_P1V05_CURR, .bus_type = SNR_BUS_I2C, .bus = VR_BUS_ID, .addr = VR_PCH_P1V05,
+    .gate = SNR_GATE_SERVER_ON, .arg = VR_LOOP_PAGE_1,
+    .read = snr_read_vr_curr },
+  { .fru = FRU_MB, .num = MB_SENSOR_VR_PCH_P1V05_VOLT, .bus_type = SNR_BUS_I2C, .bus = VR_BUS_ID, .addr = VR_PCH_P1V05,
+    .gate = SNR_GATE_SERVER_ON, .arg = VR_LOOP_PAGE_1,
+    .read = snr_read_vr_volt },
+  { .fru = FRU_MB, .num = MB_SENSOR_VR_PCH_P1V05_POWER, .bus_type = SNR_BUS_I2C, .bus = VR_BUS_ID, .addr = VR_PCH_P1V05,
+    .gate = SNR_GATE_SERVER_ON, .arg = VR_LOOP_PAGE_1,
+    .read = snr_read_vr_power },
+  /* Riser cards, behind the mux on the riser bus */
+  { .fru = FRU_MB, .num = MB_SENSOR_C2_AVA_FTEMP, .bus_type = SNR_BUS_I2C, .bus = RISER_BUS_ID, .addr = 2,
+    .gate = SNR_GATE_SERVER_ON,
+    .read = snr_read_ava_temp },
+  { .fru = FRU_MB, .num = MB_SENSOR_C2_AVA_RTEMP, .bus_type = SNR_BUS_I2C, .bus = RISER_BUS_ID, .addr = 2,
+    .gate = SNR_GATE_SERVER_ON,
+    .read = snr_read_ava_temp },
+  { .fru = FRU_MB, .num = MB_SENSOR_C2_1_NVME_CTEMP, .bus_type = SNR_BUS_I2C, .bus = RISER_BUS_ID, .addr = 2,
+    .gate = SNR_GATE_SERVER_ON,
+    .read = snr_read_nvme_temp },
+  { .fru = FRU_MB, .num = MB_SENSOR_C2_2_NVME_CTEMP, .bus_type = SNR_BUS_I2C, .bus = RISER_BUS_ID, .addr = 2,
+    .gate = SNR_GATE_SERVER_ON,
+    .read = snr_read_nvme_temp },
+  { .fru = FRU_MB, .num = MB_SENSOR_C2_3_NVME_CTEMP, .bus_type = SNR_BUS_I2C, .bus = RISER_BUS_ID, .addr = 2,
+    .gate = SNR_GATE_SERVER_ON,
+    .read = snr_read_nvme_temp },
+  { .fru = FRU_MB, .num = MB_SENSOR_C2_4_NVME_CTEMP, .bus_type = SNR_BUS_I2C, .bus = RISER_BUS_ID, .addr = 2,
+    .gate = SNR_GATE_SERVER_ON,
+    .read = snr_read_nvme_temp },
+  { .fru = FRU_MB, .num = MB_SENSOR_C3_AVA_FTEMP, .bus_type = SNR_BUS_I2C, .bus = RISER_BUS_ID, .addr = 3,
+    .gate = SNR_GATE_SERVER_ON,
+    .read = snr_read_ava_temp },
+  { .fru = FRU_MB, .num = MB_SENSOR_C3_AVA_RTEMP, .bus_type = SNR_BUS_I2C, .bus = RISER_BUS_ID, .addr = 3,
+    .gate = SNR_GATE_SERVER_ON,
+    .read = snr_read_ava_temp },
+  { .fru = FRU_MB, .num = MB_SENSOR_C3_1_NVME_CTEMP, .bus_type = SNR_BUS_I2C, .bus = RISER_BUS_ID, .addr = 3,
+    .gate = SNR_GATE_SERVER_ON,
+    .read = snr_read_nvme_temp },
+  { .fru = FRU_MB, .num = MB_SENSOR_C3_2_NVME_CTEMP, .bus_type = SNR_BUS_I2C, .bus = RISER_BUS_ID, .addr = 3,
+    .gate = SNR_GATE_SERVER_ON,
+    .read = snr_read_nvme_temp },
+  { .fru = FRU_MB, .num = MB_SENSOR_C3_3_NVME_CTEMP, .bus_type = SNR_BUS_I2C, .bus = RISER_BUS_ID, .addr = 3,
+    .gate = SNR_GATE_SERVER_ON,
+    .read = snr_read_nvme_temp },
+  { .fru = FRU_MB, .num = MB_SENSOR_C3_4_NVME_CTEMP, .bus_type = SNR_BUS_I2C, .bus = RISER_BUS_ID, .addr = 3,
+    .gate = SNR_GATE_SERVER_ON,
+    .read = snr_read_nvme_temp },
+  { .fru = FRU_MB, .num = MB_SENSOR_C4_AVA_FTEMP, .bus_type = SNR_BUS_I2C, .bus = RISER_BUS_ID, .addr = 4,
+    .gate = SNR_GATE_SERVER_ON,
+    .read = snr_read_ava_temp },
+  { .fru = FRU_MB, .num = MB_SENSOR_C4_AVA_RTEMP, .bus_type = SNR_BUS_I2C, .bus = RISER_BUS_ID, .addr = 4,
+    .gate = SNR_GATE_SERVER_ON,
+    .read = snr_read_ava_temp },
+  { .fru = FRU_MB, .num = MB_SENSOR_C4_1_NVME_CTEMP, .bus_type = SNR_BUS_I2C, .bus = RISER_BUS_ID, .addr = 4,
+    .gate = SNR_GATE_SERVER_ON,
+    .read = snr_read_nvme_temp },
+  { .fru = FRU_MB, .num = MB_SENSOR_C4_2_NVME_CTEMP, .bus_type = SNR_BUS_I2C, .bus = RISER_BUS_ID, .addr = 4,
+    .gate = SNR_GATE_SERVER_ON,
+    .read = snr_read_nvme_temp },
+  { .fru = FRU_MB, .num = MB_SENSOR_C4_3_NVME_CTEMP, .bus_type = SNR_BUS_I2C, .bus = RISER_BUS_ID, .addr = 4,
+    .gate = SNR_GATE_SERVER_ON,
+    .read = snr_read_nvme_temp },
+  { .fru = FRU_MB, .num = MB_SENSOR_C4_4_NVME_CTEMP, .bus_type = SNR_BUS_I2C, .bus = RISER_BUS_ID, .addr = 4,
+    .gate = SNR_GATE_SERVER_ON,
+    .read = snr_read_nvme_temp },
+  { .fru = FRU_MB, .num = MB_SENSOR_C2_P12V_INA230_VOL, .bus_type = SNR_BUS_I2C, .bus = RISER_BUS_ID, .addr = 2,
+    .gate = SNR_GATE_SERVER_ON,
+    .read = snr_read_ina230 },
+  { .fru = FRU_MB, .num = MB_SENSOR_C2_P12V_INA230_CURR, .bus_type = SNR_BUS_I2C, .bus = RISER_BUS_ID, .addr = 2,
+    .gate = SNR_GATE_SERVER_ON,
+    .read = snr_read_ina230 },
+  { .fru = FRU_MB, .num = MB_SENSOR_C2_P12V_INA230_PWR, .bus_type = SNR_BUS_I2C, .bus = RISER_BUS_ID, .addr = 2,
+    .gate = SNR_GATE_SERVER_ON,
+    .read = snr_read_ina230 },
+  { .fru = FRU_MB, .num = MB_SENSOR_C3_P12V_INA230_VOL, .bus_type = SNR_BUS_I2C, .bus = RISER_BUS_ID, .addr = 3,
+    .gate = SNR_GATE_SERVER_ON,
+    .read = snr_read_ina230 },
+  { .fru = FRU_MB, .num = MB_SENSOR_C3_P12V_INA230_CURR, .bus_type = SNR_BUS_I2C, .bus = RISER_BUS_ID, .addr = 3,
+    .gate = SNR_GATE_SERVER_ON,
+    .read = snr_read_ina230 },
+  { .fru = FRU_MB, .num = MB_SENSOR_C3_P12V_INA230_PWR, .bus_type = SNR_BUS_I2C, .bus = RISER_BUS_ID, .addr = 3,
+    .gate = SNR_GATE_SERVER_ON,
+    .read = snr_read_ina230 },
+  { .fru = FRU_MB, .num = MB_SENSOR_C4_P12V_INA230_VOL, .bus_type = SNR_BUS_I2C, .bus = RISER_BUS_ID, .addr = 4,
+    .gate = SNR_GATE_SERVER_ON,
+    .read = snr_read_ina230 },
+  { .fru = FRU_MB, .num = MB_SENSOR_C4_P12V_INA230_CURR, .bus_type = SNR_BUS_I2C, .bus = RISER_BUS_ID, .addr = 4,
+    .gate = SNR_GATE_SERVER_ON,
+    .read = snr_read_ina230 },
+  { .fru = FRU_MB, .num = MB_SENSOR_C4_P12V_INA230_PWR, .bus_type = SNR_BUS_I2C, .bus = RISER_BUS_ID, .addr = 4,
+    .gate = SNR_GATE_SERVER_ON,
+    .read = snr_read_ina230 },
+  { .fru = FRU_MB, .num = MB_SENSOR_CONN_P12V_INA230_VOL, .bus_type = SNR_BUS_I2C, .bus = RISER_BUS_ID, .addr = 0,
+    .gate = SNR_GATE_SERVER_ON,
+    .read = snr_read_ina230 },
+  { .fru = FRU_MB, .num = MB_SENSOR_CONN_P12V_INA230_CURR, .bus_type = SNR_BUS_I2C, .bus = RISER_BUS_ID, .addr = 0,
+    .gate = SNR_GATE_SERVER_ON,
+    .read = snr_read_ina230 },
+  { .fru = FRU_MB, .num = MB_SENSOR_CONN_P12V_INA230_PWR, .bus_type = SNR_BUS_I2C, .bus = RISER_BUS_ID, .addr = 0,
+    .gate = SNR_GATE_SERVER_ON,
+    .read = snr_read_ina230 },
+  /* Discrete Sensors */
+  { .fru = FRU_MB, .num = MB_SENSOR_POWER_FAIL, .bus_type = SNR_BUS_I2C, .bus = CPLD_BUS_ID, .addr = CPLD_ADDR,
+    .gate = SNR_GATE_STBY,
+    .read = snr_read_power_fail },
+  { .fru = FRU_MB, .num = MB_SENSOR_MEMORY_LOOP_FAIL, .bus_type = SNR_BUS_NONE, .bus = 0, .addr = 0,
+    .gate = SNR_GATE_SERVER_ON,
+    .read = snr_check_postcodes },
+  { .fru = FRU_MB, .num = MB_SENSOR_PROCESSOR_FAIL, .bus_type = SNR_BUS_NONE, .bus = 0, .addr = 0,
+    .gate = SNR_GATE_SERVER_ON,
+    .read = snr_check_frb3 },
+  /* NIC */
+  { .fru = FRU_NIC, .num = MEZZ_SENSOR_TEMP, .bus_type = SNR_BUS_SYSFS, .bus = 8, .addr = 0x1f,
+    .gate = SNR_GATE_STBY, .dev = MEZZ_TEMP_DEVICE,
+    .read = snr_read_nic_temp },
+};
+
+static pal_snr_table_t fbtp_snr_table = PAL_SNR_TABLE(fbtp_sensors, snr_power_state);
+
+int
+pal_sensor_read_raw(uint8_t fru, uint8_t sensor_num, void *value) {
+  return pal_snr_read(&fbtp_snr_table, fru, sensor_num, (float *) value);
+}
+
+int
+pal_sensor_sweep(uint8_t fru, pal_sensor_sweep_cb cb, void *arg) {
+  return pal_snr_sweep(&fbtp_snr_table, fru, cb, arg);
 }
 
 int
@@ -5953,6 +6031,8 @@ pal_add_cri_sel(char *str)
   char cmd[128];
   snprintf(cmd, 128, "logger -p local0.err \"%s\"",str);
   system(cmd);
+
+  evbus_publish(EVBUS_T_CRI_SEL, FRU_MB, LOG_ERR, NULL, 0, "%s", str);
 }
 
 int
@@ -33,6 +33,7 @@
 #include <sys/stat.h>
 #include <sys/ioctl.h>
 #include <openbmc/obmc-i2c.h>
+#include <openbmc/i2c-pool.h>
 #include <openbmc/edb.h>
 #include "vr.h"
 
@@ -130,15 +131,41 @@ msleep(int msec) {
   }
 }
 
+// MAX_READ_RETRY tries, backing off from 10ms to 100ms, for at most 1s
+static const i2c_retry_t vr_retry = {MAX_READ_RETRY - 1, 10, 100, 1000};
+
+// Select the loop's page and read a 2-byte telemetry register, with the
+// bus held so that nobody switches the page in between
+static int
+vr_read_telemetry(uint8_t vr, uint8_t loop, uint8_t reg, uint8_t *rbuf) {
+  uint8_t tbuf[2];
+  int ret;
+
+  if (i2c_pool_lock(VR_BUS_ID)) {
+    syslog(LOG_WARNING, "%s: bus#%x not available\n", __func__, VR_BUS_ID);
+    return -1;
+  }
+
+  tbuf[0] = 0x00;
+  tbuf[1] = loop;
+  ret = i2c_pool_rdwr(VR_BUS_ID, vr, tbuf, 2, rbuf, 0, &vr_retry);
+  if (!ret) {
+    tbuf[0] = reg;
+    ret = i2c_pool_rdwr(VR_BUS_ID, vr, tbuf, 1, rbuf, 2, &vr_retry);
+  }
+#ifdef DEBUG
+  if (ret)
+    syslog(LOG_WARNING, "%s: i2c_io failed for bus#%x, dev#%x\n", __func__, VR_BUS_ID, vr);
+#endif
+
+  i2c_pool_unlock(VR_BUS_ID);
+  return ret;
+}
+
 int
 vr_read_volt(uint8_t vr, uint8_t loop, float *value) {
-  int fd;
-  char fn[32];
   static int count = 0;
   int ret = -1;
-  unsigned int retry = MAX_READ_RETRY;
-  uint8_t tcount, rcount;
-  uint8_t tbuf[16] = {0};
   uint8_t rbuf[16] = {0};
 
   // The following block for detecting vr_update is in progress or not
@@ -158,89 +185,21 @@ vr_read_volt(uint8_t vr, uint8_t loop, float *value) {
 
   count = 0;
 
-  snprintf(fn, sizeof(fn), "/dev/i2c-%d", VR_BUS_ID);
-  while (retry) {
-    fd = open(fn, O_RDWR);
-    if (fd < 0) {
-      syslog(LOG_WARNING, "read_vr_volt: i2c_open failed for bus#%x\n", VR_BUS_ID);
-      retry--;
-      msleep(100);
-    } else {
-      break;
-    }
-
-    if(retry == 0)
-      goto error_exit;
-  }
-
-  // Set the page to read Voltage
-  tbuf[0] = 0x00;
-  tbuf[1] = loop;
-
-  tcount = 2;
-  rcount = 0;
-
-  retry = MAX_READ_RETRY;
-  while (retry) {
-    ret = i2c_rdwr_msg_transfer(fd, vr, tbuf, tcount, rbuf, rcount);
-    if (ret) {
-#ifdef DEBUG
-      syslog(LOG_WARNING, "read_vr_volt: i2c_io failed for bus#%x, dev#%x\n", VR_BUS_ID, vr);
-#endif
-      retry--;
-      msleep(100);
-    } else {
-      break;
-    }
-
-    if(retry == 0)
-      goto error_exit;
-  }
-
-  // Read 2 bytes from Voltage register
-  tbuf[0] = VR_TELEMETRY_VOLT;
-
-  tcount = 1;
-  rcount = 2;
-
-  retry = MAX_READ_RETRY;
-  while(retry) {
-    ret = i2c_rdwr_msg_transfer(fd, vr, tbuf, tcount, rbuf, rcount);
-    if (ret) {
-#ifdef DEBUG
-      syslog(LOG_WARNING, "read_vr_volt: i2c_io failed for bus#%x, dev#%x\n", VR_BUS_ID, vr);
-#endif
-      retry--;
-      msleep(100);
-    } else {
-      break;
-    }
-
-    if (retry == 0)
-      goto error_exit;
-  }
+  ret = vr_read_telemetry(vr, loop, VR_TELEMETRY_VOLT, rbuf);
+  if (ret)
+    return ret;
 
   // Calculate Voltage
   *value = ((rbuf[1] & 0x0F) * 256 + rbuf[0] ) * 1.25;
   *value /= 1000;
 
-error_exit:
-  if (fd > 0) {
-    close(fd);
-  }
-
   return ret;
 }
 
 int
 vr_read_curr(uint8_t vr, uint8_t loop, float *value) {
-  int fd;
-  char fn[32];
   static int count = 0;
   int ret = -1;
-  unsigned int retry = MAX_READ_RETRY;
-  uint8_t tcount, rcount;
-  uint8_t tbuf[16] = {0};
   uint8_t rbuf[16] = {0};
 
   // The following block for detecting vr_update is in progress or not
@@ -260,67 +219,9 @@ vr_read_curr(uint8_t vr, uint8_t loop, float *value) {
 
   count = 0;
 
-  snprintf(fn, sizeof(fn), "/dev/i2c-%d", VR_BUS_ID);
-  while (retry) {
-    fd = open(fn, O_RDWR);
-    if (fd < 0) {
-      syslog(LOG_WARNING, "read_vr_curr: i2c_open failed for bus#%x\n", VR_BUS_ID);
-      retry--;
-      msleep(100);
-    } else {
-      break;
-    }
-
-    if(retry == 0)
-      goto error_exit;
-  }
-
-  // Set the page to read Voltage
-  tbuf[0] = 0x00;
-  tbuf[1] = loop;
-
-  tcount = 2;
-  rcount = 0;
-
-  retry = MAX_READ_RETRY;
-  while(retry) {
-    ret = i2c_rdwr_msg_transfer(fd, vr, tbuf, tcount, rbuf, rcount);
-    if (ret) {
-#ifdef DEBUG
-      syslog(LOG_WARNING, "read_vr_curr: i2c_io failed for bus#%x, dev#%x\n", VR_BUS_ID, vr);
-#endif
-      retry--;
-      msleep(100);
-    } else {
-      break;
-    }
-
-    if (retry == 0)
-      goto error_exit;
-  }
-
-  // Read 2 bytes from Voltage register
-  tbuf[0] = VR_TELEMETRY_CURR;
-
-  tcount = 1;
-  rcount = 2;
-
-  retry = MAX_READ_RETRY;
-  while(retry) {
-    ret = i2c_rdwr_msg_transfer(fd, vr, tbuf, tcount, rbuf, rcount);
-    if (ret) {
-#ifdef DEBUG
-      syslog(LOG_WARNING, "read_vr_curr: i2c_io failed for bus#%x, dev#%x\n", VR_BUS_ID, vr);
-#endif
-      retry--;
-      msleep(100);
-    } else {
-      break;
-    }
-
-    if (retry == 0)
-      goto error_exit;
-  }
+  ret = vr_read_telemetry(vr, loop, VR_TELEMETRY_CURR, rbuf);
+  if (ret)
+    return ret;
 
   // Calculate Current
   if (rbuf[1] < 0x40) {
@@ -341,23 +242,13 @@ vr_read_curr(uint8_t vr, uint8_t loop, float *value) {
     *value = 0;
   }
 
-error_exit:
-  if (fd > 0) {
-    close(fd);
-  }
-
   return ret;
 }
 
 int
 vr_read_power(uint8_t vr, uint8_t loop, float *value) {
-  int fd;
-  char fn[32];
   static int count = 0;
   int ret = -1;
-  unsigned int retry = MAX_READ_RETRY;
-  uint8_t tcount, rcount;
-  uint8_t tbuf[16] = {0};
   uint8_t rbuf[16] = {0};
 
   // The following block for detecting vr_update is in progress or not
@@ -377,88 +268,20 @@ vr_read_power(uint8_t vr, uint8_t loop, float *value) {
 
   count = 0;
 
-  snprintf(fn, sizeof(fn), "/dev/i2c-%d", VR_BUS_ID);
-  while (retry) {
-    fd = open(fn, O_RDWR);
-    if (fd < 0) {
-      syslog(LOG_WARNING, "read_vr_power: i2c_open failed for bus#%x\n", VR_BUS_ID);
-      retry--;
-      msleep(100);
-    } else {
-      break;
-    }
-
-    if(retry == 0)
-      goto error_exit;
-  }
-
-  // Set the page to read Power
-  tbuf[0] = 0x00;
-  tbuf[1] = loop;
-
-  tcount = 2;
-  rcount = 0;
-
-  retry = MAX_READ_RETRY;
-  while(retry) {
-    ret = i2c_rdwr_msg_transfer(fd, vr, tbuf, tcount, rbuf, rcount);
-    if (ret) {
-#ifdef DEBUG
-      syslog(LOG_WARNING, "read_vr_power: i2c_io failed for bus#%x, dev#%x\n", VR_BUS_ID, vr);
-#endif
-      retry--;
-      msleep(100);
-    } else {
-      break;
-    }
-
-    if (retry == 0)
-      goto error_exit;
-  }
-
-  // Read 2 bytes from Power register
-  tbuf[0] = VR_TELEMETRY_POWER;
-
-  tcount = 1;
-  rcount = 2;
-
-  retry = MAX_READ_RETRY;
-  while(retry) {
-    ret = i2c_rdwr_msg_transfer(fd, vr, tbuf, tcount, rbuf, rcount);
-    if (ret) {
-#ifdef DEBUG
-      syslog(LOG_WARNING, "read_vr_power: i2c_io failed for bus#%x, dev#%x\n", VR_BUS_ID, vr);
-#endif
-      retry--;
-      msleep(100);
-    } else {
-      break;
-    }
-
-    if (retry == 0)
-      goto error_exit;
-  }
+  ret = vr_read_telemetry(vr, loop, VR_TELEMETRY_POWER, rbuf);
+  if (ret)
+    return ret;
 
   // Calculate Power
   *value = ((rbuf[1] & 0x3F) * 256 + rbuf[0] ) * 0.04;
 
-error_exit:
-  if (fd > 0) {
-    close(fd);
-  }
-
   return ret;
 }
 
 int
 vr_read_temp(uint8_t vr, uint8_t loop, float *value) {
-  int fd;
-  char fn[32];
   static int count = 0;
   int ret = -1;
-  unsigned int retry = MAX_READ_RETRY;
-  uint8_t tcount, rcount;
-  uint8_t tbuf[16] = {0};
   uint8_t rbuf[16] = {0};
   int16_t temp;
 
@@ -479,67 +302,9 @@ vr_read_temp(uint8_t vr, uint8_t loop, float *value) {
 
   count = 0;
 
-  snprintf(fn, sizeof(fn), "/dev/i2c-%d", VR_BUS_ID);
-  while (retry) {
-    fd = open(fn, O_RDWR);
-    if (fd < 0) {
-      syslog(LOG_WARNING, "read_vr_temp: i2c_open failed for bus#%x\n", VR_BUS_ID);
-      retry--;
-      msleep(100);
-    } else {
-      break;
-    }
-
-    if(retry == 0)
-      goto error_exit;
-  }
-
-  // Set the page to read Temperature
-  tbuf[0] = 0x00;
-  tbuf[1] = loop;
-
-  tcount = 2;
-  rcount = 0;
-
-  retry = MAX_READ_RETRY;
-  while (retry) {
-  ret = i2c_rdwr_msg_transfer(fd, vr, tbuf, tcount, rbuf, rcount);
-  if (ret) {
-#ifdef DEBUG
-    syslog(LOG_WARNING, "read_vr_temp: i2c_io failed for bus#%x, dev#%x\n", VR_BUS_ID, vr);
-#endif
-      retry--;
-      msleep(100);
-    } else {
-      break;
-    }
-
-    if(retry == 0)
-      goto error_exit;
-  }
-
-  // Read 2 bytes from Power register
-  tbuf[0] = VR_TELEMETRY_TEMP;
-
-  tcount = 1;
-  rcount = 2;
-
-  retry = MAX_READ_RETRY;
-  while(retry) {
-    ret = i2c_rdwr_msg_transfer(fd, vr, tbuf, tcount, rbuf, rcount);
-    if (ret) {
-#ifdef DEBUG
-      syslog(LOG_WARNING, "read_vr_temp: i2c_io failed for bus#%x, dev#%x\n", VR_BUS_ID, vr);
-#endif
-      retry--;
-      msleep(100);
-    } else {
-      break;
-    }
-
-    if(retry == 0)
-      goto error_exit;
-  }
+  ret = vr_read_telemetry(vr, loop, VR_TELEMETRY_TEMP, rbuf);
+  if (ret)
+    return ret;
 
   // AN-E1610B-034B: temp[11:0]
   // Calculate Temp
@@ -547,11 +312,6 @@ vr_read_temp(uint8_t vr, uint8_t loop, float *value) {
   if ((rbuf[1] & 0x08))
     temp |= 0xF000; // If negative, sign extend temp.
   *value = (float)temp * 0.125;
-error_exit:
-  if (fd > 0) {
-    close(fd);
-  }
-
   return ret;
 }
 
@@ -566,6 +326,7 @@ fetch_vr_info(uint8_t vr, char *key, uint8_t page,
   uint8_t tbuf[16] = {0};
   uint8_t rbuf[16] = {0};
   char value[MAX_VALUE_LEN] = {0};
+  bool locked = false;
 
   snprintf(fn, sizeof(fn), "/dev/i2c-%d", VR_BUS_ID);
   while (retry) {
@@ -582,6 +343,9 @@ fetch_vr_info(uint8_t vr, char *key, uint8_t page,
       goto error_exit;
   }
 
+  // Keep the telemetry readers from switching the page meanwhile
+  locked = !i2c_pool_lock(VR_BUS_ID);
+
   retry_page = MAX_READ_RETRY;
   while(retry_page) {
     // Set the page to read FW Info
@@ -709,6 +473,9 @@ fetch_vr_info(uint8_t vr, char *key, uint8_t page,
   edb_cache_set(key, value);
 
 error_exit:
+  if (locked)
+    i2c_pool_unlock(VR_BUS_ID);
+
   if (fd > 0) {
     close(fd);
   }
@@ -1685,6 +1452,7 @@ static int vr_fw_update_binary(uint8_t *BinData, uint8_t BoardInfo)
   int CurrentProgress = 0;
   char BusName[64];
   uint8_t BOARD_SKU_ID0;
+  bool locked = false;
 
   //create a file to inform "vr_read function". do not send req to VR
   fd = open(VR_UPDATE_IN_PROGRESS, O_WRONLY | O_CREAT | O_TRUNC, 0700);
@@ -1700,6 +1468,15 @@ static int vr_fw_update_binary(uint8_t *BinData, uint8_t BoardInfo)
   //wait for the sensord monitor cycle end
   sleep(3);
 
+  // Hold the bus for the whole update, so that no telemetry read switches
+  // the page in the middle of a program sequence
+  if (i2c_pool_lock(VR_BUS_ID)) {
+    printf("[%s] bus#%x not available\n", __func__, VR_BUS_ID);
+    RetVal = -1;
+    goto error_exit;
+  }
+  locked = true;
+
   snprintf(BusName, sizeof(BusName), "/dev/i2c-%d", VR_BUS_ID);
 
   //init vr array
@@ -1859,6 +1636,9 @@ static int vr_fw_update_binary(uint8_t *BinData, uint8_t BoardInfo)
   printf("\nUpdate VR Success!\n");
 
 error_exit:
+  if (locked)
+    i2c_pool_unlock(VR_BUS_ID);
+
   if ( -1 == remove(VR_UPDATE_IN_PROGRESS) )
   {
     printf("[%s] Remove %s Error\n", __func__, VR_UPDATE_IN_PROGRESS);
@@ -54,6 +54,8 @@ print_usage_help(void) {
   printf("Usage: fw-util <all|mb|nic> <--version>\n");
   printf("       fw-util <mb|nic> <--update> <--cpld|--bios|--nic|--vr|--rom|");
   printf("--bmc|--usbdbgfw|--usbdbgbl> <path>\n");
+  printf("       fw-util <mb> <--verify> <--cpld> <path>\n");
+  printf("       fw-util <mb> <--update-file> <--bios> <flash-file> <path>\n");
   printf("       fw-util <mb> <--postcode>\n");
 }
 
@@ -384,6 +386,22 @@ err_exit:
   return ret;
 }
 
+// Compare the CPLD with a JED file, so an update can be skipped if it matches
+static int
+fw_verify_cpld(const char *path) {
+  int ret;
+
+  if (cpld_intf_open()) {
+    printf("Cannot open JTAG!\n");
+    return -1;
+  }
+
+  ret = cpld_verify((char *)path);
+  cpld_intf_close();
+
+  return ret;
+}
+
 static int
 print_postcodes(uint8_t fru_id) {
   int i, rc, len;
@@ -418,7 +436,7 @@ main(int argc, char **argv) {
   int ret = 0;
   char cmd[80];
   // Check for border conditions
-  if ((argc != 3) && (argc != 5)) {
+  if ((argc != 3) && (argc != 5) && (argc != 6)) {
     goto err_exit;
   }
 
@@ -458,6 +476,22 @@ main(int argc, char **argv) {
     return fw_update_fru(argv, fru_id);
   }
 
+  if (!strcmp(argv[2], "--verify")) {
+    if (argc != 5 || fru_id != 1 || strcmp(argv[3], "--cpld")) {
+      goto err_exit;
+    }
+    return fw_verify_cpld(argv[4]);
+  }
+
+  // Run the BIOS flash programming against a copy of the flash in a file,
+  // without touching the server's power or the SPI mux
+  if (!strcmp(argv[2], "--update-file")) {
+    if (argc != 6 || fru_id != 1 || strcmp(argv[3], "--bios")) {
+      goto err_exit;
+    }
+    return bios_mtd_program(argv[4], argv[5]);
+  }
+
   if (!strcmp(argv[2], "--postcode")) {
      return print_postcodes(fru_id);
   }
@@ -31,6 +31,7 @@ from node_server import get_node_server
 from node_fruid import get_node_fruid
 from node_sensors import get_node_sensors
 from node_logs import get_node_logs
+from node_events import get_node_events
 from node_config import get_node_config
 from tree import tree
 from pal import *
@@ -48,9 +49,11 @@ def populate_server_node(num):
 
     r_logs = tree("logs", data = get_node_logs("slot" + repr(num)))
 
+    r_events = tree("events", data = get_node_events(num))
+
     r_config = tree("config", data = get_node_config("slot" + repr(num)))
 
-    r_server.addChildren([r_fruid, r_sensors, r_logs, r_config])
+    r_server.addChildren([r_fruid, r_sensors, r_logs, r_events, r_config])
 
     return r_server
 
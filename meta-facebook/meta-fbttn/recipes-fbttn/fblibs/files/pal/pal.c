@@ -1062,6 +1062,35 @@ pal_set_hb_led(uint8_t status) {
   return 0;
 }
 
+// Return the GPIOs behind a front panel input, for front-paneld to wait on
+int
+pal_get_fp_gpios(uint8_t input, int *gpios, int *cnt) {
+  if (*cnt < 1) {
+    return -1;
+  }
+
+  switch (input) {
+    case FP_INPUT_DBG_CARD_PRSNT:
+      gpios[0] = GPIO_DBG_CARD_PRSNT;
+      break;
+    case FP_INPUT_PWR_BTN:
+      gpios[0] = GPIO_PWR_BTN;
+      break;
+    case FP_INPUT_RST_BTN:
+      gpios[0] = GPIO_RST_BTN;
+      break;
+    case FP_INPUT_HAND_SW:
+      // UART select button, pal_get_hand_sw() counts its pulses
+      gpios[0] = GPIO_DEBUG_HDR_UART_SEL;
+      break;
+    default:
+      return PAL_ENOTSUP;
+  }
+
+  *cnt = 1;
+  return 0;
+}
+
 // Update the Identification LED for the given slot with the status
 int
 pal_set_id_led(uint8_t slot, uint8_t status) {
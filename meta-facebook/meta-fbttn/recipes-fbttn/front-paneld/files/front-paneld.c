@@ -32,6 +32,8 @@
 #include <openbmc/ipmi.h>
 #include <openbmc/ipmb.h>
 #include <openbmc/pal.h>
+#include <openbmc/gpio.h>
+#include <openbmc/evloop.h>
 
 #define BTN_MAX_SAMPLES   200
 #define BTN_POWER_OFF     40
@@ -54,10 +56,26 @@
 #define LED_ON_TIME_BMC_SELECT 500
 #define LED_OFF_TIME_BMC_SELECT 500
 
+#define FP_DEBOUNCE_MS 20
+#define FP_POLL_MS 1000
+#define BTN_POLL_MS 100
+#define STATUS_POLL_MS 1000
+#define STATUS_SLACK_MS 200
+#define STATS_INTERVAL_MS (60 * 1000)
+#define STATS_FILE "/tmp/front-paneld.stats"
+
+enum {
+  BTN_IDLE = 0,
+  BTN_HELD,
+  BTN_WAIT_RELEASE,
+};
+
 #define PATH_HEARTBEAT_HEALTH "/tmp/heartbeat_health"
-#define BMC_RMT_HB_TIMEOUT_COUNT  1800
-#define SCC_LOC_HB_TIMEOUT_COUNT  1800
-#define SCC_RMT_HB_TIMEOUT_COUNT  1800
+#define HB_MON_INTERVAL_MS 1000
+#define HB_TIMEOUT_COUNT (3 * 60 * 1000 / HB_MON_INTERVAL_MS)
+#define BMC_RMT_HB_TIMEOUT_COUNT  HB_TIMEOUT_COUNT
+#define SCC_LOC_HB_TIMEOUT_COUNT  HB_TIMEOUT_COUNT
+#define SCC_RMT_HB_TIMEOUT_COUNT  HB_TIMEOUT_COUNT
 #define BMC_RMT_HB_RPM_LIMIT  0
 #define SCC_LOC_HB_RPM_LIMIT  0
 #define SCC_RMT_HB_RPM_LIMIT  0
@@ -65,6 +83,19 @@
 uint8_t g_sync_led[MAX_NUM_SLOTS+1] = {0x0};
 unsigned char g_err_code[ERROR_CODE_NUM];
 
+static evloop_t *g_loop;
+static ev_input_t g_dbg_card;
+static ev_input_t g_hand_sw;
+static ev_input_t g_rst_btn;
+static ev_input_t g_pwr_btn;
+static ev_timer_t g_dbg_timer;
+static ev_timer_t g_ts_timer;
+static ev_timer_t g_sync_timer;
+static ev_timer_t g_encl_timer;
+static ev_timer_t g_hb_timer;
+static ev_timer_t g_stats_timer;
+static uint32_t g_btn_presses;
+
 int
 write_cache(const char *device, uint8_t value) {
   FILE *fp;
@@ -109,291 +140,343 @@ void check_cache_post_code(){
       fclose(fp);
   }
 }
-// Thread for monitoring debug card hotswap
-static void *
-debug_card_handler() {
-  int curr = -1;
-  int prev = -1;
-  uint8_t prsnt;
-  uint8_t pos ;
-  uint8_t prev_pos = -1;
-  int index = 0, ret, timer = 0;
-  uint8_t UART_OUT = 1;
-  int CURT = 0;
+// Wait for edges on the GPIOs behind a front panel input, or sample it
+// every poll_ms if the platform or the pins cannot signal edges
+static int
+fp_input_start(ev_input_t *in, uint8_t input, uint32_t poll_ms, ev_input_cb cb) {
+  int gpios[FP_MAX_GPIOS], fds[FP_MAX_GPIOS];
+  int i, cnt = FP_MAX_GPIOS, nfds = 0;
+  gpio_st g;
+
+  if (pal_get_fp_gpios(input, gpios, &cnt) == 0) {
+    for (i = 0; i < cnt; i++) {
+      if (gpio_open_edge(&g, gpios[i], GPIO_EDGE_BOTH))
+        break;
+      fds[nfds++] = g.gs_fd;
+    }
+    // A pin without edges would leave the input stale, so sample instead
+    if (i < cnt) {
+      while (nfds > 0)
+        close(fds[--nfds]);
+      syslog(LOG_INFO, "front panel input %d: no edge support, polling", input);
+    }
+  }
+
+  return ev_input_start(g_loop, in, fds, nfds, FP_DEBOUNCE_MS, poll_ms, cb, NULL);
+}
+
+static void
+timer_restart(ev_timer_t *t, uint32_t delay_ms, uint32_t slack_ms) {
+  ev_timer_set_slack(t, slack_ms);
+  ev_timer_start(g_loop, t, delay_ms, 0);
+}
+
+// Debug card: POST code caching, UART select and the 7-segment display.
+// Runs every 500ms while the card is present, or right away on an input edge.
+static void
+debug_card_handler(evloop_t *loop, ev_timer_t *t, void *arg) {
+  static uint8_t prev_pos = -1;
+  static int index = 0, timer = 0;
+  static uint8_t UART_OUT = 1;
+  static int CURT = 0;
   static uint8_t error[255], count_ret = 0, count_cur = 0, num;
+  uint8_t prsnt;
+  uint8_t pos;
+  int ret;
   uint8_t buffer[MAX_IPMB_RES_LEN], buf_len;
   uint8_t status;
 
-  while (1) {
-
-	ret = pal_is_fru_prsnt(FRU_SLOT1, &prsnt);
-    if (!ret && prsnt == 1) {
-		ret = pal_get_server_power(FRU_SLOT1, &status);
-		if(!ret && (status == SERVER_POWER_ON) ) {
-          ret = pal_post_enable(FRU_SLOT1);
-          if (!ret) {
-            ret = pal_post_get_buffer(buffer, &buf_len);
-            if (!ret) {
-              cache_post_code(buffer,buf_len);
-            }
-          }
-	    }
-	    else
-	      check_cache_post_code();
-    }
-    // Check if debug card present or not
-    #if 1
-    ret = pal_is_debug_card_prsnt(&prsnt);
+  ret = pal_is_fru_prsnt(FRU_SLOT1, &prsnt);
+  if (!ret && prsnt == 1) {
+    ret = pal_get_server_power(FRU_SLOT1, &status);
+    if(!ret && (status == SERVER_POWER_ON) ) {
+      ret = pal_post_enable(FRU_SLOT1);
+      if (!ret) {
+        ret = pal_post_get_buffer(buffer, &buf_len);
+        if (!ret) {
+          cache_post_code(buffer,buf_len);
+        }
+      }
+    }
+    else
+      check_cache_post_code();
+  }
+
+  // Check if debug card present or not
+  ret = pal_is_debug_card_prsnt(&prsnt);
+  if (ret) {
+    prsnt = 0;
+    goto debug_card_out;
+  }
+
+  // If Debug Card is present
+  if (prsnt) {
+    ret = pal_get_hand_sw(&pos);
     if (ret) {
       goto debug_card_out;
     }
-    #endif
-    curr = 1;
-
-    // If Debug Card is present
-    if (prsnt) {
-      ret = pal_get_hand_sw(&pos);
-      if (ret) {
-        goto debug_card_out;
-      }
-      if(pos != prev_pos) {
-        CURT++;
-        prev_pos = pos;
-        if( (CURT%2) == 0) {
-          UART_OUT = !UART_OUT;
-          ret = pal_switch_uart_mux(UART_OUT);
-        }
+    if(pos != prev_pos) {
+      CURT++;
+      prev_pos = pos;
+      if( (CURT%2) == 0) {
+        UART_OUT = !UART_OUT;
+        ret = pal_switch_uart_mux(UART_OUT);
       }
+    }
 
-      //Debug Card 7-Segment LED Display
-      //BMC Error Code Polling
-      if (timer == 0) {
-        pal_get_error_code(error, &count_ret);
-      }
+    //Debug Card 7-Segment LED Display
+    //BMC Error Code Polling
+    if (timer == 0) {
+      pal_get_error_code(error, &count_ret);
+    }
 
-      //if Count is 0 means no error, shows 0
-      if(count_ret == 0) {
-        num = 0;
-      }
-      else {
-        if(count_ret < count_cur) {
-          index = 0;
-        }
-        count_cur = count_ret;
-        //Each number shows twice while loop is around 1 second
-        num = error[index/2];
-        //Expander error code shows in 0~99 decimal, bmc shows A0~FF hexadecimal
-        if(num < 100)
-          num = num/10*16+num%10;
-
-        index++;
-
-        //when count_cur reach count_cur*2, means all sensors have been shown, so set index=0 to get error code again
-        if(index >= count_cur*2)
-          index = 0;
+    //if Count is 0 means no error, shows 0
+    if(count_ret == 0) {
+      num = 0;
+    }
+    else {
+      if(count_ret < count_cur) {
+        index = 0;
+      }
+      count_cur = count_ret;
+      //Each number shows twice while loop is around 1 second
+      num = error[index/2];
+      //Expander error code shows in 0~99 decimal, bmc shows A0~FF hexadecimal
+      if(num < 100)
+        num = num/10*16+num%10;
+
+      index++;
+
+      //when count_cur reach count_cur*2, means all sensors have been shown, so set index=0 to get error code again
+      if(index >= count_cur*2)
+        index = 0;
+    }
+    timer++;
+    //while loop 6 times is around 3 seconds
+    if(timer == 7)
+      timer = 0;
+
+    //Determine what to display on Debug Card 7-Segment LED
+    //Only if UART Select is on Server, then get post code via bic and show it
+    if (UART_OUT == HAND_SW_SERVER1) {
+      // Make sure the server is present
+      ret = pal_is_fru_prsnt(FRU_SLOT1, &prsnt);
+      if (ret || !prsnt) {
+        goto debug_card_out;
       }
-      timer++;
-      //while loop 6 times is around 3 seconds
-      if(timer == 7)
-        timer = 0;
-
-      //Determine what to display on Debug Card 7-Segment LED
-      //Only if UART Select is on Server, then get post code via bic and show it
-      if (UART_OUT == HAND_SW_SERVER1) {
-        // Make sure the server is present
-        ret = pal_is_fru_prsnt(FRU_SLOT1, &prsnt);
-        if (ret || !prsnt) {
-          goto debug_card_done;
-        }
-        // Enable POST codes for slot1
-        ret = pal_post_enable(FRU_SLOT1);
-        if (ret) {
-          goto debug_card_out;
-        }
-
-        // Get last post code and display it
-        ret = pal_post_get_last(FRU_SLOT1, &num);
-        if (ret) {
-          goto debug_card_out;
-        }
+      // Enable POST codes for slot1
+      ret = pal_post_enable(FRU_SLOT1);
+      if (ret) {
+        goto debug_card_out;
       }
 
-      /*
-       * TODO: Change the first argument from FRU_SLOT1 to UART_OUT
-       * Handle whether it is server postcode or BMC error code in
-       * pal_post_handle() definition and display od USB debug card
-      */
-      ret = pal_post_handle(FRU_SLOT1, num);
+      // Get last post code and display it
+      ret = pal_post_get_last(FRU_SLOT1, &num);
       if (ret) {
         goto debug_card_out;
       }
-
-      goto debug_card_done;
     }
 
-debug_card_done:
-    prev = curr;
-    prev_pos = pos;
-debug_card_out:
-    if (prsnt)
-      msleep(500);
-    else
-      sleep(1);
+    /*
+     * TODO: Change the first argument from FRU_SLOT1 to UART_OUT
+     * Handle whether it is server postcode or BMC error code in
+     * pal_post_handle() definition and display od USB debug card
+    */
+    ret = pal_post_handle(FRU_SLOT1, num);
   }
-}
 
-// Thread to monitor the hand switch
-static void *
-usb_handler() {
-  int curr = -1;
-  int prev = -1;
-  int ret;
-  uint8_t pos;
-  uint8_t prsnt;
-  uint8_t lpc;
-
-  while (1) {
-    // Get the current hand switch position
-    ret = pal_get_hand_sw(&pos);
-    if (ret) {
-      goto hand_sw_out;
-    }
-    curr = pos;
-    if (curr == prev) {
-      // No state change, continue;
-      goto hand_sw_out;
-    }
-
-    // Switch USB Mux to selected server
-    ret = pal_switch_usb_mux(pos);
-    if (ret) {
-      goto hand_sw_out;
-    }
+debug_card_out:
+  if (prsnt)
+    timer_restart(t, 500, 0);
+  else
+    timer_restart(t, 1000, STATUS_SLACK_MS);
+}
 
-    prev = curr;
-hand_sw_out:
-    sleep(1);
-    continue;
-  }
+// Debug card hotswap and UART select button
+static void
+debug_card_input(evloop_t *loop, ev_input_t *in, void *arg) {
+  ev_timer_start(loop, &g_dbg_timer, 0, 0);
 }
 
-// Thread to monitor Reset Button and propagate to selected server
-static void *
-rst_btn_handler() {
-  int ret;
-  int i;
+// Propagate the Reset Button to the server
+static void
+rst_btn_handler(evloop_t *loop, ev_input_t *in, void *arg) {
+  static uint8_t state = BTN_IDLE;
+  static uint64_t pressed_at;
+  uint64_t held;
   uint8_t btn;
+  int ret;
+
+  ret = pal_get_rst_btn(&btn);
+  if (ret) {
+    btn = 0;
+  }
 
-  while (1) {
-    // Check if reset button is pressed
-    ret = pal_get_rst_btn(&btn);
-    if (ret || !btn) {
-      goto rst_btn_out;
+  if (state == BTN_IDLE) {
+    if (!btn) {
+      return;
     }
 
     // Pass the reset button to the selected slot
     syslog(LOG_WARNING, "Reset button pressed\n");
+    g_btn_presses++;
     ret = pal_set_rst_btn(FRU_SLOT1, 0);
     if (ret) {
-      goto rst_btn_out;
-    }
-
-    // Wait for the button to be released
-    for (i = 0; i < BTN_MAX_SAMPLES; i++) {
-      ret = pal_get_rst_btn(&btn);
-      if (ret || btn) {
-        msleep(100);
-        continue;
-      }
-      pal_update_ts_sled();
-      syslog(LOG_WARNING, "Reset button released\n");
-      syslog(LOG_CRIT, "Reset Button pressed for FRU: %d\n", FRU_SLOT1);
-      ret = pal_set_rst_btn(FRU_SLOT1, 1);
-      goto rst_btn_out;
+      return;
     }
+    state = BTN_HELD;
+    pressed_at = evloop_now_ms(loop);
+    ev_input_recheck(loop, in, BTN_MAX_SAMPLES * BTN_POLL_MS);
+    return;
+  }
 
+  held = evloop_now_ms(loop) - pressed_at;
+  if (btn) {
     // handle error case
-    if (i == BTN_MAX_SAMPLES) {
+    if (held >= BTN_MAX_SAMPLES * BTN_POLL_MS) {
       pal_update_ts_sled();
       syslog(LOG_WARNING, "Reset button seems to stuck for long time\n");
-      goto rst_btn_out;
+      state = BTN_IDLE;
+      ev_input_recheck(loop, in, BTN_POLL_MS);
+    } else {
+      ev_input_recheck(loop, in, BTN_MAX_SAMPLES * BTN_POLL_MS - held);
     }
-rst_btn_out:
-    msleep(100);
+    return;
   }
+
+  pal_update_ts_sled();
+  syslog(LOG_WARNING, "Reset button released\n");
+  syslog(LOG_CRIT, "Reset Button pressed for FRU: %d\n", FRU_SLOT1);
+  pal_set_rst_btn(FRU_SLOT1, 1);
+  state = BTN_IDLE;
 }
 
-// Thread to handle Power Button and power on/off the selected server
-static void *
-pwr_btn_handler() {
-  int ret;
+// Handle Power Button and power on/off the server
+static void
+pwr_btn_handler(evloop_t *loop, ev_input_t *in, void *arg) {
+  static uint8_t state = BTN_IDLE;
+  static uint64_t pressed_at;
   uint8_t btn, cmd;
-  int i;
   uint8_t power;
+  uint64_t held;
+  int long_press;
+  int ret;
 
-  while (1) {
-    // Check if power button is pressed
-    ret = pal_get_pwr_btn(&btn);
-    if (ret || !btn) {
-      goto pwr_btn_out;
-    }
+  ret = pal_get_pwr_btn(&btn);
+  if (ret) {
+    btn = 0;
+  }
 
-    syslog(LOG_WARNING, "power button pressed\n");
-    // Wait for the button to be released
-    for (i = 0; i < BTN_POWER_OFF; i++) {
-      ret = pal_get_pwr_btn(&btn);
-      if (ret || btn ) {
-        msleep(100);
-        continue;
+  switch (state) {
+    case BTN_IDLE:
+      if (!btn) {
+        return;
       }
-      syslog(LOG_WARNING, "power button released\n");
-      break;
-    }
+      syslog(LOG_WARNING, "power button pressed\n");
+      g_btn_presses++;
+      state = BTN_HELD;
+      pressed_at = evloop_now_ms(loop);
+      ev_input_recheck(loop, in, BTN_POWER_OFF * BTN_POLL_MS);
+      return;
+
+    case BTN_WAIT_RELEASE:
+      if (!btn) {
+        state = BTN_IDLE;
+      }
+      return;
+  }
 
+  held = evloop_now_ms(loop) - pressed_at;
+  long_press = (held >= BTN_POWER_OFF * BTN_POLL_MS);
+  if (btn && !long_press) {
+    ev_input_recheck(loop, in, BTN_POWER_OFF * BTN_POLL_MS - held);
+    return;
+  }
 
-    // Get the current power state (power on vs. power off)
-    ret = pal_get_server_power(FRU_SLOT1, &power);
-    if (ret) {
-      goto pwr_btn_out;
-    }
+  if (btn) {
+    // Long press acts once, while the button is still held
+    state = BTN_WAIT_RELEASE;
+  } else {
+    syslog(LOG_WARNING, "power button released\n");
+    state = BTN_IDLE;
+  }
 
-    // Set power command should reverse of current power state
-    cmd = !power;
+  // Get the current power state (power on vs. power off)
+  ret = pal_get_server_power(FRU_SLOT1, &power);
+  if (ret) {
+    return;
+  }
 
-    // To determine long button press
-    if (i >= BTN_POWER_OFF) {
-      pal_update_ts_sled();
-      syslog(LOG_CRIT, "Power Button long pressed for FRU: %d\n", FRU_SLOT1);
-    } else {
+  // Set power command should reverse of current power state
+  cmd = !power;
 
-      // If current power state is ON and it is not a long press,
-      // the power off should be Graceful Shutdown
-      if (power == SERVER_POWER_ON)
-        cmd = SERVER_GRACEFUL_SHUTDOWN;
+  // To determine long button press
+  if (long_press) {
+    pal_update_ts_sled();
+    syslog(LOG_CRIT, "Power Button long pressed for FRU: %d\n", FRU_SLOT1);
+  } else {
 
-      pal_update_ts_sled();
-      syslog(LOG_CRIT, "Power Button pressed for FRU: %d\n", FRU_SLOT1);
-    }
+    // If current power state is ON and it is not a long press,
+    // the power off should be Graceful Shutdown
+    if (power == SERVER_POWER_ON)
+      cmd = SERVER_GRACEFUL_SHUTDOWN;
 
-    // Reverse the power state of the given server
-    ret = pal_set_server_power(FRU_SLOT1, cmd);
-pwr_btn_out:
-    msleep(100);
+    pal_update_ts_sled();
+    syslog(LOG_CRIT, "Power Button pressed for FRU: %d\n", FRU_SLOT1);
   }
+
+  // Reverse the power state of the given server
+  ret = pal_set_server_power(FRU_SLOT1, cmd);
 }
 
-// Thread to monitor SLED Cycles by using time stamp
-static void *
-ts_handler() {
-  int count = 0;
+// Monitor SLED Cycles by using time stamp
+static long time_sled_off;
+
+static void
+ts_handler(evloop_t *loop, ev_timer_t *t, void *arg) {
+  static uint8_t time_init = 0;
   struct timespec ts;
   struct timespec mts;
-  char tstr[64] = {0};
   char buf[128] = {0};
-  uint8_t por = 0;
-  uint8_t time_init = 0;
   long time_sled_on;
-  long time_sled_off;
+
+  if (time_init) {
+    // Store timestamp every one hour to keep track of SLED power
+    pal_update_ts_sled();
+    return;
+  }
+
+  // Make sure the time is initialized properly
+  // Since there is no battery backup, the time could be reset to build time
+  clock_gettime(CLOCK_REALTIME, &ts);
+  if (ts.tv_sec < time_sled_off) {
+    ev_timer_start(loop, t, 1000, 0);
+    return;
+  }
+
+  // If current time is more than the stored time, the date is correct
+  time_init = 1;
+  // Need to log SLED ON event, if this is Power-On-Reset
+  if (pal_is_bmc_por()) {
+    // Get uptime
+    clock_gettime(CLOCK_MONOTONIC, &mts);
+    // To find out when SLED was on, subtract the uptime from current time
+    time_sled_on = ts.tv_sec - mts.tv_sec;
+
+    ctime_r(&time_sled_on, buf);
+    // Log an event if this is Power-On-Reset
+    syslog(LOG_CRIT, "SLED Powered ON at %s", buf);
+  }
+
+  ev_timer_set_slack(t, HB_SLEEP_TIME * 1000);
+  ev_timer_start(loop, t, HB_TIMESTAMP_COUNT * HB_SLEEP_TIME * 1000,
+                 HB_TIMESTAMP_COUNT * HB_SLEEP_TIME * 1000);
+}
+
+static void
+ts_init(void) {
+  char tstr[64] = {0};
+  char buf[128] = {0};
 
   // Read the last timestamp from KV storage
   pal_get_key_value("timestamp_sled", tstr);
@@ -405,319 +488,326 @@ ts_handler() {
     syslog(LOG_CRIT, "SLED Powered OFF at %s", buf);
   }
 
-  while (1) {
-
-    // Make sure the time is initialized properly
-    // Since there is no battery backup, the time could be reset to build time
-    if (time_init == 0) {
-      // Read current time
-      clock_gettime(CLOCK_REALTIME, &ts);
-
-      if (ts.tv_sec < time_sled_off) {
-        sleep(1);
-        continue;
-      }
-
-      // If current time is more than the stored time, the date is correct
-      time_init = 1;
-      // Need to log SLED ON event, if this is Power-On-Reset
-      if (pal_is_bmc_por()) {
-        // Get uptime
-        clock_gettime(CLOCK_MONOTONIC, &mts);
-        // To find out when SLED was on, subtract the uptime from current time
-        time_sled_on = ts.tv_sec - mts.tv_sec;
-
-        ctime_r(&time_sled_on, buf);
-        // Log an event if this is Power-On-Reset
-        syslog(LOG_CRIT, "SLED Powered ON at %s", buf);
-      }
-    }
-
-    // Store timestamp every one hour to keep track of SLED power
-    if (count++ == HB_TIMESTAMP_COUNT) {
-      pal_update_ts_sled();
-      count = 0;
-    }
-
-    sleep(HB_SLEEP_TIME);
-  }
+  ev_timer_start(g_loop, &g_ts_timer, 0, 0);
 }
 
-// Thread to handle LED state of the server at given slot
-static void *
-led_handler(void *num) {
+// Handle LED state of the server: solid on, or blinking while identified
+static void
+led_sync_handler(evloop_t *loop, ev_timer_t *t, void *arg) {
+  static uint8_t blink = 0;
   int ret;
-  uint8_t prsnt;
-  uint8_t power;
-  uint8_t pos;
-  uint8_t led_blink;
   uint8_t ident = 0;
-  int led_on_time, led_off_time;
   char identify[16] = {0};
   char tstr[64] = {0};
-  int power_led_on_time = 500;
-  int power_led_off_time = 500;
-  uint8_t hlth = 0;
-
-  uint8_t slot = (*(int*) num) + 1;
-
-#ifdef DEBUG
-  syslog(LOG_INFO, "led_handler for slot %d\n", slot);
-#endif
-
-  while (1) {
-    // Check if this LED is managed by sync_led thread
-    if (g_sync_led[slot]) {
-      sleep(1);
-      continue;
-    }
-
-    // Get power status for this slot
-    ret = pal_get_server_power(slot, &power);
-    if (ret) {
-      sleep(1);
-      continue;
-    }
-
-    // Get health status for this slot
-    ret = pal_get_fru_health(slot, &hlth);
-    if (ret) {
-      sleep(1);
-      continue;
-    }
-
-    led_blink = 0;  // solid on/off
+  uint8_t slot;
+  uint8_t power;
+  uint8_t hlth;
 
-    //If no identify: Set LEDs based on power and hlth status
-    if (!led_blink) {
-		pal_set_led(slot, LED_ON);
-      goto led_handler_out;
+  // Finish the blink cycle started on the previous call
+  if (blink) {
+    for (slot = 1; slot <= MAX_NUM_SLOTS; slot++) {
+      pal_set_led(slot, LED_OFF);
     }
+    blink = 0;
+    timer_restart(t, LED_OFF_TIME_BMC_SELECT, 0);
+    return;
+  }
 
-    // Set blink rate
-    if (power == SERVER_POWER_ON) {
-      led_on_time = 900;
-      led_off_time = 100;
-    } else {
-      led_on_time = 100;
-      led_off_time = 900;
+  // Check if slot needs to be identified
+  for (slot = 1; slot <= MAX_NUM_SLOTS; slot++)  {
+    sprintf(tstr, "identify_slot%d", slot);
+    memset(identify, 0x0, 16);
+    ret = pal_get_key_value(tstr, identify);
+    if (ret == 0 && !strcmp(identify, "on")) {
+      ident = 1;
     }
+  }
 
-    // Start blinking the LED
-    if (hlth == FRU_STATUS_GOOD) {
+  if (ident == 1) {
+    // Start blinking Blue LED
+    for (slot = 1; slot <= MAX_NUM_SLOTS; slot++) {
+      g_sync_led[slot] = 1;
       pal_set_led(slot, LED_ON);
     }
 
-    msleep(led_on_time);
-
-    if (hlth == FRU_STATUS_GOOD) {
-      pal_set_led(slot, LED_OFF);
-    }
-
-    msleep(led_off_time);
-led_handler_out:
-    msleep(100);
+    blink = 1;
+    timer_restart(t, LED_ON_TIME_BMC_SELECT, 0);
+    return;
   }
-}
 
-// Thread to handle LED state of the SLED
-static void *
-led_sync_handler() {
-  int ret;
-  uint8_t pos;
-  uint8_t ident = 0;
-  char identify[16] = {0};
-  char tstr[64] = {0};
-  char id_arr[5] = {0};
-  uint8_t slot;
+  for (slot = 1; slot <= MAX_NUM_SLOTS; slot++) {
+    g_sync_led[slot] = 0;
 
-#ifdef DEBUG
-  syslog(LOG_INFO, "led_handler for slot %d\n", slot);
-#endif
-  pal_set_led(slot, LED_ON);
-
-  while (1) {
-    // Check if slot needs to be identified
-    ident = 0;
-    for (slot = 1; slot <= MAX_NUM_SLOTS; slot++)  {
-      id_arr[slot] = 0x0;
-      sprintf(tstr, "identify_slot%d", slot);
-      memset(identify, 0x0, 16);
-      ret = pal_get_key_value(tstr, identify);
-      if (ret == 0 && !strcmp(identify, "on")) {
-        id_arr[slot] = 0x1;
-        ident = 1;
-      }
-    }
-
-    // Handle BMC select condition when no slot is being identified
-    if (ident == 1) {
-      // Start blinking Blue LED
-      for (slot = 1; slot <= MAX_NUM_SLOTS; slot++) {
-        g_sync_led[slot] = 1;
-        pal_set_led(slot, LED_ON);
-      }
-
-      msleep(LED_ON_TIME_BMC_SELECT);
-
-      for (slot = 1; slot <= MAX_NUM_SLOTS; slot++) {
-        pal_set_led(slot, LED_OFF);
-      }
-
-      msleep(LED_OFF_TIME_BMC_SELECT);
+    // Solid on once power and health can be read
+    if (pal_get_server_power(slot, &power) ||
+        pal_get_fru_health(slot, &hlth)) {
       continue;
     }
-    for (slot = 1; slot <= MAX_NUM_SLOTS; slot++) {
-      g_sync_led[slot] = 0;
-    }
-    msleep(200);
+    pal_set_led(slot, LED_ON);
   }
+  timer_restart(t, STATUS_POLL_MS, STATUS_SLACK_MS);
 }
 
-// Thread for handling the Enclosure LED
-static void *
-encl_led_handler() {
+// Handle the Enclosure LED
+static void
+encl_led_handler(evloop_t *loop, ev_timer_t *t, void *arg) {
   uint8_t slot1_hlth;
   uint8_t iom_hlth;
   uint8_t dpb_hlth;
   uint8_t scc_hlth;
   uint8_t nic_hlth;
   int ret;
-  int i;
   char key[MAX_KEY_LEN] = {0};
   char cvalue[MAX_VALUE_LEN] = {0};
   int run_mode;
   static int count = 0;
 
-  // Initial error code
-  memset(g_err_code, 0, sizeof(unsigned char) * ERROR_CODE_NUM);
-  pal_fault_led_mode(ID_LED_OFF, 0);
-
-  while (1) {
-    // Get health status for all the fru and then update the ENCL_LED status
-    ret = pal_get_fru_health(FRU_SLOT1, &slot1_hlth);
-    if (ret) {
+  // Get health status for all the fru and then update the ENCL_LED status
+  ret = pal_get_fru_health(FRU_SLOT1, &slot1_hlth);
+  if (ret) {
+    pal_err_code_enable(0xF7);
+  }
+  else {
+    if (!slot1_hlth) {
       pal_err_code_enable(0xF7);
     }
     else {
-      if (!slot1_hlth) {
-        pal_err_code_enable(0xF7);
-      }
-      else {
-        pal_err_code_disable(0xF7);
-      }
+      pal_err_code_disable(0xF7);
     }
+  }
 
-    ret = pal_get_fru_health(FRU_IOM, &iom_hlth);
-    if (ret) {
+  ret = pal_get_fru_health(FRU_IOM, &iom_hlth);
+  if (ret) {
+    pal_err_code_enable(0xF8);
+  }
+  else {
+    if (!iom_hlth) {
       pal_err_code_enable(0xF8);
     }
     else {
-      if (!iom_hlth) {
-        pal_err_code_enable(0xF8);
-      }
-      else {
-        pal_err_code_disable(0xF8);
-      }
+      pal_err_code_disable(0xF8);
     }
+  }
 
-    ret = pal_get_fru_health(FRU_DPB, &dpb_hlth);
-    if (ret) {
+  ret = pal_get_fru_health(FRU_DPB, &dpb_hlth);
+  if (ret) {
+    pal_err_code_enable(0xF9);
+  }
+  else {
+    if (!dpb_hlth) {
       pal_err_code_enable(0xF9);
     }
     else {
-      if (!dpb_hlth) {
-        pal_err_code_enable(0xF9);
-      }
-      else {
-        pal_err_code_disable(0xF9);
-      }
+      pal_err_code_disable(0xF9);
     }
+  }
 
-    ret = pal_get_fru_health(FRU_SCC, &scc_hlth);
-    if (ret) {
+  ret = pal_get_fru_health(FRU_SCC, &scc_hlth);
+  if (ret) {
+    pal_err_code_enable(0xFA);
+  }
+  else {
+    if (!scc_hlth) {
       pal_err_code_enable(0xFA);
     }
     else {
-      if (!scc_hlth) {
-        pal_err_code_enable(0xFA);
-      }
-      else {
-        pal_err_code_disable(0xFA);
-      }
+      pal_err_code_disable(0xFA);
     }
+  }
 
-    ret = pal_get_fru_health(FRU_NIC, &nic_hlth);
-    if (ret) {
+  ret = pal_get_fru_health(FRU_NIC, &nic_hlth);
+  if (ret) {
+    pal_err_code_enable(0xFB);
+  }
+  else {
+    if (!nic_hlth) {
       pal_err_code_enable(0xFB);
     }
     else {
-      if (!nic_hlth) {
-        pal_err_code_enable(0xFB);
-      }
-      else {
-        pal_err_code_disable(0xFB);
-      }
+      pal_err_code_disable(0xFB);
     }
+  }
 
-    if(pal_sum_error_code() == 1) {   // error occur
-      pal_fault_led_mode(ID_LED_ON, 0);
+  if(pal_sum_error_code() == 1) {   // error occur
+    pal_fault_led_mode(ID_LED_ON, 0);
+  }
+  else {
+    pal_fault_led_mode(ID_LED_OFF, 0);
+  }
+
+  sprintf(key, "fault_led_state");
+  memset(cvalue, 0, sizeof(char)*MAX_VALUE_LEN);
+  ret = pal_get_key_value(key, cvalue);
+  run_mode = atoi(cvalue);
+  if (!ret) {
+    if(run_mode >= 20) {
+      ret = pal_fault_led_behavior( (!(count%5)) );
+      if(ret)
+        syslog(LOG_WARNING, "encl_led_handler: pal_fault_led_behavior blinking fail");
+      count++;
+    }
+    else if (run_mode >= 10) {
+      ret = pal_fault_led_behavior(ID_LED_ON);
+      if(ret)
+       syslog(LOG_WARNING, "encl_led_handler: pal_fault_led_behavior on fail");
     }
     else {
-      pal_fault_led_mode(ID_LED_OFF, 0);
-    }
-
-    sprintf(key, "fault_led_state");
-    memset(cvalue, 0, sizeof(char)*MAX_VALUE_LEN);
-    ret = pal_get_key_value(key, cvalue);
-    run_mode = atoi(cvalue);
-    if (!ret) {
-      if(run_mode >= 20) {
-        ret = pal_fault_led_behavior( (!(count%5)) );
-        if(ret)
-          syslog(LOG_WARNING, "encl_led_handler: pal_fault_led_behavior blinking fail");
-        count++;
-      }
-      else if (run_mode >= 10) {
-        ret = pal_fault_led_behavior(ID_LED_ON);
-        if(ret)
-         syslog(LOG_WARNING, "encl_led_handler: pal_fault_led_behavior on fail");
-      }
-      else {
-        ret = pal_fault_led_behavior(ID_LED_OFF);
-        if(ret)
-          syslog(LOG_WARNING, "encl_led_handler: pal_fault_led_behavior off fail");
-      }
+      ret = pal_fault_led_behavior(ID_LED_OFF);
+      if(ret)
+        syslog(LOG_WARNING, "encl_led_handler: pal_fault_led_behavior off fail");
     }
-    else
-      syslog(LOG_WARNING, "encl_led_handler: pal_get_key_value fail");
-    sleep(1);
   }
+  else
+    syslog(LOG_WARNING, "encl_led_handler: pal_get_key_value fail");
 }
 
-// Thread for handling the BMC and SCC heartbeat stauts
-static void *
-hb_mon_handler() {
+// Handle the BMC and SCC heartbeat status, sampled every HB_MON_INTERVAL_MS
+static uint8_t iom_type = 0;
+static uint8_t hb_health = 0;
+
+static void
+hb_mon_handler(evloop_t *loop, ev_timer_t *t, void *arg) {
   int bmc_rmt_hb_value = -1;
   int scc_loc_hb_value = -1;
   int scc_rmt_hb_value = -1;
-  int count_bmc_rmt = 0;
-  int count_scc_loc = 0;
-  int count_scc_rmt = 0;
+  static int count_bmc_rmt = 0;
+  static int count_scc_loc = 0;
+  static int count_scc_rmt = 0;
   int curr_bmc_rmt_status = -1;
   int curr_scc_loc_status = -1;
   int curr_scc_rmt_status = -1;
-  int prev_bmc_rmt_status = -1;
-  int prev_scc_loc_status = -1;
-  int prev_scc_rmt_status = -1;
-  uint8_t iom_type = 0;
-  uint8_t scc_rmt_type = 0;
-  uint8_t hb_health = 0;
-  int fru_health_last_state = 1;
+  static int prev_bmc_rmt_status = -1;
+  static int prev_scc_loc_status = -1;
+  static int prev_scc_rmt_status = -1;
+  static int fru_health_last_state = 1;
   int fru_health_kv_state = 1;
   int ret = 0;
   char tmp_health[MAX_VALUE_LEN];
 
+  // get current health status from kv_store
+  memset(tmp_health, 0, MAX_VALUE_LEN);
+  ret = pal_get_key_value("heartbeat_health", tmp_health);
+  if (ret){
+    syslog(LOG_ERR, " %s - kv get heartbeat_health status failed", __func__);
+  }
+  fru_health_kv_state = atoi(tmp_health);
+
+  // Heartbeat health bits [2:0] = {BMC_RMT, SCC_LOC, SCC_RMT}
+  // Diagnosis flow:
+  //   1. Get heartbeat
+  //   2. Timeout detect: heartbeat has no response continuous 3 minutes, HB_TIMEOUT_COUNT samples
+  //   3. Cache heartbeat health in /tmp
+  //   4. Update heartbeat status
+
+  // BMC remote heartbeat
+  if (iom_type == IOM_M2) {
+    // Get heartbeat
+    bmc_rmt_hb_value = pal_get_bmc_rmt_hb();
+    if (bmc_rmt_hb_value <= BMC_RMT_HB_RPM_LIMIT) {
+      count_bmc_rmt++;
+    }
+    else {
+      count_bmc_rmt = 0;
+    }
+    // Timeout Detect
+    if (count_bmc_rmt > BMC_RMT_HB_TIMEOUT_COUNT) {
+      curr_bmc_rmt_status = 0;
+    }
+    else {
+      curr_bmc_rmt_status = 1;
+    }
+    // Cache heartbeat health in /tmp
+    if (curr_bmc_rmt_status == 0) {
+      hb_health = hb_health | (1 << 2);
+      if (curr_bmc_rmt_status != prev_bmc_rmt_status) {
+        syslog(LOG_CRIT, "BMC remote heartbeat is abnormal");
+      }
+      pal_err_code_enable(0xFC);
+      pal_set_key_value("heartbeat_health", "0");
+    }
+    else {
+      hb_health = hb_health & (~(1 << 2));
+      pal_err_code_disable(0xFC);
+    }
+    // Update heartbeat status
+    prev_bmc_rmt_status = curr_bmc_rmt_status;
+  }
+
+  // SCC local heartbeat
+  if ((iom_type == IOM_M2) || (iom_type == IOM_IOC)) {
+    scc_loc_hb_value = pal_get_scc_loc_hb();
+    if (scc_loc_hb_value <= SCC_LOC_HB_RPM_LIMIT) {
+      count_scc_loc++;
+    }
+    else {
+      count_scc_loc = 0;
+    }
+    if (count_scc_loc > SCC_LOC_HB_TIMEOUT_COUNT) {
+      curr_scc_loc_status = 0;
+    }
+    else {
+      curr_scc_loc_status = 1;
+    }
+    if (curr_scc_loc_status == 0) {
+      hb_health = hb_health | (1 << 1);
+      if (curr_scc_loc_status != prev_scc_loc_status) {
+        syslog(LOG_CRIT, "SCC local heartbeat is abnormal");
+      }
+      pal_err_code_enable(0xFD);
+      pal_set_key_value("heartbeat_health", "0");
+    }
+    else {
+      hb_health = hb_health & (~(1 << 1));
+      pal_err_code_disable(0xFD);
+    }
+    prev_scc_loc_status = curr_scc_loc_status;
+  }
+
+  // SCC remote heartbeat
+  if (iom_type == IOM_IOC) {
+    scc_rmt_hb_value = pal_get_scc_rmt_hb();
+    if (scc_rmt_hb_value <= SCC_RMT_HB_RPM_LIMIT) {
+      count_scc_rmt++;
+    }
+    else {
+      count_scc_rmt = 0;
+    }
+    if (count_scc_rmt > SCC_RMT_HB_TIMEOUT_COUNT) {
+      curr_scc_rmt_status = 0;
+    }
+    else {
+      curr_scc_rmt_status = 1;
+    }
+    if (curr_scc_rmt_status == 0) {
+      hb_health = hb_health | (1 << 0);
+      if (curr_scc_rmt_status != prev_scc_rmt_status) {
+        syslog(LOG_CRIT, "SCC remote heartbeat is abnormal");
+      }
+      pal_err_code_enable(0xFE);
+      pal_set_key_value("heartbeat_health", "0");
+    }
+    else {
+      hb_health = hb_health & (~(1 << 0));
+      pal_err_code_disable(0xFE);
+    }
+    prev_scc_rmt_status = curr_scc_rmt_status;
+  }
+  write_cache(PATH_HEARTBEAT_HEALTH, hb_health);
+
+  // If log-util clear all fru, cleaning heartbeat detection count
+  // After doing it, front-paneld will regenerate assert
+  if ((fru_health_kv_state != fru_health_last_state) && (fru_health_kv_state == 1)) {
+    count_bmc_rmt = 0;
+    count_scc_loc = 0;
+    count_scc_rmt = 0;
+  }
+  fru_health_last_state = fru_health_kv_state;
+}
+
+static void
+hb_mon_init(void) {
+  uint8_t scc_rmt_type = 0;
+
   // Get remote SCC and IOM type to identify IOM is M.2 or IOC solution
   iom_type = pal_get_iom_type();
   scc_rmt_type = ((pal_get_sku() >> 6) & 0x1);
@@ -747,197 +837,82 @@ hb_mon_handler() {
   // Update heartbeat present bits [5:3] = {BMC_RMT, SCC_LOC, SCC_RMT}
   write_cache(PATH_HEARTBEAT_HEALTH, hb_health);
 
-  while(1) {
-    // get current health status from kv_store
-    memset(tmp_health, 0, MAX_VALUE_LEN);
-    ret = pal_get_key_value("heartbeat_health", tmp_health);
-    if (ret){
-      syslog(LOG_ERR, " %s - kv get heartbeat_health status failed", __func__);
-    }
-    fru_health_kv_state = atoi(tmp_health);
-
-    // Heartbeat health bits [2:0] = {BMC_RMT, SCC_LOC, SCC_RMT}
-    // Diagnosis flow:
-    //   1. Get heartbeat
-    //   2. Timeout detect: heartbeat has no response continuous 3 minutes. 1800 = 3 * 60 * 1000 / 100
-    //   3. Cache heartbeat health in /tmp
-    //   4. Update heartbeat status
-
-    // BMC remote heartbeat
-    if (iom_type == IOM_M2) {
-      // Get heartbeat
-      bmc_rmt_hb_value = pal_get_bmc_rmt_hb();
-      if (bmc_rmt_hb_value <= BMC_RMT_HB_RPM_LIMIT) {
-        count_bmc_rmt++;
-      }
-      else {
-        count_bmc_rmt = 0;
-      }
-      // Timeout Detect
-      if (count_bmc_rmt > BMC_RMT_HB_TIMEOUT_COUNT) {
-        curr_bmc_rmt_status = 0;
-      }
-      else {
-        curr_bmc_rmt_status = 1;
-      }
-      // Cache heartbeat health in /tmp
-      if (curr_bmc_rmt_status == 0) {
-        hb_health = hb_health | (1 << 2);
-        if (curr_bmc_rmt_status != prev_bmc_rmt_status) {
-          syslog(LOG_CRIT, "BMC remote heartbeat is abnormal");
-        }
-        pal_err_code_enable(0xFC);
-        pal_set_key_value("heartbeat_health", "0");
-      }
-      else {
-        hb_health = hb_health & (~(1 << 2));
-        pal_err_code_disable(0xFC);
-      }
-      // Update heartbeat status
-      prev_bmc_rmt_status = curr_bmc_rmt_status;
-    }
-
-    // SCC local heartbeat
-    if ((iom_type == IOM_M2) || (iom_type == IOM_IOC)) {
-      scc_loc_hb_value = pal_get_scc_loc_hb();
-      if (scc_loc_hb_value <= SCC_LOC_HB_RPM_LIMIT) {
-        count_scc_loc++;
-      }
-      else {
-        count_scc_loc = 0;
-      }
-      if (count_scc_loc > SCC_LOC_HB_TIMEOUT_COUNT) {
-        curr_scc_loc_status = 0;
-      }
-      else {
-        curr_scc_loc_status = 1;
-      }
-      if (curr_scc_loc_status == 0) {
-        hb_health = hb_health | (1 << 1);
-        if (curr_scc_loc_status != prev_scc_loc_status) {
-          syslog(LOG_CRIT, "SCC local heartbeat is abnormal");
-        }
-        pal_err_code_enable(0xFD);
-        pal_set_key_value("heartbeat_health", "0");
-      }
-      else {
-        hb_health = hb_health & (~(1 << 1));
-        pal_err_code_disable(0xFD);
-      }
-      prev_scc_loc_status = curr_scc_loc_status;
-    }
-
-    // SCC remote heartbeat
-    if (iom_type == IOM_IOC) {
-      scc_rmt_hb_value = pal_get_scc_rmt_hb();
-      if (scc_rmt_hb_value <= SCC_RMT_HB_RPM_LIMIT) {
-        count_scc_rmt++;
-      }
-      else {
-        count_scc_rmt = 0;
-      }
-      if (count_scc_rmt > SCC_RMT_HB_TIMEOUT_COUNT) {
-        curr_scc_rmt_status = 0;
-      }
-      else {
-        curr_scc_rmt_status = 1;
-      }
-      if (curr_scc_rmt_status == 0) {
-        hb_health = hb_health | (1 << 0);
-        if (curr_scc_rmt_status != prev_scc_rmt_status) {
-          syslog(LOG_CRIT, "SCC remote heartbeat is abnormal");
-        }
-        pal_err_code_enable(0xFE);
-        pal_set_key_value("heartbeat_health", "0");
-      }
-      else {
-        hb_health = hb_health & (~(1 << 0));
-        pal_err_code_disable(0xFE);
-      }
-      prev_scc_rmt_status = curr_scc_rmt_status;
-    }
-    write_cache(PATH_HEARTBEAT_HEALTH, hb_health);
+  ev_timer_set_slack(&g_hb_timer, STATUS_SLACK_MS);
+  ev_timer_start(g_loop, &g_hb_timer, HB_MON_INTERVAL_MS, HB_MON_INTERVAL_MS);
+}
 
-    msleep(100);
+static void
+stats_handler(evloop_t *loop, ev_timer_t *t, void *arg) {
+  FILE *fp;
 
-    // If log-util clear all fru, cleaning heartbeat detection count
-    // After doing it, front-paneld will regenerate assert
-    if ((fru_health_kv_state != fru_health_last_state) && (fru_health_kv_state == 1)) {
-      count_bmc_rmt = 0;
-      count_scc_loc = 0;
-      count_scc_rmt = 0;
-    }
-    fru_health_last_state = fru_health_kv_state;
+  fp = fopen(STATS_FILE ".tmp", "w");
+  if (!fp) {
+    return;
   }
+  evloop_dump_stats(loop, fp);
+  fprintf(fp, "dbg_card_edges: %llu\n", (unsigned long long)g_dbg_card.edges);
+  fprintf(fp, "uart_sel_edges: %llu\n", (unsigned long long)g_hand_sw.edges);
+  fprintf(fp, "rst_btn_edges: %llu\n", (unsigned long long)g_rst_btn.edges);
+  fprintf(fp, "pwr_btn_edges: %llu\n", (unsigned long long)g_pwr_btn.edges);
+  fprintf(fp, "btn_presses: %u\n", g_btn_presses);
+  fclose(fp);
+  rename(STATS_FILE ".tmp", STATS_FILE);
 }
 
 int
 main (int argc, char * const argv[]) {
-  pthread_t tid_debug_card;
-  pthread_t tid_rst_btn;
-  pthread_t tid_pwr_btn;
-  pthread_t tid_ts;
-  pthread_t tid_sync_led;
-  pthread_t tid_leds[MAX_NUM_SLOTS];
-  pthread_t tid_encl_led;
-  pthread_t tid_hb_mon;
-  int i;
-  int *ip;
-  
-  if (pthread_create(&tid_debug_card, NULL, debug_card_handler, NULL) < 0) {
-    syslog(LOG_WARNING, "pthread_create for debug card error\n");
-    exit(1);
-  }
+  int rc;
 
-  if (pthread_create(&tid_rst_btn, NULL, rst_btn_handler, NULL) < 0) {
-    syslog(LOG_WARNING, "pthread_create for reset button error\n");
+  // All front panel work shares one event loop: inputs are handled on GPIO
+  // edges and periodic work runs from coalesced timers
+  g_loop = evloop_create();
+  if (!g_loop) {
+    syslog(LOG_WARNING, "evloop_create failed\n");
     exit(1);
   }
 
-  if (pthread_create(&tid_pwr_btn, NULL, pwr_btn_handler, NULL) < 0) {
-    syslog(LOG_WARNING, "pthread_create for power button error\n");
+  ev_timer_init(&g_dbg_timer, debug_card_handler, NULL);
+  ev_timer_init(&g_ts_timer, ts_handler, NULL);
+  ev_timer_init(&g_sync_timer, led_sync_handler, NULL);
+  ev_timer_init(&g_encl_timer, encl_led_handler, NULL);
+  ev_timer_init(&g_hb_timer, hb_mon_handler, NULL);
+  ev_timer_init(&g_stats_timer, stats_handler, NULL);
+
+  if (fp_input_start(&g_dbg_card, FP_INPUT_DBG_CARD_PRSNT, FP_POLL_MS,
+                     debug_card_input) ||
+      fp_input_start(&g_hand_sw, FP_INPUT_HAND_SW, FP_POLL_MS,
+                     debug_card_input)) {
+    syslog(LOG_WARNING, "debug card monitor setup error\n");
     exit(1);
   }
 
-  if (pthread_create(&tid_ts, NULL, ts_handler, NULL) < 0) {
-    syslog(LOG_WARNING, "pthread_create for time stamp error\n");
+  if (fp_input_start(&g_rst_btn, FP_INPUT_RST_BTN, BTN_POLL_MS, rst_btn_handler)) {
+    syslog(LOG_WARNING, "reset button monitor setup error\n");
     exit(1);
   }
 
-  if (pthread_create(&tid_sync_led, NULL, led_sync_handler, NULL) < 0) {
-    syslog(LOG_WARNING, "pthread_create for led sync error\n");
+  if (fp_input_start(&g_pwr_btn, FP_INPUT_PWR_BTN, BTN_POLL_MS, pwr_btn_handler)) {
+    syslog(LOG_WARNING, "power button monitor setup error\n");
     exit(1);
   }
 
-  for (i = 0; i < MAX_NUM_SLOTS; i++) {
-    ip = malloc(sizeof(int));
-    *ip = i;
-    if (pthread_create(&tid_leds[i], NULL, led_handler, (void*)ip) < 0) {
-      syslog(LOG_WARNING, "pthread_create for led error\n");
-      exit(1);
-    }
-  }
+  ts_init();
 
-  if (pthread_create(&tid_encl_led, NULL, encl_led_handler, NULL) < 0) {
-    syslog(LOG_WARNING, "pthread_create for encl led error\n");
-    exit(1);
-  }
+  pal_set_led(1, LED_ON);
+  ev_timer_start(g_loop, &g_sync_timer, 0, 0);
 
-  if (pthread_create(&tid_hb_mon, NULL, hb_mon_handler, NULL) < 0) {
-    syslog(LOG_WARNING, "pthread_create for heartbeat error\n");
-    exit(1);
-  }
+  // Initial error code
+  memset(g_err_code, 0, sizeof(unsigned char) * ERROR_CODE_NUM);
+  pal_fault_led_mode(ID_LED_OFF, 0);
+  ev_timer_set_slack(&g_encl_timer, STATUS_SLACK_MS);
+  ev_timer_start(g_loop, &g_encl_timer, 0, STATUS_POLL_MS);
 
-  pthread_join(tid_debug_card, NULL);
-  pthread_join(tid_rst_btn, NULL);
-  pthread_join(tid_pwr_btn, NULL);
-  pthread_join(tid_ts, NULL);
-  pthread_join(tid_sync_led, NULL);
-  for (i = 0;  i < MAX_NUM_SLOTS; i++) {
-    pthread_join(tid_leds[i], NULL);
-  }
-  pthread_join(tid_encl_led, NULL);
-  pthread_join(tid_hb_mon, NULL);
+  hb_mon_init();
+
+  ev_timer_set_slack(&g_stats_timer, STATS_INTERVAL_MS / 10);
+  ev_timer_start(g_loop, &g_stats_timer, STATS_INTERVAL_MS, STATS_INTERVAL_MS);
 
-  return 0;
+  rc = evloop_run(g_loop);
+  evloop_destroy(g_loop);
+  return rc ? 1 : 0;
 }
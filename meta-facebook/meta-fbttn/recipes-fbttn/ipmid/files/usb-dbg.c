@@ -915,6 +915,7 @@ plat_udbg_get_info_page (uint8_t frame, uint8_t page, uint8_t *next, uint8_t *co
   char line_buff[256], *ptr;
   FILE *fp;
   fruid_info_t fruid;
+  fruid_compact_t fruid_rec;
   lan_config_t lan_config = { 0 };
   ipmb_req_t *req;
   ipmb_res_t *res;
@@ -925,7 +926,7 @@ plat_udbg_get_info_page (uint8_t frame, uint8_t page, uint8_t *next, uint8_t *co
   line_num = 0;
 
   // FRU
-  ret = fruid_parse("/tmp/fruid_mb.bin", &fruid);
+  ret = fruid_parse_cached("/tmp/fruid_mb.bin", &fruid_rec, &fruid);
   if (! ret) {
     line_num += plat_udbg_fill_frame(&frame_buff[line_num * LEN_PER_LINE], MAX_LINE-line_num,
       0, "SN:");
@@ -935,7 +936,6 @@ plat_udbg_get_info_page (uint8_t frame, uint8_t page, uint8_t *next, uint8_t *co
       0, "PN:");
     line_num += plat_udbg_fill_frame(&frame_buff[line_num * LEN_PER_LINE], MAX_LINE-line_num,
       1, fruid.board.part);
-    free_fruid_info(&fruid);
   }
 
   // LAN
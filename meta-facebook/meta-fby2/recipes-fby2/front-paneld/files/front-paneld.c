@@ -25,6 +25,7 @@
 #include <string.h>
 #include <pthread.h>
 #include <fcntl.h>
+#include <sys/file.h>
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <sys/un.h>
@@ -33,6 +34,8 @@
 #include <openbmc/ipmi.h>
 #include <openbmc/ipmb.h>
 #include <openbmc/pal.h>
+#include <openbmc/gpio.h>
+#include <openbmc/evloop.h>
 
 #define BTN_MAX_SAMPLES   200
 #define BTN_POWER_OFF     40
@@ -55,10 +58,42 @@
 #define LED_ON_TIME_BMC_SELECT 500
 #define LED_OFF_TIME_BMC_SELECT 500
 
+#define FP_DEBOUNCE_MS 20
+#define FP_POLL_MS 1000
+#define BTN_POLL_MS 100
+#define STATUS_POLL_MS 1000
+#define STATUS_SLACK_MS 200
+#define STATS_INTERVAL_MS (60 * 1000)
+#define STATS_FILE "/tmp/front-paneld.stats"
+
+enum {
+  BTN_IDLE = 0,
+  BTN_HELD,
+  BTN_WAIT_RELEASE,
+};
+
+enum {
+  SYNC_NONE = 0,
+  SYNC_IDENTIFY_SLED,
+  SYNC_HEALTH,
+  SYNC_BMC_SELECT,
+  SYNC_IDENTIFY_SLOT,
+};
 
 static uint8_t g_sync_led[MAX_NUM_SLOTS+1] = {0x0};
 static uint8_t m_pos = 0xff;
 
+static evloop_t *g_loop;
+static ev_input_t g_hand_sw;
+static ev_input_t g_dbg_card;
+static ev_input_t g_rst_btn;
+static ev_input_t g_pwr_btn;
+static ev_timer_t g_ts_timer;
+static ev_timer_t g_led_timer;
+static ev_timer_t g_sync_timer;
+static ev_timer_t g_stats_timer;
+static uint32_t g_btn_presses;
+
 static int
 get_handsw_pos(uint8_t *pos) {
   if ((m_pos > HAND_SW_BMC) || (m_pos < HAND_SW_SERVER1))
@@ -68,576 +103,653 @@ get_handsw_pos(uint8_t *pos) {
   return 0;
 }
 
-// Thread for monitoring debug card hotswap
-static void *
-debug_card_handler() {
-  int curr = -1;
-  int prev = -1;
+// Wait for edges on the GPIOs behind a front panel input, or sample it
+// every poll_ms if the platform or the pins cannot signal edges
+static int
+fp_input_start(ev_input_t *in, uint8_t input, uint32_t poll_ms, ev_input_cb cb) {
+  int gpios[FP_MAX_GPIOS], fds[FP_MAX_GPIOS];
+  int i, cnt = FP_MAX_GPIOS, nfds = 0;
+  gpio_st g;
+
+  if (pal_get_fp_gpios(input, gpios, &cnt) == 0) {
+    for (i = 0; i < cnt; i++) {
+      if (gpio_open_edge(&g, gpios[i], GPIO_EDGE_BOTH))
+        break;
+      fds[nfds++] = g.gs_fd;
+    }
+    // A pin without edges would leave the input stale, so sample instead
+    if (i < cnt) {
+      while (nfds > 0)
+        close(fds[--nfds]);
+      syslog(LOG_INFO, "front panel input %d: no edge support, polling", input);
+    }
+  }
+
+  return ev_input_start(g_loop, in, fds, nfds, FP_DEBOUNCE_MS, poll_ms, cb, NULL);
+}
+
+static void
+timer_restart(ev_timer_t *t, uint32_t delay_ms, uint32_t slack_ms) {
+  ev_timer_set_slack(t, slack_ms);
+  ev_timer_start(g_loop, t, delay_ms, 0);
+}
+
+// Follow debug card hotswap and the hand switch position
+static void
+debug_card_update(void) {
+  static int prev = -1;
+  static uint8_t prev_pos = 0xff;
+  int curr;
   uint8_t prsnt = 0;
   uint8_t pos;
-  uint8_t prev_pos = 0xff;
   uint8_t lpc;
   int ret;
 
-  while (1) {
-    ret = pal_get_hand_sw(&pos);
-    if (ret) {
-      goto debug_card_out;
+  ret = get_handsw_pos(&pos);
+  if (ret) {
+    goto debug_card_out;
+  }
+
+  // Check if debug card present or not
+  ret = pal_is_debug_card_prsnt(&prsnt);
+  if (ret) {
+    goto debug_card_out;
+  }
+  curr = prsnt;
+
+  // Check if Debug Card was either inserted or removed
+  if (curr != prev) {
+    if (!curr) {
+      // Debug Card was removed
+      syslog(LOG_WARNING, "Debug Card Extraction\n");
+      // Switch UART mux to BMC
+      ret = pal_switch_uart_mux(HAND_SW_BMC);
+      if (ret) {
+        goto debug_card_out;
+      }
+    } else {
+      // Debug Card was inserted
+      syslog(LOG_WARNING, "Debug Card Insertion\n");
     }
+  }
 
-    if (pos == prev_pos) {
-      goto debug_card_prs;
+  // If Debug Card is present
+  if (curr) {
+    if ((pos == prev_pos) && (curr == prev)) {
+      return;
     }
 
-    msleep(10);
-    ret = pal_get_hand_sw(&pos);
+    // Switch UART mux based on hand switch
+    ret = pal_switch_uart_mux(pos);
     if (ret) {
       goto debug_card_out;
     }
-    m_pos = pos;
 
-    ret = pal_switch_vga_mux(pos);
-    if (ret) {
-      goto debug_card_out;
+    // Enable POST code based on hand switch
+    if (pos == HAND_SW_BMC) {
+      // For BMC, there is no need to have POST specific code
+      goto debug_card_done;
+    }
+
+    // Make sure the server at selected position is ready
+    ret = pal_is_fru_ready(pos, &prsnt);
+    if (ret || !prsnt) {
+      goto debug_card_done;
     }
 
-    ret = pal_switch_usb_mux(pos);
+    // Enable POST codes for all slots
+    ret = pal_post_enable(pos);
     if (ret) {
-      goto debug_card_out;
+      goto debug_card_done;
     }
 
+    // Get last post code and display it
+    ret = pal_post_get_last(pos, &lpc);
+    if (ret) {
+      goto debug_card_done;
+    }
 
-debug_card_prs:
-    // Check if debug card present or not
-    ret = pal_is_debug_card_prsnt(&prsnt);
+    ret = pal_post_handle(pos, lpc);
     if (ret) {
       goto debug_card_out;
     }
-    curr = prsnt;
-
-    // Check if Debug Card was either inserted or removed
-    if (curr != prev) {
-      if (!curr) {
-        // Debug Card was removed
-        syslog(LOG_WARNING, "Debug Card Extraction\n");
-        // Switch UART mux to BMC
-        ret = pal_switch_uart_mux(HAND_SW_BMC);
-        if (ret) {
-          goto debug_card_out;
-        }
-      } else {
-        // Debug Card was inserted
-        syslog(LOG_WARNING, "Debug Card Insertion\n");
-      }
-    }
+  }
 
-    // If Debug Card is present
-    if (curr) {
-      if ((pos == prev_pos) && (curr == prev)) {
-        goto debug_card_out;
-      }
+debug_card_done:
+  prev = curr;
+  prev_pos = pos;
+  return;
 
-      // Switch UART mux based on hand switch
-      ret = pal_switch_uart_mux(pos);
-      if (ret) {
-        goto debug_card_out;
-      }
+debug_card_out:
+  // No edge may follow, so try again as the old poll loop would have
+  ev_input_recheck(g_loop, &g_dbg_card, FP_POLL_MS);
+}
 
-      // Enable POST code based on hand switch
-      if (pos == HAND_SW_BMC) {
-        // For BMC, there is no need to have POST specific code
-        goto debug_card_done;
-      }
+static void
+debug_card_handler(evloop_t *loop, ev_input_t *in, void *arg) {
+  debug_card_update();
+}
 
+static void
+hand_sw_handler(evloop_t *loop, ev_input_t *in, void *arg) {
+  uint8_t pos;
+  int ret;
 
+  ret = pal_get_hand_sw(&pos);
+  if (ret) {
+    goto hand_sw_retry;
+  }
 
-      // Make sure the server at selected position is ready
-      ret = pal_is_fru_ready(pos, &prsnt);
-      if (ret || !prsnt) {
-        goto debug_card_done;
-      }
+  if (pos == m_pos) {
+    return;
+  }
 
-      // Enable POST codes for all slots
-      ret = pal_post_enable(pos);
-      if (ret) {
-        goto debug_card_done;
-      }
+  ret = pal_switch_vga_mux(pos);
+  if (ret) {
+    goto hand_sw_retry;
+  }
 
-      // Get last post code and display it
-      ret = pal_post_get_last(pos, &lpc);
-      if (ret) {
-        goto debug_card_done;
-      }
+  ret = pal_switch_usb_mux(pos);
+  if (ret) {
+    goto hand_sw_retry;
+  }
+  m_pos = pos;
 
-      ret = pal_post_handle(pos, lpc);
-      if (ret) {
-        goto debug_card_out;
-      }
-    }
+  // The debug card and LEDs follow the selected server
+  debug_card_update();
+  ev_timer_start(loop, &g_led_timer, 0, 0);
+  return;
 
-debug_card_done:
-    prev = curr;
-    prev_pos = pos;
-debug_card_out:
-    if (curr == 1)
-      msleep(500);
-    else
-      sleep(1);
-  }
+hand_sw_retry:
+  ev_input_recheck(loop, in, FP_POLL_MS);
 }
 
-// Thread to monitor Reset Button and propagate to selected server
-static void *
-rst_btn_handler() {
-  int ret;
-  uint8_t pos;
-  int i;
+// Propagate the Reset Button to the selected server
+static void
+rst_btn_handler(evloop_t *loop, ev_input_t *in, void *arg) {
+  static uint8_t state = BTN_IDLE;
+  static uint8_t pos;
+  static uint64_t pressed_at;
+  uint64_t held;
   uint8_t btn;
+  int ret;
+
+  ret = pal_get_rst_btn(&btn);
+  if (ret) {
+    btn = 0;
+  }
+
+  if (state == BTN_IDLE) {
+    if (!btn) {
+      return;
+    }
 
-  while (1) {
     // Check the position of hand switch
     ret = get_handsw_pos(&pos);
     if (ret || pos == HAND_SW_BMC) {
       // For BMC, no need to handle Reset Button
-      sleep(1);
-      continue;
-    }
-
-    // Check if reset button is pressed
-    ret = pal_get_rst_btn(&btn);
-    if (ret || !btn) {
-      goto rst_btn_out;
+      return;
     }
 
     // Pass the reset button to the selected slot
     syslog(LOG_WARNING, "Reset button pressed\n");
+    g_btn_presses++;
     ret = pal_set_rst_btn(pos, 0);
     if (ret) {
-      goto rst_btn_out;
-    }
-
-    // Wait for the button to be released
-    for (i = 0; i < BTN_MAX_SAMPLES; i++) {
-      ret = pal_get_rst_btn(&btn);
-      if (ret || btn) {
-        msleep(100);
-        continue;
-      }
-      pal_update_ts_sled();
-      syslog(LOG_WARNING, "Reset button released\n");
-      syslog(LOG_CRIT, "Reset Button pressed for FRU: %d\n", pos);
-      ret = pal_set_rst_btn(pos, 1);
-      goto rst_btn_out;
+      return;
     }
+    state = BTN_HELD;
+    pressed_at = evloop_now_ms(loop);
+    ev_input_recheck(loop, in, BTN_MAX_SAMPLES * BTN_POLL_MS);
+    return;
+  }
 
+  held = evloop_now_ms(loop) - pressed_at;
+  if (btn) {
     // handle error case
-    if (i == BTN_MAX_SAMPLES) {
+    if (held >= BTN_MAX_SAMPLES * BTN_POLL_MS) {
       pal_update_ts_sled();
       syslog(LOG_WARNING, "Reset button seems to stuck for long time\n");
-      goto rst_btn_out;
+      state = BTN_IDLE;
+      ev_input_recheck(loop, in, BTN_POLL_MS);
+    } else {
+      ev_input_recheck(loop, in, BTN_MAX_SAMPLES * BTN_POLL_MS - held);
     }
-rst_btn_out:
-    msleep(100);
+    return;
   }
+
+  pal_update_ts_sled();
+  syslog(LOG_WARNING, "Reset button released\n");
+  syslog(LOG_CRIT, "Reset Button pressed for FRU: %d\n", pos);
+  pal_set_rst_btn(pos, 1);
+  state = BTN_IDLE;
 }
 
-// Thread to handle Power Button and power on/off the selected server
-static void *
-pwr_btn_handler() {
+// Handle Power Button and power on/off the selected server
+static void
+pwr_btn_handler(evloop_t *loop, ev_input_t *in, void *arg) {
+  static uint8_t state = BTN_IDLE;
+  static uint8_t pos;
+  static uint64_t pressed_at;
+  uint8_t btn, cmd = 0;
+  uint8_t power = 0;
+  uint64_t held;
+  int long_press;
   int ret;
-  uint8_t pos, btn, cmd;
-  int i;
-  uint8_t power;
-
-  while (1) {
-    // Check the position of hand switch
-    ret = get_handsw_pos(&pos);
-    if (ret) {
-      sleep(1);
-      continue;
-    }
-
-    // Check if power button is pressed
-    ret = pal_get_pwr_btn(&btn);
-    if (ret || !btn) {
-      goto pwr_btn_out;
-    }
 
-    syslog(LOG_WARNING, "power button pressed\n");
+  ret = pal_get_pwr_btn(&btn);
+  if (ret) {
+    btn = 0;
+  }
 
-    // Wait for the button to be released
-    for (i = 0; i < BTN_POWER_OFF; i++) {
-      ret = pal_get_pwr_btn(&btn);
-      if (ret || btn ) {
-        msleep(100);
-        continue;
+  switch (state) {
+    case BTN_IDLE:
+      if (!btn) {
+        return;
       }
-      syslog(LOG_WARNING, "power button released\n");
-      break;
-    }
-
-
-    // Get the current power state (power on vs. power off)
-    if (pos != HAND_SW_BMC)
-    {
-      ret = pal_get_server_power(pos, &power);
+      // Check the position of hand switch
+      ret = get_handsw_pos(&pos);
       if (ret) {
-        goto pwr_btn_out;
+        return;
       }
-      // Set power command should reverse of current power state
-      cmd = !power;
-    }
-
-    // To determine long button press
-    if (i >= BTN_POWER_OFF) {
-      // if long press (>4s) and hand-switch position == bmc, then initiate
-      // sled-cycle
-      if (pos == HAND_SW_BMC)
-      {
-        syslog(LOG_CRIT, "SLED_CYCLE using power button successful");
-        sleep(1);
-        pal_sled_cycle();
-      } else {
-        pal_update_ts_sled();
-        syslog(LOG_CRIT, "Power Button Long Press for FRU: %d\n", pos);
+      syslog(LOG_WARNING, "power button pressed\n");
+      g_btn_presses++;
+      state = BTN_HELD;
+      pressed_at = evloop_now_ms(loop);
+      ev_input_recheck(loop, in, BTN_POWER_OFF * BTN_POLL_MS);
+      return;
+
+    case BTN_WAIT_RELEASE:
+      if (!btn) {
+        state = BTN_IDLE;
       }
-    } else {
+      return;
+  }
 
-      // If current power state is ON and it is not a long press,
-      // the power off should be Graceful Shutdown
-      if (power == SERVER_POWER_ON)
-        cmd = SERVER_GRACEFUL_SHUTDOWN;
+  held = evloop_now_ms(loop) - pressed_at;
+  long_press = (held >= BTN_POWER_OFF * BTN_POLL_MS);
+  if (btn && !long_press) {
+    ev_input_recheck(loop, in, BTN_POWER_OFF * BTN_POLL_MS - held);
+    return;
+  }
 
-      pal_update_ts_sled();
-      syslog(LOG_CRIT, "Power Button Press for FRU: %d\n", pos);
+  if (btn) {
+    // Long press acts once, while the button is still held
+    state = BTN_WAIT_RELEASE;
+  } else {
+    syslog(LOG_WARNING, "power button released\n");
+    state = BTN_IDLE;
+  }
+
+  // Get the current power state (power on vs. power off)
+  if (pos != HAND_SW_BMC)
+  {
+    ret = pal_get_server_power(pos, &power);
+    if (ret) {
+      return;
     }
+    // Set power command should reverse of current power state
+    cmd = !power;
+  }
 
-    if (pos != HAND_SW_BMC) {
-      // Reverse the power state of the given server
-      ret = pal_set_server_power(pos, cmd);
+  // To determine long button press
+  if (long_press) {
+    // if long press (>4s) and hand-switch position == bmc, then initiate
+    // sled-cycle
+    if (pos == HAND_SW_BMC)
+    {
+      syslog(LOG_CRIT, "SLED_CYCLE using power button successful");
+      sleep(1);
+      pal_sled_cycle();
+    } else {
+      pal_update_ts_sled();
+      syslog(LOG_CRIT, "Power Button Long Press for FRU: %d\n", pos);
     }
-pwr_btn_out:
-    msleep(100);
+  } else {
+
+    // If current power state is ON and it is not a long press,
+    // the power off should be Graceful Shutdown
+    if (power == SERVER_POWER_ON)
+      cmd = SERVER_GRACEFUL_SHUTDOWN;
+
+    pal_update_ts_sled();
+    syslog(LOG_CRIT, "Power Button Press for FRU: %d\n", pos);
+  }
+
+  if (pos != HAND_SW_BMC) {
+    // Reverse the power state of the given server
+    ret = pal_set_server_power(pos, cmd);
   }
 }
 
-// Thread to monitor SLED Cycles by using time stamp
-static void *
-ts_handler() {
-  int count = 0;
+// Monitor SLED Cycles by using time stamp
+static void
+ts_handler(evloop_t *loop, ev_timer_t *t, void *arg) {
+  static long time_sled_off = -1;
+  static uint8_t time_init = 0;
   struct timespec ts;
   struct timespec mts;
   char tstr[64] = {0};
   char buf[128] = {0};
-  uint8_t por = 0;
-  uint8_t time_init = 0;
   long time_sled_on;
-  long time_sled_off;
-
-  // Read the last timestamp from KV storage
-  pal_get_key_value("timestamp_sled", tstr);
-  time_sled_off = (long) strtoul(tstr, NULL, 10);
-
-  while (1) {
 
-    // Make sure the time is initialized properly
-    // Since there is no battery backup, the time could be reset to build time
-    if (time_init < 100) {  // wait 100s at most, to prevent infinite waiting
-      // Read current time
-      clock_gettime(CLOCK_REALTIME, &ts);
-
-      if ((ts.tv_sec < time_sled_off) && (++time_init < 100)) {
-        sleep(1);
-        continue;
-      }
+  if (time_init >= 100) {
+    // Store timestamp every one hour to keep track of SLED power
+    pal_update_ts_sled();
+    return;
+  }
 
-      // If current time is more than the stored time, the date is correct
-      time_init = 100;
-      // Need to log SLED ON event, if this is Power-On-Reset
-      if (pal_is_bmc_por()) {
-        ctime_r(&time_sled_off, buf);
-        syslog(LOG_CRIT, "SLED Powered OFF at %s", buf);
-
-        // Get uptime
-        clock_gettime(CLOCK_MONOTONIC, &mts);
-        // To find out when SLED was on, subtract the uptime from current time
-        time_sled_on = ts.tv_sec - mts.tv_sec;
-
-        ctime_r(&time_sled_on, buf);
-        // Log an event if this is Power-On-Reset
-        syslog(LOG_CRIT, "SLED Powered ON at %s", buf);
-      }
-    }
+  if (time_sled_off < 0) {
+    // Read the last timestamp from KV storage
+    pal_get_key_value("timestamp_sled", tstr);
+    time_sled_off = (long) strtoul(tstr, NULL, 10);
+  }
 
-    // Store timestamp every one hour to keep track of SLED power
-    if (count++ == HB_TIMESTAMP_COUNT) {
-      pal_update_ts_sled();
-      count = 0;
-    }
+  // Make sure the time is initialized properly
+  // Since there is no battery backup, the time could be reset to build time
+  // wait 100s at most, to prevent infinite waiting
+  clock_gettime(CLOCK_REALTIME, &ts);
+  if ((ts.tv_sec < time_sled_off) && (++time_init < 100)) {
+    ev_timer_start(loop, t, 1000, 0);
+    return;
+  }
 
-    sleep(HB_SLEEP_TIME);
+  // If current time is more than the stored time, the date is correct
+  time_init = 100;
+  // Need to log SLED ON event, if this is Power-On-Reset
+  if (pal_is_bmc_por()) {
+    ctime_r(&time_sled_off, buf);
+    syslog(LOG_CRIT, "SLED Powered OFF at %s", buf);
+
+    // Get uptime
+    clock_gettime(CLOCK_MONOTONIC, &mts);
+    // To find out when SLED was on, subtract the uptime from current time
+    time_sled_on = ts.tv_sec - mts.tv_sec;
+
+    ctime_r(&time_sled_on, buf);
+    // Log an event if this is Power-On-Reset
+    syslog(LOG_CRIT, "SLED Powered ON at %s", buf);
   }
+
+  ev_timer_set_slack(t, HB_SLEEP_TIME * 1000);
+  ev_timer_start(loop, t, HB_TIMESTAMP_COUNT * HB_SLEEP_TIME * 1000,
+                 HB_TIMESTAMP_COUNT * HB_SLEEP_TIME * 1000);
 }
 
-// Thread to handle LED state of the server at given slot
-static void *
-led_handler() {
-  int ret;
-  uint8_t pos;
+// Handle LED state of the server at each slot, blinking the selected one
+static void
+led_handler(evloop_t *loop, ev_timer_t *t, void *arg) {
+  static uint8_t phase = 0;
+  static uint8_t pos;
+  static uint8_t power[MAX_NUM_SLOTS+1] = {0};
+  static uint8_t hlth[MAX_NUM_SLOTS+1] = {0};
   uint8_t slot;
   uint8_t ready;
-  uint8_t power[MAX_NUM_SLOTS+1] = {0};
-  uint8_t hlth[MAX_NUM_SLOTS+1] = {0};
-  int led_on_time, led_off_time;
-
-  while (1) {
-    // Get hand switch position to see if this is selected server
-    ret = get_handsw_pos(&pos);
-    if (ret != 0) {
-      sleep(1);
-      continue;
-    }
-
-    for (slot = 1; slot <= MAX_NUM_SLOTS; slot++) {
-      // Check if this LED is managed by sync_led thread
-      if (g_sync_led[slot]) {
-        continue;
-      }
-
-      ret = pal_is_fru_ready(slot, &ready);
-      if (!ret && ready) {
-        // Get power status for this slot
-        ret = pal_get_server_power(slot, &power[slot]);
-        if (ret) {
-          continue;
-        }
+  int ret;
 
-        // Get health status for this slot
-        ret = pal_get_fru_health(slot, &hlth[slot]);
-        if (ret) {
-          continue;
-        }
+  switch (phase) {
+    case 1:
+      if (hlth[pos] == FRU_STATUS_GOOD) {
+        pal_set_led(pos, LED_OFF);
       } else {
-        power[slot] = SERVER_POWER_OFF;
-        hlth[slot] = FRU_STATUS_GOOD;
+        pal_set_id_led(pos, ID_LED_OFF);
       }
-
-      if ((pos == slot) || (power[slot] == SERVER_POWER_ON)) {
-        if (hlth[slot] == FRU_STATUS_GOOD) {
-          pal_set_led(slot, LED_ON);
-          pal_set_id_led(slot, ID_LED_OFF);
+      phase = 2;
+      timer_restart(t, (power[pos] == SERVER_POWER_ON) ? 100 : 900, 0);
+      return;
+
+    case 2:
+      if (power[pos] == SERVER_POWER_ON) {
+        if (hlth[pos] == FRU_STATUS_GOOD) {
+          pal_set_led(pos, LED_ON);
         } else {
-          pal_set_led(slot, LED_OFF);
-          pal_set_id_led(slot, ID_LED_ON);
+          pal_set_id_led(pos, ID_LED_ON);
         }
-      } else {
-        pal_set_led(slot, LED_OFF);
-        pal_set_id_led(slot, ID_LED_OFF);
       }
-    }
+      break;
+  }
+  phase = 0;
 
-    if (pos > MAX_NUM_SLOTS) {
-      sleep(1);
-      continue;
-    }
+  // Get hand switch position to see if this is selected server
+  ret = get_handsw_pos(&pos);
+  if (ret != 0) {
+    timer_restart(t, STATUS_POLL_MS, STATUS_SLACK_MS);
+    return;
+  }
 
-    if (g_sync_led[pos]) {
-      sleep(1);
+  for (slot = 1; slot <= MAX_NUM_SLOTS; slot++) {
+    // Check if this LED is managed by led_sync_handler
+    if (g_sync_led[slot]) {
       continue;
     }
 
-    // Set blink rate
-    if (power[pos] == SERVER_POWER_ON) {
-      led_on_time = 900;
-      led_off_time = 100;
-    } else {
-      led_on_time = 100;
-      led_off_time = 900;
-    }
-
-    msleep(led_on_time);
+    ret = pal_is_fru_ready(slot, &ready);
+    if (!ret && ready) {
+      // Get power status for this slot
+      ret = pal_get_server_power(slot, &power[slot]);
+      if (ret) {
+        continue;
+      }
 
-    if (hlth[pos] == FRU_STATUS_GOOD) {
-      pal_set_led(pos, LED_OFF);
+      // Get health status for this slot
+      ret = pal_get_fru_health(slot, &hlth[slot]);
+      if (ret) {
+        continue;
+      }
     } else {
-      pal_set_id_led(pos, ID_LED_OFF);
+      power[slot] = SERVER_POWER_OFF;
+      hlth[slot] = FRU_STATUS_GOOD;
     }
 
-    msleep(led_off_time);
-
-    if (power[pos] == SERVER_POWER_ON) {
-      if (hlth[pos] == FRU_STATUS_GOOD) {
-        pal_set_led(pos, LED_ON);
+    if ((pos == slot) || (power[slot] == SERVER_POWER_ON)) {
+      if (hlth[slot] == FRU_STATUS_GOOD) {
+        pal_set_led(slot, LED_ON);
+        pal_set_id_led(slot, ID_LED_OFF);
       } else {
-        pal_set_id_led(pos, ID_LED_ON);
+        pal_set_led(slot, LED_OFF);
+        pal_set_id_led(slot, ID_LED_ON);
       }
+    } else {
+      pal_set_led(slot, LED_OFF);
+      pal_set_id_led(slot, ID_LED_OFF);
     }
   }
+
+  if (pos > MAX_NUM_SLOTS || g_sync_led[pos]) {
+    timer_restart(t, STATUS_POLL_MS, STATUS_SLACK_MS);
+    return;
+  }
+
+  // Set blink rate
+  phase = 1;
+  timer_restart(t, (power[pos] == SERVER_POWER_ON) ? 900 : 100, 0);
 }
 
-// Thread to handle LED state of the SLED
-static void *
-led_sync_handler() {
+// Handle LED state of the SLED
+static void
+led_sync_handler(evloop_t *loop, ev_timer_t *t, void *arg) {
+  static uint8_t blink = SYNC_NONE;
+  static char id_arr[MAX_NUM_SLOTS+1] = {0};
   int ret;
   uint8_t pos;
   uint8_t ident = 0;
   char identify[16] = {0};
   char tstr[64] = {0};
-  char id_arr[5] = {0};
   uint8_t slot;
   uint8_t spb_hlth = 0;
   uint8_t nic_hlth = 0;
 
-#ifdef DEBUG
-  syslog(LOG_INFO, "led_handler for slot %d\n", slot);
-#endif
-
-  while (1) {
-    // Handle Slot IDENTIFY condition
-    memset(identify, 0x0, 16);
-    ret = pal_get_key_value("identify_sled", identify);
-    if (ret == 0 && !strcmp(identify, "on")) {
-      // Turn OFF Blue LED
+  // Finish the blink cycle started on the previous call
+  switch (blink) {
+    case SYNC_IDENTIFY_SLED:
       for (slot = 1; slot <= MAX_NUM_SLOTS; slot++) {
-        g_sync_led[slot] = 1;
-        pal_set_led(slot, LED_OFF);
+        pal_set_id_led(slot, ID_LED_OFF);
       }
+      blink = SYNC_NONE;
+      timer_restart(t, LED_OFF_TIME_IDENTIFY, 0);
+      return;
 
-      // Start blinking the ID LED
-      for (slot = 1; slot <= MAX_NUM_SLOTS; slot++) {
-        pal_set_id_led(slot, ID_LED_ON);
+    case SYNC_HEALTH:
+      ret = get_handsw_pos(&pos);
+      if ((ret) || (pos == HAND_SW_BMC)) {
+        for (slot = 1; slot <= MAX_NUM_SLOTS; slot++) {
+           pal_set_id_led(slot, ID_LED_OFF);
+        }
+      } else {
+           pal_set_id_led(pos, ID_LED_OFF);
       }
+      blink = SYNC_NONE;
+      timer_restart(t, LED_OFF_TIME_HEALTH, 0);
+      return;
 
-      msleep(LED_ON_TIME_IDENTIFY);
+    case SYNC_BMC_SELECT:
+      for (slot = 1; slot <= MAX_NUM_SLOTS; slot++) {
+        pal_set_led(slot, LED_OFF);
+      }
+      blink = SYNC_NONE;
+      timer_restart(t, LED_OFF_TIME_BMC_SELECT, 0);
+      return;
 
+    case SYNC_IDENTIFY_SLOT:
       for (slot = 1; slot <= MAX_NUM_SLOTS; slot++) {
-        pal_set_id_led(slot, ID_LED_OFF);
+        if (id_arr[slot]) {
+          pal_set_id_led(slot, ID_LED_OFF);
+        }
       }
-      msleep(LED_OFF_TIME_IDENTIFY);
-      continue;
-    }
+      blink = SYNC_NONE;
+      timer_restart(t, LED_OFF_TIME_IDENTIFY, 0);
+      return;
+  }
 
-    // Handle Sled level health condition
-    ret = pal_get_fru_health(FRU_SPB, &spb_hlth);
-    if (ret) {
-      sleep(1);
-      continue;
+  // Handle Slot IDENTIFY condition
+  ret = pal_get_key_value("identify_sled", identify);
+  if (ret == 0 && !strcmp(identify, "on")) {
+    // Turn OFF Blue LED
+    for (slot = 1; slot <= MAX_NUM_SLOTS; slot++) {
+      g_sync_led[slot] = 1;
+      pal_set_led(slot, LED_OFF);
     }
 
-    ret = pal_get_fru_health(FRU_NIC, &nic_hlth);
-    if (ret) {
-      sleep(1);
-      continue;
+    // Start blinking the ID LED
+    for (slot = 1; slot <= MAX_NUM_SLOTS; slot++) {
+      pal_set_id_led(slot, ID_LED_ON);
     }
 
-    if (spb_hlth == FRU_STATUS_BAD || nic_hlth == FRU_STATUS_BAD) {
-      // Turn OFF Blue LED
-      for (slot = 1; slot <= MAX_NUM_SLOTS; slot++) {
-        g_sync_led[slot] = 1;
-        pal_set_led(slot, LED_OFF);
-      }
+    blink = SYNC_IDENTIFY_SLED;
+    timer_restart(t, LED_ON_TIME_IDENTIFY, 0);
+    return;
+  }
 
-      // Start blinking the Yellow/ID LED
-      for (slot = 1; slot <= MAX_NUM_SLOTS; slot++) {
-        pal_set_id_led(slot, ID_LED_ON);
-      }
+  // Handle Sled level health condition
+  ret = pal_get_fru_health(FRU_SPB, &spb_hlth);
+  if (ret) {
+    timer_restart(t, STATUS_POLL_MS, STATUS_SLACK_MS);
+    return;
+  }
 
-      msleep(LED_ON_TIME_HEALTH);
+  ret = pal_get_fru_health(FRU_NIC, &nic_hlth);
+  if (ret) {
+    timer_restart(t, STATUS_POLL_MS, STATUS_SLACK_MS);
+    return;
+  }
 
-      ret = get_handsw_pos(&pos);
-      if ((ret) || (pos == HAND_SW_BMC)) {
-        for (slot = 1; slot <= MAX_NUM_SLOTS; slot++) {
-           pal_set_id_led(slot, ID_LED_OFF);
-        }
-      } else {
-           pal_set_id_led(pos, ID_LED_OFF);
-      }
-      msleep(LED_OFF_TIME_HEALTH);
-      continue;
+  if (spb_hlth == FRU_STATUS_BAD || nic_hlth == FRU_STATUS_BAD) {
+    // Turn OFF Blue LED
+    for (slot = 1; slot <= MAX_NUM_SLOTS; slot++) {
+      g_sync_led[slot] = 1;
+      pal_set_led(slot, LED_OFF);
     }
 
-    // Check if slot needs to be identified
-    ident = 0;
-    for (slot = 1; slot <= MAX_NUM_SLOTS; slot++)  {
-      id_arr[slot] = 0x0;
-      sprintf(tstr, "identify_slot%d", slot);
-      memset(identify, 0x0, 16);
-      ret = pal_get_key_value(tstr, identify);
-      if (ret == 0 && !strcmp(identify, "on")) {
-        id_arr[slot] = 0x1;
-        ident = 1;
-      }
+    // Start blinking the Yellow/ID LED
+    for (slot = 1; slot <= MAX_NUM_SLOTS; slot++) {
+      pal_set_id_led(slot, ID_LED_ON);
     }
 
-    // Get hand switch position to see if this is selected server
-    ret = get_handsw_pos(&pos);
-    if (ret) {
-      sleep(1);
-      continue;
+    blink = SYNC_HEALTH;
+    timer_restart(t, LED_ON_TIME_HEALTH, 0);
+    return;
+  }
+
+  // Check if slot needs to be identified
+  for (slot = 1; slot <= MAX_NUM_SLOTS; slot++)  {
+    id_arr[slot] = 0x0;
+    sprintf(tstr, "identify_slot%d", slot);
+    memset(identify, 0x0, 16);
+    ret = pal_get_key_value(tstr, identify);
+    if (ret == 0 && !strcmp(identify, "on")) {
+      id_arr[slot] = 0x1;
+      ident = 1;
     }
+  }
 
-    // Handle BMC select condition when no slot is being identified
-    if ((pos == HAND_SW_BMC) && (ident == 0)) {
-      // Turn OFF Yellow LED
-      for (slot = 1; slot <= MAX_NUM_SLOTS; slot++) {
-        g_sync_led[slot] = 1;
-        pal_set_id_led(slot, ID_LED_OFF);
-      }
+  // Get hand switch position to see if this is selected server
+  ret = get_handsw_pos(&pos);
+  if (ret) {
+    timer_restart(t, STATUS_POLL_MS, STATUS_SLACK_MS);
+    return;
+  }
 
-      // Start blinking Blue LED
-      for (slot = 1; slot <= 4; slot++) {
-        pal_set_led(slot, LED_ON);
-      }
+  // Handle BMC select condition when no slot is being identified
+  if ((pos == HAND_SW_BMC) && (ident == 0)) {
+    // Turn OFF Yellow LED
+    for (slot = 1; slot <= MAX_NUM_SLOTS; slot++) {
+      g_sync_led[slot] = 1;
+      pal_set_id_led(slot, ID_LED_OFF);
+    }
 
-      msleep(LED_ON_TIME_BMC_SELECT);
+    // Start blinking Blue LED
+    for (slot = 1; slot <= MAX_NUM_SLOTS; slot++) {
+      pal_set_led(slot, LED_ON);
+    }
+
+    blink = SYNC_BMC_SELECT;
+    timer_restart(t, LED_ON_TIME_BMC_SELECT, 0);
+    return;
+  }
 
-      for (slot = 1; slot <= 4; slot++) {
+  // Handle individual identify slot condition
+  if (ident) {
+    for (slot = 1; slot <= MAX_NUM_SLOTS; slot++) {
+      if (id_arr[slot]) {
+        g_sync_led[slot] = 1;
         pal_set_led(slot, LED_OFF);
+        pal_set_id_led(slot, ID_LED_ON);
+      } else {
+        g_sync_led[slot] = 0;
       }
-
-      msleep(LED_OFF_TIME_BMC_SELECT);
-      continue;
     }
 
-    // Handle individual identify slot condition
-    if (ident) {
-      for (slot = 1; slot <=4; slot++) {
-        if (id_arr[slot]) {
-          g_sync_led[slot] = 1;
-          pal_set_led(slot, LED_OFF);
-          pal_set_id_led(slot, ID_LED_ON);
-        } else {
-          g_sync_led[slot] = 0;
-        }
-      }
+    blink = SYNC_IDENTIFY_SLOT;
+    timer_restart(t, LED_ON_TIME_IDENTIFY, 0);
+    return;
+  }
 
-      msleep(LED_ON_TIME_IDENTIFY);
+  for (slot = 1; slot <= MAX_NUM_SLOTS; slot++) {
+    g_sync_led[slot] = 0;
+  }
+  timer_restart(t, 500, STATUS_SLACK_MS);
+}
 
-      for (slot = 1; slot <=4; slot++) {
-        if (id_arr[slot]) {
-          pal_set_id_led(slot, ID_LED_OFF);
-        }
-      }
+static void
+stats_handler(evloop_t *loop, ev_timer_t *t, void *arg) {
+  FILE *fp;
 
-      msleep(LED_OFF_TIME_IDENTIFY);
-      continue;
-    }
-
-    for (slot = 1; slot <= 4; slot++) {
-      g_sync_led[slot] = 0;
-    }
-    msleep(500);
+  fp = fopen(STATS_FILE ".tmp", "w");
+  if (!fp) {
+    return;
   }
+  evloop_dump_stats(loop, fp);
+  fprintf(fp, "hand_sw_edges: %llu\n", (unsigned long long)g_hand_sw.edges);
+  fprintf(fp, "dbg_card_edges: %llu\n", (unsigned long long)g_dbg_card.edges);
+  fprintf(fp, "rst_btn_edges: %llu\n", (unsigned long long)g_rst_btn.edges);
+  fprintf(fp, "pwr_btn_edges: %llu\n", (unsigned long long)g_pwr_btn.edges);
+  fprintf(fp, "btn_presses: %u\n", g_btn_presses);
+  fclose(fp);
+  rename(STATS_FILE ".tmp", STATS_FILE);
 }
 
 int
 main (int argc, char * const argv[]) {
-  pthread_t tid_debug_card;
-  pthread_t tid_rst_btn;
-  pthread_t tid_pwr_btn;
-  pthread_t tid_ts;
-  pthread_t tid_sync_led;
-  pthread_t tid_led;
   int rc;
   int pid_file;
 
@@ -653,43 +765,49 @@ main (int argc, char * const argv[]) {
    openlog("front-paneld", LOG_CONS, LOG_DAEMON);
   }
 
-
-  if (pthread_create(&tid_debug_card, NULL, debug_card_handler, NULL) < 0) {
-    syslog(LOG_WARNING, "pthread_create for debug card error\n");
+  // All front panel work shares one event loop: inputs are handled on GPIO
+  // edges and periodic work runs from coalesced timers
+  g_loop = evloop_create();
+  if (!g_loop) {
+    syslog(LOG_WARNING, "evloop_create failed\n");
     exit(1);
   }
 
-  if (pthread_create(&tid_rst_btn, NULL, rst_btn_handler, NULL) < 0) {
-    syslog(LOG_WARNING, "pthread_create for reset button error\n");
-    exit(1);
-  }
+  ev_timer_init(&g_ts_timer, ts_handler, NULL);
+  ev_timer_init(&g_led_timer, led_handler, NULL);
+  ev_timer_init(&g_sync_timer, led_sync_handler, NULL);
+  ev_timer_init(&g_stats_timer, stats_handler, NULL);
 
-  if (pthread_create(&tid_pwr_btn, NULL, pwr_btn_handler, NULL) < 0) {
-    syslog(LOG_WARNING, "pthread_create for power button error\n");
+  // Hand switch first, the other inputs act on its position
+  if (fp_input_start(&g_hand_sw, FP_INPUT_HAND_SW, FP_POLL_MS, hand_sw_handler)) {
+    syslog(LOG_WARNING, "hand switch monitor setup error\n");
     exit(1);
   }
 
-  if (pthread_create(&tid_ts, NULL, ts_handler, NULL) < 0) {
-    syslog(LOG_WARNING, "pthread_create for time stamp error\n");
+  if (fp_input_start(&g_dbg_card, FP_INPUT_DBG_CARD_PRSNT, FP_POLL_MS,
+                     debug_card_handler)) {
+    syslog(LOG_WARNING, "debug card monitor setup error\n");
     exit(1);
   }
 
-  if (pthread_create(&tid_sync_led, NULL, led_sync_handler, NULL) < 0) {
-    syslog(LOG_WARNING, "pthread_create for led sync error\n");
+  if (fp_input_start(&g_rst_btn, FP_INPUT_RST_BTN, BTN_POLL_MS, rst_btn_handler)) {
+    syslog(LOG_WARNING, "reset button monitor setup error\n");
     exit(1);
   }
 
-  if (pthread_create(&tid_led, NULL, led_handler, NULL) < 0) {
-    syslog(LOG_WARNING, "pthread_create for led error\n");
+  if (fp_input_start(&g_pwr_btn, FP_INPUT_PWR_BTN, BTN_POLL_MS, pwr_btn_handler)) {
+    syslog(LOG_WARNING, "power button monitor setup error\n");
     exit(1);
   }
 
-  pthread_join(tid_debug_card, NULL);
-  pthread_join(tid_rst_btn, NULL);
-  pthread_join(tid_pwr_btn, NULL);
-  pthread_join(tid_ts, NULL);
-  pthread_join(tid_sync_led, NULL);
-  pthread_join(tid_led, NULL);
+  ev_timer_start(g_loop, &g_ts_timer, 0, 0);
+  ev_timer_start(g_loop, &g_led_timer, 0, 0);
+  ev_timer_start(g_loop, &g_sync_timer, 0, 0);
 
-  return 0;
+  ev_timer_set_slack(&g_stats_timer, STATS_INTERVAL_MS / 10);
+  ev_timer_start(g_loop, &g_stats_timer, STATS_INTERVAL_MS, STATS_INTERVAL_MS);
+
+  rc = evloop_run(g_loop);
+  evloop_destroy(g_loop);
+  return rc ? 1 : 0;
 }
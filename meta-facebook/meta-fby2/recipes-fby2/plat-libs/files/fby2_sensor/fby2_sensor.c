@@ -29,6 +29,7 @@
 #include <errno.h>
 #include <syslog.h>
 #include <openbmc/obmc-i2c.h>
+#include <openbmc/i2c-pool.h>
 #include "fby2_sensor.h"
 
 #define LARGEST_DEVICE_NAME 120
@@ -65,8 +66,8 @@
 
 #define UNIT_DIV 1000
 
-#define I2C_DEV_DC_1 "/dev/i2c-1"
-#define I2C_DEV_DC_3 "/dev/i2c-5"
+#define I2C_BUS_DC_1 1
+#define I2C_BUS_DC_3 5
 #define I2C_DC_INA_ADDR 0x40
 
 #define I2C_DEV_NIC "/dev/i2c-11"
@@ -492,31 +493,17 @@ read_hsc_value(const char* attr, const char *device, int r_sense, float *value)
 }
 
 static int
-read_ina230_value(uint8_t reg, char *device, uint8_t addr, float *value) {
-  int dev;
-  int ret;
+read_ina230_value(uint8_t reg, uint8_t bus, uint8_t addr, float *value) {
+  union i2c_smbus_data data;
   int32_t res;
 
-  dev = open(device, O_RDWR);
-  if (dev < 0) {
-    syslog(LOG_ERR, "%s: open() failed", __func__);
-    return -1;
-  }
-
-  /* Assign the i2c device address */
-  ret = ioctl(dev, I2C_SLAVE, addr);
-  if (ret < 0) {
-    syslog(LOG_ERR, "%s: ioctl() assigning i2c addr failed", __func__);
-    close(dev);
-    return -1;
-  }
-
-  res = i2c_smbus_read_word_data(dev, reg);
-  if (res < 0) {
-    close(dev);
+  // The bus handle stays open in the pool between sensor sweeps
+  if (i2c_pool_smbus(bus, addr, I2C_SMBUS_READ, reg, I2C_SMBUS_WORD_DATA,
+                     &data, NULL)) {
     syslog(LOG_ERR, "%s: i2c_smbus_read_word_data failed", __func__);
     return -1;
   }
+  res = data.word;
 
   switch (reg) {
     case INA230_VOLT:
@@ -530,8 +517,6 @@ read_ina230_value(uint8_t reg, char *device, uint8_t addr, float *value) {
 
   }
 
-  close(dev);
-
   return 0;
 }
 
@@ -1165,7 +1150,6 @@ fby2_sensor_read(uint8_t fru, uint8_t sensor_num, void *value) {
   int ret;
   bool discrete;
   int i;
-  char path[LARGEST_DEVICE_NAME];
   uint8_t status;
 
   switch (fru) {
@@ -1224,17 +1208,13 @@ fby2_sensor_read(uint8_t fru, uint8_t sensor_num, void *value) {
               else
                 return read_temp(DC_SLOT3_INLET_TEMP_DEVICE, (float*) value);
             case DC_SENSOR_INA230_VOLT:
-              if (fru == FRU_SLOT1)
-                snprintf(path, LARGEST_DEVICE_NAME, "%s", I2C_DEV_DC_1);
-              else
-                snprintf(path, LARGEST_DEVICE_NAME, "%s", I2C_DEV_DC_3);
-              return read_ina230_value(INA230_VOLT, path, I2C_DC_INA_ADDR, (float*) value);
+              return read_ina230_value(INA230_VOLT,
+                (fru == FRU_SLOT1) ? I2C_BUS_DC_1 : I2C_BUS_DC_3,
+                I2C_DC_INA_ADDR, (float*) value);
             case DC_SENSOR_INA230_POWER:
-              if (fru == FRU_SLOT1)
-                snprintf(path, LARGEST_DEVICE_NAME, "%s", I2C_DEV_DC_1);
-              else
-                snprintf(path, LARGEST_DEVICE_NAME, "%s", I2C_DEV_DC_3);
-              return read_ina230_value(INA230_POWER, path, I2C_DC_INA_ADDR, (float*) value);
+              return read_ina230_value(INA230_POWER,
+                (fru == FRU_SLOT1) ? I2C_BUS_DC_1 : I2C_BUS_DC_3,
+                I2C_DC_INA_ADDR, (float*) value);
             case DC_SENSOR_NVMe1_CTEMP:
               return 0;
             case DC_SENSOR_NVMe2_CTEMP:
@@ -1675,6 +1675,46 @@ pal_set_hb_led(uint8_t status) {
   return 0;
 }
 
+// Return the GPIOs behind a front panel input, for front-paneld to wait on
+int
+pal_get_fp_gpios(uint8_t input, int *gpios, int *cnt) {
+  const int hand_sw[] = { GPIO_HAND_SW_ID1, GPIO_HAND_SW_ID2,
+                          GPIO_HAND_SW_ID4, GPIO_HAND_SW_ID8 };
+  int i;
+
+  switch (input) {
+    case FP_INPUT_DBG_CARD_PRSNT:
+      if (*cnt < 1)
+        return -1;
+      gpios[0] = GPIO_DBG_CARD_PRSNT;
+      *cnt = 1;
+      break;
+    case FP_INPUT_PWR_BTN:
+      if (*cnt < 1)
+        return -1;
+      gpios[0] = GPIO_PWR_BTN;
+      *cnt = 1;
+      break;
+    case FP_INPUT_RST_BTN:
+      if (*cnt < 1)
+        return -1;
+      gpios[0] = GPIO_RST_BTN;
+      *cnt = 1;
+      break;
+    case FP_INPUT_HAND_SW:
+      if (*cnt < 4)
+        return -1;
+      for (i = 0; i < 4; i++)
+        gpios[i] = hand_sw[i];
+      *cnt = 4;
+      break;
+    default:
+      return PAL_ENOTSUP;
+  }
+
+  return 0;
+}
+
 // Update the Identification LED for the given slot with the status
 int
 pal_set_id_led(uint8_t slot, uint8_t status) {
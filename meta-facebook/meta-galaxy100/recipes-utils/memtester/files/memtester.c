@@ -28,6 +28,7 @@
 #include "types.h"
 #include "sizes.h"
 #include "tests.h"
+#include "parallel.h"
 
 #define EXIT_FAIL_NONSTARTER    0x01
 #define EXIT_FAIL_ADDRESSLINES  0x02
@@ -94,6 +95,7 @@ int memtester_pagesize(void) {
 
 /* Function declarations */
 void usage(char *me);
+int run_parallel(ul testmask);
 
 /* Global vars - so tests have access to this information */
 int use_phys = 0;
@@ -102,11 +104,46 @@ off_t physaddrbase = 0;
 /* Function definitions */
 void usage(char *me) {
     fprintf(stderr, "\n"
-            "Usage: %s [-p physaddrbase [-d device]] <mem>[B|K|M|G] [loops]\n",
+            "Usage: %s [-p physaddrbase [-d device]] [-j threads] "
+            "<mem>[B|K|M|G] [loops]\n"
+            "  -j  split the tests between threads, one per CPU for 0\n",
             me);
     exit(EXIT_FAIL_NONSTARTER);
 }
 
+int run_parallel(ul testmask) {
+    int exit_code = 0;
+    double mbps;
+    ul i;
+
+    printf("  %-20s: ", "Stuck Address");
+    fflush(stdout);
+    if (!par_run(par_stuck_address, &mbps)) {
+        printf("ok  %9.1f MB/s\n", mbps);
+    } else {
+        printf("\n");
+        exit_code |= EXIT_FAIL_ADDRESSLINES;
+    }
+    for (i=0;;i++) {
+        if (!par_tests[i].name) break;
+        if (testmask && (!((1 << i) & testmask))) {
+            continue;
+        }
+        printf("  %-20s: ", par_tests[i].name);
+        fflush(stdout);
+        if (!par_tests[i].fp) {
+            printf("skipped\n");
+        } else if (!par_run(par_tests[i].fp, &mbps)) {
+            printf("ok  %9.1f MB/s\n", mbps);
+        } else {
+            printf("\n");
+            exit_code |= EXIT_FAIL_OTHERTEST;
+        }
+        fflush(stdout);
+    }
+    return exit_code;
+}
+
 int main(int argc, char **argv) {
     ul loops, loop, i;
     size_t pagesize, wantraw, wantmb, wantbytes, wantbytes_orig, bufsize,
@@ -126,6 +163,7 @@ int main(int argc, char **argv) {
     int device_specified = 0;
     char *env_testmask = 0;
     ul testmask = 0;
+    int nthreads = -1;
 
     printf("memtester version " __version__ " (%d-bit)\n", UL_LEN);
     printf("Copyright (C) 2001-2012 Charles Cazabon.\n");
@@ -150,7 +188,7 @@ int main(int argc, char **argv) {
         printf("using testmask 0x%lx\n", testmask);
     }
 
-    while ((opt = getopt(argc, argv, "p:d:")) != -1) {
+    while ((opt = getopt(argc, argv, "p:d:j:")) != -1) {
         switch (opt) {
             case 'p':
                 errno = 0;
@@ -193,6 +231,14 @@ int main(int argc, char **argv) {
                     }
                 }
                 break;              
+            case 'j':
+                errno = 0;
+                nthreads = (int) strtol(optarg, &addrsuffix, 0);
+                if (errno != 0 || *addrsuffix != '\0' || nthreads < 0) {
+                    fprintf(stderr, "failed to parse number of threads\n");
+                    usage(argv[0]); /* doesn't return */
+                }
+                break;
             default: /* '?' */
                 usage(argv[0]); /* doesn't return */
         }
@@ -364,12 +410,23 @@ int main(int argc, char **argv) {
     bufa = (ulv *) aligned;
     bufb = (ulv *) ((size_t) aligned + halflen);
 
+    if (nthreads >= 0 && par_start(aligned, bufsize, nthreads) < 0) {
+        fprintf(stderr, "Continuing with one thread.\n");
+        nthreads = -1;
+    }
+
     for(loop=1; ((!loops) || loop <= loops); loop++) {
         printf("Loop %lu", loop);
         if (loops) {
             printf("/%lu", loops);
         }
         printf(":\n");
+        if (nthreads >= 0) {
+            exit_code |= run_parallel(testmask);
+            printf("\n");
+            fflush(stdout);
+            continue;
+        }
         printf("  %-20s: ", "Stuck Address");
         fflush(stdout);
         if (!test_stuck_address(aligned, bufsize / sizeof(ul))) {
@@ -396,6 +453,7 @@ int main(int argc, char **argv) {
         printf("\n");
         fflush(stdout);
     }
+    if (nthreads >= 0) par_stop();
     if (do_mlock) munlock((void *) aligned, bufsize);
     printf("Done.\n");
     fflush(stdout);
@@ -0,0 +1,682 @@
+/*
+ * Parallel mode for memtester.
+ * Copyright 2017-present Facebook. All Rights Reserved.
+ * Licensed under the terms of the GNU General Public License version 2 (only).
+ * See the file COPYING for details.
+ *
+ * The tests of tests.c, with the two halves of the buffer split between
+ * worker threads, each pinned to a CPU and working on its own share of
+ * both halves. Fill and compare run as separate passes over the whole
+ * buffer, with every worker meeting at a barrier in between, so a write
+ * that lands in another worker's share is still caught.
+ *
+ * The word loops of tests.c go through volatile pointers. Here they run on
+ * wide words instead, GCC vectors that map to SIMD registers where the CPU
+ * has them and to unrolled pairs of words where it doesn't, and the passes
+ * are kept apart by non-inlined kernels and compiler barriers. A compare
+ * pass ORs the differences of a span together and only goes word by word
+ * through a span that shows one.
+ *
+ * Unlike compare_regions(), failures name the half they were found in and
+ * are checked against the expected pattern where there is one, with the
+ * offset of the word in that half.
+ *
+ */
+
+#define _GNU_SOURCE
+#include <sys/types.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+
+#include "types.h"
+#include "sizes.h"
+#include "memtester.h"
+#include "parallel.h"
+
+#define ONE 0x00000001L
+
+#if defined(__SSE2__) || defined(__ARM_NEON) || defined(__ARM_NEON__) || \
+    defined(__ALTIVEC__)
+#define PAR_VEC_BYTES 16
+#else
+/* No SIMD: two words at a time, which GCC lowers to plain word moves. */
+#define PAR_VEC_BYTES (2 * sizeof(ul))
+#endif
+
+typedef ul vul __attribute__((vector_size(PAR_VEC_BYTES), may_alias));
+#define VW (PAR_VEC_BYTES / sizeof(ul))
+
+/* Vectors ORed together before looking at the result. */
+#define PAR_SPAN 64
+/* Failures reported word by word per worker and test; the rest are counted. */
+#define PAR_MAX_REPORTS 16
+
+#define barrier() __asm__ __volatile__("" ::: "memory")
+
+struct par_worker {
+    int id;
+    int cpu;
+    pthread_t thread;
+    ul *half[2];        /* this worker's share of bufa and bufb */
+    size_t count;       /* words in each */
+    size_t first;       /* index of half[0][0] in bufa */
+    ul seed;
+    ull bytes;          /* moved by the current test */
+    ul errors[2];       /* per half, in the current test */
+    ul reports;
+    int ret;
+};
+
+static struct par_worker workers[PAR_MAX_THREADS];
+static int nworkers;
+static pthread_barrier_t start_barrier, done_barrier, sync_barrier;
+static int (*cur_fn)(struct par_worker *w);
+static volatile int failed;
+static ul cur_q;
+static char *base_addr;
+static ul *bufa;
+static size_t half_count;
+
+static const char *half_name[2] = { "A", "B" };
+
+/* Helpers */
+
+static vul vsplat(ul q0, ul q1) {
+    vul v;
+    unsigned int k;
+
+    for (k = 0; k < VW; k++) {
+        v[k] = (k % 2) == 0 ? q0 : q1;
+    }
+    return v;
+}
+
+static int vzero(vul v) {
+    ul acc = 0;
+    unsigned int k;
+
+    for (k = 0; k < VW; k++) {
+        acc |= v[k];
+    }
+    return acc == 0;
+}
+
+static void report(struct par_worker *w, int h, ul *p, ul got, ul expect,
+                   const char *what) {
+    size_t off = (char *) p - base_addr;
+
+    if (h == 1) {
+        off -= half_count * sizeof(ul);
+    }
+    w->errors[h]++;
+    if (w->reports++ >= PAR_MAX_REPORTS) {
+        return;
+    }
+    if (use_phys) {
+        fprintf(stderr,
+                "FAILURE: %s0x%08lx != 0x%08lx in half %s at physical "
+                "address 0x%08lx.\n",
+                what, got, expect, half_name[h],
+                (ul) (physaddrbase + ((char *) p - base_addr)));
+    } else {
+        fprintf(stderr,
+                "FAILURE: %s0x%08lx != 0x%08lx in half %s at offset "
+                "0x%08lx.\n",
+                what, got, expect, half_name[h], (ul) off);
+    }
+}
+
+/* Meet the other workers between the fill and the compare of a pass. */
+static void par_sync(void) {
+    pthread_barrier_wait(&sync_barrier);
+}
+
+/*
+ * Meet them at the end of a pass; true if any of them found a failure.
+ * failed is only set before this barrier and only read after it, so no
+ * worker can see a failure of the next pass here.
+ */
+static int par_end_pass(int r) {
+    if (r) {
+        failed = 1;
+    }
+    pthread_barrier_wait(&sync_barrier);
+    return failed;
+}
+
+/* Kernels */
+
+static void __attribute__((noinline))
+fill(ul *a, ul *b, size_t n, ul q0, ul q1) {
+    vul v = vsplat(q0, q1);
+    vul *pa = (vul *) a;
+    vul *pb = (vul *) b;
+    size_t i;
+
+    for (i = 0; i < n / VW; i++) {
+        pa[i] = v;
+        pb[i] = v;
+    }
+    barrier();
+}
+
+/* Offset of the first span of a with a word other than q0, q1, ...; n if none */
+static size_t __attribute__((noinline))
+find_bad(const ul *a, size_t n, ul q0, ul q1) {
+    vul v = vsplat(q0, q1);
+    const vul *p = (const vul *) a;
+    vul acc;
+    size_t i, j, end, nv = n / VW;
+
+    for (i = 0; i < nv; i += PAR_SPAN) {
+        end = i + PAR_SPAN < nv ? i + PAR_SPAN : nv;
+        acc = p[i] ^ v;
+        for (j = i + 1; j < end; j++) {
+            acc |= p[j] ^ v;
+        }
+        if (!vzero(acc)) {
+            return i * VW;
+        }
+    }
+    return n;
+}
+
+/* As find_bad(), for spans where a and b differ */
+static size_t __attribute__((noinline))
+find_diff(const ul *a, const ul *b, size_t n) {
+    const vul *pa = (const vul *) a;
+    const vul *pb = (const vul *) b;
+    vul acc;
+    size_t i, j, end, nv = n / VW;
+
+    for (i = 0; i < nv; i += PAR_SPAN) {
+        end = i + PAR_SPAN < nv ? i + PAR_SPAN : nv;
+        acc = pa[i] ^ pb[i];
+        for (j = i + 1; j < end; j++) {
+            acc |= pa[j] ^ pb[j];
+        }
+        if (!vzero(acc)) {
+            return i * VW;
+        }
+    }
+    return n;
+}
+
+#define PAR_OP(name, op)                                    \
+static void __attribute__((noinline))                       \
+name(ul *a, size_t n, ul q) {                               \
+    vul v = vsplat(q, q);                                   \
+    vul *p = (vul *) a;                                     \
+    size_t i;                                               \
+                                                            \
+    for (i = 0; i < n / VW; i++) {                          \
+        p[i] = p[i] op v;                                   \
+    }                                                       \
+    barrier();                                              \
+}
+
+PAR_OP(op_xor, ^)
+PAR_OP(op_sub, -)
+PAR_OP(op_mul, *)
+PAR_OP(op_div, /)
+PAR_OP(op_or, |)
+PAR_OP(op_and, &)
+
+/* Checks on a worker's share */
+
+static int check_pattern(struct par_worker *w, int h, ul q0, ul q1) {
+    ul *a = w->half[h];
+    size_t i = 0, end, n = w->count;
+    ul got, expect;
+    int r = 0;
+
+    while ((i += find_bad(a + i, n - i, q0, q1)) < n) {
+        end = i + PAR_SPAN * VW < n ? i + PAR_SPAN * VW : n;
+        for (; i < end; i++) {
+            got = ((ulv *) a)[i];
+            expect = (i % 2) == 0 ? q0 : q1;
+            if (got != expect) {
+                report(w, h, a + i, got, expect, "");
+            }
+        }
+        r = -1;
+    }
+    w->bytes += n * sizeof(ul);
+    return r;
+}
+
+static int check_halves(struct par_worker *w) {
+    ul *a = w->half[0];
+    ul *b = w->half[1];
+    size_t i = 0, end, n = w->count;
+    ul va, vb;
+    int r = 0;
+
+    while ((i += find_diff(a + i, b + i, n - i)) < n) {
+        end = i + PAR_SPAN * VW < n ? i + PAR_SPAN * VW : n;
+        for (; i < end; i++) {
+            va = ((ulv *) a)[i];
+            vb = ((ulv *) b)[i];
+            if (va != vb) {
+                /* No telling which half is wrong; name both */
+                report(w, 0, a + i, va, vb, "A vs B, ");
+                report(w, 1, b + i, vb, va, "B vs A, ");
+            }
+        }
+        r = -1;
+    }
+    w->bytes += 2 * n * sizeof(ul);
+    return r;
+}
+
+/* One pass of a fixed pattern, q0 on even words and q1 on odd ones */
+static int par_pattern(struct par_worker *w, ul q0, ul q1) {
+    int r;
+
+    fill(w->half[0], w->half[1], w->count, q0, q1);
+    w->bytes += 2 * w->count * sizeof(ul);
+    par_sync();
+    r = check_pattern(w, 0, q0, q1);
+    r |= check_pattern(w, 1, q0, q1);
+    return par_end_pass(r) ? -1 : 0;
+}
+
+static int par_op(struct par_worker *w, void (*op)(ul *, size_t, ul), ul q) {
+    op(w->half[0], w->count, q);
+    op(w->half[1], w->count, q);
+    w->bytes += 4 * w->count * sizeof(ul);
+    par_sync();
+    return par_end_pass(check_halves(w)) ? -1 : 0;
+}
+
+static ul par_rand(ul *s) {
+    ul x = *s;
+
+#if UL_LEN == 64
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+#else
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+#endif
+    return *s = x;
+}
+
+/* Tests */
+
+int par_stuck_address(struct par_worker *w) {
+    unsigned int j;
+    size_t i, n = w->count, first;
+    ul *p, expect;
+    int h, r = 0;
+
+    for (j = 0; j < 16; j++) {
+        for (h = 0; h < 2; h++) {
+            p = w->half[h];
+            first = w->first + h * half_count;
+            for (i = 0; i < n; i++, p++) {
+                *p = ((j + first + i) % 2) == 0 ? (ul) p : ~((ul) p);
+            }
+        }
+        barrier();
+        w->bytes += 2 * n * sizeof(ul);
+        par_sync();
+        for (h = 0; h < 2; h++) {
+            p = w->half[h];
+            first = w->first + h * half_count;
+            for (i = 0; i < n; i++, p++) {
+                expect = ((j + first + i) % 2) == 0 ? (ul) p : ~((ul) p);
+                if (*(ulv *) p != expect) {
+                    report(w, h, p, *(ulv *) p, expect,
+                           "possible bad address line, ");
+                    r = -1;
+                }
+            }
+        }
+        w->bytes += 2 * n * sizeof(ul);
+        if (par_end_pass(r)) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static int par_random_value(struct par_worker *w) {
+    ul *p1 = w->half[0];
+    ul *p2 = w->half[1];
+    size_t i;
+
+    for (i = 0; i < w->count; i++) {
+        *p1++ = *p2++ = par_rand(&w->seed);
+    }
+    barrier();
+    w->bytes += 2 * w->count * sizeof(ul);
+    par_sync();
+    return par_end_pass(check_halves(w)) ? -1 : 0;
+}
+
+static int par_xor_comparison(struct par_worker *w) {
+    return par_op(w, op_xor, cur_q);
+}
+
+static int par_sub_comparison(struct par_worker *w) {
+    return par_op(w, op_sub, cur_q);
+}
+
+static int par_mul_comparison(struct par_worker *w) {
+    return par_op(w, op_mul, cur_q);
+}
+
+static int par_div_comparison(struct par_worker *w) {
+    return par_op(w, op_div, cur_q ? cur_q : 1);
+}
+
+static int par_or_comparison(struct par_worker *w) {
+    return par_op(w, op_or, cur_q);
+}
+
+static int par_and_comparison(struct par_worker *w) {
+    return par_op(w, op_and, cur_q);
+}
+
+static int par_seqinc_comparison(struct par_worker *w) {
+    vul *p1 = (vul *) w->half[0];
+    vul *p2 = (vul *) w->half[1];
+    vul v, step;
+    unsigned int k;
+    size_t i;
+
+    for (k = 0; k < VW; k++) {
+        v[k] = w->first + k + cur_q;
+        step[k] = VW;
+    }
+    for (i = 0; i < w->count / VW; i++, v += step) {
+        p1[i] = p2[i] = v;
+    }
+    barrier();
+    w->bytes += 2 * w->count * sizeof(ul);
+    par_sync();
+    return par_end_pass(check_halves(w)) ? -1 : 0;
+}
+
+static int par_solidbits_comparison(struct par_worker *w) {
+    unsigned int j;
+    ul q;
+
+    for (j = 0; j < 64; j++) {
+        q = (j % 2) == 0 ? UL_ONEBITS : 0;
+        if (par_pattern(w, q, ~q)) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static int par_checkerboard_comparison(struct par_worker *w) {
+    unsigned int j;
+    ul q;
+
+    for (j = 0; j < 64; j++) {
+        q = (j % 2) == 0 ? CHECKERBOARD1 : CHECKERBOARD2;
+        if (par_pattern(w, q, ~q)) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static int par_blockseq_comparison(struct par_worker *w) {
+    unsigned int j;
+
+    for (j = 0; j < 256; j++) {
+        if (par_pattern(w, (ul) UL_BYTE(j), (ul) UL_BYTE(j))) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static int par_walkbits0_comparison(struct par_worker *w) {
+    unsigned int j;
+    ul q;
+
+    for (j = 0; j < UL_LEN * 2; j++) {
+        if (j < UL_LEN) { /* Walk it up. */
+            q = ONE << j;
+        } else { /* Walk it back down. */
+            q = ONE << (UL_LEN * 2 - j - 1);
+        }
+        if (par_pattern(w, q, q)) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static int par_walkbits1_comparison(struct par_worker *w) {
+    unsigned int j;
+    ul q;
+
+    for (j = 0; j < UL_LEN * 2; j++) {
+        if (j < UL_LEN) { /* Walk it up. */
+            q = UL_ONEBITS ^ (ONE << j);
+        } else { /* Walk it back down. */
+            q = UL_ONEBITS ^ (ONE << (UL_LEN * 2 - j - 1));
+        }
+        if (par_pattern(w, q, q)) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static int par_bitspread_comparison(struct par_worker *w) {
+    unsigned int j;
+    ul q;
+
+    for (j = 0; j < UL_LEN * 2; j++) {
+        if (j < UL_LEN) { /* Walk it up. */
+            q = (ONE << j) | (ONE << (j + 2));
+        } else { /* Walk it back down. */
+            q = (ONE << (UL_LEN * 2 - 1 - j)) | (ONE << (UL_LEN * 2 + 1 - j));
+        }
+        if (par_pattern(w, q, UL_ONEBITS ^ q)) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static int par_bitflip_comparison(struct par_worker *w) {
+    unsigned int j, k;
+    ul q;
+
+    for (k = 0; k < UL_LEN; k++) {
+        q = ONE << k;
+        for (j = 0; j < 8; j++) {
+            q = ~q;
+            if (par_pattern(w, q, ~q)) {
+                return -1;
+            }
+        }
+    }
+    return 0;
+}
+
+struct par_test par_tests[] = {
+    { "Random Value", par_random_value },
+    { "Compare XOR", par_xor_comparison },
+    { "Compare SUB", par_sub_comparison },
+    { "Compare MUL", par_mul_comparison },
+    { "Compare DIV", par_div_comparison },
+    { "Compare OR", par_or_comparison },
+    { "Compare AND", par_and_comparison },
+    { "Sequential Increment", par_seqinc_comparison },
+    { "Solid Bits", par_solidbits_comparison },
+    { "Block Sequential", par_blockseq_comparison },
+    { "Checkerboard", par_checkerboard_comparison },
+    { "Bit Spread", par_bitspread_comparison },
+    { "Bit Flip", par_bitflip_comparison },
+    { "Walking Ones", par_walkbits1_comparison },
+    { "Walking Zeroes", par_walkbits0_comparison },
+#ifdef TEST_NARROW_WRITES
+    /* The point of these is the narrow stores; run them with tests.c */
+    { "8-bit Writes", NULL },
+    { "16-bit Writes", NULL },
+#endif
+    { NULL, NULL }
+};
+
+/* Workers */
+
+static void *par_worker_main(void *arg) {
+    struct par_worker *w = arg;
+    cpu_set_t set;
+
+    if (w->cpu >= 0) {
+        CPU_ZERO(&set);
+        CPU_SET(w->cpu, &set);
+        if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set)) {
+            fprintf(stderr, "worker %d: failed to pin to CPU %d\n", w->id,
+                    w->cpu);
+        }
+    }
+
+    for (;;) {
+        pthread_barrier_wait(&start_barrier);
+        if (!cur_fn) {
+            break;
+        }
+        w->ret = cur_fn(w);
+        pthread_barrier_wait(&done_barrier);
+    }
+    return NULL;
+}
+
+int par_start(void volatile *base, size_t bufsize, int nthreads) {
+    int cpus[CPU_SETSIZE];
+    int ncpus = 0, i;
+    size_t per, blocks;
+    cpu_set_t set;
+
+    if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+        for (i = 0; i < CPU_SETSIZE; i++) {
+            if (CPU_ISSET(i, &set)) {
+                cpus[ncpus++] = i;
+            }
+        }
+    }
+    if (nthreads <= 0) {
+        nthreads = ncpus ? ncpus : sysconf(_SC_NPROCESSORS_ONLN);
+    }
+
+    /* Whole blocks only, so every share starts aligned and on an even word */
+    blocks = bufsize / 2 / sizeof(ul) / PAR_BLOCK;
+    if (nthreads > PAR_MAX_THREADS) {
+        nthreads = PAR_MAX_THREADS;
+    }
+    if ((size_t) nthreads > blocks) {
+        nthreads = blocks;
+    }
+    if (nthreads <= 0) {
+        return -1;
+    }
+
+    base_addr = (char *) base;
+    bufa = (ul *) base;
+    half_count = blocks * PAR_BLOCK;
+    per = blocks / nthreads;
+
+    if (pthread_barrier_init(&start_barrier, NULL, nthreads + 1) ||
+        pthread_barrier_init(&done_barrier, NULL, nthreads + 1) ||
+        pthread_barrier_init(&sync_barrier, NULL, nthreads)) {
+        perror("pthread_barrier_init");
+        return -1;
+    }
+
+    for (i = 0; i < nthreads; i++) {
+        struct par_worker *w = &workers[i];
+
+        w->id = i;
+        w->cpu = ncpus ? cpus[i % ncpus] : -1;
+        w->first = i * per * PAR_BLOCK;
+        w->count = (i == nthreads - 1 ? blocks - i * per : per) * PAR_BLOCK;
+        w->half[0] = bufa + w->first;
+        w->half[1] = bufa + half_count + w->first;
+        if (pthread_create(&w->thread, NULL, par_worker_main, w)) {
+            perror("pthread_create");
+            exit(EXIT_FAILURE);
+        }
+    }
+    nworkers = nthreads;
+
+    printf("parallel: %d threads, %llu bytes in each half, %u-byte words\n",
+           nworkers, (ull) half_count * sizeof(ul), (unsigned) PAR_VEC_BYTES);
+    return nworkers;
+}
+
+static double now(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int par_run(int (*fp)(struct par_worker *w), double *mbps) {
+    ull bytes = 0;
+    ul errors[2] = { 0, 0 };
+    double t0, t;
+    int i, r = 0;
+
+    cur_fn = fp;
+    cur_q = rand_ul();
+    failed = 0;
+    for (i = 0; i < nworkers; i++) {
+        workers[i].seed = rand_ul() | 1;
+        workers[i].bytes = 0;
+        workers[i].errors[0] = workers[i].errors[1] = 0;
+        workers[i].reports = 0;
+    }
+
+    t0 = now();
+    pthread_barrier_wait(&start_barrier);
+    pthread_barrier_wait(&done_barrier);
+    t = now() - t0;
+
+    for (i = 0; i < nworkers; i++) {
+        bytes += workers[i].bytes;
+        errors[0] += workers[i].errors[0];
+        errors[1] += workers[i].errors[1];
+        r |= workers[i].ret;
+    }
+    if (errors[0] || errors[1]) {
+        fprintf(stderr, "FAILURE: %lu words bad in half A, %lu in half B.\n",
+                errors[0], errors[1]);
+    }
+    *mbps = t > 0 ? bytes / t / (1 << 20) : 0;
+    return r;
+}
+
+void par_stop(void) {
+    int i;
+
+    if (!nworkers) {
+        return;
+    }
+    cur_fn = NULL;
+    pthread_barrier_wait(&start_barrier);
+    for (i = 0; i < nworkers; i++) {
+        pthread_join(workers[i].thread, NULL);
+    }
+    pthread_barrier_destroy(&start_barrier);
+    pthread_barrier_destroy(&done_barrier);
+    pthread_barrier_destroy(&sync_barrier);
+    nworkers = 0;
+}
@@ -0,0 +1,38 @@
+/*
+ * Parallel mode for memtester.
+ * Copyright 2017-present Facebook. All Rights Reserved.
+ * Licensed under the terms of the GNU General Public License version 2 (only).
+ * See the file COPYING for details.
+ *
+ * This file contains the declarations for the parallel versions of the
+ * tests, run from the main routine in memtester.c when -j is given.
+ *
+ */
+
+#include <sys/types.h>
+
+/* Most worker threads, and the granule, in words, the halves are split in. */
+#define PAR_MAX_THREADS 64
+#define PAR_BLOCK 8
+
+struct par_worker;
+
+struct par_test {
+    char *name;
+    int (*fp)(struct par_worker *w);
+};
+
+/* Same order as tests[] in memtester.c, so MEMTESTER_TEST_MASK applies. */
+extern struct par_test par_tests[];
+
+int par_stuck_address(struct par_worker *w);
+
+/*
+ * Split the two halves of the buffer at base between nthreads workers, one
+ * per CPU for 0, pinned round robin to the CPUs we may run on. Returns the
+ * number of workers, or -1 if none could be started.
+ */
+int par_start(void volatile *base, size_t bufsize, int nthreads);
+/* Run one test on all workers; MB/s moved to and from memory in *mbps. */
+int par_run(int (*fp)(struct par_worker *w), double *mbps);
+void par_stop(void);
@@ -14,14 +14,22 @@
  * along with this program; if not, write to the Free Software
  * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
  */
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
 #include <syslog.h>
+#include <pthread.h>
+#include <time.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/file.h>
 #include <fcntl.h>
 #include <openbmc/obmc-i2c.h>
+#include <facebook/lightning_common.h>
 #include "lightning_flash.h"
 
 #define I2C_DEV_FLASH1 "/dev/i2c-7"
@@ -36,7 +44,42 @@
 #define NVME_TEMP_REG 0x03
 
 #define SKIP_READ_SSD_TEMP "/tmp/skipSSD"
- 
+
+#define FLASH_MUX_LOCK "/tmp/lightning_flash_mux%d.lock"
+#define FLASH_STATS_FILE "/tmp/lightning_flash.stats"
+
+// A sweep result is served once, and only while it is this recent
+#define FLASH_SWEEP_MAX_AGE_MS 1000
+
+#define NUM_MUX 2
+#define MUX_CHAN_UNKNOWN 0xFF
+
+/*
+ * Each flash mux sits on a bus of its own, and with the M.2 mux behind the
+ * selected channel forms one tree. Anything done on a tree is done holding
+ * its lock: a mutex for the threads of this process and a flock for other
+ * processes. The channels last written are remembered while the lock is
+ * held, so a channel already selected is not selected again.
+ */
+struct flash_mux_tree {
+  const char *bus;
+  uint8_t addr;
+  pthread_mutex_t mutex;
+  int depth;                // lock nesting in this process
+  int lock_fd;
+  int bus_fd;               // kept open
+  int slave;                // address assigned to bus_fd, -1 if none
+  uint8_t chan;             // channel of the flash mux
+  uint8_t sec_chan;         // channel of the M.2 mux behind it
+};
+
+static struct flash_mux_tree g_tree[NUM_MUX] = {
+  {I2C_DEV_FLASH1, I2C_MUX_FLASH1_ADDR, PTHREAD_RECURSIVE_MUTEX_INITIALIZER_NP,
+   0, -1, -1, -1, MUX_CHAN_UNKNOWN, MUX_CHAN_UNKNOWN},
+  {I2C_DEV_FLASH2, I2C_MUX_FLASH2_ADDR, PTHREAD_RECURSIVE_MUTEX_INITIALIZER_NP,
+   0, -1, -1, -1, MUX_CHAN_UNKNOWN, MUX_CHAN_UNKNOWN},
+};
+
 /* List of information of I2C mapping for mux and channel */
 const uint8_t lightning_flash_list[] = {
   I2C_MAP_FLASH0,
@@ -58,88 +101,176 @@ const uint8_t lightning_flash_list[] = {
 
 size_t lightning_flash_cnt = sizeof(lightning_flash_list) / sizeof(uint8_t);
 
-// TODO: Need to change the lightning_flash_status_read to read SSD status
-// data and not just Temperature Data.
+#define MAX_FLASH (sizeof(lightning_flash_list) / sizeof(uint8_t))
 
-/* To read NVMe Management Spec Based Status information */
-int
-lightning_flash_status_read(uint8_t i2c_map, uint16_t *status) {
-
-  int dev;
+struct flash_result {
   int ret;
-  int32_t res;
-  uint8_t mux;
-  uint8_t chan;
-  char bus[32];
+  float temp;
+  uint8_t valid;            // not served yet
+};
 
-  mux = i2c_map / 10;
-  chan = i2c_map % 10;
+static pthread_mutex_t m_sweep = PTHREAD_MUTEX_INITIALIZER;
+static struct flash_result g_temp[MAX_FLASH];
+static struct flash_result g_amb[MAX_FLASH];
+static lightning_flash_stats_t g_stats[MAX_FLASH];
+static uint64_t g_sweep_ts;
+static uint32_t g_sweep_us;
+static uint32_t g_sweeps;
+static uint32_t g_mux_writes;
+
+static uint64_t
+now_us(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
 
-  //if enclosure-util read SSD, skip SSD monitor
-  if (access(SKIP_READ_SSD_TEMP, F_OK) == 0)
-    return 1;
-  ret = lightning_flash_mux_sel_chan(mux, chan);
-  if(ret < 0) {
-    syslog(LOG_DEBUG, "%s(): lightning_flash_mux_sel_chan on Mux %d failed", __func__, mux);
-    return -1;
+static struct flash_mux_tree *
+flash_tree(uint8_t mux) {
+  if (mux >= NUM_MUX) {
+    syslog(LOG_DEBUG, "%s(): unknown mux", __func__);
+    return NULL;
   }
+  return &g_tree[mux];
+}
 
-  if (mux == I2C_MUX_FLASH1)
-    sprintf(bus, "%s", I2C_DEV_FLASH1);
-  else if (mux == I2C_MUX_FLASH2)
-    sprintf(bus, "%s", I2C_DEV_FLASH2);
-  else {
-    syslog(LOG_DEBUG, "%s(): unknown mux", __func__);
+int
+lightning_flash_lock(uint8_t mux) {
+  struct flash_mux_tree *tree = flash_tree(mux);
+  char path[64];
+
+  if (!tree)
     return -1;
+
+  pthread_mutex_lock(&tree->mutex);
+  if (tree->depth++)
+    return 0;
+
+  if (tree->lock_fd < 0) {
+    snprintf(path, sizeof(path), FLASH_MUX_LOCK, mux);
+    tree->lock_fd = open(path, O_CREAT | O_RDWR | O_CLOEXEC, 0666);
+  }
+  if (tree->lock_fd < 0 || flock(tree->lock_fd, LOCK_EX) < 0) {
+    // Better to go on unlocked than to stop monitoring the drives
+    syslog(LOG_WARNING, "%s(): cannot lock mux %d, errno %d", __func__, mux, errno);
   }
 
-  //if enclosure-util read SSD, skip SSD monitor
-  if (access(SKIP_READ_SSD_TEMP, F_OK) == 0)
-    return 1;
+  // Another process may have switched the muxes meanwhile
+  tree->chan = MUX_CHAN_UNKNOWN;
+  tree->sec_chan = MUX_CHAN_UNKNOWN;
+  return 0;
+}
 
-  dev = open(bus, O_RDWR);
-  if (dev < 0) {
-    syslog(LOG_DEBUG, "%s(): open() failed", __func__);
-    return -1;
+void
+lightning_flash_unlock(uint8_t mux) {
+  struct flash_mux_tree *tree = flash_tree(mux);
+
+  if (!tree)
+    return;
+
+  if (--tree->depth == 0 && tree->lock_fd >= 0)
+    flock(tree->lock_fd, LOCK_UN);
+  pthread_mutex_unlock(&tree->mutex);
+}
+
+// Bus fd talking to addr. Called with the tree locked.
+static int
+flash_dev(struct flash_mux_tree *tree, uint8_t addr) {
+  if (tree->bus_fd < 0) {
+    tree->bus_fd = open(tree->bus, O_RDWR | O_CLOEXEC);
+    if (tree->bus_fd < 0) {
+      syslog(LOG_DEBUG, "%s(): open() failed", __func__);
+      return -1;
+    }
+    tree->slave = -1;
   }
 
-  /* Assign the i2c device address */
-  ret = ioctl(dev, I2C_SLAVE, I2C_FLASH_ADDR);
-  if (ret < 0) {
-    syslog(LOG_DEBUG, "%s(): ioctl() assigning i2c addr failed", __func__);
-    close(dev);
-    return -1;
+  if (tree->slave != addr) {
+    /* Assign the i2c device address */
+    if (ioctl(tree->bus_fd, I2C_SLAVE, addr) < 0) {
+      syslog(LOG_DEBUG, "%s(): ioctl() assigning i2c addr failed", __func__);
+      close(tree->bus_fd);
+      tree->bus_fd = -1;
+      return -1;
+    }
+    tree->slave = addr;
   }
 
-  /* Read the Status from the NVMe device */
-  res = i2c_smbus_read_word_data(dev, NVME_STATUS_CMD);
-  if (res < 0) {
-    close(dev);
-    syslog(LOG_DEBUG, "%s(): i2c_smbus_read_block_data failed", __func__);
+  return tree->bus_fd;
+}
+
+// Called with the tree locked
+static int
+flash_mux_sel(struct flash_mux_tree *tree, uint8_t channel) {
+  int dev;
+
+  if (tree->chan == channel)
+    return 0;
+
+  dev = flash_dev(tree, tree->addr);
+  if (dev < 0)
+    return -1;
+
+  /* Write the channel number to enable it */
+  g_mux_writes++;
+  if (i2c_smbus_write_byte(dev, (1 << 3) | channel) < 0) {
+    syslog(LOG_DEBUG, "%s(): i2c_smbus_write_byte failed", __func__);
+    tree->chan = MUX_CHAN_UNKNOWN;
     return -1;
   }
 
-  // Return only the word
-  *status = (res & 0xFF00) >> 8 | (res & 0xFF) << 8;
+  tree->chan = channel;
+  // The M.2 mux behind the new channel is another one
+  tree->sec_chan = MUX_CHAN_UNKNOWN;
+  return 0;
+}
 
-  close(dev);
+// Called with the tree locked
+static int
+flash_sec_mux_sel(struct flash_mux_tree *tree, uint8_t channel) {
+  int dev;
 
-  return ret;
-}
+  if (tree->chan != MUX_CHAN_UNKNOWN && tree->sec_chan == channel)
+    return 0;
 
-/* To read NVMe Management Spec Based device Temperature */
-int
-lightning_flash_temp_read(uint8_t i2c_map, float *temp) {
+  dev = flash_dev(tree, I2C_M2_MUX_ADDR);
+  if (dev < 0)
+    return -1;
 
-  int ret;
+  /* Write the channel number to enable it */
+  g_mux_writes++;
+  if (i2c_smbus_write_byte(dev, channel) < 0) {
+    syslog(LOG_DEBUG, "%s(): i2c_smbus_write_byte failed", __func__);
+    tree->sec_chan = MUX_CHAN_UNKNOWN;
+    return -1;
+  }
+
+  tree->sec_chan = channel;
+  return 0;
+}
+
+/* NVMe Management Spec based temperature, channel already selected */
+static int
+flash_status_temp(struct flash_mux_tree *tree, float *temp) {
+  int dev;
+  int32_t res;
   uint16_t status;
 
-  ret = lightning_flash_status_read(i2c_map, &status);
-  if(ret < 0) {
-    syslog(LOG_DEBUG, "%s(): lightning_flash_status_read failed", __func__);
+  dev = flash_dev(tree, I2C_FLASH_ADDR);
+  if (dev < 0)
+    return -1;
+
+  /* Read the Status from the NVMe device */
+  res = i2c_smbus_read_word_data(dev, NVME_STATUS_CMD);
+  if (res < 0) {
+    syslog(LOG_DEBUG, "%s(): i2c_smbus_read_block_data failed", __func__);
     return -1;
   }
 
+  // Return only the word
+  status = (res & 0xFF00) >> 8 | (res & 0xFF) << 8;
+
   *temp = (status & 0x0FF0) >> 4;
 
   // Check is the temperature is negative
@@ -154,172 +285,147 @@ lightning_flash_temp_read(uint8_t i2c_map, float *temp) {
     return -1;
   }
 
-  return ret;
+  return 0;
 }
 
-int 
-lightning_u2_flash_temp_read(uint8_t i2c_map, float *temp) {
-
-  int ret;
-  uint8_t mux;
-  uint8_t chan;
-  uint8_t vendor;
-  mux = i2c_map / 10;
-  chan = i2c_map % 10;
-
-  //if enclosure-util read SSD, skip SSD monitor
-  if (access(SKIP_READ_SSD_TEMP, F_OK) == 0)
-    return 1;
+/* NVMe-MI basic management temperature, channels already selected */
+static int
+flash_nvme_temp(struct flash_mux_tree *tree, float *temp) {
+  int dev;
+  int32_t res;
 
-  /* Set 1-level mux */
-  ret = lightning_flash_mux_sel_chan(mux, chan);
-  if(ret < 0) {
-    syslog(LOG_DEBUG, "%s(): lightning_flash_mux_sel_chan on Mux %d failed", __func__, mux);
+  dev = flash_dev(tree, I2C_NVME_INTF_ADDR);
+  if (dev < 0)
     return -1;
-  }
 
-  // Get temp reading via NVME
-  ret = lightning_nvme_temp_read(mux, temp);
-  
-  if(ret < 0) {
-    syslog(LOG_DEBUG, "%s(): lightning_nvme_temp_read failed, try old method", __func__);
-    // If it does not support NVME, try old method
-    ret = lightning_flash_temp_read(i2c_map, temp);
-    if(ret < 0) {
-      syslog(LOG_DEBUG, "%s(): lightning_flash_temp_read failed", __func__);
-      return -1;
-    }
-    else
-      return 0;
-    
+  res = i2c_smbus_read_byte_data(dev, NVME_TEMP_REG);
+  if (res < 0) {
+    syslog(LOG_DEBUG, "%s(): i2c_smbus_read_byte_data failed", __func__);
     return -1;
   }
 
-  // Error handling for flash seems support NVME but always reture same data, try old method to get temp 
-  ret = lightning_ssd_vendor(&vendor);
+  *temp = (float) res;
+  return 0;
+}
 
-  if((ret < 0) && (*temp == 0xD5)) 
-    ret = lightning_flash_temp_read(i2c_map, temp);
+/* M.2 card ambient temperature, channel already selected */
+static int
+flash_amb_temp(struct flash_mux_tree *tree, float *temp) {
+  int dev;
+  int32_t res;
 
-  if(ret < 0) {
-    syslog(LOG_DEBUG, "%s(): lightning_flash_temp_read failed", __func__);
+  dev = flash_dev(tree, I2C_M2CARD_AMB_ADDR);
+  if (dev < 0)
     return -1;
-  }
 
-  return ret;
-}
-
-/* Enable the mux to select a particular channel */
-int
-lightning_flash_mux_sel_chan(uint8_t mux, uint8_t channel) {
-
-  int dev;
-  int ret;
-  uint8_t addr;
-  uint8_t chan_en;
-  char bus[32];
-
-  if (mux == I2C_MUX_FLASH1)
-    sprintf(bus, "%s", I2C_DEV_FLASH1);
-  else if (mux == I2C_MUX_FLASH2)
-    sprintf(bus, "%s", I2C_DEV_FLASH2);
-  else {
-    syslog(LOG_DEBUG, "%s(): unknown mux", __func__);
+  /* Read the ambient temp */
+  res = i2c_smbus_read_word_data(dev, M2CARD_AMB_TEMP_REG);
+  if (res < 0) {
+    syslog(LOG_DEBUG, "%s(): i2c_smbus_read_block_data failed", __func__);
     return -1;
   }
 
-  dev = open(bus, O_RDWR);
-  if (dev < 0) {
-    syslog(LOG_DEBUG, "%s(): open() failed", __func__);
+  /* Result is read as MSB byte first and LSB byte second.
+   * Result is 12bit with res[11:4]  == MSB[7:0] and res[3:0] = LSB */
+  res = ((res & 0x0FF) << 4) | ((res & 0xF000) >> 12);
+
+   /* Resolution is 0.0625 deg C/bit */
+  if (res <= 0x7FF) {
+    /* Temperature is positive  */
+    *temp = (float) res * 0.0625;
+  } else if (res >= 0xC90) {
+    /* Temperature is negative */
+    *temp = (float) (0xFFF - res + 1) * (-1) * 0.0625;
+  } else {
+    /* Out of range [128C to -55C] */
+    syslog(LOG_DEBUG, "%s(): invalid res value = 0x%X", __func__, res);
     return -1;
   }
 
-  switch(mux) {
-    case I2C_MUX_FLASH1:
-      addr = I2C_MUX_FLASH1_ADDR,
-      chan_en = (1 << 3) | channel;
-      break;
+  return 0;
+}
 
-    case I2C_MUX_FLASH2:
-      addr = I2C_MUX_FLASH2_ADDR,
-      chan_en = (1 << 3) | channel;
-      break;
-  }
+// Called with the tree locked
+static int
+flash_u2_temp(struct flash_mux_tree *tree, uint8_t chan, float *temp) {
+  uint8_t vendor;
+  int ret;
 
-  /* Assign the i2c device address */
-  ret = ioctl(dev, I2C_SLAVE, addr);
-  if (ret < 0) {
-    syslog(LOG_DEBUG, "%s(): ioctl() assigning i2c addr failed", __func__);
-    close(dev);
+  /* Set 1-level mux */
+  if (flash_mux_sel(tree, chan) < 0)
     return -1;
-  }
 
-  /* Write the channel number to enable it */
-  ret = i2c_smbus_write_byte(dev, chan_en);
-  if (ret < 0) {
-    syslog(LOG_DEBUG, "%s(): i2c_smbus_write_byte failed", __func__);
-    close(dev);
-    return -1;
+  // Get temp reading via NVME
+  if (flash_nvme_temp(tree, temp) < 0) {
+    syslog(LOG_DEBUG, "%s(): NVMe-MI read failed, try old method", __func__);
+    // If it does not support NVME, try old method
+    return flash_status_temp(tree, temp);
   }
 
-  close(dev);
+  // Error handling for flash seems support NVME but always reture same data, try old method to get temp
+  ret = lightning_ssd_vendor(&vendor);
+  if ((ret < 0) && (*temp == 0xD5))
+    ret = flash_status_temp(tree, temp);
 
-  return 0;
+  return ret < 0 ? -1 : 0;
 }
 
-int
-lightning_flash_sec_mux_sel_chan(uint8_t mux, uint8_t channel) {
-
-  int dev;
-  int ret;
-  char bus[32];
+// Called with the tree locked
+static int
+flash_m2_temp(struct flash_mux_tree *tree, uint8_t chan, uint8_t sec_chan,
+              float *temp) {
+  /* Set 1-level mux */
+  if (flash_mux_sel(tree, chan) < 0)
+    return -1;
 
-  if (mux == I2C_MUX_FLASH1)
-    sprintf(bus, "%s", I2C_DEV_FLASH1);
-  else if (mux == I2C_MUX_FLASH2)
-    sprintf(bus, "%s", I2C_DEV_FLASH2);
-  else {
-    syslog(LOG_DEBUG, "%s(): unknown mux", __func__);
+  /* Set 2-level mux */
+  if (flash_sec_mux_sel(tree, sec_chan) < 0)
     return -1;
-  }
 
-  dev = open(bus, O_RDWR);
-  if (dev < 0) {
-    syslog(LOG_DEBUG, "%s(): open() failed", __func__);
+  return flash_nvme_temp(tree, temp);
+}
+
+// Called with the tree locked
+static int
+flash_m2_max_temp(struct flash_mux_tree *tree, uint8_t chan, float *temp) {
+  float temp1;
+  float temp2;
+
+  /* read the M.2 temp on channel 0 */
+  if (flash_m2_temp(tree, chan, M2_MUX_CHANNEL_0, &temp1) < 0) {
+    syslog(LOG_DEBUG, "%s(): M.2 temp read on channel 0 failed", __func__);
     return -1;
   }
-
-  /* Assign the 2-level mux address */
-  ret = ioctl(dev, I2C_SLAVE, I2C_M2_MUX_ADDR);
-  if (ret < 0) {
-    syslog(LOG_DEBUG, "%s(): ioctl() assigning i2c addr failed", __func__);
-    close(dev);
+  /* read the M.2 temp on channel 1 */
+  if (flash_m2_temp(tree, chan, M2_MUX_CHANNEL_1, &temp2) < 0) {
+    syslog(LOG_DEBUG, "%s(): M.2 temp read on channel 1 failed", __func__);
     return -1;
   }
 
+  /*  return the bigger temp reading */
+  *temp = (temp1 > temp2)? temp1:temp2;
+  return 0;
+}
 
-  /* Write the channel number to enable it */
-  ret = i2c_smbus_write_byte(dev, channel);
-  if (ret < 0) {
-    syslog(LOG_DEBUG, "%s(): i2c_smbus_write_byte failed", __func__);
-    close(dev);
+// Called with the tree locked
+static int
+flash_m2_amb_temp(struct flash_mux_tree *tree, uint8_t chan, float *temp) {
+  if (flash_mux_sel(tree, chan) < 0)
     return -1;
-  }
-
-  close(dev);
 
-  return 0;
+  return flash_amb_temp(tree, temp);
 }
 
-int 
-lightning_m2_amb_temp_read(uint8_t i2c_map, float *temp) {
+/* To read NVMe Management Spec Based Status information */
+int
+lightning_flash_status_read(uint8_t i2c_map, uint16_t *status) {
 
+  struct flash_mux_tree *tree;
   int dev;
-  int ret;
+  int ret = -1;
   int32_t res;
   uint8_t mux;
   uint8_t chan;
-  char bus[32];
 
   mux = i2c_map / 10;
   chan = i2c_map % 10;
@@ -328,182 +434,353 @@ lightning_m2_amb_temp_read(uint8_t i2c_map, float *temp) {
   if (access(SKIP_READ_SSD_TEMP, F_OK) == 0)
     return 1;
 
-  ret = lightning_flash_mux_sel_chan(mux, chan);
-  if(ret < 0) {
-    syslog(LOG_DEBUG, "%s(): lightning_flash_mux_sel_chan on Mux %d failed", __func__, mux);
+  tree = flash_tree(mux);
+  if (!tree || lightning_flash_lock(mux))
     return -1;
+
+  if (flash_mux_sel(tree, chan) < 0) {
+    syslog(LOG_DEBUG, "%s(): lightning_flash_mux_sel_chan on Mux %d failed", __func__, mux);
+    goto exit;
   }
 
-  if (mux == I2C_MUX_FLASH1)
-    sprintf(bus, "%s", I2C_DEV_FLASH1);
-  else if (mux == I2C_MUX_FLASH2)
-    sprintf(bus, "%s", I2C_DEV_FLASH2);
-  else {
-    syslog(LOG_DEBUG, "%s(): unknown mux", __func__);
-    return -1;
+  dev = flash_dev(tree, I2C_FLASH_ADDR);
+  if (dev < 0)
+    goto exit;
+
+  /* Read the Status from the NVMe device */
+  res = i2c_smbus_read_word_data(dev, NVME_STATUS_CMD);
+  if (res < 0) {
+    syslog(LOG_DEBUG, "%s(): i2c_smbus_read_block_data failed", __func__);
+    goto exit;
   }
 
+  // Return only the word
+  *status = (res & 0xFF00) >> 8 | (res & 0xFF) << 8;
+  ret = 0;
+
+exit:
+  lightning_flash_unlock(mux);
+  return ret;
+}
+
+/* To read NVMe Management Spec Based device Temperature */
+int
+lightning_flash_temp_read(uint8_t i2c_map, float *temp) {
+
+  struct flash_mux_tree *tree;
+  uint8_t mux = i2c_map / 10;
+  int ret = -1;
+
   //if enclosure-util read SSD, skip SSD monitor
   if (access(SKIP_READ_SSD_TEMP, F_OK) == 0)
     return 1;
 
-  dev = open(bus, O_RDWR);
-  if (dev < 0) {
-    syslog(LOG_DEBUG, "%s(): open() failed", __func__);
+  tree = flash_tree(mux);
+  if (!tree || lightning_flash_lock(mux))
     return -1;
-  }
 
-  /* Assign the i2c device address */
-  ret = ioctl(dev, I2C_SLAVE, I2C_M2CARD_AMB_ADDR);
-  if (ret < 0) {
-    syslog(LOG_DEBUG, "%s(): ioctl() assigning i2c addr failed", __func__);
-    close(dev);
-    return -1;
-  }
+  if (flash_mux_sel(tree, i2c_map % 10) == 0)
+    ret = flash_status_temp(tree, temp);
 
-  /* Read the ambient temp */
-  res = i2c_smbus_read_word_data(dev, M2CARD_AMB_TEMP_REG);
-  if (res < 0) {
-    close(dev);
-    syslog(LOG_DEBUG, "%s(): i2c_smbus_read_block_data failed", __func__);
-    return -1;
-  }
-  
-  close(dev);
+  lightning_flash_unlock(mux);
+  return ret;
+}
 
-  /* Result is read as MSB byte first and LSB byte second.
-   * Result is 12bit with res[11:4]  == MSB[7:0] and res[3:0] = LSB */
-  res = ((res & 0x0FF) << 4) | ((res & 0xF000) >> 12);
+int
+lightning_u2_flash_temp_read(uint8_t i2c_map, float *temp) {
 
-   /* Resolution is 0.0625 deg C/bit */
-  if (res <= 0x7FF) {
-    /* Temperature is positive  */
-    *temp = (float) res * 0.0625;
-  } else if (res >= 0xC90) {
-    /* Temperature is negative */
-    *temp = (float) (0xFFF - res + 1) * (-1) * 0.0625;
-  } else {
-    /* Out of range [128C to -55C] */
-    syslog(LOG_DEBUG, "%s(): invalid res value = 0x%X", __func__, res);
+  struct flash_mux_tree *tree;
+  uint8_t mux = i2c_map / 10;
+  int ret;
+
+  //if enclosure-util read SSD, skip SSD monitor
+  if (access(SKIP_READ_SSD_TEMP, F_OK) == 0)
+    return 1;
+
+  tree = flash_tree(mux);
+  if (!tree || lightning_flash_lock(mux))
     return -1;
-  }
 
+  ret = flash_u2_temp(tree, i2c_map % 10, temp);
+  if (ret < 0)
+    syslog(LOG_DEBUG, "%s(): U.2 temp read failed", __func__);
+
+  lightning_flash_unlock(mux);
   return ret;
 }
 
-int 
-lightning_m2_flash_temp_read(uint8_t i2c_map, float *temp) {
+/* Enable the mux to select a particular channel */
+int
+lightning_flash_mux_sel_chan(uint8_t mux, uint8_t channel) {
 
-  float temp1;
-  float temp2;
+  struct flash_mux_tree *tree;
   int ret;
 
-  /* read the M.2 temp on channel 0 */
-  ret = lightning_m2_temp_read(i2c_map, M2_MUX_CHANNEL_0, &temp1);
-  if(ret < 0) {
-    syslog(LOG_DEBUG, "%s(): lightning_m2_temp_read on channel 0 failed", __func__);
+  tree = flash_tree(mux);
+  if (!tree || lightning_flash_lock(mux))
     return -1;
-  }
-  /* read the M.2 temp on channel 1 */
-  ret = lightning_m2_temp_read(i2c_map, M2_MUX_CHANNEL_1, &temp2);
-   if(ret < 0) {
-    syslog(LOG_DEBUG, "%s(): lightning_m2_temp_read on channel 1 failed", __func__);
+
+  ret = flash_mux_sel(tree, channel);
+
+  lightning_flash_unlock(mux);
+  return ret;
+}
+
+int
+lightning_flash_sec_mux_sel_chan(uint8_t mux, uint8_t channel) {
+
+  struct flash_mux_tree *tree;
+  int ret;
+
+  tree = flash_tree(mux);
+  if (!tree || lightning_flash_lock(mux))
     return -1;
-  }
 
-  /*  return the bigger temp reading */
-  *temp = (temp1 > temp2)? temp1:temp2;
+  ret = flash_sec_mux_sel(tree, channel);
 
+  lightning_flash_unlock(mux);
   return ret;
 }
 
-int 
-lightning_m2_temp_read(uint8_t i2c_map, uint8_t m2_mux_chan, float *temp) {
+int
+lightning_m2_amb_temp_read(uint8_t i2c_map, float *temp) {
 
+  struct flash_mux_tree *tree;
+  uint8_t mux = i2c_map / 10;
   int ret;
-  uint8_t mux;
-  uint8_t chan;
-  char bus[32];
 
-  mux = i2c_map / 10;
-  chan = i2c_map % 10;
+  //if enclosure-util read SSD, skip SSD monitor
+  if (access(SKIP_READ_SSD_TEMP, F_OK) == 0)
+    return 1;
+
+  tree = flash_tree(mux);
+  if (!tree || lightning_flash_lock(mux))
+    return -1;
+
+  ret = flash_m2_amb_temp(tree, i2c_map % 10, temp);
+
+  lightning_flash_unlock(mux);
+  return ret;
+}
+
+int
+lightning_m2_flash_temp_read(uint8_t i2c_map, float *temp) {
+
+  struct flash_mux_tree *tree;
+  uint8_t mux = i2c_map / 10;
+  int ret;
 
   //if enclosure-util read SSD, skip SSD monitor
   if (access(SKIP_READ_SSD_TEMP, F_OK) == 0)
     return 1;
 
-  /* Set 1-level mux */
-  ret = lightning_flash_mux_sel_chan(mux, chan);
-  if(ret < 0) {
-    syslog(LOG_DEBUG, "%s(): lightning_flash_mux_sel_chan on Mux %d failed", __func__, mux);
+  tree = flash_tree(mux);
+  if (!tree || lightning_flash_lock(mux))
     return -1;
-  }
+
+  ret = flash_m2_max_temp(tree, i2c_map % 10, temp);
+
+  lightning_flash_unlock(mux);
+  return ret;
+}
+
+int
+lightning_m2_temp_read(uint8_t i2c_map, uint8_t m2_mux_chan, float *temp) {
+
+  struct flash_mux_tree *tree;
+  uint8_t mux = i2c_map / 10;
+  int ret;
 
   //if enclosure-util read SSD, skip SSD monitor
   if (access(SKIP_READ_SSD_TEMP, F_OK) == 0)
     return 1;
 
-  /* Set 2-level mux */
-  ret = lightning_flash_sec_mux_sel_chan(mux, m2_mux_chan);
-  if(ret < 0) {
-    syslog(LOG_DEBUG, "%s(): lightning_flash_sec_mux_sel_chan on Mux %d failed", __func__, mux);
+  tree = flash_tree(mux);
+  if (!tree || lightning_flash_lock(mux))
     return -1;
-  }
 
-  ret = lightning_nvme_temp_read(mux, temp);
-  
-  if(ret < 0) {
+  ret = flash_m2_temp(tree, i2c_map % 10, m2_mux_chan, temp);
+  if (ret < 0)
     syslog(LOG_DEBUG, "%s(): lightning_nvme_temp_read failed", __func__);
-    return -1;
-  }
 
+  lightning_flash_unlock(mux);
   return ret;
 }
 
-int 
+int
 lightning_nvme_temp_read(uint8_t mux, float *temp) {
-  int dev;
+
+  struct flash_mux_tree *tree;
   int ret;
-  int32_t res;
-  char bus[32];
 
-  if (mux == I2C_MUX_FLASH1)
-    sprintf(bus, "%s", I2C_DEV_FLASH1);
-  else if (mux == I2C_MUX_FLASH2)
-    sprintf(bus, "%s", I2C_DEV_FLASH2);
-  else {
-    syslog(LOG_DEBUG, "%s(): unknown mux", __func__);
+  //if enclosure-util read SSD, skip SSD monitor
+  if (access(SKIP_READ_SSD_TEMP, F_OK) == 0)
+    return 1;
+
+  tree = flash_tree(mux);
+  if (!tree || lightning_flash_lock(mux))
     return -1;
+
+  ret = flash_nvme_temp(tree, temp);
+
+  lightning_flash_unlock(mux);
+  return ret;
+}
+
+static void
+flash_stats_update(uint8_t flash_num, int ret, uint32_t us) {
+  lightning_flash_stats_t *st = &g_stats[flash_num];
+
+  st->count++;
+  if (ret < 0)
+    st->errors++;
+  st->last_us = us;
+  if (us > st->max_us)
+    st->max_us = us;
+}
+
+static void
+flash_stats_write(void) {
+  FILE *fp;
+  int i;
+
+  fp = fopen(FLASH_STATS_FILE ".tmp", "w");
+  if (!fp)
+    return;
+
+  fprintf(fp, "sweeps: %u\n", g_sweeps);
+  fprintf(fp, "last_sweep_us: %u\n", g_sweep_us);
+  fprintf(fp, "mux_writes: %u\n", g_mux_writes);
+  for (i = 0; i < MAX_FLASH; i++) {
+    fprintf(fp, "flash%d: count %u, errors %u, last_us %u, max_us %u\n", i,
+            g_stats[i].count, g_stats[i].errors, g_stats[i].last_us,
+            g_stats[i].max_us);
+  }
+  fclose(fp);
+  rename(FLASH_STATS_FILE ".tmp", FLASH_STATS_FILE);
+}
+
+/*
+ * Read every drive, in order of mux tree and channel, so each tree is
+ * locked once and each channel selected once. Called with m_sweep held.
+ */
+static void
+flash_sweep(uint8_t sku) {
+  struct flash_mux_tree *tree;
+  uint8_t order[MAX_FLASH];
+  uint8_t map, tmp;
+  uint64_t start, t;
+  int i, j, locked = -1;
+
+  for (i = 0; i < MAX_FLASH; i++)
+    order[i] = i;
+  // The map is the mux number followed by the channel
+  for (i = 1; i < MAX_FLASH; i++) {
+    for (j = i; j > 0 && lightning_flash_list[order[j]] <
+                         lightning_flash_list[order[j - 1]]; j--) {
+      tmp = order[j];
+      order[j] = order[j - 1];
+      order[j - 1] = tmp;
+    }
+  }
+
+  start = now_us();
+  for (i = 0; i < MAX_FLASH; i++) {
+    map = lightning_flash_list[order[i]];
+    if (locked != map / 10) {
+      if (locked >= 0)
+        lightning_flash_unlock(locked);
+      locked = map / 10;
+      lightning_flash_lock(locked);
+    }
+    tree = flash_tree(locked);
+
+    t = now_us();
+    if (sku == M2_SKU) {
+      // The ambient sensor is on the card, ahead of the M.2 mux
+      g_amb[order[i]].ret = flash_m2_amb_temp(tree, map % 10, &g_amb[order[i]].temp);
+      g_amb[order[i]].valid = 1;
+      g_temp[order[i]].ret = flash_m2_max_temp(tree, map % 10, &g_temp[order[i]].temp);
+    } else {
+      g_temp[order[i]].ret = flash_u2_temp(tree, map % 10, &g_temp[order[i]].temp);
+    }
+    g_temp[order[i]].valid = 1;
+    flash_stats_update(order[i], g_temp[order[i]].ret, now_us() - t);
   }
+  if (locked >= 0)
+    lightning_flash_unlock(locked);
+
+  g_sweep_ts = now_us();
+  g_sweep_us = g_sweep_ts - start;
+  g_sweeps++;
+  flash_stats_write();
+}
+
+/*
+ * The first reading of a drive after a sweep is served from it. A drive
+ * read again before the next sweep is due, e.g. to confirm a threshold
+ * crossing, is read from the hardware.
+ */
+static int
+flash_sched_read(uint8_t flash_num, uint8_t sku, int amb, float *temp) {
+  struct flash_result *res = amb ? &g_amb[flash_num] : &g_temp[flash_num];
+  uint64_t age;
+  int ret;
 
   //if enclosure-util read SSD, skip SSD monitor
   if (access(SKIP_READ_SSD_TEMP, F_OK) == 0)
     return 1;
 
-  dev = open(bus, O_RDWR);
-  if (dev < 0) {
-    syslog(LOG_DEBUG, "%s(): open() failed", __func__);
-    return -1;
+  pthread_mutex_lock(&m_sweep);
+  age = now_us() - g_sweep_ts;
+  if (!res->valid && (!g_sweeps || age > FLASH_SWEEP_MAX_AGE_MS * 1000)) {
+    flash_sweep(sku);
+    age = 0;
   }
 
-  /* Assign the i2c device address */
-  ret = ioctl(dev, I2C_SLAVE, I2C_NVME_INTF_ADDR);
-  if (ret < 0) {
-    syslog(LOG_DEBUG, "%s(): ioctl() assigning i2c addr failed", __func__);
-    close(dev);
-    return -1;
+  if (res->valid && age <= FLASH_SWEEP_MAX_AGE_MS * 1000) {
+    res->valid = 0;
+    *temp = res->temp;
+    ret = res->ret;
+    pthread_mutex_unlock(&m_sweep);
+    return ret;
   }
+  pthread_mutex_unlock(&m_sweep);
 
-  res = i2c_smbus_read_byte_data(dev, NVME_TEMP_REG);
-  if (res < 0) {
-    syslog(LOG_DEBUG, "%s(): i2c_smbus_read_byte_data failed", __func__);
-    close(dev);
+  if (amb)
+    return lightning_m2_amb_temp_read(lightning_flash_list[flash_num], temp);
+  if (sku == M2_SKU)
+    return lightning_m2_flash_temp_read(lightning_flash_list[flash_num], temp);
+  return lightning_u2_flash_temp_read(lightning_flash_list[flash_num], temp);
+}
+
+int
+lightning_flash_sched_temp_read(uint8_t flash_num, uint8_t sku, float *temp) {
+  if (flash_num >= MAX_FLASH || (sku != U2_SKU && sku != M2_SKU))
     return -1;
-  }
 
-  *temp = (float) res;
-  
-  close(dev);
+  return flash_sched_read(flash_num, sku, 0, temp);
+}
 
-  return ret;
+int
+lightning_flash_sched_amb_temp_read(uint8_t flash_num, uint8_t sku, float *temp) {
+  if (flash_num >= MAX_FLASH)
+    return -1;
+
+  // Only M.2 cards have the ambient sensor, so only M.2 sweeps read it
+  if (sku != M2_SKU)
+    return lightning_m2_amb_temp_read(lightning_flash_list[flash_num], temp);
+
+  return flash_sched_read(flash_num, sku, 1, temp);
+}
+
+int
+lightning_flash_get_stats(uint8_t flash_num, lightning_flash_stats_t *stats) {
+  if (flash_num >= MAX_FLASH)
+    return -1;
+
+  pthread_mutex_lock(&m_sweep);
+  *stats = g_stats[flash_num];
+  pthread_mutex_unlock(&m_sweep);
+  return 0;
 }
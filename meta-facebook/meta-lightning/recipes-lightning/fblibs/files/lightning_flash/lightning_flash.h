@@ -23,6 +23,9 @@
 extern "C" {
 #endif
 
+#include <stdint.h>
+#include <stddef.h>
+
 enum i2c_mux_list {
   I2C_MUX_FLASH1,
   I2C_MUX_FLASH2,
@@ -76,6 +79,30 @@ int lightning_m2_temp_read(uint8_t i2c_map, uint8_t sec_chan, float *temp);
 int lightning_u2_flash_temp_read(uint8_t i2c_map, float *temp);
 int lightning_nvme_temp_read(uint8_t mux, float *temp);
 
+/*
+ * Hold the mux tree across several accesses, e.g. selecting a channel and
+ * talking to the drive behind it. Locks nest, and keep other processes out.
+ */
+int lightning_flash_lock(uint8_t mux);
+void lightning_flash_unlock(uint8_t mux);
+
+/*
+ * Temperatures of drive flash_num (index in lightning_flash_list), from a
+ * sweep reading all drives in mux and channel order when one is due.
+ */
+int lightning_flash_sched_temp_read(uint8_t flash_num, uint8_t sku, float *temp);
+int lightning_flash_sched_amb_temp_read(uint8_t flash_num, uint8_t sku, float *temp);
+
+typedef struct {
+  uint32_t count;       /* sweep reads */
+  uint32_t errors;
+  uint32_t last_us;     /* latency, including mux selection */
+  uint32_t max_us;
+} lightning_flash_stats_t;
+
+/* Per drive latency of the sweeps of this process */
+int lightning_flash_get_stats(uint8_t flash_num, lightning_flash_stats_t *stats);
+
 #ifdef __cplusplus
 } // extern "C"
 #endif
@@ -576,10 +576,8 @@ read_flash_temp(uint8_t flash_num, float *value) {
     syslog(LOG_DEBUG, "%s(): lightning_ssd_sku failed", __func__);
     return -1;
   }
-  if (sku == U2_SKU)
-    return lightning_u2_flash_temp_read(lightning_flash_list[flash_num], value);
-  else if (sku == M2_SKU)
-    return lightning_m2_flash_temp_read(lightning_flash_list[flash_num], value);
+  if (sku == U2_SKU || sku == M2_SKU)
+    return lightning_flash_sched_temp_read(flash_num, sku, value);
   else {
     syslog(LOG_DEBUG, "%s(): unknown ssd sku", __func__);
     return -1;
@@ -589,7 +587,12 @@ read_flash_temp(uint8_t flash_num, float *value) {
 static int
 read_m2_amb_temp(uint8_t flash_num, float *value) {
 
-  return lightning_m2_amb_temp_read(lightning_flash_list[flash_num], value);
+  uint8_t sku = 0;
+
+  if (lightning_ssd_sku(&sku) < 0)
+    syslog(LOG_DEBUG, "%s(): lightning_ssd_sku failed", __func__);
+
+  return lightning_flash_sched_amb_temp_read(flash_num, sku, value);
 }
 
 static int
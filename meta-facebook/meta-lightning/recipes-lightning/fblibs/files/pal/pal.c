@@ -1625,19 +1625,11 @@ pal_u2_flash_read_nvme_data(uint8_t slot_num, uint8_t cmd) {
   int ret;
   uint8_t mux;
   uint8_t chan;
-  uint8_t vendor;
   char bus[32];
 
   mux = lightning_flash_list[slot_num] / 10;
   chan = lightning_flash_list[slot_num] % 10;
 
-  /* Set 1-level mux */
-  ret = lightning_flash_mux_sel_chan(mux, chan);
-  if(ret < 0) {
-    syslog(LOG_DEBUG, "%s(): lightning_flash_mux_sel_chan on Mux %d failed", __func__, mux);
-    return -1;
-  }
-
   if (mux == I2C_MUX_FLASH1)
     sprintf(bus, "%s", I2C_DEV_FLASH1);
   else if (mux == I2C_MUX_FLASH2)
@@ -1647,27 +1639,45 @@ pal_u2_flash_read_nvme_data(uint8_t slot_num, uint8_t cmd) {
     return -1;
   }
 
+  // Keep the mux on this drive until we are done with it
+  if (lightning_flash_lock(mux) < 0)
+    return -1;
+
+  /* Set 1-level mux */
+  ret = lightning_flash_mux_sel_chan(mux, chan);
+  if(ret < 0) {
+    syslog(LOG_DEBUG, "%s(): lightning_flash_mux_sel_chan on Mux %d failed", __func__, mux);
+    ret = -1;
+    goto exit;
+  }
+
+  // The bus now leads to another drive
+  nvme_snapshot_invalidate(bus);
+
   if (cmd == CMD_DRIVE_STATUS) {
     printf("Slot%d:\n", slot_num);
     ret = pal_drive_status(bus);
     if(ret < 0) {
       syslog(LOG_DEBUG, "%s(): pal_drive_status failed", __func__);
-      return -1;
+      ret = -1;
+      goto exit;
     }
 
     ret = pal_drive_health(bus);
-    return ret;
   }
 
   else if (cmd == CMD_DRIVE_HEALTH) {
     ret = pal_drive_health(bus);
-    return ret;
   }
 
   else {
     syslog(LOG_DEBUG, "%s(): unknown cmd", __func__);
-    return -1;
+    ret = -1;
   }
+
+exit:
+  lightning_flash_unlock(mux);
+  return ret;
 }
 
 int
@@ -1711,50 +1721,61 @@ pal_m2_read_nvme_data(uint8_t slot_num, uint8_t m2_mux_chan, uint8_t cmd) {
   mux = lightning_flash_list[slot_num] / 10;
   chan = lightning_flash_list[slot_num] % 10;
 
+  if (mux == I2C_MUX_FLASH1)
+    sprintf(bus, "%s", I2C_DEV_FLASH1);
+  else if (mux == I2C_MUX_FLASH2)
+    sprintf(bus, "%s", I2C_DEV_FLASH2);
+  else {
+    syslog(LOG_DEBUG, "%s(): unknown mux", __func__);
+    return -1;
+  }
+
+  // Keep the muxes on this drive until we are done with it
+  if (lightning_flash_lock(mux) < 0)
+    return -1;
+
   /* Set 1-level mux */
   ret = lightning_flash_mux_sel_chan(mux, chan);
   if(ret < 0) {
     syslog(LOG_DEBUG, "%s(): lightning_flash_mux_sel_chan on Mux %d failed", __func__, mux);
-    return -1;
+    ret = -1;
+    goto exit;
   }
 
   /* Set 2-level mux */
   ret = lightning_flash_sec_mux_sel_chan(mux, m2_mux_chan);
   if(ret < 0) {
     syslog(LOG_DEBUG, "%s(): lightning_flash_sec_mux_sel_chan on Mux %d failed", __func__, mux);
-    return -1;
+    ret = -1;
+    goto exit;
   }
 
-  if (mux == I2C_MUX_FLASH1)
-    sprintf(bus, "%s", I2C_DEV_FLASH1);
-  else if (mux == I2C_MUX_FLASH2)
-    sprintf(bus, "%s", I2C_DEV_FLASH2);
-  else {
-    syslog(LOG_DEBUG, "%s(): unknown mux", __func__);
-    return -1;
-  }
+  // The bus now leads to another drive
+  nvme_snapshot_invalidate(bus);
 
   if (cmd == CMD_DRIVE_STATUS) {
     printf("Slot%d Drive%d\n", slot_num, m2_mux_chan);
     ret = pal_drive_status(bus);
     if(ret < 0) {
       syslog(LOG_DEBUG, "%s(): pal_drive_status failed", __func__);
-      return ret;
+      goto exit;
     }
 
     ret = pal_drive_health(bus);
-    return ret;
   }
 
   else if (cmd == CMD_DRIVE_HEALTH) {
     ret = pal_drive_health(bus);
-    return ret;
   }
 
   else {
     syslog(LOG_DEBUG, "%s(): unknown cmd", __func__);
-    return -1;
+    ret = -1;
   }
+
+exit:
+  lightning_flash_unlock(mux);
+  return ret;
 }
 
 int
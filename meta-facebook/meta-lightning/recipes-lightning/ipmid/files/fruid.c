@@ -118,12 +118,7 @@ int plat_fruid_init(void) {
   return ret;
 }
 
-int plat_fruid_size(unsigned char payload_id) {
+int plat_fruid_path(unsigned char payload_id, unsigned char fru_id, char *path) {
   /* TODO: Not supported yet */
-  return 0;
-}
-
-int plat_fruid_data(unsigned char payload_id, int offset, int count, unsigned char *data) {
-  /* TODO: Not supported yet */
-  return 0;
+  return -1;
 }
@@ -157,7 +157,7 @@ oob_intf* oob_intf_create(const char *name, const uint8_t mac[6]) {
   rc = fcntl(intf->oi_fd, F_GETFL);
   _CHECK_RC("Failed to get flags from fd ", intf->oi_fd);
   flags = rc | O_NONBLOCK;
-  rc = fcntl(intf->oi_fd, F_SETFL, rc);
+  rc = fcntl(intf->oi_fd, F_SETFL, flags);
   _CHECK_RC("Failed to set non-blocking flags ", flags,
             " to fd ", intf->oi_fd);
 
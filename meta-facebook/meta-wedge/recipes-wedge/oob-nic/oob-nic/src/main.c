@@ -16,119 +16,356 @@
  * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
  */
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
-#include <sys/select.h>
-#include <sys/time.h>
+#include <poll.h>
+#include <time.h>
 #include <sys/errno.h>
 
 #include "nic.h"
+#include "nic_model.h"
 #include "intf.h"
 
 #include "openbmc/log.h"
 #include "facebook/wedge_eeprom.h"
 
-#define WAIT4PACKET_TIMEOUT 10000        /* 10ms */
-#define NO_RCV_CHECK_THRESHOLD 100 /* if not receiving pkt for 100 times (1s),
-                                    * check the NIC status
-                                    */
+#define OOB_NIC_ALERT_GPIO 9  /* MNSERV_NIC_SMBUS_ALRT, GPIO B1 */
 
-static void io_loop(oob_nic *nic, oob_intf *intf, const uint8_t mac[6]) {
+#define RX_BURST 16           /* packets read from the NIC per pass */
+#define TX_BURST 8            /* packets sent to the NIC per wakeup */
+#define POLL_MIN_MS 1         /* polling interval right after traffic */
+#define POLL_MAX_MS 20        /* polling interval once idle */
+#define ALERT_POLL_MS 500     /* read the NIC anyway, in case an edge is lost */
+#define ALERT_MISS_MAX 3      /* lost alerts in a row before polling instead */
+#define STATUS_CHECK_MS 1000  /* check the NIC status when RX is idle this long */
+#define STATS_INTERVAL_MS 10000
+#define STATS_FILE "/tmp/oob-nic.stats"
 
-  fd_set rfds;
-  int fd = oob_intf_get_fd(intf);
-  struct timeval timeout;
-  int rc;
-  int n_fds;
+/* rx is NIC to tap, tx is tap to NIC */
+struct oob_stats_t {
+  uint64_t os_rx_pkts;
+  uint64_t os_rx_bytes;
+  uint64_t os_rx_errs;          /* failed reads from the NIC */
+  uint64_t os_rx_drops;         /* packets the tap did not take */
+  uint64_t os_tx_pkts;
+  uint64_t os_tx_bytes;
+  uint64_t os_tx_errs;          /* failed sends to the NIC */
+  uint64_t os_tx_drops;         /* packets not sent to the NIC */
+  uint64_t os_alerts;
+  uint64_t os_alert_misses;     /* packets found without an alert */
+  uint64_t os_polls;            /* passes reading the NIC */
+  uint64_t os_empty_polls;      /* passes that found nothing */
+  uint64_t os_status_checks;
+  uint64_t os_restarts;
+};
+
+static oob_nic_model *model;
+
+static uint64_t now_ms(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/* Forward packets pending on the NIC to the tap. Returns the count. */
+static int nic_drain(oob_nic *nic, oob_intf *intf, struct oob_stats_t *stats) {
+  uint8_t buf[NIC_PKT_SIZE_MAX];
   int n_io;
-  char buf[NIC_PKT_SIZE_MAX];
-  int no_rcv = 0;
+  int rc;
+
+  stats->os_polls++;
+  for (n_io = 0; n_io < RX_BURST; n_io++) {
+    rc = oob_nic_receive(nic, buf, sizeof(buf));
+    if (rc < 0) {
+      stats->os_rx_errs++;
+      break;
+    }
+    if (rc == 0) {
+      break;
+    }
+    if (oob_intf_send(intf, (char *)buf, rc) < 0) {
+      stats->os_rx_drops++;
+    } else {
+      stats->os_rx_pkts++;
+      stats->os_rx_bytes += rc;
+    }
+  }
+  if (!n_io) {
+    stats->os_empty_polls++;
+  }
+  return n_io;
+}
+
+static void nic_check_status(oob_nic *nic, const uint8_t mac[6],
+                             struct oob_stats_t *stats) {
   struct oob_nic_status_t sts;
 
-  while (1) {
-    memset(&timeout, 0, sizeof(timeout));
-    timeout.tv_sec = 0;
-    timeout.tv_usec = WAIT4PACKET_TIMEOUT;
+  while (oob_nic_get_status(nic, &sts)) {
+    usleep(1000);
+  }
+  stats->os_status_checks++;
+  LOG_VER("No packets received for %d ms. NIC status is %x.%x",
+          STATUS_CHECK_MS, sts.ons_byte1, sts.ons_byte2);
+  /*
+   * if the NIC went through initialization, or not set force up, need to
+   * re-program the filters by calling oob_nic_start().
+   */
+  if ((sts.ons_byte1 & NIC_STATUS_D1_INIT)
+      || !(sts.ons_byte1 & NIC_STATUS_D1_FORCE_UP)) {
+    LOG_INFO("NIC status is %x.%x, restart it",
+             sts.ons_byte1, sts.ons_byte2);
+    while (oob_nic_start(nic, mac)) {
+      usleep(1000);
+    }
+    stats->os_restarts++;
+  }
+}
+
+static void stats_dump(const struct oob_stats_t *stats,
+                       const struct oob_stats_t *prev, uint64_t elapsed,
+                       int alert) {
+  FILE *fp;
+  oob_nic_model_stats ms;
+
+  fp = fopen(STATS_FILE ".tmp", "w");
+  if (!fp) {
+    return;
+  }
+  fprintf(fp, "mode: %s\n", alert ? "alert" : "polling");
+  fprintf(fp, "rx_pkts: %llu\n", (unsigned long long)stats->os_rx_pkts);
+  fprintf(fp, "rx_bytes: %llu\n", (unsigned long long)stats->os_rx_bytes);
+  fprintf(fp, "rx_errs: %llu\n", (unsigned long long)stats->os_rx_errs);
+  fprintf(fp, "rx_drops: %llu\n", (unsigned long long)stats->os_rx_drops);
+  fprintf(fp, "rx_bytes_per_sec: %llu\n", (unsigned long long)
+          ((stats->os_rx_bytes - prev->os_rx_bytes) * 1000 / elapsed));
+  fprintf(fp, "tx_pkts: %llu\n", (unsigned long long)stats->os_tx_pkts);
+  fprintf(fp, "tx_bytes: %llu\n", (unsigned long long)stats->os_tx_bytes);
+  fprintf(fp, "tx_errs: %llu\n", (unsigned long long)stats->os_tx_errs);
+  fprintf(fp, "tx_drops: %llu\n", (unsigned long long)stats->os_tx_drops);
+  fprintf(fp, "tx_bytes_per_sec: %llu\n", (unsigned long long)
+          ((stats->os_tx_bytes - prev->os_tx_bytes) * 1000 / elapsed));
+  fprintf(fp, "alerts: %llu\n", (unsigned long long)stats->os_alerts);
+  fprintf(fp, "alert_misses: %llu\n",
+          (unsigned long long)stats->os_alert_misses);
+  fprintf(fp, "polls: %llu\n", (unsigned long long)stats->os_polls);
+  fprintf(fp, "empty_polls: %llu\n",
+          (unsigned long long)stats->os_empty_polls);
+  fprintf(fp, "status_checks: %llu\n",
+          (unsigned long long)stats->os_status_checks);
+  fprintf(fp, "restarts: %llu\n", (unsigned long long)stats->os_restarts);
+  if (model) {
+    oob_nic_model_get_stats(model, &ms);
+    fprintf(fp, "model_rx_pkts: %llu\n", (unsigned long long)ms.onms_rx_pkts);
+    fprintf(fp, "model_rx_drops: %llu\n",
+            (unsigned long long)ms.onms_rx_drops);
+    fprintf(fp, "model_tx_pkts: %llu\n", (unsigned long long)ms.onms_tx_pkts);
+    fprintf(fp, "model_tx_errs: %llu\n", (unsigned long long)ms.onms_tx_errs);
+    fprintf(fp, "model_reads: %llu\n", (unsigned long long)ms.onms_reads);
+    fprintf(fp, "model_writes: %llu\n", (unsigned long long)ms.onms_writes);
+    fprintf(fp, "model_alerts: %llu\n", (unsigned long long)ms.onms_alerts);
+  }
+  fclose(fp);
+  rename(STATS_FILE ".tmp", STATS_FILE);
+}
+
+static void io_loop(oob_nic *nic, oob_intf *intf, const uint8_t mac[6],
+                    int alert_fd, short alert_events) {
+
+  struct pollfd pfd[2];
+  struct oob_stats_t stats, prev;
+  uint8_t buf[NIC_PKT_SIZE_MAX];
+  uint64_t now, last_rx, last_status, last_stats;
+  int poll_ms = POLL_MIN_MS;
+  int misses = 0;
+  int nfds;
+  int n_fds;
+  int n_rx, n_tx;
+  int rc;
+
+  memset(&stats, 0, sizeof(stats));
+  prev = stats;
+  last_rx = last_status = last_stats = now_ms();
 
-    FD_ZERO(&rfds);
-    FD_SET(fd, &rfds);
+  while (1) {
+    pfd[0].fd = oob_intf_get_fd(intf);
+    pfd[0].events = POLLIN;
+    nfds = 1;
+    if (alert_fd >= 0) {
+      pfd[1].fd = alert_fd;
+      pfd[1].events = alert_events;
+      pfd[1].revents = 0;
+      nfds = 2;
+    }
 
-    n_fds = select(fd + 1, &rfds, NULL, NULL, &timeout);
+    n_fds = poll(pfd, nfds, (alert_fd >= 0) ? ALERT_POLL_MS : poll_ms);
     if (n_fds < 0) {
       rc = errno;
-      LOG_ERR(rc, "Failed to select");
+      if (rc != EINTR) {
+        LOG_ERR(rc, "Failed to poll");
+      }
       continue;
     }
+    now = now_ms();
 
     /*
      * no matter what, receive packet from nic first, as the nic
      * has small amount of memory. Without read, the sending could
      * fail due to OOM.
      *
-     * TODO: We might want to do something smart here to prevent attack or
-     * just rx flooding. Disable the Receive Enable first, drain the buffer
-     * with oob_nic_receive(), then Tx, and enable Receive Enable after.
+     * With SMBALERT#, the NIC tells when it has packets, so it is only read
+     * then, plus once in a while in case an edge got lost. If that happens
+     * repeatedly, the alert is not trustworthy and we go back to polling.
      */
-    for (n_io = 0; n_io < 16; n_io++) {
-      rc = oob_nic_receive(nic, buf, sizeof(buf));
-      if (rc <= 0) {
-        no_rcv++;
-        break;
+    n_rx = 0;
+    if (alert_fd >= 0) {
+      if (pfd[1].revents & alert_events) {
+        stats.os_alerts++;
+      }
+      if (oob_nic_alert_check(nic) > 0) {
+        while ((rc = nic_drain(nic, intf, &stats)) > 0) {
+          n_rx += rc;
+          if (rc < RX_BURST) {
+            break;
+          }
+        }
+        misses = 0;
+      } else if (n_fds == 0) {
+        n_rx = nic_drain(nic, intf, &stats);
+        if (n_rx > 0) {
+          stats.os_alert_misses++;
+          if (++misses >= ALERT_MISS_MAX) {
+            LOG_INFO("Missed %d alerts in a row, fall back to polling",
+                     misses);
+            oob_nic_alert_close(nic);
+            alert_fd = -1;
+            while (oob_nic_start(nic, mac)) {
+              usleep(1000);
+            }
+          }
+        }
       }
-      oob_intf_send(intf, buf, rc);
-      no_rcv = 0;
+    } else {
+      n_rx = nic_drain(nic, intf, &stats);
     }
 
     /*
-     * if we didn't receive any packet for NO_RCV_CHECK_THRESHOLD times,
-     * check the nic status
+     * Send what the tap has queued, up to TX_BURST packets, so a burst does
+     * not need a wakeup per packet. With the alert, packets the NIC
+     * receives meanwhile are picked up between sends.
      */
-    if (no_rcv >= NO_RCV_CHECK_THRESHOLD) {
-      while(oob_nic_get_status(nic, &sts)) {
-        usleep(1000);
-      }
-      LOG_INFO("Failed to receive packets for %d times. NIC status is "
-               "%x.%x", NO_RCV_CHECK_THRESHOLD, sts.ons_byte1, sts.ons_byte2);
-      /*
-       * if the NIC went through initialization, or not set force up, need to
-       * re-program the filters by calling oob_nic_start().
-       */
-      if ((sts.ons_byte1 & NIC_STATUS_D1_INIT)
-          || !(sts.ons_byte1 & NIC_STATUS_D1_FORCE_UP)) {
-        while(oob_nic_start(nic, mac)) {
-          usleep(1000);
+    n_tx = 0;
+    if (n_fds > 0 && (pfd[0].revents & POLLIN)) {
+      for (; n_tx < TX_BURST; n_tx++) {
+        rc = oob_intf_receive(intf, (char *)buf, sizeof(buf));
+        if (rc == 0) {
+          break;
+        }
+        if (rc < 0) {
+          stats.os_tx_drops++;
+          if (rc == -ENOSPC) {
+            continue;
+          }
+          break;
+        }
+        if (oob_nic_send(nic, buf, rc) < 0) {
+          stats.os_tx_errs++;
+          stats.os_tx_drops++;
+        } else {
+          stats.os_tx_pkts++;
+          stats.os_tx_bytes += rc;
+        }
+        if (alert_fd >= 0 && oob_nic_alert_check(nic) > 0) {
+          n_rx += nic_drain(nic, intf, &stats);
         }
       }
-      no_rcv = 0;
     }
 
-    if (n_fds > 0 && FD_ISSET(fd, &rfds)) {
-      for (n_io = 0; n_io < 1; n_io++) {
-        rc = oob_intf_receive(intf, buf, sizeof(buf));
-        if (rc <= 0) {
-          break;
-        }
-        oob_nic_send(nic, buf, rc);
+    /* poll fast while there is traffic, back off when idle */
+    if (n_rx || n_tx) {
+      poll_ms = POLL_MIN_MS;
+    } else if (n_fds == 0 && poll_ms < POLL_MAX_MS) {
+      poll_ms *= 2;
+      if (poll_ms > POLL_MAX_MS) {
+        poll_ms = POLL_MAX_MS;
       }
     }
+
+    /* if we didn't receive any packet for a while, check the nic status */
+    if (n_rx) {
+      last_rx = now;
+    } else if (now - last_rx >= STATUS_CHECK_MS
+               && now - last_status >= STATUS_CHECK_MS) {
+      nic_check_status(nic, mac, &stats);
+      last_status = now;
+    }
+
+    if (now - last_stats >= STATS_INTERVAL_MS) {
+      stats_dump(&stats, &prev, now - last_stats, alert_fd >= 0);
+      prev = stats;
+      last_stats = now;
+    }
   }
 }
 
-int main(int argc, const char **argv) {
+static void usage(const char *prog) {
+  fprintf(stderr,
+          "Usage: %s [-a <gpio>] [-m]\n"
+          "  -a <gpio>  SMBALERT# gpio, -1 to poll the NIC (default %d)\n"
+          "  -m         run against a NIC model echoing packets back\n",
+          prog, OOB_NIC_ALERT_GPIO);
+}
+
+int main(int argc, char **argv) {
 
   uint8_t mac[6];
   oob_nic *nic;
   oob_intf *intf;
   struct wedge_eeprom_st eeprom;
-  int rc;
   int from_eeprom = 0;
+  int alert_gpio = OOB_NIC_ALERT_GPIO;
+  int alert_fd = -1;
+  short alert_events = 0;
+  int opt;
 
-  nic = oob_nic_open(0, 0x49);
+  while ((opt = getopt(argc, argv, "a:m")) != -1) {
+    switch (opt) {
+    case 'a':
+      alert_gpio = atoi(optarg);
+      break;
+    case 'm':
+      memcpy(mac, "\x02\x00\x00\x00\x00\x01", sizeof(mac));
+      model = oob_nic_model_create(mac);
+      if (!model) {
+        return -1;
+      }
+      oob_nic_model_set_echo(model, 1);
+      break;
+    default:
+      usage(argv[0]);
+      return -1;
+    }
+  }
+
+  if (model) {
+    nic = oob_nic_model_open(model);
+  } else {
+    nic = oob_nic_open(0, 0x49);
+  }
   if (!nic) {
     return -1;
   }
 
+  if (alert_gpio >= 0) {
+    alert_fd = oob_nic_alert_open(nic, alert_gpio, &alert_events);
+    if (alert_fd < 0) {
+      LOG_INFO("SMBALERT# not available, poll the NIC instead");
+    }
+  }
+
   /* read EEPROM for the MAC */
-  if (wedge_eeprom_parse(NULL, &eeprom) == 0) {
+  if (!model && wedge_eeprom_parse(NULL, &eeprom) == 0) {
     uint16_t carry;
     int pos;
     int adj;
@@ -198,7 +435,7 @@ int main(int argc, const char **argv) {
     usleep(1000);
   }
 
-  io_loop(nic, intf, mac);
+  io_loop(nic, intf, mac, alert_fd, alert_events);
 
   return 0;
 }
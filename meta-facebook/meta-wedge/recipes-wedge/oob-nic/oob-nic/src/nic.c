@@ -20,13 +20,16 @@
 #include <arpa/inet.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <poll.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/ioctl.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <unistd.h>
 
 #include <openbmc/obmc-i2c.h>
+#include <openbmc/gpio.h>
 #include "openbmc/log.h"
 
 #define ETHERTYPE_LLDP 0x88cc
@@ -53,6 +56,11 @@ struct oob_nic_t {
   uint8_t on_addr;
   int on_file;                  /* the file descriptor */
   uint8_t on_mac[6];            /* the mac address assigned to this NIC */
+  const oob_nic_xfer *on_xfer;
+  void *on_ctx;
+  int on_alert;                 /* receive mode is SMBALERT# */
+  gpio_st on_alert_gpio;
+  int on_ara_file;              /* for Alert Response Address reads */
 };
 
 static inline __s32 i2c_smbus_read_block_large_data(int file, __u8 command,
@@ -85,6 +93,152 @@ static inline __s32 i2c_smbus_write_block_large_data(int file, __u8 command,
                           (union i2c_smbus_data *)&data);
 }
 
+static int nic_i2c_read_block(void *ctx, uint8_t cmd, uint8_t *buf,
+                              int large) {
+  oob_nic *dev = ctx;
+  int rc;
+
+  if (large) {
+    rc = i2c_smbus_read_block_large_data(dev->on_file, cmd, buf);
+  } else {
+    rc = i2c_smbus_read_block_data(dev->on_file, cmd, buf);
+  }
+  return (rc < 0) ? -errno : rc;
+}
+
+static int nic_i2c_write_block(void *ctx, uint8_t cmd, const uint8_t *buf,
+                               int len, int large) {
+  oob_nic *dev = ctx;
+  int rc;
+
+  if (large) {
+    rc = i2c_smbus_write_block_large_data(dev->on_file, cmd, len, buf);
+  } else {
+    rc = i2c_smbus_write_block_data(dev->on_file, cmd, len, buf);
+  }
+  return (rc < 0) ? -errno : len;
+}
+
+static int nic_i2c_alert_open(void *ctx, int gpio, short *events) {
+  oob_nic *dev = ctx;
+  char fn[32];
+  int rc;
+
+  /* SMBALERT# is active low */
+  rc = gpio_open_edge(&dev->on_alert_gpio, gpio, GPIO_EDGE_FALLING);
+  if (rc) {
+    LOG_ERR(-rc, "Failed to open alert gpio %d", gpio);
+    return rc;
+  }
+
+  /*
+   * ARA is a reserved address that the smbus_alert driver may have claimed.
+   * Use a separate file, so the NIC address stays set on on_file.
+   */
+  snprintf(fn, sizeof(fn), "/dev/i2c-%d", dev->on_bus);
+  dev->on_ara_file = open(fn, O_RDWR);
+  if (dev->on_ara_file == -1) {
+    rc = -errno;
+    LOG_ERR(-rc, "Failed to open i2c device %s for ARA", fn);
+    goto err_out;
+  }
+  if (ioctl(dev->on_ara_file, I2C_SLAVE_FORCE, NIC_SMBUS_ARA_ADDR) < 0) {
+    rc = -errno;
+    LOG_ERR(-rc, "Failed to set ARA address 0x%x", NIC_SMBUS_ARA_ADDR);
+    goto err_out;
+  }
+
+  *events = POLLPRI;
+  return dev->on_alert_gpio.gs_fd;
+
+ err_out:
+  if (dev->on_ara_file != -1) {
+    close(dev->on_ara_file);
+    dev->on_ara_file = -1;
+  }
+  gpio_close(&dev->on_alert_gpio);
+  return rc;
+}
+
+static int nic_i2c_alert_check(void *ctx) {
+  oob_nic *dev = ctx;
+  int rc;
+
+  /* reading the value also clears the pending edge */
+  if (gpio_read(&dev->on_alert_gpio) != GPIO_VALUE_LOW) {
+    return 0;
+  }
+
+  /*
+   * The NIC answers the ARA with its own address and releases SMBALERT#.
+   * Other devices may share the line, so only report the alert as ours if
+   * the NIC answered. A failed ARA read still means an alert is pending;
+   * let the caller read the NIC to find out.
+   */
+  rc = i2c_smbus_read_byte(dev->on_ara_file);
+  if (rc < 0) {
+    LOG_VER("ARA read failed on %d, errno %d", dev->on_bus, errno);
+    return 1;
+  }
+  if ((rc >> 1) != dev->on_addr) {
+    LOG_VER("Alert from 0x%x on %d, not the NIC", rc >> 1, dev->on_bus);
+    return 0;
+  }
+  return 1;
+}
+
+static void nic_i2c_close(void *ctx) {
+  oob_nic *dev = ctx;
+
+  if (dev->on_file != -1) {
+    close(dev->on_file);
+  }
+}
+
+static const oob_nic_xfer nic_i2c_xfer = {
+  .read_block = nic_i2c_read_block,
+  .write_block = nic_i2c_write_block,
+  .alert_open = nic_i2c_alert_open,
+  .alert_check = nic_i2c_alert_check,
+  .close = nic_i2c_close,
+};
+
+static inline int nic_read_block(oob_nic *dev, uint8_t cmd, uint8_t *buf,
+                                 int large) {
+  return dev->on_xfer->read_block(dev->on_ctx, cmd, buf, large);
+}
+
+static inline int nic_write_block(oob_nic *dev, uint8_t cmd,
+                                  const uint8_t *buf, int len, int large) {
+  return dev->on_xfer->write_block(dev->on_ctx, cmd, buf, len, large);
+}
+
+static oob_nic* oob_nic_alloc(void) {
+  oob_nic *dev;
+
+  dev = calloc(1, sizeof(*dev));
+  if (!dev) {
+    return NULL;
+  }
+  dev->on_file = -1;
+  dev->on_ara_file = -1;
+  dev->on_alert_gpio.gs_fd = -1;
+  return dev;
+}
+
+oob_nic* oob_nic_open_xfer(const oob_nic_xfer *xfer, void *ctx) {
+  oob_nic *dev;
+
+  dev = oob_nic_alloc();
+  if (!dev) {
+    return NULL;
+  }
+  dev->on_bus = -1;
+  dev->on_xfer = xfer;
+  dev->on_ctx = ctx;
+  return dev;
+}
+
 oob_nic* oob_nic_open(int bus, uint8_t addr) {
   oob_nic *dev = NULL;
   char fn[32];
@@ -96,12 +250,14 @@ oob_nic* oob_nic_open(int bus, uint8_t addr) {
     return NULL;
   }
 
-  dev = calloc(1, sizeof(*dev));
+  dev = oob_nic_alloc();
   if (!dev) {
     return NULL;
   }
   dev->on_bus = bus;
   dev->on_addr = addr;
+  dev->on_xfer = &nic_i2c_xfer;
+  dev->on_ctx = dev;
 
   /* construct the device file name */
   snprintf(fn, sizeof(fn), "/dev/i2c-%d", bus);
@@ -129,19 +285,60 @@ void oob_nic_close(oob_nic *dev) {
   if (!dev) {
     return;
   }
-  if (dev->on_file != -1) {
+  oob_nic_alert_close(dev);
+  if (dev->on_xfer && dev->on_xfer->close) {
+    dev->on_xfer->close(dev->on_ctx);
+  } else if (dev->on_file != -1) {
     close(dev->on_file);
   }
   free(dev);
 }
 
+int oob_nic_alert_open(oob_nic *dev, int gpio, short *events) {
+  int fd;
+
+  if (!dev->on_xfer->alert_open || !dev->on_xfer->alert_check) {
+    return -ENOTSUP;
+  }
+  fd = dev->on_xfer->alert_open(dev->on_ctx, gpio, events);
+  if (fd < 0) {
+    return fd;
+  }
+  dev->on_alert = 1;
+  LOG_INFO("Receive packets on SMBALERT# (gpio %d)", gpio);
+  return fd;
+}
+
+void oob_nic_alert_close(oob_nic *dev) {
+  if (dev->on_ara_file != -1) {
+    close(dev->on_ara_file);
+    dev->on_ara_file = -1;
+  }
+  if (dev->on_alert_gpio.gs_fd != -1) {
+    gpio_close(&dev->on_alert_gpio);
+    dev->on_alert_gpio.gs_fd = -1;
+  }
+  dev->on_alert = 0;
+}
+
+int oob_nic_alert_enabled(const oob_nic *dev) {
+  return dev->on_alert;
+}
+
+int oob_nic_alert_check(oob_nic *dev) {
+  if (!dev->on_alert) {
+    return 0;
+  }
+  return dev->on_xfer->alert_check(dev->on_ctx);
+}
+
 int oob_nic_get_mac(oob_nic *dev, uint8_t mac[6]) {
   int rc;
   uint8_t buf[64];
 
-  rc = i2c_smbus_read_block_data(dev->on_file, NIC_READ_MAC_CMD, buf);
+  rc = nic_read_block(dev, NIC_READ_MAC_CMD, buf, 0);
   if (rc < 0) {
-    rc = errno;
+    rc = -rc;
     LOG_ERR(rc, "Failed to get MAC on %d-%x",
             dev->on_bus, dev->on_addr);
     return -rc;
@@ -170,9 +367,9 @@ int oob_nic_get_status(oob_nic *dev, oob_nic_status *status) {
   int rc;
   uint8_t buf[64];
 
-  rc = i2c_smbus_read_block_data(dev->on_file, NIC_READ_STATUS_CMD, buf);
+  rc = nic_read_block(dev, NIC_READ_STATUS_CMD, buf, 0);
   if (rc < 0) {
-    rc = errno;
+    rc = -rc;
     LOG_ERR(rc, "Failed to get status on %d-%x",
             dev->on_bus, dev->on_addr);
     return -rc;
@@ -209,6 +406,7 @@ int oob_nic_receive(oob_nic *dev, uint8_t *buf, int len) {
   int to_copy;
   int expect_first = 1;
   int n_frags = 0;
+  int n_reads = 0;
 
 #define _COPY_DATA(n, data) do {                    \
   int to_copy;                                      \
@@ -223,9 +421,15 @@ int oob_nic_receive(oob_nic *dev, uint8_t *buf, int len) {
 } while(0)
 
   do {
-    rc = i2c_smbus_read_block_large_data(dev->on_file, NIC_READ_PKT_CMD, pkt);
+    if (++n_reads > NIC_PKT_FRAGMENT_MAX) {
+      rc = EFAULT;
+      LOG_ERR(rc, "No LAST after %d fragments on %d-%x",
+              NIC_PKT_FRAGMENT_MAX, dev->on_bus, dev->on_addr);
+      goto err_out;
+    }
+    rc = nic_read_block(dev, NIC_READ_PKT_CMD, pkt, 1);
     if (rc < 0) {
-      rc = errno;
+      rc = -rc;
       LOG_ERR(rc, "Failed to get packet on %d-%x",
               dev->on_bus, dev->on_addr);
       goto err_out;
@@ -331,10 +535,9 @@ int oob_nic_send(oob_nic *dev, const uint8_t *data, int len) {
       }
     }
 
-    rc = i2c_smbus_write_block_large_data(dev->on_file, cmd,
-                                          to_send, data + has_sent);
+    rc = nic_write_block(dev, cmd, data + has_sent, to_send, 1);
     if (rc < 0) {
-      rc = errno;
+      rc = -rc;
       LOG_ERR(rc, "Failed to sent packet with cmd 0x%x, has_sent=%d "
               "to_send=%d", cmd, has_sent, to_send);
       return -rc;
@@ -359,10 +562,9 @@ static int oob_nic_set_mng_ctrl(oob_nic *dev, const uint8_t *data, int len) {
     return -rc;
   }
 
-  rc = i2c_smbus_write_block_data(dev->on_file, NIC_WRITE_MNG_CTRL_CMD,
-                                  len, data);
+  rc = nic_write_block(dev, NIC_WRITE_MNG_CTRL_CMD, data, len, 0);
   if (rc < 0) {
-    rc = errno;
+    rc = -rc;
     LOG_ERR(rc, "Failed to send management control command for parameter # %d",
             data[0]);
     return -rc;
@@ -416,10 +618,9 @@ static int oob_nic_setup_filters(oob_nic *dev, const uint8_t mac[6]) {
   *cmd++ = NIC_FILTER_MAC_PAIR0; /* pair 0 */
   memcpy(cmd, mac, 6);
   cmd += 6;
-  rc = i2c_smbus_write_block_data(dev->on_file, NIC_WRITE_FILTER_CMD,
-                                  cmd - buf, buf);
+  rc = nic_write_block(dev, NIC_WRITE_FILTER_CMD, buf, cmd - buf, 0);
   if (rc < 0) {
-    rc = errno;
+    rc = -rc;
     LOG_ERR(rc, "Failed to set MAC filter");
     return -rc;
   }
@@ -451,10 +652,9 @@ static int oob_nic_setup_filters(oob_nic *dev, const uint8_t mac[6]) {
                                         NIC_FILTER_MAC_PAIR0));
   memcpy(cmd, &cmd32, sizeof(cmd32));
   cmd += sizeof(cmd32);
-  rc = i2c_smbus_write_block_data(dev->on_file, NIC_WRITE_FILTER_CMD,
-                                  cmd - buf, buf);
+  rc = nic_write_block(dev, NIC_WRITE_FILTER_CMD, buf, cmd - buf, 0);
   if (rc < 0) {
-    rc = errno;
+    rc = -rc;
     LOG_ERR(rc, "Failed to set MAC filter to MDEF 0");
     return -rc;
   }
@@ -466,10 +666,9 @@ static int oob_nic_setup_filters(oob_nic *dev, const uint8_t mac[6]) {
   cmd32 = htonl(ETHERTYPE_LLDP);
   memcpy(cmd, &cmd32, sizeof(cmd32));
   cmd += sizeof(cmd32);
-  rc = i2c_smbus_write_block_data(dev->on_file, NIC_WRITE_FILTER_CMD,
-                                  cmd - buf, buf);
+  rc = nic_write_block(dev, NIC_WRITE_FILTER_CMD, buf, cmd - buf, 0);
   if (rc < 0) {
-    rc = errno;
+    rc = -rc;
     LOG_ERR(rc, "Failed to program EtherType0 to match LLDP");
     return -rc;
   }
@@ -493,10 +692,9 @@ static int oob_nic_setup_filters(oob_nic *dev, const uint8_t mac[6]) {
                 | NIC_FILTER_MDEF_BIT(NIC_FILTER_MDEF_NBG_OR_OFFSET));
   memcpy(cmd, &cmd32, sizeof(cmd32));
   cmd += sizeof(cmd32);
-  rc = i2c_smbus_write_block_data(dev->on_file, NIC_WRITE_FILTER_CMD,
-                                  cmd - buf, buf);
+  rc = nic_write_block(dev, NIC_WRITE_FILTER_CMD, buf, cmd - buf, 0);
   if (rc < 0) {
-    rc = errno;
+    rc = -rc;
     LOG_ERR(rc, "Failed to set ARP and ND filter to MDEF 1");
     return -rc;
   }
@@ -507,10 +705,9 @@ static int oob_nic_setup_filters(oob_nic *dev, const uint8_t mac[6]) {
   cmd32 = htonl(NIC_FILTER_MNG_ONLY_FILTER0);
   memcpy(cmd, &cmd32, sizeof(cmd32));
   cmd += sizeof(cmd32);
-  rc = i2c_smbus_write_block_data(dev->on_file, NIC_WRITE_FILTER_CMD,
-                                  cmd - buf, buf);
+  rc = nic_write_block(dev, NIC_WRITE_FILTER_CMD, buf, cmd - buf, 0);
   if (rc < 0) {
-    rc = errno;
+    rc = -rc;
     LOG_ERR(rc, "Failed to enabled management only filter");
     return -rc;
   }
@@ -533,17 +730,18 @@ int oob_nic_start(oob_nic *dev, const uint8_t mac[6]) {
   /* first byte is the control */
   cmd = NIC_WRITE_RECV_ENABLE_EN
     | NIC_WRITE_RECV_ENABLE_STA
-    | NIC_WRITE_RECV_ENABLE_NM_UNSUPP /* TODO, to support ALERT */
+    | (dev->on_alert
+       ? NIC_WRITE_RECV_ENABLE_NM_ALERT : NIC_WRITE_RECV_ENABLE_NM_UNSUPP)
     | NIC_WRITE_RECV_ENABLE_RESERVED;
 
-  rc = i2c_smbus_write_block_data(dev->on_file, NIC_WRITE_RECV_ENABLE_CMD,
-                                  1, &cmd);
+  rc = nic_write_block(dev, NIC_WRITE_RECV_ENABLE_CMD, &cmd, 1, 0);
   if (rc < 0) {
-    rc = errno;
+    rc = -rc;
     LOG_ERR(rc, "Failed to start receive function");
     return -rc;
   }
-  LOG_DBG("Started receive function");
+  LOG_DBG("Started receive function in %s mode",
+          dev->on_alert ? "alert" : "polling");
   return 0;
 }
 
@@ -552,10 +750,9 @@ int oob_nic_stop(oob_nic *dev) {
   uint8_t ctrl;
   /* don't set any enable bits, which turns off the receive func */
   ctrl = NIC_WRITE_RECV_ENABLE_RESERVED;
-  rc = i2c_smbus_write_block_data(dev->on_file, NIC_WRITE_RECV_ENABLE_CMD,
-                                  1, &ctrl);
+  rc = nic_write_block(dev, NIC_WRITE_RECV_ENABLE_CMD, &ctrl, 1, 0);
   if (rc < 0) {
-    rc = errno;
+    rc = -rc;
     LOG_ERR(rc, "Failed to stop receive function");
     return -rc;
   }
@@ -24,9 +24,40 @@
 
 typedef struct oob_nic_t oob_nic;
 
+/*
+ * SMBus transfers to the NIC. oob_nic_open() talks to /dev/i2c-<bus>; a
+ * stand-in (see nic_model.h) can provide its own to run without hardware.
+ * Block functions return the number of bytes transferred, or -errno.
+ */
+typedef struct oob_nic_xfer_t {
+  int (*read_block)(void *ctx, uint8_t cmd, uint8_t *buf, int large);
+  int (*write_block)(void *ctx, uint8_t cmd, const uint8_t *buf, int len,
+                     int large);
+  /* SMBALERT#, optional. Returns the fd to poll for events. */
+  int (*alert_open)(void *ctx, int gpio, short *events);
+  /* Consume pending alert events. Returns 1 while the alert is asserted. */
+  int (*alert_check)(void *ctx);
+  void (*close)(void *ctx);
+} oob_nic_xfer;
+
 oob_nic* oob_nic_open(int bus, uint8_t addr);
+oob_nic* oob_nic_open_xfer(const oob_nic_xfer *xfer, void *ctx);
 void oob_nic_close(oob_nic* dev);
 
+/*
+ * Have the NIC signal received packets on SMBALERT#, wired to gpio. Must be
+ * called before oob_nic_start(). Returns the fd to poll for events, or
+ * -errno, in which case the NIC stays in polling mode.
+ */
+int oob_nic_alert_open(oob_nic *dev, int gpio, short *events);
+void oob_nic_alert_close(oob_nic *dev);
+int oob_nic_alert_enabled(const oob_nic *dev);
+/*
+ * Consume alert events and acknowledge the alert with an ARA read.
+ * Returns 1 if the NIC has packets pending, 0 if not.
+ */
+int oob_nic_alert_check(oob_nic *dev);
+
 /* MAC */
 int oob_nic_get_mac(oob_nic *dev, uint8_t mac[6]);
 
@@ -22,6 +22,11 @@
 
 #define OOB_NIC_PKT_FRAGMENT_SIZE 240
 #define NIC_PKT_SIZE_MAX 1536
+/* fragments of one received packet, including LAST */
+#define NIC_PKT_FRAGMENT_MAX 32
+
+/** SMBus Alert Response Address */
+#define NIC_SMBUS_ARA_ADDR 0x0C
 
 /** Get System MAC Address */
 #define NIC_READ_MAC_CMD 0xD4
@@ -0,0 +1,307 @@
+/*
+ * Copyright 2017-present Facebook. All Rights Reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+#define _GNU_SOURCE
+#include "nic_model.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "openbmc/log.h"
+
+/* data bytes in a FIRST or MIDDLE fragment, after the opt code */
+#define MODEL_FRAG_DATA (OOB_NIC_PKT_FRAGMENT_SIZE - 1)
+
+struct onm_pkt_t {
+  int onmp_len;
+  uint8_t onmp_data[NIC_PKT_SIZE_MAX];
+};
+
+struct oob_nic_model_t {
+  uint8_t onm_mac[6];
+  uint8_t onm_sts1;
+  uint8_t onm_sts2;
+  int onm_started;
+  int onm_alert_mode;
+  int onm_echo;
+  /* packets from the network, waiting to be read by the driver */
+  struct onm_pkt_t onm_rx[NIC_MODEL_RX_SLOTS];
+  int onm_rx_head;
+  int onm_rx_count;
+  int onm_rx_off;               /* bytes of the head packet already read */
+  /* packet being written by the driver */
+  uint8_t onm_tx[NIC_PKT_SIZE_MAX];
+  int onm_tx_len;
+  int onm_tx_busy;
+  int onm_alert_pipe[2];
+  int onm_alert_raised;
+  oob_nic_model_stats onm_stats;
+};
+
+static void model_alert_raise(oob_nic_model *model) {
+  uint8_t c = 0;
+
+  if (!model->onm_alert_mode || !model->onm_rx_count
+      || model->onm_alert_raised) {
+    return;
+  }
+  if (write(model->onm_alert_pipe[1], &c, 1) == 1) {
+    model->onm_alert_raised = 1;
+    model->onm_stats.onms_alerts++;
+  }
+}
+
+static int model_read_pkt(oob_nic_model *model, uint8_t *buf) {
+  struct onm_pkt_t *pkt;
+  int n;
+
+  if (!model->onm_rx_count) {
+    /* nothing pending, the NIC answers with its status */
+    buf[0] = NIC_READ_STATUS_RES_OPT;
+    buf[1] = model->onm_sts1;
+    buf[2] = model->onm_sts2;
+    return NIC_READ_STATUS_RES_LEN;
+  }
+
+  pkt = &model->onm_rx[model->onm_rx_head];
+  if (model->onm_rx_off < pkt->onmp_len) {
+    n = pkt->onmp_len - model->onm_rx_off;
+    if (n > MODEL_FRAG_DATA) {
+      n = MODEL_FRAG_DATA;
+    }
+    buf[0] = model->onm_rx_off
+      ? NIC_READ_PKT_RES_MIDDLE_OPT : NIC_READ_PKT_RES_FIRST_OPT;
+    memcpy(&buf[1], &pkt->onmp_data[model->onm_rx_off], n);
+    model->onm_rx_off += n;
+    return n + 1;
+  }
+
+  /* LAST carries the packet status only */
+  buf[0] = NIC_READ_PKT_RES_LAST_OPT;
+  memset(&buf[1], 0, NIC_READ_PKT_RES_LAST_LEN - 1);
+  model->onm_rx_head = (model->onm_rx_head + 1) % NIC_MODEL_RX_SLOTS;
+  model->onm_rx_count--;
+  model->onm_rx_off = 0;
+  model->onm_stats.onms_rx_pkts++;
+  model_alert_raise(model);
+  return NIC_READ_PKT_RES_LAST_LEN;
+}
+
+static int model_read_block(void *ctx, uint8_t cmd, uint8_t *buf, int large) {
+  oob_nic_model *model = ctx;
+
+  model->onm_stats.onms_reads++;
+  switch (cmd) {
+  case NIC_READ_MAC_CMD:
+    buf[0] = NIC_READ_MAC_RES_OPT;
+    memcpy(&buf[1], model->onm_mac, sizeof(model->onm_mac));
+    return NIC_READ_MAC_RES_LEN;
+  case NIC_READ_STATUS_CMD:
+    buf[0] = NIC_READ_STATUS_RES_OPT;
+    buf[1] = model->onm_sts1;
+    buf[2] = model->onm_sts2;
+    return NIC_READ_STATUS_RES_LEN;
+  case NIC_READ_PKT_CMD:
+    if (!large) {
+      return -EINVAL;
+    }
+    return model_read_pkt(model, buf);
+  default:
+    /* the NIC NACKs unknown commands */
+    return -EIO;
+  }
+}
+
+static void model_tx_done(oob_nic_model *model) {
+  uint8_t addr[6];
+
+  model->onm_stats.onms_tx_pkts++;
+  if (!model->onm_echo || model->onm_tx_len < 2 * sizeof(addr)) {
+    return;
+  }
+  memcpy(addr, model->onm_tx, sizeof(addr));
+  memcpy(model->onm_tx, &model->onm_tx[6], sizeof(addr));
+  memcpy(&model->onm_tx[6], addr, sizeof(addr));
+  oob_nic_model_inject(model, model->onm_tx, model->onm_tx_len);
+}
+
+static int model_write_pkt(oob_nic_model *model, uint8_t cmd,
+                           const uint8_t *buf, int len) {
+  if (cmd == NIC_WRITE_PKT_SINGLE_CMD || cmd == NIC_WRITE_PKT_FIRST_CMD) {
+    model->onm_tx_len = 0;
+    model->onm_tx_busy = 1;
+  } else if (!model->onm_tx_busy) {
+    model->onm_stats.onms_tx_errs++;
+    return -EIO;
+  }
+
+  if (model->onm_tx_len + len > sizeof(model->onm_tx)) {
+    model->onm_tx_busy = 0;
+    model->onm_stats.onms_tx_errs++;
+    return -EIO;
+  }
+  memcpy(&model->onm_tx[model->onm_tx_len], buf, len);
+  model->onm_tx_len += len;
+
+  if (cmd == NIC_WRITE_PKT_SINGLE_CMD || cmd == NIC_WRITE_PKT_LAST_CMD) {
+    model->onm_tx_busy = 0;
+    model_tx_done(model);
+  }
+  return len;
+}
+
+static int model_write_block(void *ctx, uint8_t cmd, const uint8_t *buf,
+                             int len, int large) {
+  oob_nic_model *model = ctx;
+
+  model->onm_stats.onms_writes++;
+  if (len <= 0 || len > (large ? OOB_NIC_PKT_FRAGMENT_SIZE : 32)) {
+    return -EINVAL;
+  }
+
+  switch (cmd) {
+  case NIC_WRITE_PKT_SINGLE_CMD:
+  case NIC_WRITE_PKT_FIRST_CMD:
+  case NIC_WRITE_PKT_MIDDLE_CMD:
+  case NIC_WRITE_PKT_LAST_CMD:
+    return model_write_pkt(model, cmd, buf, len);
+  case NIC_WRITE_MNG_CTRL_CMD:
+    if (len >= 2 && buf[0] == NIC_MNG_CTRL_KEEP_LINK_UP_NUM) {
+      if (buf[1] == NIC_MNG_CTRL_KEEP_LINK_UP_ENABLE) {
+        model->onm_sts1 |= NIC_STATUS_D1_FORCE_UP;
+      } else {
+        model->onm_sts1 &= ~NIC_STATUS_D1_FORCE_UP;
+      }
+    }
+    return len;
+  case NIC_WRITE_FILTER_CMD:
+    /* every packet injected passes the filters */
+    return len;
+  case NIC_WRITE_RECV_ENABLE_CMD:
+    model->onm_started = buf[0] & NIC_WRITE_RECV_ENABLE_EN;
+    model->onm_alert_mode = model->onm_started
+      && (buf[0] & NIC_WRITE_RECV_ENABLE_NM_UNSUPP)
+           == NIC_WRITE_RECV_ENABLE_NM_ALERT;
+    model->onm_sts1 &= ~NIC_STATUS_D1_INIT;
+    model_alert_raise(model);
+    return len;
+  default:
+    return -EIO;
+  }
+}
+
+static int model_alert_open(void *ctx, int gpio, short *events) {
+  oob_nic_model *model = ctx;
+
+  *events = POLLIN;
+  return model->onm_alert_pipe[0];
+}
+
+static int model_alert_check(void *ctx) {
+  oob_nic_model *model = ctx;
+  uint8_t buf[16];
+
+  while (read(model->onm_alert_pipe[0], buf, sizeof(buf)) > 0) {
+  }
+  model->onm_alert_raised = 0;
+  return model->onm_rx_count ? 1 : 0;
+}
+
+static void model_close(void *ctx) {
+  oob_nic_model_destroy(ctx);
+}
+
+static const oob_nic_xfer model_xfer = {
+  .read_block = model_read_block,
+  .write_block = model_write_block,
+  .alert_open = model_alert_open,
+  .alert_check = model_alert_check,
+  .close = model_close,
+};
+
+oob_nic_model* oob_nic_model_create(const uint8_t mac[6]) {
+  oob_nic_model *model;
+
+  model = calloc(1, sizeof(*model));
+  if (!model) {
+    return NULL;
+  }
+  if (pipe2(model->onm_alert_pipe, O_NONBLOCK | O_CLOEXEC)) {
+    LOG_ERR(errno, "Failed to create the alert pipe");
+    free(model);
+    return NULL;
+  }
+  memcpy(model->onm_mac, mac, sizeof(model->onm_mac));
+  model->onm_sts1 = NIC_STATUS_D1_INIT | NIC_STATUS_D1_LINK;
+  model->onm_sts2 = NIC_STATUS_D2_DRV_VALID;
+  return model;
+}
+
+void oob_nic_model_destroy(oob_nic_model *model) {
+  if (!model) {
+    return;
+  }
+  close(model->onm_alert_pipe[0]);
+  close(model->onm_alert_pipe[1]);
+  free(model);
+}
+
+oob_nic* oob_nic_model_open(oob_nic_model *model) {
+  return oob_nic_open_xfer(&model_xfer, model);
+}
+
+int oob_nic_model_inject(oob_nic_model *model, const uint8_t *pkt, int len) {
+  struct onm_pkt_t *slot;
+
+  if (len <= 0 || len > NIC_PKT_SIZE_MAX) {
+    return -EINVAL;
+  }
+  if (!model->onm_started || model->onm_rx_count >= NIC_MODEL_RX_SLOTS) {
+    model->onm_stats.onms_rx_drops++;
+    return -ENOBUFS;
+  }
+
+  slot = &model->onm_rx[(model->onm_rx_head + model->onm_rx_count)
+                        % NIC_MODEL_RX_SLOTS];
+  memcpy(slot->onmp_data, pkt, len);
+  slot->onmp_len = len;
+  model->onm_rx_count++;
+  model_alert_raise(model);
+  return len;
+}
+
+void oob_nic_model_set_echo(oob_nic_model *model, int enable) {
+  model->onm_echo = enable;
+}
+
+void oob_nic_model_reset(oob_nic_model *model) {
+  model->onm_started = 0;
+  model->onm_alert_mode = 0;
+  model->onm_rx_count = 0;
+  model->onm_rx_off = 0;
+  model->onm_tx_busy = 0;
+  model->onm_sts1 = NIC_STATUS_D1_INIT | NIC_STATUS_D1_LINK;
+}
+
+void oob_nic_model_get_stats(const oob_nic_model *model,
+                             oob_nic_model_stats *stats) {
+  *stats = model->onm_stats;
+}
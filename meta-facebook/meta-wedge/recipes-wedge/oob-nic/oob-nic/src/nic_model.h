@@ -0,0 +1,70 @@
+/*
+ * Copyright 2017-present Facebook. All Rights Reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+#ifndef NIC_MODEL_H
+#define NIC_MODEL_H
+
+#include <stdint.h>
+
+#include "nic.h"
+
+/*
+ * Stand-in for the NIC at the SMBus command level, so the driver can be
+ * exercised without hardware. It answers the MAC, status, filter and
+ * receive enable commands, hands out received packets as FIRST/MIDDLE/LAST
+ * fragments and reassembles transmitted ones. SMBALERT# is emulated with a
+ * pipe that becomes readable while packets are pending.
+ *
+ * Like the NIC, it only buffers a few received packets and drops the rest.
+ */
+
+#define NIC_MODEL_RX_SLOTS 8
+
+typedef struct oob_nic_model_t oob_nic_model;
+
+typedef struct oob_nic_model_stats_t {
+  uint64_t onms_rx_pkts;      /* handed to the driver */
+  uint64_t onms_rx_drops;     /* RX buffer full */
+  uint64_t onms_tx_pkts;      /* reassembled from the driver */
+  uint64_t onms_tx_errs;      /* bad fragment sequence */
+  uint64_t onms_reads;        /* SMBus block reads */
+  uint64_t onms_writes;       /* SMBus block writes */
+  uint64_t onms_alerts;
+} oob_nic_model_stats;
+
+oob_nic_model* oob_nic_model_create(const uint8_t mac[6]);
+void oob_nic_model_destroy(oob_nic_model *model);
+
+/* The model is closed together with the returned handle */
+oob_nic* oob_nic_model_open(oob_nic_model *model);
+
+/* Queue a packet as if it arrived from the network. -ENOBUFS if dropped. */
+int oob_nic_model_inject(oob_nic_model *model, const uint8_t *pkt, int len);
+
+/*
+ * Send every transmitted packet back with the Ethernet addresses swapped,
+ * so traffic from the tap interface comes back to it.
+ */
+void oob_nic_model_set_echo(oob_nic_model *model, int enable);
+
+/* Report NIC_STATUS_D1_INIT, as after a NIC reset */
+void oob_nic_model_reset(oob_nic_model *model);
+
+void oob_nic_model_get_stats(const oob_nic_model *model,
+                             oob_nic_model_stats *stats);
+
+#endif
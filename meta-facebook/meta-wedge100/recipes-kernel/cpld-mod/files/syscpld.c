@@ -593,8 +593,20 @@ static int syscpld_probe(struct i2c_client *client,
                          const struct i2c_device_id *id)
 {
   int n_attrs = sizeof(syscpld_attr_table) / sizeof(syscpld_attr_table[0]);
-  return i2c_dev_sysfs_data_init(client, &syscpld_data,
-                                 syscpld_attr_table, n_attrs);
+  int err;
+
+  err = i2c_dev_sysfs_data_init(client, &syscpld_data,
+                                syscpld_attr_table, n_attrs);
+  if (err) {
+    return err;
+  }
+
+  /* plain registers, so they can be cached and read in bulk */
+  err = i2c_dev_sysfs_cache_init(client, &syscpld_data, 0);
+  if (err) {
+    i2c_dev_sysfs_data_clean(client, &syscpld_data);
+  }
+  return err;
 }
 
 static int syscpld_remove(struct i2c_client *client)
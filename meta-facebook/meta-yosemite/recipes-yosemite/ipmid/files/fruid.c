@@ -108,51 +108,22 @@ int plat_fruid_init(void) {
   return ret;
 }
 
-int plat_fruid_size(unsigned char payload_id) {
-  char fpath[64] = {0};
-  struct stat buf;
-  int ret;
-
-  // Fill the file path for a given slot
-  sprintf(fpath, BIN_SLOT, payload_id);
-
-  // check the size of the file and return size
-  ret = stat(fpath, &buf);
-  if (ret) {
-    return 0;
-  }
-
-  return buf.st_size;
-}
-
-int plat_fruid_data(unsigned char payload_id, int offset, int count, unsigned char *data) {
-  char fpath[64] = {0};
-  int fd;
-  int ret;
-
-  // Fill the file path for a given slot
-  sprintf(fpath, BIN_SLOT, payload_id);
-
-  // open file for read purpose
-  fd = open(fpath, O_RDONLY);
-  if (fd < 0) {
-    return fd;
-  }
-
-  // seek position based on given offset
-  ret = lseek(fd, offset, SEEK_SET);
-  if (ret < 0) {
-    close(fd);
-    return ret;
-  }
-
-  // read the file content
-  ret = read(fd, data, count);
-  if (ret != count) {
-    close(fd);
-    return -1;
+int plat_fruid_path(unsigned char payload_id, unsigned char fru_id, char *path) {
+
+  switch (fru_id) {
+    case 0:
+      // Fill the file path for a given slot
+      sprintf(path, BIN_SLOT, payload_id);
+      break;
+    case 1:
+      strcpy(path, BIN_SPB);
+      break;
+    case 2:
+      strcpy(path, BIN_NIC);
+      break;
+    default:
+      return -1;
   }
 
-  close(fd);
   return 0;
 }